@@ -48,6 +48,7 @@ extern UWORD Helios_ComputeCRC16(const QUADLET *data, ULONG len);
 extern void Helios_AddEventListener(HeliosEventListenerList *list, HeliosEventMsg *node);
 extern void Helios_RemoveEventListener(HeliosEventListenerList *list, HeliosEventMsg *node);
 extern void Helios_SendEvent(HeliosEventListenerList *list, ULONG event, ULONG result);
+extern void Helios_FreeEvent(HeliosEventMsg *msg);
 
 /* Subtask API */
 extern HeliosSubTask *Helios_CreateSubTaskA(CONST_STRPTR name, HeliosSubTaskEntry entry, struct TagItem *tags);
@@ -72,6 +73,10 @@ extern LONG Helios_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length);
 extern void Helios_InitRomIterator(HeliosRomIterator *ri, const QUADLET *rom);
 extern LONG Helios_RomIterate(HeliosRomIterator *ri, QUADLET *key, QUADLET *value);
 extern LONG Helios_ReadTextualDescriptor(const QUADLET *dir, STRPTR buffer, ULONG length);
+extern LONG Helios_LoadROMCache(CONST_STRPTR filename);
+extern LONG Helios_SaveROMCache(CONST_STRPTR filename);
+extern LONG Helios_LoadROMQuirks(CONST_STRPTR filename);
+extern LONG Helios_SaveROMQuirks(CONST_STRPTR filename);
 
 /* Objects API */
 extern LONG Helios_SetAttrsA(ULONG type, APTR obj, struct TagItem *tags);
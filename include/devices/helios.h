@@ -46,6 +46,10 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define HHIOCMD_DELETEISOCONTEXT  (CMD_NONSTD+11)
 #define HHIOCMD_STARTISOCONTEXT   (CMD_NONSTD+12)
 #define HHIOCMD_STOPISOCONTEXT    (CMD_NONSTD+13)
+#define HHIOCMD_SENDREQUESTS      (CMD_NONSTD+14) /* Data: IOHeliosHWSendRequest *[], Length: count */
+#define HHIOCMD_DUMPTRACE         (CMD_NONSTD+15) /* Data: HeliosTraceEvent[], Length: bytes */
+#define HHIOCMD_RESETSTATISTICS   (CMD_NONSTD+16) /* Zeroes HHA_Statistics counters */
+#define HHIOCMD_READCAPTURE       (CMD_NONSTD+17) /* Data: HeliosCapturePacket[], Length: bytes */
 
 /* They also support following standard IO commands:
  * - CMD_RESET
@@ -71,6 +75,10 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define HHA_NodeCount          (HHA_Dummy+15)
 #define HHA_TopologyGeneration (HHA_Dummy+16)
 #define HHA_LocalGUID          (HHA_Dummy+17)
+#define HHA_TraceMask          (HHA_Dummy+18) /* ULONG HTRACEF_xxx (also HHIOCMD_SETATTRIBUTES) */
+#define HHA_TraceRing          (HHA_Dummy+19) /* HeliosTraceRing *, for class drivers tracepoints */
+#define HHA_Statistics         (HHA_Dummy+20) /* HeliosHWStatistics *, filled by a copy */
+#define HHA_Capture            (HHA_Dummy+21) /* ULONG HCAPF_xxx (also HHIOCMD_SETATTRIBUTES) */
 
 /* Hardware Capabilities */
 #define HHF_1394A_1995 (1<<0) /* Speeds: s100, s200, s400 */
@@ -85,9 +93,20 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define HHIOERR_NOMEM                     5
 
 /* RequestHandler flags */
-#define HHF_REQH_ALLOCLEN 1 /* let Helios find the start address in given region */
+#define HHF_REQH_ALLOCLEN 1 /* let Helios find the start address in given region, else use rh_Start */
+#define HHF_REQH_ZEROCOPY 2 /* request payloads are borrowed views into the receive DMA buffer */
 
+/* HHF_REQH_ZEROCOPY: the request Payload given to the callback points directly
+ * into the receive DMA buffer and shall be considered as read-only.
+ * It stays valid after the callback returns, until the handler gives it back
+ * by calling rh_Release(handler, request->Payload), exactly once per request
+ * with a non-empty payload (PayloadLength > 0). The device stops to receive
+ * requests when all its buffers are borrowed: release them as soon as
+ * possible, and before removing the handler.
+ */
+struct HeliosHWReqHandler;
 typedef HeliosResponse * (*HeliosHWReqCallback)(HeliosAPacket *request, APTR udata);
+typedef void (*HeliosHWReqRelease)(struct HeliosHWReqHandler *reqh, QUADLET *payload);
 
 typedef struct HeliosHWReqHandler
 {
@@ -100,6 +119,10 @@ typedef struct HeliosHWReqHandler
     HeliosHWReqCallback rh_ReqCallback;
     APTR                rh_UserData;
     ULONG               rh_Flags;
+
+    /* Following fields exist only if HHF_REQH_ZEROCOPY is set, filled by HHIOCMD_ADDREQHANDLER */
+    HeliosHWReqRelease  rh_Release;
+    APTR                rh_ReleaseData;
 } HeliosHWReqHandler;
 
 typedef struct IOHeliosHWReq
@@ -118,4 +141,194 @@ typedef struct IOHeliosHWSendRequest
     HeliosTransaction     iohhe_Transaction;      /* Just fill the packet */
 } IOHeliosHWSendRequest;
 
+/* HHIOCMD_SENDREQUESTS: each IOHeliosHWSendRequest of the array is filled as
+ * for HHIOCMD_SENDREQUEST and replied alone when done (use WaitIO() on it).
+ * The batch request itself is replied as soon as all requests are queued,
+ * iohh_Actual giving the number of requests put on the bus.
+ * A NULL array entry is skipped and sets the batch io_Error to HHIOERR_FAILED,
+ * the other requests being sent.
+ */
+
+/* 1394 cycle timer (seconds:7, cycles:13, offset:12) as 24.576MHz ticks,
+ * wrapping every HELIOS_CYCLE_WRAP ticks (128 seconds).
+ */
+#define HELIOS_CYCLE_TICKS(ct)  (((((ct) >> 25) * 8000) + (((ct) >> 12) & 0x1fff)) * 3072 + ((ct) & 0xfff))
+#define HELIOS_CYCLE_WRAP       (128ul * 8000 * 3072)
+
+/* Tracepoints.
+ * Each unit records fixed-size events into a ring, timestamped by the
+ * 1394 cycle timer (seconds:7, cycles:13, offset:12). Subsystems are enabled
+ * at runtime by HHA_TraceMask, a disabled tracepoint costs one test.
+ * HHIOCMD_DUMPTRACE copies the recorded events, oldest first, and sets
+ * iohh_Actual to the number of events copied.
+ */
+#define HTRACE_AT           0   /* Asynchronous transmit contexts */
+#define HTRACE_AR           1   /* Asynchronous receive contexts */
+#define HTRACE_IRQ          2   /* Interrupts and deferred handler */
+#define HTRACE_TL           3   /* Transaction layer */
+#define HTRACE_BUSRESET     4
+#define HTRACE_SBP2         5
+
+#define HTRACEF_AT          (1<<HTRACE_AT)
+#define HTRACEF_AR          (1<<HTRACE_AR)
+#define HTRACEF_IRQ         (1<<HTRACE_IRQ)
+#define HTRACEF_TL          (1<<HTRACE_TL)
+#define HTRACEF_BUSRESET    (1<<HTRACE_BUSRESET)
+#define HTRACEF_SBP2        (1<<HTRACE_SBP2)
+#define HTRACEF_ALL         (~0ul)
+
+/* Tracepoint id: subsystem in the high byte */
+#define HTP_ID(sub, n)      (((sub) << 8) | (n))
+#define HTP_SUBSYSTEM(id)   ((id) >> 8)
+
+                                                     /* Arg16          Args[0]          Args[1] */
+#define HTP_AT_SEND         HTP_ID(HTRACE_AT, 0)     /* tlabel         header[0]        packet data */
+#define HTP_AT_COMPLETE     HTP_ID(HTRACE_AT, 1)     /* ack or rcode   timestamp        packet data */
+#define HTP_AT_DROP         HTP_ID(HTRACE_AT, 2)     /* rcode          header[0]        packet data */
+#define HTP_AR_PACKET       HTP_ID(HTRACE_AR, 0)     /* event          header[0]        header[1] */
+#define HTP_AR_DROP         HTP_ID(HTRACE_AR, 1)     /* generation     header[0]        header[1] */
+#define HTP_IRQ_EVENTS      HTP_ID(HTRACE_IRQ, 0)    /* -              events           iso events */
+#define HTP_IRQ_HANDLER     HTP_ID(HTRACE_IRQ, 1)    /* -              pending events   - */
+#define HTP_TL_SEND         HTP_ID(HTRACE_TL, 0)     /* tlabel         destid:tcode     transaction */
+#define HTP_TL_RESPONSE     HTP_ID(HTRACE_TL, 1)     /* rcode          srcid:tlabel     transaction */
+#define HTP_TL_FINISH       HTP_ID(HTRACE_TL, 2)     /* rcode          destid           transaction */
+#define HTP_TL_TIMEOUT      HTP_ID(HTRACE_TL, 3)     /* tlabel         destid           transaction */
+#define HTP_BUSRESET_SELFID HTP_ID(HTRACE_BUSRESET, 0) /* generation   local node id    self-id quadlets */
+#define HTP_SBP2_QUEUE      HTP_ID(HTRACE_SBP2, 0)   /* opcode         ORB address      length */
+#define HTP_SBP2_DOORBELL   HTP_ID(HTRACE_SBP2, 1)   /* -              queue count      - */
+#define HTP_SBP2_STATUS     HTP_ID(HTRACE_SBP2, 2)   /* -              status[0]        ORB address */
+#define HTP_SBP2_DONE       HTP_ID(HTRACE_SBP2, 3)   /* opcode         error            length */
+
+typedef struct HeliosTraceEvent
+{
+    ULONG te_Seq;       /* Recording order, from 1 */
+    ULONG te_Time;      /* Cycle timer */
+    UWORD te_Id;        /* HTP_xxx */
+    UWORD te_Arg16;
+    ULONG te_Args[2];
+} HeliosTraceEvent;
+
+typedef ULONG (*HeliosTraceClock)(APTR data);
+
+/* Lock-free ring, the oldest events are overwritten */
+typedef struct HeliosTraceRing
+{
+    ULONG              tr_Mask;        /* HTRACEF_xxx */
+    ULONG              tr_Head;        /* Events recorded */
+    ULONG              tr_Size;        /* Events in tr_Events, a power of 2 */
+    HeliosTraceEvent * tr_Events;
+    HeliosTraceClock   tr_Clock;
+    APTR               tr_ClockData;
+} HeliosTraceRing;
+
+/* Statistics.
+ * Counters are updated without lock by the unit and only wrap: a rate is
+ * the difference of two HHA_Statistics snapshots, modulo 2^32.
+ * High-water marks and hs_LatencyMax are kept since the last
+ * HHIOCMD_RESETSTATISTICS.
+ *
+ * Latency is measured on the cycle timer from the transaction send to its
+ * completion (response, split timeout or error), in a log2 histogram:
+ * bin 0 counts latencies under 1us, bin n those in [2^(n-1), 2^n[ us,
+ * the last bin everything above.
+ */
+#define HSTAT_LATENCY_BINS      20
+#define HSTAT_RCODE_INDEX(rc)   ((rc) >= 0 ? (rc) : 15 - (rc)) /* HELIOS_RCODE_xxx, negatives from 16 */
+
+typedef struct HeliosHWCtxStats
+{
+    ULONG cs_Packets;
+    ULONG cs_Bytes;       /* Headers and payloads */
+    ULONG cs_HighWater;   /* AT: max DMA buffers in use */
+} HeliosHWCtxStats;
+
+typedef struct HeliosHWStatistics
+{
+    HeliosHWCtxStats hs_ATRequest;
+    HeliosHWCtxStats hs_ATResponse;
+    HeliosHWCtxStats hs_ARRequest;
+    HeliosHWCtxStats hs_ARResponse;
+    ULONG            hs_Acks[16];                /* By HELIOS_ACK_xxx code */
+    ULONG            hs_RCodes[32];              /* Transactions by HSTAT_RCODE_INDEX() */
+    ULONG            hs_BusyAcks;                /* Busy acks left after the hardware retries */
+    ULONG            hs_SplitTimeouts;
+    ULONG            hs_ATGenerationDrops;       /* Packets not sent due to a bus reset */
+    ULONG            hs_ARGenerationDrops;       /* Packets received from a previous generation */
+    ULONG            hs_Latency[HSTAT_LATENCY_BINS];
+    ULONG            hs_LatencyMax;              /* us */
+} HeliosHWStatistics;
+
+/* Bus capture.
+ * When HHA_Capture is not 0, each unit copies the asynchronous packets it
+ * sends, the AT completions and the received packets into a lock-free ring.
+ * HHIOCMD_READCAPTURE copies the packets recorded after the cp_Seq given
+ * in iohh_Actual (0 for the oldest kept) and sets iohh_Actual to the number
+ * of packets copied. A gap in cp_Seq gives the count of lost packets.
+ *
+ * cp_Header has the same layout for all cp_Type: the IEEE 1394 wire format
+ * (destination_ID, tl, rt, tcode, pri then source_ID...), host order.
+ * AT packets are converted from the OHCI AT format, the speed is in cp_Speed.
+ * Exceptions, as given by the OHCI AR contexts: PHY packets are a tcode
+ * quadlet, then the PHY quadlet and its inverse, and a bus reset packet
+ * (cp_Event 0x09) has the new generation in bits 23-16 of its third quadlet.
+ */
+#define HCAPF_HEADERS           (1<<0)
+#define HCAPF_PAYLOAD           (1<<1) /* Also the first HCAPTURE_PAYLOAD bytes of payloads */
+
+#define HCAPTURE_AT_SEND        0   /* Packet appended to an AT context */
+#define HCAPTURE_AT_COMPLETE    1   /* AT packet handled by the controller, no payload */
+#define HCAPTURE_AR             2   /* Packet received, including bus reset packets */
+
+#define HCAPTURE_PAYLOAD        32
+
+typedef struct HeliosCapturePacket
+{
+    ULONG   cp_Seq;                     /* Recording order, from 1 */
+    ULONG   cp_Time;                    /* Cycle timer at capture */
+    UWORD   cp_TimeStamp;               /* OHCI timestamp (seconds:3, cycles:13), 0 for AT_SEND */
+    UBYTE   cp_Type;                    /* HCAPTURE_xxx */
+    UBYTE   cp_Event;                   /* OHCI event code (acks are 0x10 + ack), 0 for AT_SEND */
+    UWORD   cp_PayloadLength;           /* Payload bytes of the packet */
+    UBYTE   cp_HeaderLength;            /* Bytes in cp_Header */
+    UBYTE   cp_CapLength;               /* Bytes in cp_Payload */
+    UBYTE   cp_Speed;                   /* S100_xxx, sent or received at */
+    QUADLET cp_Header[4];
+    UBYTE   cp_Payload[HCAPTURE_PAYLOAD];
+} HeliosCapturePacket;
+
+/* Lock-free ring, the oldest packets are overwritten */
+typedef struct HeliosCaptureRing
+{
+    ULONG                 cr_Flags;       /* HCAPF_xxx, 0 when disabled */
+    ULONG                 cr_Head;        /* Packets recorded */
+    ULONG                 cr_Size;        /* Packets in cr_Packets, a power of 2 */
+    HeliosCapturePacket * cr_Packets;
+    HeliosTraceClock      cr_Clock;
+    APTR                  cr_ClockData;
+} HeliosCaptureRing;
+
+/* Capture files.
+ * helios_capture writes a pcap file (format 2.4, microseconds) of link
+ * type HCAPTURE_LINKTYPE (LINKTYPE_USER0). Each pcap packet is a
+ * HeliosCapturePcapHeader, big-endian, then the cp_HeaderLength bytes of
+ * the 1394 header quadlets (layout of cp_Header) and the cp_CapLength bytes
+ * of payload.
+ * The pcap original length counts the whole payload.
+ */
+#define HCAPTURE_LINKTYPE       147
+#define HCAPTURE_PCAP_VERSION   2
+
+typedef struct HeliosCapturePcapHeader
+{
+    UBYTE   cph_Version;                /* HCAPTURE_PCAP_VERSION */
+    UBYTE   cph_Type;                   /* cp_Type */
+    UBYTE   cph_Event;                  /* cp_Event */
+    UBYTE   cph_HeaderLength;           /* cp_HeaderLength */
+    UWORD   cph_TimeStamp;              /* cp_TimeStamp */
+    UWORD   cph_PayloadLength;          /* cp_PayloadLength */
+    ULONG   cph_CycleTimer;             /* cp_Time */
+    UBYTE   cph_Speed;                  /* cp_Speed */
+    UBYTE   cph_Reserved[3];            /* 0 */
+} HeliosCapturePcapHeader;
+
 #endif /* DEVICE_HELIOS_H */
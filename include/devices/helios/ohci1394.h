@@ -32,10 +32,77 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define OHCI1394_VERSION_1_0    0x00010000
 #define OHCI1394_VERSION_1_1    0x00010010
 
+/* Highest OHCI1394A_IrqMaxRate ceiling, larger values are clamped to it */
+#define OHCI1394_IRQ_MAX_RATE   1000
+
 /* More tags for HHIOCMD_QUERYDEVICE io request */
 #define OHCI1394A_Dummy             (HELIOS_TAGBASE+0x200)
 #define OHCI1394A_PciVendorId       (OHCI1394A_Dummy+0)
 #define OHCI1394A_PciDeviceId       (OHCI1394A_Dummy+1)
 #define OHCI1394A_Generation        (OHCI1394A_Dummy+2)
+#define OHCI1394A_IrqMaxRate        (OHCI1394A_Dummy+3) /* ULONG interrupts/s, 0 = no limit (also HHIOCMD_SETATTRIBUTES) */
+#define OHCI1394A_IrqStats          (OHCI1394A_Dummy+4) /* OHCI1394IrqStats * */
+#define OHCI1394A_SplitStats        (OHCI1394A_Dummy+5) /* OHCI1394SplitStats * */
+#define OHCI1394A_Replay            (OHCI1394A_Dummy+6) /* OHCI1394Replay *, HHIOCMD_SETATTRIBUTES only */
+#define OHCI1394A_IrDrops           (OHCI1394A_Dummy+7) /* ULONG, buffer-fill IR packets too large to cross the page ring end */
+
+/* Interrupt counters, given by the OHCI1394A_IrqStats query.
+ * AT/AR and isochronous events are handled by one deferred handler per unit:
+ * the difference between interrupts taken and events handled shows the coalescing.
+ */
+typedef struct OHCI1394IrqStats
+{
+    ULONG is_Interrupts;        /* IRQ handler calls with events */
+    ULONG is_HandlerRuns;       /* Deferred handler wake-ups */
+    ULONG is_Events;            /* AT/AR and iso context events handled */
+    ULONG is_ATRequest;         /* Event counts per class */
+    ULONG is_ATResponse;
+    ULONG is_ARRequest;
+    ULONG is_ARResponse;
+    ULONG is_IsoRecv;
+    ULONG is_IsoXmit;
+    ULONG is_Throttled;         /* Unmasks delayed by the OHCI1394A_IrqMaxRate ceiling */
+    ULONG is_BudgetExhausted;   /* Handler runs stopped by the event budget */
+} OHCI1394IrqStats;
+
+/* SPLIT-TIMEOUT counters, given by the OHCI1394A_SplitStats query.
+ * A split timer is armed when a request is acked pending.
+ */
+typedef struct OHCI1394SplitStats
+{
+    ULONG ss_Armed;             /* Timers armed */
+    ULONG ss_Pending;           /* Timers currently waiting a response */
+    ULONG ss_Expired;           /* Transactions finished by SPLIT-TIMEOUT */
+    ULONG ss_Cancelled;         /* Timers stopped by a response or a cancellation */
+} OHCI1394SplitStats;
+
+/* Capture replay, run by HHIOCMD_SETATTRIBUTES with the OHCI1394A_Replay tag.
+ * Only known by a device built on the controller model (make SIMULATOR=1).
+ * Records are HHIOCMD_READCAPTURE ones, replayed in order in the caller task:
+ * sent requests, their acks, received responses and bus resets are given to
+ * the transaction layer as the DMA handlers do, received requests are injected
+ * in the model by their source peer. Sent responses are not replayed, the
+ * request handlers of the device send them again.
+ * Latencies are host times between a request and its ack or response.
+ */
+typedef struct OHCI1394Replay
+{
+    /* Given */
+    HeliosCapturePacket *rp_Packets;
+    ULONG rp_Count;
+    ULONG rp_Speed;             /* 0: compressed (no wait), 1: original timing, n: n times faster */
+
+    /* Returned */
+    ULONG rp_Transactions;      /* Replayed requests */
+    ULONG rp_Completed;         /* Finished by a recorded ack or response */
+    ULONG rp_Unmatched;         /* Responses without request, requests left pending at the end */
+    ULONG rp_Requests;          /* Received requests injected in the model */
+    ULONG rp_BusResets;
+    ULONG rp_Errors;            /* Records not replayed: no free tlabel, model queue full */
+    ULONG rp_ElapsedUS;
+    ULONG rp_Latency[4];        /* p50, p90, p99 and max of completed requests, in us */
+    ULONG rp_TLAllocs;          /* Transaction layer pool allocations */
+    ULONG rp_ModelAllocs;       /* Controller model packet allocations */
+} OHCI1394Replay;
 
 #endif /* DEVICE_OHCI1394_H */
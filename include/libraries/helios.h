@@ -51,7 +51,13 @@ typedef enum
 /* Physical speed reported by SelfID packets for beta nodes */
 #define SBETA 3
 
-/* HeliosReportMsg types */
+/* HeliosReportMsg types.
+ * Helios_ReportMsg() messages are formatted when read: fmt and the %s
+ * args are copied into the record, which has 160 bytes for the label,
+ * the string args and the format. Args that do not fit are truncated
+ * (counted by HA_ReportsTruncated); a format that does not fit is
+ * formatted at once by the caller.
+ */
 #define HRMB_FATAL 0
 #define HRMB_ERROR 1
 #define HRMB_WARN  2
@@ -100,6 +106,11 @@ typedef enum
 #define HELIOS_ISO_RX_CTX 0
 #define HELIOS_ISO_TX_CTX 1
 
+/* Isochronous receive modes (HA_IsoRxMode) */
+#define HELIOS_ISO_RX_PACKET_PER_BUFFER 0 /* One HeliosIRBuffer per packet (default) */
+#define HELIOS_ISO_RX_BUFFER_FILL       1 /* Packets stored contiguously, given by batch */
+#define HELIOS_ISO_RX_MULTI_CHANNEL     2 /* As BUFFER_FILL, for all channels set in the mask */
+
 /* API return error codes */
 #define HERR_NOERR     0
 #define HERR_NOMEM    -1
@@ -156,6 +167,19 @@ typedef enum
 #define HA_IsoChannel          (HA_Dummy+35)
 #define HA_IsoTag              (HA_Dummy+36)
 #define HA_IsoRxDropEmpty      (HA_Dummy+37)
+#define HA_IsoTxCIP            (HA_Dummy+38)
+#define HA_IsoCycleMatch       (HA_Dummy+39)
+#define HA_IsoRxMode           (HA_Dummy+40)
+#define HA_IsoChannelMaskHi    (HA_Dummy+41)
+#define HA_IsoChannelMaskLo    (HA_Dummy+42)
+#define HA_RomScanTime         (HA_Dummy+43)
+#define HA_RomScanRequests     (HA_Dummy+44)
+#define HA_EventsSent          (HA_Dummy+45)
+#define HA_EventsCoalesced     (HA_Dummy+46)
+#define HA_EventsOverflows     (HA_Dummy+47)
+#define HA_EventsDropped       (HA_Dummy+48)
+#define HA_ReportsDropped      (HA_Dummy+49)
+#define HA_ReportsTruncated    (HA_Dummy+50)
 
 /*--- Class methods (HeliosClass_DoMethodA) ----*/
 #define HCM_Dummy                (HELIOS_TAGBASE+0x200)
@@ -326,6 +350,7 @@ typedef struct HeliosEventMsg
     struct timeval  hm_Time;
     ULONG           hm_EventMask;
     APTR            hm_UserData;
+    ULONG           hm_Count;       /* Events coalesced in this message (POOLED_EVENT listeners) */
 } HeliosEventMsg;
 
 /* Helios messages types */
@@ -334,6 +359,7 @@ enum
     HELIOS_MSGTYPE_TASKKILL,
     HELIOS_MSGTYPE_EVENT,
     HELIOS_MSGTYPE_FAST_EVENT,
+    HELIOS_MSGTYPE_POOLED_EVENT, /* As EVENT, messages freed by Helios_FreeEvent() */
 };
 
 typedef struct HeliosReportMsg
@@ -342,6 +368,7 @@ typedef struct HeliosReportMsg
     ULONG          hrm_TypeBit;
     CONST_STRPTR   hrm_Label;
     CONST_STRPTR   hrm_Msg;
+    struct timeval hrm_Time;
 } HeliosReportMsg;
 
 typedef union HeliosBusOptions
@@ -350,6 +377,7 @@ typedef union HeliosBusOptions
 
     struct
     {
+#if BYTE_ORDER == BIG_ENDIAN
         /* bits from 31 to 0 */
         QUADLET IsoRsrcMgr      : 1;
         QUADLET CycleMaster     : 1;
@@ -363,6 +391,21 @@ typedef union HeliosBusOptions
         QUADLET CfgROMChg       : 2;
         QUADLET Reserved0       : 3;
         QUADLET MaxLinkSpeed    : 3;
+#else
+        /* bits from 0 to 31 */
+        QUADLET MaxLinkSpeed    : 3;
+        QUADLET Reserved0       : 3;
+        QUADLET CfgROMChg       : 2;
+        QUADLET Reserved1       : 4;
+        QUADLET MaxRec          : 4;
+        QUADLET CycleClockAcc   : 8;
+        QUADLET Reserved2       : 3;
+        QUADLET PowerMgt        : 1;
+        QUADLET BusMgr          : 1;
+        QUADLET Isochronous     : 1;
+        QUADLET CycleMaster     : 1;
+        QUADLET IsoRsrcMgr      : 1;
+#endif
     } r;
 } HeliosBusOptions;
 
@@ -414,6 +457,40 @@ typedef struct HeliosIRBuffer
 
 typedef void (*HeliosIRCallback)(HeliosIRBuffer *irbuf, ULONG status, APTR userdata);
 
+/* One packet received by a buffer-fill Iso Receive context.
+ * Payload points into the context pages and is valid only during the callback call.
+ */
+typedef struct HeliosIRPacket
+{
+    QUADLET Header;         /* Isochronous packet header (length, tag, channel, tcode, sy) */
+    UWORD   Status;         /* xferStatus of the packet (speed and event code) */
+    UWORD   TimeStamp;      /* Cycle time when the packet was received */
+    APTR    Payload;
+    ULONG   PayloadLength;
+} HeliosIRPacket;
+
+typedef void (*HeliosIRBatchCallback)(HeliosIRPacket *packets, ULONG count, ULONG status, APTR userdata);
+
+/* HeliosITBuffer Flags */
+#define HELIOS_ITBF_SKIP (1<<0) /* Send nothing during this cycle */
+
+/* One packet of an Iso Transmit context, filled by the HeliosITCallback
+ * for each completed packet (and for all packets before the context start).
+ */
+typedef struct HeliosITBuffer
+{
+    APTR    Payload;        /* Data to send (DMA-able memory, default points to the context buffer) */
+    ULONG   PayloadLength;  /* Bytes to send (0 = CIP header only packet) */
+    ULONG   PayloadSize;    /* Size of the context buffer (read-only) */
+    QUADLET CIP[2];         /* CIP header (HA_IsoTxCIP contexts only) */
+    UBYTE   Sy;             /* Synchronization code of the packet */
+    UBYTE   Flags;          /* HELIOS_ITBF_xxx */
+    UWORD   TimeStamp;      /* Cycle time when the previous packet of this buffer was sent (read-only) */
+    ULONG   Underruns;      /* DMA underruns count of the context (read-only) */
+} HeliosITBuffer;
+
+typedef void (*HeliosITCallback)(HeliosITBuffer *itbuf, ULONG status, APTR userdata);
+
 typedef struct HeliosNode
 {
     UBYTE          n_PhyID;
@@ -0,0 +1,135 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Bus capture recording, see capture.h.
+**
+*/
+
+#include "capture.h"
+
+#include <proto/exec.h>
+#include <clib/macros.h>
+#include <string.h>
+
+void capture_Init(HeliosCaptureRing *ring, HeliosCapturePacket *packets, ULONG size,
+                  HeliosTraceClock clock, APTR clock_data)
+{
+    ring->cr_Flags = 0;
+    ring->cr_Head = 0;
+    ring->cr_Size = size;
+    ring->cr_Packets = packets;
+    ring->cr_Clock = clock;
+    ring->cr_ClockData = clock_data;
+    bzero(packets, size * sizeof(*packets));
+}
+
+/* Lock-free, callable from interrupts.
+ * header is in host order, payload is copied only with HCAPF_PAYLOAD.
+ */
+void capture_Packet(HeliosCaptureRing *ring, UBYTE type, UBYTE event, UWORD timestamp, UBYTE speed,
+                    const QUADLET *header, ULONG header_length,
+                    const void *payload, ULONG payload_length)
+{
+    HeliosCapturePacket *cp;
+    ULONG ticket, i;
+
+    do
+    {
+        ticket = ring->cr_Head;
+    }
+    while (ATOMIC_CMPXCHG(&ring->cr_Head, ticket, ticket + 1) != ticket);
+
+    cp = &ring->cr_Packets[ticket & (ring->cr_Size - 1)];
+
+    cp->cp_Seq = 0;
+    MEMORY_BARRIER();
+
+    header_length = MIN(header_length, sizeof(cp->cp_Header));
+
+    cp->cp_Time = (NULL != ring->cr_Clock) ? ring->cr_Clock(ring->cr_ClockData) : 0;
+    cp->cp_TimeStamp = timestamp;
+    cp->cp_Type = type;
+    cp->cp_Event = event;
+    cp->cp_Speed = speed;
+    cp->cp_PayloadLength = payload_length;
+    cp->cp_HeaderLength = header_length;
+    for (i=0; i < header_length / sizeof(QUADLET); i++)
+    {
+        cp->cp_Header[i] = header[i];
+    }
+
+    if ((NULL != payload) && (ring->cr_Flags & HCAPF_PAYLOAD))
+    {
+        cp->cp_CapLength = MIN(payload_length, HCAPTURE_PAYLOAD);
+        memcpy(cp->cp_Payload, payload, cp->cp_CapLength);
+    }
+    else
+    {
+        cp->cp_CapLength = 0;
+    }
+
+    MEMORY_BARRIER();
+    cp->cp_Seq = ticket + 1;
+}
+
+/* Copy up to count packets recorded after the one of seq after, oldest first.
+ * Returns the number of packets copied.
+ */
+ULONG capture_Read(HeliosCaptureRing *ring, ULONG after, HeliosCapturePacket *packets, ULONG count)
+{
+    ULONG head, ticket, n=0;
+
+    head = ATOMIC_FETCH((LONG *)&ring->cr_Head);
+    ticket = head > ring->cr_Size ? head - ring->cr_Size : 0;
+
+    /* Not before the oldest kept */
+    if ((LONG)(after - ticket) > 0)
+    {
+        ticket = after;
+    }
+
+    for (; (ticket != head) && (n < count); ticket++)
+    {
+        volatile HeliosCapturePacket *cp = &ring->cr_Packets[ticket & (ring->cr_Size - 1)];
+        ULONG seq = cp->cp_Seq;
+
+        if (seq != (ticket + 1))
+        {
+            if ((LONG)(seq - (ticket + 1)) < 0)
+            {
+                break; /* Being written, the next read restarts here */
+            }
+
+            continue; /* Overwritten */
+        }
+
+        MEMORY_BARRIER();
+        CopyMem((APTR)cp, &packets[n], sizeof(HeliosCapturePacket));
+        MEMORY_BARRIER();
+
+        if (cp->cp_Seq == seq)
+        {
+            n++;
+        }
+    }
+
+    return n;
+}
@@ -0,0 +1,47 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Bus capture recording.
+**
+** Same ring as the tracepoints one (trace.h): writers take a ticket on
+** cr_Head, the slot cp_Seq is cleared during the fill and set to
+** ticket + 1 after. A reader stops at a slot still being written and
+** skips the overwritten ones.
+**
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "utils.h"
+#include "devices/helios.h"
+
+/* The flags test is the only cost of a disabled capture tap */
+#define CAPTURE_ENABLED(ring) __builtin_expect(0 != (ring)->cr_Flags, 0)
+
+extern void capture_Init(HeliosCaptureRing *ring, HeliosCapturePacket *packets, ULONG size,
+                         HeliosTraceClock clock, APTR clock_data);
+extern void capture_Packet(HeliosCaptureRing *ring, UBYTE type, UBYTE event, UWORD timestamp, UBYTE speed,
+                           const QUADLET *header, ULONG header_length,
+                           const void *payload, ULONG payload_length);
+extern ULONG capture_Read(HeliosCaptureRing *ring, ULONG after, HeliosCapturePacket *packets, ULONG count);
+
+#endif /* CAPTURE_H */
@@ -101,6 +101,8 @@ struct HeliosDevice
     ULONG                   hd_RomLength;
     HeliosIds               hd_Ids;
     struct MinList          hd_Units; /* Logical units */
+    ULONG                   hd_RomScanTime;     /* Last ROM scan duration in ms */
+    ULONG                   hd_RomScanRequests; /* Read requests of the last ROM scan */
 };
 
 #define HELIOS_HW_HEAD                                                  \
@@ -114,7 +116,8 @@ struct HeliosDevice
     HeliosEventListenerList hu_Listeners;                               \
     struct MinList          hu_Devices;                                 \
     UWORD                   hu_LocalNodeId; /* Known after successfull Self-ID process */ \
-    UWORD                   hu_Pad0;
+    UWORD                   hu_Pad0;                                    \
+    struct HeliosScanner *  hu_Scanner; /* ROM scan scheduler (library private) */
 
 struct HeliosHardware
 {
@@ -0,0 +1,110 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Tracepoints recording, see trace.h.
+**
+*/
+
+#include "trace.h"
+
+#include <proto/exec.h>
+#include <string.h>
+
+void trace_Init(HeliosTraceRing *ring, HeliosTraceEvent *events, ULONG size,
+                HeliosTraceClock clock, APTR clock_data)
+{
+    ring->tr_Mask = 0;
+    ring->tr_Head = 0;
+    ring->tr_Size = size;
+    ring->tr_Events = events;
+    ring->tr_Clock = clock;
+    ring->tr_ClockData = clock_data;
+    bzero(events, size * sizeof(*events));
+}
+
+/* Lock-free, callable from interrupts */
+void trace_Record(HeliosTraceRing *ring, UWORD id, UWORD arg16, ULONG arg1, ULONG arg2)
+{
+    HeliosTraceEvent *ev;
+    ULONG ticket;
+
+    do
+    {
+        ticket = ring->tr_Head;
+    }
+    while (ATOMIC_CMPXCHG(&ring->tr_Head, ticket, ticket + 1) != ticket);
+
+    ev = &ring->tr_Events[ticket & (ring->tr_Size - 1)];
+
+    ev->te_Seq = 0;
+    MEMORY_BARRIER();
+
+    ev->te_Time = (NULL != ring->tr_Clock) ? ring->tr_Clock(ring->tr_ClockData) : 0;
+    ev->te_Id = id;
+    ev->te_Arg16 = arg16;
+    ev->te_Args[0] = arg1;
+    ev->te_Args[1] = arg2;
+
+    MEMORY_BARRIER();
+    ev->te_Seq = ticket + 1;
+}
+
+/* Copy up to count events, oldest first. Returns the number of events copied */
+ULONG trace_Dump(HeliosTraceRing *ring, HeliosTraceEvent *events, ULONG count)
+{
+    ULONG head, ticket, n=0;
+
+    head = ATOMIC_FETCH((LONG *)&ring->tr_Head);
+    ticket = head > ring->tr_Size ? head - ring->tr_Size : 0;
+
+    /* Keep the newest ones */
+    if ((head - ticket) > count)
+    {
+        ticket = head - count;
+    }
+
+    for (; ticket != head; ticket++)
+    {
+        volatile HeliosTraceEvent *ev = &ring->tr_Events[ticket & (ring->tr_Size - 1)];
+        ULONG seq = ev->te_Seq;
+
+        if (seq != (ticket + 1))
+        {
+            continue; /* Overwritten or being written */
+        }
+
+        MEMORY_BARRIER();
+        events[n].te_Seq = seq;
+        events[n].te_Time = ev->te_Time;
+        events[n].te_Id = ev->te_Id;
+        events[n].te_Arg16 = ev->te_Arg16;
+        events[n].te_Args[0] = ev->te_Args[0];
+        events[n].te_Args[1] = ev->te_Args[1];
+        MEMORY_BARRIER();
+
+        if (ev->te_Seq == seq)
+        {
+            n++;
+        }
+    }
+
+    return n;
+}
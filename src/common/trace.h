@@ -0,0 +1,48 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Tracepoints recording.
+**
+** Writers take a ticket on tr_Head and fill the slot ticket % tr_Size.
+** The slot te_Seq is cleared during the fill and set to ticket + 1 after,
+** so a reader checks te_Seq before and after its copy to skip a slot
+** overwritten meanwhile.
+**
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "utils.h"
+#include "devices/helios.h"
+
+/* The mask test is the only cost of a disabled tracepoint */
+#define TRACE(ring, id, a16, a1, a2) ({ \
+    HeliosTraceRing *_r = (ring); \
+    if (__builtin_expect(0 != (_r->tr_Mask & (1ul << HTP_SUBSYSTEM(id))), 0)) \
+        trace_Record(_r, (id), (a16), (ULONG)(a1), (ULONG)(a2)); })
+
+extern void trace_Init(HeliosTraceRing *ring, HeliosTraceEvent *events, ULONG size,
+                       HeliosTraceClock clock, APTR clock_data);
+extern void trace_Record(HeliosTraceRing *ring, UWORD id, UWORD arg16, ULONG arg1, ULONG arg2);
+extern ULONG trace_Dump(HeliosTraceRing *ring, HeliosTraceEvent *events, ULONG count);
+
+#endif /* TRACE_H */
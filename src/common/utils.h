@@ -57,6 +57,35 @@ static inline LONG _ATOMIC_NCMPXCHG(volatile LONG *ptr, LONG old, LONG new)
 #define ATOMIC_NCMPXCHG(p,o,n) _ATOMIC_NCMPXCHG(p,o,n)
 #endif
 
+/* Store new at *ptr if it contains old, returns the previous *ptr value */
+#ifndef ATOMIC_CMPXCHG
+static inline ULONG _ATOMIC_CMPXCHG(volatile ULONG *ptr, ULONG old, ULONG new)
+{
+    register ULONG ret;
+
+    __asm__ __volatile__ (
+        "\n"
+        ".atomic_cmpxchg_loop_%=:\n"
+        "   lwarx   %0,0,%2\n"
+        "   cmpw    0,%0,%3\n"
+        "   bne-    .atomic_cmpxchg_out_%=\n"
+        "   stwcx.  %4,0,%2\n"
+        "   bne-    .atomic_cmpxchg_loop_%=\n"
+        ".atomic_cmpxchg_out_%=:\n"
+        : "=&r" (ret)
+        : "m" (*ptr), "r" (ptr), "r" (old), "r" (new)
+        : "memory", "cr0");
+
+    return ret;
+};
+#define ATOMIC_CMPXCHG(p,o,n) _ATOMIC_CMPXCHG(p,o,n)
+#endif
+
+/* Stores before are visible to other CPUs before stores after */
+#ifndef MEMORY_BARRIER
+#define MEMORY_BARRIER() __asm__ __volatile__ ("sync" : : : "memory")
+#endif
+
 /* Lock region facilities */
 #define LOCK_VARIABLE struct SignalSemaphore SpinLock
 #define LOCK_INIT(x) InitSemaphore(&(x)->SpinLock);
@@ -76,6 +76,7 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "utils.h"
 #include "debug.h"
+#include "trace.h"
 #include "proto/helios.h"
 
 #include <devices/scsidisk.h>
@@ -126,9 +127,39 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define STATUS_GET_DATA(v)       ((v).data)
 
 #define ORB_PAGE_SIZE 0xfffc /* DataLen = 0xffff, but addresses must be 4-bytes aligned */
-#define ORB_SG_PAGES 64 /* enough for maxXfer=2MB and page_size=0xfffc */
+#define ORB_SG_PAGES 64 /* page table in the request, larger ones come from u_SGPool */
+#define ORB_SG_MAX_PAGES 0xffff /* data_size field of a page table ORB */
 #define ORB_TIMEOUT 3500 /* important to let the time to launch motor for some devices like CD */
 
+#define SBP2_QUEUE_DEPTH 8 /* Command ORBs linked on the fetch agent (env var helios_sbp2_queuedepth) */
+#define SBP2_QUEUE_DEPTH_MAX 32
+
+/* Byte offset of a read/write ioreq, io_Actual is not io_HighOffset for CMD_READ/CMD_WRITE */
+#define IOREQ_OFFSET64(io) ((((io)->io_Command == CMD_READ) || ((io)->io_Command == CMD_WRITE)) ? \
+                            (UQUAD)(io)->io_LowOffset : (((UQUAD)(io)->io_HighOffset<<32) + (io)->io_LowOffset))
+
+#define SBP2_SCHED_SLOTS 64       /* ioreqs sorted by the scheduler (env var helios_sbp2_scheduler) */
+#define SBP2_SCHED_MERGE 8        /* ioreqs merged in one read/write command */
+#define SBP2_SCHED_READ_EXPIRE 8  /* Dispatches before a waiting read/write is served first (deadline) */
+#define SBP2_SCHED_WRITE_EXPIRE 32
+
+#define SBP2_WB_MAX 4096          /* Max write-back buffer in KB (env var helios_sbp2_writeback, 0 = off) */
+#define SBP2_WB_EXTENTS 64        /* Dirty ranges in the write-back buffer */
+#define SBP2_WB_DELAY 500         /* ms before dirty data are written */
+#define SBP2_WB_RETRIES 3         /* Failed flushes of a ready unit before dirty data are dropped */
+
+#define SBP2_RA_MAX 4096          /* Max read-ahead window in KB (env var helios_sbp2_readahead, 0 = off) */
+#define SBP2_RA_MIN (1ul<<15)     /* First read-ahead window, doubled at each prefetch of a run */
+#define SBP2_RA_SLOTS 2           /* The window being read and the next one */
+#define SBP2_RA_TRIGGER 2         /* Sequential reads before the first prefetch */
+
+#define SBP2_XFER_MIN (1ul<<16)   /* Max transfer per read/write command (env var helios_sbp2_maxtransfer) */
+#define SBP2_XFER_START (1ul<<17)
+#define SBP2_XFER_MAX (1ul<<22)
+#define SBP2_XFER_PROBE 32        /* Full size transfers measured before a step up */
+#define SBP2_PAYLOAD_MIN 7        /* 512 bytes */
+#define SBP2_PAYLOAD_MAX 12
+
 #define SBP2_VENDORID_LEN 8
 #define SBP2_PRODUCTID_LEN 16
 #define SBP2_PRODUCTVERSION_LEN 4
@@ -160,6 +191,13 @@ typedef struct SBP2SGPage
     ULONG addr_lo;
 } SBP2SGPage __attribute__((__aligned__(8)));
 
+/* Data buffer piece of a command not transfering into a single buffer */
+typedef struct SBP2Segment
+{
+    APTR  sg_Data;
+    ULONG sg_Length;
+} SBP2Segment;
+
 struct SBP2ORBRequest;
 struct SBP2Unit;
 
@@ -242,11 +280,80 @@ typedef struct SBP2SCSICmdReq
     ORBSCSICommand    sr_ORB;
     struct SCSICmd *  sr_Cmd;
     struct SBP2Unit * sr_Unit;
+    const SBP2Segment *sr_Segs;       /* Replaces scsi_Data if not NULL */
+    ULONG             sr_SegCount;
+    ULONG             sr_Mapped;      /* Segments given to CachePreDMA() */
+    SBP2Segment       sr_DataSeg;     /* scsi_Data as a segment */
+    SBP2SGPage *      sr_SGTable;     /* sr_SGPages or a larger table */
+    ULONG             sr_SGTableSize; /* Entries */
+
+    /* Queued commands only */
+    struct MinNode    sr_ChainNode;   /* u_ORBChain */
+    struct MinNode    sr_DoneNode;    /* u_ORBDoneList */
+    struct IOStdReq * sr_IOReqs[SBP2_SCHED_MERGE]; /* Replied at completion in offset order */
+    ULONG             sr_IOReqCount;  /* 0 once replied */
+    SBP2Segment       sr_MergeSegs[SBP2_SCHED_MERGE];
+    BOOL              sr_Completed;   /* Status received or ORB cancelled */
+    BOOL              sr_Cancelled;
+    BOOL              sr_InFlight;    /* ORB_POINTER write not returned */
+    struct timeval    sr_Start;       /* Queued at, for the transfer tuning */
+    struct SCSICmd    sr_SCSICmd;
+    UBYTE             sr_CDB[12];
+    UBYTE             sr_Sense[20];
 
     /* Align SG pages on a cache line */
     SBP2SGPage        sr_SGPages[ORB_SG_PAGES];
 } SBP2SCSICmdReq;
 
+/* An ioreq waiting in the scheduler */
+typedef struct SBP2SchedEntry
+{
+    struct IOStdReq * se_IOReq;
+    UQUAD             se_Offset;
+    ULONG             se_Seq;         /* u_SchedSeq at arrival */
+    BOOL              se_Write;
+    BOOL              se_Barrier;     /* Not a read/write, nothing passes it */
+} SBP2SchedEntry;
+
+/* Scheduler policy: returns the index of the next entry to dispatch
+ * among the count first ones, count > 0 and none is a barrier.
+ */
+typedef struct SBP2SchedPolicy
+{
+    CONST_STRPTR      sp_Name;
+    ULONG           (*sp_Pick)(struct SBP2Unit *unit, ULONG count);
+} SBP2SchedPolicy;
+
+/* A dirty range of the write-back buffer */
+typedef struct SBP2WBExtent
+{
+    UQUAD             we_Offset;
+    ULONG             we_Length;
+    UBYTE *           we_Data;        /* In u_WBBuffer */
+} SBP2WBExtent;
+
+/* A read-ahead window */
+typedef struct SBP2RASlot
+{
+    struct IOStdReq   rs_IOReq;       /* Prefetch, replied to u_RAPort */
+    struct MinList    rs_Waiting;     /* ioreqs served at the end of the prefetch */
+    UBYTE *           rs_Buffer;
+    UQUAD             rs_Offset;
+    ULONG             rs_Length;      /* 0 = empty */
+    BOOL              rs_Loading;
+    BOOL              rs_Stale;       /* Dropped at the end of the prefetch */
+} SBP2RASlot;
+
+/* Tuned transfer sizes of a target, kept by the class */
+typedef struct SBP2XferInfo
+{
+    struct MinNode xi_Node;
+    UQUAD          xi_GUID;
+    ULONG          xi_MaxTransfer;
+    ULONG          xi_MaxTransferLimit;
+    UBYTE          xi_PayloadLimit;
+} SBP2XferInfo;
+
 typedef struct
 {
     ULONG Logged:1;
@@ -265,6 +372,7 @@ typedef struct
     ULONG PowerCond:1;    /* Set POWER_CONDITION bits */
     ULONG FixCapacity:1;  /* Try to fix capacity values if wrong */
     ULONG MaxXfert128k:1; /* Use for xfert 128k-bytes at max per SCSI command */
+    ULONG FixedXfer:1;    /* Max transfer set by the user, no tuning */
 } SBP2Flags;
 
 /* SBP2 logical unit: */
@@ -289,6 +397,7 @@ typedef struct SBP2Unit
     HeliosHardware *     u_HeliosHW;
     HeliosDevice *       u_HeliosDevice;
     HeliosUnit *         u_HeliosUnit;
+    HeliosTraceRing *    u_Trace;         /* Hardware tracepoints ring (HTRACEF_SBP2) */
     ULONG                u_Generation;
     UQUAD                u_GUID;
     UWORD                u_NodeID;
@@ -313,16 +422,76 @@ typedef struct SBP2Unit
     struct MinList       u_PendingORBList;
     HeliosHWReqHandler   u_FSReqHandler;
 
+    /* Command ORB queue: read/write ORBs are linked through next_ORB and the
+     * DOORBELL, completed by the status FIFO handler and replied by the unit task.
+     */
+    ULONG                u_QueueDepth;      /* 0 = no queue */
+    ULONG                u_QueueCount;      /* Queued ORBs not replied */
+    ULONG                u_QueueDone;       /* Replied ORBs (timeout progress) */
+    ULONG                u_QueueMark;
+    LONG                 u_QueueError;      /* io_Error of cancelled ORBs */
+    struct MsgPort *     u_QueuePort;       /* Transport replies, its signal is also the status signal */
+    struct MinList       u_ORBChain;        /* Queued requests in fetch order, kept until the next one is done */
+    struct MinList       u_ORBDoneList;     /* Completed by the status handler */
+    SBP2SCSICmdReq *     u_ORBTail;         /* Last linked ORB, NULL when the agent needs an ORB_POINTER write */
+    struct timerequest * u_QueueTimer;
+    IOHeliosHWSendRequest u_DoorbellReq;
+    BOOL                 u_DoorbellBusy;
+    BOOL                 u_DoorbellAgain;   /* Ring again when u_DoorbellReq returns */
+
+    /* I/O scheduler: ioreqs taken from the unit port in arrival order,
+     * dispatched sorted by offset and merged when adjacent.
+     */
+    const SBP2SchedPolicy *u_SchedPolicy;
+    ULONG                u_SchedCount;
+    ULONG                u_SchedSeq;        /* Dispatched groups */
+    UQUAD                u_SchedHead;       /* Offset following the last dispatched read/write */
+    SBP2SchedEntry       u_SchedEntries[SBP2_SCHED_SLOTS];
+
+    /* Write-back stage: absorbed writes waiting in u_WBBuffer */
+    UBYTE *              u_WBBuffer;
+    ULONG                u_WBSize;          /* 0 = off */
+    ULONG                u_WBUsed;
+    ULONG                u_WBCount;
+    LONG                 u_WBError;         /* Lost flush error, given by the next write or CMD_UPDATE */
+    ULONG                u_WBRetries;       /* Failed flushes of the kept data */
+    struct timerequest * u_WBTimer;
+    SBP2WBExtent         u_WBExtents[SBP2_WB_EXTENTS];
+
+    /* Read-ahead cache: sequential reads are served from prefetched windows */
+    ULONG                u_RAMaxWindow;     /* 0 = off */
+    ULONG                u_RAWindow;
+    UQUAD                u_RANext;          /* Offset following the last read */
+    ULONG                u_RASeq;           /* Sequential reads in a row */
+    UQUAD                u_RAWant;          /* Prefetch to start after the dispatch, ~0 if none */
+    ULONG                u_RAHits;
+    ULONG                u_RAMisses;
+    ULONG                u_RAPrefetches;
+    struct MsgPort       u_RAPort;          /* Shares the u_QueuePort signal */
+    SBP2RASlot           u_RASlots[SBP2_RA_SLOTS];
+
+    /* Transfer size tuning */
+    ULONG                u_MaxTransfer;     /* Bytes per read/write command */
+    ULONG                u_MaxTransferLimit;
+    UBYTE                u_PayloadLimit;    /* Caps u_MaxPayload */
+    BOOL                 u_XferProbing;     /* u_MaxTransfer just doubled */
+    ULONG                u_XferRate;        /* bytes/ms before the last step up */
+    ULONG                u_XferCount;       /* Current measure window */
+    ULONG                u_XferBytes;
+    ULONG                u_XferTime;
+    struct timeval       u_XferLast;        /* Last queued completion */
+
     /* Unit specifics and SCSI cmds management data */
     STRPTR               u_UnitName;
     struct MsgPort *     u_OrbPort;
+    APTR                 u_SGPool;          /* Page tables over ORB_SG_PAGES entries */
     struct DriveGeometry u_Geometry;
     ULONG                u_BlockSize;
     UBYTE                u_BlockShift;
     UBYTE                u_Read10Cmd;
     BYTE                 u_ORBStatusSigBit;
     UBYTE                u_Reserved2;
-    UBYTE *              u_OneBlock;
+    UBYTE *              u_OneBlock;        /* Staging blocks for partial reads/writes */
     ULONG                u_OneBlockSize;
     UBYTE                u_ModePageBuf[256];
 
@@ -344,6 +513,10 @@ typedef struct SBP2Device
 
 extern void sbp2_cancel_orbs(SBP2Unit *unit);
 extern LONG sbp2_do_scsi_cmd(SBP2Unit *unit, struct SCSICmd *scsicmd, ULONG timeout);
+extern LONG sbp2_do_scsi_cmd_sg(SBP2Unit *unit, struct SCSICmd *scsicmd,
+                                const SBP2Segment *segs, ULONG nsegs, ULONG timeout);
+extern LONG sbp2_queue_scsi_cmd(SBP2Unit *unit, struct IOStdReq **ioreqs, ULONG count,
+                                const UBYTE *cdb, ULONG cdblen, UBYTE flags);
 extern void sbp2_unmount_all(SBP2Unit *unit);
 
 extern void sbp2_incref(SBP2Unit *unit);
@@ -109,6 +109,7 @@ struct Library* LIB_Init(SBP2ClassLib *base,
             {
                 LOCK_INIT(base);
                 NEWLIST(&base->hc_Units);
+                NEWLIST(&base->hc_XferInfos);
                 base->hc_MaxUnitNo = 0;
 
                 _INFO_LIB("Loading device %s into memory\n", DEVNAME);
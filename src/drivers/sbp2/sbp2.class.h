@@ -61,6 +61,7 @@ struct SBP2ClassLib
     struct HeliosClass *hc_HeliosClass;
     struct MinList      hc_Units;
     ULONG               hc_MaxUnitNo;
+    struct MinList      hc_XferInfos; /* SBP2XferInfo, freed with hc_MemPool */
 };
 
 #endif /* SPB2_CLASS_H */
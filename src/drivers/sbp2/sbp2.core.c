@@ -33,6 +33,9 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "sbp2.class.h"
 #include "sbp2.iocmd.h"
+#include "sbp2.sched.h"
+#include "sbp2.wback.h"
+#include "sbp2.rahead.h"
 #include "sbp2.device.h"
 
 #include <clib/macros.h>
@@ -45,6 +48,7 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #include <proto/dos.h>
 #include <proto/mount.h>
 #include <proto/exec.h>
+#include <proto/timer.h>
 
 #include <string.h>
 #include <stdlib.h>
@@ -88,6 +92,9 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define KEYTYPE_DIRECTORY   3
 
 
+/* Used when the hardware has no tracepoints ring, never enabled */
+static HeliosTraceRing sbp2_notrace;
+
 /*----------------------------------------------------------------------------*/
 /*--- LOCAL CODE SECTION -----------------------------------------------------*/
 
@@ -636,6 +643,8 @@ static HeliosResponse *sbp2_fs_reqhandler(HeliosAPacket *request, APTR udata)
         }
         UNLOCK_REGION(unit);
 
+        TRACE(unit->u_Trace, HTP_SBP2_STATUS, 0, ((QUADLET *)status)[0], orb_low);
+
         if (NULL != orbreq)
         {
             orbreq->or_ORBDone(base, orbreq, status);
@@ -655,6 +664,8 @@ static HeliosResponse *sbp2_fs_reqhandler(HeliosAPacket *request, APTR udata)
 }
 
 
+static void sbp2_queue_drain(SBP2Unit *unit);
+
 static void sbp2_complete_managment_orb(SBP2ClassLib *base, SBP2ORBRequest *orbreq, ORBStatus *status)
 {
     if (NULL != status)
@@ -670,6 +681,9 @@ static LONG sbp2_do_management_orb(SBP2Unit *unit, APTR orb)
     LONG err, ioerr, rcode;
     ULONG status_signal = 1ul << unit->u_ORBStatusSigBit;
 
+    /* Management ORBs are not ordered with queued commands */
+    sbp2_queue_drain(unit);
+
     bzero(&orbreq, sizeof(orbreq));
     orbreq.or_Base.iohhe_Req.iohh_Req.io_Message.mn_Length = sizeof(orbreq);
     orbreq.or_Base.iohhe_Req.iohh_Req.io_Message.mn_ReplyPort = unit->u_OrbPort;
@@ -737,12 +751,118 @@ static ULONG sbp2_sense_data_from_status(const UBYTE *status, UBYTE *sense_data)
     return status[0] & 0x3f;
 }
 
+/* Grow the page table of a request, tables over ORB_SG_PAGES entries come from u_SGPool */
+static BOOL sbp2_sg_grow(SBP2Unit *unit, SBP2SCSICmdReq *req)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    SBP2SGPage *table;
+    ULONG size;
+
+    if (req->sr_SGTableSize >= ORB_SG_MAX_PAGES)
+    {
+        return FALSE;
+    }
+
+    size = MIN(2 * req->sr_SGTableSize, ORB_SG_MAX_PAGES);
+    table = AllocPooledAligned(unit->u_SGPool, size * sizeof(SBP2SGPage), 8, 0);
+    if (NULL == table)
+    {
+        _ERR_SCSI("SCSI: failed to alloc a %lu entries page table\n", size);
+        return FALSE;
+    }
+
+    CopyMemQuick(req->sr_SGTable, table, req->sr_SGTableSize * sizeof(SBP2SGPage));
+    if (req->sr_SGTable != req->sr_SGPages)
+    {
+        FreePooled(unit->u_SGPool, req->sr_SGTable, req->sr_SGTableSize * sizeof(SBP2SGPage));
+    }
+
+    req->sr_SGTable = table;
+    req->sr_SGTableSize = size;
+
+    return TRUE;
+}
+
+/* Append page table entries for a physically contiguous area */
+static BOOL sbp2_sg_add_pages(SBP2Unit *unit, SBP2SCSICmdReq *req, ULONG *count, ULONG phy, ULONG length)
+{
+    ULONG i = *count;
+
+    while (0 != length)
+    {
+        ULONG len = MIN(ORB_PAGE_SIZE, length);
+
+        if ((i >= req->sr_SGTableSize) && !sbp2_sg_grow(unit, req))
+        {
+            return FALSE;
+        }
+
+        req->sr_SGTable[i].length_addr_hi = LE_SWAPWORD(len << 16);
+        req->sr_SGTable[i].addr_lo = LE_SWAPLONG(phy);
+
+        length -= len;
+        phy += len;
+        i++;
+    }
+
+    *count = i;
+    return TRUE;
+}
+
+/* End the DMA on the remains bytes from ptr */
+static void sbp2_dma_end(SBP2ClassLib *base, UBYTE *ptr, ULONG remains, ULONG flags)
+{
+    while (0 != remains)
+    {
+        ULONG len = remains;
+
+        CachePostDMA(ptr, &len, flags);
+        flags |= DMA_Continue;
+
+        len = MIN(MAX(len, 1), remains);
+        ptr += len;
+        remains -= len;
+    }
+}
+
+/* End the DMA on the segments walked by sbp2_scsi_setup() */
+static void sbp2_scsi_unmap(SBP2SCSICmdReq *req)
+{
+    SBP2ClassLib *base = req->sr_Unit->u_SBP2ClassBase;
+    ULONG i, dmaflags = (req->sr_Cmd->scsi_Flags & SCSIF_READ) ? 0 : DMA_ReadFromRAM;
+
+    for (i=0; i < req->sr_Mapped; i++)
+    {
+        sbp2_dma_end(base, req->sr_Segs[i].sg_Data, req->sr_Segs[i].sg_Length, dmaflags);
+    }
+
+    req->sr_Mapped = 0;
+}
+
+static void sbp2_free_scsi_req(SBP2Unit *unit, SBP2SCSICmdReq *req)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+
+    sbp2_scsi_unmap(req);
+
+    if (req->sr_SGTable != req->sr_SGPages)
+    {
+        FreePooled(unit->u_SGPool, req->sr_SGTable, req->sr_SGTableSize * sizeof(SBP2SGPage));
+    }
+
+    sbp2_free_orb_req(base, &req->sr_Base);
+}
+
 static BOOL sbp2_scsi_setup(SBP2Unit *unit, SBP2SCSICmdReq *req)
 {
     SBP2ClassLib *base = unit->u_SBP2ClassBase;
     struct SCSICmd *scsicmd = req->sr_Cmd;
     ORBSCSICommand *orb = &req->sr_ORB;
 
+    req->sr_SGTable = req->sr_SGPages;
+    req->sr_SGTableSize = ORB_SG_PAGES;
+    req->sr_Mapped = 0;
+
     orb->next.q = ORBPOINTER_NULL;
     orb->control = LE_SWAPLONG(ORBCONTROLPAYLOAD(unit->u_MaxPayload)
                                | ORBCONTROLSPEED(unit->u_MaxSpeed)
@@ -765,139 +885,796 @@ static BOOL sbp2_scsi_setup(SBP2Unit *unit, SBP2SCSICmdReq *req)
         scsicmd->scsi_CmdActual = scsicmd->scsi_CmdLength;
     }
 
-    if (NULL != scsicmd->scsi_Data)
-    {
-#ifdef ERROR_ON_BAD_ALIGNMENT
-        if (0 != ((ULONG)scsicmd->scsi_Data % 4))
+    /* A single buffer is a one segment list */
+    if ((NULL == req->sr_Segs) && (NULL != scsicmd->scsi_Data) && (0 != scsicmd->scsi_Length))
+    {
+        req->sr_DataSeg.sg_Data = scsicmd->scsi_Data;
+        req->sr_DataSeg.sg_Length = scsicmd->scsi_Length;
+        req->sr_Segs = &req->sr_DataSeg;
+        req->sr_SegCount = 1;
+    }
+
+    if (NULL != req->sr_Segs)
+    {
+        ULONG i, n=0, run_phy=0, run_len=0;
+        ULONG dmaflags = (scsicmd->scsi_Flags & SCSIF_READ) ? 0 : DMA_ReadFromRAM;
+
+        /* Buffers are virtually contiguous only: walk them page by page,
+         * merging physically adjacent pieces into the current run.
+         */
+        for (i=0; i < req->sr_SegCount; i++)
+        {
+            UBYTE *ptr = req->sr_Segs[i].sg_Data;
+            ULONG remains = req->sr_Segs[i].sg_Length;
+            ULONG flags = dmaflags;
+
+#ifdef ERROR_ON_BAD_ALIGNMENT
+            if (0 != ((ULONG)ptr % 4))
+            {
+                _ERR_SCSI("SCSI: data address not aligned on 4-bytes: %p\n", ptr);
+                sbp2_scsi_unmap(req);
+                return FALSE;
+            }
+#endif
+
+            while (0 != remains)
+            {
+                ULONG len = remains;
+                ULONG phy = (ULONG)CachePreDMA(ptr, &len, flags);
+
+                flags |= DMA_Continue;
+                len = MIN(MAX(len, 1), remains);
+
+                if ((0 != run_len) && (run_phy + run_len == phy))
+                {
+                    run_len += len;
+                }
+                else
+                {
+                    if (!sbp2_sg_add_pages(unit, req, &n, run_phy, run_len))
+                    {
+                        /* The current segment is mapped up to this piece included */
+                        sbp2_dma_end(base, req->sr_Segs[i].sg_Data,
+                                     ptr + len - (UBYTE *)req->sr_Segs[i].sg_Data, dmaflags);
+                        goto sg_error;
+                    }
+
+                    run_phy = phy;
+                    run_len = len;
+                }
+
+                ptr += len;
+                remains -= len;
+            }
+
+            req->sr_Mapped = i + 1;
+        }
+
+        orb->desc_hi = (ULONG)unit->u_NodeID << 16; /* local node id */
+
+        if (0 == n)
+        {
+            /* One physical area: direct addressing */
+            if (run_len <= 0xffff)
+            {
+                orb->desc_lo = run_phy;
+                orb->datalen = run_len;
+                goto done;
+            }
+        }
+
+        if (!sbp2_sg_add_pages(unit, req, &n, run_phy, run_len))
+        {
+            goto sg_error;
+        }
+
+        orb->desc_lo = utils_GetPhyAddress(req->sr_SGTable);
+        orb->datalen = LE_SWAPWORD(n);
+        orb->control |= LE_SWAPLONG_C(ORBCONTROLF_PAGETABLE | ORBCONTROLPAGESIZE(0));
+
+        /* Make sure that SG pages are in memory */
+        CacheFlushDataArea(req->sr_SGTable, sizeof(SBP2SGPage)*n);
+    }
+    else
+    {
+        orb->desc_hi = 0;
+        orb->desc_lo = 0;
+        orb->datalen = 0;
+    }
+
+done:
+    _INFO_ORB("ORB %p: Data phy addr %llx, len=%u\n", orb, ((UQUAD)orb->desc_hi << 32) + orb->desc_lo, orb->datalen);
+
+    return TRUE;
+
+sg_error:
+    _ERR_SCSI("SCSI: not enough SGPages for required data length: %lu\n",
+              scsicmd->scsi_Length);
+    sbp2_scsi_unmap(req);
+    return FALSE;
+}
+
+static void sbp2_complete_scsi_orb(SBP2ClassLib *base, SBP2ORBRequest *orbreq, ORBStatus *status)
+{
+    SBP2SCSICmdReq *req = (APTR)orbreq;
+    struct SCSICmd *cmd = req->sr_Cmd;
+    UBYTE scsi_status = 0;
+
+    if (NULL != status)
+    {
+        orbreq->or_ORBStatus.status = status->status;
+        log_DumpMem(status, (STATUS_GET_LEN(*status)+1)*sizeof(QUADLET), FALSE, "Status dump:\n");
+
+        if (STATUS_GET_DEAD(*status))
+        {
+            sbp2_agent_reset(req->sr_Unit);
+        }
+
+        switch (STATUS_GET_RESPONSE(*status))
+        {
+            case SBP2_STATUS_REQUEST_COMPLETE:
+                scsi_status = SCSI_GOOD;
+
+#if 1
+                /* Trash data cache of region written by the FW DMA */
+                if (NULL != req->sr_Segs)
+                {
+                    ULONG i;
+
+                    for (i=0; i < req->sr_SegCount; i++)
+                    {
+                        CacheTrashCacheArea(req->sr_Segs[i].sg_Data, req->sr_Segs[i].sg_Length);
+                    }
+                }
+                else if (NULL != cmd->scsi_Data)
+                {
+                    CacheTrashCacheArea(cmd->scsi_Data, cmd->scsi_Length);
+                }
+#endif
+                cmd->scsi_Actual = cmd->scsi_Length;
+
+                if (STATUS_GET_LEN(*status) > 1)
+                {
+                    if ((18 >= cmd->scsi_SenseLength) && (NULL != cmd->scsi_SenseData))
+                    {
+                        scsi_status = sbp2_sense_data_from_status(status->data, cmd->scsi_SenseData);
+                        cmd->scsi_SenseActual = 18;
+                        _INFO_SCSI("SCSI: sense data for SCSI cmd %p, status=%u\n", cmd, scsi_status);
+                    }
+                    else
+                    {
+                        scsi_status = status->data[0] & 0x3f;
+                        _WARN_SCSI("SCSI[$%02x] Failed: Status=%u, SenseData=[key=$%x, asc/ascq=$%02x/$%02x] (not forwared)\n",
+                                   cmd->scsi_Command[0], scsi_status,
+                                   (((status->data[1]&0xf0)<<1) + (status->data[1]&0x0f)) & SK_MASK,
+                                   status->data[2], status->data[3]);
+                    }
+                }
+                break;
+
+            case SBP2_STATUS_TRANSPORT_FAILURE:
+                _INFO_SCSI("SCSI: TRANSPORT_FAILURE\n");
+                scsi_status = HFERR_Phase;
+                break;
+
+            case SBP2_STATUS_ILLEGAL_REQUEST:
+            case SBP2_STATUS_VENDOR_DEPENDENT:
+                _INFO_SCSI("SCSI: ILLEGAL_REQUEST/VENDOR_DEPENDENT (%u)\n",
+                           STATUS_GET_RESPONSE(*status));
+                scsi_status = HFERR_Phase;
+                break;
+        }
+    }
+    else
+    {
+        /* The ORB has been cancelled (bus reset?) */
+        scsi_status = SCSI_TASK_ABORTED;
+    }
+
+    cmd->scsi_Status = scsi_status;
+}
+
+/*--- Transfer size tuning ---------------------------------------------------*/
+
+/* The max transfer per read/write command starts at SBP2_XFER_START and
+ * doubles after each window of SBP2_XFER_PROBE full size transfers, as long
+ * as the throughput doesn't fall. A slower window steps back and ends the
+ * probe. Transport errors and timeouts halve the size and set it as limit;
+ * at the minimal size they lower the max payload.
+ * The result is kept per GUID in the class base for the next logins.
+ */
+
+static void sbp2_get_time(SBP2Unit *unit, struct timeval *tv)
+{
+    struct Library *TimerBase = (struct Library *)unit->u_IOTimeReq->tr_node.io_Device;
+
+    GetSysTime(tv);
+}
+
+/* Saturated to ~0 from an hour, so an unset (zero) start doesn't wrap */
+static ULONG sbp2_diff_us(struct timeval *now, struct timeval *start)
+{
+    if ((now->tv_secs - start->tv_secs) >= 3600)
+    {
+        return ~0;
+    }
+
+    return (now->tv_secs - start->tv_secs) * 1000000 + now->tv_micro - start->tv_micro;
+}
+
+static ULONG sbp2_elapsed_us(SBP2Unit *unit, struct timeval *start)
+{
+    struct timeval now;
+
+    sbp2_get_time(unit, &now);
+    return sbp2_diff_us(&now, start);
+}
+
+/* Queued commands overlap: a command is timed from its queuing or from the
+ * previous completion, the latest one, so the times sum to the busy time.
+ */
+static ULONG sbp2_queued_us(SBP2Unit *unit, SBP2SCSICmdReq *req)
+{
+    struct timeval now;
+    ULONG us, since;
+
+    sbp2_get_time(unit, &now);
+    us = sbp2_diff_us(&now, &req->sr_Start);
+    since = sbp2_diff_us(&now, &unit->u_XferLast);
+    unit->u_XferLast = now;
+
+    return MIN(us, since);
+}
+
+static void sbp2_xfer_save(SBP2Unit *unit)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    SBP2XferInfo *info, *found = NULL;
+
+    LOCK_REGION(base);
+    {
+        ForeachNode(&base->hc_XferInfos, info)
+        {
+            if (info->xi_GUID == unit->u_GUID)
+            {
+                found = info;
+                break;
+            }
+        }
+
+        if (NULL == found)
+        {
+            found = AllocPooled(base->hc_MemPool, sizeof(*found));
+            if (NULL != found)
+            {
+                found->xi_GUID = unit->u_GUID;
+                ADDTAIL(&base->hc_XferInfos, found);
+            }
+        }
+
+        if (NULL != found)
+        {
+            found->xi_MaxTransfer = unit->u_MaxTransfer;
+            found->xi_MaxTransferLimit = unit->u_MaxTransferLimit;
+            found->xi_PayloadLimit = unit->u_PayloadLimit;
+        }
+    }
+    UNLOCK_REGION(base);
+
+    _INFO("GUID $%llx: max transfer %lu (limit %lu), payload limit %lu\n",
+          unit->u_GUID, unit->u_MaxTransfer, unit->u_MaxTransferLimit,
+          1ul << (unit->u_PayloadLimit+2));
+}
+
+static void sbp2_xfer_init(SBP2Unit *unit, ULONG fixed)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    SBP2XferInfo *info;
+
+    unit->u_MaxTransfer = SBP2_XFER_START;
+    unit->u_MaxTransferLimit = unit->u_Flags.MaxXfert128k ? (1ul<<17) : SBP2_XFER_MAX;
+    unit->u_PayloadLimit = SBP2_PAYLOAD_MAX;
+    unit->u_XferProbing = FALSE;
+    unit->u_XferRate = 0;
+    unit->u_XferCount = 0;
+    unit->u_XferBytes = 0;
+    unit->u_XferTime = 0;
+    unit->u_XferLast.tv_secs = 0;
+    unit->u_XferLast.tv_micro = 0;
+
+    if (0 != fixed)
+    {
+        /* Rounded to a power of 2, no tuning */
+        unit->u_MaxTransfer = SBP2_XFER_MIN;
+        while ((unit->u_MaxTransfer < SBP2_XFER_MAX) && ((unit->u_MaxTransfer << 1) <= fixed))
+        {
+            unit->u_MaxTransfer <<= 1;
+        }
+        unit->u_MaxTransferLimit = unit->u_MaxTransfer;
+        unit->u_Flags.FixedXfer = 1;
+        return;
+    }
+
+    LOCK_REGION_SHARED(base);
+    {
+        ForeachNode(&base->hc_XferInfos, info)
+        {
+            if (info->xi_GUID == unit->u_GUID)
+            {
+                unit->u_MaxTransfer = info->xi_MaxTransfer;
+                unit->u_MaxTransferLimit = info->xi_MaxTransferLimit;
+                unit->u_PayloadLimit = info->xi_PayloadLimit;
+                break;
+            }
+        }
+    }
+    UNLOCK_REGION(base);
+
+    unit->u_MaxTransfer = MIN(unit->u_MaxTransfer, unit->u_MaxTransferLimit);
+}
+
+/* Account a read/write command of length bytes, us = 0 if not timed (busy time if queued) */
+static void sbp2_xfer_done(SBP2Unit *unit, ULONG length, LONG err, ULONG us)
+{
+    ULONG rate;
+
+    if (unit->u_Flags.FixedXfer)
+    {
+        return;
+    }
+
+    if (err)
+    {
+        /* Only transport failures and timeouts, not medium errors or bus resets */
+        if (HFERR_Phase != err)
+        {
+            return;
+        }
+
+        if (length > SBP2_XFER_MIN)
+        {
+            while ((unit->u_MaxTransfer >= length) && (unit->u_MaxTransfer > SBP2_XFER_MIN))
+            {
+                unit->u_MaxTransfer >>= 1;
+            }
+            unit->u_MaxTransferLimit = unit->u_MaxTransfer;
+        }
+        else if (unit->u_PayloadLimit > SBP2_PAYLOAD_MIN)
+        {
+            unit->u_PayloadLimit--;
+            unit->u_MaxPayload = MIN(unit->u_MaxPayload, unit->u_PayloadLimit);
+        }
+        else
+        {
+            return;
+        }
+
+        _WARN("GUID $%llx: transfer error, max transfer now %lu, max payload %lu\n",
+              unit->u_GUID, unit->u_MaxTransfer, 1ul << (unit->u_MaxPayload+2));
+
+        unit->u_XferProbing = FALSE;
+        unit->u_XferCount = 0;
+        unit->u_XferBytes = 0;
+        unit->u_XferTime = 0;
+        sbp2_xfer_save(unit);
+        return;
+    }
+
+    /* Measure full size transfers only */
+    if ((length != unit->u_MaxTransfer) || (0 == us))
+    {
+        return;
+    }
+
+    unit->u_XferBytes += length;
+    unit->u_XferTime += us;
+    if (++unit->u_XferCount < SBP2_XFER_PROBE)
+    {
+        return;
+    }
+
+    rate = (ULONG)(((UQUAD)unit->u_XferBytes * 1000) / MAX(unit->u_XferTime, 1)); /* bytes/ms */
+    unit->u_XferCount = 0;
+    unit->u_XferBytes = 0;
+    unit->u_XferTime = 0;
+
+    if (unit->u_XferProbing && ((rate + rate/20) < unit->u_XferRate))
+    {
+        /* Bigger is slower: step back and stay there */
+        unit->u_MaxTransfer >>= 1;
+        unit->u_MaxTransferLimit = unit->u_MaxTransfer;
+        unit->u_XferProbing = FALSE;
+        sbp2_xfer_save(unit);
+    }
+    else if (unit->u_MaxTransfer < unit->u_MaxTransferLimit)
+    {
+        unit->u_XferRate = rate;
+        unit->u_MaxTransfer <<= 1;
+        unit->u_XferProbing = TRUE;
+        sbp2_xfer_save(unit);
+    }
+    else
+    {
+        unit->u_XferProbing = FALSE;
+    }
+}
+
+/*--- Command ORB queue ------------------------------------------------------*/
+
+/* Read/write commands given by sbp2_queue_scsi_cmd() are linked to the
+ * next_ORB field of the last queued ORB and the fetch agent is woken up
+ * by a DOORBELL write, so the target has several commands to fetch.
+ * Only the first ORB of an idle agent is written to ORB_POINTER.
+ * Status are matched by sbp2_fs_reqhandler() as for other ORBs; ioreqs are
+ * replied by the unit task.
+ * An ORB may carry several ioreqs merged by the scheduler: their buffers are
+ * the segments of one command and the transferred bytes are given back in order.
+ */
+
+#define QUEUE_SIGNAL(unit) (1ul << (unit)->u_QueuePort->mp_SigBit)
+
+static void sbp2_complete_queued_orb(SBP2ClassLib *base, SBP2ORBRequest *orbreq, ORBStatus *status)
+{
+    SBP2SCSICmdReq *req = (APTR)orbreq;
+    SBP2Unit *unit = req->sr_Unit;
+
+    /* Status are handled by the unit task, not in the request handler */
+    if (NULL != status)
+    {
+        CopyMem(status, &orbreq->or_ORBStatus,
+                MIN((STATUS_GET_LEN(*status)+1)*sizeof(QUADLET), sizeof(orbreq->or_ORBStatus)));
+    }
+    else
+    {
+        req->sr_Cancelled = TRUE;
+    }
+
+    LOCK_REGION(unit);
+    {
+        req->sr_Completed = TRUE;
+        ADDTAIL(&unit->u_ORBDoneList, &req->sr_DoneNode);
+    }
+    UNLOCK_REGION(unit);
+}
+
+static void sbp2_ring_doorbell(SBP2Unit *unit)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    IOHeliosHWSendRequest *ioreq = &unit->u_DoorbellReq;
+    HeliosAPacket *p;
+
+    /* One write in flight is enough: ring again when it returns */
+    if (unit->u_DoorbellBusy)
+    {
+        unit->u_DoorbellAgain = TRUE;
+        return;
+    }
+
+    Helios_InitIO(HGA_DEVICE, unit->u_HeliosDevice, &ioreq->iohhe_Req);
+    ioreq->iohhe_Req.iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
+    ioreq->iohhe_Req.iohh_Req.io_Message.mn_ReplyPort = unit->u_QueuePort;
+    ioreq->iohhe_Req.iohh_Req.io_Message.mn_Length = sizeof(*ioreq);
+    ioreq->iohhe_Req.iohh_Req.io_Command = HHIOCMD_SENDREQUEST;
+    ioreq->iohhe_Req.iohh_Data = NULL;
+    ioreq->iohhe_Device = unit->u_HeliosDevice;
+
+    p = &ioreq->iohhe_Transaction.htr_Packet;
+    Helios_FillWriteQuadletPacket(p, unit->u_MaxSpeed,
+                                  unit->u_ORBLoginResponse.command_agent + SBP2_DOORBELL,
+                                  0);
+
+    unit->u_DoorbellBusy = TRUE;
+    unit->u_DoorbellAgain = FALSE;
+    TRACE(unit->u_Trace, HTP_SBP2_DOORBELL, 0, unit->u_QueueCount, 0);
+    SendIO(&ioreq->iohhe_Req.iohh_Req);
+}
+
+static LONG sbp2_queue_transport_error(IOHeliosHWSendRequest *ioreq)
+{
+    LONG ioerr = ioreq->iohhe_Req.iohh_Req.io_Error;
+    LONG rcode = ioreq->iohhe_Transaction.htr_Packet.RCode;
+
+    if ((HHIOERR_NO_ERROR == ioerr) && (HELIOS_RCODE_COMPLETE == rcode))
+    {
+        return 0;
+    }
+
+    _ERR_ORB("Queue: transport error, ioerr=%ld, rcode=%ld\n", ioerr, rcode);
+
+    if ((HHIOERR_NO_ERROR == ioerr) && (HELIOS_RCODE_GENERATION == rcode))
+    {
+        return TDERR_PostReset;
+    }
+
+    return HFERR_Phase;
+}
+
+/* Get ORB_POINTER and DOORBELL writes replies, returns the first error */
+static LONG sbp2_queue_getmsgs(SBP2Unit *unit)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    IOHeliosHWSendRequest *ioreq;
+    LONG err = 0, ioerr;
+
+    while (NULL != (ioreq = (APTR)GetMsg(unit->u_QueuePort)))
+    {
+        ioerr = sbp2_queue_transport_error(ioreq);
+        if (!err)
+        {
+            err = ioerr;
+        }
+
+        if (ioreq == &unit->u_DoorbellReq)
+        {
+            unit->u_DoorbellBusy = FALSE;
+            if (unit->u_DoorbellAgain && !ioerr)
+            {
+                sbp2_ring_doorbell(unit);
+            }
+        }
+        else
+        {
+            ((SBP2SCSICmdReq *)ioreq)->sr_InFlight = FALSE;
+        }
+    }
+
+    return err;
+}
+
+static BOOL sbp2_queue_busy(SBP2Unit *unit)
+{
+    struct MinNode *node;
+
+    if ((unit->u_QueueCount > 0) || unit->u_DoorbellBusy)
+    {
+        return TRUE;
+    }
+
+    ForeachNode(&unit->u_ORBChain, node)
+    {
+        SBP2SCSICmdReq *req = (APTR)node - offsetof(SBP2SCSICmdReq, sr_ChainNode);
+
+        if (req->sr_InFlight)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Reply ioreqs of completed ORBs, returns TRUE if the queue must be aborted */
+static BOOL sbp2_queue_reply(SBP2Unit *unit)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    SBP2SCSICmdReq *req;
+    struct MinNode *node;
+    BOOL failed = FALSE;
+
+    for (;;)
+    {
+        struct SCSICmd *cmd;
+        ULONG i, actual;
+        LONG err;
+
+        LOCK_REGION(unit);
+        node = (APTR)REMHEAD(&unit->u_ORBDoneList);
+        UNLOCK_REGION(unit);
+
+        if (NULL == node)
+        {
+            break;
+        }
+
+        req = (APTR)node - offsetof(SBP2SCSICmdReq, sr_DoneNode);
+        cmd = req->sr_Cmd;
+
+        if (req->sr_Cancelled)
+        {
+            sbp2_complete_scsi_orb(base, &req->sr_Base, NULL);
+            err = unit->u_QueueError ? unit->u_QueueError : IOERR_ABORTED;
+            failed = TRUE;
+        }
+        else
+        {
+            /* Resets the agent if dead */
+            sbp2_complete_scsi_orb(base, &req->sr_Base, &req->sr_Base.or_ORBStatus);
+
+            if (SBP2_STATUS_REQUEST_COMPLETE != STATUS_GET_RESPONSE(req->sr_Base.or_ORBStatus))
+            {
+                _ERR_SCSI("SCSI[$%02x]: queued ORB status failure, response code is %x\n",
+                          cmd->scsi_Command[0], STATUS_GET_RESPONSE(req->sr_Base.or_ORBStatus));
+                err = HFERR_Phase;
+                failed = TRUE;
+            }
+            else if (SCSI_GOOD != cmd->scsi_Status)
+            {
+                _ERR_SCSI("SCSI[$%02x]: queued ORB bad status %u\n", cmd->scsi_Command[0], cmd->scsi_Status);
+                err = HFERR_BadStatus;
+            }
+            else
+            {
+                err = 0;
+            }
+
+            /* A dead agent has dropped the following ORBs */
+            if (STATUS_GET_DEAD(req->sr_Base.or_ORBStatus))
+            {
+                failed = TRUE;
+            }
+        }
+
+        TRACE(unit->u_Trace, HTP_SBP2_DONE, cmd->scsi_Command[0], err, cmd->scsi_Length);
+        sbp2_xfer_done(unit, cmd->scsi_Length, err, sbp2_queued_us(unit, req));
+        sbp2_scsi_unmap(req);
+
+        actual = err ? 0 : cmd->scsi_Actual;
+        for (i=0; i < req->sr_IOReqCount; i++)
+        {
+            struct IOStdReq *ioreq = req->sr_IOReqs[i];
+
+            ioreq->io_Error = err;
+            ioreq->io_Actual = MIN(actual, ioreq->io_Length);
+            actual -= ioreq->io_Actual;
+            ReplyMsg(&ioreq->io_Message);
+        }
+
+        req->sr_IOReqCount = 0;
+        unit->u_QueueCount--;
+        unit->u_QueueDone++;
+    }
+
+    return failed;
+}
+
+/* Free replied requests from the chain head.
+ * The agent may read the next_ORB field of a request until the next one
+ * is fetched, so a request is kept until its successor is completed.
+ * With all set, the queue must be idle and the whole chain is freed.
+ */
+static void sbp2_queue_release(SBP2Unit *unit, BOOL all)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    struct MinNode *node, *next;
+
+    ForeachNodeSafe(&unit->u_ORBChain, node, next)
+    {
+        SBP2SCSICmdReq *req = (APTR)node - offsetof(SBP2SCSICmdReq, sr_ChainNode);
+
+        if (!all)
+        {
+            SBP2SCSICmdReq *succ = (APTR)next - offsetof(SBP2SCSICmdReq, sr_ChainNode);
+
+            if ((0 != req->sr_IOReqCount) || req->sr_InFlight ||
+                (NULL == next->mln_Succ) || !succ->sr_Completed)
+            {
+                break;
+            }
+        }
+
+        LOCK_REGION(unit);
+        {
+            REMOVE(node);
+            if (req == unit->u_ORBTail)
+            {
+                unit->u_ORBTail = NULL;
+            }
+        }
+        UNLOCK_REGION(unit);
+
+        sbp2_free_scsi_req(unit, req);
+    }
+}
+
+/* Cancel all queued ORBs, their ioreqs are replied with the given error */
+static void sbp2_queue_abort(SBP2Unit *unit, LONG err)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    ULONG gen;
+
+    if (IsListEmpty((struct List *)&unit->u_ORBChain) && !unit->u_DoorbellBusy)
+    {
+        return;
+    }
+
+    _ERR_ORB("Queue: abort %lu ORB(s), err=%ld\n", unit->u_QueueCount, err);
+
+    unit->u_QueueError = err;
+    sbp2_cancel_orbs(unit);
+
+    if (unit->u_DoorbellBusy)
+    {
+        AbortIO(&unit->u_DoorbellReq.iohhe_Req.iohh_Req);
+    }
+
+    /* Transport requests are always replied */
+    for (;;)
+    {
+        struct MinNode *node;
+        BOOL inflight;
+
+        sbp2_queue_getmsgs(unit);
+
+        inflight = unit->u_DoorbellBusy;
+        ForeachNode(&unit->u_ORBChain, node)
         {
-            _ERR_SCSI("SCSI: data address not aligned on 4-bytes: %p\n",
-                      scsicmd->scsi_Data);
-            return FALSE;
-        }
-#endif
+            SBP2SCSICmdReq *req = (APTR)node - offsetof(SBP2SCSICmdReq, sr_ChainNode);
 
-        orb->desc_hi = (ULONG)unit->u_NodeID << 16; /* local node id */
+            inflight |= req->sr_InFlight;
+        }
 
-        if (scsicmd->scsi_Length <= 0xffff)
+        if (!inflight)
         {
-            orb->desc_lo = utils_GetPhyAddress(scsicmd->scsi_Data);
-            orb->datalen = scsicmd->scsi_Length;
+            break;
         }
-        else
-        {
-            ULONG i;
-            ULONG remains = scsicmd->scsi_Length;
-            ULONG phy = utils_GetPhyAddress(scsicmd->scsi_Data);
 
-            /* not enough SG pagse ?*/
-            if (remains > (ORB_PAGE_SIZE * ORB_SG_PAGES))
-            {
-                _ERR_SCSI("SCSI: not enough SGPages for required data length: %lu\n",
-                          scsicmd->scsi_Length);
-                return FALSE;
-            }
+        Wait(QUEUE_SIGNAL(unit));
+    }
+    unit->u_DoorbellAgain = FALSE;
 
-            /* Prepare ScatterGather pages (unrestricted pages) */
-            for (i=0; (i < ORB_SG_PAGES) && (0 != remains); i++)
-            {
-                ULONG len = MIN(ORB_PAGE_SIZE, remains);
+    sbp2_agent_reset(unit);
+    sbp2_queue_reply(unit);
+    sbp2_queue_release(unit, TRUE);
+    unit->u_QueueError = 0;
 
-                req->sr_SGPages[i].length_addr_hi = LE_SWAPWORD(len << 16);
-                req->sr_SGPages[i].addr_lo = LE_SWAPLONG(phy);
+    /* check if its not due to a bus-reset */
+    if ((1 == Helios_GetAttrs(HGA_DEVICE, unit->u_HeliosDevice,
+                              HA_Generation, (ULONG)&gen,
+                              TAG_DONE)) &&
+        (gen != unit->u_Generation))
+    {
+        LOCK_REGION(unit);
+        unit->u_Flags.Ready = 0;
+        UNLOCK_REGION(unit);
+    }
+}
 
-                remains -= len;
-                phy += len;
-            }
+static void sbp2_queue_process(SBP2Unit *unit)
+{
+    LONG err;
 
-            orb->desc_lo = utils_GetPhyAddress(req->sr_SGPages);
-            orb->datalen = LE_SWAPWORD(i);
-            orb->control |= LE_SWAPLONG_C(ORBCONTROLF_PAGETABLE | ORBCONTROLPAGESIZE(0));
+    err = sbp2_queue_getmsgs(unit);
+    if (sbp2_queue_reply(unit) && !err)
+    {
+        err = HFERR_Phase;
+    }
 
-            /* Make sure that SG pages are in memory */
-            CacheFlushDataArea(req->sr_SGPages, sizeof(SBP2SGPage)*i);
-        }
+    if (err)
+    {
+        sbp2_queue_abort(unit, err);
     }
     else
     {
-        orb->desc_hi = 0;
-        orb->desc_lo = 0;
-        orb->datalen = 0;
+        sbp2_queue_release(unit, FALSE);
     }
-
-    _INFO_ORB("ORB %p: Data phy addr %llx, len=%u\n", orb, ((UQUAD)orb->desc_hi << 32) + orb->desc_lo, orb->datalen);
-
-    return TRUE;
 }
 
-static void sbp2_complete_scsi_orb(SBP2ClassLib *base, SBP2ORBRequest *orbreq, ORBStatus *status)
+/* Wait for all queued commands, then the next ORB is given by ORB_POINTER */
+static void sbp2_queue_drain(SBP2Unit *unit)
 {
-    SBP2SCSICmdReq *req = (APTR)orbreq;
-    struct SCSICmd *cmd = req->sr_Cmd;
-    UBYTE scsi_status = 0;
-
-    if (NULL != status)
+    if (NULL == unit->u_QueuePort)
     {
-        orbreq->or_ORBStatus.status = status->status;
-        log_DumpMem(status, (STATUS_GET_LEN(*status)+1)*sizeof(QUADLET), FALSE, "Status dump:\n");
+        return;
+    }
 
-        if (STATUS_GET_DEAD(*status))
+    for (;;)
+    {
+        sbp2_queue_process(unit);
+        sbp2_ra_process(unit);
+        if (!sbp2_queue_busy(unit))
         {
-            sbp2_agent_reset(req->sr_Unit);
+            break;
         }
 
-        switch (STATUS_GET_RESPONSE(*status))
+        if (HERR_TIMEOUT == sbp2_wait(unit, QUEUE_SIGNAL(unit), ORB_TIMEOUT))
         {
-            case SBP2_STATUS_REQUEST_COMPLETE:
-                scsi_status = SCSI_GOOD;
-
-#if 1
-                /* Trash data cache of region written by the FW DMA */
-                if (NULL != cmd->scsi_Data)
-                {
-                    CacheTrashCacheArea(cmd->scsi_Data, cmd->scsi_Length);
-                }
-#endif
-                cmd->scsi_Actual = cmd->scsi_Length;
-
-                if (STATUS_GET_LEN(*status) > 1)
-                {
-                    if ((18 >= cmd->scsi_SenseLength) && (NULL != cmd->scsi_SenseData))
-                    {
-                        scsi_status = sbp2_sense_data_from_status(status->data, cmd->scsi_SenseData);
-                        cmd->scsi_SenseActual = 18;
-                        _INFO_SCSI("SCSI: sense data for SCSI cmd %p, status=%u\n", cmd, scsi_status);
-                    }
-                    else
-                    {
-                        scsi_status = status->data[0] & 0x3f;
-                        _WARN_SCSI("SCSI[$%02x] Failed: Status=%u, SenseData=[key=$%x, asc/ascq=$%02x/$%02x] (not forwared)\n",
-                                   cmd->scsi_Command[0], scsi_status,
-                                   (((status->data[1]&0xf0)<<1) + (status->data[1]&0x0f)) & SK_MASK,
-                                   status->data[2], status->data[3]);
-                    }
-                }
-                break;
-
-            case SBP2_STATUS_TRANSPORT_FAILURE:
-                _INFO_SCSI("SCSI: TRANSPORT_FAILURE\n");
-                scsi_status = HFERR_Phase;
-                break;
-
-            case SBP2_STATUS_ILLEGAL_REQUEST:
-            case SBP2_STATUS_VENDOR_DEPENDENT:
-                _INFO_SCSI("SCSI: ILLEGAL_REQUEST/VENDOR_DEPENDENT (%u)\n",
-                           STATUS_GET_RESPONSE(*status));
-                scsi_status = HFERR_Phase;
-                break;
+            _ERR_ORB("Queue: status timeout, %lu ORB(s) pending\n", unit->u_QueueCount);
+            sbp2_queue_abort(unit, HFERR_Phase);
+            break;
         }
     }
-    else
-    {
-        /* The ORB has been cancelled (bus reset?) */
-        scsi_status = SCSI_TASK_ABORTED;
-    }
 
-    cmd->scsi_Status = scsi_status;
+    sbp2_queue_release(unit, TRUE);
 }
 
 LONG sbp2_scsi_test_unit_ready(SBP2Unit *unit, UBYTE *sensedata)
@@ -1488,6 +2265,10 @@ static void sbp2_on_medium_changed(SBP2Unit *unit)
     ready = unit->u_Flags.Ready;
     UNLOCK_REGION(unit);
 
+    /* Dirty data and read-ahead windows were for the previous medium */
+    sbp2_wb_discard(unit);
+    sbp2_ra_invalidate(unit);
+
     if (ready)
     {
         struct IOStdReq ioreq;
@@ -1543,6 +2324,11 @@ static BOOL sbp2_update(SBP2Unit *unit)
     unit->u_Flags.Ready = 0;
     UNLOCK_REGION(unit);
 
+    /* Queued ORBs are lost with the login */
+    sbp2_queue_abort(unit, TDERR_PostReset);
+    sbp2_ra_invalidate(unit);
+    sbp2_ra_process(unit);
+
     /* Get info on local node */
     res = Helios_GetAttrs(HGA_HARDWARE, unit->u_HeliosHW,
                           HA_NodeID, (ULONG)&nodeid,
@@ -1578,6 +2364,9 @@ static BOOL sbp2_update(SBP2Unit *unit)
          */
         unit->u_MaxPayload = MIN(nodeinfo.n_MaxSpeed + 7, 12u);
 
+        /* Lowered after transfer errors at the minimal transfer size */
+        unit->u_MaxPayload = MIN(unit->u_MaxPayload, unit->u_PayloadLimit);
+
         _INFO("MaxSpeed: %u, MaxPayload: %lu\n", unit->u_MaxSpeed, 1ul << (unit->u_MaxPayload+2));
 
         if (unit->u_Flags.Logged)
@@ -1676,6 +2465,16 @@ static void sbp2_handle_ioreq(SBP2Unit *unit, struct IOStdReq *ioreq)
             sbp2_iocmd_get_geometry(unit, ioreq);
             break;
 
+        /* Write-back data have been written by sbp2_wb_dispatch(), a kept
+         * flush error replies the ioreq there.
+         */
+        case CMD_UPDATE:
+        case TD_MOTOR:
+            ioreq->io_Error = unit->u_WBError;
+            ioreq->io_Actual = 0;
+            unit->u_WBError = 0;
+            break;
+
         case CMD_START:
         case CMD_STOP:
         case TD_EJECT:
@@ -1710,6 +2509,15 @@ static void sbp2_handle_ioreq(SBP2Unit *unit, struct IOStdReq *ioreq)
     ReplyMsg(&ioreq->io_Message);
 }
 
+/* IO scheduler policy from the env var, read again at each device update */
+static void sbp2_select_scheduler(SBP2Unit *unit)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    char buf[16];
+
+    sbp2_sched_init(unit, (GetVar("helios_sbp2_scheduler", buf, sizeof(buf), 0) > 0) ? buf : NULL);
+}
+
 static void sbp2_handle_removable(SBP2Unit *unit)
 {
     SBP2ClassLib *base = unit->u_SBP2ClassBase;
@@ -1765,7 +2573,7 @@ static void sbp2_handle_removable(SBP2Unit *unit)
 static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
 {
     HeliosDevice *dev = unit->u_HeliosDevice;
-    ULONG sigs, gen=0, ioreq_signal, timer_signal;
+    ULONG sigs, gen=0, ioreq_signal, timer_signal, queue_signal;
     BOOL run=TRUE;
     HeliosEventListenerList *dev_ell=NULL, *hw_ell=NULL;
     HeliosEventMsg sbp2_dev_listener;
@@ -1803,8 +2611,44 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
         }
 
         _INFO("Auto-Reconnect=%lu\n", unit->u_AutoReconnect);
+
+        unit->u_QueueDepth = SBP2_QUEUE_DEPTH;
+
+        if ((GetVar("helios_sbp2_queuedepth", buf, sizeof(buf), 0) > 0) &&
+            (StrToLong(buf, &value) > 0))
+        {
+            unit->u_QueueDepth = MIN(MAX(value, 0), SBP2_QUEUE_DEPTH_MAX);
+        }
+
+        _INFO("ORB queue depth=%lu\n", unit->u_QueueDepth);
+
+        /* Tuned per GUID unless fixed */
+        value = 0;
+        if (GetVar("helios_sbp2_maxtransfer", buf, sizeof(buf), 0) > 0)
+        {
+            StrToLong(buf, &value);
+        }
+        sbp2_xfer_init(unit, MAX(value, 0));
+
+        /* Write-back buffer in KB, off by default */
+        value = 0;
+        if (GetVar("helios_sbp2_writeback", buf, sizeof(buf), 0) > 0)
+        {
+            StrToLong(buf, &value);
+        }
+        sbp2_wb_init(unit, MIN(MAX(value, 0), SBP2_WB_MAX) * 1024);
+
+        /* Read-ahead max window in KB, off by default */
+        value = 0;
+        if (GetVar("helios_sbp2_readahead", buf, sizeof(buf), 0) > 0)
+        {
+            StrToLong(buf, &value);
+        }
+        unit->u_RAMaxWindow = MIN(MAX(value, 0), SBP2_RA_MAX) * 1024;
     }
 
+    sbp2_select_scheduler(unit);
+
     /* For the mount.library */
     unit->u_NotifyUnit = MountCreateNotifyUnitTags(MOUNTATTR_DEVICE, (ULONG)base->hc_DevBase,
                                                    MOUNTATTR_UNIT, (ULONG)&unit->u_SysUnit,
@@ -1848,18 +2692,24 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
     evt_port = CreateMsgPort();
     unit->u_TimerPort = CreateMsgPort();
     unit->u_OrbPort = CreateMsgPort();
+    unit->u_QueuePort = CreateMsgPort();
+    unit->u_SGPool = CreatePool(MEMF_PUBLIC, 16384, 4096);
     unit->u_ORBStatusSigBit = AllocSignal(-1);
     io_sigbit = AllocSignal(-1);
 
     if ((NULL == evt_port) ||
         (NULL == unit->u_TimerPort) ||
         (NULL == unit->u_OrbPort) ||
+        (NULL == unit->u_QueuePort) ||
+        (NULL == unit->u_SGPool) ||
         (-1 == unit->u_ORBStatusSigBit) ||
         (-1 == io_sigbit))
     {
         goto release_unit;
     }
 
+    sbp2_ra_init(unit);
+
     unit->u_IOTimeReq = Helios_OpenTimer(unit->u_TimerPort, UNIT_VBLANK);
     if (NULL == unit->u_IOTimeReq)
     {
@@ -1883,9 +2733,15 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
     }
 
     hw_ell = NULL;
+    unit->u_Trace = NULL;
     Helios_GetAttrs(HGA_HARDWARE, unit->u_HeliosHW,
                     HA_EventListenerList, (ULONG)&hw_ell,
+                    HHA_TraceRing, (ULONG)&unit->u_Trace,
                     TAG_DONE);
+    if (NULL == unit->u_Trace)
+    {
+        unit->u_Trace = &sbp2_notrace;
+    }
     if (NULL == hw_ell)
     {
         _ERR("SBP2 unit %p, failed to obtain HW data\n", unit);
@@ -1936,14 +2792,14 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
     /* Registers hardware events */
     sbp2_hw_listener.hm_Msg.mn_ReplyPort = evt_port;
     sbp2_hw_listener.hm_Msg.mn_Length = sizeof(sbp2_hw_listener);
-    sbp2_hw_listener.hm_Type = HELIOS_MSGTYPE_EVENT;
+    sbp2_hw_listener.hm_Type = HELIOS_MSGTYPE_POOLED_EVENT;
     sbp2_hw_listener.hm_EventMask = HEVTF_HARDWARE_BUSRESET;
     Helios_AddEventListener(hw_ell, &sbp2_hw_listener);
 
     /* Registers device events */
     sbp2_dev_listener.hm_Msg.mn_ReplyPort = evt_port;
     sbp2_dev_listener.hm_Msg.mn_Length = sizeof(sbp2_dev_listener);
-    sbp2_dev_listener.hm_Type = HELIOS_MSGTYPE_EVENT;
+    sbp2_dev_listener.hm_Type = HELIOS_MSGTYPE_POOLED_EVENT;
     sbp2_dev_listener.hm_EventMask = HEVTF_DEVICE_NEW_UNIT
                                      | HEVTF_DEVICE_DEAD
                                      | HEVTF_DEVICE_REMOVED
@@ -1962,6 +2818,7 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
 
     ioreq_signal = 1ul << io_sigbit;
     timer_signal = 1ul << unit->u_TimerPort->mp_SigBit;
+    queue_signal = QUEUE_SIGNAL(unit);
 
     /* Login and target initialization */
     if (!sbp2_update(unit))
@@ -1983,7 +2840,27 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
             reconnect_tr = sbp2_add_timereq(unit, unit->u_AutoReconnect);
         }
 
-        sigs = Wait(SIGBREAKF_CTRL_C | (1ul << evt_port->mp_SigBit) | timer_signal | ioreq_signal);
+        /* Status timeout of queued ORBs: no progress during a whole period */
+        if ((unit->u_QueueCount > 0) && (NULL == unit->u_QueueTimer))
+        {
+            unit->u_QueueMark = unit->u_QueueDone;
+            unit->u_QueueTimer = sbp2_add_timereq(unit, ORB_TIMEOUT);
+        }
+
+        /* Dirty write-back data are written after a delay */
+        if ((unit->u_WBCount > 0) && (NULL == unit->u_WBTimer))
+        {
+            unit->u_WBTimer = sbp2_add_timereq(unit, SBP2_WB_DELAY);
+        }
+
+        sigs = Wait(SIGBREAKF_CTRL_C | (1ul << evt_port->mp_SigBit) | timer_signal | ioreq_signal | queue_signal);
+
+        /* Reply completed queued ioreqs */
+        if (sigs & queue_signal)
+        {
+            sbp2_queue_process(unit);
+            sbp2_ra_process(unit);
+        }
 
         /* exit? */
         if (sigs & SIGBREAKF_CTRL_C)
@@ -2030,10 +2907,9 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
                                     update = TRUE;
                                     break;
                             }
-                            break;
                         }
 
-                        FreeMem(evt, evt->hm_Msg.mn_Length);
+                        Helios_FreeEvent(evt);
                         break;
 
                     default:
@@ -2043,22 +2919,56 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
 
             if (run & update)
             {
+                sbp2_select_scheduler(unit);
                 sbp2_update(unit);
             }
         }
 
         /* Device IO requests */
-        if (run && ((sigs & ioreq_signal) || (unit->u_Flags.ProcessIO)))
+        if (run && ((sigs & (ioreq_signal | queue_signal)) || (unit->u_Flags.ProcessIO)))
         {
-            struct IOStdReq *ioreq;
+            struct IOStdReq *ioreq, *group[SBP2_SCHED_MERGE];
+            ULONG i, count;
 
             /* do not process io until reconnect */
             if (unit->u_Flags.AcceptIO)
             {
                 unit->u_Flags.ProcessIO = 0;
-                while (NULL != (ioreq = (struct IOStdReq *)GetMsg(&unit->u_SysUnit.unit_MsgPort)))
+                for (;;)
                 {
-                    sbp2_handle_ioreq(unit, ioreq);
+                    /* Sort what is waiting before each dispatch */
+                    while (!sbp2_sched_full(unit) &&
+                           (NULL != (ioreq = (struct IOStdReq *)GetMsg(&unit->u_SysUnit.unit_MsgPort))))
+                    {
+                        sbp2_sched_add(unit, ioreq);
+                    }
+
+                    /* Full queue: next ioreqs wait for a completion */
+                    if ((unit->u_QueueDepth > 0) && (unit->u_QueueCount >= unit->u_QueueDepth))
+                    {
+                        break;
+                    }
+
+                    count = sbp2_sched_next(unit, group);
+                    if (0 == count)
+                    {
+                        break;
+                    }
+
+                    /* Read/write are queued, others wait for the queue end */
+                    if (!sbp2_ra_dispatch(unit, group, count) &&
+                        !sbp2_wb_dispatch(unit, group, count) &&
+                        !sbp2_iocmd_queue(unit, group, count))
+                    {
+                        for (i=0; i < count; i++)
+                        {
+                            sbp2_handle_ioreq(unit, group[i]);
+                        }
+                    }
+
+                    /* Queued behind the read that asked it */
+                    sbp2_ra_prefetch(unit);
+
                     if (!unit->u_Flags.AcceptIO)
                     {
                         unit->u_Flags.ProcessIO = 1;
@@ -2095,6 +3005,24 @@ static void sbp2_driver_task(SBP2ClassLib *base, SBP2Unit *unit)
                     }
                     reconnect_tr = NULL;
                 }
+                else if (tr == unit->u_QueueTimer)
+                {
+                    if ((unit->u_QueueCount > 0) && (unit->u_QueueMark == unit->u_QueueDone))
+                    {
+                        _ERR_ORB("Queue: status timeout, %lu ORB(s) pending\n", unit->u_QueueCount);
+                        sbp2_queue_abort(unit, HFERR_Phase);
+                    }
+                    unit->u_QueueTimer = NULL;
+                }
+                else if (tr == unit->u_WBTimer)
+                {
+                    /* Kept until reconnect */
+                    if (run && unit->u_Flags.AcceptIO && unit->u_Flags.Ready)
+                    {
+                        sbp2_wb_flush(unit);
+                    }
+                    unit->u_WBTimer = NULL;
+                }
 
                 sbp2_free_timereq(unit, tr);
             }
@@ -2118,8 +3046,35 @@ release_unit:
     sbp2_unmount_all(unit);
 
     /* Flush and abort pending device IO requests */
+    if (NULL != unit->u_QueuePort)
+    {
+        sbp2_queue_abort(unit, IOERR_ABORTED);
+    }
+    sbp2_sched_flush(unit, IOERR_ABORTED);
+    sbp2_ra_cleanup(unit);
     sbp2_flush_io(unit);
 
+    /* Still logged if the binding is released with the target on the bus
+     * (class expunge, ROM change): last chance for dirty write-back data.
+     * Not after a bus reset or the device death, the login is lost.
+     */
+    if (unit->u_Flags.Logged)
+    {
+        if ((1 == Helios_GetAttrs(HGA_DEVICE, dev,
+                                  HA_Generation, (ULONG)&gen,
+                                  TAG_DONE)) &&
+            (gen == unit->u_Generation))
+        {
+            sbp2_wb_flush(unit);
+        }
+        else
+        {
+            LOCK_REGION(unit);
+            unit->u_Flags.Logged = 0;
+            UNLOCK_REGION(unit);
+        }
+    }
+
     LOCK_REGION(unit);
     {
         /* see the note in sbp2_decref() */
@@ -2167,7 +3122,7 @@ release_unit:
         switch (evt->hm_Type)
         {
             case HELIOS_MSGTYPE_EVENT:
-                FreeMem(evt, evt->hm_Msg.mn_Length);
+                Helios_FreeEvent(evt);
                 break;
         }
     }
@@ -2181,6 +3136,7 @@ release_unit:
     unit->u_HeliosUnit = NULL;
     unit->u_HeliosDevice = NULL;
     unit->u_HeliosHW = NULL;
+    unit->u_Trace = &sbp2_notrace;
 
     /* Abort periodic timers */
     if ((NULL != removable_tr) && !CheckIO(&removable_tr->tr_node))
@@ -2193,8 +3149,19 @@ release_unit:
         AbortIO(&reconnect_tr->tr_node);
     }
 
+    if ((NULL != unit->u_QueueTimer) && !CheckIO(&unit->u_QueueTimer->tr_node))
+    {
+        AbortIO(&unit->u_QueueTimer->tr_node);
+    }
+
+    if ((NULL != unit->u_WBTimer) && !CheckIO(&unit->u_WBTimer->tr_node))
+    {
+        AbortIO(&unit->u_WBTimer->tr_node);
+    }
+
     /* Proper timer device flush */
-    while ((NULL != removable_tr) || (NULL != reconnect_tr))
+    while ((NULL != removable_tr) || (NULL != reconnect_tr) ||
+           (NULL != unit->u_QueueTimer) || (NULL != unit->u_WBTimer))
     {
         struct timerequest *tr;
 
@@ -2210,6 +3177,16 @@ release_unit:
                 reconnect_tr = NULL;
             }
 
+            if (tr == unit->u_QueueTimer)
+            {
+                unit->u_QueueTimer = NULL;
+            }
+
+            if (tr == unit->u_WBTimer)
+            {
+                unit->u_WBTimer = NULL;
+            }
+
             sbp2_free_timereq(unit, tr);
         }
     }
@@ -2230,6 +3207,14 @@ release_unit:
     {
         DeleteMsgPort(unit->u_OrbPort);
     }
+    if (NULL != unit->u_QueuePort)
+    {
+        DeleteMsgPort(unit->u_QueuePort);
+    }
+    if (NULL != unit->u_SGPool)
+    {
+        DeletePool(unit->u_SGPool);
+    }
     if (NULL != evt_port)
     {
         DeleteMsgPort(evt_port);
@@ -2246,6 +3231,7 @@ release_unit:
     {
         FreePooled(base->hc_MemPool, unit->u_OneBlock, unit->u_OneBlockSize);
     }
+    sbp2_wb_cleanup(unit);
 
     task_name = unit->u_TaskName;
 
@@ -2303,15 +3289,37 @@ void sbp2_cancel_orbs(SBP2Unit *unit)
 }
 
 LONG sbp2_do_scsi_cmd(SBP2Unit *unit, struct SCSICmd *scsicmd, ULONG timeout)
+{
+    return sbp2_do_scsi_cmd_sg(unit, scsicmd, NULL, 0, timeout);
+}
+
+/* Same as sbp2_do_scsi_cmd(), but data are transfered from/to the given
+ * segments in place of scsi_Data. scsi_Length is the total length.
+ */
+LONG sbp2_do_scsi_cmd_sg(SBP2Unit *unit, struct SCSICmd *scsicmd,
+                         const SBP2Segment *segs, ULONG nsegs, ULONG timeout)
 {
     SBP2ClassLib *base = unit->u_SBP2ClassBase;
     SBP2SCSICmdReq *req;
     LONG ioerr, rcode, retry;
     ULONG status_signal = 1ul << unit->u_ORBStatusSigBit;
+    struct timeval start;
+    BOOL xfer;
 
     scsicmd->scsi_Actual = 0;
     scsicmd->scsi_SenseActual = 0;
 
+    /* The command is given by ORB_POINTER, the agent must be idle */
+    sbp2_queue_drain(unit);
+
+    xfer = (10 == scsicmd->scsi_CmdLength) &&
+           ((SCSI_DA_READ_10 == scsicmd->scsi_Command[0]) ||
+            (SCSI_DA_WRITE_10 == scsicmd->scsi_Command[0]));
+    if (xfer)
+    {
+        sbp2_get_time(unit, &start);
+    }
+
     req = (SBP2SCSICmdReq *) sbp2_alloc_orb_req(unit->u_SBP2ClassBase, sizeof(SBP2SCSICmdReq));
     if (NULL == req)
     {
@@ -2322,6 +3330,8 @@ LONG sbp2_do_scsi_cmd(SBP2Unit *unit, struct SCSICmd *scsicmd, ULONG timeout)
     req->sr_Base.or_Base.iohhe_Req.iohh_Req.io_Message.mn_ReplyPort = unit->u_OrbPort;
     req->sr_Cmd = scsicmd;
     req->sr_Unit = unit;
+    req->sr_Segs = segs;
+    req->sr_SegCount = nsegs;
 
     /* Finish the request initialization */
     if (!sbp2_scsi_setup(unit, req))
@@ -2437,7 +3447,12 @@ transport_error:
 out:
     if (NULL != req)
     {
-        sbp2_free_orb_req(unit->u_SBP2ClassBase, &req->sr_Base);
+        sbp2_free_scsi_req(unit, req);
+    }
+
+    if (xfer)
+    {
+        sbp2_xfer_done(unit, scsicmd->scsi_Length, ioerr, sbp2_elapsed_us(unit, &start));
     }
 
     /* in case of error, check if its not due to a bus-reset */
@@ -2459,6 +3474,119 @@ out:
     return ioerr;
 }
 
+LONG sbp2_queue_scsi_cmd(SBP2Unit *unit, struct IOStdReq **ioreqs, ULONG count,
+                         const UBYTE *cdb, ULONG cdblen, UBYTE flags)
+{
+    SBP2ClassLib *base = unit->u_SBP2ClassBase;
+    SBP2SCSICmdReq *req, *tail;
+    struct SCSICmd *scsicmd;
+    ULONG i, length=0;
+
+    if ((0 == count) || (count > SBP2_SCHED_MERGE))
+    {
+        return IOERR_BADLENGTH;
+    }
+
+    req = (SBP2SCSICmdReq *) sbp2_alloc_orb_req(base, sizeof(SBP2SCSICmdReq));
+    if (NULL == req)
+    {
+        return IOERR_NOMEMORY;
+    }
+
+    /* The SCSI command lives in the request, the ioreq is replied at completion */
+    scsicmd = &req->sr_SCSICmd;
+    bzero(scsicmd, sizeof(*scsicmd));
+    CopyMem((APTR)cdb, req->sr_CDB, MIN(cdblen, sizeof(req->sr_CDB)));
+    for (i=0; i < count; i++)
+    {
+        req->sr_IOReqs[i] = ioreqs[i];
+        req->sr_MergeSegs[i].sg_Data = ioreqs[i]->io_Data;
+        req->sr_MergeSegs[i].sg_Length = ioreqs[i]->io_Length;
+        length += ioreqs[i]->io_Length;
+    }
+    req->sr_IOReqCount = count;
+
+    scsicmd->scsi_Data = ioreqs[0]->io_Data;
+    scsicmd->scsi_Length = length;
+    scsicmd->scsi_Command = req->sr_CDB;
+    scsicmd->scsi_CmdLength = MIN(cdblen, sizeof(req->sr_CDB));
+    scsicmd->scsi_Flags = flags | SCSIF_AUTOSENSE;
+    scsicmd->scsi_SenseData = req->sr_Sense;
+    scsicmd->scsi_SenseLength = 18;
+
+    req->sr_Cmd = scsicmd;
+    req->sr_Unit = unit;
+    req->sr_Segs = (count > 1) ? req->sr_MergeSegs : NULL;
+    req->sr_SegCount = count;
+    req->sr_Completed = FALSE;
+    req->sr_Cancelled = FALSE;
+    req->sr_InFlight = FALSE;
+    sbp2_get_time(unit, &req->sr_Start);
+
+    if (!sbp2_scsi_setup(unit, req))
+    {
+        sbp2_free_scsi_req(unit, req);
+        return HFERR_Phase;
+    }
+
+    /* Linked ORBs are never sent: CheckIO() is TRUE for sbp2_cancel_orbs() */
+    req->sr_Base.or_Base.iohhe_Req.iohh_Req.io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+    req->sr_Base.or_Base.iohhe_Req.iohh_Req.io_Message.mn_ReplyPort = unit->u_QueuePort;
+    req->sr_Base.or_ORBAddr.addr.hi = 0;
+    req->sr_Base.or_ORBAddr.addr.lo = LE_SWAPLONG(utils_GetPhyAddress(&req->sr_ORB));
+    req->sr_Base.or_ORBDone = sbp2_complete_queued_orb;
+    req->sr_Base.or_ORBStTask = FindTask(NULL);
+    req->sr_Base.or_ORBStSignal = QUEUE_SIGNAL(unit);
+
+    /* Make sure that the ORB is in memory before the agent fetches it */
+    CacheFlushDataArea(&req->sr_ORB, sizeof(req->sr_ORB));
+
+    /* Only the linking is done under the lock, as sbp2_complete_queued_orb()
+     * takes it from the request handler: the transport writes are sent after.
+     */
+    LOCK_REGION(unit);
+    {
+        tail = unit->u_ORBTail;
+        unit->u_ORBTail = req;
+        unit->u_QueueCount++;
+
+        ADDTAIL(&unit->u_PendingORBList, &req->sr_Base.or_Node);
+        ADDTAIL(&unit->u_ORBChain, &req->sr_ChainNode);
+
+        if (NULL == tail)
+        {
+            req->sr_InFlight = TRUE;
+        }
+        else
+        {
+            /* Fetched after the tail, or at the doorbell if the agent is suspended */
+            tail->sr_ORB.next.addr.lo = req->sr_Base.or_ORBAddr.addr.lo;
+            tail->sr_ORB.next.addr.hi = 0;
+            CacheFlushDataArea(&tail->sr_ORB.next, sizeof(tail->sr_ORB.next));
+        }
+    }
+    UNLOCK_REGION(unit);
+
+    TRACE(unit->u_Trace, HTP_SBP2_QUEUE, req->sr_CDB[0], req->sr_Base.or_ORBAddr.addr.lo, length);
+
+    if (NULL == tail)
+    {
+        /* Idle agent */
+        _INFO_ORB("Queue: ORB req %p to ORB_POINTER\n", req);
+        sbp2_send_write_block(base, unit->u_HeliosDevice, &req->sr_Base.or_Base,
+                              &req->sr_Base.or_ORBAddr, 8,
+                              unit->u_ORBLoginResponse.command_agent + SBP2_ORB_POINTER,
+                              unit->u_MaxSpeed);
+    }
+    else
+    {
+        _INFO_ORB("Queue: ORB req %p linked after %p\n", req, tail);
+        sbp2_ring_doorbell(unit);
+    }
+
+    return 0;
+}
+
 void sbp2_unmount_all(SBP2Unit *unit)
 {
     SBP2ClassLib *base = unit->u_SBP2ClassBase;
@@ -2597,6 +3725,8 @@ LONG sbp2_ForceUnitBinding(SBP2ClassLib *base, HeliosUnit *unit)
             LOCK_INIT(sbp2_unit);
             NEWLIST(&sbp2_unit->u_SysUnit.unit_MsgPort.mp_MsgList); /* used to forward IO msg */
             NEWLIST(&sbp2_unit->u_PendingORBList);
+            NEWLIST(&sbp2_unit->u_ORBChain);
+            NEWLIST(&sbp2_unit->u_ORBDoneList);
 
             sbp2_unit->u_SBP2ClassBase = base;
             sbp2_unit->u_SysUnit.unit_OpenCnt = 1; /* used by its handler task */
@@ -2604,6 +3734,7 @@ LONG sbp2_ForceUnitBinding(SBP2ClassLib *base, HeliosUnit *unit)
             sbp2_unit->u_SysUnit.unit_MsgPort.mp_SigTask = NULL;
             sbp2_unit->u_HeliosDevice = dev; /* NR from Helios_GetAttrs */
             sbp2_unit->u_HeliosUnit = unit;
+            sbp2_unit->u_Trace = &sbp2_notrace;
             sbp2_unit->u_GUID = guid;
             sbp2_unit->u_Generation = gen;
             /* Let the driver task fill the rest */
@@ -2711,9 +3842,9 @@ LONG sbp2_ReleaseUnitBinding(SBP2ClassLib *base, HeliosUnit *helios_unit, SBP2Un
 
     LOCK_REGION(sbp2_unit);
     {
-        sbp2_unit->u_Flags.Logged = 0; /* As the device is not supposed to be linked. */
-
-        /* Ask the unit task to exit */
+        /* Ask the unit task to exit, it checks if the target is still there
+         * to flush the write-back data and logout.
+         */
         if (NULL != sbp2_unit->u_DriverTask)
         {
             Signal(sbp2_unit->u_DriverTask, SIGBREAKF_CTRL_C);
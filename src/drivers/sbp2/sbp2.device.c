@@ -319,6 +319,16 @@ static void devBeginIO(void)
 
     switch (ioreq->io_Command)
     {
+        /* Flush the write-back stage, NOPs without it */
+        case CMD_UPDATE:
+        case TD_MOTOR:
+            if (0 == sbp2_unit->u_WBSize)
+            {
+                ret = RC_OK;
+                break;
+            }
+            /* fall through */
+
         case CMD_START:
         case CMD_STOP:
         case CMD_RESET:
@@ -351,8 +361,6 @@ static void devBeginIO(void)
 
         /* NOPs */
         case CMD_CLEAR:
-        case CMD_UPDATE:
-        case TD_MOTOR:
             ret = RC_OK;
             break;
 
@@ -653,7 +653,7 @@ LONG sbp2_iocmd_read64(SBP2Unit *unit, struct IOStdReq *ioreq)
     LONG err;
 
     ULONG datalen, dataremain = ioreq->io_Length;
-    ULONG maxtrans = 1ul<<21; /* TODO: how to set the max transfer ? */
+    ULONG maxtrans = unit->u_MaxTransfer; /* Tuned per target */
     ULONG insideblockoffset, startblock, dataoffset=0;
     UQUAD offset64;
 
@@ -687,30 +687,34 @@ LONG sbp2_iocmd_read64(SBP2Unit *unit, struct IOStdReq *ioreq)
         return ioreq->io_Error;
     }
 
-    if (unit->u_OneBlockSize < unit->u_BlockSize)
+    /* Two staging blocks: partial head and tail blocks */
+    if (unit->u_OneBlockSize < 2*unit->u_BlockSize)
     {
         if (NULL != unit->u_OneBlock)
         {
             FreePooled(unit->u_SBP2ClassBase->hc_MemPool, unit->u_OneBlock, unit->u_OneBlockSize);
         }
-        unit->u_OneBlock = AllocPooled(unit->u_SBP2ClassBase->hc_MemPool, unit->u_BlockSize);
+        unit->u_OneBlock = AllocPooled(unit->u_SBP2ClassBase->hc_MemPool, 2*unit->u_BlockSize);
         if (NULL == unit->u_OneBlock)
         {
             _ERR("Alloc block failed\n");
+            unit->u_OneBlockSize = 0;
             ioreq->io_Actual = 0;
             ioreq->io_Error = IOERR_NOMEMORY;
             return ioreq->io_Error;
         }
 
-        unit->u_OneBlockSize = unit->u_BlockSize;
+        unit->u_OneBlockSize = 2*unit->u_BlockSize;
     }
 
     /* This is the idea of operation:
      * the READ_10 scsi command permits to transfer zero or more blocks.
      * So we need to give the address of the start block and a block count.
      * Now the IO requests a buffer not aligned on block and of any size.
-     * So we're going to split this buffer into block transfer and handles
-     * non read used border data by doing mem copy from a temporary buffer.
+     * So each READ_10 covers the whole block range of the buffer: the ORB
+     * page table gives the full blocks directly into the buffer, and the
+     * partial head and tail blocks into staging blocks. Only the used
+     * border data of these two blocks are copied.
      *
      * As the transfer length is a number of block, given as a 16-bits value,
      * we can't read more than 65,535 blocks per READ_10 command.
@@ -727,81 +731,82 @@ LONG sbp2_iocmd_read64(SBP2Unit *unit, struct IOStdReq *ioreq)
     insideblockoffset = (ioreq->io_LowOffset & ((1ul << unit->u_BlockShift)-1));
     while (dataremain)
     {
+        SBP2Segment segs[3];
+        ULONG nsegs=0, blocks, headlen=0, taillen;
+        UBYTE *data = &(((UBYTE *) ioreq->io_Data)[dataoffset]);
+
         /* Limit transfer size */
-        datalen = MIN(dataremain, maxtrans);
+        datalen = MIN(dataremain, maxtrans - insideblockoffset);
+        blocks = (insideblockoffset + datalen + unit->u_BlockSize - 1) >> unit->u_BlockShift;
 
-        _INFO("Reading %lu bytes from block %ld, %ld bytes left...\n", datalen, startblock, dataremain);
+        _INFO("Reading %lu bytes from block %ld (%lu blocks), %ld bytes left...\n",
+              datalen, startblock, blocks, dataremain);
 
-        /* if offset is not block aligned or xfer size is less than a block size */
+        /* Partial head block */
         if (insideblockoffset || (datalen < unit->u_BlockSize))
         {
-            /* now limit xfert size to the block size */
-            if (datalen > unit->u_BlockSize - insideblockoffset)
-            {
-                datalen = unit->u_BlockSize - insideblockoffset;
-            }
+            headlen = MIN(datalen, unit->u_BlockSize - insideblockoffset);
+            segs[nsegs].sg_Data = unit->u_OneBlock;
+            segs[nsegs++].sg_Length = unit->u_BlockSize;
+        }
 
-            scsicmd.scsi_Data = (UWORD *) unit->u_OneBlock;
-            scsicmd.scsi_Length = unit->u_BlockSize;
-            scsicmd.scsi_Command = cmd10;
-            scsicmd.scsi_CmdLength = 10;
-            scsicmd.scsi_Flags = SCSIF_READ|SCSIF_AUTOSENSE;
-            scsicmd.scsi_SenseData = sensedata;
-            scsicmd.scsi_SenseLength = 18;
-            cmd10[0] = SCSI_DA_READ_10;
-            cmd10[1] = 0;
-            *((ULONG *) (&cmd10[2])) = LE_SWAPLONG(startblock);
-            cmd10[6] = 0;
-            cmd10[7] = 0;
-            cmd10[8] = 1;
-            cmd10[9] = 0;
+        /* Full blocks */
+        taillen = (datalen - headlen) & (unit->u_BlockSize-1);
+        if (datalen > headlen + taillen)
+        {
+            segs[nsegs].sg_Data = data + headlen;
+            segs[nsegs++].sg_Length = datalen - headlen - taillen;
+        }
 
-            err = sbp2_do_scsi_cmd(unit, &scsicmd, ORB_TIMEOUT);
-            if (err)
-            {
-                ioreq->io_Error = err;
-                goto out;
-            }
+        /* Partial tail block */
+        if (taillen)
+        {
+            segs[nsegs].sg_Data = unit->u_OneBlock + unit->u_BlockSize;
+            segs[nsegs++].sg_Length = unit->u_BlockSize;
+        }
 
-            if (((ULONG)&unit->u_OneBlock[insideblockoffset] & 3) ||
-                ((ULONG)&(((UBYTE *) ioreq->io_Data)[dataoffset]) & 3) ||
-                (datalen & 3))
-            {
-                _WARN("CopyMemQuick() will fails\n");
-            }
-            CopyMemQuick(&unit->u_OneBlock[insideblockoffset],
-                         &(((UBYTE *) ioreq->io_Data)[dataoffset]),
-                         datalen);
-            insideblockoffset = 0;
-            startblock++;
+        scsicmd.scsi_Data = (UWORD *) data;
+        scsicmd.scsi_Length = blocks << unit->u_BlockShift;
+        scsicmd.scsi_Command = cmd10;
+        scsicmd.scsi_CmdLength = 10;
+        scsicmd.scsi_Flags = SCSIF_READ|SCSIF_AUTOSENSE;
+        scsicmd.scsi_SenseData = sensedata;
+        scsicmd.scsi_SenseLength = 18;
+        cmd10[0] = SCSI_DA_READ_10;
+        cmd10[1] = 0;
+        *((ULONG *) (&cmd10[2])) = LE_SWAPLONG(startblock);
+        cmd10[6] = 0;
+        cmd10[7] = blocks >> 8;
+        cmd10[8] = blocks;
+        cmd10[9] = 0;
+
+        /* Block aligned: no page table needed */
+        if ((1 == nsegs) && (segs[0].sg_Data == data))
+        {
+            err = sbp2_do_scsi_cmd(unit, &scsicmd, ORB_TIMEOUT);
         }
         else
         {
-            scsicmd.scsi_Data = (UWORD *) &(((UBYTE *) ioreq->io_Data)[dataoffset]);
-            scsicmd.scsi_Length = datalen;
-            scsicmd.scsi_Command = cmd10;
-            scsicmd.scsi_CmdLength = 10;
-            scsicmd.scsi_Flags = SCSIF_READ|SCSIF_AUTOSENSE;
-            scsicmd.scsi_SenseData = sensedata;
-            scsicmd.scsi_SenseLength = 18;
-            cmd10[0] = SCSI_DA_READ_10;
-            cmd10[1] = 0;
-            *((ULONG *) (&cmd10[2])) = LE_SWAPLONG(startblock);
-            cmd10[6] = 0;
-            cmd10[7] = datalen >> (unit->u_BlockShift+8);
-            cmd10[8] = datalen >> unit->u_BlockShift;
-            cmd10[9] = 0;
+            err = sbp2_do_scsi_cmd_sg(unit, &scsicmd, segs, nsegs, ORB_TIMEOUT);
+        }
 
-            err = sbp2_do_scsi_cmd(unit, &scsicmd, ORB_TIMEOUT);
-            if (err)
-            {
-                ioreq->io_Error = err;
-                goto out;
-            }
+        if (err)
+        {
+            ioreq->io_Error = err;
+            goto out;
+        }
 
-            startblock += (insideblockoffset+datalen) >> unit->u_BlockShift;
+        if (headlen)
+        {
+            CopyMem(&unit->u_OneBlock[insideblockoffset], data, headlen);
+        }
+        if (taillen)
+        {
+            CopyMem(&unit->u_OneBlock[unit->u_BlockSize], data + datalen - taillen, taillen);
         }
 
+        insideblockoffset = 0;
+        startblock += blocks;
         dataoffset += datalen;
         dataremain -= datalen;
     }
@@ -819,7 +824,7 @@ LONG sbp2_iocmd_write64(SBP2Unit *unit, struct IOStdReq *ioreq)
     LONG err;
 
     ULONG datalen, dataremain = ioreq->io_Length;
-    ULONG maxtrans = 1ul<<21; /* TODO: how to set the max transfer ? */
+    ULONG maxtrans = unit->u_MaxTransfer; /* Tuned per target */
     ULONG insideblockoffset, startblock, dataoffset=0;
     UQUAD offset64;
 
@@ -1177,5 +1182,102 @@ geo_ok:
     return ioreq->io_Error;
 }
 
+/* Returns TRUE if a block aligned read/write can be given alone to the ORB queue */
+BOOL sbp2_iocmd_queueable(SBP2Unit *unit, struct IOStdReq *ioreq)
+{
+    UQUAD offset64;
+
+    if ((0 == unit->u_QueueDepth) || (0 == unit->u_BlockSize))
+    {
+        return FALSE;
+    }
+
+    switch (ioreq->io_Command)
+    {
+        case CMD_READ:
+        case TD_READ64:
+            if (0xff == unit->u_Read10Cmd)
+            {
+                return FALSE;
+            }
+            break;
+
+        case CMD_WRITE:
+        case TD_WRITE64:
+            if (unit->u_Flags.WriteProtected)
+            {
+                return FALSE;
+            }
+            break;
+
+        default:
+            return FALSE;
+    }
+
+    if ((CMD_READ == ioreq->io_Command) || (CMD_WRITE == ioreq->io_Command))
+    {
+        ioreq->io_Actual = 0; /* io_HighOffset */
+    }
+
+    offset64 = ((UQUAD)ioreq->io_HighOffset<<32) + ioreq->io_LowOffset;
+
+    /* Partial blocks, long or unaligned transfers are split by read64/write64 */
+    return (0 != ioreq->io_Length) &&
+        (ioreq->io_Length <= unit->u_MaxTransfer) &&
+        !(ioreq->io_Length & (unit->u_BlockSize-1)) &&
+        !(offset64 & (unit->u_BlockSize-1)) &&
+        ((ioreq->io_Length >> unit->u_BlockShift) <= 0xffff) &&
+        !((ULONG)ioreq->io_Data & 3) &&
+        ((offset64 >> unit->u_BlockShift) <= 0xffffffffull);
+}
+
+/* Give count block aligned reads or writes to the ORB queue as one command.
+ * ioreqs are adjacent on the disk, in offset order, all of the same direction.
+ * Returns FALSE if each ioreq must be handled by sbp2_handle_ioreq().
+ */
+BOOL sbp2_iocmd_queue(SBP2Unit *unit, struct IOStdReq **ioreqs, ULONG count)
+{
+    UBYTE cmd10[10];
+    UBYTE flags;
+    ULONG i, length=0, blocks;
+    UQUAD offset64;
+
+    for (i=0; i < count; i++)
+    {
+        if (!sbp2_iocmd_queueable(unit, ioreqs[i]))
+        {
+            return FALSE;
+        }
+        length += ioreqs[i]->io_Length;
+    }
+
+    blocks = length >> unit->u_BlockShift;
+    if ((length > unit->u_MaxTransfer) || (blocks > 0xffff))
+    {
+        return FALSE;
+    }
+
+    if ((CMD_READ == ioreqs[0]->io_Command) || (TD_READ64 == ioreqs[0]->io_Command))
+    {
+        cmd10[0] = SCSI_DA_READ_10;
+        flags = SCSIF_READ;
+    }
+    else
+    {
+        cmd10[0] = SCSI_DA_WRITE_10;
+        flags = SCSIF_WRITE;
+    }
+
+    offset64 = ((UQUAD)ioreqs[0]->io_HighOffset<<32) + ioreqs[0]->io_LowOffset;
+
+    cmd10[1] = 0;
+    *((ULONG *) (&cmd10[2])) = LE_SWAPLONG((ULONG)(offset64 >> unit->u_BlockShift));
+    cmd10[6] = 0;
+    cmd10[7] = blocks >> 8;
+    cmd10[8] = blocks;
+    cmd10[9] = 0;
+
+    return 0 == sbp2_queue_scsi_cmd(unit, ioreqs, count, cmd10, sizeof(cmd10), flags);
+}
 
 /* EOF */
@@ -33,5 +33,7 @@ extern LONG sbp2_iocmd_start_stop(SBP2Unit *unit, struct IOStdReq *ioreq);
 extern LONG sbp2_iocmd_read64(SBP2Unit *unit, struct IOStdReq *ioreq);
 extern LONG sbp2_iocmd_write64(SBP2Unit *unit, struct IOStdReq *ioreq);
 extern LONG sbp2_iocmd_get_geometry(SBP2Unit *unit, struct IOStdReq *ioreq);
+extern BOOL sbp2_iocmd_queueable(SBP2Unit *unit, struct IOStdReq *ioreq);
+extern BOOL sbp2_iocmd_queue(SBP2Unit *unit, struct IOStdReq **ioreqs, ULONG count);
 
 #endif /* SBP2_IOCMD_H */
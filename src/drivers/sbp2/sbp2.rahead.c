@@ -0,0 +1,492 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** SBP2 class read-ahead cache.
+**
+** With helios_sbp2_readahead set (KB, max window) and the ORB queue on,
+** SBP2_RA_TRIGGER reads in a row, each one starting where the previous one
+** ended, start a prefetch of the following window. The prefetch is a
+** TD_READ64 given to the ORB queue after the read that triggered it, its
+** reply comes to u_RAPort. Reads inside a window are copied from it, or
+** wait for the end of its prefetch. When half of a window is read, the next
+** one is prefetched in the other slot, twice larger up to the max window
+** (and u_MaxTransfer).
+** Windows are dropped by writes over them, any command that may change the
+** medium data (HD_SCSICMD, TD_FORMAT...), a medium change and a bus reset.
+** A window dropped while loading still serves the reads waiting for it:
+** they were dispatched before the write.
+** A failed prefetch only drops its window: the reads waiting for it are
+** given again to the scheduler, as ordinary reads.
+**
+*/
+
+#define NDEBUG
+
+#include "sbp2.class.h"
+#include "sbp2.iocmd.h"
+#include "sbp2.rahead.h"
+#include "sbp2.sched.h"
+#include "sbp2.wback.h"
+
+#include <clib/macros.h>
+
+#define SysBase (unit->u_SBP2ClassBase->hc_SysBase)
+
+#define NO_PREFETCH (~0ull)
+
+/*============================================================================*/
+/*--- LOCAL CODE -------------------------------------------------------------*/
+/*============================================================================*/
+
+static void ra_drop(SBP2RASlot *slot)
+{
+    if (slot->rs_Loading)
+    {
+        slot->rs_Stale = TRUE;
+    }
+    else
+    {
+        slot->rs_Length = 0;
+    }
+}
+
+/* The valid window holding the range, NULL if none */
+static SBP2RASlot *ra_find(SBP2Unit *unit, UQUAD offset, ULONG length)
+{
+    ULONG i;
+
+    for (i=0; i < SBP2_RA_SLOTS; i++)
+    {
+        SBP2RASlot *slot = &unit->u_RASlots[i];
+
+        if ((0 != slot->rs_Length) && !slot->rs_Stale &&
+            (offset >= slot->rs_Offset) &&
+            ((offset + length) <= (slot->rs_Offset + slot->rs_Length)))
+        {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static void ra_copy(SBP2RASlot *slot, struct IOStdReq *ioreq)
+{
+    SBP2Unit *unit = (APTR)ioreq->io_Unit;
+
+    CopyMem(slot->rs_Buffer + (IOREQ_OFFSET64(ioreq) - slot->rs_Offset), ioreq->io_Data, ioreq->io_Length);
+    ioreq->io_Error = 0;
+    ioreq->io_Actual = ioreq->io_Length;
+}
+
+/* Ask a prefetch at offset if no window starts there */
+static void ra_want(SBP2Unit *unit, UQUAD offset)
+{
+    ULONG i;
+
+    for (i=0; i < SBP2_RA_SLOTS; i++)
+    {
+        SBP2RASlot *slot = &unit->u_RASlots[i];
+
+        if ((0 != slot->rs_Length) && !slot->rs_Stale &&
+            (offset >= slot->rs_Offset) && (offset < (slot->rs_Offset + slot->rs_Length)))
+        {
+            return;
+        }
+    }
+
+    unit->u_RAWant = offset;
+}
+
+/*============================================================================*/
+/*--- PUBLIC CODE ------------------------------------------------------------*/
+/*============================================================================*/
+
+/* Allocate the windows of u_RAMaxWindow bytes, called once u_QueuePort exists */
+void sbp2_ra_init(SBP2Unit *unit)
+{
+    ULONG i;
+
+    unit->u_RAPort.mp_Node.ln_Type = NT_MSGPORT;
+    unit->u_RAPort.mp_Flags = PA_SIGNAL;
+    unit->u_RAPort.mp_SigBit = unit->u_QueuePort->mp_SigBit;
+    unit->u_RAPort.mp_SigTask = FindTask(NULL);
+    NEWLIST(&unit->u_RAPort.mp_MsgList);
+
+    unit->u_RAWindow = SBP2_RA_MIN;
+    unit->u_RAWant = NO_PREFETCH;
+
+    for (i=0; i < SBP2_RA_SLOTS; i++)
+    {
+        SBP2RASlot *slot = &unit->u_RASlots[i];
+
+        NEWLIST(&slot->rs_Waiting);
+        slot->rs_IOReq.io_Message.mn_Length = sizeof(slot->rs_IOReq);
+        slot->rs_IOReq.io_Message.mn_ReplyPort = &unit->u_RAPort;
+        slot->rs_IOReq.io_Unit = &unit->u_SysUnit;
+        slot->rs_Length = 0;
+
+        /* Prefetches use the ORB queue */
+        if ((0 != unit->u_RAMaxWindow) && (0 != unit->u_QueueDepth))
+        {
+            slot->rs_Buffer = AllocVecDMA(unit->u_RAMaxWindow, MEMF_PUBLIC);
+            if (NULL == slot->rs_Buffer)
+            {
+                _ERR("Read-ahead: failed to allocate %lu bytes\n", unit->u_RAMaxWindow);
+                sbp2_ra_cleanup(unit);
+                break;
+            }
+        }
+    }
+
+    if (NULL == unit->u_RASlots[0].rs_Buffer)
+    {
+        unit->u_RAMaxWindow = 0;
+    }
+
+    _INFO("Read-ahead: max window %lu bytes\n", unit->u_RAMaxWindow);
+}
+
+/* The ORB queue shall be idle */
+void sbp2_ra_cleanup(SBP2Unit *unit)
+{
+    ULONG i;
+
+    /* Replies of the aborted prefetches */
+    if (NULL != unit->u_RAPort.mp_SigTask)
+    {
+        sbp2_ra_process(unit);
+    }
+
+    if (0 != unit->u_RAMaxWindow)
+    {
+        _INFO("Read-ahead: %lu hits, %lu misses, %lu prefetches\n",
+              unit->u_RAHits, unit->u_RAMisses, unit->u_RAPrefetches);
+    }
+
+    for (i=0; i < SBP2_RA_SLOTS; i++)
+    {
+        SBP2RASlot *slot = &unit->u_RASlots[i];
+
+        if (NULL != slot->rs_Buffer)
+        {
+            FreeVecDMA(slot->rs_Buffer);
+            slot->rs_Buffer = NULL;
+        }
+        slot->rs_Length = 0;
+    }
+
+    unit->u_RAMaxWindow = 0;
+}
+
+/* Called for each group given by the scheduler.
+ * Returns TRUE if the reads are served by the cache (replied or waiting for
+ * a prefetch), else the group is executed as usual.
+ */
+BOOL sbp2_ra_dispatch(SBP2Unit *unit, struct IOStdReq **ioreqs, ULONG count)
+{
+    SBP2RASlot *slots[SBP2_SCHED_MERGE];
+    UQUAD offset;
+    ULONG i, total=0;
+
+    if (0 == unit->u_RAMaxWindow)
+    {
+        return FALSE;
+    }
+
+    switch (ioreqs[0]->io_Command)
+    {
+        case CMD_READ:
+        case TD_READ64:
+            break;
+
+        case CMD_WRITE:
+        case TD_WRITE64:
+            for (i=0; i < count; i++)
+            {
+                UQUAD start = IOREQ_OFFSET64(ioreqs[i]);
+                ULONG j;
+
+                for (j=0; j < SBP2_RA_SLOTS; j++)
+                {
+                    SBP2RASlot *slot = &unit->u_RASlots[j];
+
+                    if ((start < (slot->rs_Offset + slot->rs_Length)) &&
+                        (slot->rs_Offset < (start + ioreqs[i]->io_Length)))
+                    {
+                        ra_drop(slot);
+                    }
+                }
+            }
+            return FALSE;
+
+        /* Medium data are not changed */
+        case TD_GETGEOMETRY:
+        case CMD_UPDATE:
+        case TD_MOTOR:
+        case CMD_START:
+            return FALSE;
+
+        default:
+            sbp2_ra_invalidate(unit);
+            return FALSE;
+    }
+
+    offset = IOREQ_OFFSET64(ioreqs[0]);
+    for (i=0; i < count; i++)
+    {
+        slots[i] = ra_find(unit, IOREQ_OFFSET64(ioreqs[i]), ioreqs[i]->io_Length);
+        if (NULL == slots[i])
+        {
+            break;
+        }
+        total += ioreqs[i]->io_Length;
+    }
+
+    /* Sequential access detection */
+    if (offset == unit->u_RANext)
+    {
+        unit->u_RASeq++;
+    }
+    else
+    {
+        unit->u_RASeq = 0;
+        unit->u_RAWindow = SBP2_RA_MIN;
+    }
+
+    if (i < count)
+    {
+        for (total=0, i=0; i < count; i++)
+        {
+            total += ioreqs[i]->io_Length;
+        }
+
+        unit->u_RAMisses += count;
+        unit->u_RANext = offset + total;
+
+        if (unit->u_RASeq >= SBP2_RA_TRIGGER)
+        {
+            ra_want(unit, unit->u_RANext);
+        }
+        return FALSE;
+    }
+
+    unit->u_RAHits += count;
+    unit->u_RANext = offset + total;
+
+    for (i=0; i < count; i++)
+    {
+        if (slots[i]->rs_Loading)
+        {
+            ADDTAIL(&slots[i]->rs_Waiting, &ioreqs[i]->io_Message.mn_Node);
+        }
+        else
+        {
+            ra_copy(slots[i], ioreqs[i]);
+            ReplyMsg(&ioreqs[i]->io_Message);
+        }
+    }
+
+    /* Half of the window is read: prefetch the next one */
+    if ((unit->u_RANext - slots[count-1]->rs_Offset) >= (slots[count-1]->rs_Length / 2))
+    {
+        ra_want(unit, slots[count-1]->rs_Offset + slots[count-1]->rs_Length);
+    }
+
+    return TRUE;
+}
+
+/* Start the prefetch asked by sbp2_ra_dispatch(), after the group it has seen */
+void sbp2_ra_prefetch(SBP2Unit *unit)
+{
+    SBP2RASlot *slot=NULL;
+    struct IOStdReq *ioreq;
+    UQUAD offset = unit->u_RAWant, disk_end;
+    ULONG i, length;
+
+    if (NO_PREFETCH == offset)
+    {
+        return;
+    }
+
+    unit->u_RAWant = NO_PREFETCH;
+
+    if ((unit->u_QueueCount >= unit->u_QueueDepth) || (0 == unit->u_BlockSize) || !unit->u_Flags.Ready)
+    {
+        return;
+    }
+
+    /* An idle slot, not the window of the last read */
+    for (i=0; i < SBP2_RA_SLOTS; i++)
+    {
+        SBP2RASlot *s = &unit->u_RASlots[i];
+
+        if (s->rs_Loading)
+        {
+            continue;
+        }
+
+        if ((0 == s->rs_Length) ||
+            (unit->u_RANext <= s->rs_Offset) ||
+            (unit->u_RANext > (s->rs_Offset + s->rs_Length)))
+        {
+            slot = s;
+            break;
+        }
+    }
+
+    if (NULL == slot)
+    {
+        return;
+    }
+
+    offset &= ~(UQUAD)(unit->u_BlockSize - 1);
+    disk_end = (UQUAD)unit->u_Geometry.dg_TotalSectors << unit->u_BlockShift;
+    if (offset >= disk_end)
+    {
+        return;
+    }
+
+    length = MIN(MIN(unit->u_RAWindow, unit->u_RAMaxWindow), unit->u_MaxTransfer);
+    length = MIN(length, 0xffff << unit->u_BlockShift);
+    length = MIN((UQUAD)length, disk_end - offset) & ~(unit->u_BlockSize - 1);
+
+    /* Dirty write-back data are newer than the medium */
+    if ((0 == length) || sbp2_wb_overlaps(unit, offset, length))
+    {
+        return;
+    }
+
+    slot->rs_Offset = offset;
+    slot->rs_Length = length;
+    slot->rs_Stale = FALSE;
+    slot->rs_Loading = TRUE;
+
+    ioreq = &slot->rs_IOReq;
+    ioreq->io_Command = TD_READ64;
+    ioreq->io_Data = slot->rs_Buffer;
+    ioreq->io_Length = length;
+    ioreq->io_Actual = offset >> 32;
+    ioreq->io_Offset = offset;
+
+    if (!sbp2_iocmd_queue(unit, &ioreq, 1))
+    {
+        slot->rs_Loading = FALSE;
+        slot->rs_Length = 0;
+        return;
+    }
+
+    _INFO("Read-ahead: prefetch %lu bytes at $%llx\n", length, offset);
+
+    unit->u_RAPrefetches++;
+    unit->u_RAWindow = MIN(unit->u_RAWindow * 2, unit->u_RAMaxWindow);
+}
+
+/* A read waiting for a failed prefetch is dispatched again, from the medium */
+static void ra_requeue(SBP2Unit *unit, struct IOStdReq *ioreq, LONG err)
+{
+    if (!unit->u_Flags.AcceptIO)
+    {
+        /* Released unit: the scheduler has been flushed */
+        ioreq->io_Error = err;
+        ioreq->io_Actual = 0;
+        ReplyMsg(&ioreq->io_Message);
+    }
+    else if (!sbp2_sched_full(unit))
+    {
+        sbp2_sched_add(unit, ioreq);
+        unit->u_Flags.ProcessIO = 1;
+    }
+    else
+    {
+        PutMsg(&unit->u_SysUnit.unit_MsgPort, &ioreq->io_Message);
+    }
+}
+
+/* Complete prefetches replied by the ORB queue */
+void sbp2_ra_process(SBP2Unit *unit)
+{
+    struct IOStdReq *prefetch;
+
+    while (NULL != (prefetch = (struct IOStdReq *)GetMsg(&unit->u_RAPort)))
+    {
+        SBP2RASlot *slot = (APTR)prefetch - offsetof(SBP2RASlot, rs_IOReq);
+        struct IOStdReq *ioreq;
+        LONG err = prefetch->io_Error;
+
+        if (!err && (prefetch->io_Actual != slot->rs_Length))
+        {
+            err = IOERR_BADLENGTH;
+        }
+
+        if (err)
+        {
+            _ERR("Read-ahead: prefetch at $%llx failed, err=%ld\n", slot->rs_Offset, err);
+        }
+
+        slot->rs_Loading = FALSE;
+
+        /* Waiting reads get the prefetch data, or are read again */
+        while (NULL != (ioreq = REMHEAD(&slot->rs_Waiting)))
+        {
+            if (err)
+            {
+                ra_requeue(unit, ioreq, err);
+            }
+            else
+            {
+                ra_copy(slot, ioreq);
+                ReplyMsg(&ioreq->io_Message);
+            }
+        }
+
+        if (err || slot->rs_Stale)
+        {
+            slot->rs_Length = 0;
+            slot->rs_Stale = FALSE;
+        }
+
+        /* The run starts again from the requeued reads */
+        if (err)
+        {
+            unit->u_RASeq = 0;
+            unit->u_RAWindow = SBP2_RA_MIN;
+            unit->u_RAWant = NO_PREFETCH;
+        }
+    }
+}
+
+/* Drop all windows: medium change, bus reset, raw SCSI command */
+void sbp2_ra_invalidate(SBP2Unit *unit)
+{
+    ULONG i;
+
+    for (i=0; i < SBP2_RA_SLOTS; i++)
+    {
+        ra_drop(&unit->u_RASlots[i]);
+    }
+
+    unit->u_RASeq = 0;
+    unit->u_RAWindow = SBP2_RA_MIN;
+    unit->u_RAWant = NO_PREFETCH;
+}
+
+/* EOF */
@@ -0,0 +1,38 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** SBP2 class read-ahead cache header file.
+**
+*/
+
+#ifndef SBP2_RAHEAD_H
+#define SBP2_RAHEAD_H
+
+#include "sbp2.class.h"
+
+extern void sbp2_ra_init(SBP2Unit *unit);
+extern void sbp2_ra_cleanup(SBP2Unit *unit);
+extern BOOL sbp2_ra_dispatch(SBP2Unit *unit, struct IOStdReq **ioreqs, ULONG count);
+extern void sbp2_ra_prefetch(SBP2Unit *unit);
+extern void sbp2_ra_process(SBP2Unit *unit);
+extern void sbp2_ra_invalidate(SBP2Unit *unit);
+
+#endif /* SBP2_RAHEAD_H */
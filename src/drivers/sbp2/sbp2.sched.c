@@ -0,0 +1,316 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** SBP2 class IO scheduler.
+**
+** The unit task moves ioreqs from the unit port to u_SchedEntries, kept in
+** arrival order, then asks sbp2_sched_next() for the next group to execute.
+** The policy picks one read/write, following ones starting where the group
+** ends are merged in the same command.
+** Any other command is a barrier: nothing is picked after it until it is
+** dispatched, and it waits for all older ioreqs.
+** A read/write never passes an older overlapping access when one of them writes.
+**
+** Policies (env var helios_sbp2_scheduler):
+**   fifo:     arrival order, adjacent ioreqs are still merged.
+**   cscan:    lowest offset after the head, then back to the lowest offset.
+**   deadline: cscan, but a read waiting for SBP2_SCHED_READ_EXPIRE dispatches
+**             (a write for SBP2_SCHED_WRITE_EXPIRE) is served first. Default.
+**
+*/
+
+#define NDEBUG
+
+#include "sbp2.class.h"
+#include "sbp2.iocmd.h"
+#include "sbp2.sched.h"
+
+#define SysBase (unit->u_SBP2ClassBase->hc_SysBase)
+#define UtilityBase (unit->u_SBP2ClassBase->hc_UtilityBase)
+
+#define ENTRY_END(e) ((e)->se_Offset + (e)->se_IOReq->io_Length)
+#define NO_ENTRY ((ULONG)~0)
+
+static ULONG sched_pick_fifo(SBP2Unit *unit, ULONG count);
+static ULONG sched_pick_cscan(SBP2Unit *unit, ULONG count);
+static ULONG sched_pick_deadline(SBP2Unit *unit, ULONG count);
+
+static const SBP2SchedPolicy sched_policies[] =
+{
+    {"deadline", sched_pick_deadline},
+    {"cscan", sched_pick_cscan},
+    {"fifo", sched_pick_fifo},
+    {NULL, NULL}
+};
+
+/*============================================================================*/
+/*--- LOCAL CODE -------------------------------------------------------------*/
+/*============================================================================*/
+
+static BOOL sched_is_write(struct IOStdReq *ioreq)
+{
+    return (CMD_WRITE == ioreq->io_Command) || (TD_WRITE64 == ioreq->io_Command);
+}
+
+static BOOL sched_is_rw(struct IOStdReq *ioreq)
+{
+    switch (ioreq->io_Command)
+    {
+        case CMD_READ:
+        case TD_READ64:
+        case CMD_WRITE:
+        case TD_WRITE64:
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void sched_remove(SBP2Unit *unit, ULONG index)
+{
+    ULONG i;
+
+    unit->u_SchedCount--;
+    for (i=index; i < unit->u_SchedCount; i++)
+    {
+        unit->u_SchedEntries[i] = unit->u_SchedEntries[i+1];
+    }
+}
+
+/* TRUE if the entry may be dispatched before older ones */
+static BOOL sched_can_pass(SBP2Unit *unit, ULONG index)
+{
+    SBP2SchedEntry *e = &unit->u_SchedEntries[index];
+    ULONG i;
+
+    for (i=0; i < index; i++)
+    {
+        SBP2SchedEntry *o = &unit->u_SchedEntries[i];
+
+        if ((e->se_Write || o->se_Write) &&
+            (e->se_Offset < ENTRY_END(o)) && (o->se_Offset < ENTRY_END(e)))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static ULONG sched_pick_fifo(SBP2Unit *unit, ULONG count)
+{
+    return 0;
+}
+
+static ULONG sched_pick_cscan(SBP2Unit *unit, ULONG count)
+{
+    SBP2SchedEntry *entries = unit->u_SchedEntries;
+    ULONG i, next=NO_ENTRY, lowest=0;
+
+    /* The first entry can always be dispatched */
+    for (i=0; i < count; i++)
+    {
+        if ((i > 0) && !sched_can_pass(unit, i))
+        {
+            continue;
+        }
+
+        if ((entries[i].se_Offset >= unit->u_SchedHead) &&
+            ((NO_ENTRY == next) || (entries[i].se_Offset < entries[next].se_Offset)))
+        {
+            next = i;
+        }
+
+        if (entries[i].se_Offset < entries[lowest].se_Offset)
+        {
+            lowest = i;
+        }
+    }
+
+    return (NO_ENTRY != next) ? next : lowest;
+}
+
+static ULONG sched_pick_deadline(SBP2Unit *unit, ULONG count)
+{
+    ULONG i;
+
+    /* Entries are in arrival order: the first expired is the oldest */
+    for (i=0; i < count; i++)
+    {
+        SBP2SchedEntry *e = &unit->u_SchedEntries[i];
+        ULONG expire = e->se_Write ? SBP2_SCHED_WRITE_EXPIRE : SBP2_SCHED_READ_EXPIRE;
+
+        if (((unit->u_SchedSeq - e->se_Seq) >= expire) &&
+            ((0 == i) || sched_can_pass(unit, i)))
+        {
+            return i;
+        }
+    }
+
+    return sched_pick_cscan(unit, count);
+}
+
+/*============================================================================*/
+/*--- PUBLIC CODE ------------------------------------------------------------*/
+/*============================================================================*/
+
+/* Select the policy by name, the default one if NULL or unknown */
+void sbp2_sched_init(SBP2Unit *unit, CONST_STRPTR name)
+{
+    const SBP2SchedPolicy *policy = &sched_policies[0];
+
+    if (NULL != name)
+    {
+        const SBP2SchedPolicy *p;
+
+        for (p=sched_policies; NULL != p->sp_Name; p++)
+        {
+            if (0 == Stricmp(name, p->sp_Name))
+            {
+                policy = p;
+                break;
+            }
+        }
+    }
+
+    unit->u_SchedPolicy = policy;
+    _INFO("IO scheduler: %s\n", policy->sp_Name);
+}
+
+BOOL sbp2_sched_full(SBP2Unit *unit)
+{
+    return unit->u_SchedCount >= SBP2_SCHED_SLOTS;
+}
+
+void sbp2_sched_add(SBP2Unit *unit, struct IOStdReq *ioreq)
+{
+    SBP2SchedEntry *e = &unit->u_SchedEntries[unit->u_SchedCount++];
+
+    e->se_IOReq = ioreq;
+    e->se_Offset = IOREQ_OFFSET64(ioreq);
+    e->se_Seq = unit->u_SchedSeq;
+    e->se_Write = sched_is_write(ioreq);
+    e->se_Barrier = !sched_is_rw(ioreq);
+}
+
+/* Remove the next group to execute from the scheduler.
+ * Fills ioreqs with up to SBP2_SCHED_MERGE adjacent reads or writes in offset
+ * order, or one other command. Returns the ioreq count, 0 if empty.
+ * A group of more than one ioreq has been checked by sbp2_iocmd_queueable().
+ */
+ULONG sbp2_sched_next(SBP2Unit *unit, struct IOStdReq **ioreqs)
+{
+    SBP2SchedEntry *entries = unit->u_SchedEntries;
+    ULONG count, pick, n=1;
+    UQUAD end;
+    ULONG total;
+    BOOL write;
+
+    if (0 == unit->u_SchedCount)
+    {
+        return 0;
+    }
+
+    unit->u_SchedSeq++;
+
+    /* Candidates are before the first barrier */
+    for (count=0; (count < unit->u_SchedCount) && !entries[count].se_Barrier; count++);
+
+    if (0 == count)
+    {
+        ioreqs[0] = entries[0].se_IOReq;
+        sched_remove(unit, 0);
+        return 1;
+    }
+
+    pick = unit->u_SchedPolicy->sp_Pick(unit, count);
+
+    ioreqs[0] = entries[pick].se_IOReq;
+    write = entries[pick].se_Write;
+    end = ENTRY_END(&entries[pick]);
+    total = ioreqs[0]->io_Length;
+
+    sched_remove(unit, pick);
+    count--;
+
+    if (sbp2_iocmd_queueable(unit, ioreqs[0]))
+    {
+        while (n < SBP2_SCHED_MERGE)
+        {
+            ULONG i;
+
+            for (i=0; i < count; i++)
+            {
+                SBP2SchedEntry *e = &entries[i];
+                ULONG length = e->se_IOReq->io_Length;
+
+                if ((e->se_Offset == end) && (e->se_Write == write) &&
+                    ((total + length) <= unit->u_MaxTransfer) &&
+                    (((total + length) >> unit->u_BlockShift) <= 0xffff) &&
+                    sched_can_pass(unit, i) &&
+                    sbp2_iocmd_queueable(unit, e->se_IOReq))
+                {
+                    break;
+                }
+            }
+
+            if (i == count)
+            {
+                break;
+            }
+
+            ioreqs[n++] = entries[i].se_IOReq;
+            end += entries[i].se_IOReq->io_Length;
+            total += entries[i].se_IOReq->io_Length;
+
+            sched_remove(unit, i);
+            count--;
+        }
+    }
+
+    unit->u_SchedHead = end;
+
+    if (n > 1)
+    {
+        _INFO("IO scheduler: %lu ioreqs merged, %lu bytes\n", n, total);
+    }
+
+    return n;
+}
+
+/* Reply all waiting ioreqs with the given error */
+void sbp2_sched_flush(SBP2Unit *unit, LONG err)
+{
+    ULONG i;
+
+    for (i=0; i < unit->u_SchedCount; i++)
+    {
+        struct IOStdReq *ioreq = unit->u_SchedEntries[i].se_IOReq;
+
+        ioreq->io_Error = err;
+        ioreq->io_Actual = 0;
+        ReplyMsg(&ioreq->io_Message);
+    }
+
+    unit->u_SchedCount = 0;
+}
+
+/* EOF */
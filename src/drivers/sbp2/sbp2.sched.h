@@ -0,0 +1,37 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** SBP2 class IO scheduler header file.
+**
+*/
+
+#ifndef SBP2_SCHED_H
+#define SBP2_SCHED_H
+
+#include "sbp2.class.h"
+
+extern void sbp2_sched_init(SBP2Unit *unit, CONST_STRPTR name);
+extern BOOL sbp2_sched_full(SBP2Unit *unit);
+extern void sbp2_sched_add(SBP2Unit *unit, struct IOStdReq *ioreq);
+extern ULONG sbp2_sched_next(SBP2Unit *unit, struct IOStdReq **ioreqs);
+extern void sbp2_sched_flush(SBP2Unit *unit, LONG err);
+
+#endif /* SBP2_SCHED_H */
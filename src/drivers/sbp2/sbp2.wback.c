@@ -0,0 +1,460 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** SBP2 class write-back stage.
+**
+** With helios_sbp2_writeback set (KB), block aligned writes given by the
+** scheduler are copied in u_WBBuffer and replied at once. Extents are kept in
+** arrival order, a write following the last extent extends it.
+** Dirty extents are written sorted by offset, adjacent ones in one WRITE_10
+** with a segment per extent, when:
+**   - the buffer or the extent table is full,
+**   - SBP2_WB_DELAY ms after the first dirty write (unit task timer),
+**   - an ioreq that is not an absorbed write comes: CMD_UPDATE, TD_MOTOR,
+**     HD_SCSICMD..., a read over dirty data or a write not absorbed,
+**   - the unit is released.
+** Data survive a bus reset: nothing is written until the unit accepts IO again.
+** A flush failed by a bus reset or a busy target keeps the data for a retry,
+** ioreqs depending on them fail meanwhile. They are dropped on a permanent
+** error, after SBP2_WB_RETRIES failures of a ready unit, or on medium change:
+** the error is given by the next write, CMD_UPDATE or TD_MOTOR.
+** Data loss window: replied writes not written yet are lost if the device is
+** unplugged, dies or can't login again after a bus reset. The unit release
+** flushes them only if the target is still there with the same login (class
+** expunge, ROM change). Lost data, or a flush error never given to a write,
+** are reported as a Helios error message (HEVTF_NEW_REPORTMSG listeners).
+**
+*/
+
+#define NDEBUG
+
+#include "sbp2.class.h"
+#include "sbp2.wback.h"
+
+#include <scsi/commands.h>
+#include <scsi/values.h>
+#include <hardware/byteswap.h>
+#include <clib/macros.h>
+
+#define SysBase (unit->u_SBP2ClassBase->hc_SysBase)
+#define HeliosBase (unit->u_SBP2ClassBase->hc_HeliosBase)
+
+/*============================================================================*/
+/*--- LOCAL CODE -------------------------------------------------------------*/
+/*============================================================================*/
+
+static BOOL wb_absorbable(SBP2Unit *unit, struct IOStdReq *ioreq)
+{
+    UQUAD offset = IOREQ_OFFSET64(ioreq);
+
+    return ((CMD_WRITE == ioreq->io_Command) || (TD_WRITE64 == ioreq->io_Command)) &&
+        (0 != unit->u_BlockSize) &&
+        unit->u_Flags.Ready && !unit->u_Flags.WriteProtected &&
+        (0 != ioreq->io_Length) &&
+        (ioreq->io_Length <= (unit->u_WBSize / 2)) &&
+        !(ioreq->io_Length & (unit->u_BlockSize-1)) &&
+        !(offset & (unit->u_BlockSize-1)) &&
+        ((offset >> unit->u_BlockShift) <= 0xffffffffull);
+}
+
+/* Reply the ioreqs with an error */
+static void wb_fail(struct IOStdReq **ioreqs, ULONG count, LONG err)
+{
+    ULONG i;
+
+    for (i=0; i < count; i++)
+    {
+        ioreqs[i]->io_Error = err;
+        ioreqs[i]->io_Actual = 0;
+        ReplyMsg(&ioreqs[i]->io_Message);
+    }
+}
+
+/* Errors of a bus reset or of a busy target, the flush is tried again */
+static BOOL wb_transient(LONG err)
+{
+    switch (err)
+    {
+        case TDERR_PostReset:
+        case IOERR_ABORTED:
+        case HFERR_Phase:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* Copy a write in the buffer, may flush first.
+ * Returns the flush error if the data kept for a retry leave no room.
+ */
+static LONG wb_absorb(SBP2Unit *unit, struct IOStdReq *ioreq)
+{
+    UQUAD offset = IOREQ_OFFSET64(ioreq);
+    ULONG i, length = ioreq->io_Length;
+    SBP2WBExtent *e;
+    LONG err;
+
+    /* Rewrite of dirty data */
+    for (i=0; i < unit->u_WBCount; i++)
+    {
+        e = &unit->u_WBExtents[i];
+
+        if ((offset >= e->we_Offset) && ((offset + length) <= (e->we_Offset + e->we_Length)))
+        {
+            CopyMem(ioreq->io_Data, e->we_Data + (offset - e->we_Offset), length);
+            return 0;
+        }
+    }
+
+    /* Partial overlaps are written before */
+    if (sbp2_wb_overlaps(unit, offset, length) ||
+        ((unit->u_WBUsed + length) > unit->u_WBSize))
+    {
+        err = sbp2_wb_flush(unit);
+        if (err && (unit->u_WBCount > 0))
+        {
+            return err;
+        }
+    }
+
+    e = unit->u_WBCount ? &unit->u_WBExtents[unit->u_WBCount-1] : NULL;
+    if ((NULL != e) && ((e->we_Offset + e->we_Length) == offset))
+    {
+        /* The last extent ends at the buffer tail */
+        e->we_Length += length;
+    }
+    else
+    {
+        if (unit->u_WBCount >= SBP2_WB_EXTENTS)
+        {
+            err = sbp2_wb_flush(unit);
+            if (err && (unit->u_WBCount > 0))
+            {
+                return err;
+            }
+        }
+
+        e = &unit->u_WBExtents[unit->u_WBCount++];
+        e->we_Offset = offset;
+        e->we_Length = length;
+        e->we_Data = unit->u_WBBuffer + unit->u_WBUsed;
+    }
+
+    CopyMem(ioreq->io_Data, unit->u_WBBuffer + unit->u_WBUsed, length);
+    unit->u_WBUsed += length;
+
+    return 0;
+}
+
+static LONG wb_write(SBP2Unit *unit, UQUAD offset, const SBP2Segment *segs, ULONG nsegs, ULONG length)
+{
+    UBYTE cmd10[10];
+    struct SCSICmd scsicmd;
+    UBYTE sensedata[18];
+    ULONG blocks = length >> unit->u_BlockShift;
+    ULONG startblock = offset >> unit->u_BlockShift;
+
+    _INFO("Write-back: %lu bytes at $%llx, %lu segment(s)\n", length, offset, nsegs);
+
+    scsicmd.scsi_Data = (UWORD *) segs[0].sg_Data;
+    scsicmd.scsi_Length = length;
+    scsicmd.scsi_Command = cmd10;
+    scsicmd.scsi_CmdLength = 10;
+    scsicmd.scsi_Flags = SCSIF_WRITE|SCSIF_AUTOSENSE;
+    scsicmd.scsi_SenseData = sensedata;
+    scsicmd.scsi_SenseLength = 18;
+    cmd10[0] = SCSI_DA_WRITE_10;
+    cmd10[1] = 0;
+    *((ULONG *) (&cmd10[2])) = LE_SWAPLONG(startblock);
+    cmd10[6] = 0;
+    cmd10[7] = blocks >> 8;
+    cmd10[8] = blocks;
+    cmd10[9] = 0;
+
+    if (1 == nsegs)
+    {
+        return sbp2_do_scsi_cmd(unit, &scsicmd, ORB_TIMEOUT);
+    }
+
+    return sbp2_do_scsi_cmd_sg(unit, &scsicmd, segs, nsegs, ORB_TIMEOUT);
+}
+
+/*============================================================================*/
+/*--- PUBLIC CODE ------------------------------------------------------------*/
+/*============================================================================*/
+
+/* Allocate a buffer of size bytes, 0 disables the stage */
+BOOL sbp2_wb_init(SBP2Unit *unit, ULONG size)
+{
+    unit->u_WBSize = 0;
+    unit->u_WBUsed = 0;
+    unit->u_WBCount = 0;
+    unit->u_WBError = 0;
+    unit->u_WBRetries = 0;
+
+    if (0 == size)
+    {
+        return TRUE;
+    }
+
+    unit->u_WBBuffer = AllocVecDMA(size, MEMF_PUBLIC);
+    if (NULL == unit->u_WBBuffer)
+    {
+        _ERR("Write-back: failed to allocate %lu bytes\n", size);
+        return FALSE;
+    }
+
+    unit->u_WBSize = size;
+    _INFO("Write-back: %lu bytes\n", size);
+
+    return TRUE;
+}
+
+/* Release the buffer, dirty data or a pending error are reported as lost */
+void sbp2_wb_cleanup(SBP2Unit *unit)
+{
+    if (unit->u_WBCount > 0)
+    {
+        _ERR("Write-back: %lu extent(s) lost\n", unit->u_WBCount);
+        Helios_ReportMsg(HRMB_ERROR, "SBP2", "Unit #%u: %u bytes of written data lost (write-back)",
+                         unit->u_UnitNo, unit->u_WBUsed);
+    }
+    else if (unit->u_WBError)
+    {
+        Helios_ReportMsg(HRMB_ERROR, "SBP2", "Unit #%u: written data lost (write-back, err=%ld)",
+                         unit->u_UnitNo, unit->u_WBError);
+    }
+
+    if (NULL != unit->u_WBBuffer)
+    {
+        FreeVecDMA(unit->u_WBBuffer);
+        unit->u_WBBuffer = NULL;
+    }
+
+    unit->u_WBSize = 0;
+    unit->u_WBUsed = 0;
+    unit->u_WBCount = 0;
+    unit->u_WBError = 0;
+}
+
+/* Called for each group given by the scheduler.
+ * Returns TRUE if the ioreqs have been absorbed and replied, else the group
+ * must be executed after the dirty data it depends on are written.
+ */
+BOOL sbp2_wb_dispatch(SBP2Unit *unit, struct IOStdReq **ioreqs, ULONG count)
+{
+    ULONG i;
+    LONG err;
+
+    if (0 == unit->u_WBSize)
+    {
+        return FALSE;
+    }
+
+    switch (ioreqs[0]->io_Command)
+    {
+        case CMD_WRITE:
+        case TD_WRITE64:
+            /* Dropped data are reported by the next write */
+            if (unit->u_WBError)
+            {
+                wb_fail(ioreqs, count, unit->u_WBError);
+                unit->u_WBError = 0;
+                return TRUE;
+            }
+
+            for (i=0; i < count; i++)
+            {
+                if (!wb_absorbable(unit, ioreqs[i]))
+                {
+                    /* Kept data must not be written over the new ones later */
+                    err = sbp2_wb_flush(unit);
+                    if (err && (unit->u_WBCount > 0))
+                    {
+                        wb_fail(ioreqs, count, err);
+                        return TRUE;
+                    }
+                    return FALSE;
+                }
+            }
+
+            for (i=0; i < count; i++)
+            {
+                err = wb_absorb(unit, ioreqs[i]);
+                ioreqs[i]->io_Error = err;
+                ioreqs[i]->io_Actual = err ? 0 : ioreqs[i]->io_Length;
+                ReplyMsg(&ioreqs[i]->io_Message);
+            }
+            return TRUE;
+
+        case CMD_READ:
+        case TD_READ64:
+            for (i=0; i < count; i++)
+            {
+                if (sbp2_wb_overlaps(unit, IOREQ_OFFSET64(ioreqs[i]), ioreqs[i]->io_Length))
+                {
+                    /* The medium does not have the data yet */
+                    err = sbp2_wb_flush(unit);
+                    if (err && (unit->u_WBCount > 0))
+                    {
+                        wb_fail(ioreqs, count, err);
+                        return TRUE;
+                    }
+                    break;
+                }
+            }
+            return FALSE;
+
+        case CMD_UPDATE:
+        case TD_MOTOR:
+            err = sbp2_wb_flush(unit);
+            if (err && (unit->u_WBCount > 0))
+            {
+                wb_fail(ioreqs, count, err);
+                return TRUE;
+            }
+            return FALSE;
+
+        default:
+            sbp2_wb_flush(unit);
+            return FALSE;
+    }
+}
+
+/* Write all dirty extents.
+ * On a transient error all extents are kept, the written ones being written
+ * again by the retry. Otherwise data are dropped, the error is kept in
+ * u_WBError for the next write or CMD_UPDATE.
+ */
+LONG sbp2_wb_flush(SBP2Unit *unit)
+{
+    SBP2WBExtent *sorted[SBP2_WB_EXTENTS];
+    SBP2Segment segs[SBP2_WB_EXTENTS];
+    ULONG i, j, count = unit->u_WBCount, pos=0, limit;
+    LONG err=0;
+
+    if (0 == count)
+    {
+        return 0;
+    }
+
+    /* Insertion sort by offset */
+    for (i=0; i < count; i++)
+    {
+        SBP2WBExtent *e = &unit->u_WBExtents[i];
+
+        for (j=i; (j > 0) && (sorted[j-1]->we_Offset > e->we_Offset); j--)
+        {
+            sorted[j] = sorted[j-1];
+        }
+        sorted[j] = e;
+    }
+
+    limit = MIN(unit->u_MaxTransfer, 0xffff << unit->u_BlockShift);
+
+    /* Adjacent extents are segments of the same command */
+    i = 0;
+    while ((i < count) && !err)
+    {
+        UQUAD start = sorted[i]->we_Offset + pos;
+        ULONG nsegs=0, total=0;
+
+        while ((i < count) && (total < limit))
+        {
+            SBP2WBExtent *e = sorted[i];
+            ULONG length;
+
+            if ((nsegs > 0) && (e->we_Offset != (start + total)))
+            {
+                break;
+            }
+
+            length = MIN(e->we_Length - pos, limit - total);
+            segs[nsegs].sg_Data = e->we_Data + pos;
+            segs[nsegs++].sg_Length = length;
+            total += length;
+            pos += length;
+
+            if (pos == e->we_Length)
+            {
+                pos = 0;
+                i++;
+            }
+        }
+
+        err = wb_write(unit, start, segs, nsegs, total);
+    }
+
+    if (err)
+    {
+        /* A unit not ready waits for the reconnect, retries are not counted */
+        if (wb_transient(err) &&
+            (!unit->u_Flags.Ready || (++unit->u_WBRetries < SBP2_WB_RETRIES)))
+        {
+            _WARN("Write-back: flush failed, err=%ld, %lu extent(s) kept\n", err, count);
+            return err;
+        }
+
+        _ERR("Write-back: flush failed, err=%ld, %lu extent(s) lost\n", err, count - i);
+        unit->u_WBError = err;
+    }
+
+    unit->u_WBCount = 0;
+    unit->u_WBUsed = 0;
+    unit->u_WBRetries = 0;
+
+    return err;
+}
+
+/* TRUE if dirty data are in the range */
+BOOL sbp2_wb_overlaps(SBP2Unit *unit, UQUAD offset, ULONG length)
+{
+    ULONG i;
+
+    for (i=0; i < unit->u_WBCount; i++)
+    {
+        SBP2WBExtent *e = &unit->u_WBExtents[i];
+
+        if ((offset < (e->we_Offset + e->we_Length)) && (e->we_Offset < (offset + length)))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Drop dirty data, the medium has changed */
+void sbp2_wb_discard(SBP2Unit *unit)
+{
+    if (unit->u_WBCount > 0)
+    {
+        _ERR("Write-back: medium changed, %lu extent(s) dropped\n", unit->u_WBCount);
+        unit->u_WBError = TDERR_DiskChanged;
+    }
+
+    unit->u_WBCount = 0;
+    unit->u_WBUsed = 0;
+    unit->u_WBRetries = 0;
+}
+
+/* EOF */
@@ -0,0 +1,38 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** SBP2 class write-back stage header file.
+**
+*/
+
+#ifndef SBP2_WBACK_H
+#define SBP2_WBACK_H
+
+#include "sbp2.class.h"
+
+extern BOOL sbp2_wb_init(SBP2Unit *unit, ULONG size);
+extern void sbp2_wb_cleanup(SBP2Unit *unit);
+extern BOOL sbp2_wb_dispatch(SBP2Unit *unit, struct IOStdReq **ioreqs, ULONG count);
+extern LONG sbp2_wb_flush(SBP2Unit *unit);
+extern BOOL sbp2_wb_overlaps(SBP2Unit *unit, UQUAD offset, ULONG length);
+extern void sbp2_wb_discard(SBP2Unit *unit);
+
+#endif /* SBP2_WBACK_H */
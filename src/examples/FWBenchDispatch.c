@@ -0,0 +1,332 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Register 1, 64 and 1024 request handlers, then receive COUNT write
+** requests of SIZE bytes on the last registered one, and print the
+** registration time and the packets/s for each handlers count.
+** Requires a device built with SIMULATOR=1: the requests are sent by the
+** write block generator of the simulated node 0 (see ohci1394sim.h).
+**
+*/
+
+#include "proto/helios.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+#include <clib/macros.h>
+#include <string.h>
+
+#define MAX_SIZE 2048
+#define MAX_HANDLERS 1024
+#define HANDLER_LENGTH 0x100
+
+/* OHCISIM_PEER_GENERATOR: count, length, offset hi, offset lo */
+#define SIM_GENERATOR_OFFSET 0x10000
+
+struct Library *HeliosBase;
+struct Library *TimerBase;
+static const UBYTE template[] = "HW_ID/N,NODE_ID/N,COUNT/N,SIZE/N";
+
+static struct
+{
+    LONG *hwno;
+    LONG *nodeid;
+    LONG *count;
+    LONG *size;
+} args;
+
+static struct
+{
+    struct Task *       task;
+    ULONG               signal;
+    ULONG               expected;
+    ULONG               received;
+    ULONG               errors;
+} bench_data;
+
+static const ULONG handler_counts[] = {1, 64, MAX_HANDLERS};
+static HeliosHWReqHandler handlers[MAX_HANDLERS];
+static HeliosResponse complete_response =
+{
+    {RCode : HELIOS_RCODE_COMPLETE},
+    NULL, 0, 0, 0
+};
+
+static ULONG elapsed_us(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_secs - start->tv_secs) * 1000000 + end->tv_micro - start->tv_micro;
+}
+
+static HeliosResponse *bench_reqhandler(HeliosAPacket *request, APTR udata)
+{
+    /* Only the last handler shall be called */
+    if ((TCODE_WRITE_BLOCK_REQUEST != request->TCode) || (NULL == udata))
+    {
+        bench_data.errors++;
+    }
+
+    if (++bench_data.received == bench_data.expected)
+    {
+        Signal(bench_data.task, bench_data.signal);
+    }
+
+    return &complete_response;
+}
+
+static LONG send_generator(HeliosDevice *dev, ULONG count, ULONG size, HeliosOffset offset)
+{
+    IOHeliosHWSendRequest ioreq;
+    HeliosAPacket *p;
+    QUADLET gen[4];
+    LONG err;
+
+    gen[0] = count;
+    gen[1] = size;
+    gen[2] = offset >> 32;
+    gen[3] = offset;
+
+    bzero(&ioreq, sizeof(ioreq));
+    ioreq.iohhe_Req.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+    ioreq.iohhe_Req.iohh_Req.io_Command = HHIOCMD_SENDREQUEST;
+    ioreq.iohhe_Device = dev;
+    p = &ioreq.iohhe_Transaction.htr_Packet;
+    Helios_FillWriteBlockPacket(p, S400, SIM_GENERATOR_OFFSET, gen, sizeof(gen));
+
+    err = Helios_DoIO(HGA_DEVICE, dev, &ioreq.iohhe_Req);
+    if (err || (HELIOS_RCODE_COMPLETE != p->RCode))
+    {
+        Printf("Generator start failed, io err=%ld, RCode=%ld\n", err, p->RCode);
+        return err ? err : -1;
+    }
+
+    return 0;
+}
+
+static LONG bench(HeliosDevice *dev, ULONG nhandlers, ULONG count, ULONG size,
+                  ULONG *reg_us, ULONG *recv_us)
+{
+    IOHeliosHWReq h_ioreq;
+    struct timeval start, end;
+    ULONG i, registered, sigs;
+    LONG err = 0;
+
+    bench_data.expected = count;
+    bench_data.received = 0;
+    bench_data.errors = 0;
+
+    bzero(&h_ioreq, sizeof(h_ioreq));
+    h_ioreq.iohh_Req.io_Message.mn_Length = sizeof(h_ioreq);
+    h_ioreq.iohh_Req.io_Command = HHIOCMD_ADDREQHANDLER;
+
+    GetSysTime(&start);
+    for (registered=0; registered < nhandlers; registered++)
+    {
+        HeliosHWReqHandler *reqh = &handlers[registered];
+
+        bzero(reqh, sizeof(*reqh));
+        reqh->rh_RegionStart = HELIOS_HIGHMEM_START;
+        reqh->rh_RegionStop = HELIOS_HIGHMEM_STOP;
+        reqh->rh_Length = HANDLER_LENGTH;
+        reqh->rh_Flags = HHF_REQH_ALLOCLEN;
+        reqh->rh_ReqCallback = bench_reqhandler;
+        reqh->rh_UserData = (registered == (nhandlers - 1)) ? reqh : NULL;
+
+        h_ioreq.iohh_Data = reqh;
+        err = Helios_DoIO(HGA_DEVICE, dev, &h_ioreq);
+        if (err)
+        {
+            Printf("HHIOCMD_ADDREQHANDLER failed, io err=%ld\n", err);
+            break;
+        }
+    }
+    GetSysTime(&end);
+    *reg_us = elapsed_us(&start, &end);
+
+    if (!err)
+    {
+        SetSignal(0, bench_data.signal);
+
+        GetSysTime(&start);
+        err = send_generator(dev, count, size, handlers[nhandlers-1].rh_Start);
+        if (!err)
+        {
+            sigs = Wait(bench_data.signal | SIGBREAKF_CTRL_C);
+            if (0 == (sigs & bench_data.signal))
+            {
+                Printf("Break (%lu requests received)\n", bench_data.received);
+                err = -1;
+            }
+        }
+        GetSysTime(&end);
+        *recv_us = elapsed_us(&start, &end);
+    }
+
+    h_ioreq.iohh_Req.io_Command = HHIOCMD_REMREQHANDLER;
+    for (i=0; i < registered; i++)
+    {
+        h_ioreq.iohh_Data = &handlers[i];
+        Helios_DoIO(HGA_DEVICE, dev, &h_ioreq);
+    }
+
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    APTR rdargs;
+    LONG res=RETURN_FAIL, hwno=0;
+    UWORD nodeid=0xffc0;
+    ULONG count=10000, size=8;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL != rdargs)
+    {
+        if (NULL != args.hwno)
+        {
+            hwno = *args.hwno;
+        }
+        if (NULL != args.nodeid)
+        {
+            nodeid = *args.nodeid;
+        }
+        if (NULL != args.count)
+        {
+            count = MAX(*args.count, 1);
+        }
+        if (NULL != args.size)
+        {
+            size = MIN(MAX(*args.size, 4), MAX_SIZE) & ~3;
+        }
+    }
+    else
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    HeliosBase = OpenLibrary("helios.library", 52);
+    if (NULL != HeliosBase)
+    {
+        ULONG cnt=0;
+        HeliosHardware *hw = NULL;
+        HeliosDevice *dev=NULL;
+
+        Helios_WriteLockBase();
+        {
+            while (NULL != (hw = Helios_GetNextHardware(hw)))
+            {
+                if (hwno == cnt++)
+                {
+                    while (NULL != (dev = Helios_GetNextDevice(dev,
+                                                               HA_Hardware, (ULONG)hw,
+                                                               TAG_DONE)))
+                    {
+                        ULONG value;
+
+                        if (1 == Helios_GetAttrs(HGA_DEVICE, dev,
+                                                 HA_NodeID, (ULONG)&value,
+                                                 TAG_DONE))
+                        {
+                            if (value == nodeid)
+                            {
+                                break;
+                            }
+                        }
+
+                        Helios_ReleaseDevice(dev);
+                    }
+
+                    break;
+                }
+
+                Helios_ReleaseHardware(hw);
+            }
+        }
+        Helios_UnlockBase();
+
+        if (NULL != dev)
+        {
+            struct timerequest tr;
+            BYTE sigbit;
+
+            bzero(&tr, sizeof(tr));
+            tr.tr_node.io_Message.mn_Length = sizeof(tr);
+            sigbit = AllocSignal(-1);
+            if (-1 == sigbit)
+            {
+                Printf("AllocSignal() failed\n");
+            }
+            else if (!OpenDevice(TIMERNAME, UNIT_MICROHZ, &tr.tr_node, 0))
+            {
+                ULONG i, reg_us, recv_us;
+
+                TimerBase = (struct Library *)tr.tr_node.io_Device;
+                bench_data.task = FindTask(NULL);
+                bench_data.signal = 1ul << sigbit;
+
+                Printf("Node %04lx: %lu write requests of %lu bytes\n", nodeid, count, size);
+                Printf("%8s %14s %12s %10s %8s\n", (ULONG)"handlers", (ULONG)"register (us)",
+                       (ULONG)"time (us)", (ULONG)"packets/s", (ULONG)"errors");
+
+                res = RETURN_OK;
+                for (i=0; i < (sizeof(handler_counts)/sizeof(*handler_counts)); i++)
+                {
+                    if (bench(dev, handler_counts[i], count, size, &reg_us, &recv_us))
+                    {
+                        res = RETURN_ERROR;
+                        break;
+                    }
+
+                    recv_us = MAX(recv_us, 1);
+                    Printf("%8lu %14lu %12lu %10lu %8lu\n", handler_counts[i], reg_us, recv_us,
+                           (ULONG)(((UQUAD)count * 1000000) / recv_us), bench_data.errors);
+                }
+
+                CloseDevice(&tr.tr_node);
+            }
+            else
+            {
+                Printf("Failed to open %s\n", (ULONG)TIMERNAME);
+            }
+
+            if (-1 != sigbit)
+            {
+                FreeSignal(sigbit);
+            }
+
+            Helios_ReleaseDevice(dev);
+        }
+        else
+        {
+            Printf("No device with node ID %04lx\n", nodeid);
+        }
+
+        if (NULL != hw)
+        {
+            Helios_ReleaseHardware(hw);
+        }
+
+        CloseLibrary(HeliosBase);
+    }
+
+    return res;
+}
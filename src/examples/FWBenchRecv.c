@@ -0,0 +1,328 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Receive COUNT write block requests of SIZE bytes from a node, first with
+** a request handler copying the payload, then with a HHF_REQH_ZEROCOPY one,
+** and print packets/s and KB/s for both.
+** Requires a device built with SIMULATOR=1: the requests are sent by the
+** write block generator of the simulated node 0 (see ohci1394sim.h).
+**
+*/
+
+#include "proto/helios.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+#include <clib/macros.h>
+#include <string.h>
+
+#define MAX_SIZE 2048
+
+/* OHCISIM_PEER_GENERATOR: count, length, offset hi, offset lo */
+#define SIM_GENERATOR_OFFSET 0x10000
+
+struct Library *HeliosBase;
+struct Library *TimerBase;
+static const UBYTE template[] = "HW_ID/N,NODE_ID/N,COUNT/N,SIZE/N";
+
+static struct
+{
+    LONG *hwno;
+    LONG *nodeid;
+    LONG *count;
+    LONG *size;
+} args;
+
+static struct
+{
+    HeliosHWReqHandler  reqh;
+    struct Task *       task;
+    ULONG               signal;
+    ULONG               expected;
+    ULONG               received;
+    ULONG               errors;
+    QUADLET             sum;
+} bench_data;
+
+static HeliosResponse complete_response =
+{
+    {RCode : HELIOS_RCODE_COMPLETE},
+    NULL, 0, 0, 0
+};
+static QUADLET copy_buffer[MAX_SIZE/sizeof(QUADLET)];
+
+static ULONG elapsed_us(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_secs - start->tv_secs) * 1000000 + end->tv_micro - start->tv_micro;
+}
+
+static void bench_received(HeliosAPacket *request)
+{
+    if ((TCODE_WRITE_BLOCK_REQUEST != request->TCode) || (NULL == request->Payload))
+    {
+        bench_data.errors++;
+    }
+
+    if (++bench_data.received == bench_data.expected)
+    {
+        Signal(bench_data.task, bench_data.signal);
+    }
+}
+
+/* Usual handler: the payload is only valid during the call */
+static HeliosResponse *bench_copy_reqhandler(HeliosAPacket *request, APTR udata)
+{
+    if (NULL != request->Payload)
+    {
+        CopyMem(request->Payload, copy_buffer, MIN(request->PayloadLength, sizeof(copy_buffer)));
+        bench_data.sum += copy_buffer[0];
+    }
+
+    bench_received(request);
+    return &complete_response;
+}
+
+/* Zero-copy handler: the payload is read in the DMA buffer then given back */
+static HeliosResponse *bench_zerocopy_reqhandler(HeliosAPacket *request, APTR udata)
+{
+    if ((NULL != request->Payload) && (request->PayloadLength > 0))
+    {
+        bench_data.sum += request->Payload[0];
+        bench_data.reqh.rh_Release(&bench_data.reqh, request->Payload);
+    }
+
+    bench_received(request);
+    return &complete_response;
+}
+
+static LONG bench(HeliosDevice *dev, ULONG count, ULONG size, BOOL zerocopy)
+{
+    IOHeliosHWSendRequest ioreq;
+    IOHeliosHWReq h_ioreq;
+    HeliosAPacket *p;
+    QUADLET gen[4];
+    ULONG sigs;
+    LONG err;
+
+    bzero(&bench_data.reqh, sizeof(bench_data.reqh));
+    bench_data.reqh.rh_RegionStart = HELIOS_HIGHMEM_START;
+    bench_data.reqh.rh_RegionStop = HELIOS_HIGHMEM_STOP;
+    bench_data.reqh.rh_Length = MAX_SIZE;
+    bench_data.reqh.rh_Flags = HHF_REQH_ALLOCLEN | (zerocopy ? HHF_REQH_ZEROCOPY : 0);
+    bench_data.reqh.rh_ReqCallback = zerocopy ? bench_zerocopy_reqhandler : bench_copy_reqhandler;
+    bench_data.expected = count;
+    bench_data.received = 0;
+    bench_data.errors = 0;
+
+    bzero(&h_ioreq, sizeof(h_ioreq));
+    h_ioreq.iohh_Req.io_Message.mn_Length = sizeof(h_ioreq);
+    h_ioreq.iohh_Req.io_Command = HHIOCMD_ADDREQHANDLER;
+    h_ioreq.iohh_Data = &bench_data.reqh;
+
+    err = Helios_DoIO(HGA_DEVICE, dev, &h_ioreq);
+    if (err)
+    {
+        Printf("HHIOCMD_ADDREQHANDLER failed, io err=%ld\n", err);
+        return err;
+    }
+
+    /* Start the generator of the simulated node */
+    gen[0] = count;
+    gen[1] = size;
+    gen[2] = bench_data.reqh.rh_Start >> 32;
+    gen[3] = bench_data.reqh.rh_Start;
+
+    bzero(&ioreq, sizeof(ioreq));
+    ioreq.iohhe_Req.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+    ioreq.iohhe_Device = dev;
+    p = &ioreq.iohhe_Transaction.htr_Packet;
+    Helios_FillWriteBlockPacket(p, S400, SIM_GENERATOR_OFFSET, gen, sizeof(gen));
+    ioreq.iohhe_Req.iohh_Req.io_Command = HHIOCMD_SENDREQUEST;
+
+    SetSignal(0, bench_data.signal);
+    err = Helios_DoIO(HGA_DEVICE, dev, &ioreq.iohhe_Req);
+    if (err || (HELIOS_RCODE_COMPLETE != p->RCode))
+    {
+        Printf("Generator start failed, io err=%ld, RCode=%ld\n", err, p->RCode);
+        err = err ? err : -1;
+    }
+    else
+    {
+        sigs = Wait(bench_data.signal | SIGBREAKF_CTRL_C);
+        if (0 == (sigs & bench_data.signal))
+        {
+            Printf("Break (%lu requests received)\n", bench_data.received);
+            err = -1;
+        }
+    }
+
+    h_ioreq.iohh_Req.io_Command = HHIOCMD_REMREQHANDLER;
+    Helios_DoIO(HGA_DEVICE, dev, &h_ioreq);
+
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    APTR rdargs;
+    LONG res=RETURN_FAIL, hwno=0;
+    UWORD nodeid=0xffc0;
+    ULONG count=10000, size=2048;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL != rdargs)
+    {
+        if (NULL != args.hwno)
+        {
+            hwno = *args.hwno;
+        }
+        if (NULL != args.nodeid)
+        {
+            nodeid = *args.nodeid;
+        }
+        if (NULL != args.count)
+        {
+            count = MAX(*args.count, 1);
+        }
+        if (NULL != args.size)
+        {
+            size = MIN(MAX(*args.size, 4), MAX_SIZE) & ~3;
+        }
+    }
+    else
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    HeliosBase = OpenLibrary("helios.library", 52);
+    if (NULL != HeliosBase)
+    {
+        ULONG cnt=0;
+        HeliosHardware *hw = NULL;
+        HeliosDevice *dev=NULL;
+
+        Helios_WriteLockBase();
+        {
+            while (NULL != (hw = Helios_GetNextHardware(hw)))
+            {
+                if (hwno == cnt++)
+                {
+                    while (NULL != (dev = Helios_GetNextDevice(dev,
+                                                               HA_Hardware, (ULONG)hw,
+                                                               TAG_DONE)))
+                    {
+                        ULONG value;
+
+                        if (1 == Helios_GetAttrs(HGA_DEVICE, dev,
+                                                 HA_NodeID, (ULONG)&value,
+                                                 TAG_DONE))
+                        {
+                            if (value == nodeid)
+                            {
+                                break;
+                            }
+                        }
+
+                        Helios_ReleaseDevice(dev);
+                    }
+
+                    break;
+                }
+
+                Helios_ReleaseHardware(hw);
+            }
+        }
+        Helios_UnlockBase();
+
+        if (NULL != dev)
+        {
+            struct timerequest tr;
+            BYTE sigbit;
+
+            bzero(&tr, sizeof(tr));
+            tr.tr_node.io_Message.mn_Length = sizeof(tr);
+            sigbit = AllocSignal(-1);
+            if (-1 == sigbit)
+            {
+                Printf("AllocSignal() failed\n");
+            }
+            else if (!OpenDevice(TIMERNAME, UNIT_MICROHZ, &tr.tr_node, 0))
+            {
+                struct timeval start, end;
+                ULONG mode, us;
+
+                TimerBase = (struct Library *)tr.tr_node.io_Device;
+                bench_data.task = FindTask(NULL);
+                bench_data.signal = 1ul << sigbit;
+
+                Printf("Node %04lx: %lu write requests of %lu bytes\n", nodeid, count, size);
+                Printf("%8s %12s %10s %10s %8s\n", (ULONG)"handler", (ULONG)"time (us)",
+                       (ULONG)"packets/s", (ULONG)"KB/s", (ULONG)"errors");
+
+                res = RETURN_OK;
+                for (mode=0; mode < 2; mode++)
+                {
+                    GetSysTime(&start);
+                    if (bench(dev, count, size, mode))
+                    {
+                        res = RETURN_ERROR;
+                        break;
+                    }
+                    GetSysTime(&end);
+
+                    us = MAX(elapsed_us(&start, &end), 1);
+                    Printf("%8s %12lu %10lu %10lu %8lu\n", (ULONG)(mode ? "zerocopy" : "copy"), us,
+                           (ULONG)(((UQUAD)count * 1000000) / us),
+                           (ULONG)(((UQUAD)count * size * 1000000) / 1024 / us),
+                           bench_data.errors);
+                }
+
+                CloseDevice(&tr.tr_node);
+            }
+            else
+            {
+                Printf("Failed to open %s\n", (ULONG)TIMERNAME);
+            }
+
+            if (-1 != sigbit)
+            {
+                FreeSignal(sigbit);
+            }
+
+            Helios_ReleaseDevice(dev);
+        }
+        else
+        {
+            Printf("No device with node ID %04lx\n", nodeid);
+        }
+
+        if (NULL != hw)
+        {
+            Helios_ReleaseHardware(hw);
+        }
+
+        CloseLibrary(HeliosBase);
+    }
+
+    return res;
+}
@@ -0,0 +1,241 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Read COUNT blocks of SIZE bytes from a sbp2.device unit, keeping 1, 2, 4...
+** up to DEPTH TD_READ64 requests outstanding, and print MB/s and IOPS for
+** each queue depth.
+** The driver links up to helios_sbp2_queuedepth command ORBs on the target
+** fetch agent (env var, 0 = one ORB at a time).
+** Run it on a device built with SIMULATOR=1 SIMULATOR_SBP2=1: the simulated
+** node 0 is a SBP-2 disk with a fixed command cost and transfer rate
+** (see ohci1394sim.h).
+**
+*/
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+#include <devices/trackdisk.h>
+#include <clib/macros.h>
+#include <string.h>
+
+#define MAX_DEPTH 32
+
+struct Library *TimerBase;
+static const UBYTE template[] = "DEVICE,UNIT/N,SIZE/N,COUNT/N,DEPTH/N";
+
+static struct
+{
+    STRPTR device;
+    LONG *unit;
+    LONG *size;
+    LONG *count;
+    LONG *depth;
+} args;
+
+static struct IOStdReq ioreqs[MAX_DEPTH];
+static APTR buffers[MAX_DEPTH];
+
+static ULONG elapsed_us(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_secs - start->tv_secs) * 1000000 + end->tv_micro - start->tv_micro;
+}
+
+static void send_read(struct IOStdReq *ioreq, APTR buffer, ULONG size, UQUAD offset)
+{
+    ioreq->io_Command = TD_READ64;
+    ioreq->io_Data = buffer;
+    ioreq->io_Length = size;
+    ioreq->io_Actual = offset >> 32;
+    ioreq->io_Offset = offset;
+    SendIO((struct IORequest *)ioreq);
+}
+
+/* Keep depth reads in flight until count are done, returns the failed count.
+ * A CTRL-C stops sending new reads.
+ */
+static ULONG bench(ULONG depth, ULONG size, ULONG count)
+{
+    struct MsgPort *port = ioreqs[0].io_Message.mn_ReplyPort;
+    ULONG i, sent=0, done=0, failed=0;
+
+    for (i=0; (i < depth) && (sent < count); i++, sent++)
+    {
+        send_read(&ioreqs[i], buffers[i], size, (UQUAD)sent * size);
+    }
+
+    while (done < sent)
+    {
+        struct IOStdReq *ioreq;
+
+        WaitPort(port);
+        while (NULL != (ioreq = (struct IOStdReq *)GetMsg(port)))
+        {
+            done++;
+            if (ioreq->io_Error || (ioreq->io_Actual != size))
+            {
+                failed++;
+            }
+
+            if ((sent < count) && !(SetSignal(0, 0) & SIGBREAKF_CTRL_C))
+            {
+                send_read(ioreq, ioreq->io_Data, size, (UQUAD)sent * size);
+                sent++;
+            }
+        }
+    }
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    APTR rdargs;
+    LONG res=RETURN_FAIL, unit=0;
+    STRPTR device="sbp2.device";
+    ULONG size=65536, count=2000, depth=MAX_DEPTH;
+    struct MsgPort *port;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL != rdargs)
+    {
+        if (NULL != args.device)
+        {
+            device = args.device;
+        }
+        if (NULL != args.unit)
+        {
+            unit = *args.unit;
+        }
+        if (NULL != args.size)
+        {
+            size = MIN(MAX(*args.size, 512), 1ul<<21) & ~511;
+        }
+        if (NULL != args.count)
+        {
+            count = MAX(*args.count, 1);
+        }
+        if (NULL != args.depth)
+        {
+            depth = MIN(MAX(*args.depth, 1), MAX_DEPTH);
+        }
+    }
+    else
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    port = CreateMsgPort();
+    if (NULL != port)
+    {
+        struct timerequest tr;
+        ULONG i;
+
+        bzero(&tr, sizeof(tr));
+        tr.tr_node.io_Message.mn_Length = sizeof(tr);
+
+        for (i=0; i < depth; i++)
+        {
+            ioreqs[i].io_Message.mn_Length = sizeof(ioreqs[i]);
+            ioreqs[i].io_Message.mn_ReplyPort = port;
+            buffers[i] = AllocVec(size, MEMF_PUBLIC);
+            if (NULL == buffers[i])
+            {
+                break;
+            }
+        }
+
+        if (i < depth)
+        {
+            Printf("Not enough memory\n");
+        }
+        else if (OpenDevice(device, unit, (struct IORequest *)&ioreqs[0], 0))
+        {
+            Printf("Failed to open %s unit %ld\n", (ULONG)device, unit);
+        }
+        else
+        {
+            for (i=1; i < depth; i++)
+            {
+                ioreqs[i].io_Device = ioreqs[0].io_Device;
+                ioreqs[i].io_Unit = ioreqs[0].io_Unit;
+            }
+
+            if (!OpenDevice(TIMERNAME, UNIT_MICROHZ, &tr.tr_node, 0))
+            {
+                struct timeval start, end;
+                ULONG n, us, failed;
+
+                TimerBase = (struct Library *)tr.tr_node.io_Device;
+
+                Printf("%s unit %ld: %lu reads of %lu bytes\n", (ULONG)device, unit, count, size);
+                Printf("%6s %12s %10s %10s %8s\n", (ULONG)"depth", (ULONG)"time (us)",
+                       (ULONG)"MB/s", (ULONG)"IOPS", (ULONG)"failed");
+
+                res = RETURN_OK;
+                for (n=1; n <= depth; n <<= 1)
+                {
+                    GetSysTime(&start);
+                    failed = bench(n, size, count);
+                    GetSysTime(&end);
+
+                    us = MAX(elapsed_us(&start, &end), 1);
+                    Printf("%6lu %12lu %10lu %10lu %8lu\n", n, us,
+                           (ULONG)(((UQUAD)count * size) / us),
+                           (ULONG)(((UQUAD)count * 1000000) / us),
+                           failed);
+
+                    if (failed)
+                    {
+                        res = RETURN_WARN;
+                    }
+
+                    if (SetSignal(0, SIGBREAKF_CTRL_C) & SIGBREAKF_CTRL_C)
+                    {
+                        Printf("Break\n");
+                        res = RETURN_ERROR;
+                        break;
+                    }
+                }
+
+                CloseDevice(&tr.tr_node);
+            }
+            else
+            {
+                Printf("Failed to open %s\n", (ULONG)TIMERNAME);
+            }
+
+            CloseDevice((struct IORequest *)&ioreqs[0]);
+        }
+
+        for (i=0; i < depth; i++)
+        {
+            FreeVec(buffers[i]);
+        }
+
+        DeleteMsgPort(port);
+    }
+
+    FreeArgs(rdargs);
+    return res;
+}
@@ -0,0 +1,345 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Compare the sbp2.device IO schedulers: for each policy, set the
+** helios_sbp2_scheduler env var, reset the bus HW_ID so the unit reads it
+** again, then send COUNT TD_READ64 of SIZE bytes with DEPTH outstanding.
+** Reads come round-robin from STREAMS sequential streams, each one jumping
+** to a random offset every 64 reads: the sorted policies merge the streams
+** and save seeks. The same offsets are used for each policy.
+** Run it on a device built with SIMULATOR=1 SIMULATOR_SBP2=1: the simulated
+** node 0 is a SBP-2 disk with a seek time (see ohci1394sim.h).
+** Reads over helios_sbp2_queuedepth wait in the scheduler, keep DEPTH above it.
+**
+*/
+
+#include "proto/helios.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+#include <devices/trackdisk.h>
+#include <dos/var.h>
+#include <clib/macros.h>
+#include <string.h>
+
+#define MAX_DEPTH 64
+#define MAX_STREAMS 16
+#define STREAM_RUN 64
+
+struct Library *HeliosBase;
+struct Library *TimerBase;
+static const UBYTE template[] = "DEVICE,UNIT/N,HW_ID/N,SIZE/N,COUNT/N,DEPTH/N,STREAMS/N";
+
+static struct
+{
+    STRPTR device;
+    LONG *unit;
+    LONG *hwno;
+    LONG *size;
+    LONG *count;
+    LONG *depth;
+    LONG *streams;
+} args;
+
+static const STRPTR policies[] = {"fifo", "cscan", "deadline", NULL};
+
+static struct IOStdReq ioreqs[MAX_DEPTH];
+static APTR buffers[MAX_DEPTH];
+static UQUAD stream_offsets[MAX_STREAMS];
+static ULONG seed;
+
+static ULONG elapsed_us(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_secs - start->tv_secs) * 1000000 + end->tv_micro - start->tv_micro;
+}
+
+static ULONG bench_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/* Offset of the n-th read */
+static UQUAD next_offset(ULONG n, ULONG streams, ULONG size, ULONG slots)
+{
+    ULONG s = n % streams;
+
+    if (0 == ((n / streams) % STREAM_RUN))
+    {
+        stream_offsets[s] = (UQUAD)(bench_random() % (slots - STREAM_RUN)) * size;
+    }
+    else
+    {
+        stream_offsets[s] += size;
+    }
+
+    return stream_offsets[s];
+}
+
+static void send_read(struct IOStdReq *ioreq, APTR buffer, ULONG size, UQUAD offset)
+{
+    ioreq->io_Command = TD_READ64;
+    ioreq->io_Data = buffer;
+    ioreq->io_Length = size;
+    ioreq->io_Actual = offset >> 32;
+    ioreq->io_Offset = offset;
+    SendIO((struct IORequest *)ioreq);
+}
+
+/* Keep depth reads in flight until count are done, returns the failed count.
+ * A CTRL-C stops sending new reads.
+ */
+static ULONG bench(ULONG depth, ULONG size, ULONG count, ULONG streams, ULONG slots)
+{
+    struct MsgPort *port = ioreqs[0].io_Message.mn_ReplyPort;
+    ULONG i, sent=0, done=0, failed=0;
+
+    seed = 1;
+
+    for (i=0; (i < depth) && (sent < count); i++, sent++)
+    {
+        send_read(&ioreqs[i], buffers[i], size, next_offset(sent, streams, size, slots));
+    }
+
+    while (done < sent)
+    {
+        struct IOStdReq *ioreq;
+
+        WaitPort(port);
+        while (NULL != (ioreq = (struct IOStdReq *)GetMsg(port)))
+        {
+            done++;
+            if (ioreq->io_Error || (ioreq->io_Actual != size))
+            {
+                failed++;
+            }
+
+            if ((sent < count) && !(SetSignal(0, 0) & SIGBREAKF_CTRL_C))
+            {
+                send_read(ioreq, ioreq->io_Data, size, next_offset(sent, streams, size, slots));
+                sent++;
+            }
+        }
+    }
+
+    return failed;
+}
+
+/* Select the policy and make the unit read it */
+static void set_policy(LONG hwno, STRPTR policy)
+{
+    HeliosHardware *hw = NULL;
+    ULONG cnt=0;
+
+    SetVar("helios_sbp2_scheduler", policy, -1, GVF_GLOBAL_ONLY);
+
+    Helios_WriteLockBase();
+    {
+        while (NULL != (hw = Helios_GetNextHardware(hw)))
+        {
+            if (hwno == cnt++)
+            {
+                break;
+            }
+            Helios_ReleaseHardware(hw);
+        }
+    }
+    Helios_UnlockBase();
+
+    if (NULL != hw)
+    {
+        Helios_BusReset(hw, TRUE);
+        Helios_ReleaseHardware(hw);
+    }
+
+    /* Let the unit reconnect */
+    Delay(2 * TICKS_PER_SECOND);
+}
+
+int main(int argc, char **argv)
+{
+    APTR rdargs;
+    LONG res=RETURN_FAIL, unit=0, hwno=0;
+    STRPTR device="sbp2.device";
+    ULONG size=4096, count=4000, depth=32, streams=4;
+    struct MsgPort *port;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL != rdargs)
+    {
+        if (NULL != args.device)
+        {
+            device = args.device;
+        }
+        if (NULL != args.unit)
+        {
+            unit = *args.unit;
+        }
+        if (NULL != args.hwno)
+        {
+            hwno = *args.hwno;
+        }
+        if (NULL != args.size)
+        {
+            size = MIN(MAX(*args.size, 512), 1ul<<20) & ~511;
+        }
+        if (NULL != args.count)
+        {
+            count = MAX(*args.count, 1);
+        }
+        if (NULL != args.depth)
+        {
+            depth = MIN(MAX(*args.depth, 1), MAX_DEPTH);
+        }
+        if (NULL != args.streams)
+        {
+            streams = MIN(MAX(*args.streams, 1), MAX_STREAMS);
+        }
+    }
+    else
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    HeliosBase = OpenLibrary("helios.library", 52);
+    if (NULL == HeliosBase)
+    {
+        FreeArgs(rdargs);
+        return RETURN_FAIL;
+    }
+
+    port = CreateMsgPort();
+    if (NULL != port)
+    {
+        struct timerequest tr;
+        struct DriveGeometry dg;
+        ULONG i;
+
+        bzero(&tr, sizeof(tr));
+        tr.tr_node.io_Message.mn_Length = sizeof(tr);
+
+        for (i=0; i < depth; i++)
+        {
+            ioreqs[i].io_Message.mn_Length = sizeof(ioreqs[i]);
+            ioreqs[i].io_Message.mn_ReplyPort = port;
+            buffers[i] = AllocVec(size, MEMF_PUBLIC);
+            if (NULL == buffers[i])
+            {
+                break;
+            }
+        }
+
+        if (i < depth)
+        {
+            Printf("Not enough memory\n");
+        }
+        else if (OpenDevice(device, unit, (struct IORequest *)&ioreqs[0], 0))
+        {
+            Printf("Failed to open %s unit %ld\n", (ULONG)device, unit);
+        }
+        else
+        {
+            ULONG slots = 0;
+
+            for (i=1; i < depth; i++)
+            {
+                ioreqs[i].io_Device = ioreqs[0].io_Device;
+                ioreqs[i].io_Unit = ioreqs[0].io_Unit;
+            }
+
+            ioreqs[0].io_Command = TD_GETGEOMETRY;
+            ioreqs[0].io_Data = &dg;
+            ioreqs[0].io_Length = sizeof(dg);
+            if (!DoIO((struct IORequest *)&ioreqs[0]))
+            {
+                slots = ((UQUAD)dg.dg_TotalSectors * dg.dg_SectorSize) / size;
+            }
+
+            if (slots <= STREAM_RUN)
+            {
+                Printf("Failed to get a large enough disk geometry\n");
+            }
+            else if (!OpenDevice(TIMERNAME, UNIT_MICROHZ, &tr.tr_node, 0))
+            {
+                struct timeval start, end;
+                ULONG n, us, failed;
+
+                TimerBase = (struct Library *)tr.tr_node.io_Device;
+
+                Printf("%s unit %ld: %lu reads of %lu bytes, %lu streams, depth %lu\n",
+                       (ULONG)device, unit, count, size, streams, depth);
+                Printf("%-10s %12s %10s %10s %8s\n", (ULONG)"policy", (ULONG)"time (us)",
+                       (ULONG)"MB/s", (ULONG)"IOPS", (ULONG)"failed");
+
+                res = RETURN_OK;
+                for (n=0; NULL != policies[n]; n++)
+                {
+                    set_policy(hwno, policies[n]);
+
+                    GetSysTime(&start);
+                    failed = bench(depth, size, count, streams, slots);
+                    GetSysTime(&end);
+
+                    us = MAX(elapsed_us(&start, &end), 1);
+                    Printf("%-10s %12lu %10lu %10lu %8lu\n", (ULONG)policies[n], us,
+                           (ULONG)(((UQUAD)count * size) / us),
+                           (ULONG)(((UQUAD)count * 1000000) / us),
+                           failed);
+
+                    if (failed)
+                    {
+                        res = RETURN_WARN;
+                    }
+
+                    if (SetSignal(0, SIGBREAKF_CTRL_C) & SIGBREAKF_CTRL_C)
+                    {
+                        Printf("Break\n");
+                        res = RETURN_ERROR;
+                        break;
+                    }
+                }
+
+                DeleteVar("helios_sbp2_scheduler", GVF_GLOBAL_ONLY);
+
+                CloseDevice(&tr.tr_node);
+            }
+            else
+            {
+                Printf("Failed to open %s\n", (ULONG)TIMERNAME);
+            }
+
+            CloseDevice((struct IORequest *)&ioreqs[0]);
+        }
+
+        for (i=0; i < depth; i++)
+        {
+            FreeVec(buffers[i]);
+        }
+
+        DeleteMsgPort(port);
+    }
+
+    CloseLibrary(HeliosBase);
+    FreeArgs(rdargs);
+    return res;
+}
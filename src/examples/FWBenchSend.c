@@ -0,0 +1,313 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Send COUNT write block requests to a node using HHIOCMD_SENDREQUESTS,
+** for batch sizes 1, 2, 4, ... up to BATCH, and print packets/s per batch size.
+** Run it on a device built with SIMULATOR=1 to measure the driver alone:
+** the simulated node 1 acks writes into its RAM at offset 0.
+** CAPTURE=HEADERS or CAPTURE=PAYLOAD enables the bus capture tap during
+** the run, to measure its cost against a run without.
+**
+*/
+
+#include "proto/helios.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/timer.h>
+#include <proto/utility.h>
+#include <devices/timer.h>
+#include <clib/macros.h>
+#include <string.h>
+
+#define MAX_BATCH 256
+#define MAX_SIZE 2048
+
+struct Library *HeliosBase;
+struct Library *TimerBase;
+static const UBYTE template[] = "HW_ID/N,NODE_ID/N,COUNT/N,BATCH/N,SIZE/N,OFFSET/N,CAPTURE/K";
+
+static struct
+{
+    LONG *hwno;
+    LONG *nodeid;
+    LONG *count;
+    LONG *batch;
+    LONG *size;
+    LONG *offset;
+    STRPTR capture;
+} args;
+
+static IOHeliosHWSendRequest subs[MAX_BATCH];
+static IOHeliosHWReq *subs_array[MAX_BATCH];
+static QUADLET payload[MAX_SIZE/sizeof(QUADLET)];
+
+static LONG set_capture(HeliosHardware *hw, ULONG flags)
+{
+    struct TagItem tags[] =
+    {
+        {HHA_Capture, flags},
+        {TAG_DONE, 0}
+    };
+    IOHeliosHWReq ioreq;
+
+    bzero(&ioreq, sizeof(ioreq));
+    ioreq.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+    ioreq.iohh_Req.io_Command = HHIOCMD_SETATTRIBUTES;
+    ioreq.iohh_Data = tags;
+    return Helios_DoIO(HGA_HARDWARE, hw, &ioreq) || (1 != ioreq.iohh_Actual);
+}
+
+static ULONG elapsed_us(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_secs - start->tv_secs) * 1000000 + end->tv_micro - start->tv_micro;
+}
+
+LONG bench(HeliosDevice *dev, ULONG count, ULONG batch, ULONG size, ULONG offset, ULONG *errors)
+{
+    struct MsgPort *port;
+    IOHeliosHWReq ioreq;
+    ULONG i, n, sent;
+    LONG err = 0;
+
+    port = CreateMsgPort();
+    if (NULL == port)
+    {
+        return -1;
+    }
+
+    bzero(&ioreq, sizeof(ioreq));
+    ioreq.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+    ioreq.iohh_Req.io_Message.mn_ReplyPort = port;
+    ioreq.iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
+    Helios_InitIO(HGA_DEVICE, dev, &ioreq);
+
+    for (sent=0; sent < count; sent += n)
+    {
+        HeliosAPacket *p;
+
+        n = MIN(batch, count - sent);
+
+        for (i=0; i < n; i++)
+        {
+            bzero(&subs[i], sizeof(subs[i]));
+            subs[i].iohhe_Req.iohh_Req.io_Message.mn_Length = sizeof(subs[i]);
+            subs[i].iohhe_Req.iohh_Req.io_Message.mn_ReplyPort = port;
+            subs[i].iohhe_Device = dev;
+            Helios_InitIO(HGA_DEVICE, dev, &subs[i].iohhe_Req);
+
+            p = &subs[i].iohhe_Transaction.htr_Packet;
+            Helios_FillWriteBlockPacket(p, S400, offset, payload, size);
+
+            subs_array[i] = &subs[i].iohhe_Req;
+        }
+
+        ioreq.iohh_Req.io_Command = HHIOCMD_SENDREQUESTS;
+        ioreq.iohh_Data = subs_array;
+        ioreq.iohh_Length = n;
+
+        err = DoIO(&ioreq.iohh_Req);
+        if (err)
+        {
+            Printf("HHIOCMD_SENDREQUESTS failed, io err=%ld\n", err);
+            break;
+        }
+
+        for (i=0; i < n; i++)
+        {
+            WaitIO(&subs[i].iohhe_Req.iohh_Req);
+            if (subs[i].iohhe_Req.iohh_Req.io_Error ||
+                (HELIOS_RCODE_COMPLETE != subs[i].iohhe_Transaction.htr_Packet.RCode))
+            {
+                (*errors)++;
+            }
+        }
+    }
+
+    DeleteMsgPort(port);
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    APTR rdargs;
+    LONG res=RETURN_FAIL, hwno=0;
+    UWORD nodeid=0xffc1;
+    ULONG count=10000, maxbatch=64, size=8, offset=0, capture=0;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL != rdargs)
+    {
+        if (NULL != args.hwno)
+        {
+            hwno = *args.hwno;
+        }
+        if (NULL != args.nodeid)
+        {
+            nodeid = *args.nodeid;
+        }
+        if (NULL != args.count)
+        {
+            count = *args.count;
+        }
+        if (NULL != args.batch)
+        {
+            maxbatch = MIN(MAX(*args.batch, 1), MAX_BATCH);
+        }
+        if (NULL != args.size)
+        {
+            size = MIN(MAX(*args.size, 4), MAX_SIZE) & ~3;
+        }
+        if (NULL != args.offset)
+        {
+            offset = *args.offset;
+        }
+        if (NULL != args.capture)
+        {
+            if (!Stricmp(args.capture, "HEADERS"))
+            {
+                capture = HCAPF_HEADERS;
+            }
+            else if (!Stricmp(args.capture, "PAYLOAD"))
+            {
+                capture = HCAPF_HEADERS | HCAPF_PAYLOAD;
+            }
+            else
+            {
+                Printf("CAPTURE is HEADERS or PAYLOAD\n");
+                FreeArgs(rdargs);
+                return RETURN_ERROR;
+            }
+        }
+    }
+    else
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    HeliosBase = OpenLibrary("helios.library", 52);
+    if (NULL != HeliosBase)
+    {
+        ULONG cnt=0;
+        HeliosHardware *hw = NULL;
+        HeliosDevice *dev=NULL;
+
+        Helios_WriteLockBase();
+        {
+            while (NULL != (hw = Helios_GetNextHardware(hw)))
+            {
+                if (hwno == cnt++)
+                {
+                    while (NULL != (dev = Helios_GetNextDevice(dev,
+                                                               HA_Hardware, (ULONG)hw,
+                                                               TAG_DONE)))
+                    {
+                        ULONG value;
+
+                        if (1 == Helios_GetAttrs(HGA_DEVICE, dev,
+                                                 HA_NodeID, (ULONG)&value,
+                                                 TAG_DONE))
+                        {
+                            if (value == nodeid)
+                            {
+                                break;
+                            }
+                        }
+
+                        Helios_ReleaseDevice(dev);
+                    }
+
+                    break;
+                }
+
+                Helios_ReleaseHardware(hw);
+            }
+        }
+        Helios_UnlockBase();
+
+        if (NULL != dev)
+        {
+            struct timerequest tr;
+
+            bzero(&tr, sizeof(tr));
+            tr.tr_node.io_Message.mn_Length = sizeof(tr);
+            if (!OpenDevice(TIMERNAME, UNIT_MICROHZ, &tr.tr_node, 0))
+            {
+                struct timeval start, end;
+                ULONG batch, us, errors;
+
+                TimerBase = (struct Library *)tr.tr_node.io_Device;
+
+                Printf("Node %04lx: %lu write requests of %lu bytes%s\n", nodeid, count, size,
+                       (ULONG)(capture ? ", capture enabled" : ""));
+                if (capture && set_capture(hw, capture))
+                {
+                    Printf("Capture not supported by this hardware\n");
+                }
+                Printf("%8s %12s %10s %8s\n", (ULONG)"batch", (ULONG)"time (us)", (ULONG)"packets/s", (ULONG)"errors");
+
+                res = RETURN_OK;
+                for (batch=1; batch <= maxbatch; batch <<= 1)
+                {
+                    errors = 0;
+
+                    GetSysTime(&start);
+                    if (bench(dev, count, batch, size, offset, &errors))
+                    {
+                        res = RETURN_ERROR;
+                        break;
+                    }
+                    GetSysTime(&end);
+
+                    us = MAX(elapsed_us(&start, &end), 1);
+                    Printf("%8lu %12lu %10lu %8lu\n", batch, us,
+                           (ULONG)(((UQUAD)count * 1000000) / us), errors);
+                }
+
+                if (capture)
+                {
+                    set_capture(hw, 0);
+                }
+
+                CloseDevice(&tr.tr_node);
+            }
+            else
+            {
+                Printf("Failed to open %s\n", (ULONG)TIMERNAME);
+            }
+
+            Helios_ReleaseDevice(dev);
+        }
+        else
+        {
+            Printf("No device with node ID %04lx\n", nodeid);
+        }
+
+        if (NULL != hw)
+        {
+            Helios_ReleaseHardware(hw);
+        }
+
+        CloseLibrary(HeliosBase);
+    }
+
+    return res;
+}
@@ -0,0 +1,281 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Replay a capture written by helios_capture on a device built with
+** SIMULATOR=1, and print the transaction layer throughput, latencies and
+** allocations. SPEED=0 (default) replays back-to-back, SPEED=1 at the
+** captured times, SPEED=n n times faster.
+**
+**     FWReplay FROM=RAM:bus.pcap
+**     FWReplay FROM=RAM:bus.pcap SPEED=1
+**
+*/
+
+#include "proto/helios.h"
+#include "devices/helios/ohci1394.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <clib/macros.h>
+#include <string.h>
+
+static const UBYTE template[] = "HW_ID/N,FROM/A,SPEED/N";
+
+static struct
+{
+    LONG *hwno;
+    STRPTR from;
+    LONG *speed;
+} args;
+
+struct pcap_file_header
+{
+    ULONG magic;
+    UWORD version_major;
+    UWORD version_minor;
+    LONG  thiszone;
+    ULONG sigfigs;
+    ULONG snaplen;
+    ULONG linktype;
+};
+
+struct pcap_packet_header
+{
+    ULONG ts_sec;
+    ULONG ts_usec;
+    ULONG incl_len;
+    ULONG orig_len;
+};
+
+/* Returns the records of the capture file, *count set to their number */
+static HeliosCapturePacket *load_capture(BPTR fh, ULONG *count)
+{
+    struct pcap_file_header fhdr;
+    struct pcap_packet_header ph;
+    HeliosCapturePcapHeader cph;
+    HeliosCapturePacket *packets = NULL;
+    ULONG size = 0;
+
+    *count = 0;
+
+    if ((1 != FRead(fh, &fhdr, sizeof(fhdr), 1)) ||
+        (0xa1b2c3d4 != fhdr.magic) || (HCAPTURE_LINKTYPE != fhdr.linktype))
+    {
+        Printf("Not a helios_capture file\n");
+        return NULL;
+    }
+
+    while (1 == FRead(fh, &ph, sizeof(ph), 1))
+    {
+        HeliosCapturePacket *cp;
+        ULONG caplen;
+
+        if (*count == size)
+        {
+            HeliosCapturePacket *tmp;
+
+            size = size ? size * 2 : 1024;
+            tmp = AllocVec(size * sizeof(*tmp), MEMF_PUBLIC | MEMF_CLEAR);
+            if (NULL == tmp)
+            {
+                Printf("Not enough memory for %lu records\n", size);
+                break;
+            }
+
+            if (NULL != packets)
+            {
+                CopyMem(packets, tmp, *count * sizeof(*tmp));
+                FreeVec(packets);
+            }
+            packets = tmp;
+        }
+
+        if ((ph.incl_len < sizeof(cph)) || (1 != FRead(fh, &cph, sizeof(cph), 1)) ||
+            (HCAPTURE_PCAP_VERSION != cph.cph_Version) ||
+            (cph.cph_HeaderLength > sizeof(cp->cp_Header)) ||
+            (ph.incl_len - sizeof(cph) < cph.cph_HeaderLength))
+        {
+            Printf("Bad record #%lu\n", *count + 1);
+            break;
+        }
+
+        cp = &packets[*count];
+        caplen = MIN(ph.incl_len - sizeof(cph) - cph.cph_HeaderLength, (ULONG)HCAPTURE_PAYLOAD);
+
+        cp->cp_Seq = *count + 1;
+        cp->cp_Time = cph.cph_CycleTimer;
+        cp->cp_TimeStamp = cph.cph_TimeStamp;
+        cp->cp_Type = cph.cph_Type;
+        cp->cp_Event = cph.cph_Event;
+        cp->cp_PayloadLength = cph.cph_PayloadLength;
+        cp->cp_HeaderLength = cph.cph_HeaderLength;
+        cp->cp_CapLength = caplen;
+        cp->cp_Speed = cph.cph_Speed;
+
+        if ((cph.cph_HeaderLength && (1 != FRead(fh, cp->cp_Header, cph.cph_HeaderLength, 1))) ||
+            (caplen && (1 != FRead(fh, cp->cp_Payload, caplen, 1))))
+        {
+            Printf("Truncated record #%lu\n", *count + 1);
+            break;
+        }
+
+        /* Skip what a larger snap length may give */
+        if (ph.incl_len > sizeof(cph) + cph.cph_HeaderLength + caplen)
+        {
+            Seek(fh, ph.incl_len - sizeof(cph) - cph.cph_HeaderLength - caplen, OFFSET_CURRENT);
+        }
+
+        (*count)++;
+    }
+
+    return packets;
+}
+
+static LONG replay(HeliosHardware *hw, OHCI1394Replay *rp)
+{
+    struct TagItem tags[] =
+    {
+        {OHCI1394A_Replay, (ULONG)rp},
+        {TAG_DONE, 0}
+    };
+    IOHeliosHWReq ioreq;
+
+    bzero(&ioreq, sizeof(ioreq));
+    ioreq.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+    ioreq.iohh_Req.io_Command = HHIOCMD_SETATTRIBUTES;
+    ioreq.iohh_Data = tags;
+    if (Helios_DoIO(HGA_HARDWARE, hw, &ioreq))
+    {
+        Printf("Replay failed, io err=%ld\n", (LONG)ioreq.iohh_Req.io_Error);
+        return RETURN_ERROR;
+    }
+
+    if (1 != ioreq.iohh_Actual)
+    {
+        Printf("Replay needs a device built with SIMULATOR=1\n");
+        return RETURN_ERROR;
+    }
+
+    return RETURN_OK;
+}
+
+static void print_results(OHCI1394Replay *rp)
+{
+    ULONG us = MAX(rp->rp_ElapsedUS, 1);
+
+    Printf("%lu record(s) in %lu us: %lu request(s) sent, %lu received, %lu bus reset(s)\n",
+           rp->rp_Count, rp->rp_ElapsedUS, rp->rp_Transactions, rp->rp_Requests, rp->rp_BusResets);
+    Printf("Throughput: %lu transactions/s\n",
+           (ULONG)(((UQUAD)(rp->rp_Transactions + rp->rp_Requests) * 1000000) / us));
+    Printf("Completed: %lu, unmatched: %lu, errors: %lu\n",
+           rp->rp_Completed, rp->rp_Unmatched, rp->rp_Errors);
+    Printf("Latency (us): p50 %lu, p90 %lu, p99 %lu, max %lu\n",
+           rp->rp_Latency[0], rp->rp_Latency[1], rp->rp_Latency[2], rp->rp_Latency[3]);
+    Printf("Allocations: transaction layer %lu, controller model %lu\n",
+           rp->rp_TLAllocs, rp->rp_ModelAllocs);
+}
+
+int main(int argc, char **argv)
+{
+    struct Library *HeliosBase;
+    OHCI1394Replay rp;
+    APTR rdargs;
+    LONG res=RETURN_FAIL, hwno=0;
+    BPTR fh;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL == rdargs)
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    bzero(&rp, sizeof(rp));
+    if (NULL != args.hwno)
+    {
+        hwno = *args.hwno;
+    }
+    if ((NULL != args.speed) && (*args.speed > 0))
+    {
+        rp.rp_Speed = *args.speed;
+    }
+
+    fh = Open(args.from, MODE_OLDFILE);
+    if (0 == fh)
+    {
+        PrintFault(IoErr(), args.from);
+        FreeArgs(rdargs);
+        return RETURN_ERROR;
+    }
+
+    rp.rp_Packets = load_capture(fh, &rp.rp_Count);
+    Close(fh);
+
+    if (0 == rp.rp_Count)
+    {
+        Printf("No record to replay\n");
+    }
+    else if (NULL != (HeliosBase = OpenLibrary("helios.library", 52)))
+    {
+        HeliosHardware *hw = NULL;
+        LONG cnt=0;
+
+        Helios_ReadLockBase();
+        {
+            while (NULL != (hw = Helios_GetNextHardware(hw)))
+            {
+                if (hwno == cnt++)
+                {
+                    break;
+                }
+                Helios_ReleaseHardware(hw);
+            }
+        }
+        Helios_UnlockBase();
+
+        if (NULL != hw)
+        {
+            Printf("Replaying %lu record(s) of %s, %s timing\n", rp.rp_Count, (ULONG)args.from,
+                   (ULONG)(rp.rp_Speed ? "original" : "compressed"));
+
+            res = replay(hw, &rp);
+            if (RETURN_OK == res)
+            {
+                print_results(&rp);
+            }
+
+            Helios_ReleaseHardware(hw);
+        }
+        else
+        {
+            Printf("No hardware #%ld\n", hwno);
+        }
+
+        CloseLibrary(HeliosBase);
+    }
+
+    if (NULL != rp.rp_Packets)
+    {
+        FreeVec(rp.rp_Packets);
+    }
+
+    FreeArgs(rdargs);
+    return res;
+}
@@ -0,0 +1,284 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Stress the transaction label allocator: during ROUNDS rounds, send DEPTH
+** write quadlet requests to every remote node of a bus in one
+** HHIOCMD_SENDREQUESTS batch, then wait for all responses.
+** Print the number of transactions in flight when the batch returns,
+** failed requests and transactions/s.
+** Run it on a device built with SIMULATOR=1 SIMULATOR_PEERS=n: the simulated
+** nodes respond after a split delay, so all accepted requests of a round
+** are pending together. A node has 64 tlabels, so a DEPTH over 64 gives
+** failures, whatever the number of nodes.
+**
+*/
+
+#include "proto/helios.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+#include <clib/macros.h>
+#include <string.h>
+
+#define MAX_NODES 16
+#define MAX_DEPTH 128
+#define MAX_BATCH (MAX_NODES * MAX_DEPTH)
+
+struct Library *HeliosBase;
+struct Library *TimerBase;
+static const UBYTE template[] = "HW_ID/N,DEPTH/N,ROUNDS/N";
+
+static struct
+{
+    LONG *hwno;
+    LONG *depth;
+    LONG *rounds;
+} args;
+
+static HeliosDevice *devices[MAX_NODES];
+static IOHeliosHWSendRequest subs[MAX_BATCH];
+static IOHeliosHWReq *subs_array[MAX_BATCH];
+
+static struct
+{
+    ULONG rounds;
+    ULONG sent;
+    ULONG failed;
+    ULONG inflight_max;
+    ULONG inflight_sum;
+} stats;
+
+static ULONG elapsed_us(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_secs - start->tv_secs) * 1000000 + end->tv_micro - start->tv_micro;
+}
+
+static LONG stress(ULONG ndev, ULONG depth, ULONG rounds)
+{
+    struct MsgPort *port;
+    IOHeliosHWReq ioreq;
+    ULONG i, n, round;
+    LONG err = 0;
+
+    port = CreateMsgPort();
+    if (NULL == port)
+    {
+        return -1;
+    }
+
+    bzero(&ioreq, sizeof(ioreq));
+    ioreq.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+    ioreq.iohh_Req.io_Message.mn_ReplyPort = port;
+    ioreq.iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
+    Helios_InitIO(HGA_DEVICE, devices[0], &ioreq);
+
+    n = ndev * depth;
+    for (round=0; round < rounds; round++)
+    {
+        /* Interleave destinations to mix the tlabel pools */
+        for (i=0; i < n; i++)
+        {
+            HeliosDevice *dev = devices[i % ndev];
+            HeliosAPacket *p;
+
+            bzero(&subs[i], sizeof(subs[i]));
+            subs[i].iohhe_Req.iohh_Req.io_Message.mn_Length = sizeof(subs[i]);
+            subs[i].iohhe_Req.iohh_Req.io_Message.mn_ReplyPort = port;
+            subs[i].iohhe_Device = dev;
+            Helios_InitIO(HGA_DEVICE, dev, &subs[i].iohhe_Req);
+
+            p = &subs[i].iohhe_Transaction.htr_Packet;
+            Helios_FillWriteQuadletPacket(p, S400, (i / ndev) * sizeof(QUADLET), round);
+
+            subs_array[i] = &subs[i].iohhe_Req;
+        }
+
+        ioreq.iohh_Req.io_Command = HHIOCMD_SENDREQUESTS;
+        ioreq.iohh_Data = subs_array;
+        ioreq.iohh_Length = n;
+
+        err = DoIO(&ioreq.iohh_Req);
+        if (err)
+        {
+            Printf("HHIOCMD_SENDREQUESTS failed, io err=%ld\n", err);
+            break;
+        }
+
+        stats.inflight_sum += ioreq.iohh_Actual;
+        stats.inflight_max = MAX(stats.inflight_max, (ULONG)ioreq.iohh_Actual);
+
+        for (i=0; i < n; i++)
+        {
+            WaitIO(&subs[i].iohhe_Req.iohh_Req);
+            if (subs[i].iohhe_Req.iohh_Req.io_Error ||
+                (HELIOS_RCODE_COMPLETE != subs[i].iohhe_Transaction.htr_Packet.RCode))
+            {
+                stats.failed++;
+            }
+        }
+
+        stats.sent += n;
+        stats.rounds++;
+
+        if (SetSignal(0, SIGBREAKF_CTRL_C) & SIGBREAKF_CTRL_C)
+        {
+            Printf("Break\n");
+            err = -1;
+            break;
+        }
+    }
+
+    DeleteMsgPort(port);
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    APTR rdargs;
+    LONG res=RETURN_FAIL, hwno=0;
+    ULONG depth=64, rounds=100;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL != rdargs)
+    {
+        if (NULL != args.hwno)
+        {
+            hwno = *args.hwno;
+        }
+        if (NULL != args.depth)
+        {
+            depth = MIN(MAX(*args.depth, 1), MAX_DEPTH);
+        }
+        if (NULL != args.rounds)
+        {
+            rounds = MAX(*args.rounds, 1);
+        }
+    }
+    else
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    HeliosBase = OpenLibrary("helios.library", 52);
+    if (NULL != HeliosBase)
+    {
+        ULONG cnt=0, ndev=0, i;
+        HeliosHardware *hw = NULL;
+        HeliosDevice *dev=NULL;
+
+        Helios_WriteLockBase();
+        {
+            while (NULL != (hw = Helios_GetNextHardware(hw)))
+            {
+                if (hwno == cnt++)
+                {
+                    ULONG local=~0;
+
+                    Helios_GetAttrs(HGA_HARDWARE, hw,
+                                    HA_NodeID, (ULONG)&local,
+                                    TAG_DONE);
+
+                    /* Keep remote nodes only */
+                    while (NULL != (dev = Helios_GetNextDevice(dev,
+                                                               HA_Hardware, (ULONG)hw,
+                                                               TAG_DONE)))
+                    {
+                        ULONG value;
+
+                        if ((ndev < MAX_NODES) &&
+                            (1 == Helios_GetAttrs(HGA_DEVICE, dev,
+                                                  HA_NodeID, (ULONG)&value,
+                                                  TAG_DONE)) &&
+                            (value != local))
+                        {
+                            devices[ndev++] = dev;
+                        }
+                        else
+                        {
+                            Helios_ReleaseDevice(dev);
+                        }
+                    }
+
+                    break;
+                }
+
+                Helios_ReleaseHardware(hw);
+            }
+        }
+        Helios_UnlockBase();
+
+        if (ndev > 0)
+        {
+            struct timerequest tr;
+
+            bzero(&tr, sizeof(tr));
+            tr.tr_node.io_Message.mn_Length = sizeof(tr);
+            if (!OpenDevice(TIMERNAME, UNIT_MICROHZ, &tr.tr_node, 0))
+            {
+                struct timeval start, end;
+                ULONG us;
+
+                TimerBase = (struct Library *)tr.tr_node.io_Device;
+
+                Printf("%lu nodes, %lu requests per node, %lu rounds\n", ndev, depth, rounds);
+
+                GetSysTime(&start);
+                res = stress(ndev, depth, rounds) ? RETURN_ERROR : RETURN_OK;
+                GetSysTime(&end);
+
+                us = MAX(elapsed_us(&start, &end), 1);
+                rounds = MAX(stats.rounds, 1);
+                Printf("in flight: max %lu, average %lu (%lu per node)\n",
+                       stats.inflight_max, stats.inflight_sum / rounds,
+                       stats.inflight_sum / rounds / ndev);
+                Printf("%lu transactions, %lu failed, %lu us, %lu transactions/s\n",
+                       stats.sent, stats.failed, us,
+                       (ULONG)(((UQUAD)(stats.sent - stats.failed) * 1000000) / us));
+
+                CloseDevice(&tr.tr_node);
+            }
+            else
+            {
+                Printf("Failed to open %s\n", (ULONG)TIMERNAME);
+            }
+
+            for (i=0; i < ndev; i++)
+            {
+                Helios_ReleaseDevice(devices[i]);
+            }
+        }
+        else
+        {
+            Printf("No remote node\n");
+        }
+
+        if (NULL != hw)
+        {
+            Helios_ReleaseHardware(hw);
+        }
+
+        CloseLibrary(HeliosBase);
+    }
+
+    return res;
+}
@@ -66,6 +66,12 @@ int main(int argc, char **argv)
                 {
                     ULONG sigs;
 
+                    /* (Re-)register the listener (as it's a FAST_EVENT listenera).
+                     * The event is only sent when the ring becomes non-empty:
+                     * register before emptying it.
+                     */
+                    Helios_AddEventListener(ell, &listener);
+
                     /* Fetch all report messages */
                     while (NULL != (msg = Helios_GetNextReportMsg()))
                     {
@@ -77,9 +83,6 @@ int main(int argc, char **argv)
                         Helios_FreeReportMsg(msg);
                     }
 
-                    /* (Re-)register the listener (as it's a FAST_EVENT listenera) */
-                    Helios_AddEventListener(ell, &listener);
-
                     /* Wait for new reports or BREAK-C */
                     sigs = Wait((1ul << evt_port->mp_SigBit) | SIGBREAKF_CTRL_C);
                     if (sigs & SIGBREAKF_CTRL_C)
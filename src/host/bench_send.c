@@ -0,0 +1,240 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host benchmark: FWBenchSend on the simulated controller.
+**
+** Sends COUNT write block requests of SIZE bytes to a simulated peer using
+** HHIOCMD_SENDREQUESTS, for batch sizes 1, 2, 4, ... up to BATCH, without
+** capture, then with the capture tap on headers and on headers + payload.
+** Each run is repeated RUNS times, the best one is printed.
+**
+** Usage: bench_send [COUNT [BATCH [SIZE [RUNS]]]]
+**
+*/
+
+#include "hosttest.h"
+
+#include "proto/helios.h"
+
+#include <proto/exec.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+#include <clib/macros.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BATCH 256
+#define MAX_SIZE 2048
+
+static const struct
+{
+    CONST_STRPTR    name;
+    ULONG           flags;
+} bench_Modes[] =
+{
+    {"off", 0},
+    {"HEADERS", HCAPF_HEADERS},
+    {"PAYLOAD", HCAPF_HEADERS | HCAPF_PAYLOAD},
+};
+
+#define MODE_COUNT (sizeof(bench_Modes) / sizeof(bench_Modes[0]))
+
+static struct Library *TimerBase;
+
+static LONG bench_SetCapture(HostTestUnit *tu, ULONG flags)
+{
+    struct TagItem tags[] =
+    {
+        {HHA_Capture, flags},
+        {TAG_DONE, 0}
+    };
+    IOHeliosHWReq ioreq;
+
+    hosttest_InitIO(tu, &ioreq, HHIOCMD_SETATTRIBUTES, sizeof(ioreq));
+    ioreq.iohh_Data = tags;
+    return hosttest_DoIO(tu, &ioreq) || (1 != ioreq.iohh_Actual);
+}
+
+static ULONG bench_Now(void)
+{
+    struct timeval tv;
+
+    GetSysTime(&tv);
+    return tv.tv_secs * 1000000 + tv.tv_micro;
+}
+
+static LONG bench_Send(HostTestUnit *tu, UWORD nodeid, QUADLET *payload,
+                       IOHeliosHWSendRequest *subs, IOHeliosHWReq **subs_array,
+                       ULONG count, ULONG batch, ULONG size, ULONG *errors)
+{
+    IOHeliosHWReq ioreq;
+    ULONG i, n, sent;
+    LONG err = 0;
+
+    for (sent=0; sent < count; sent += n)
+    {
+        HeliosAPacket *p;
+
+        n = MIN(batch, count - sent);
+
+        for (i=0; i < n; i++)
+        {
+            hosttest_InitIO(tu, &subs[i].iohhe_Req, HHIOCMD_SENDREQUEST, sizeof(subs[i]));
+
+            p = &subs[i].iohhe_Transaction.htr_Packet;
+            Helios_FillWriteBlockPacket(p, S400, 0, payload, size);
+            p->DestID = nodeid;
+
+            subs_array[i] = &subs[i].iohhe_Req;
+        }
+
+        hosttest_InitIO(tu, &ioreq, HHIOCMD_SENDREQUESTS, sizeof(ioreq));
+        ioreq.iohh_Data = subs_array;
+        ioreq.iohh_Length = n;
+
+        err = hosttest_DoIO(tu, &ioreq);
+        if (err)
+        {
+            printf("HHIOCMD_SENDREQUESTS failed, io err=%ld\n", (long)err);
+            break;
+        }
+
+        for (i=0; i < n; i++)
+        {
+            WaitIO(&subs[i].iohhe_Req.iohh_Req);
+            if (subs[i].iohhe_Req.iohh_Req.io_Error ||
+                (HELIOS_RCODE_COMPLETE != subs[i].iohhe_Transaction.htr_Packet.RCode))
+            {
+                (*errors)++;
+            }
+        }
+    }
+
+    return err;
+}
+
+static int bench_Main(int argc, char **argv)
+{
+    HostTestUnit tu;
+    HeliosTopology *topo;
+    struct timerequest tr;
+    IOHeliosHWSendRequest *subs;
+    IOHeliosHWReq **subs_array;
+    QUADLET *payload;
+    ULONG count=10000, maxbatch=64, size=8, runs=3;
+    ULONG mode, batch, run, us, best, errors;
+    UWORD nodeid;
+    int res = 0;
+
+    if (argc > 1) count = strtoul(argv[1], NULL, 0);
+    if (argc > 2) maxbatch = MIN(strtoul(argv[2], NULL, 0), MAX_BATCH);
+    if (argc > 3) size = MIN(strtoul(argv[3], NULL, 0), MAX_SIZE);
+    if (argc > 4) runs = MAX(strtoul(argv[4], NULL, 0), 1);
+
+    memset(&tr, 0, sizeof(tr));
+    tr.tr_node.io_Message.mn_Length = sizeof(tr);
+    if (OpenDevice(TIMERNAME, UNIT_MICROHZ, &tr.tr_node, 0))
+    {
+        printf("Failed to open %s\n", TIMERNAME);
+        return 1;
+    }
+    TimerBase = (struct Library *)tr.tr_node.io_Device;
+
+    if (HERR_NOERR != hosttest_OpenUnit(&tu, 1))
+    {
+        CloseDevice(&tr.tr_node);
+        return 1;
+    }
+
+    topo = hosttest_WaitTopology(&tu, 0, 2000);
+    if (NULL == topo)
+    {
+        printf("No topology\n");
+        hosttest_CloseUnit(&tu);
+        CloseDevice(&tr.tr_node);
+        return 1;
+    }
+    nodeid = 0xffc0 | (0 == topo->ht_LocalNodeID ? 1 : 0);
+
+    /* Seen by the driver: below 4GB */
+    payload = AllocVec(MAX_SIZE, MEMF_PUBLIC | MEMF_CLEAR);
+    subs = AllocVec(MAX_BATCH * sizeof(*subs), MEMF_PUBLIC | MEMF_CLEAR);
+    subs_array = AllocVec(MAX_BATCH * sizeof(*subs_array), MEMF_PUBLIC | MEMF_CLEAR);
+
+    printf("Node %04x: %lu write requests of %lu bytes, best of %lu runs\n",
+           nodeid, (unsigned long)count, (unsigned long)size, (unsigned long)runs);
+    printf("%8s %8s %12s %10s %8s\n", "capture", "batch", "time (us)", "packets/s", "errors");
+
+    for (mode=0; (mode < MODE_COUNT) && !res; mode++)
+    {
+        if (bench_SetCapture(&tu, bench_Modes[mode].flags))
+        {
+            printf("Capture not supported\n");
+            res = 1;
+            break;
+        }
+
+        for (batch=1; batch <= maxbatch; batch <<= 1)
+        {
+            best = ~0;
+            errors = 0;
+
+            for (run=0; run < runs; run++)
+            {
+                ULONG start = bench_Now();
+
+                if (bench_Send(&tu, nodeid, payload, subs, subs_array, count, batch, size, &errors))
+                {
+                    res = 1;
+                    break;
+                }
+
+                us = MAX(bench_Now() - start, 1);
+                best = MIN(best, us);
+            }
+
+            if (res)
+            {
+                break;
+            }
+
+            printf("%8s %8lu %12lu %10lu %8lu\n", bench_Modes[mode].name, (unsigned long)batch,
+                   (unsigned long)best, (unsigned long)(((UQUAD)count * 1000000) / best),
+                   (unsigned long)errors);
+        }
+    }
+
+    bench_SetCapture(&tu, 0);
+
+    FreeVec(subs_array);
+    FreeVec(subs);
+    FreeVec(payload);
+    hosttest_CloseUnit(&tu);
+    CloseDevice(&tr.tr_node);
+
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    return host_RunMain(bench_Main, argc, argv);
+}
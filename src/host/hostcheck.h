@@ -0,0 +1,65 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: checks and result of a test, also used by the tests that
+** do not open a device unit (hosttest.h).
+**
+*/
+
+#ifndef HOSTCHECK_H
+#define HOSTCHECK_H
+
+#include <exec/types.h>
+
+#include <stdio.h>
+
+extern ULONG hosttest_Failures;
+
+/* Helios_ReportMsg() calls with HRMB_ERROR (hosthelios.c) */
+extern ULONG hosthelios_Errors;
+
+#define CHECK(cond) ({                                                  \
+    BOOL _ok = (cond) ? TRUE : FALSE;                                   \
+    if (!_ok)                                                           \
+    {                                                                   \
+        fprintf(stderr, "%s:%u: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        hosttest_Failures++;                                            \
+    }                                                                   \
+    _ok; })
+
+#define CHECK_EQ(a, b) ({                                               \
+    unsigned long long _a = (a), _b = (b);                              \
+    BOOL _ok = _a == _b;                                                \
+    if (!_ok)                                                           \
+    {                                                                   \
+        fprintf(stderr, "%s:%u: check failed: %s == %s (%llu != %llu)\n", \
+                __FILE__, __LINE__, #a, #b, _a, _b);                    \
+        hosttest_Failures++;                                            \
+    }                                                                   \
+    _ok; })
+
+/* Runs entry() in an exec task (hostexec.c) */
+extern int host_RunMain(int (*entry)(int, char **), int argc, char **argv);
+
+/* Prints the result, returns the exit code of the test */
+extern int hosttest_Result(CONST_STRPTR name);
+
+#endif /* HOSTCHECK_H */
@@ -0,0 +1,1718 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: the exec, utility and timer.device subset used by the
+** ohci1394_pci.device sources, on top of POSIX threads.
+**
+** Each exec task is a pthread. Signals, message lists and semaphores are
+** all serialised by one global mutex, each task sleeping on its own
+** condition variable. All exec memory and task stacks come from an arena
+** mapped in the low 2GB so pointers still fit in ULONG tag data and IPTR
+** fields, as on the 32-bit target.
+**
+*/
+
+#define _GNU_SOURCE
+
+#include <proto/exec.h>
+#include <proto/utility.h>
+#include <proto/alib.h>
+#include <clib/timer_protos.h>
+#include <clib/debug_protos.h>
+#include <exec/errors.h>
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <errno.h>
+
+#define ARENA_SIZE          (768ul << 20)
+#define ARENA_MIN_CLASS     6           /* 64 bytes */
+#define ARENA_MAX_CLASS     30
+#define ARENA_MAGIC         0x48454c53  /* 'HELS' */
+#define TASK_MIN_STACK      (256ul << 10)
+
+typedef struct HostBlockHeader
+{
+    ULONG           bh_Block;       /* start of the arena block */
+    ULONG           bh_Class;
+    ULONG           bh_Size;        /* user size */
+    ULONG           bh_Magic;
+} HostBlockHeader;
+
+typedef struct HostPool
+{
+    struct MinList  hp_Items;
+    ULONG           hp_Flags;
+} HostPool;
+
+typedef struct HostTask
+{
+    struct Task     ht_Task;
+    struct MinNode  ht_ZombieNode;
+    pthread_t       ht_Thread;
+    pthread_cond_t  ht_Cond;
+    APTR            ht_Stack;
+    IPTR            ht_PC;
+    IPTR            ht_Args[2];
+    struct Message *ht_StartupMsg;
+    struct MsgPort *ht_TaskPort;
+} HostTask;
+
+struct ExecBase *SysBase;
+
+static struct ExecBase exec_Base;
+static struct Library exec_Library;
+static struct Device timer_Device;
+
+static pthread_mutex_t exec_Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t exec_ForbidLock;
+static pthread_once_t exec_Once = PTHREAD_ONCE_INIT;
+static __thread HostTask *exec_ThisTask;
+
+static pthread_mutex_t arena_Lock = PTHREAD_MUTEX_INITIALIZER;
+static UBYTE *arena_Base, *arena_Top, *arena_End;
+static APTR arena_Free[ARENA_MAX_CLASS + 1];
+
+static struct MinList exec_Zombies;
+
+/* timer.device */
+static pthread_mutex_t timer_Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_Cond;
+static struct List timer_Pending;
+static pthread_t timer_Thread;
+static BOOL timer_Running;
+
+static void exec_Init(void);
+static void exec_ReapZombies(void);
+
+/*----------------------------------------------------------------------------*/
+/*--- MEMORY -----------------------------------------------------------------*/
+
+static void arena_Init(void)
+{
+    arena_Base = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_32BIT, -1, 0);
+    if (MAP_FAILED == arena_Base)
+    {
+        perror("arena mmap");
+        abort();
+    }
+
+    arena_Top = arena_Base;
+    arena_End = arena_Base + ARENA_SIZE;
+}
+
+static APTR arena_Alloc(ULONG size, ULONG flags, ULONG align, ULONG offset, ULONG headroom)
+{
+    HostBlockHeader *bh;
+    ULONG need, cls;
+    UBYTE *block, *user;
+
+    pthread_once(&exec_Once, exec_Init);
+
+    if (align < 16)
+    {
+        align = 16;
+    }
+
+    need = size + sizeof(HostBlockHeader) + headroom + align + offset;
+    for (cls = ARENA_MIN_CLASS; (1ul << cls) < need; cls++)
+    {
+        if (cls == ARENA_MAX_CLASS)
+        {
+            return NULL;
+        }
+    }
+
+    pthread_mutex_lock(&arena_Lock);
+    block = arena_Free[cls];
+    if (NULL != block)
+    {
+        arena_Free[cls] = *(APTR *)block;
+    }
+    else if ((ULONG)(arena_End - arena_Top) >= (1ul << cls))
+    {
+        block = arena_Top;
+        arena_Top += 1ul << cls;
+    }
+    pthread_mutex_unlock(&arena_Lock);
+
+    if (NULL == block)
+    {
+        return NULL;
+    }
+
+    user = block + headroom + sizeof(HostBlockHeader) + offset;
+    user += (align - ((IPTR)user % align)) % align;
+    user -= offset;
+
+    bh = (HostBlockHeader *)user - 1;
+    bh->bh_Block = (IPTR)block;
+    bh->bh_Class = cls;
+    bh->bh_Size = size;
+    bh->bh_Magic = ARENA_MAGIC;
+
+    if (flags & MEMF_CLEAR)
+    {
+        memset(user, 0, size);
+    }
+
+    return user;
+}
+
+static HostBlockHeader *arena_Header(APTR mem)
+{
+    HostBlockHeader *bh = (HostBlockHeader *)mem - 1;
+
+    if (ARENA_MAGIC != bh->bh_Magic)
+    {
+        fprintf(stderr, "hostexec: freeing bad block %p\n", mem);
+        abort();
+    }
+
+    return bh;
+}
+
+static void arena_Free_(APTR mem)
+{
+    HostBlockHeader *bh;
+    APTR block;
+    ULONG cls;
+
+    if (NULL == mem)
+    {
+        return;
+    }
+
+    bh = arena_Header(mem);
+    block = (APTR)(IPTR)bh->bh_Block;
+    cls = bh->bh_Class;
+    bh->bh_Magic = 0;
+
+    pthread_mutex_lock(&arena_Lock);
+    *(APTR *)block = arena_Free[cls];
+    arena_Free[cls] = block;
+    pthread_mutex_unlock(&arena_Lock);
+}
+
+APTR AllocMem(ULONG size, ULONG flags)
+{
+    return arena_Alloc(size, flags, 16, 0, 0);
+}
+
+void FreeMem(APTR mem, ULONG size)
+{
+    arena_Free_(mem);
+}
+
+APTR AllocMemAligned(ULONG size, ULONG flags, ULONG align, ULONG offset)
+{
+    return arena_Alloc(size, flags, align, offset, 0);
+}
+
+APTR AllocVec(ULONG size, ULONG flags)
+{
+    return arena_Alloc(size, flags, 16, 0, 0);
+}
+
+void FreeVec(APTR mem)
+{
+    arena_Free_(mem);
+}
+
+APTR AllocVecDMA(ULONG size, ULONG flags)
+{
+    return arena_Alloc(size, flags, 32, 0, 0);
+}
+
+void FreeVecDMA(APTR mem)
+{
+    arena_Free_(mem);
+}
+
+APTR CreatePool(ULONG flags, ULONG puddle, ULONG thresh)
+{
+    HostPool *pool = AllocMem(sizeof(*pool), MEMF_CLEAR);
+
+    if (NULL != pool)
+    {
+        NEWLIST(&pool->hp_Items);
+        pool->hp_Flags = flags;
+    }
+
+    return pool;
+}
+
+void DeletePool(APTR pool)
+{
+    HostPool *hp = pool;
+    struct MinNode *node;
+
+    if (NULL == hp)
+    {
+        return;
+    }
+
+    while (NULL != (node = REMHEAD(&hp->hp_Items)))
+    {
+        arena_Free_((HostBlockHeader *)(node + 1) + 1);
+    }
+
+    FreeMem(hp, sizeof(*hp));
+}
+
+/* Pooled blocks: [MinNode][HostBlockHeader][user data] */
+APTR AllocPooledAligned(APTR pool, ULONG size, ULONG align, ULONG offset)
+{
+    HostPool *hp = pool;
+    struct MinNode *node;
+    APTR mem;
+
+    mem = arena_Alloc(size, hp->hp_Flags, align, offset, sizeof(struct MinNode));
+    if (NULL != mem)
+    {
+        node = (struct MinNode *)((HostBlockHeader *)mem - 1) - 1;
+        pthread_mutex_lock(&exec_Lock);
+        ADDTAIL(&hp->hp_Items, node);
+        pthread_mutex_unlock(&exec_Lock);
+    }
+
+    return mem;
+}
+
+APTR AllocPooled(APTR pool, ULONG size)
+{
+    return AllocPooledAligned(pool, size, 16, 0);
+}
+
+void FreePooled(APTR pool, APTR mem, ULONG size)
+{
+    struct MinNode *node;
+
+    if (NULL == mem)
+    {
+        return;
+    }
+
+    node = (struct MinNode *)arena_Header(mem) - 1;
+    pthread_mutex_lock(&exec_Lock);
+    REMOVE(node);
+    pthread_mutex_unlock(&exec_Lock);
+
+    arena_Free_(mem);
+}
+
+APTR AllocVecPooled(APTR pool, ULONG size)
+{
+    return AllocPooled(pool, size);
+}
+
+void FreeVecPooled(APTR pool, APTR mem)
+{
+    FreePooled(pool, mem, 0);
+}
+
+void CopyMem(CONST_APTR src, APTR dst, ULONG size)
+{
+    memmove(dst, src, size);
+}
+
+void CopyMemQuick(CONST_APTR src, APTR dst, ULONG size)
+{
+    memmove(dst, src, size);
+}
+
+/* The simulated controller works on virtual addresses: there is no IOMMU
+ * nor cache to manage.
+ */
+APTR CachePreDMA(CONST_APTR addr, ULONG *length, ULONG flags)
+{
+    return (APTR)addr;
+}
+
+void CachePostDMA(CONST_APTR addr, ULONG *length, ULONG flags)
+{
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- LISTS ------------------------------------------------------------------*/
+
+void AddHead(struct List *list, struct Node *node)
+{
+    node->ln_Succ = list->lh_Head;
+    node->ln_Pred = (struct Node *)&list->lh_Head;
+    list->lh_Head->ln_Pred = node;
+    list->lh_Head = node;
+}
+
+void AddTail(struct List *list, struct Node *node)
+{
+    node->ln_Succ = (struct Node *)&list->lh_Tail;
+    node->ln_Pred = list->lh_TailPred;
+    list->lh_TailPred->ln_Succ = node;
+    list->lh_TailPred = node;
+}
+
+void Remove(struct Node *node)
+{
+    node->ln_Pred->ln_Succ = node->ln_Succ;
+    node->ln_Succ->ln_Pred = node->ln_Pred;
+}
+
+struct Node *RemHead(struct List *list)
+{
+    struct Node *node = list->lh_Head;
+
+    if (NULL == node->ln_Succ)
+    {
+        return NULL;
+    }
+
+    Remove(node);
+    return node;
+}
+
+struct Node *RemTail(struct List *list)
+{
+    struct Node *node = list->lh_TailPred;
+
+    if (NULL == node->ln_Pred)
+    {
+        return NULL;
+    }
+
+    Remove(node);
+    return node;
+}
+
+void Insert(struct List *list, struct Node *node, struct Node *pred)
+{
+    if (NULL == pred)
+    {
+        AddHead(list, node);
+    }
+    else if (NULL == pred->ln_Succ)
+    {
+        AddTail(list, node);
+    }
+    else
+    {
+        node->ln_Succ = pred->ln_Succ;
+        node->ln_Pred = pred;
+        pred->ln_Succ->ln_Pred = node;
+        pred->ln_Succ = node;
+    }
+}
+
+void Enqueue(struct List *list, struct Node *node)
+{
+    struct Node *next;
+
+    ForeachNode(list, next)
+    {
+        if (next->ln_Pri < node->ln_Pri)
+        {
+            break;
+        }
+    }
+
+    Insert(list, node, next->ln_Pred);
+}
+
+struct Node *FindName(struct List *list, CONST_STRPTR name)
+{
+    struct Node *node;
+
+    ForeachNode(list, node)
+    {
+        if ((NULL != node->ln_Name) && !strcmp(node->ln_Name, name))
+        {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- TAGS -------------------------------------------------------------------*/
+
+struct TagItem *NextTagItem(struct TagItem **tags)
+{
+    struct TagItem *ti;
+
+    while (NULL != (ti = *tags))
+    {
+        switch (ti->ti_Tag)
+        {
+            case TAG_DONE:
+                *tags = NULL;
+                return NULL;
+
+            case TAG_MORE:
+                *tags = (struct TagItem *)ti->ti_Data;
+                break;
+
+            case TAG_IGNORE:
+                (*tags)++;
+                break;
+
+            case TAG_SKIP:
+                *tags += ti->ti_Data + 1;
+                break;
+
+            default:
+                (*tags)++;
+                return ti;
+        }
+    }
+
+    return NULL;
+}
+
+struct TagItem *FindTagItem(Tag tag, const struct TagItem *tags)
+{
+    struct TagItem *ti, *state = (struct TagItem *)tags;
+
+    while (NULL != (ti = NextTagItem(&state)))
+    {
+        if (tag == ti->ti_Tag)
+        {
+            return ti;
+        }
+    }
+
+    return NULL;
+}
+
+IPTR GetTagData(Tag tag, IPTR def, const struct TagItem *tags)
+{
+    struct TagItem *ti = FindTagItem(tag, tags);
+
+    return NULL != ti ? ti->ti_Data : def;
+}
+
+LONG Stricmp(CONST_STRPTR a, CONST_STRPTR b)
+{
+    return strcasecmp((const char *)a, (const char *)b);
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- TASKS AND SIGNALS ------------------------------------------------------*/
+
+static HostTask *exec_NewHostTask(CONST_STRPTR name)
+{
+    HostTask *ht = AllocMem(sizeof(*ht), MEMF_CLEAR);
+
+    if (NULL != ht)
+    {
+        ht->ht_Task.tc_Node.ln_Type = NT_TASK;
+        ht->ht_Task.tc_Node.ln_Name = (char *)name;
+        ht->ht_Task.tc_SigAlloc = 0xffff; /* system signals */
+        ht->ht_Task.tc_Host = ht;
+        pthread_cond_init(&ht->ht_Cond, NULL);
+    }
+
+    return ht;
+}
+
+struct Task *FindTask(CONST_STRPTR name)
+{
+    if (NULL != name)
+    {
+        return NULL;
+    }
+
+    if (NULL == exec_ThisTask)
+    {
+        exec_ThisTask = exec_NewHostTask("host main");
+    }
+
+    return &exec_ThisTask->ht_Task;
+}
+
+/* exec_Lock must be held */
+static void exec_SignalLocked(struct Task *task, ULONG sigs)
+{
+    HostTask *ht = task->tc_Host;
+
+    task->tc_SigRecvd |= sigs;
+    if (task->tc_SigRecvd & task->tc_SigWait)
+    {
+        pthread_cond_signal(&ht->ht_Cond);
+    }
+}
+
+void Signal(struct Task *task, ULONG sigs)
+{
+    pthread_mutex_lock(&exec_Lock);
+    exec_SignalLocked(task, sigs);
+    pthread_mutex_unlock(&exec_Lock);
+}
+
+ULONG SetSignal(ULONG newsigs, ULONG mask)
+{
+    struct Task *task = FindTask(NULL);
+    ULONG old;
+
+    pthread_mutex_lock(&exec_Lock);
+    old = task->tc_SigRecvd;
+    task->tc_SigRecvd = (old & ~mask) | (newsigs & mask);
+    pthread_mutex_unlock(&exec_Lock);
+
+    return old;
+}
+
+ULONG Wait(ULONG sigs)
+{
+    struct Task *task = FindTask(NULL);
+    HostTask *ht = task->tc_Host;
+    ULONG recvd;
+
+    pthread_mutex_lock(&exec_Lock);
+    task->tc_SigWait = sigs;
+    while (0 == (task->tc_SigRecvd & sigs))
+    {
+        pthread_cond_wait(&ht->ht_Cond, &exec_Lock);
+    }
+    task->tc_SigWait = 0;
+    recvd = task->tc_SigRecvd & sigs;
+    task->tc_SigRecvd &= ~recvd;
+    pthread_mutex_unlock(&exec_Lock);
+
+    return recvd;
+}
+
+BYTE AllocSignal(LONG signum)
+{
+    struct Task *task = FindTask(NULL);
+    BYTE sig = -1;
+
+    pthread_mutex_lock(&exec_Lock);
+    if (-1 == signum)
+    {
+        for (signum = 31; signum >= 16; signum--)
+        {
+            if (0 == (task->tc_SigAlloc & (1ul << signum)))
+            {
+                break;
+            }
+        }
+    }
+
+    if ((signum >= 0) && (signum < 32) && (0 == (task->tc_SigAlloc & (1ul << signum))))
+    {
+        task->tc_SigAlloc |= 1ul << signum;
+        task->tc_SigRecvd &= ~(1ul << signum);
+        sig = signum;
+    }
+    pthread_mutex_unlock(&exec_Lock);
+
+    return sig;
+}
+
+void FreeSignal(LONG signum)
+{
+    struct Task *task = FindTask(NULL);
+
+    if (-1 != signum)
+    {
+        pthread_mutex_lock(&exec_Lock);
+        task->tc_SigAlloc &= ~(1ul << signum);
+        pthread_mutex_unlock(&exec_Lock);
+    }
+}
+
+void Forbid(void)
+{
+    pthread_once(&exec_Once, exec_Init);
+    pthread_mutex_lock(&exec_ForbidLock);
+}
+
+void Permit(void)
+{
+    pthread_mutex_unlock(&exec_ForbidLock);
+}
+
+static void *exec_TaskEntry(void *data)
+{
+    HostTask *ht = data;
+    struct Message *msg;
+
+    exec_ThisTask = ht;
+
+    ((void (*)(IPTR, IPTR))(IPTR)ht->ht_PC)(ht->ht_Args[0], ht->ht_Args[1]);
+
+    if (NULL != ht->ht_TaskPort)
+    {
+        DeleteMsgPort(ht->ht_TaskPort);
+    }
+
+    /* The stack is released by the next exec_ReapZombies() */
+    msg = ht->ht_StartupMsg;
+    pthread_mutex_lock(&exec_Lock);
+    ADDTAIL(&exec_Zombies, &ht->ht_ZombieNode);
+    pthread_mutex_unlock(&exec_Lock);
+
+    if ((NULL != msg) && (NULL != msg->mn_ReplyPort))
+    {
+        ReplyMsg(msg);
+    }
+
+    return NULL;
+}
+
+static void exec_ReapZombies(void)
+{
+    struct MinNode *node;
+    HostTask *ht;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&exec_Lock);
+        node = REMHEAD(&exec_Zombies);
+        pthread_mutex_unlock(&exec_Lock);
+
+        if (NULL == node)
+        {
+            break;
+        }
+
+        ht = (HostTask *)((UBYTE *)node - offsetof(HostTask, ht_ZombieNode));
+        pthread_join(ht->ht_Thread, NULL);
+        pthread_cond_destroy(&ht->ht_Cond);
+        FreeMem(ht->ht_Stack, 0);
+        FreeMem(ht, sizeof(*ht));
+    }
+}
+
+struct Task *NewCreateTaskA(struct TagItem *tags)
+{
+    struct MsgPort **portp;
+    pthread_attr_t attr;
+    HostTask *ht;
+    ULONG stacksize;
+
+    exec_ReapZombies();
+
+    ht = exec_NewHostTask((STRPTR)GetTagData(TASKTAG_NAME, 0, tags));
+    if (NULL == ht)
+    {
+        return NULL;
+    }
+
+    ht->ht_PC = GetTagData(TASKTAG_PC, 0, tags);
+    ht->ht_Args[0] = GetTagData(TASKTAG_PPC_ARG1, 0, tags);
+    ht->ht_Args[1] = GetTagData(TASKTAG_PPC_ARG2, 0, tags);
+    ht->ht_StartupMsg = (struct Message *)GetTagData(TASKTAG_STARTUPMSG, 0, tags);
+    ht->ht_Task.tc_UserData = (APTR)GetTagData(TASKTAG_USERDATA, 0, tags);
+    ht->ht_Task.tc_Node.ln_Pri = GetTagData(TASKTAG_PRI, 0, tags);
+
+    stacksize = GetTagData(TASKTAG_STACKSIZE, 0, tags);
+    if (stacksize < TASK_MIN_STACK)
+    {
+        stacksize = TASK_MIN_STACK;
+    }
+
+    ht->ht_Stack = AllocMemAligned(stacksize, MEMF_ANY, 4096, 0);
+    if (NULL == ht->ht_Stack)
+    {
+        goto err;
+    }
+
+    /* The task port is owned by the new task: allocate its signal there */
+    portp = (struct MsgPort **)GetTagData(TASKTAG_TASKMSGPORT, 0, tags);
+    if (NULL != portp)
+    {
+        struct MsgPort *port = AllocMem(sizeof(*port), MEMF_CLEAR);
+
+        if (NULL == port)
+        {
+            goto err;
+        }
+
+        port->mp_Node.ln_Type = NT_MSGPORT;
+        port->mp_Flags = PA_SIGNAL;
+        port->mp_SigBit = 31;
+        port->mp_SigTask = &ht->ht_Task;
+        ht->ht_Task.tc_SigAlloc |= 1ul << 31;
+        NEWLIST(&port->mp_MsgList);
+
+        ht->ht_TaskPort = port;
+        *portp = port;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, ht->ht_Stack, stacksize);
+    if (pthread_create(&ht->ht_Thread, &attr, exec_TaskEntry, ht))
+    {
+        pthread_attr_destroy(&attr);
+        if (NULL != ht->ht_TaskPort)
+        {
+            FreeMem(ht->ht_TaskPort, 0);
+        }
+        goto err;
+    }
+    pthread_attr_destroy(&attr);
+
+    return &ht->ht_Task;
+
+err:
+    FreeMem(ht->ht_Stack, 0);
+    pthread_cond_destroy(&ht->ht_Cond);
+    FreeMem(ht, sizeof(*ht));
+    return NULL;
+}
+
+struct Task *NewCreateTask(Tag tag, ...)
+{
+    struct TagItem tags[32];
+    va_list va;
+    ULONG i;
+
+    va_start(va, tag);
+    for (i = 0; i < 31; i++)
+    {
+        tags[i].ti_Tag = tag;
+        if (TAG_DONE == tag)
+        {
+            break;
+        }
+        tags[i].ti_Data = va_arg(va, ULONG);
+        tag = va_arg(va, ULONG);
+    }
+    tags[i].ti_Tag = TAG_DONE;
+    va_end(va);
+
+    return NewCreateTaskA(tags);
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- PORTS AND MESSAGES -----------------------------------------------------*/
+
+struct MsgPort *CreateMsgPort(void)
+{
+    struct MsgPort *port;
+    BYTE sig;
+
+    sig = AllocSignal(-1);
+    if (-1 == sig)
+    {
+        return NULL;
+    }
+
+    port = AllocMem(sizeof(*port), MEMF_CLEAR);
+    if (NULL == port)
+    {
+        FreeSignal(sig);
+        return NULL;
+    }
+
+    port->mp_Node.ln_Type = NT_MSGPORT;
+    port->mp_Flags = PA_SIGNAL;
+    port->mp_SigBit = sig;
+    port->mp_SigTask = FindTask(NULL);
+    NEWLIST(&port->mp_MsgList);
+
+    return port;
+}
+
+void DeleteMsgPort(struct MsgPort *port)
+{
+    if (NULL != port)
+    {
+        struct Task *task = port->mp_SigTask;
+
+        pthread_mutex_lock(&exec_Lock);
+        task->tc_SigAlloc &= ~(1ul << port->mp_SigBit);
+        pthread_mutex_unlock(&exec_Lock);
+
+        FreeMem(port, sizeof(*port));
+    }
+}
+
+static void exec_PutMsgLocked(struct MsgPort *port, struct Message *msg)
+{
+    ADDTAIL(&port->mp_MsgList, msg);
+    if ((PA_SIGNAL == (port->mp_Flags & PF_ACTION)) && (NULL != port->mp_SigTask))
+    {
+        exec_SignalLocked(port->mp_SigTask, 1ul << port->mp_SigBit);
+    }
+}
+
+void PutMsg(struct MsgPort *port, struct Message *msg)
+{
+    pthread_mutex_lock(&exec_Lock);
+    msg->mn_Node.ln_Type = NT_MESSAGE;
+    exec_PutMsgLocked(port, msg);
+    pthread_mutex_unlock(&exec_Lock);
+}
+
+struct Message *GetMsg(struct MsgPort *port)
+{
+    struct Message *msg;
+
+    pthread_mutex_lock(&exec_Lock);
+    msg = REMHEAD(&port->mp_MsgList);
+    pthread_mutex_unlock(&exec_Lock);
+
+    return msg;
+}
+
+void ReplyMsg(struct Message *msg)
+{
+    pthread_mutex_lock(&exec_Lock);
+    if (NULL == msg->mn_ReplyPort)
+    {
+        msg->mn_Node.ln_Type = NT_FREEMSG;
+    }
+    else
+    {
+        msg->mn_Node.ln_Type = NT_REPLYMSG;
+        exec_PutMsgLocked(msg->mn_ReplyPort, msg);
+    }
+    pthread_mutex_unlock(&exec_Lock);
+}
+
+struct Message *WaitPort(struct MsgPort *port)
+{
+    struct Message *msg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&exec_Lock);
+        msg = (struct Message *)port->mp_MsgList.lh_Head;
+        if (NULL == msg->mn_Node.ln_Succ)
+        {
+            msg = NULL;
+        }
+        pthread_mutex_unlock(&exec_Lock);
+
+        if (NULL != msg)
+        {
+            return msg;
+        }
+
+        Wait(1ul << port->mp_SigBit);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- SEMAPHORES -------------------------------------------------------------*/
+
+/* ss_NestCount counts the owner exclusive (and nested shared) locks,
+ * ss_QueueCount counts the shared holders.
+ */
+
+void InitSemaphore(struct SignalSemaphore *sem)
+{
+    memset(sem, 0, sizeof(*sem));
+    sem->ss_Link.ln_Type = NT_SEMAPHORE;
+    pthread_cond_init(&sem->ss_HostCond, NULL);
+}
+
+static BOOL sem_TryExclusive(struct SignalSemaphore *sem, struct Task *me)
+{
+    if (sem->ss_Owner == me)
+    {
+        sem->ss_NestCount++;
+        return TRUE;
+    }
+
+    if ((NULL == sem->ss_Owner) && (0 == sem->ss_QueueCount))
+    {
+        sem->ss_Owner = me;
+        sem->ss_NestCount = 1;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static BOOL sem_TryShared(struct SignalSemaphore *sem, struct Task *me)
+{
+    if (sem->ss_Owner == me)
+    {
+        sem->ss_NestCount++;
+        return TRUE;
+    }
+
+    if (NULL == sem->ss_Owner)
+    {
+        sem->ss_QueueCount++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+void ObtainSemaphore(struct SignalSemaphore *sem)
+{
+    struct Task *me = FindTask(NULL);
+
+    pthread_mutex_lock(&exec_Lock);
+    while (!sem_TryExclusive(sem, me))
+    {
+        pthread_cond_wait(&sem->ss_HostCond, &exec_Lock);
+    }
+    pthread_mutex_unlock(&exec_Lock);
+}
+
+void ObtainSemaphoreShared(struct SignalSemaphore *sem)
+{
+    struct Task *me = FindTask(NULL);
+
+    pthread_mutex_lock(&exec_Lock);
+    while (!sem_TryShared(sem, me))
+    {
+        pthread_cond_wait(&sem->ss_HostCond, &exec_Lock);
+    }
+    pthread_mutex_unlock(&exec_Lock);
+}
+
+ULONG AttemptSemaphore(struct SignalSemaphore *sem)
+{
+    struct Task *me = FindTask(NULL);
+    BOOL ok;
+
+    pthread_mutex_lock(&exec_Lock);
+    ok = sem_TryExclusive(sem, me);
+    pthread_mutex_unlock(&exec_Lock);
+
+    return ok;
+}
+
+ULONG AttemptSemaphoreShared(struct SignalSemaphore *sem)
+{
+    struct Task *me = FindTask(NULL);
+    BOOL ok;
+
+    pthread_mutex_lock(&exec_Lock);
+    ok = sem_TryShared(sem, me);
+    pthread_mutex_unlock(&exec_Lock);
+
+    return ok;
+}
+
+void ReleaseSemaphore(struct SignalSemaphore *sem)
+{
+    struct Task *me = FindTask(NULL);
+
+    pthread_mutex_lock(&exec_Lock);
+    if (sem->ss_Owner == me)
+    {
+        if (0 == --sem->ss_NestCount)
+        {
+            sem->ss_Owner = NULL;
+            pthread_cond_broadcast(&sem->ss_HostCond);
+        }
+    }
+    else if (sem->ss_QueueCount > 0)
+    {
+        if (0 == --sem->ss_QueueCount)
+        {
+            pthread_cond_broadcast(&sem->ss_HostCond);
+        }
+    }
+    else
+    {
+        fprintf(stderr, "hostexec: ReleaseSemaphore(%p) not obtained\n", sem);
+        abort();
+    }
+    pthread_mutex_unlock(&exec_Lock);
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- TIMER.DEVICE -----------------------------------------------------------*/
+
+static void timer_Now(struct timeval *tv)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    tv->tv_secs = ts.tv_sec;
+    tv->tv_micro = ts.tv_nsec / 1000;
+}
+
+void GetSysTime(struct timeval *dest)
+{
+    timer_Now(dest);
+}
+
+void AddTime(struct timeval *dest, const struct timeval *src)
+{
+    dest->tv_secs += src->tv_secs;
+    dest->tv_micro += src->tv_micro;
+    if (dest->tv_micro >= 1000000)
+    {
+        dest->tv_micro -= 1000000;
+        dest->tv_secs++;
+    }
+}
+
+void SubTime(struct timeval *dest, const struct timeval *src)
+{
+    if (dest->tv_micro < src->tv_micro)
+    {
+        dest->tv_micro += 1000000;
+        dest->tv_secs--;
+    }
+    dest->tv_micro -= src->tv_micro;
+    dest->tv_secs -= src->tv_secs;
+}
+
+/* Returns -1 if a > b, 0 if equal, 1 if a < b (as timer.device does) */
+LONG CmpTime(const struct timeval *a, const struct timeval *b)
+{
+    if (a->tv_secs != b->tv_secs)
+    {
+        return a->tv_secs > b->tv_secs ? -1 : 1;
+    }
+    if (a->tv_micro != b->tv_micro)
+    {
+        return a->tv_micro > b->tv_micro ? -1 : 1;
+    }
+    return 0;
+}
+
+ULONG ReadEClock(struct EClockVal *dest)
+{
+    struct timespec ts;
+    UQUAD us;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    us = (UQUAD)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    dest->ev_hi = us >> 32;
+    dest->ev_lo = us;
+
+    return 1000000;
+}
+
+static void *timer_Task(void *data)
+{
+    struct timerequest *tr;
+    struct timeval now;
+    struct timespec ts;
+
+    pthread_mutex_lock(&timer_Lock);
+    while (timer_Running)
+    {
+        tr = (struct timerequest *)timer_Pending.lh_Head;
+        if (NULL == tr->tr_node.io_Message.mn_Node.ln_Succ)
+        {
+            pthread_cond_wait(&timer_Cond, &timer_Lock);
+            continue;
+        }
+
+        timer_Now(&now);
+        if (CmpTime(&tr->tr_time, &now) >= 0)
+        {
+            REMOVE(tr);
+            tr->tr_node.io_Error = 0;
+            ReplyMsg(&tr->tr_node.io_Message);
+            continue;
+        }
+
+        ts.tv_sec = tr->tr_time.tv_secs;
+        ts.tv_nsec = tr->tr_time.tv_micro * 1000;
+        pthread_cond_timedwait(&timer_Cond, &timer_Lock, &ts);
+    }
+    pthread_mutex_unlock(&timer_Lock);
+
+    return NULL;
+}
+
+static void timer_BeginIO(struct timerequest *tr)
+{
+    struct timerequest *next;
+    struct timeval now;
+
+    tr->tr_node.io_Error = 0;
+    tr->tr_node.io_Message.mn_Node.ln_Type = NT_MESSAGE;
+
+    switch (tr->tr_node.io_Command)
+    {
+        case TR_ADDREQUEST:
+            /* Convert the delay into an absolute monotonic deadline */
+            if (UNIT_WAITUNTIL != (IPTR)tr->tr_node.io_Unit)
+            {
+                timer_Now(&now);
+                AddTime(&tr->tr_time, &now);
+            }
+
+            pthread_mutex_lock(&timer_Lock);
+            ForeachNode(&timer_Pending, next)
+            {
+                if (CmpTime(&next->tr_time, &tr->tr_time) < 0)
+                {
+                    break;
+                }
+            }
+            Insert(&timer_Pending, (struct Node *)tr, ((struct Node *)next)->ln_Pred);
+            pthread_cond_signal(&timer_Cond);
+            pthread_mutex_unlock(&timer_Lock);
+            return;
+
+        case TR_GETSYSTIME:
+            timer_Now(&tr->tr_time);
+            break;
+
+        default:
+            tr->tr_node.io_Error = IOERR_NOCMD;
+            break;
+    }
+
+    ReplyMsg(&tr->tr_node.io_Message);
+}
+
+static LONG timer_AbortIO(struct timerequest *tr)
+{
+    struct Node *node;
+
+    pthread_mutex_lock(&timer_Lock);
+    ForeachNode(&timer_Pending, node)
+    {
+        if (node == (struct Node *)tr)
+        {
+            REMOVE(tr);
+            tr->tr_node.io_Error = IOERR_ABORTED;
+            ReplyMsg(&tr->tr_node.io_Message);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&timer_Lock);
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- DEVICES AND I/O --------------------------------------------------------*/
+
+APTR CreateIORequest(struct MsgPort *port, ULONG size)
+{
+    struct IORequest *ioreq;
+
+    if (NULL == port)
+    {
+        return NULL;
+    }
+
+    ioreq = AllocMem(size, MEMF_PUBLIC | MEMF_CLEAR);
+    if (NULL != ioreq)
+    {
+        ioreq->io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+        ioreq->io_Message.mn_ReplyPort = port;
+        ioreq->io_Message.mn_Length = size;
+    }
+
+    return ioreq;
+}
+
+void DeleteIORequest(APTR ioreq)
+{
+    if (NULL != ioreq)
+    {
+        FreeMem(ioreq, 0);
+    }
+}
+
+struct IORequest *CreateExtIO(struct MsgPort *port, LONG size)
+{
+    return CreateIORequest(port, size);
+}
+
+void DeleteExtIO(struct IORequest *ioreq)
+{
+    DeleteIORequest(ioreq);
+}
+
+BYTE OpenDevice(CONST_STRPTR name, ULONG unit, struct IORequest *ioreq, ULONG flags)
+{
+    pthread_once(&exec_Once, exec_Init);
+
+    if (strcmp(name, TIMERNAME))
+    {
+        ioreq->io_Error = IOERR_OPENFAIL;
+        return IOERR_OPENFAIL;
+    }
+
+    ioreq->io_Device = &timer_Device;
+    ioreq->io_Unit = (struct Unit *)(IPTR)unit;
+    ioreq->io_Error = 0;
+    ioreq->io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+
+    return 0;
+}
+
+void CloseDevice(struct IORequest *ioreq)
+{
+    ioreq->io_Device = NULL;
+}
+
+void SendIO(struct IORequest *ioreq)
+{
+    ioreq->io_Flags &= ~IOF_QUICK;
+    timer_BeginIO((struct timerequest *)ioreq);
+}
+
+struct IORequest *CheckIO(struct IORequest *ioreq)
+{
+    return NT_REPLYMSG == ioreq->io_Message.mn_Node.ln_Type ? ioreq : NULL;
+}
+
+BYTE WaitIO(struct IORequest *ioreq)
+{
+    struct MsgPort *port = ioreq->io_Message.mn_ReplyPort;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&exec_Lock);
+        if (NT_REPLYMSG == ioreq->io_Message.mn_Node.ln_Type)
+        {
+            REMOVE(ioreq);
+            pthread_mutex_unlock(&exec_Lock);
+            break;
+        }
+        pthread_mutex_unlock(&exec_Lock);
+
+        Wait(1ul << port->mp_SigBit);
+    }
+
+    return ioreq->io_Error;
+}
+
+BYTE DoIO(struct IORequest *ioreq)
+{
+    SendIO(ioreq);
+    return WaitIO(ioreq);
+}
+
+LONG AbortIO(struct IORequest *ioreq)
+{
+    return timer_AbortIO((struct timerequest *)ioreq);
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- LIBRARIES --------------------------------------------------------------*/
+
+struct Library *OpenLibrary(CONST_STRPTR name, ULONG version)
+{
+    pthread_once(&exec_Once, exec_Init);
+    return &exec_Library;
+}
+
+void CloseLibrary(struct Library *lib)
+{
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- FORMATTING -------------------------------------------------------------*/
+
+static APTR fmt_PutString(APTR data, UBYTE c)
+{
+    STRPTR *buf = data;
+
+    *(*buf)++ = c;
+    return data;
+}
+
+static APTR fmt_Emit(APTR (*putch)(APTR, UBYTE), APTR data, CONST_STRPTR s, LONG len,
+                     LONG width, BOOL left, char pad)
+{
+    LONG i;
+
+    if (!left)
+    {
+        for (i = len; i < width; i++)
+        {
+            data = putch(data, pad);
+        }
+    }
+    for (i = 0; i < len; i++)
+    {
+        data = putch(data, s[i]);
+    }
+    if (left)
+    {
+        for (i = len; i < width; i++)
+        {
+            data = putch(data, ' ');
+        }
+    }
+
+    return data;
+}
+
+/* RawDoFmt() flavour used by the MorphOS sources: %l is a 32-bit value as
+ * plain integers, %ll a 64-bit one.
+ */
+STRPTR VNewRawDoFmt(CONST_STRPTR fmt, APTR (*putch)(APTR, UBYTE), STRPTR data, va_list args)
+{
+    STRPTR buf = data;
+    APTR pdata;
+
+    if (RAWFMTFUNC_STRING == putch)
+    {
+        putch = fmt_PutString;
+        pdata = &buf;
+    }
+    else
+    {
+        pdata = data;
+    }
+
+    for (; *fmt; fmt++)
+    {
+        char tmp[32], *s, pad = ' ', conv;
+        BOOL left = FALSE, plus = FALSE, alt = FALSE, neg = FALSE;
+        LONG width = 0, prec = -1, len, longs = 0;
+        UQUAD value;
+
+        if ('%' != *fmt)
+        {
+            pdata = putch(pdata, *fmt);
+            continue;
+        }
+
+        for (fmt++;; fmt++)
+        {
+            if ('-' == *fmt) left = TRUE;
+            else if ('0' == *fmt) pad = '0';
+            else if ('+' == *fmt) plus = TRUE;
+            else if ('#' == *fmt) alt = TRUE;
+            else if (' ' != *fmt) break;
+        }
+
+        if ('*' == *fmt)
+        {
+            width = va_arg(args, LONG);
+            fmt++;
+        }
+        else for (; (*fmt >= '0') && (*fmt <= '9'); fmt++)
+        {
+            width = width * 10 + (*fmt - '0');
+        }
+
+        if ('.' == *fmt)
+        {
+            fmt++;
+            prec = 0;
+            if ('*' == *fmt)
+            {
+                prec = va_arg(args, LONG);
+                fmt++;
+            }
+            else for (; (*fmt >= '0') && (*fmt <= '9'); fmt++)
+            {
+                prec = prec * 10 + (*fmt - '0');
+            }
+        }
+
+        for (; ('l' == *fmt) || ('h' == *fmt) || ('z' == *fmt); fmt++)
+        {
+            if ('l' == *fmt)
+            {
+                longs++;
+            }
+        }
+
+        conv = *fmt;
+        switch (conv)
+        {
+            case '\0':
+                fmt--;
+                continue;
+
+            case 's':
+                s = va_arg(args, char *);
+                if (NULL == s)
+                {
+                    s = "(null)";
+                }
+                len = strlen(s);
+                if ((prec >= 0) && (len > prec))
+                {
+                    len = prec;
+                }
+                pdata = fmt_Emit(putch, pdata, s, len, width, left, ' ');
+                continue;
+
+            case 'c':
+                tmp[0] = va_arg(args, int);
+                pdata = fmt_Emit(putch, pdata, tmp, 1, width, left, ' ');
+                continue;
+
+            case 'p':
+                value = (uintptr_t)va_arg(args, void *);
+                conv = 'x';
+                alt = TRUE;
+                break;
+
+            case 'd':
+            case 'i':
+                if (longs > 1)
+                {
+                    QUAD v = va_arg(args, QUAD);
+                    neg = v < 0;
+                    value = neg ? -(UQUAD)v : (UQUAD)v;
+                }
+                else
+                {
+                    LONG v = va_arg(args, LONG);
+                    neg = v < 0;
+                    value = neg ? -(UQUAD)v : (UQUAD)v;
+                }
+                break;
+
+            case 'u':
+            case 'x':
+            case 'X':
+                value = longs > 1 ? va_arg(args, UQUAD) : va_arg(args, ULONG);
+                break;
+
+            default:
+                pdata = putch(pdata, conv);
+                continue;
+        }
+
+        /* Integer conversions */
+        {
+            const char *digits = 'X' == conv ? "0123456789ABCDEF" : "0123456789abcdef";
+            ULONG base = (('x' == conv) || ('X' == conv)) ? 16 : 10;
+            char out[40];
+            LONG n = 0, pfx = 0, i;
+
+            s = tmp + sizeof(tmp);
+            do
+            {
+                *--s = digits[value % base];
+                value /= base;
+            }
+            while (value);
+            len = tmp + sizeof(tmp) - s;
+
+            if (neg)
+            {
+                out[pfx++] = '-';
+            }
+            else if (plus && (10 == base))
+            {
+                out[pfx++] = '+';
+            }
+            else if (alt && (16 == base))
+            {
+                out[pfx++] = '0';
+                out[pfx++] = conv;
+            }
+
+            for (i = len; i < prec; i++)
+            {
+                out[pfx + n++] = '0';
+            }
+            CopyMem(s, &out[pfx + n], len);
+            n += pfx + len;
+
+            if (('0' == pad) && !left && (prec < 0))
+            {
+                /* zero padding goes after the sign or the 0x prefix */
+                for (i = 0; i < pfx; i++)
+                {
+                    pdata = putch(pdata, out[i]);
+                }
+                pdata = fmt_Emit(putch, pdata, &out[pfx], n - pfx, width - pfx, FALSE, '0');
+            }
+            else
+            {
+                pdata = fmt_Emit(putch, pdata, out, n, width, left, ' ');
+            }
+        }
+    }
+
+    putch(pdata, '\0');
+
+    return data;
+}
+
+STRPTR NewRawDoFmt(CONST_STRPTR fmt, APTR (*putch)(APTR, UBYTE), STRPTR data, ...)
+{
+    va_list va;
+
+    va_start(va, data);
+    data = VNewRawDoFmt(fmt, putch, data, va);
+    va_end(va);
+
+    return data;
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- DEBUG ------------------------------------------------------------------*/
+
+struct debug_buf
+{
+    STRPTR  buf;
+    ULONG   size;
+};
+
+static APTR debug_PutCh(APTR data, UBYTE c)
+{
+    struct debug_buf *db = data;
+
+    if (db->size > 1)
+    {
+        *db->buf++ = c;
+        db->size--;
+    }
+    else
+    {
+        *db->buf = '\0';
+    }
+
+    return data;
+}
+
+void vkprintf(const char *fmt, va_list args)
+{
+    static int enabled = -1;
+    char buf[1024];
+    struct debug_buf db = {buf, sizeof(buf)};
+
+    if (enabled < 0)
+    {
+        enabled = NULL != getenv("HELIOS_HOST_DEBUG");
+    }
+
+    if (enabled)
+    {
+        VNewRawDoFmt(fmt, debug_PutCh, (STRPTR)&db, args);
+        fputs(buf, stderr);
+    }
+}
+
+void kprintf(const char *fmt, ...)
+{
+    va_list va;
+
+    va_start(va, fmt);
+    vkprintf(fmt, va);
+    va_end(va);
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- INIT -------------------------------------------------------------------*/
+
+static void exec_Init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_condattr_t cattr;
+
+    arena_Init();
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&exec_ForbidLock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    NEWLIST(&exec_Zombies);
+    NEWLIST(&timer_Pending);
+
+    exec_Library.lib_Node.ln_Type = NT_LIBRARY;
+    exec_Library.lib_Node.ln_Name = "host.library";
+    exec_Base.LibNode.lib_Node.ln_Name = "exec.library";
+    timer_Device.dd_Library.lib_Node.ln_Type = NT_DEVICE;
+    timer_Device.dd_Library.lib_Node.ln_Name = TIMERNAME;
+    SysBase = &exec_Base;
+
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer_Cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    timer_Running = TRUE;
+    if (pthread_create(&timer_Thread, NULL, timer_Task, NULL))
+    {
+        perror("timer thread");
+        abort();
+    }
+}
+
+/* Runs entry() as an exec task and returns its result: the host main
+ * thread has neither a low stack nor an exec task context.
+ */
+struct host_MainArgs
+{
+    int (*entry)(int, char **);
+    int argc;
+    char **argv;
+    int result;
+    struct Task *parent;
+};
+
+static void host_MainEntry(struct host_MainArgs *args)
+{
+    args->result = args->entry(args->argc, args->argv);
+    Signal(args->parent, SIGF_SINGLE);
+}
+
+int host_RunMain(int (*entry)(int, char **), int argc, char **argv)
+{
+    struct host_MainArgs *args;
+    struct Task *task;
+    int result;
+
+    pthread_once(&exec_Once, exec_Init);
+
+    args = AllocMem(sizeof(*args), MEMF_CLEAR);
+    args->entry = entry;
+    args->argc = argc;
+    args->argv = argv;
+    args->parent = FindTask(NULL);
+
+    SetSignal(0, SIGF_SINGLE);
+    task = NewCreateTask(TASKTAG_NAME,      (IPTR)"host test",
+                         TASKTAG_PC,        (IPTR)host_MainEntry,
+                         TASKTAG_PPC_ARG1,  (IPTR)args,
+                         TASKTAG_STACKSIZE, 1ul << 20,
+                         TAG_DONE);
+    if (NULL == task)
+    {
+        fprintf(stderr, "failed to create the main task\n");
+        return EXIT_FAILURE;
+    }
+
+    Wait(SIGF_SINGLE);
+    result = args->result;
+    FreeMem(args, sizeof(*args));
+
+    pthread_mutex_lock(&timer_Lock);
+    timer_Running = FALSE;
+    pthread_cond_signal(&timer_Cond);
+    pthread_mutex_unlock(&timer_Lock);
+    pthread_join(timer_Thread, NULL);
+
+    exec_ReapZombies();
+
+    return result;
+}
@@ -0,0 +1,885 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: the helios.library calls made by the ohci1394_pci.device,
+** and the src/common/utils.c routines (which read SysBase at address 4).
+**
+** Subtasks, timer and event delivery follow src/stack/libs/helios/misc.c.
+** Devices are bare objects: there is no ROM scanner nor class binding.
+**
+*/
+
+#include "helios_internals.h"
+#include "clib/helios_protos.h"
+
+#include <exec/errors.h>
+#include <proto/exec.h>
+#include <proto/utility.h>
+#include <proto/alib.h>
+#include <clib/timer_protos.h>
+#include <clib/debug_protos.h>
+#include <clib/macros.h>
+
+#include <string.h>
+#include <stdarg.h>
+
+#define BIB_CRC(v)          ((((QUADLET)(v))&0xffff) <<  0)
+#define BIB_CRC_LENGTH(v)   ((((QUADLET)(v))&255) << 16)
+#define BIB_INFO_LENGTH(v)  ((((QUADLET)(v))&255) << 24)
+
+#define MAKE_ID(a,b,c,d) ((ULONG) (a)<<24 | (ULONG) (b)<<16 | (ULONG) (c)<<8 | (ULONG) (d))
+
+struct HeliosSubTask
+{
+    struct Message         stc_Msg;
+    struct SignalSemaphore stc_Lock;         /* Lock stc_Task reads (use ObtainSemaphoreShared) */
+    STRPTR                 stc_TaskName;
+    struct Task *          stc_Task;         /* NULL if task is dead */
+    struct MsgPort *       stc_TaskPort;     /* Task msg port, valid only if task is running */
+    HeliosSubTaskEntry     stc_SubEntry;
+    APTR                   stc_Pool;
+    struct Task *          stc_Waiter;
+    ULONG                  stc_ReadySigBit;
+    LONG                   stc_Success;
+    struct TagItem         stc_ExtraTags[0];
+};
+
+static struct SignalSemaphore helios_BaseLock;
+static BOOL helios_BaseLockInit;
+
+/*----------------------------------------------------------------------------*/
+/*--- UTILS ------------------------------------------------------------------*/
+
+APTR utils_PutChProc(APTR data, UBYTE c)
+{
+    STRPTR *string_p = data;
+    ((*string_p)++)[0] = c;
+    return data;
+}
+
+APTR utils_SafePutChProc(APTR data, UBYTE c)
+{
+    struct safe_buf *sb = data;
+
+    if (sb->size)
+    {
+        (sb->buf++)[0] = c;
+        sb->size--;
+    }
+
+    return data;
+}
+
+APTR utils_SPrintF(STRPTR buf, STRPTR fmt, ...)
+{
+    STRPTR s = buf;
+    va_list va;
+
+    va_start(va, fmt);
+    VNewRawDoFmt(fmt, utils_PutChProc, (APTR)&s, va);
+    va_end(va);
+
+    return buf;
+}
+
+APTR utils_SafeSPrintF(STRPTR buf, ULONG size, STRPTR fmt, ...)
+{
+    struct safe_buf sb = {buf, size};
+    va_list va;
+
+    va_start(va, fmt);
+    VNewRawDoFmt(fmt, utils_SafePutChProc, (APTR)&sb, va);
+    va_end(va);
+
+    return buf;
+}
+
+STRPTR utils_DupStr(APTR pool, CONST_STRPTR src)
+{
+    ULONG len = strlen(src) + 1;
+    STRPTR dest;
+
+    if (NULL != pool)
+    {
+        dest = AllocVecPooled(pool, len);
+    }
+    else
+    {
+        dest = AllocVec(len, MEMF_PUBLIC);
+    }
+
+    if (NULL != dest)
+    {
+        CopyMem((STRPTR)src, dest, len);
+    }
+
+    return dest;
+}
+
+ULONG utils_GetPhyAddress(APTR addr)
+{
+    ULONG len = 16; // Hardware field len
+    APTR busaddr = CachePreDMA(addr, &len, 0L);
+
+    return (ULONG)(IPTR) busaddr;
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- BASE AND REPORTS -------------------------------------------------------*/
+
+void Helios_WriteLockBase(void)
+{
+    Forbid();
+    if (!helios_BaseLockInit)
+    {
+        InitSemaphore(&helios_BaseLock);
+        helios_BaseLockInit = TRUE;
+    }
+    Permit();
+
+    ObtainSemaphore(&helios_BaseLock);
+}
+
+void Helios_ReadLockBase(void)
+{
+    Helios_WriteLockBase();
+}
+
+void Helios_UnlockBase(void)
+{
+    ReleaseSemaphore(&helios_BaseLock);
+}
+
+ULONG hosthelios_Errors;
+
+LONG Helios_VReportMsg(ULONG type, CONST_STRPTR label, CONST_STRPTR fmt, va_list args)
+{
+    if (HRMB_ERROR == type)
+    {
+        hosthelios_Errors++;
+    }
+
+    kprintf("[%s] ", label);
+    vkprintf(fmt, args);
+    kprintf("\n");
+
+    return 0;
+}
+
+LONG Helios_ReportMsg(ULONG type, CONST_STRPTR label, CONST_STRPTR fmt, ...)
+{
+    va_list va;
+    LONG err;
+
+    va_start(va, fmt);
+    err = Helios_VReportMsg(type, label, fmt, va);
+    va_end(va);
+
+    return err;
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- EVENTS -----------------------------------------------------------------*/
+
+void Helios_AddEventListener(HeliosEventListenerList *list, HeliosEventMsg *node)
+{
+    LOCK_REGION(list);
+    ADDTAIL(&list->ell_SysList, node);
+    UNLOCK_REGION(list);
+}
+
+void Helios_RemoveEventListener(HeliosEventListenerList *list, HeliosEventMsg *node)
+{
+    LOCK_REGION(list);
+    REMOVE(node);
+    UNLOCK_REGION(list);
+}
+
+/* No event pool here: pooled listeners get allocated messages */
+void Helios_SendEvent(HeliosEventListenerList *list, ULONG event, ULONG result)
+{
+    HeliosEventMsg *msg, *node, *next;
+    struct timeval tv;
+
+    GetSysTime(&tv);
+
+    LOCK_REGION(list);
+    {
+        ForeachNodeSafe(list, node, next)
+        {
+            if (0 == (node->hm_EventMask & event))
+            {
+                continue;
+            }
+
+            if (HELIOS_MSGTYPE_FAST_EVENT == node->hm_Type)
+            {
+                REMOVE(node);
+                node->hm_Time = tv;
+                node->hm_Result = result;
+                ReplyMsg(&node->hm_Msg);
+                continue;
+            }
+
+            msg = AllocMem(sizeof(*msg), MEMF_PUBLIC);
+            if (NULL == msg)
+            {
+                _ERR("Msg alloc failed\n");
+                continue;
+            }
+
+            msg->hm_Msg.mn_ReplyPort = NULL;
+            msg->hm_Msg.mn_Length = sizeof(*msg);
+            msg->hm_Msg.mn_Node.ln_Type = NT_FREEMSG;
+            msg->hm_Type = HELIOS_MSGTYPE_EVENT;
+            msg->hm_Time = tv;
+            msg->hm_EventMask = event;
+            msg->hm_Result = result;
+            msg->hm_UserData = node->hm_UserData;
+            msg->hm_Count = 1;
+
+            PutMsg(node->hm_Msg.mn_ReplyPort, &msg->hm_Msg);
+        }
+    }
+    UNLOCK_REGION(list);
+}
+
+void Helios_FreeEvent(HeliosEventMsg *msg)
+{
+    FreeMem(msg, sizeof(*msg));
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- TIMER ------------------------------------------------------------------*/
+
+struct timerequest *Helios_OpenTimer(struct MsgPort *port, ULONG unit)
+{
+    struct timerequest *tr;
+
+    tr = (struct timerequest *)CreateExtIO(port, sizeof(*tr));
+    if (NULL != tr)
+    {
+        if (!OpenDevice("timer.device", unit, (struct IORequest *)tr, 0))
+        {
+            tr->tr_node.io_Command = TR_ADDREQUEST;
+            return tr;
+        }
+
+        _ERR("Failed to open timer.device\n");
+        DeleteExtIO((struct IORequest *)tr);
+    }
+    else
+    {
+        _ERR("Failed to create timer request\n");
+    }
+
+    return NULL;
+}
+
+void Helios_CloseTimer(struct timerequest *tr)
+{
+    CloseDevice((struct IORequest *)tr);
+    DeleteExtIO((struct IORequest *)tr);
+}
+
+void Helios_DelayMS(ULONG milli)
+{
+    struct MsgPort port;
+    struct timerequest tr;
+
+    /* Reply port setup (we use the task's port) */
+    port.mp_Flags   = PA_SIGNAL;
+    port.mp_SigBit  = SIGB_SINGLE;
+    port.mp_SigTask = FindTask(NULL);
+    NEWLIST(&port.mp_MsgList);
+
+    OpenDevice("timer.device", UNIT_MICROHZ, (struct IORequest *)&tr, 0);
+    tr.tr_node.io_Message.mn_ReplyPort = &port;
+    tr.tr_node.io_Command = TR_ADDREQUEST;
+    tr.tr_time.tv_secs  = milli / 1000;
+    tr.tr_time.tv_micro = (milli % 1000) * 1000;
+
+    DoIO((struct IORequest *)&tr);
+    CloseDevice((struct IORequest *)&tr);
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- SUBTASKS ---------------------------------------------------------------*/
+
+static void helios_SubTaskEntry(HeliosSubTask *ctx)
+{
+    BYTE rsb;
+    struct Task *waiter;
+    struct Task *task = FindTask(NULL);
+
+    struct TagItem tags[] =
+    {
+        {HA_MsgPort, 0},
+        {TAG_MORE, 0},
+        {TAG_END, 0}
+    };
+
+    /* Init task data */
+    ctx->stc_Task = task;
+    tags[0].ti_Data = (IPTR)ctx->stc_TaskPort;
+    tags[1].ti_Data = (IPTR)ctx->stc_ExtraTags;
+
+    /* Run child entry code */
+    ctx->stc_SubEntry(ctx, tags);
+
+    Helios_TaskReady(ctx, 0); /* NIL if no waiter */
+
+    ObtainSemaphore(&ctx->stc_Lock);
+    ctx->stc_Task = NULL; /* This set forbid Helios_SignalSubTask() and Helios_SendMsgToSubTask() functions usage. */
+    rsb = ctx->stc_ReadySigBit;
+    ctx->stc_ReadySigBit = 32;
+    waiter = ctx->stc_Waiter;
+    ReleaseSemaphore(&ctx->stc_Lock);
+
+    if (NULL != waiter)
+    {
+        Signal(waiter, 1lu << rsb);
+    }
+}
+
+ULONG Helios_SignalSubTask(HeliosSubTask *ctx, ULONG sigmask)
+{
+    ULONG err;
+
+    ObtainSemaphoreShared(&ctx->stc_Lock);
+
+    if (NULL != ctx->stc_Task)
+    {
+        Signal(ctx->stc_Task, sigmask);
+        err = HERR_NOERR;
+    }
+    else
+    {
+        err = HERR_SYSTEM;
+    }
+
+    ReleaseSemaphore(&ctx->stc_Lock);
+
+    return err;
+}
+
+LONG Helios_SendMsgToSubTask(HeliosSubTask *ctx, struct Message *msg)
+{
+    ULONG err;
+
+    ObtainSemaphoreShared(&ctx->stc_Lock);
+
+    if (NULL != ctx->stc_Task)
+    {
+        msg->mn_Node.ln_Type = NT_MESSAGE;
+        PutMsg(ctx->stc_TaskPort, msg);
+        err = HERR_NOERR;
+    }
+    else
+    {
+        err = HERR_SYSTEM;
+    }
+
+    ReleaseSemaphore(&ctx->stc_Lock);
+
+    return err;
+}
+
+LONG Helios_DoMsgToSubTask(HeliosSubTask *ctx, struct Message *msg, struct MsgPort *replyport)
+{
+    BOOL allocport = (NULL == replyport) || (NULL != msg->mn_ReplyPort);
+    LONG err;
+
+    if (allocport)
+    {
+        replyport = CreateMsgPort();
+        if (NULL == replyport)
+        {
+            _ERR("CreateMsgPort() failed\n");
+            return HERR_NOMEM;
+        }
+    }
+
+    if (NULL != replyport)
+    {
+        msg->mn_ReplyPort = replyport;
+    }
+
+    err = Helios_SendMsgToSubTask(ctx, msg);
+    if (HERR_NOERR != err)
+    {
+        goto end;
+    }
+
+    WaitPort(msg->mn_ReplyPort);
+    GetMsg(msg->mn_ReplyPort);
+
+end:
+    if (allocport)
+    {
+        DeleteMsgPort(replyport);
+    }
+
+    return err;
+}
+
+HeliosSubTask *Helios_CreateSubTaskA(CONST_STRPTR name,
+                                     HeliosSubTaskEntry entry,
+                                     struct TagItem *tags)
+{
+    HeliosSubTask *ctx;
+    struct TagItem *tag, *next_tag;
+    LONG priority = 0;
+    APTR pool = NULL;
+    ULONG extra_tags_cnt = 0, size, name_len;
+
+    /* Parse tags */
+    next_tag = tags;
+    while (NULL != (tag = NextTagItem(&next_tag)))
+    {
+        switch (tag->ti_Tag)
+        {
+            case HA_Pool: pool = (APTR)tag->ti_Data; tag->ti_Tag = TAG_IGNORE; break;
+            case TASKTAG_PRI: priority = tag->ti_Data; tag->ti_Tag = TAG_IGNORE; break;
+            default: extra_tags_cnt++;
+        }
+    }
+
+    name_len = strlen(name) + 1;
+    size = sizeof(HeliosSubTask) + sizeof(struct TagItem) * (extra_tags_cnt+1) + name_len;
+
+    if (NULL != pool)
+    {
+        ctx = AllocVecPooled(pool, size);
+    }
+    else
+    {
+        ctx = AllocVec(size, MEMF_PUBLIC | MEMF_CLEAR);
+    }
+
+    if (NULL != ctx)
+    {
+        ULONG i;
+
+        InitSemaphore(&ctx->stc_Lock);
+        ctx->stc_TaskName = (APTR)ctx + (size - name_len);
+        strcpy(ctx->stc_TaskName, name);
+
+        /* Duplicate tags */
+        i = 0;
+        while ((NULL != (tag = NextTagItem(&tags))) && (i < extra_tags_cnt))
+        {
+            ctx->stc_ExtraTags[i].ti_Tag = tag->ti_Tag;
+            ctx->stc_ExtraTags[i].ti_Data = tag->ti_Data;
+            i++;
+        }
+        ctx->stc_ExtraTags[i].ti_Tag = TAG_END;
+
+        /* Create and run the new task */
+        ctx->stc_Msg.mn_Node.ln_Type = NT_MESSAGE;
+        ctx->stc_Msg.mn_ReplyPort = NULL;
+        ctx->stc_Msg.mn_Length = sizeof(*ctx);
+        ctx->stc_Pool = pool;
+        ctx->stc_SubEntry = entry;
+        ctx->stc_ReadySigBit = -1;
+        ctx->stc_Waiter = NULL;
+        ctx->stc_Success = -1;
+
+        /* Set under the lock: the task may read it before NewCreateTask() returns */
+        ObtainSemaphore(&ctx->stc_Lock);
+        ctx->stc_Task = NewCreateTask(TASKTAG_CODETYPE,    CODETYPE_PPC,
+                                      TASKTAG_NAME,        (IPTR)ctx->stc_TaskName,
+                                      TASKTAG_PRI,         priority,
+                                      TASKTAG_STACKSIZE,   32768,
+                                      TASKTAG_STARTUPMSG,  (IPTR)ctx,
+                                      TASKTAG_TASKMSGPORT, (IPTR)&ctx->stc_TaskPort,
+                                      TASKTAG_PC,          (IPTR)helios_SubTaskEntry,
+                                      TASKTAG_PPC_ARG1,    (IPTR)ctx,
+                                      TAG_DONE);
+        ReleaseSemaphore(&ctx->stc_Lock);
+        if (NULL != ctx->stc_Task)
+        {
+            return ctx;
+        }
+        else
+        {
+            _ERR("NewCreateTask(...) failed\n");
+        }
+    }
+    else
+    {
+        _ERR("Subtask ctx allocation failed\n");
+    }
+
+    if (NULL != pool)
+    {
+        FreeVecPooled(pool, ctx);
+    }
+    else
+    {
+        FreeVec(ctx);
+    }
+
+    return NULL;
+}
+
+HeliosSubTask *Helios_CreateSubTask(CONST_STRPTR name, HeliosSubTaskEntry entry, ...)
+{
+    struct TagItem tags[32];
+    va_list va;
+    ULONG i;
+
+    va_start(va, entry);
+    for (i = 0; i < 31; i++)
+    {
+        tags[i].ti_Tag = va_arg(va, ULONG);
+        if (TAG_DONE == tags[i].ti_Tag)
+        {
+            break;
+        }
+        tags[i].ti_Data = va_arg(va, ULONG);
+    }
+    tags[i].ti_Tag = TAG_DONE;
+    va_end(va);
+
+    return Helios_CreateSubTaskA(name, entry, tags);
+}
+
+LONG Helios_KillSubTask(HeliosSubTask *ctx)
+{
+    HeliosMsg msg;
+    struct Task *task;
+    struct MsgPort port;
+
+    ObtainSemaphoreShared(&ctx->stc_Lock);
+    task = ctx->stc_Task;
+    if (task != NULL)
+    {
+        /* Reply port setup (we use the task's port) */
+        port.mp_Flags   = PA_SIGNAL;
+        port.mp_SigBit  = SIGB_SINGLE;
+        port.mp_SigTask = FindTask(NULL);
+        NEWLIST(&port.mp_MsgList);
+
+        ctx->stc_Msg.mn_ReplyPort = &port;
+    }
+    ReleaseSemaphore(&ctx->stc_Lock);
+
+    if (FindTask(NULL) == task)
+    {
+        _ERR("A subtask can't kill itself!\n");
+        return HERR_SYSTEM;
+    }
+
+    if (NULL == task)
+    {
+        _ERR("Subtask already killed!\n");
+        return HERR_NOERR;
+    }
+
+    msg.hm_Msg.mn_Node.ln_Type = NT_MESSAGE;
+    msg.hm_Msg.mn_ReplyPort = NULL;
+    msg.hm_Msg.mn_Length = sizeof(msg);
+    msg.hm_Type = HELIOS_MSGTYPE_TASKKILL;
+
+    if (HERR_NOMEM == Helios_DoMsgToSubTask(ctx, (struct Message *)&msg, NULL))
+    {
+        return HERR_NOMEM;
+    }
+
+    /* Wait for the end of task */
+    for (;;)
+    {
+        Wait(SIGF_SINGLE);
+        if (&ctx->stc_Msg == GetMsg(&port))
+        {
+            break;
+        }
+    }
+
+    if (NULL != ctx->stc_Pool)
+    {
+        FreeVecPooled(ctx->stc_Pool, ctx);
+    }
+    else
+    {
+        FreeVec(ctx);
+    }
+
+    return HERR_NOERR;
+}
+
+LONG Helios_WaitTaskReady(HeliosSubTask *ctx, LONG sigs)
+{
+    struct Task *task;
+    LONG rsig = 0;
+
+    ObtainSemaphore(&ctx->stc_Lock);
+    {
+        task = ctx->stc_Task;
+        if (NULL != task)
+            if (32 != ctx->stc_ReadySigBit)
+            {
+                rsig = AllocSignal(-1);
+                if (-1 != rsig)
+                {
+                    ctx->stc_Waiter = FindTask(NULL);
+                    ctx->stc_ReadySigBit = rsig;
+                }
+            }
+    }
+    ReleaseSemaphore(&ctx->stc_Lock);
+
+    /* task already finished */
+    if ((NULL == task) || (0 == rsig))
+    {
+        return ctx->stc_Success?0:-1;
+    }
+
+    if (-1 == rsig)
+    {
+        _ERR("Failed to allocate signal on task %p\n", FindTask(NULL));
+        return -1;
+    }
+
+    sigs |= 1ul << rsig;
+    sigs = Wait(sigs);
+
+    FreeSignal(rsig);
+    if (sigs & (1ul << rsig))
+    {
+        return ctx->stc_Success?0:-1;
+    }
+    return sigs;
+}
+
+void Helios_TaskReady(HeliosSubTask *ctx, BOOL success)
+{
+    BYTE rsb;
+    struct Task *waiter;
+
+    ObtainSemaphore(&ctx->stc_Lock);
+    {
+        rsb = ctx->stc_ReadySigBit;
+        ctx->stc_ReadySigBit = 32;
+        waiter = ctx->stc_Waiter;
+        ctx->stc_Waiter = NULL;
+        ctx->stc_Success = success;
+    }
+    ReleaseSemaphore(&ctx->stc_Lock);
+
+    if (NULL != waiter)
+    {
+        Signal(waiter, 1lu << rsb);
+    }
+}
+
+LONG Helios_IsSubTaskKilled(HeliosSubTask *ctx)
+{
+    LONG killed;
+
+    ObtainSemaphoreShared(&ctx->stc_Lock);
+    killed = ctx->stc_Task == NULL;
+    ReleaseSemaphore(&ctx->stc_Lock);
+
+    return killed;
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- ROM --------------------------------------------------------------------*/
+
+/* Same default ROM as rom_SetDefault() of the library */
+static void rom_SetDefault(QUADLET *rom, UQUAD guid, QUADLET opts, QUADLET vendor_comp_id)
+{
+    HeliosBusOptions options;
+    UWORD crc;
+    ULONG i, j, length;
+
+    options.value = opts;
+    options.r.IsoRsrcMgr = 0;
+    options.r.CycleMaster = 1;
+    options.r.Isochronous = 0;
+    options.r.BusMgr = 0;
+    options.r.CycleClockAcc = 100;
+
+    /*--- Bus Info Block ---*/
+
+    rom[1]  = 0x31333934;
+    rom[2]  = options.value;
+    rom[3]  = guid >> 32;
+    rom[4]  = guid;
+
+    /* BIB crc */
+    crc = utils_GetBlockCRC16(&rom[1], 4);
+    rom[0] = BIB_INFO_LENGTH(4) | BIB_CRC_LENGTH(4) | BIB_CRC(crc);
+
+    /*--- Root Directory ---*/
+    i = 5;
+    rom[i++] = 0; // length + CRC16, filled later
+    rom[i++] = 0x03000000 | vendor_comp_id;
+    rom[i++] = 0x81000000; // offset filled later
+    rom[i++] = 0x0c0083c0; // node capabilities, see ISO/IEC 13213 : 1994
+    rom[i++] = 0x17000001;
+    rom[i++] = 0x81000000; // offset filled later
+
+    j = i;
+    rom[7] += i - 7;
+    rom[i++] = 0; // length + CRC16, filled later
+    rom[i++] = 0;
+    rom[i++] = 0;
+    rom[i++] = MAKE_ID('M', 'o', 'r', 'p');
+    rom[i++] = MAKE_ID('h', 'O', 'S', ' ');
+    rom[i++] = MAKE_ID('-', ' ', 'O', 'H');
+    rom[i++] = MAKE_ID('C', 'I', '1', '3');
+    rom[i++] = MAKE_ID('9', '4', '\0', '\0');
+
+    rom[j] = (length = i - j - 1) << 16;
+    rom[j] |= utils_GetBlockCRC16(&rom[j+1], length);
+
+    j = i;
+    rom[10] += i - 10;
+    rom[i++] = 0; // length + CRC16, filled later
+    rom[i++] = 0;
+    rom[i++] = 0;
+    rom[i++] = MAKE_ID('H', 'e', 'l', 'i');
+    rom[i++] = MAKE_ID('o', 's', '\0', '\0');
+
+    rom[j] = (length = i - j - 1) << 16;
+    rom[j] |= utils_GetBlockCRC16(&rom[j+1], length);
+
+    /* Update root directory length and compute its CRC */
+    length = 11 - 5 - 1;
+    rom[5] = (length << 16) | utils_GetBlockCRC16(&rom[6], length);
+}
+
+QUADLET *Helios_CreateROMTagList(APTR pool, CONST struct TagItem *tags)
+{
+    QUADLET *rom;
+
+    if (NULL != pool)
+    {
+        rom = AllocPooledAligned(pool, CSR_CONFIG_ROM_SIZE, CSR_CONFIG_ROM_SIZE, 0);
+    }
+    else
+    {
+        rom = AllocMemAligned(CSR_CONFIG_ROM_SIZE, MEMF_PUBLIC|MEMF_CLEAR, CSR_CONFIG_ROM_SIZE, 0);
+    }
+
+    if (NULL != rom)
+    {
+        /* Note: we suppose that data/length must be multiples of 4 */
+        QUADLET *data = (APTR)GetTagData(HA_Rom, 0, tags);
+        ULONG len = MIN(GetTagData(HA_RomLength, CSR_CONFIG_ROM_SIZE, tags), CSR_CONFIG_ROM_SIZE);
+
+        if (NULL != data)
+        {
+            CopyMemQuick(data, rom, len);
+            if (len < CSR_CONFIG_ROM_SIZE)
+            {
+                memset((APTR)rom + len, 0, CSR_CONFIG_ROM_SIZE - len);
+            }
+        }
+        else
+            rom_SetDefault(rom, (((UQUAD)GetTagData(HA_GUID_Hi, 0, tags)) << 32)
+                           | GetTagData(HA_GUID_Lo, 0, tags),
+                           GetTagData(HA_BusOptions, 0, tags),
+                           GetTagData(HHA_VendorCompagnyId, 0, tags));
+    }
+
+    return rom;
+}
+
+QUADLET *Helios_CreateROM(APTR pool, ...)
+{
+    struct TagItem tags[32];
+    va_list va;
+    ULONG i;
+
+    va_start(va, pool);
+    for (i = 0; i < 31; i++)
+    {
+        tags[i].ti_Tag = va_arg(va, ULONG);
+        if (TAG_DONE == tags[i].ti_Tag)
+        {
+            break;
+        }
+        tags[i].ti_Data = va_arg(va, ULONG);
+    }
+    tags[i].ti_Tag = TAG_DONE;
+    va_end(va);
+
+    return Helios_CreateROMTagList(pool, tags);
+}
+
+void Helios_FreeROM(APTR pool, QUADLET *rom)
+{
+    if (NULL != pool)
+    {
+        FreePooled(pool, rom, CSR_CONFIG_ROM_SIZE);
+    }
+    else
+    {
+        FreeMem(rom, CSR_CONFIG_ROM_SIZE);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*--- DEVICES ----------------------------------------------------------------*/
+
+HeliosDevice *Helios_AddDevice(HeliosHardware *hw, HeliosNode *node, ULONG topogen)
+{
+    HeliosDevice *dev;
+
+    dev = AllocMem(sizeof(*dev), MEMF_PUBLIC | MEMF_CLEAR);
+    if (NULL != dev)
+    {
+        LOCK_INIT(dev);
+        NEWLIST(&dev->hd_Listeners.ell_SysList);
+        LOCK_INIT(&dev->hd_Listeners);
+        NEWLIST(&dev->hd_Units);
+        dev->hso_RefCnt = 1;
+        dev->hd_Hardware = hw;
+        dev->hd_Generation = topogen;
+        dev->hd_NodeID = node->n_PhyID;
+        dev->hd_NodeInfo = *node;
+    }
+
+    return dev;
+}
+
+void Helios_UpdateDevice(HeliosDevice *dev, HeliosNode *node, ULONG topogen)
+{
+    LOCK_REGION(dev);
+    dev->hd_Generation = topogen;
+    dev->hd_NodeID = node->n_PhyID;
+    dev->hd_NodeInfo = *node;
+    UNLOCK_REGION(dev);
+}
+
+/* No ROM scanner: the device stays GUID-less */
+void Helios_ScanDevice(HeliosDevice *dev)
+{
+}
+
+void Helios_RemoveDevice(HeliosDevice *dev)
+{
+    FreeMem(dev, sizeof(*dev));
+}
@@ -0,0 +1,248 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: test harness of the ohci1394_pci.device on the simulated
+** controller.
+**
+*/
+
+#include "hosttest.h"
+
+#include "proto/helios.h"
+
+#include <exec/errors.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+ULONG hosttest_Failures;
+
+/*----------------------------------------------------------------------------*/
+/*--- PUBLIC CODE SECTION ----------------------------------------------------*/
+
+/* DEV_Init() then DEV_Open() of the unit 0, with the given peers on its bus */
+LONG hosttest_OpenUnit(HostTestUnit *tu, ULONG peers)
+{
+    memset(tu, 0, sizeof(*tu));
+
+    tu->htu_Port = CreateMsgPort();
+    tu->htu_Base = AllocMem(sizeof(OHCI1394Device), MEMF_PUBLIC | MEMF_CLEAR);
+    tu->htu_OpenReq = AllocMem(sizeof(IOHeliosHWReq), MEMF_PUBLIC | MEMF_CLEAR);
+    if ((NULL == tu->htu_Port) || (NULL == tu->htu_Base) || (NULL == tu->htu_OpenReq))
+    {
+        fprintf(stderr, "hosttest: no memory\n");
+        return HERR_NOMEM;
+    }
+
+    tu->htu_Base->hd_Library.lib_Node.ln_Type = NT_DEVICE;
+    tu->htu_Base->hd_Library.lib_Node.ln_Name = DEVNAME;
+    tu->htu_Base->hd_MemPool = CreatePool(MEMF_PUBLIC|MEMF_CLEAR, 16384, 4096);
+    if (NULL == tu->htu_Base->hd_MemPool)
+    {
+        return HERR_NOMEM;
+    }
+
+    tu->htu_Bus = ohcisim_OpenBus();
+    if (!ohci_ScanPCI(tu->htu_Base))
+    {
+        fprintf(stderr, "hosttest: PCI scan failed\n");
+        return HERR_SYSTEM;
+    }
+
+    tu->htu_Sim = ohcisim_GetBoard(0);
+    ohcisim_SetPeerCount(tu->htu_Sim, peers);
+
+    tu->htu_OpenReq->iohh_Req.io_Message.mn_ReplyPort = tu->htu_Port;
+    tu->htu_OpenReq->iohh_Req.io_Message.mn_Length = sizeof(IOHeliosHWReq);
+    tu->htu_OpenReq->iohh_Req.io_Device = (struct Device *)tu->htu_Base;
+    if (ohci_OpenUnit(tu->htu_Base, tu->htu_OpenReq, 0))
+    {
+        fprintf(stderr, "hosttest: unit open failed\n");
+        return HERR_SYSTEM;
+    }
+
+    tu->htu_Unit = (OHCI1394Unit *)tu->htu_OpenReq->iohh_Req.io_Unit;
+    return HERR_NOERR;
+}
+
+/* DEV_Close() then DEV_Expunge() */
+void hosttest_CloseUnit(HostTestUnit *tu)
+{
+    if (NULL != tu->htu_Unit)
+    {
+        ohci_CloseUnit(tu->htu_Base, tu->htu_OpenReq);
+        tu->htu_Unit = NULL;
+    }
+
+    if (NULL != tu->htu_Base)
+    {
+        DeletePool(tu->htu_Base->hd_MemPool);
+        FreeMem(tu->htu_Base, sizeof(OHCI1394Device));
+    }
+
+    if (NULL != tu->htu_OpenReq)
+    {
+        FreeMem(tu->htu_OpenReq, sizeof(IOHeliosHWReq));
+    }
+
+    ohcisim_CloseBus(tu->htu_Bus);
+    DeleteMsgPort(tu->htu_Port);
+    memset(tu, 0, sizeof(*tu));
+}
+
+void hosttest_InitIO(HostTestUnit *tu, IOHeliosHWReq *ioreq, UWORD cmd, ULONG size)
+{
+    memset(ioreq, 0, size);
+    ioreq->iohh_Req.io_Message.mn_ReplyPort = tu->htu_Port;
+    ioreq->iohh_Req.io_Message.mn_Length = size;
+    ioreq->iohh_Req.io_Device = (struct Device *)tu->htu_Base;
+    ioreq->iohh_Req.io_Unit = (struct Unit *)tu->htu_Unit;
+    ioreq->iohh_Req.io_Command = cmd;
+}
+
+/* DEV_BeginIO() for the commands used by the tests, never IOF_QUICK */
+void hosttest_SendIO(HostTestUnit *tu, IOHeliosHWReq *ioreq)
+{
+    OHCI1394Unit *unit = tu->htu_Unit;
+    OHCI1394Device *base = tu->htu_Base;
+    ULONG ret;
+
+    ioreq->iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
+    ioreq->iohh_Req.io_Flags = 0;
+    ioreq->iohh_Req.io_Error = 0;
+
+    switch (ioreq->iohh_Req.io_Command)
+    {
+        case CMD_RESET: ret = cmdReset(ioreq, unit, base); break;
+        case HHIOCMD_QUERYDEVICE: ret = cmdQueryDevice(ioreq, unit, base); break;
+        case HHIOCMD_BUSRESET: ret = cmdBusReset(ioreq, unit, base); break;
+        case HHIOCMD_SENDREQUEST: ret = cmdSendRequest(ioreq, unit, base); break;
+        case HHIOCMD_SENDREQUESTS: ret = cmdSendRequests(ioreq, unit, base); break;
+        case HHIOCMD_SETATTRIBUTES: ret = cmdSetAttrs(ioreq, unit, base); break;
+        case HHIOCMD_DUMPTRACE: ret = cmdDumpTrace(ioreq, unit, base); break;
+        case HHIOCMD_RESETSTATISTICS: ret = cmdResetStatistics(ioreq, unit, base); break;
+        case HHIOCMD_READCAPTURE: ret = cmdReadCapture(ioreq, unit, base); break;
+
+        default:
+            ioreq->iohh_Req.io_Error = IOERR_NOCMD;
+            ret = 0;
+            break;
+    }
+
+    if (!ret)
+    {
+        ReplyMsg(&ioreq->iohh_Req.io_Message);
+    }
+}
+
+LONG hosttest_DoIO(HostTestUnit *tu, IOHeliosHWReq *ioreq)
+{
+    hosttest_SendIO(tu, ioreq);
+    return WaitIO(&ioreq->iohh_Req);
+}
+
+/* Wait for a valid topology of a generation greater than the given one.
+ * Returns NULL on timeout.
+ */
+HeliosTopology *hosttest_WaitTopology(HostTestUnit *tu, ULONG generation, ULONG timeout_ms)
+{
+    OHCI1394Unit *unit = tu->htu_Unit;
+    HeliosTopology *topo;
+
+    for (;;)
+    {
+        LOCK_REGION_SHARED(unit);
+        topo = unit->hu_Topology;
+        if ((NULL != topo) && (topo->ht_Generation <= generation))
+        {
+            topo = NULL;
+        }
+        UNLOCK_REGION_SHARED(unit);
+
+        if ((NULL != topo) || (0 == timeout_ms--))
+        {
+            return topo;
+        }
+
+        Helios_DelayMS(1);
+    }
+}
+
+static LONG hosttest_Block(HostTestUnit *tu, UWORD nodeid, HeliosOffset offset,
+                           APTR buf, ULONG length, BOOL write)
+{
+    IOHeliosHWSendRequest ioreq;
+    HeliosAPacket *p = &ioreq.iohhe_Transaction.htr_Packet;
+    LONG err;
+
+    hosttest_InitIO(tu, &ioreq.iohhe_Req, HHIOCMD_SENDREQUEST, sizeof(ioreq));
+    if (write)
+    {
+        Helios_FillWriteBlockPacket(p, S400, offset, buf, length);
+    }
+    else
+    {
+        Helios_FillReadBlockPacket(p, S400, offset, length);
+        ioreq.iohhe_Req.iohh_Data = buf;
+        ioreq.iohhe_Req.iohh_Length = length;
+    }
+    p->DestID = nodeid;
+
+    err = hosttest_DoIO(tu, &ioreq.iohhe_Req);
+    if (HHIOERR_NO_ERROR != err)
+    {
+        return err;
+    }
+
+    if (HELIOS_RCODE_COMPLETE != p->RCode)
+    {
+        return HHIOERR_FAILED;
+    }
+
+    if (!write && (ioreq.iohhe_Req.iohh_Actual != (LONG)length))
+    {
+        return HHIOERR_FAILED;
+    }
+
+    return HHIOERR_NO_ERROR;
+}
+
+LONG hosttest_Read(HostTestUnit *tu, UWORD nodeid, HeliosOffset offset, APTR buf, ULONG length)
+{
+    return hosttest_Block(tu, nodeid, offset, buf, length, FALSE);
+}
+
+LONG hosttest_Write(HostTestUnit *tu, UWORD nodeid, HeliosOffset offset, APTR buf, ULONG length)
+{
+    return hosttest_Block(tu, nodeid, offset, buf, length, TRUE);
+}
+
+int hosttest_Result(CONST_STRPTR name)
+{
+    if (hosttest_Failures)
+    {
+        printf("FAIL: %s (%lu failed checks)\n", name, (unsigned long)hosttest_Failures);
+        return 1;
+    }
+
+    printf("PASS: %s\n", name);
+    return 0;
+}
@@ -0,0 +1,57 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: test harness of the ohci1394_pci.device on the simulated
+** controller.
+**
+** A test opens the unit as DEV_Init() and DEV_Open() do, then drives it
+** with the device commands, as a client would with DoIO().
+**
+*/
+
+#ifndef HOSTTEST_H
+#define HOSTTEST_H
+
+#include "ohci1394.device.h"
+#include "ohci1394core.h"
+#include "ohci1394sim.h"
+#include "hostcheck.h"
+
+typedef struct HostTestUnit
+{
+    struct Library *    htu_Bus;
+    OHCI1394Device *    htu_Base;
+    OHCI1394Unit *      htu_Unit;
+    OHCI1394Sim *       htu_Sim;
+    IOHeliosHWReq *     htu_OpenReq;
+    struct MsgPort *    htu_Port;
+} HostTestUnit;
+
+extern LONG hosttest_OpenUnit(HostTestUnit *tu, ULONG peers);
+extern void hosttest_CloseUnit(HostTestUnit *tu);
+extern void hosttest_InitIO(HostTestUnit *tu, IOHeliosHWReq *ioreq, UWORD cmd, ULONG size);
+extern void hosttest_SendIO(HostTestUnit *tu, IOHeliosHWReq *ioreq);
+extern LONG hosttest_DoIO(HostTestUnit *tu, IOHeliosHWReq *ioreq);
+extern HeliosTopology *hosttest_WaitTopology(HostTestUnit *tu, ULONG generation, ULONG timeout_ms);
+extern LONG hosttest_Read(HostTestUnit *tu, UWORD nodeid, HeliosOffset offset, APTR buf, ULONG length);
+extern LONG hosttest_Write(HostTestUnit *tu, UWORD nodeid, HeliosOffset offset, APTR buf, ULONG length);
+
+#endif /* HOSTTEST_H */
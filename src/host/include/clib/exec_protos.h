@@ -0,0 +1,109 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec.library functions (hostexec.c).
+**
+*/
+
+#ifndef HOST_CLIB_EXEC_PROTOS_H
+#define HOST_CLIB_EXEC_PROTOS_H
+
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <exec/lists.h>
+#include <exec/ports.h>
+#include <exec/tasks.h>
+#include <exec/semaphores.h>
+#include <exec/io.h>
+#include <exec/libraries.h>
+#include <exec/execbase.h>
+#include <utility/tagitem.h>
+#include <stdarg.h>
+
+/* CachePreDMA()/CachePostDMA() flags */
+#define DMA_Continue    (1L<<1)
+#define DMA_NoModify    (1L<<2)
+#define DMA_ReadFromRAM (1L<<3)
+
+extern APTR AllocMem(ULONG size, ULONG flags);
+extern void FreeMem(APTR mem, ULONG size);
+extern APTR AllocMemAligned(ULONG size, ULONG flags, ULONG align, ULONG offset);
+extern APTR AllocVec(ULONG size, ULONG flags);
+extern void FreeVec(APTR mem);
+extern APTR AllocVecDMA(ULONG size, ULONG flags);
+extern void FreeVecDMA(APTR mem);
+extern APTR CreatePool(ULONG flags, ULONG puddle, ULONG thresh);
+extern void DeletePool(APTR pool);
+extern APTR AllocPooled(APTR pool, ULONG size);
+extern void FreePooled(APTR pool, APTR mem, ULONG size);
+extern APTR AllocPooledAligned(APTR pool, ULONG size, ULONG align, ULONG offset);
+extern APTR AllocVecPooled(APTR pool, ULONG size);
+extern void FreeVecPooled(APTR pool, APTR mem);
+extern void CopyMem(CONST_APTR src, APTR dst, ULONG size);
+extern void CopyMemQuick(CONST_APTR src, APTR dst, ULONG size);
+extern APTR CachePreDMA(CONST_APTR addr, ULONG *length, ULONG flags);
+extern void CachePostDMA(CONST_APTR addr, ULONG *length, ULONG flags);
+
+extern void Forbid(void);
+extern void Permit(void);
+
+extern struct Task *FindTask(CONST_STRPTR name);
+extern struct Task *NewCreateTaskA(struct TagItem *tags);
+extern struct Task *NewCreateTask(Tag tag, ...);
+extern BYTE AllocSignal(LONG signum);
+extern void FreeSignal(LONG signum);
+extern void Signal(struct Task *task, ULONG sigs);
+extern ULONG SetSignal(ULONG newsigs, ULONG mask);
+extern ULONG Wait(ULONG sigs);
+
+extern struct MsgPort *CreateMsgPort(void);
+extern void DeleteMsgPort(struct MsgPort *port);
+extern void PutMsg(struct MsgPort *port, struct Message *msg);
+extern struct Message *GetMsg(struct MsgPort *port);
+extern void ReplyMsg(struct Message *msg);
+extern struct Message *WaitPort(struct MsgPort *port);
+
+extern APTR CreateIORequest(struct MsgPort *port, ULONG size);
+extern void DeleteIORequest(APTR ioreq);
+extern BYTE OpenDevice(CONST_STRPTR name, ULONG unit, struct IORequest *ioreq, ULONG flags);
+extern void CloseDevice(struct IORequest *ioreq);
+extern BYTE DoIO(struct IORequest *ioreq);
+extern void SendIO(struct IORequest *ioreq);
+extern struct IORequest *CheckIO(struct IORequest *ioreq);
+extern BYTE WaitIO(struct IORequest *ioreq);
+extern LONG AbortIO(struct IORequest *ioreq);
+
+extern void InitSemaphore(struct SignalSemaphore *sem);
+extern void ObtainSemaphore(struct SignalSemaphore *sem);
+extern void ObtainSemaphoreShared(struct SignalSemaphore *sem);
+extern ULONG AttemptSemaphore(struct SignalSemaphore *sem);
+extern ULONG AttemptSemaphoreShared(struct SignalSemaphore *sem);
+extern void ReleaseSemaphore(struct SignalSemaphore *sem);
+
+extern struct Library *OpenLibrary(CONST_STRPTR name, ULONG version);
+extern void CloseLibrary(struct Library *lib);
+
+#define RAWFMTFUNC_STRING   ((APTR (*)(APTR, UBYTE))0)
+
+extern STRPTR NewRawDoFmt(CONST_STRPTR fmt, APTR (*putch)(APTR, UBYTE), STRPTR data, ...);
+extern STRPTR VNewRawDoFmt(CONST_STRPTR fmt, APTR (*putch)(APTR, UBYTE), STRPTR data, va_list args);
+
+#endif /* HOST_CLIB_EXEC_PROTOS_H */
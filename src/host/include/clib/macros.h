@@ -0,0 +1,42 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: common macros.
+**
+*/
+
+#ifndef HOST_CLIB_MACROS_H
+#define HOST_CLIB_MACROS_H
+
+#ifndef MIN
+#define MIN(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)   (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef ABS
+#define ABS(a)      (((a) < 0) ? -(a) : (a))
+#endif
+#ifndef CLAMP
+#define CLAMP(x, l, h)  MIN(MAX((x), (l)), (h))
+#endif
+
+#endif /* HOST_CLIB_MACROS_H */
@@ -0,0 +1,37 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: timer.device functions (hostexec.c).
+**
+*/
+
+#ifndef HOST_CLIB_TIMER_PROTOS_H
+#define HOST_CLIB_TIMER_PROTOS_H
+
+#include <devices/timer.h>
+
+extern void GetSysTime(struct timeval *dest);
+extern void AddTime(struct timeval *dest, const struct timeval *src);
+extern void SubTime(struct timeval *dest, const struct timeval *src);
+extern LONG CmpTime(const struct timeval *a, const struct timeval *b);
+extern ULONG ReadEClock(struct EClockVal *dest);
+
+#endif /* HOST_CLIB_TIMER_PROTOS_H */
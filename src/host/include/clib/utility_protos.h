@@ -0,0 +1,36 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: utility.library functions (hostexec.c).
+**
+*/
+
+#ifndef HOST_CLIB_UTILITY_PROTOS_H
+#define HOST_CLIB_UTILITY_PROTOS_H
+
+#include <utility/tagitem.h>
+
+extern IPTR GetTagData(Tag tag, IPTR def, const struct TagItem *tags);
+extern struct TagItem *FindTagItem(Tag tag, const struct TagItem *tags);
+extern struct TagItem *NextTagItem(struct TagItem **tags);
+extern LONG Stricmp(CONST_STRPTR a, CONST_STRPTR b);
+
+#endif /* HOST_CLIB_UTILITY_PROTOS_H */
@@ -0,0 +1,60 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: HD_SCSICMD.
+**
+*/
+
+#ifndef HOST_DEVICES_SCSIDISK_H
+#define HOST_DEVICES_SCSIDISK_H
+
+#include <exec/types.h>
+
+#define HD_SCSICMD      28
+
+struct SCSICmd
+{
+    UWORD * scsi_Data;
+    ULONG   scsi_Length;
+    ULONG   scsi_Actual;
+    UBYTE * scsi_Command;
+    UWORD   scsi_CmdLength;
+    UWORD   scsi_CmdActual;
+    UBYTE   scsi_Flags;
+    UBYTE   scsi_Status;
+    UBYTE * scsi_SenseData;
+    UWORD   scsi_SenseLength;
+    UWORD   scsi_SenseActual;
+};
+
+#define SCSIF_WRITE         0
+#define SCSIF_READ          1
+#define SCSIF_AUTOSENSE     2
+#define SCSIF_OLDAUTOSENSE  6
+
+#define HFERR_SelfUnit      40
+#define HFERR_DMA           41
+#define HFERR_Phase         42
+#define HFERR_Parity        43
+#define HFERR_SelTimeout    44
+#define HFERR_BadStatus     45
+
+#endif /* HOST_DEVICES_SCSIDISK_H */
@@ -0,0 +1,67 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: timer.device.
+**
+** The C library struct timeval is declared first, then the exec one takes
+** its name in the code including this file.
+**
+*/
+
+#ifndef HOST_DEVICES_TIMER_H
+#define HOST_DEVICES_TIMER_H
+
+#include <exec/io.h>
+#include <sys/time.h>
+
+#define timeval host_timeval
+
+struct timeval
+{
+    ULONG   tv_secs;
+    ULONG   tv_micro;
+};
+
+struct EClockVal
+{
+    ULONG   ev_hi;
+    ULONG   ev_lo;
+};
+
+struct timerequest
+{
+    struct IORequest    tr_node;
+    struct timeval      tr_time;
+};
+
+#define TIMERNAME       "timer.device"
+
+#define UNIT_MICROHZ    0
+#define UNIT_VBLANK     1
+#define UNIT_ECLOCK     2
+#define UNIT_WAITUNTIL  3
+#define UNIT_WAITECLOCK 4
+
+#define TR_ADDREQUEST   CMD_NONSTD
+#define TR_GETSYSTIME   (CMD_NONSTD+1)
+#define TR_SETSYSTIME   (CMD_NONSTD+2)
+
+#endif /* HOST_DEVICES_TIMER_H */
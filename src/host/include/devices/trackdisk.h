@@ -0,0 +1,88 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: trackdisk.device commands and TD64 offsets.
+**
+*/
+
+#ifndef HOST_DEVICES_TRACKDISK_H
+#define HOST_DEVICES_TRACKDISK_H
+
+#include <exec/io.h>
+
+/* TD64 commands: io_Actual is the offset high part */
+#define io_LowOffset    io_Offset
+#define io_HighOffset   io_Actual
+
+#define TD_MOTOR        (CMD_NONSTD+0)
+#define TD_SEEK         (CMD_NONSTD+1)
+#define TD_FORMAT       (CMD_NONSTD+2)
+#define TD_REMOVE       (CMD_NONSTD+3)
+#define TD_CHANGENUM    (CMD_NONSTD+4)
+#define TD_CHANGESTATE  (CMD_NONSTD+5)
+#define TD_PROTSTATUS   (CMD_NONSTD+6)
+#define TD_RAWREAD      (CMD_NONSTD+7)
+#define TD_RAWWRITE     (CMD_NONSTD+8)
+#define TD_GETDRIVETYPE (CMD_NONSTD+9)
+#define TD_GETNUMTRACKS (CMD_NONSTD+10)
+#define TD_ADDCHANGEINT (CMD_NONSTD+11)
+#define TD_REMCHANGEINT (CMD_NONSTD+12)
+#define TD_GETGEOMETRY  (CMD_NONSTD+13)
+#define TD_EJECT        (CMD_NONSTD+14)
+#define TD_LASTCOMM     (CMD_NONSTD+15)
+
+#define TD_READ64       24
+#define TD_WRITE64      25
+#define TD_SEEK64       26
+#define TD_FORMAT64     27
+
+struct DriveGeometry
+{
+    ULONG   dg_SectorSize;
+    ULONG   dg_TotalSectors;
+    ULONG   dg_Cylinders;
+    ULONG   dg_CylSectors;
+    ULONG   dg_Heads;
+    ULONG   dg_TrackSectors;
+    ULONG   dg_BufMemType;
+    UBYTE   dg_DeviceType;
+    UBYTE   dg_Flags;
+    UWORD   dg_Reserved;
+};
+
+#define DG_DIRECT_ACCESS    0
+#define DG_CDROM            5
+#define DG_UNKNOWN          31
+
+#define DGB_REMOVABLE       0
+#define DGF_REMOVABLE       (1<<DGB_REMOVABLE)
+
+#define TDERR_NotSpecified  20
+#define TDERR_WriteProt     28
+#define TDERR_DiskChanged   29
+#define TDERR_SeekError     30
+#define TDERR_NoMem         31
+#define TDERR_BadUnitNum    32
+#define TDERR_BadDriveType  33
+#define TDERR_DriveInUse    34
+#define TDERR_PostReset     35
+
+#endif /* HOST_DEVICES_TRACKDISK_H */
@@ -0,0 +1,58 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: dos.library definitions.
+**
+*/
+
+#ifndef HOST_DOS_DOS_H
+#define HOST_DOS_DOS_H
+
+#include <exec/types.h>
+
+#define DOSTRUE             (-1L)
+#define DOSFALSE            (0L)
+
+#define TICKS_PER_SECOND    50
+
+struct DateStamp
+{
+    LONG    ds_Days;
+    LONG    ds_Minute;
+    LONG    ds_Tick;
+};
+
+#define RETURN_OK           0
+#define RETURN_WARN         5
+#define RETURN_ERROR        10
+#define RETURN_FAIL         20
+
+#define SIGBREAKB_CTRL_C    12
+#define SIGBREAKB_CTRL_D    13
+#define SIGBREAKB_CTRL_E    14
+#define SIGBREAKB_CTRL_F    15
+
+#define SIGBREAKF_CTRL_C    (1L<<SIGBREAKB_CTRL_C)
+#define SIGBREAKF_CTRL_D    (1L<<SIGBREAKB_CTRL_D)
+#define SIGBREAKF_CTRL_E    (1L<<SIGBREAKB_CTRL_E)
+#define SIGBREAKF_CTRL_F    (1L<<SIGBREAKB_CTRL_F)
+
+#endif /* HOST_DOS_DOS_H */
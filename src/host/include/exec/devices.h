@@ -0,0 +1,48 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec devices.
+**
+*/
+
+#ifndef HOST_EXEC_DEVICES_H
+#define HOST_EXEC_DEVICES_H
+
+#include <exec/libraries.h>
+#include <exec/ports.h>
+
+struct Device
+{
+    struct Library  dd_Library;
+};
+
+struct Unit
+{
+    struct MsgPort  unit_MsgPort;
+    UBYTE           unit_flags;
+    UBYTE           unit_pad;
+    UWORD           unit_OpenCnt;
+};
+
+#define UNITF_ACTIVE    (1<<0)
+#define UNITF_INTASK    (1<<1)
+
+#endif /* HOST_EXEC_DEVICES_H */
@@ -0,0 +1,37 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec I/O errors.
+**
+*/
+
+#ifndef HOST_EXEC_ERRORS_H
+#define HOST_EXEC_ERRORS_H
+
+#define IOERR_OPENFAIL      (-1)
+#define IOERR_ABORTED       (-2)
+#define IOERR_NOCMD         (-3)
+#define IOERR_BADLENGTH     (-4)
+#define IOERR_BADADDRESS    (-5)
+#define IOERR_UNITBUSY      (-6)
+#define IOERR_SELFTEST      (-7)
+
+#endif /* HOST_EXEC_ERRORS_H */
@@ -0,0 +1,70 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec I/O requests.
+**
+*/
+
+#ifndef HOST_EXEC_IO_H
+#define HOST_EXEC_IO_H
+
+#include <exec/ports.h>
+#include <exec/devices.h>
+
+struct IORequest
+{
+    struct Message  io_Message;
+    struct Device * io_Device;
+    struct Unit *   io_Unit;
+    UWORD           io_Command;
+    UBYTE           io_Flags;
+    BYTE            io_Error;
+};
+
+struct IOStdReq
+{
+    struct Message  io_Message;
+    struct Device * io_Device;
+    struct Unit *   io_Unit;
+    UWORD           io_Command;
+    UBYTE           io_Flags;
+    BYTE            io_Error;
+    ULONG           io_Actual;
+    ULONG           io_Length;
+    APTR            io_Data;
+    ULONG           io_Offset;
+};
+
+#define IOB_QUICK   0
+#define IOF_QUICK   (1<<IOB_QUICK)
+
+#define CMD_INVALID 0
+#define CMD_RESET   1
+#define CMD_READ    2
+#define CMD_WRITE   3
+#define CMD_UPDATE  4
+#define CMD_CLEAR   5
+#define CMD_STOP    6
+#define CMD_START   7
+#define CMD_FLUSH   8
+#define CMD_NONSTD  9
+
+#endif /* HOST_EXEC_IO_H */
@@ -0,0 +1,50 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec libraries.
+**
+*/
+
+#ifndef HOST_EXEC_LIBRARIES_H
+#define HOST_EXEC_LIBRARIES_H
+
+#include <exec/nodes.h>
+
+struct Library
+{
+    struct Node     lib_Node;
+    UBYTE           lib_Flags;
+    UBYTE           lib_pad;
+    UWORD           lib_NegSize;
+    UWORD           lib_PosSize;
+    UWORD           lib_Version;
+    UWORD           lib_Revision;
+    APTR            lib_IdString;
+    ULONG           lib_Sum;
+    UWORD           lib_OpenCnt;
+};
+
+#define LIBF_SUMMING    (1<<0)
+#define LIBF_CHANGED    (1<<1)
+#define LIBF_SUMUSED    (1<<2)
+#define LIBF_DELEXP     (1<<3)
+
+#endif /* HOST_EXEC_LIBRARIES_H */
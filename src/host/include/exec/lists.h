@@ -0,0 +1,89 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec lists and the list macros used by Helios.
+**
+*/
+
+#ifndef HOST_EXEC_LISTS_H
+#define HOST_EXEC_LISTS_H
+
+#include <exec/nodes.h>
+
+struct List
+{
+    struct Node *   lh_Head;
+    struct Node *   lh_Tail;
+    struct Node *   lh_TailPred;
+    UBYTE           lh_Type;
+    UBYTE           l_pad;
+};
+
+struct MinList
+{
+    struct MinNode *mlh_Head;
+    struct MinNode *mlh_Tail;
+    struct MinNode *mlh_TailPred;
+};
+
+extern void AddHead(struct List *list, struct Node *node);
+extern void AddTail(struct List *list, struct Node *node);
+extern void Remove(struct Node *node);
+extern struct Node *RemHead(struct List *list);
+extern struct Node *RemTail(struct List *list);
+extern void Enqueue(struct List *list, struct Node *node);
+extern void Insert(struct List *list, struct Node *node, struct Node *pred);
+extern struct Node *FindName(struct List *list, CONST_STRPTR name);
+
+#define NEWLIST(l) ({ struct List *_l = (struct List *)(l); \
+    _l->lh_Head = (struct Node *)&_l->lh_Tail;              \
+    _l->lh_Tail = NULL;                                     \
+    _l->lh_TailPred = (struct Node *)&_l->lh_Head; })
+
+#define ADDHEAD(l, n)   AddHead((struct List *)(l), (struct Node *)(n))
+#define ADDTAIL(l, n)   AddTail((struct List *)(l), (struct Node *)(n))
+#define REMOVE(n)       Remove((struct Node *)(n))
+#define REMHEAD(l)      ((APTR)RemHead((struct List *)(l)))
+#define REMTAIL(l)      ((APTR)RemTail((struct List *)(l)))
+
+#define IsListEmpty(l)      (((struct List *)(l))->lh_TailPred == (struct Node *)(l))
+#define IsMinListEmpty(l)   IsListEmpty(l)
+
+#define GetHead(l)  ({ struct List *_l = (struct List *)(l); \
+    (APTR)(_l->lh_Head->ln_Succ ? _l->lh_Head : NULL); })
+#define GetTail(l)  ({ struct List *_l = (struct List *)(l); \
+    (APTR)(_l->lh_TailPred->ln_Pred ? _l->lh_TailPred : NULL); })
+#define GetSucc(n)  ({ struct Node *_n = (struct Node *)(n); \
+    (APTR)(_n->ln_Succ->ln_Succ ? _n->ln_Succ : NULL); })
+#define GetPred(n)  ({ struct Node *_n = (struct Node *)(n); \
+    (APTR)(_n->ln_Pred->ln_Pred ? _n->ln_Pred : NULL); })
+
+#define ForeachNode(l, n) \
+    for (n = (APTR)((struct List *)(l))->lh_Head; \
+         ((struct Node *)(n))->ln_Succ; \
+         n = (APTR)((struct Node *)(n))->ln_Succ)
+
+#define ForeachNodeSafe(l, n, s) \
+    for (n = (APTR)((struct List *)(l))->lh_Head; \
+         (s = (APTR)((struct Node *)(n))->ln_Succ); \
+         n = (APTR)(s))
+
+#endif /* HOST_EXEC_LISTS_H */
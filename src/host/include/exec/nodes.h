@@ -0,0 +1,64 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec nodes.
+**
+*/
+
+#ifndef HOST_EXEC_NODES_H
+#define HOST_EXEC_NODES_H
+
+#include <exec/types.h>
+
+struct Node
+{
+    struct Node *   ln_Succ;
+    struct Node *   ln_Pred;
+    UBYTE           ln_Type;
+    BYTE            ln_Pri;
+    char *          ln_Name;
+};
+
+struct MinNode
+{
+    struct MinNode *mln_Succ;
+    struct MinNode *mln_Pred;
+};
+
+#define NT_UNKNOWN      0
+#define NT_TASK         1
+#define NT_INTERRUPT    2
+#define NT_DEVICE       3
+#define NT_MSGPORT      4
+#define NT_MESSAGE      5
+#define NT_FREEMSG      6
+#define NT_REPLYMSG     7
+#define NT_RESOURCE     8
+#define NT_LIBRARY      9
+#define NT_MEMORY       10
+#define NT_SOFTINT      11
+#define NT_FONT         12
+#define NT_PROCESS      13
+#define NT_SEMAPHORE    14
+#define NT_USER         254
+#define NT_EXTENDED     255
+
+#endif /* HOST_EXEC_NODES_H */
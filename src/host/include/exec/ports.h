@@ -0,0 +1,53 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec message ports.
+**
+*/
+
+#ifndef HOST_EXEC_PORTS_H
+#define HOST_EXEC_PORTS_H
+
+#include <exec/lists.h>
+#include <exec/tasks.h>
+
+struct MsgPort
+{
+    struct Node     mp_Node;
+    UBYTE           mp_Flags;
+    UBYTE           mp_SigBit;
+    APTR            mp_SigTask;
+    struct List     mp_MsgList;
+};
+
+#define PF_ACTION   3
+#define PA_SIGNAL   0
+#define PA_SOFTINT  1
+#define PA_IGNORE   2
+
+struct Message
+{
+    struct Node     mn_Node;
+    struct MsgPort *mn_ReplyPort;
+    UWORD           mn_Length;
+};
+
+#endif /* HOST_EXEC_PORTS_H */
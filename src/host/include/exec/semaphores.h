@@ -0,0 +1,46 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec semaphores.
+**
+** Same rules than exec: exclusive locks nest, a task holding the exclusive
+** lock may also obtain it shared.
+**
+*/
+
+#ifndef HOST_EXEC_SEMAPHORES_H
+#define HOST_EXEC_SEMAPHORES_H
+
+#include <exec/nodes.h>
+#include <pthread.h>
+
+struct Task;
+
+struct SignalSemaphore
+{
+    struct Node     ss_Link;
+    WORD            ss_NestCount;
+    WORD            ss_QueueCount;
+    struct Task *   ss_Owner;
+    pthread_cond_t  ss_HostCond;
+};
+
+#endif /* HOST_EXEC_SEMAPHORES_H */
@@ -0,0 +1,84 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: exec tasks.
+**
+** A task is a host thread; tc_Host is the runtime private data.
+**
+*/
+
+#ifndef HOST_EXEC_TASKS_H
+#define HOST_EXEC_TASKS_H
+
+#include <exec/nodes.h>
+#include <utility/tagitem.h>
+
+struct Task
+{
+    struct Node     tc_Node;
+    UBYTE           tc_Flags;
+    UBYTE           tc_State;
+    BYTE            tc_IDNestCnt;
+    BYTE            tc_TDNestCnt;
+    ULONG           tc_SigAlloc;
+    ULONG           tc_SigWait;
+    ULONG           tc_SigRecvd;
+    ULONG           tc_SigExcept;
+    APTR            tc_UserData;
+    APTR            tc_Host;
+};
+
+#define SIGB_ABORT      0
+#define SIGB_CHILD      1
+#define SIGB_BLIT       4
+#define SIGB_SINGLE     4
+#define SIGB_INTUITION  5
+#define SIGB_NET        7
+#define SIGB_DOS        8
+
+#define SIGF_ABORT      (1L<<SIGB_ABORT)
+#define SIGF_CHILD      (1L<<SIGB_CHILD)
+#define SIGF_BLIT       (1L<<SIGB_BLIT)
+#define SIGF_SINGLE     (1L<<SIGB_SINGLE)
+#define SIGF_INTUITION  (1L<<SIGB_INTUITION)
+#define SIGF_NET        (1L<<SIGB_NET)
+#define SIGF_DOS        (1L<<SIGB_DOS)
+
+#define CODETYPE_PPC    2
+
+/* NewCreateTask() tags */
+#define TASKTAG_Dummy       (TAG_USER + 0x100000)
+#define TASKTAG_ERROR       (TASKTAG_Dummy + 0)
+#define TASKTAG_CODETYPE    (TASKTAG_Dummy + 1)
+#define TASKTAG_PC          (TASKTAG_Dummy + 2)
+#define TASKTAG_FINALPC     (TASKTAG_Dummy + 3)
+#define TASKTAG_STACKSIZE   (TASKTAG_Dummy + 4)
+#define TASKTAG_NAME        (TASKTAG_Dummy + 6)
+#define TASKTAG_USERDATA    (TASKTAG_Dummy + 7)
+#define TASKTAG_PRI         (TASKTAG_Dummy + 8)
+#define TASKTAG_POOLPUDDLE  (TASKTAG_Dummy + 9)
+#define TASKTAG_POOLTHRESH  (TASKTAG_Dummy + 10)
+#define TASKTAG_PPC_ARG1    (TASKTAG_Dummy + 16)
+#define TASKTAG_PPC_ARG2    (TASKTAG_Dummy + 17)
+#define TASKTAG_STARTUPMSG  (TASKTAG_Dummy + 24)
+#define TASKTAG_TASKMSGPORT (TASKTAG_Dummy + 25)
+
+#endif /* HOST_EXEC_TASKS_H */
@@ -0,0 +1,66 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: MorphOS exec base types.
+**
+** As on the PPC target, LONG and ULONG are 32-bit wide and IPTR holds
+** a pointer: the host runtime keeps all exec allocations, task stacks and
+** the program image below 4GB (see hostexec.c).
+**
+*/
+
+#ifndef HOST_EXEC_TYPES_H
+#define HOST_EXEC_TYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t            ULONG;
+typedef int32_t             LONG;
+typedef uint16_t            UWORD;
+typedef int16_t             WORD;
+typedef uint8_t             UBYTE;
+typedef int8_t              BYTE;
+typedef uint64_t            UQUAD;
+typedef int64_t             QUAD;
+typedef int16_t             BOOL;
+typedef float               FLOAT;
+typedef double              DOUBLE;
+typedef void *              APTR;
+typedef const void *        CONST_APTR;
+typedef char *              STRPTR;
+typedef const char *        CONST_STRPTR;
+typedef unsigned char       TEXT;
+typedef ULONG               IPTR;
+typedef LONG                SIPTR;
+typedef LONG                BPTR;
+
+#define VOID                void
+#define CONST               const
+
+#ifndef TRUE
+#define TRUE                1
+#endif
+#ifndef FALSE
+#define FALSE               0
+#endif
+
+#endif /* HOST_EXEC_TYPES_H */
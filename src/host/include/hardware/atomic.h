@@ -0,0 +1,65 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: atomic operations.
+**
+** Also gives the compare-exchange and barrier primitives defined with
+** PPC assembly in utils.h.
+**
+*/
+
+#ifndef HOST_HARDWARE_ATOMIC_H
+#define HOST_HARDWARE_ATOMIC_H
+
+#include <exec/types.h>
+
+#define ATOMIC_ADD(p, v)    ((void)__sync_fetch_and_add((p), (v)))
+#define ATOMIC_SUB(p, v)    ((void)__sync_fetch_and_sub((p), (v)))
+#define ATOMIC_OR(p, v)     ((void)__sync_fetch_and_or((p), (v)))
+#define ATOMIC_AND(p, v)    ((void)__sync_fetch_and_and((p), (v)))
+#define ATOMIC_FETCH(p)     __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(p, v)  __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+
+/* Store new at *ptr if it contains old, returns the previous *ptr value */
+#define ATOMIC_CMPXCHG(p, o, n) __sync_val_compare_and_swap((p), (o), (n))
+
+/* Store new at *ptr if it doesn't contain old, returns the previous *ptr value */
+static inline LONG _ATOMIC_NCMPXCHG(volatile LONG *ptr, LONG old, LONG new)
+{
+    LONG cur;
+
+    do
+    {
+        cur = *ptr;
+        if (cur == old)
+        {
+            break;
+        }
+    }
+    while (!__sync_bool_compare_and_swap(ptr, cur, new));
+
+    return cur;
+}
+#define ATOMIC_NCMPXCHG(p, o, n) _ATOMIC_NCMPXCHG(p, o, n)
+
+#define MEMORY_BARRIER()    __sync_synchronize()
+
+#endif /* HOST_HARDWARE_ATOMIC_H */
@@ -0,0 +1,58 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: byte swapping.
+**
+** Keeps the PPC meaning: BE_SWAP* converts PCI little-endian data on a
+** big-endian CPU and swaps, LE_SWAP* is the identity. The driver and the
+** controller model both use these macros, so the DMA programs and the bus
+** data keep the target layout (1394 quadlets are host values).
+**
+*/
+
+#ifndef HOST_HARDWARE_BYTESWAP_H
+#define HOST_HARDWARE_BYTESWAP_H
+
+#include <exec/types.h>
+
+#define SWAPWORD(x)     ((UWORD)__builtin_bswap16((UWORD)(x)))
+#define SWAPLONG(x)     ((ULONG)__builtin_bswap32((ULONG)(x)))
+#define SWAPQUAD(x)     ((UQUAD)__builtin_bswap64((UQUAD)(x)))
+
+#define BE_SWAPWORD(x)  SWAPWORD(x)
+#define BE_SWAPLONG(x)  SWAPLONG(x)
+#define BE_SWAPQUAD(x)  SWAPQUAD(x)
+#define LE_SWAPWORD(x)  ((UWORD)(x))
+#define LE_SWAPLONG(x)  ((ULONG)(x))
+#define LE_SWAPQUAD(x)  ((UQUAD)(x))
+
+#define BE_SWAPWORD_C(x)    BE_SWAPWORD(x)
+#define BE_SWAPLONG_C(x)    BE_SWAPLONG(x)
+#define LE_SWAPWORD_C(x)    LE_SWAPWORD(x)
+#define LE_SWAPLONG_C(x)    LE_SWAPLONG(x)
+
+/* In place */
+#define BE_SWAPWORD_P(p)    ({ UWORD *_p = (UWORD *)(p); *_p = BE_SWAPWORD(*_p); })
+#define BE_SWAPLONG_P(p)    ({ ULONG *_p = (ULONG *)(p); *_p = BE_SWAPLONG(*_p); })
+#define LE_SWAPWORD_P(p)    ((void)(p))
+#define LE_SWAPLONG_P(p)    ((void)(p))
+
+#endif /* HOST_HARDWARE_BYTESWAP_H */
@@ -0,0 +1,39 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: timer.device functions.
+**
+** As the target inlines, calls need a TimerBase in scope.
+**
+*/
+
+#ifndef HOST_PROTO_TIMER_H
+#define HOST_PROTO_TIMER_H
+
+#include <clib/timer_protos.h>
+
+#define GetSysTime(dest)    ((void)(TimerBase), GetSysTime(dest))
+#define AddTime(dest, src)  ((void)(TimerBase), AddTime(dest, src))
+#define SubTime(dest, src)  ((void)(TimerBase), SubTime(dest, src))
+#define CmpTime(a, b)       ((void)(TimerBase), CmpTime(a, b))
+#define ReadEClock(dest)    ((void)(TimerBase), ReadEClock(dest))
+
+#endif /* HOST_PROTO_TIMER_H */
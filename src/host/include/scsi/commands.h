@@ -0,0 +1,44 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: SCSI operation codes.
+**
+*/
+
+#ifndef HOST_SCSI_COMMANDS_H
+#define HOST_SCSI_COMMANDS_H
+
+#define SCSI_TEST_UNIT_READY        0x00
+#define SCSI_INQUIRY                0x12
+#define SCSI_MODE_SELECT_6          0x15
+#define SCSI_MODE_SENSE_6           0x1a
+#define SCSI_DA_START_STOP_UNIT     0x1b
+#define SCSI_DA_READ_CAPACITY       0x25
+#define SCSI_DA_READ_10             0x28
+#define SCSI_DA_WRITE_10            0x2a
+#define SCSI_CD_SYNCHRONIZE_CACHE   0x35
+#define SCSI_MODE_SELECT_10         0x55
+#define SCSI_MODE_SENSE_10          0x5a
+#define SCSI_CD_CLOSE_TRACK         0x5b
+#define SCSI_CD_BLANK               0xa1
+#define SCSI_CD_LOAD_UNLOAD_MEDIUM  0xa6
+
+#endif /* HOST_SCSI_COMMANDS_H */
@@ -0,0 +1,41 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: utility hooks.
+**
+*/
+
+#ifndef HOST_UTILITY_HOOKS_H
+#define HOST_UTILITY_HOOKS_H
+
+#include <exec/nodes.h>
+
+typedef ULONG (*HOOKFUNC)();
+
+struct Hook
+{
+    struct MinNode  h_MinNode;
+    HOOKFUNC        h_Entry;
+    HOOKFUNC        h_SubEntry;
+    APTR            h_Data;
+};
+
+#endif /* HOST_UTILITY_HOOKS_H */
@@ -0,0 +1,46 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host build: utility tag items.
+**
+*/
+
+#ifndef HOST_UTILITY_TAGITEM_H
+#define HOST_UTILITY_TAGITEM_H
+
+#include <exec/types.h>
+
+typedef ULONG Tag;
+
+struct TagItem
+{
+    Tag     ti_Tag;
+    IPTR    ti_Data;
+};
+
+#define TAG_DONE    0
+#define TAG_END     0
+#define TAG_IGNORE  1
+#define TAG_MORE    2
+#define TAG_SKIP    3
+#define TAG_USER    ((ULONG)(1UL<<31))
+
+#endif /* HOST_UTILITY_TAGITEM_H */
@@ -0,0 +1,108 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host test: unit bring-up, self-ID topology, async block write/read to
+** a simulated peer and a bus reset requested by the client.
+**
+*/
+
+#include "hosttest.h"
+
+#include <proto/exec.h>
+
+#include <string.h>
+
+#define TEST_PEERS      2
+#define TEST_OFFSET     0x100
+#define TEST_LENGTH     512
+
+static int test_Main(int argc, char **argv)
+{
+    HostTestUnit tu;
+    HeliosTopology *topo;
+    OHCI1394SimStats stats;
+    IOHeliosHWReq ioreq;
+    UBYTE *out, *in, *mem;
+    ULONG i, gen;
+    UWORD peer;
+
+    if (!CHECK(HERR_NOERR == hosttest_OpenUnit(&tu, TEST_PEERS)))
+    {
+        return hosttest_Result("bus");
+    }
+
+    /* Self-ID: the local node and its peers */
+    topo = hosttest_WaitTopology(&tu, 0, 2000);
+    if (!CHECK(NULL != topo))
+    {
+        hosttest_CloseUnit(&tu);
+        return hosttest_Result("bus");
+    }
+
+    CHECK_EQ(topo->ht_NodeCount, TEST_PEERS + 1);
+    CHECK(topo->ht_LocalNodeID < topo->ht_NodeCount);
+    gen = topo->ht_Generation;
+    peer = 0xffc0 | (0 == topo->ht_LocalNodeID ? 1 : 0);
+
+    /* Write a block to the peer memory, then read it back */
+    out = AllocVec(TEST_LENGTH, MEMF_PUBLIC);
+    in = AllocVec(TEST_LENGTH, MEMF_PUBLIC | MEMF_CLEAR);
+    for (i=0; i < TEST_LENGTH; i++)
+    {
+        out[i] = i * 7 + 3;
+    }
+
+    CHECK_EQ(hosttest_Write(&tu, peer, TEST_OFFSET, out, TEST_LENGTH), HHIOERR_NO_ERROR);
+    mem = ohcisim_GetPeerMemory(tu.htu_Sim, peer & 0x3f);
+    if (CHECK(NULL != mem))
+    {
+        CHECK(!memcmp(mem + TEST_OFFSET, out, TEST_LENGTH));
+    }
+
+    CHECK_EQ(hosttest_Read(&tu, peer, TEST_OFFSET, in, TEST_LENGTH), HHIOERR_NO_ERROR);
+    CHECK(!memcmp(in, out, TEST_LENGTH));
+
+    FreeVec(in);
+    FreeVec(out);
+
+    /* A client bus reset gives a new topology */
+    hosttest_InitIO(&tu, &ioreq, HHIOCMD_BUSRESET, sizeof(ioreq));
+    CHECK_EQ(hosttest_DoIO(&tu, &ioreq), HHIOERR_NO_ERROR);
+
+    topo = hosttest_WaitTopology(&tu, gen, 2000);
+    if (CHECK(NULL != topo))
+    {
+        CHECK_EQ(topo->ht_NodeCount, TEST_PEERS + 1);
+    }
+
+    ohcisim_GetStats(tu.htu_Sim, &stats);
+    CHECK(stats.ss_BusResets >= 2);
+    CHECK(stats.ss_ATPackets[0] >= 2);
+
+    hosttest_CloseUnit(&tu);
+
+    return hosttest_Result("bus");
+}
+
+int main(int argc, char **argv)
+{
+    return host_RunMain(test_Main, argc, argv);
+}
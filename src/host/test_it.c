@@ -0,0 +1,300 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host test: Iso Transmit context. Packets (iso header, CIP header and
+** payload) received by the simulated bus, cycle match start, skipped
+** cycles, then an underrun and its recovery.
+**
+** The bus clock is stepped by the test, one cycle at a time, waiting for
+** the IT handler to refill the completed buffers between cycles.
+**
+*/
+
+#include "hosttest.h"
+
+#include "proto/helios.h"
+
+#include <hardware/byteswap.h>
+#include <clib/macros.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#define TEST_CHANNEL        5
+#define TEST_TAG            1
+#define TEST_BUFFERS        4
+#define TEST_PAYLOAD_SIZE   64
+#define TEST_MATCH_DELAY    50
+#define TEST_CIP1           0x9002ffff
+#define TEST_MAX_PACKETS    256
+
+#define IT_SKIPPED(seq)     (3 == ((seq) % 5))
+#define IT_LENGTH(seq)      (16 + ((seq) % 3) * 4)
+
+typedef struct ITPacket
+{
+    UBYTE   itp_Channel;
+    UBYTE   itp_Tag;
+    UBYTE   itp_Sy;
+    ULONG   itp_Length;
+    QUADLET itp_CIP[2];
+    ULONG   itp_Seq;
+} ITPacket;
+
+static volatile ULONG it_Seq;           /* Next packet given to the context */
+static volatile ULONG it_Completed;     /* Packets reported as sent by the callback */
+static volatile ULONG it_FirstTimeStamp;
+static volatile ULONG it_Underruns;
+static ITPacket it_Packets[TEST_MAX_PACKETS];
+static ULONG it_PacketCount;
+
+/* Called at start to prefill all buffers, then by the IT handler each time one is sent */
+static void it_Callback(HeliosITBuffer *itbuf, ULONG status, APTR udata)
+{
+    ULONG seq = it_Seq++;
+
+    if (OHCI1394_EVENT_NO_STATUS != status)
+    {
+        if (0 == it_Completed++)
+        {
+            it_FirstTimeStamp = itbuf->TimeStamp;
+        }
+
+        it_Underruns = itbuf->Underruns;
+    }
+
+    if (IT_SKIPPED(seq))
+    {
+        itbuf->Flags |= HELIOS_ITBF_SKIP;
+        return;
+    }
+
+    memset(itbuf->Payload, 0, itbuf->PayloadSize);
+    *(ULONG *)itbuf->Payload = seq;
+    itbuf->PayloadLength = IT_LENGTH(seq);
+    itbuf->CIP[0] = 0x01020000 | seq;
+    itbuf->CIP[1] = TEST_CIP1;
+    itbuf->Sy = seq & 0xf;
+}
+
+/* Called by the model for each packet put on the bus */
+static void it_Sink(OHCI1394Sim *sim, UBYTE channel, UBYTE tag, UBYTE sy,
+                    const UBYTE *payload, ULONG length, APTR udata)
+{
+    ITPacket *pkt;
+    QUADLET q[3];
+
+    if (it_PacketCount >= TEST_MAX_PACKETS)
+    {
+        return;
+    }
+
+    pkt = &it_Packets[it_PacketCount++];
+    pkt->itp_Channel = channel;
+    pkt->itp_Tag = tag;
+    pkt->itp_Sy = sy;
+    pkt->itp_Length = length;
+
+    memset(q, 0, sizeof(q));
+    memcpy(q, payload, MIN(length, sizeof(q)));
+    pkt->itp_CIP[0] = LE_SWAPLONG(q[0]);
+    pkt->itp_CIP[1] = LE_SWAPLONG(q[1]);
+    pkt->itp_Seq = q[2];
+}
+
+static ULONG it_Sent(HostTestUnit *tu)
+{
+    OHCI1394SimStats stats;
+
+    ohcisim_GetStats(tu->htu_Sim, &stats);
+    return stats.ss_ITPackets + stats.ss_ITSkips;
+}
+
+/* Wait for the IT handler to report the given count of sent packets */
+static BOOL it_WaitCompleted(ULONG count)
+{
+    ULONG timeout = 1000;
+
+    while (it_Completed < count)
+    {
+        if (0 == timeout--)
+        {
+            return FALSE;
+        }
+
+        Helios_DelayMS(1);
+    }
+
+    return TRUE;
+}
+
+/* Step the bus one cycle at a time */
+static BOOL it_Run(HostTestUnit *tu, ULONG cycles)
+{
+    while (cycles--)
+    {
+        ohcisim_Step(tu->htu_Sim, 1);
+        if (!CHECK(it_WaitCompleted(it_Sent(tu))))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static void it_CheckPackets(void)
+{
+    ULONG i, seq = 0;
+
+    for (i=0; i < it_PacketCount; i++, seq++)
+    {
+        ITPacket *pkt = &it_Packets[i];
+
+        while (IT_SKIPPED(seq))
+        {
+            seq++;
+        }
+
+        if (!CHECK_EQ(pkt->itp_Seq, seq) ||
+            !CHECK_EQ(pkt->itp_Channel, TEST_CHANNEL) ||
+            !CHECK_EQ(pkt->itp_Tag, TEST_TAG) ||
+            !CHECK_EQ(pkt->itp_Sy, seq & 0xf) ||
+            !CHECK_EQ(pkt->itp_Length, 8 + IT_LENGTH(seq)) ||
+            !CHECK_EQ(pkt->itp_CIP[0], 0x01020000 | seq) ||
+            !CHECK_EQ(pkt->itp_CIP[1], TEST_CIP1))
+        {
+            break;
+        }
+    }
+}
+
+static int test_Main(int argc, char **argv)
+{
+    HostTestUnit tu;
+    OHCI1394SimStats stats;
+    OHCI1394ITCtx *ctx;
+    OHCI1394ITCtxFlags flags = { .CIP = 1 };
+    ULONG ts, seconds, cycle, match, sent, skips, i;
+
+    if (!CHECK(HERR_NOERR == hosttest_OpenUnit(&tu, 1)))
+    {
+        return hosttest_Result("it");
+    }
+
+    if (!CHECK(NULL != hosttest_WaitTopology(&tu, 0, 2000)))
+    {
+        hosttest_CloseUnit(&tu);
+        return hosttest_Result("it");
+    }
+
+    /* The bus clock only advances on ohcisim_Step(sim, n) from now */
+    ohcisim_SetAutoStep(tu.htu_Sim, FALSE);
+    ohcisim_SetIsoSink(tu.htu_Sim, it_Sink, NULL);
+    ohcisim_ResetStats(tu.htu_Sim);
+
+    ctx = ohci_ITContext_Create(tu.htu_Unit, -1, TEST_PAYLOAD_SIZE, TEST_BUFFERS,
+                                it_Callback, NULL, flags);
+    if (!CHECK(NULL != ctx))
+    {
+        ohcisim_SetAutoStep(tu.htu_Sim, TRUE);
+        hosttest_CloseUnit(&tu);
+        return hosttest_Result("it");
+    }
+
+    /* Cycle match (seconds modulo 4, cycle) some cycles ahead */
+    ts = ohci_GetTimeStamp(tu.htu_Unit);
+    seconds = (ts >> 13) & 3;
+    cycle = (ts & 0x1fff) + TEST_MATCH_DELAY;
+    if (cycle >= 8000)
+    {
+        cycle -= 8000;
+        seconds = (seconds + 1) & 3;
+    }
+    match = (seconds << 13) | cycle;
+
+    CHECK(ohci_ITContext_Start(ctx, TEST_CHANNEL, TEST_TAG, S400, match));
+    CHECK_EQ(it_Seq, TEST_BUFFERS);
+
+    /* Nothing sent before the match cycle */
+    for (i=1; i < TEST_MATCH_DELAY; i++)
+    {
+        ohcisim_Step(tu.htu_Sim, 1);
+    }
+    CHECK_EQ(it_Sent(&tu), 0);
+
+    if (it_Run(&tu, 1))
+    {
+        CHECK_EQ(it_FirstTimeStamp & 0x7fff, match);
+    }
+
+    /* One packet per cycle, with skipped cycles */
+    it_Run(&tu, 40);
+
+    ohcisim_GetStats(tu.htu_Sim, &stats);
+    sent = stats.ss_ITPackets + stats.ss_ITSkips;
+    CHECK_EQ(sent, 41);
+    for (i=0, skips=0; i < sent; i++)
+    {
+        skips += IT_SKIPPED(i);
+    }
+    CHECK_EQ(stats.ss_ITSkips, skips);
+    CHECK_EQ(stats.ss_ITUnderruns, 0);
+    CHECK_EQ(it_PacketCount, stats.ss_ITPackets);
+    CHECK_EQ(it_Underruns, 0);
+
+    /* More cycles than buffers before the handler runs: the DMA stops on the
+     * end of the program, then resumes when the handler wakes it.
+     */
+    ohcisim_Step(tu.htu_Sim, TEST_BUFFERS * 2);
+    ohcisim_GetStats(tu.htu_Sim, &stats);
+    CHECK_EQ(stats.ss_ITUnderruns, 1);
+    CHECK(it_WaitCompleted(it_Sent(&tu) - 1));
+
+    it_Run(&tu, 20);
+
+    ohcisim_GetStats(tu.htu_Sim, &stats);
+    CHECK_EQ(stats.ss_ITUnderruns, 1);
+    CHECK(stats.ss_ITPackets + stats.ss_ITSkips > sent + TEST_BUFFERS);
+    CHECK_EQ(it_Underruns, 1);
+    CHECK_EQ(stats.ss_DeadContexts, 0);
+    CHECK_EQ(it_PacketCount, stats.ss_ITPackets);
+
+    /* No packet lost or reordered across the underrun */
+    it_CheckPackets();
+
+    CHECK(ohci_ITContext_Stop(ctx));
+    sent = it_Sent(&tu);
+    ohcisim_Step(tu.htu_Sim, 10);
+    CHECK_EQ(it_Sent(&tu), sent);
+
+    ohci_ITContext_Destroy(ctx);
+    ohcisim_SetIsoSink(tu.htu_Sim, NULL, NULL);
+    ohcisim_SetAutoStep(tu.htu_Sim, TRUE);
+    hosttest_CloseUnit(&tu);
+
+    return hosttest_Result("it");
+}
+
+int main(int argc, char **argv)
+{
+    return host_RunMain(test_Main, argc, argv);
+}
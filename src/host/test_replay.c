@@ -0,0 +1,253 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host test: capture replay (OHCI1394A_Replay).
+**
+** Async traffic to a simulated peer is recorded with HHA_Capture, then
+** replayed: all replayed requests shall be completed by their recorded
+** acks and responses. A replayed bus reset shall cancel the replayed
+** requests only, not a request of another user of the unit.
+**
+*/
+
+#include "hosttest.h"
+
+#include "proto/helios.h"
+
+#include <devices/helios/ohci1394.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#define TEST_PEERS          2
+#define TEST_OFFSET         0x200
+#define TEST_LENGTH         256
+#define TEST_BLOCKS         4
+#define TEST_MAX_RECORDS    256
+#define TEST_SPLIT_TIMEOUT  (4 << 15)   /* 4s, in SPLIT-TIMEOUT CSR format */
+#define TEST_RESPONSE_DELAY 100         /* cycles */
+
+static LONG test_SetAttrs(HostTestUnit *tu, struct TagItem *tags)
+{
+    IOHeliosHWReq ioreq;
+
+    hosttest_InitIO(tu, &ioreq, HHIOCMD_SETATTRIBUTES, sizeof(ioreq));
+    ioreq.iohh_Data = tags;
+    return hosttest_DoIO(tu, &ioreq);
+}
+
+static LONG test_SetCapture(HostTestUnit *tu, ULONG flags)
+{
+    struct TagItem tags[] =
+    {
+        {HHA_Capture, flags},
+        {TAG_DONE, 0}
+    };
+
+    return test_SetAttrs(tu, tags);
+}
+
+static LONG test_Replay(HostTestUnit *tu, OHCI1394Replay *rp, HeliosCapturePacket *records, ULONG count)
+{
+    struct TagItem tags[] =
+    {
+        {OHCI1394A_Replay, (IPTR)rp},
+        {TAG_DONE, 0}
+    };
+
+    memset(rp, 0, sizeof(*rp));
+    rp->rp_Packets = records;
+    rp->rp_Count = count;
+    return test_SetAttrs(tu, tags);
+}
+
+static ULONG test_SplitPending(HostTestUnit *tu)
+{
+    OHCI1394SplitStats stats;
+    struct TagItem tags[] =
+    {
+        {OHCI1394A_SplitStats, (IPTR)&stats},
+        {TAG_DONE, 0}
+    };
+    IOHeliosHWReq ioreq;
+
+    hosttest_InitIO(tu, &ioreq, HHIOCMD_QUERYDEVICE, sizeof(ioreq));
+    ioreq.iohh_Data = tags;
+    hosttest_DoIO(tu, &ioreq);
+
+    return stats.ss_Pending;
+}
+
+/* Record reads and writes to the peer, then replay them */
+static void test_RecordReplay(HostTestUnit *tu, UWORD peer, HeliosCapturePacket *records, ULONG *count)
+{
+    OHCI1394Replay rp;
+    IOHeliosHWReq ioreq;
+    UBYTE *buf;
+    ULONG i, requests;
+
+    buf = AllocVec(TEST_LENGTH, MEMF_PUBLIC | MEMF_CLEAR);
+    CHECK_EQ(test_SetCapture(tu, HCAPF_HEADERS | HCAPF_PAYLOAD), HHIOERR_NO_ERROR);
+
+    for (i=0; i < TEST_BLOCKS; i++)
+    {
+        memset(buf, i + 1, TEST_LENGTH);
+        CHECK_EQ(hosttest_Write(tu, peer, TEST_OFFSET + i * TEST_LENGTH, buf, TEST_LENGTH), HHIOERR_NO_ERROR);
+    }
+
+    for (i=0; i < TEST_BLOCKS; i++)
+    {
+        CHECK_EQ(hosttest_Read(tu, peer, TEST_OFFSET + i * TEST_LENGTH, buf, TEST_LENGTH), HHIOERR_NO_ERROR);
+        CHECK_EQ(buf[0], i + 1);
+    }
+
+    CHECK_EQ(test_SetCapture(tu, 0), HHIOERR_NO_ERROR);
+    FreeVec(buf);
+
+    hosttest_InitIO(tu, &ioreq, HHIOCMD_READCAPTURE, sizeof(ioreq));
+    ioreq.iohh_Data = records;
+    ioreq.iohh_Length = TEST_MAX_RECORDS * sizeof(HeliosCapturePacket);
+    CHECK_EQ(hosttest_DoIO(tu, &ioreq), HHIOERR_NO_ERROR);
+    *count = ioreq.iohh_Actual;
+
+    /* Send and completion of each request, and the responses to reads */
+    CHECK(*count >= TEST_BLOCKS * 5);
+    for (i=0, requests=0; i < *count; i++)
+    {
+        UBYTE tcode = AT_GET_HEADER_TCODE(records[i].cp_Header[0]);
+
+        requests += (HCAPTURE_AT_SEND == records[i].cp_Type)
+            && ((TCODE_WRITE_BLOCK_REQUEST == tcode) || (TCODE_READ_BLOCK_REQUEST == tcode));
+    }
+    CHECK_EQ(requests, TEST_BLOCKS * 2);
+
+    CHECK_EQ(test_Replay(tu, &rp, records, *count), HHIOERR_NO_ERROR);
+    CHECK_EQ(rp.rp_Transactions, requests);
+    CHECK_EQ(rp.rp_Completed, requests);
+    CHECK_EQ(rp.rp_Unmatched, 0);
+    CHECK_EQ(rp.rp_Errors, 0);
+    CHECK_EQ(rp.rp_BusResets, 0);
+}
+
+/* A replayed bus reset while a request of another user is pending */
+static void test_ReplayBusReset(HostTestUnit *tu, UWORD peer, HeliosCapturePacket *records, ULONG count)
+{
+    HeliosCapturePacket *replay;
+    IOHeliosHWSendRequest ioreq;
+    HeliosAPacket *p = &ioreq.iohhe_Transaction.htr_Packet;
+    OHCI1394Replay rp;
+    UBYTE *buf;
+    ULONG i, timeout;
+
+    /* The recorded sending of a read request, left pending by a bus reset */
+    replay = AllocVec(2 * sizeof(HeliosCapturePacket), MEMF_PUBLIC | MEMF_CLEAR);
+    for (i=0; i < count; i++)
+    {
+        if ((HCAPTURE_AT_SEND == records[i].cp_Type)
+            && (TCODE_READ_BLOCK_REQUEST == AT_GET_HEADER_TCODE(records[i].cp_Header[0])))
+        {
+            replay[0] = records[i];
+            break;
+        }
+    }
+    CHECK(i < count);
+
+    replay[1].cp_Time = replay[0].cp_Time;
+    replay[1].cp_Type = HCAPTURE_AR;
+    replay[1].cp_Event = OHCI1394_EVENT_BUS_RESET;
+    replay[1].cp_HeaderLength = 16;
+    replay[1].cp_Header[0] = AT_HEADER_TCODE(TCODE_WRITE_PHY);
+
+    /* Stop the bus clock: the response to this request is not sent until restarted */
+    tu->htu_Unit->hu_SplitTimeout = TEST_SPLIT_TIMEOUT;
+    ohcisim_SetResponseDelay(tu->htu_Sim, TEST_RESPONSE_DELAY);
+    ohcisim_SetAutoStep(tu->htu_Sim, FALSE);
+
+    buf = AllocVec(TEST_LENGTH, MEMF_PUBLIC | MEMF_CLEAR);
+    hosttest_InitIO(tu, &ioreq.iohhe_Req, HHIOCMD_SENDREQUEST, sizeof(ioreq));
+    Helios_FillReadBlockPacket(p, S400, TEST_OFFSET, TEST_LENGTH);
+    p->DestID = peer;
+    ioreq.iohhe_Req.iohh_Data = buf;
+    ioreq.iohhe_Req.iohh_Length = TEST_LENGTH;
+    hosttest_SendIO(tu, &ioreq.iohhe_Req);
+
+    for (timeout=1000; (0 == test_SplitPending(tu)) && (timeout > 0); timeout--)
+    {
+        Helios_DelayMS(1);
+    }
+    CHECK(timeout > 0);
+
+    CHECK_EQ(test_Replay(tu, &rp, replay, 2), HHIOERR_NO_ERROR);
+    CHECK_EQ(rp.rp_Transactions, 1);
+    CHECK_EQ(rp.rp_BusResets, 1);
+    CHECK_EQ(rp.rp_Unmatched, 0);
+    CHECK_EQ(rp.rp_Errors, 0);
+
+    /* Not cancelled by the replay, finished by the response */
+    CHECK(NULL == CheckIO(&ioreq.iohhe_Req.iohh_Req));
+    ohcisim_SetAutoStep(tu->htu_Sim, TRUE);
+
+    CHECK_EQ(WaitIO(&ioreq.iohhe_Req.iohh_Req), HHIOERR_NO_ERROR);
+    CHECK_EQ(p->RCode, HELIOS_RCODE_COMPLETE);
+    CHECK_EQ(ioreq.iohhe_Req.iohh_Actual, TEST_LENGTH);
+    CHECK_EQ(buf[0], 1);
+
+    ohcisim_SetResponseDelay(tu->htu_Sim, 0);
+    FreeVec(buf);
+    FreeVec(replay);
+}
+
+static int test_Main(int argc, char **argv)
+{
+    HostTestUnit tu;
+    HeliosTopology *topo;
+    HeliosCapturePacket *records;
+    ULONG count = 0;
+    UWORD peer;
+
+    if (!CHECK(HERR_NOERR == hosttest_OpenUnit(&tu, TEST_PEERS)))
+    {
+        return hosttest_Result("replay");
+    }
+
+    topo = hosttest_WaitTopology(&tu, 0, 2000);
+    if (!CHECK(NULL != topo))
+    {
+        hosttest_CloseUnit(&tu);
+        return hosttest_Result("replay");
+    }
+    peer = 0xffc0 | (0 == topo->ht_LocalNodeID ? 1 : 0);
+
+    records = AllocVec(TEST_MAX_RECORDS * sizeof(HeliosCapturePacket), MEMF_PUBLIC | MEMF_CLEAR);
+
+    test_RecordReplay(&tu, peer, records, &count);
+    test_ReplayBusReset(&tu, peer, records, count);
+
+    FreeVec(records);
+    hosttest_CloseUnit(&tu);
+
+    return hosttest_Result("replay");
+}
+
+int main(int argc, char **argv)
+{
+    return host_RunMain(test_Main, argc, argv);
+}
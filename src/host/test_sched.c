@@ -0,0 +1,278 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host test: SBP2 class IO scheduler (sbp2.sched.c).
+**
+** Groups returned by sbp2_sched_next() for ioreqs given in a known order:
+** merging of adjacent reads or writes, barriers, the overlap rule of a
+** read/write passing older ones, and the deadline of a waiting read.
+** sbp2_iocmd_queueable() is replaced by the aligned read/write check.
+**
+*/
+
+#include "hostcheck.h"
+
+#include "sbp2.class.h"
+#include "sbp2.iocmd.h"
+#include "sbp2.sched.h"
+
+#include <devices/trackdisk.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#define TEST_BLOCK      512
+#define TEST_MAX_IOREQS 64
+
+static SBP2ClassLib test_Base;
+static struct IOStdReq test_IOReqs[TEST_MAX_IOREQS];
+static ULONG test_IOReqCount;
+
+/* Only block aligned reads and writes may be merged */
+BOOL sbp2_iocmd_queueable(SBP2Unit *unit, struct IOStdReq *ioreq)
+{
+    switch (ioreq->io_Command)
+    {
+        case CMD_READ:
+        case TD_READ64:
+        case CMD_WRITE:
+        case TD_WRITE64:
+            return (0 != ioreq->io_Length) &&
+                !(ioreq->io_Length & (unit->u_BlockSize-1)) &&
+                !(IOREQ_OFFSET64(ioreq) & (unit->u_BlockSize-1));
+    }
+
+    return FALSE;
+}
+
+static SBP2Unit *test_NewUnit(CONST_STRPTR policy)
+{
+    SBP2Unit *unit;
+
+    unit = AllocVec(sizeof(*unit), MEMF_PUBLIC | MEMF_CLEAR);
+    unit->u_SBP2ClassBase = &test_Base;
+    unit->u_BlockSize = TEST_BLOCK;
+    unit->u_BlockShift = 9;
+    unit->u_MaxTransfer = 1ul << 20;
+    unit->u_QueueDepth = SBP2_QUEUE_DEPTH;
+    sbp2_sched_init(unit, policy);
+
+    test_IOReqCount = 0;
+    return unit;
+}
+
+/* Queue a TD64 command in the scheduler, returns its ioreq */
+static struct IOStdReq *test_Add(SBP2Unit *unit, UWORD cmd, UQUAD offset, ULONG length)
+{
+    struct IOStdReq *ioreq = &test_IOReqs[test_IOReqCount++];
+
+    memset(ioreq, 0, sizeof(*ioreq));
+    ioreq->io_Command = cmd;
+    ioreq->io_HighOffset = offset >> 32;
+    ioreq->io_LowOffset = offset;
+    ioreq->io_Length = length;
+
+    sbp2_sched_add(unit, ioreq);
+    return ioreq;
+}
+
+/* Check the next group is the given ioreqs, in this order */
+static BOOL test_Next(SBP2Unit *unit, ULONG count, ...)
+{
+    struct IOStdReq *ioreqs[SBP2_SCHED_MERGE];
+    va_list args;
+    ULONG n, i;
+    BOOL ok;
+
+    n = sbp2_sched_next(unit, ioreqs);
+    ok = CHECK_EQ(n, count);
+
+    va_start(args, count);
+    for (i=0; ok && (i < n); i++)
+    {
+        ok = CHECK(va_arg(args, struct IOStdReq *) == ioreqs[i]);
+    }
+    va_end(args);
+
+    return ok;
+}
+
+/* Adjacent ioreqs come out as one group in offset order */
+static void test_Merge(void)
+{
+    SBP2Unit *unit = test_NewUnit("cscan");
+    struct IOStdReq *a, *b, *c, *d, *r;
+
+    c = test_Add(unit, TD_WRITE64, 0x2000, 0x1000);
+    a = test_Add(unit, TD_WRITE64, 0x0000, 0x1000);
+    b = test_Add(unit, TD_WRITE64, 0x1000, 0x1000);
+    r = test_Add(unit, TD_READ64, 0x3000, 0x1000);  /* Adjacent but a read */
+    d = test_Add(unit, TD_WRITE64, 0x5000, 0x1000); /* Not adjacent */
+
+    test_Next(unit, 3, a, b, c);
+    test_Next(unit, 1, r);
+    test_Next(unit, 1, d);
+    CHECK_EQ(sbp2_sched_next(unit, NULL), 0);
+
+    /* Up to SBP2_SCHED_MERGE ioreqs, and no more than u_MaxTransfer bytes */
+    {
+        struct IOStdReq *w[SBP2_SCHED_MERGE + 1];
+        ULONG i;
+
+        for (i=0; i <= SBP2_SCHED_MERGE; i++)
+        {
+            w[i] = test_Add(unit, TD_WRITE64, 0x100000 + i * 0x1000, 0x1000);
+        }
+
+        test_Next(unit, SBP2_SCHED_MERGE, w[0], w[1], w[2], w[3], w[4], w[5], w[6], w[7]);
+        test_Next(unit, 1, w[8]);
+
+        unit->u_MaxTransfer = 0x2000;
+        for (i=0; i < 3; i++)
+        {
+            w[i] = test_Add(unit, TD_WRITE64, 0x200000 + i * 0x1000, 0x1000);
+        }
+
+        test_Next(unit, 2, w[0], w[1]);
+        test_Next(unit, 1, w[2]);
+    }
+
+    /* An unaligned read/write is not merged */
+    unit->u_MaxTransfer = 1ul << 20;
+    a = test_Add(unit, TD_READ64, 0x300000, 0x1000);
+    b = test_Add(unit, TD_READ64, 0x301000, 0x100);
+    test_Next(unit, 1, a);
+    test_Next(unit, 1, b);
+
+    FreeVec(unit);
+}
+
+/* Nothing is picked after another command until it is dispatched,
+ * and it waits for all older ioreqs.
+ */
+static void test_Barrier(void)
+{
+    SBP2Unit *unit = test_NewUnit("cscan");
+    struct IOStdReq *a, *b, *c, *u;
+
+    b = test_Add(unit, TD_WRITE64, 0x8000, 0x1000);
+    a = test_Add(unit, TD_WRITE64, 0x0000, 0x1000);
+    u = test_Add(unit, CMD_UPDATE, 0, 0);
+    c = test_Add(unit, TD_WRITE64, 0x1000, 0x1000); /* Adjacent to a, after the barrier */
+
+    test_Next(unit, 1, a);
+    test_Next(unit, 1, b);
+    test_Next(unit, 1, u);
+    test_Next(unit, 1, c);
+
+    /* A barrier first is dispatched alone */
+    u = test_Add(unit, CMD_UPDATE, 0, 0);
+    a = test_Add(unit, TD_READ64, 0, 0x1000);
+    test_Next(unit, 1, u);
+    test_Next(unit, 1, a);
+
+    FreeVec(unit);
+}
+
+/* A read/write never passes an older overlapping one when one of them writes */
+static void test_Overlap(void)
+{
+    SBP2Unit *unit = test_NewUnit("cscan");
+    struct IOStdReq *a, *b, *c;
+
+    /* The read over the older write waits for it, the other read passes both */
+    a = test_Add(unit, TD_WRITE64, 0x10000, 0x1000);
+    b = test_Add(unit, TD_READ64, 0x10800, 0x1000);
+    c = test_Add(unit, TD_READ64, 0x2000, 0x1000);
+    test_Next(unit, 1, c);
+    test_Next(unit, 1, a);
+    test_Next(unit, 1, b);
+
+    /* Overlapping reads are free to pass */
+    unit->u_SchedHead = 0;
+    a = test_Add(unit, TD_READ64, 0x10000, 0x1000);
+    b = test_Add(unit, TD_READ64, 0xf000, 0x2000);
+    test_Next(unit, 1, b);
+    test_Next(unit, 1, a);
+
+    /* A write after an older read of its range is not merged before it */
+    unit->u_SchedHead = 0;
+    a = test_Add(unit, TD_READ64, 0x1000, 0x1000);
+    b = test_Add(unit, TD_WRITE64, 0x0000, 0x1000);
+    c = test_Add(unit, TD_WRITE64, 0x1000, 0x1000);
+    test_Next(unit, 1, b);
+    test_Next(unit, 1, a);
+    test_Next(unit, 1, c);
+
+    /* The write at the head can't pass the older read it overlaps */
+    unit->u_SchedHead = 0x800;
+    a = test_Add(unit, TD_READ64, 0x0000, 0x1000);
+    b = test_Add(unit, TD_WRITE64, 0x0800, 0x800);
+    test_Next(unit, 1, a);
+    test_Next(unit, 1, b);
+
+    FreeVec(unit);
+}
+
+/* A read waiting for SBP2_SCHED_READ_EXPIRE dispatches is served first */
+static void test_Deadline(void)
+{
+    SBP2Unit *unit = test_NewUnit("deadline");
+    struct IOStdReq *far, *near;
+    ULONG i;
+
+    far = test_Add(unit, TD_READ64, 0x1000000, 0x1000);
+    for (i=1; i < SBP2_SCHED_READ_EXPIRE; i++)
+    {
+        near = test_Add(unit, TD_READ64, i * 0x10000, 0x1000);
+        test_Next(unit, 1, near);
+    }
+
+    near = test_Add(unit, TD_READ64, i * 0x10000, 0x1000);
+    test_Next(unit, 1, far);
+    test_Next(unit, 1, near);
+
+    /* fifo: arrival order */
+    sbp2_sched_init(unit, "fifo");
+    far = test_Add(unit, TD_READ64, 0x1000000, 0x1000);
+    near = test_Add(unit, TD_READ64, 0, 0x1000);
+    test_Next(unit, 1, far);
+    test_Next(unit, 1, near);
+
+    FreeVec(unit);
+}
+
+static int test_Main(int argc, char **argv)
+{
+    test_Base.hc_SysBase = SysBase;
+
+    test_Merge();
+    test_Barrier();
+    test_Overlap();
+    test_Deadline();
+
+    return hosttest_Result("sched");
+}
+
+int main(int argc, char **argv)
+{
+    return host_RunMain(test_Main, argc, argv);
+}
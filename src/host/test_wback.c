@@ -0,0 +1,418 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Host test: SBP2 class write-back stage (sbp2.wback.c).
+**
+** Absorbed writes are coalesced in extents, then flushed sorted by offset
+** with adjacent extents in one WRITE_10. Reads over dirty data and
+** CMD_UPDATE flush first. Transient flush errors keep the data for a
+** retry, permanent ones drop them and fail the next write. Data lost by
+** the unit release are reported as a Helios error message.
+** sbp2_do_scsi_cmd() and sbp2_do_scsi_cmd_sg() are replaced by a disk in
+** memory which logs each WRITE_10.
+**
+*/
+
+#include "hostcheck.h"
+
+#include "sbp2.class.h"
+#include "sbp2.wback.h"
+
+#include <devices/trackdisk.h>
+#include <scsi/commands.h>
+#include <hardware/byteswap.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#define TEST_BLOCK      512
+#define TEST_DISK_SIZE  (1ul << 20)
+#define TEST_WB_SIZE    (64ul << 10)
+#define TEST_MAX_CMDS   16
+
+typedef struct TestCmd
+{
+    UQUAD   tc_Offset;
+    ULONG   tc_Length;
+    ULONG   tc_Segs;
+} TestCmd;
+
+static SBP2ClassLib test_Base;
+static struct MsgPort *test_Port;
+static UBYTE *test_Disk;
+static TestCmd test_Cmds[TEST_MAX_CMDS];
+static ULONG test_CmdCount;
+static ULONG test_FailCount;    /* Next commands failing with test_FailError */
+static LONG test_FailError;
+
+static LONG test_Write10(struct SCSICmd *scsicmd, const SBP2Segment *segs, ULONG nsegs)
+{
+    UBYTE *cdb = scsicmd->scsi_Command;
+    UQUAD offset = (UQUAD)LE_SWAPLONG(*(ULONG *)&cdb[2]) * TEST_BLOCK;
+    ULONG length = ((cdb[7] << 8) | cdb[8]) * TEST_BLOCK;
+    ULONG i, pos;
+
+    if (!CHECK_EQ(cdb[0], SCSI_DA_WRITE_10) ||
+        !CHECK_EQ(length, scsicmd->scsi_Length) ||
+        !CHECK((offset + length) <= TEST_DISK_SIZE))
+    {
+        return HFERR_BadStatus;
+    }
+
+    if (test_FailCount > 0)
+    {
+        test_FailCount--;
+        return test_FailError;
+    }
+
+    if (test_CmdCount < TEST_MAX_CMDS)
+    {
+        test_Cmds[test_CmdCount].tc_Offset = offset;
+        test_Cmds[test_CmdCount].tc_Length = length;
+        test_Cmds[test_CmdCount].tc_Segs = nsegs;
+    }
+    test_CmdCount++;
+
+    for (i=0, pos=0; i < nsegs; pos += segs[i++].sg_Length)
+    {
+        CopyMem(segs[i].sg_Data, test_Disk + offset + pos, segs[i].sg_Length);
+    }
+    CHECK_EQ(pos, length);
+
+    scsicmd->scsi_Actual = length;
+    scsicmd->scsi_Status = 0;
+    return 0;
+}
+
+LONG sbp2_do_scsi_cmd(SBP2Unit *unit, struct SCSICmd *scsicmd, ULONG timeout)
+{
+    SBP2Segment seg = {scsicmd->scsi_Data, scsicmd->scsi_Length};
+
+    return test_Write10(scsicmd, &seg, 1);
+}
+
+LONG sbp2_do_scsi_cmd_sg(SBP2Unit *unit, struct SCSICmd *scsicmd,
+                         const SBP2Segment *segs, ULONG nsegs, ULONG timeout)
+{
+    return test_Write10(scsicmd, segs, nsegs);
+}
+
+static SBP2Unit *test_NewUnit(void)
+{
+    SBP2Unit *unit;
+
+    unit = AllocVec(sizeof(*unit), MEMF_PUBLIC | MEMF_CLEAR);
+    unit->u_SBP2ClassBase = &test_Base;
+    unit->u_BlockSize = TEST_BLOCK;
+    unit->u_BlockShift = 9;
+    unit->u_MaxTransfer = 1ul << 16;
+    unit->u_Flags.Ready = 1;
+    CHECK(sbp2_wb_init(unit, TEST_WB_SIZE));
+
+    memset(test_Disk, 0, TEST_DISK_SIZE);
+    test_CmdCount = 0;
+    test_FailCount = 0;
+    return unit;
+}
+
+static void test_FreeUnit(SBP2Unit *unit)
+{
+    sbp2_wb_cleanup(unit);
+    FreeVec(unit);
+}
+
+/* Give one ioreq to sbp2_wb_dispatch(), returns its result.
+ * The ioreq reply is checked against the expected io_Error.
+ */
+static BOOL test_Dispatch(SBP2Unit *unit, UWORD cmd, UQUAD offset, ULONG length, UBYTE fill, LONG err)
+{
+    struct IOStdReq *ioreq;
+    BOOL res;
+
+    ioreq = AllocVec(sizeof(*ioreq) + length, MEMF_PUBLIC | MEMF_CLEAR);
+    ioreq->io_Message.mn_ReplyPort = test_Port;
+    ioreq->io_Message.mn_Length = sizeof(*ioreq);
+    ioreq->io_Command = cmd;
+    ioreq->io_HighOffset = offset >> 32;
+    ioreq->io_LowOffset = offset;
+    ioreq->io_Length = length;
+    ioreq->io_Data = &ioreq[1];
+    memset(ioreq->io_Data, fill, length);
+
+    res = sbp2_wb_dispatch(unit, &ioreq, 1);
+    if (res)
+    {
+        CHECK(&ioreq->io_Message == GetMsg(test_Port));
+        CHECK_EQ(ioreq->io_Error, err);
+        CHECK_EQ(ioreq->io_Actual, err ? 0 : length);
+    }
+    else
+    {
+        CHECK(NULL == GetMsg(test_Port));
+    }
+
+    FreeVec(ioreq);
+    return res;
+}
+
+static BOOL test_Absorb(SBP2Unit *unit, UQUAD offset, ULONG length, UBYTE fill)
+{
+    return CHECK(test_Dispatch(unit, TD_WRITE64, offset, length, fill, 0));
+}
+
+static BOOL test_CheckCmd(ULONG index, UQUAD offset, ULONG length, ULONG nsegs)
+{
+    TestCmd *tc = &test_Cmds[index];
+
+    return CHECK(index < test_CmdCount) &&
+        CHECK_EQ(tc->tc_Offset, offset) &&
+        CHECK_EQ(tc->tc_Length, length) &&
+        CHECK_EQ(tc->tc_Segs, nsegs);
+}
+
+static BOOL test_CheckDisk(UQUAD offset, ULONG length, UBYTE fill)
+{
+    ULONG i;
+
+    for (i=0; i < length; i++)
+    {
+        if (!CHECK_EQ(test_Disk[offset + i], fill))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Writes in extents, flushed sorted, adjacent extents in one command */
+static void test_Coalesce(void)
+{
+    SBP2Unit *unit = test_NewUnit();
+
+    /* A write following the last extent extends it, a rewrite goes in place */
+    test_Absorb(unit, 0x0000, 0x1000, 1);
+    test_Absorb(unit, 0x1000, 0x1000, 2);
+    CHECK_EQ(unit->u_WBCount, 1);
+    test_Absorb(unit, 0x4000, 0x1000, 3);
+    CHECK_EQ(unit->u_WBCount, 2);
+    test_Absorb(unit, 0x0800, 0x400, 4);
+    CHECK_EQ(unit->u_WBCount, 2);
+    CHECK_EQ(unit->u_WBUsed, 0x3000);
+    CHECK_EQ(test_CmdCount, 0);
+
+    /* Written before CMD_UPDATE is done */
+    CHECK(!test_Dispatch(unit, CMD_UPDATE, 0, 0, 0, 0));
+    CHECK_EQ(unit->u_WBCount, 0);
+    CHECK_EQ(unit->u_WBUsed, 0);
+    CHECK_EQ(test_CmdCount, 2);
+    test_CheckCmd(0, 0x0000, 0x2000, 1);
+    test_CheckCmd(1, 0x4000, 0x1000, 1);
+    test_CheckDisk(0x0000, 0x800, 1);
+    test_CheckDisk(0x0800, 0x400, 4);
+    test_CheckDisk(0x0c00, 0x400, 1);
+    test_CheckDisk(0x1000, 0x1000, 2);
+    test_CheckDisk(0x2000, 0x2000, 0);
+    test_CheckDisk(0x4000, 0x1000, 3);
+
+    /* Adjacent extents given out of order are segments of one command */
+    test_CmdCount = 0;
+    test_Absorb(unit, 0xa000, 0x1000, 5);
+    test_Absorb(unit, 0x8000, 0x1000, 6);
+    test_Absorb(unit, 0x9000, 0x1000, 7);
+    CHECK_EQ(unit->u_WBCount, 2);
+    CHECK_EQ(sbp2_wb_flush(unit), 0);
+    CHECK_EQ(test_CmdCount, 1);
+    test_CheckCmd(0, 0x8000, 0x3000, 2);
+    test_CheckDisk(0x8000, 0x1000, 6);
+    test_CheckDisk(0x9000, 0x1000, 7);
+    test_CheckDisk(0xa000, 0x1000, 5);
+
+    /* An extent longer than u_MaxTransfer is cut */
+    test_CmdCount = 0;
+    unit->u_MaxTransfer = 0x2000;
+    test_Absorb(unit, 0x10000, 0x1000, 8);
+    test_Absorb(unit, 0x11000, 0x1000, 8);
+    test_Absorb(unit, 0x12000, 0x1000, 8);
+    CHECK_EQ(unit->u_WBCount, 1);
+    CHECK_EQ(sbp2_wb_flush(unit), 0);
+    CHECK_EQ(test_CmdCount, 2);
+    test_CheckCmd(0, 0x10000, 0x2000, 1);
+    test_CheckCmd(1, 0x12000, 0x1000, 1);
+    test_CheckDisk(0x10000, 0x3000, 8);
+
+    /* A full buffer is flushed before absorbing more */
+    test_CmdCount = 0;
+    unit->u_MaxTransfer = 1ul << 16;
+    test_Absorb(unit, 0x20000, TEST_WB_SIZE / 2, 9);
+    test_Absorb(unit, 0x20000 + TEST_WB_SIZE / 2, TEST_WB_SIZE / 2, 9);
+    CHECK_EQ(test_CmdCount, 0);
+    test_Absorb(unit, 0x40000, 0x1000, 10);
+    CHECK_EQ(test_CmdCount, 1);
+    test_CheckCmd(0, 0x20000, TEST_WB_SIZE, 1);
+    CHECK_EQ(unit->u_WBCount, 1);
+    CHECK_EQ(unit->u_WBUsed, 0x1000);
+
+    test_FreeUnit(unit);
+}
+
+/* What is absorbed, and what is flushed before going on */
+static void test_Dispatching(void)
+{
+    SBP2Unit *unit = test_NewUnit();
+
+    test_Absorb(unit, 0x1000, 0x1000, 1);
+
+    /* A read elsewhere does not flush, one over dirty data does */
+    CHECK(!test_Dispatch(unit, TD_READ64, 0x3000, 0x1000, 0, 0));
+    CHECK_EQ(test_CmdCount, 0);
+    CHECK(!test_Dispatch(unit, TD_READ64, 0x1800, 0x1000, 0, 0));
+    CHECK_EQ(test_CmdCount, 1);
+    CHECK_EQ(unit->u_WBCount, 0);
+
+    /* A partial block write is not absorbed, and comes after the dirty data */
+    test_Absorb(unit, 0x1000, 0x1000, 2);
+    CHECK(!test_Dispatch(unit, TD_WRITE64, 0x1000, 100, 3, 0));
+    CHECK_EQ(test_CmdCount, 2);
+    CHECK_EQ(unit->u_WBCount, 0);
+
+    /* Nor a write to a unit not ready */
+    unit->u_Flags.Ready = 0;
+    CHECK(!test_Dispatch(unit, TD_WRITE64, 0x1000, 0x1000, 4, 0));
+    CHECK_EQ(unit->u_WBCount, 0);
+    unit->u_Flags.Ready = 1;
+
+    test_FreeUnit(unit);
+}
+
+/* Transient errors keep the data, others drop them and fail the next write */
+static void test_Errors(void)
+{
+    SBP2Unit *unit = test_NewUnit();
+    ULONG i;
+
+    /* Busy target: kept up to SBP2_WB_RETRIES failed flushes */
+    test_Absorb(unit, 0x1000, 0x1000, 1);
+    test_FailError = HFERR_Phase;
+    test_FailCount = SBP2_WB_RETRIES;
+    for (i=1; i < SBP2_WB_RETRIES; i++)
+    {
+        CHECK(test_Dispatch(unit, CMD_UPDATE, 0, 0, 0, HFERR_Phase));
+        CHECK_EQ(unit->u_WBCount, 1);
+    }
+
+    CHECK(!test_Dispatch(unit, CMD_UPDATE, 0, 0, 0, 0));
+    CHECK_EQ(unit->u_WBCount, 0);
+    CHECK_EQ(unit->u_WBError, HFERR_Phase);
+    CHECK_EQ(test_CmdCount, 0);
+
+    /* The lost data are reported by the next write, not absorbed */
+    CHECK(test_Dispatch(unit, TD_WRITE64, 0x1000, 0x1000, 2, HFERR_Phase));
+    CHECK_EQ(unit->u_WBError, 0);
+    CHECK_EQ(unit->u_WBCount, 0);
+    test_Absorb(unit, 0x1000, 0x1000, 2);
+
+    /* A bus reset: retries are not counted until the unit is ready again */
+    unit->u_Flags.Ready = 0;
+    test_FailError = TDERR_PostReset;
+    test_FailCount = SBP2_WB_RETRIES * 2;
+    for (i=0; i < SBP2_WB_RETRIES * 2; i++)
+    {
+        CHECK_EQ(sbp2_wb_flush(unit), TDERR_PostReset);
+        CHECK_EQ(unit->u_WBCount, 1);
+    }
+
+    unit->u_Flags.Ready = 1;
+    CHECK_EQ(sbp2_wb_flush(unit), 0);
+    CHECK_EQ(unit->u_WBCount, 0);
+    CHECK_EQ(test_CmdCount, 1);
+    test_CheckDisk(0x1000, 0x1000, 2);
+
+    /* A permanent error drops the data at once */
+    test_Absorb(unit, 0x1000, 0x1000, 3);
+    test_FailError = HFERR_BadStatus;
+    test_FailCount = 1;
+    CHECK_EQ(sbp2_wb_flush(unit), HFERR_BadStatus);
+    CHECK_EQ(unit->u_WBCount, 0);
+    CHECK_EQ(unit->u_WBError, HFERR_BadStatus);
+    test_CheckDisk(0x1000, 0x1000, 2);
+    unit->u_WBError = 0;
+
+    /* A medium change too */
+    test_Absorb(unit, 0x1000, 0x1000, 4);
+    sbp2_wb_discard(unit);
+    CHECK_EQ(unit->u_WBCount, 0);
+    CHECK_EQ(unit->u_WBError, TDERR_DiskChanged);
+    CHECK(test_Dispatch(unit, TD_WRITE64, 0x1000, 0x1000, 5, TDERR_DiskChanged));
+
+    test_FreeUnit(unit);
+}
+
+/* Data lost by the unit release are reported */
+static void test_Release(void)
+{
+    SBP2Unit *unit;
+    ULONG errors = hosthelios_Errors;
+
+    unit = test_NewUnit();
+    test_Absorb(unit, 0x1000, 0x1000, 1);
+    test_FreeUnit(unit);
+    CHECK_EQ(hosthelios_Errors, errors + 1);
+    CHECK_EQ(test_CmdCount, 0);
+
+    /* A flush error not given to a write yet */
+    unit = test_NewUnit();
+    test_Absorb(unit, 0x1000, 0x1000, 2);
+    test_FailError = HFERR_BadStatus;
+    test_FailCount = 1;
+    CHECK_EQ(sbp2_wb_flush(unit), HFERR_BadStatus);
+    test_FreeUnit(unit);
+    CHECK_EQ(hosthelios_Errors, errors + 2);
+
+    /* Nothing lost */
+    unit = test_NewUnit();
+    test_Absorb(unit, 0x1000, 0x1000, 3);
+    CHECK_EQ(sbp2_wb_flush(unit), 0);
+    test_FreeUnit(unit);
+    CHECK_EQ(hosthelios_Errors, errors + 2);
+}
+
+static int test_Main(int argc, char **argv)
+{
+    test_Base.hc_SysBase = SysBase;
+    test_Port = CreateMsgPort();
+    test_Disk = AllocVec(TEST_DISK_SIZE, MEMF_PUBLIC | MEMF_CLEAR);
+
+    test_Coalesce();
+    test_Dispatching();
+    test_Errors();
+    test_Release();
+
+    FreeVec(test_Disk);
+    DeleteMsgPort(test_Port);
+
+    return hosttest_Result("wback");
+}
+
+int main(int argc, char **argv)
+{
+    return host_RunMain(test_Main, argc, argv);
+}
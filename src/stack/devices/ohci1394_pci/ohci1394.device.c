@@ -26,6 +26,15 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #include "ohci1394trans.h"
 #include "debug.h"
 
+#ifdef OHCI1394_SIMULATOR
+#include "ohci1394sim.h"
+#define OPEN_PCIX() ohcisim_OpenBus()
+#define CLOSE_PCIX(b) ohcisim_CloseBus(b)
+#else
+#define OPEN_PCIX() OpenLibrary("pcix.library", 50)
+#define CLOSE_PCIX(b) CloseLibrary(b)
+#endif
+
 #include <exec/errors.h>
 #include <exec/lists.h>
 #include <devices/timer.h>
@@ -59,7 +68,7 @@ static OHCI1394Device *DEV_Init(OHCI1394Device *base,
     HeliosBase = OpenLibrary("helios.library", 52);
     if (NULL != HeliosBase)
     {
-        PCIXBase = OpenLibrary("pcix.library", 50);
+        PCIXBase = OPEN_PCIX();
         if (NULL != PCIXBase)
         {
             DOSBase = (struct DosLibrary *) OpenLibrary("dos.library", 39);
@@ -96,7 +105,7 @@ static OHCI1394Device *DEV_Init(OHCI1394Device *base,
             else
                 _ERR("OpenLibrary(\"dos.library\", 39) failed!\n");
 
-            CloseLibrary(PCIXBase);
+            CLOSE_PCIX(PCIXBase);
         }
         else
             _ERR("OpenLibrary(\"pcix.library\", 50) failed!\n");
@@ -198,7 +207,7 @@ static BPTR DEV_Close(void)
         DeletePool(base->hd_MemPool);
         CloseLibrary(UtilityBase);
         CloseLibrary((struct Library *) DOSBase);
-        CloseLibrary(PCIXBase);
+        CLOSE_PCIX(PCIXBase);
         CloseLibrary(HeliosBase);
 
         if (base->hd_Library.lib_Flags & LIBF_DELEXP)
@@ -226,8 +235,10 @@ static void DEV_BeginIO(void)
     ret = unit->hu_Flags.UnrecoverableError;
     UNLOCK_REGION_SHARED(unit);
 
-    /* Block any command except CMD_RESET if the unit is in an unrecoverable state */
-    if (ret && (CMD_RESET != ioreq->iohh_Req.io_Command))
+    /* Block any command except CMD_RESET (and the trace dump, to debug it)
+     * if the unit is in an unrecoverable state.
+     */
+    if (ret && (CMD_RESET != ioreq->iohh_Req.io_Command) && (HHIOCMD_DUMPTRACE != ioreq->iohh_Req.io_Command))
     {
         _ERR("UnrecoverableError\n");
         ioreq->iohh_Req.io_Error = HHIOERR_UNRECOVERABLE_ERROR_STATE;
@@ -265,6 +276,10 @@ static void DEV_BeginIO(void)
                 ret = cmdSendRequest(ioreq, unit, base);
                 break;
 
+            case HHIOCMD_SENDREQUESTS:
+                ret = cmdSendRequests(ioreq, unit, base);
+                break;
+
             case HHIOCMD_ADDREQHANDLER:
                 ret = cmdAddReqHandler(ioreq, unit, base);
                 break;
@@ -293,6 +308,18 @@ static void DEV_BeginIO(void)
                 ret = cmdStopIsoCtx(ioreq, unit, base);
                 break;
 
+            case HHIOCMD_DUMPTRACE:
+                ret = cmdDumpTrace(ioreq, unit, base);
+                break;
+
+            case HHIOCMD_RESETSTATISTICS:
+                ret = cmdResetStatistics(ioreq, unit, base);
+                break;
+
+            case HHIOCMD_READCAPTURE:
+                ret = cmdReadCapture(ioreq, unit, base);
+                break;
+
             default:
                 _INFO("CMD_INVALID\n");
                 ioreq->iohh_Req.io_Error = IOERR_NOCMD;
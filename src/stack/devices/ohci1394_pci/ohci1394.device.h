@@ -81,10 +81,14 @@ extern CMDP(cmdBusReset);
 extern CMDP(cmdSendRawPacket);
 extern CMDP(cmdSendPhy);
 extern CMDP(cmdSendRequest);
+extern CMDP(cmdSendRequests);
 extern CMDP(abortSendRequest);
 extern CMDP(cmdAddReqHandler);
 extern CMDP(cmdRemReqHandler);
 extern CMDP(cmdSetAttrs);
+extern CMDP(cmdDumpTrace);
+extern CMDP(cmdResetStatistics);
+extern CMDP(cmdReadCapture);
 extern CMDP(cmdCreateIsoCtx);
 extern CMDP(cmdDelIsoCtx);
 extern CMDP(cmdStartIsoCtx);
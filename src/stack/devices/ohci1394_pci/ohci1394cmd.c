@@ -37,6 +37,9 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #include "ohci1394topo.h"
 #include "ohci1394trans.h"
 #include "ohci1394dev.h"
+#ifdef OHCI1394_SIMULATOR
+#include "ohci1394sim.h"
+#endif
 
 #include <exec/errors.h>
 
@@ -175,6 +178,52 @@ CMDP(cmdQueryDevice)
                 count++;
                 break;
 
+            case OHCI1394A_IrqMaxRate:
+                *(ULONG *)tag->ti_Data = unit->hu_IRQMaxRate;
+                count++;
+                break;
+
+            case OHCI1394A_IrqStats:
+                CopyMem(&unit->hu_IRQStats, (APTR)tag->ti_Data, sizeof(OHCI1394IrqStats));
+                count++;
+                break;
+
+            case OHCI1394A_IrDrops:
+                *(ULONG *)tag->ti_Data = unit->hu_IRDrops;
+                count++;
+                break;
+
+            case OHCI1394A_SplitStats:
+                LOCK_REGION_SHARED(unit);
+                {
+                    CopyMem(&unit->hu_SplitStats, (APTR)tag->ti_Data, sizeof(OHCI1394SplitStats));
+                    ((OHCI1394SplitStats *)tag->ti_Data)->ss_Pending = unit->hu_SplitWheel.sw_Pending;
+                }
+                UNLOCK_REGION_SHARED(unit);
+                count++;
+                break;
+
+            case HHA_TraceMask:
+                *(ULONG *)tag->ti_Data = unit->hu_Trace.tr_Mask;
+                count++;
+                break;
+
+            case HHA_TraceRing:
+                *(HeliosTraceRing **)tag->ti_Data = &unit->hu_Trace;
+                count++;
+                break;
+
+            case HHA_Statistics:
+                /* Counters are not locked, each one is consistent but not the whole copy */
+                CopyMem(&unit->hu_Stats, (APTR)tag->ti_Data, sizeof(HeliosHWStatistics));
+                count++;
+                break;
+
+            case HHA_Capture:
+                *(ULONG *)tag->ti_Data = unit->hu_Capture.cr_Flags;
+                count++;
+                break;
+
             case HHA_VendorUnique:
                 *(ULONG *)tag->ti_Data = unit->hu_OHCI_VendorID >> 24;
                 count++;
@@ -360,17 +409,15 @@ CMDP(cmdBusReset)
     return FALSE;
 }
 
-CMDP(cmdSendRequest)
+/* Check and prepare a HHIOCMD_SENDREQUEST request before sending.
+ * The destination node is set into the packet.
+ * Returns FALSE if the request shall be replied without sending it.
+ */
+static BOOL _cmd_PrepareSendRequest(IOHeliosHWReq *ioreq, OHCI1394Unit *unit, ULONG topogen)
 {
     IOHeliosHWSendRequest *ioreqext;
     HeliosTransaction *t;
     HeliosAPacket *p;
-    UBYTE gen;
-    LONG err;
-    ULONG topogen;
-    UWORD destid;
-
-    _INFO_UNIT(unit, "HHIOCMD_SENDREQUEST\n");
 
     if (ioreq->iohh_Req.io_Message.mn_Length < sizeof(IOHeliosHWSendRequest))
     {
@@ -383,20 +430,6 @@ CMDP(cmdSendRequest)
     t = &ioreqext->iohhe_Transaction;
     p = &t->htr_Packet;
 
-    LOCK_REGION_SHARED(unit);
-    {
-        if (unit->hu_Topology)
-        {
-            topogen = unit->hu_Topology->ht_Generation;
-        }
-        else
-        {
-            topogen = 0;    /* will cause an error below */
-        }
-        gen = unit->hu_OHCI_LastGeneration;
-    }
-    UNLOCK_REGION_SHARED(unit);
-
     if (NULL != ioreqext->iohhe_Device)
     {
         /* Outdated device ? */
@@ -408,11 +441,7 @@ CMDP(cmdSendRequest)
             ioreq->iohh_Req.io_Error = HHIOERR_NO_ERROR;
             return FALSE;
         }
-        destid = ioreqext->iohhe_Device->hd_NodeID;
-    }
-    else
-    {
-        destid = p->DestID;
+        p->DestID = ioreqext->iohhe_Device->hd_NodeID;
     }
 
     t->htr_Callback = _cmd_HandleResponse;
@@ -425,7 +454,42 @@ CMDP(cmdSendRequest)
     }
 
     ioreq->iohh_Actual = 0; /* will contains number of bytes read if needed */
-    err = ohci_TL_SendRequest(unit, t, destid, p->Speed, gen, p->TCode,
+    return TRUE;
+}
+
+CMDP(cmdSendRequest)
+{
+    HeliosTransaction *t;
+    HeliosAPacket *p;
+    UBYTE gen;
+    LONG err;
+    ULONG topogen;
+
+    _INFO_UNIT(unit, "HHIOCMD_SENDREQUEST\n");
+
+    LOCK_REGION_SHARED(unit);
+    {
+        if (unit->hu_Topology)
+        {
+            topogen = unit->hu_Topology->ht_Generation;
+        }
+        else
+        {
+            topogen = 0;    /* will cause an error below */
+        }
+        gen = unit->hu_OHCI_LastGeneration;
+    }
+    UNLOCK_REGION_SHARED(unit);
+
+    if (!_cmd_PrepareSendRequest(ioreq, unit, topogen))
+    {
+        return FALSE;
+    }
+
+    t = &((IOHeliosHWSendRequest *)ioreq)->iohhe_Transaction;
+    p = &t->htr_Packet;
+
+    err = ohci_TL_SendRequest(unit, t, p->DestID, p->Speed, gen, p->TCode,
                               p->ExtTCode, p->Offset, p->Payload, p->PayloadLength);
     if (HHIOERR_NO_ERROR == err)
     {
@@ -436,6 +500,76 @@ CMDP(cmdSendRequest)
     return FALSE;
 }
 
+CMDP(cmdSendRequests)
+{
+    IOHeliosHWReq **subs = ioreq->iohh_Data;
+    IOHeliosHWReq *sub;
+    HeliosTransaction *ts[OHCI1394_AT_BATCH_MAX];
+    ULONG i, n, count, topogen;
+    UBYTE gen;
+
+    _INFO_UNIT(unit, "HHIOCMD_SENDREQUESTS (%lu)\n", ioreq->iohh_Length);
+
+    ioreq->iohh_Actual = 0;
+    if ((NULL == subs) && (ioreq->iohh_Length > 0))
+    {
+        ioreq->iohh_Req.io_Error = IOERR_BADADDRESS;
+        return FALSE;
+    }
+
+    LOCK_REGION_SHARED(unit);
+    {
+        if (unit->hu_Topology)
+        {
+            topogen = unit->hu_Topology->ht_Generation;
+        }
+        else
+        {
+            topogen = 0;    /* will cause an error below */
+        }
+        gen = unit->hu_OHCI_LastGeneration;
+    }
+    UNLOCK_REGION_SHARED(unit);
+
+    for (count = ioreq->iohh_Length; count > 0; count -= i)
+    {
+        n = 0;
+        for (i=0; (i < count) && (n < OHCI1394_AT_BATCH_MAX); i++)
+        {
+            sub = subs[i];
+
+            /* Nothing to reply: the batch gets the error, Actual doesn't count it */
+            if (NULL == sub)
+            {
+                _ERR_UNIT(unit, "HHIOCMD_SENDREQUESTS: NULL request #%lu\n",
+                          ioreq->iohh_Length - count + i);
+                ioreq->iohh_Req.io_Error = HHIOERR_FAILED;
+                continue;
+            }
+
+            /* Each request is handled as a HHIOCMD_SENDREQUEST one (i.e. for AbortIO) */
+            sub->iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
+            sub->iohh_Req.io_Flags &= ~IOF_QUICK;
+            sub->iohh_Req.io_Command = HHIOCMD_SENDREQUEST;
+            sub->iohh_Req.io_Error = 0;
+
+            if (_cmd_PrepareSendRequest(sub, unit, topogen))
+            {
+                ts[n++] = &((IOHeliosHWSendRequest *)sub)->iohhe_Transaction;
+            }
+            else
+            {
+                cmd_reply_ioreq(sub, sub->iohh_Req.io_Error, 0);
+            }
+        }
+
+        subs += i;
+        ioreq->iohh_Actual += ohci_TL_SendRequests(unit, gen, ts, n);
+    }
+
+    return FALSE;
+}
+
 CMDP(abortSendRequest)
 {
     HeliosTransaction *t = (HeliosTransaction *)ioreq->iohh_Data;
@@ -519,6 +653,28 @@ CMDP(cmdSetAttrs)
                 err = ohci_SetROM(unit, (QUADLET *)tag->ti_Data);
                 ioreq->iohh_Actual++;
                 break;
+
+            case OHCI1394A_IrqMaxRate:
+                unit->hu_IRQMaxRate = MIN(tag->ti_Data, (ULONG)OHCI1394_IRQ_MAX_RATE);
+                ioreq->iohh_Actual++;
+                break;
+
+            case HHA_TraceMask:
+                unit->hu_Trace.tr_Mask = tag->ti_Data;
+                ioreq->iohh_Actual++;
+                break;
+
+            case HHA_Capture:
+                unit->hu_Capture.cr_Flags = tag->ti_Data;
+                ioreq->iohh_Actual++;
+                break;
+
+#ifdef OHCI1394_SIMULATOR
+            case OHCI1394A_Replay:
+                err = ohcisim_Replay(unit, (OHCI1394Replay *)tag->ti_Data);
+                ioreq->iohh_Actual++;
+                break;
+#endif
         }
 
         if (err)
@@ -532,24 +688,68 @@ CMDP(cmdSetAttrs)
     return FALSE;
 }
 
+CMDP(cmdDumpTrace)
+{
+    _INFO_UNIT(unit, "HHIOCMD_DUMPTRACE (%lu bytes @ %p)\n", ioreq->iohh_Length, ioreq->iohh_Data);
+
+    ioreq->iohh_Actual = trace_Dump(&unit->hu_Trace, ioreq->iohh_Data,
+                                    ioreq->iohh_Length / sizeof(HeliosTraceEvent));
+    ioreq->iohh_Req.io_Error = HHIOERR_NO_ERROR;
+
+    return FALSE;
+}
+
+CMDP(cmdReadCapture)
+{
+    _INFO_UNIT(unit, "HHIOCMD_READCAPTURE (%lu bytes @ %p, after #%lu)\n",
+               ioreq->iohh_Length, ioreq->iohh_Data, ioreq->iohh_Actual);
+
+    ioreq->iohh_Actual = capture_Read(&unit->hu_Capture, ioreq->iohh_Actual, ioreq->iohh_Data,
+                                      ioreq->iohh_Length / sizeof(HeliosCapturePacket));
+    ioreq->iohh_Req.io_Error = HHIOERR_NO_ERROR;
+
+    return FALSE;
+}
+
+CMDP(cmdResetStatistics)
+{
+    _INFO_UNIT(unit, "HHIOCMD_RESETSTATISTICS\n");
+
+    memset(&unit->hu_Stats, 0, sizeof(unit->hu_Stats));
+    ioreq->iohh_Req.io_Error = HHIOERR_NO_ERROR;
+
+    return FALSE;
+}
+
 CMDP(cmdDelIsoCtx)
 {
+    OHCI1394Context *ctx;
+
     _INFO_UNIT(unit, "HHIOCMD_DELETEISOCONTEXT\n");
 
-    ohci_IRContext_Destroy(ioreq->iohh_Data);
+    ctx = ioreq->iohh_Data;
+    if (ctx->ctx_RegOffset >= OHCI1394_REG_IRECV_CONTEXT_CONTROL(0))
+    {
+        ohci_IRContext_Destroy((OHCI1394IRCtx *)ctx);
+    }
+    else
+    {
+        ohci_ITContext_Destroy((OHCI1394ITCtx *)ctx);
+    }
 
     return FALSE;
 }
 
 CMDP(cmdCreateIsoCtx)
 {
-    OHCI1394IRCtx **ctx_p=NULL;
+    APTR *ctx_p=NULL;
     struct TagItem *tag, *tags;
     LONG err=HHIOERR_FAILED, type=-1, index=-1;
+    ULONG rxmode=HELIOS_ISO_RX_PACKET_PER_BUFFER;
     UWORD ibuf_size=0, ibuf_count=0, hlen=0;
     UBYTE payload_align=1;
     APTR callback=NULL, udata=NULL;
-    BOOL dropempty=FALSE;
+    BOOL dropempty=FALSE, cip=FALSE;
 
     _INFO_UNIT(unit, "HHIOCMD_CREATEISOCONTEXT\n");
 
@@ -572,6 +772,8 @@ CMDP(cmdCreateIsoCtx)
             case HA_IsoCallback: callback = (APTR)tag->ti_Data; break;
             case HA_UserData: udata = (APTR)tag->ti_Data; break;
             case HA_IsoRxDropEmpty: dropempty = tag->ti_Data; break;
+            case HA_IsoTxCIP: cip = tag->ti_Data; break;
+            case HA_IsoRxMode: rxmode = tag->ti_Data; break;
 
             default: ioreq->iohh_Actual--; break;
         }
@@ -584,11 +786,26 @@ CMDP(cmdCreateIsoCtx)
     {
         if (HELIOS_ISO_RX_CTX == type)
         {
-            if ((ibuf_size > 0) && (ibuf_count > 0) && (hlen > 0) && (payload_align > 0))
+            OHCI1394IRCtxFlags flags;
+            BOOL valid;
+
+            flags.DropEmpty = dropempty;
+            flags.BufferFill = (HELIOS_ISO_RX_BUFFER_FILL == rxmode) || (HELIOS_ISO_RX_MULTI_CHANNEL == rxmode);
+            flags.MultiChannel = HELIOS_ISO_RX_MULTI_CHANNEL == rxmode;
+
+            if (flags.BufferFill)
+            {
+                /* Pages must hold at least one empty packet, and be given back to the DMA while it fills the next one */
+                valid = (ibuf_size >= 8) && (ibuf_count > 1) && (NULL != callback);
+            }
+            else
             {
-                OHCI1394IRCtxFlags flags;
+                valid = (HELIOS_ISO_RX_PACKET_PER_BUFFER == rxmode) &&
+                    (ibuf_size > 0) && (ibuf_count > 0) && (hlen > 0) && (payload_align > 0);
+            }
 
-                flags.DropEmpty = dropempty;
+            if (valid)
+            {
                 *ctx_p = ohci_IRContext_Create(unit, index, ibuf_size, ibuf_count,
                                                hlen, payload_align, callback, udata, flags);
                 if (NULL != *ctx_p)
@@ -597,9 +814,20 @@ CMDP(cmdCreateIsoCtx)
                 }
             }
         }
-        else
+        else if (HELIOS_ISO_TX_CTX == type)
         {
-            DB_NotImplemented();
+            if ((ibuf_size > 0) && (ibuf_count > 1) && (NULL != callback))
+            {
+                OHCI1394ITCtxFlags flags;
+
+                flags.CIP = cip;
+                *ctx_p = ohci_ITContext_Create(unit, index, ibuf_size, ibuf_count,
+                                               callback, udata, flags);
+                if (NULL != *ctx_p)
+                {
+                    err = 0;
+                }
+            }
         }
     }
 
@@ -610,7 +838,9 @@ CMDP(cmdCreateIsoCtx)
 CMDP(cmdStartIsoCtx)
 {
     struct TagItem *tag, *tags;
-    ULONG channel=-1, isotag=0;
+    ULONG channel=-1, isotag=0, speed=S400;
+    ULONG mask_hi=0, mask_lo=0;
+    LONG cycle_match=-1;
     OHCI1394Context *ctx=NULL;
     LONG err=HHIOERR_FAILED;
 
@@ -628,6 +858,10 @@ CMDP(cmdStartIsoCtx)
             case HA_IsoContext: ctx = (APTR)tag->ti_Data; break;
             case HA_IsoChannel: channel = tag->ti_Data; break;
             case HA_IsoTag: isotag = tag->ti_Data; break;
+            case HA_Speed: speed = tag->ti_Data; break;
+            case HA_IsoCycleMatch: cycle_match = tag->ti_Data; break;
+            case HA_IsoChannelMaskHi: mask_hi = tag->ti_Data; break;
+            case HA_IsoChannelMaskLo: mask_lo = tag->ti_Data; break;
 
             default: ioreq->iohh_Actual--; break;
         }
@@ -637,11 +871,13 @@ CMDP(cmdStartIsoCtx)
     {
         if (ctx->ctx_RegOffset >= OHCI1394_REG_IRECV_CONTEXT_CONTROL(0))
         {
-            ohci_IRContext_Start((OHCI1394IRCtx *)ctx, channel, isotag);
+            ohci_IRContext_Start((OHCI1394IRCtx *)ctx, channel, isotag,
+                                 ((UQUAD)mask_hi << 32) | mask_lo);
+            err = 0;
         }
-        else
+        else if (ohci_ITContext_Start((OHCI1394ITCtx *)ctx, channel, isotag, speed, cycle_match))
         {
-            DB_NotImplemented();
+            err = 0;
         }
     }
 
@@ -662,7 +898,7 @@ CMDP(cmdStopIsoCtx)
     }
     else
     {
-        DB_NotImplemented();
+        ohci_ITContext_Stop((OHCI1394ITCtx *)ioreq->iohh_Data);
     }
 
     return FALSE;
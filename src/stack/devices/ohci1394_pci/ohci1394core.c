@@ -49,7 +49,11 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #include "proto/helios.h"
 
 #include <exec/errors.h>
+#ifdef OHCI1394_SIMULATOR
+#include "ohci1394sim.h"
+#else
 #include <libraries/pcix.h>
+#endif
 #include <hardware/atomic.h>
 #include <hardware/byteswap.h>
 #include <clib/macros.h>
@@ -57,7 +61,10 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #include <proto/exec.h>
 #include <proto/dos.h>
 #include <proto/utility.h>
+#include <proto/timer.h>
+#ifndef OHCI1394_SIMULATOR
 #include <proto/pcix.h>
+#endif
 #include <proto/alib.h>
 
 #include <unistd.h>
@@ -132,9 +139,9 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define HELIOS_PCI_OWNER DEVNAME
 
 #define TASK_PRIO_BUSRESET      21
-#define TASK_PRIO_ARCTX         20
-#define TASK_PRIO_ATCTX         20
+#define TASK_PRIO_IRQ           20
 #define TASK_PRIO_IRCTX         21
+#define TASK_PRIO_ITCTX         21
 #define TASK_PRIO_SPLITTIMEOUT  20
 
 #define MAXLOOP                 100
@@ -153,6 +160,11 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define ARBUFFER_PAGE_SIZE      65532 /* 2068 <= n <= 65532 */
 #define ARBUFFER_PAGE_COUNT     10 /* per AR ctx */
 
+/* Pages are followed by one spare page, where the start of the ring is copied
+ * when a packet is split between the last and the first page.
+ */
+#define ARBUFFER_RING_SIZE      (ARBUFFER_PAGE_COUNT * ARBUFFER_PAGE_SIZE)
+
 #define OHCI1394_FLAGS_GUID_ROM (1<<0)
 
 #define OHCI1394_MAX_AT_REQ_RETRIES     (0x2)
@@ -169,6 +181,17 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define CTX_MULTI_CHAN_MODE    (1<<28)
 #define CTX_DUAL_BUFFER_MODE   (1<<27)
 
+/* IT contextControl */
+#define IT_CTX_CYCLE_MATCH_ENABLE (1ul<<31)
+
+/* Interrupt events handled by the unit IRQ task */
+#define IRQ_DEFERRED_EVENTS (OHCI1394_INTF_REQTXCOMPLETE | OHCI1394_INTF_RESPTXCOMPLETE | \
+                             OHCI1394_INTF_RQPKT | OHCI1394_INTF_RSPKT |                \
+                             OHCI1394_INTF_ISOCHRX | OHCI1394_INTF_ISOCHTX)
+
+/* Max rounds of pending events drained by one IRQ task wake-up */
+#define IRQ_BUDGET 16
+
 static void ohci_ATContext_ATCompleteHandler(OHCI1394Context *);
 static void ohci_CheckAndScheduleIsoList(struct MinList *list, ULONG events);
 
@@ -357,6 +380,9 @@ static void log_SelfIDs(UWORD node_id, UBYTE generation, ULONG self_id_count, QU
 /*--- OHCI level API ---*/
 static QUADLET ohci_RegRead(OHCI1394Unit * const unit, LONG offset)
 {
+#ifdef OHCI1394_SIMULATOR
+    return ohcisim_RegRead(unit->hu_PCI_BoardObject, offset);
+#else
     register QUADLET ret;
     register volatile QUADLET * address = (APTR)unit->hu_PCI_RegBase + offset;
 
@@ -368,10 +394,14 @@ static QUADLET ohci_RegRead(OHCI1394Unit * const unit, LONG offset)
 #endif
 
     return ret;
+#endif
 }
 
 static void ohci_RegWrite(OHCI1394Unit * const unit, LONG offset, QUADLET value)
 {
+#ifdef OHCI1394_SIMULATOR
+    ohcisim_RegWrite(unit->hu_PCI_BoardObject, offset, value);
+#else
     register volatile QUADLET * address = (APTR)unit->hu_PCI_RegBase + offset;
 
     /* byteswapping => PCI access is little-endian by default */
@@ -380,6 +410,13 @@ static void ohci_RegWrite(OHCI1394Unit * const unit, LONG offset, QUADLET value)
 #else
     *address = BE_SWAPLONG(value);
 #endif
+#endif
+}
+
+/* Tracepoints and capture timestamp */
+static ULONG ohci_TraceClock(APTR data)
+{
+    return ohci_CycleTimer(data);
 }
 
 void ohci_DumpRegisters(OHCI1394Unit *unit)
@@ -502,54 +539,48 @@ static ULONG ohci_PCI_IrqHandler(APTR data)
     ohci_RegWrite(unit, OHCI1394_REG_INT_EVENT_CLEAR, events & ~OHCI1394_INTF_BUSRESET);
     log_IrqEvents(events);
 
-    /* Handle Asynchronous events */
+    unit->hu_IRQStats.is_Interrupts++;
+
     if (events & OHCI1394_INTF_SELFIDCOMPLETE)
     {
         Helios_SignalSubTask(unit->hu_BusResetTask, unit->hu_BusResetSignal);
     }
-    if (events & OHCI1394_INTF_REQTXCOMPLETE)
-    {
-        Helios_SignalSubTask(unit->hu_ATRequestCtx.atc_Context.ctx_SubTask, unit->hu_ATRequestCtx.atc_Context.ctx_Signal);
-    }
-    if (events & OHCI1394_INTF_RESPTXCOMPLETE)
-    {
-        Helios_SignalSubTask(unit->hu_ATResponseCtx.atc_Context.ctx_SubTask, unit->hu_ATResponseCtx.atc_Context.ctx_Signal);
-    }
-    if (events & OHCI1394_INTF_RQPKT)
-    {
-        Helios_SignalSubTask(unit->hu_ARRequestCtx.arc_Context.ctx_SubTask, unit->hu_ARRequestCtx.arc_Context.ctx_Signal);
-    }
-    if (events & OHCI1394_INTF_RSPKT)
-    {
-        Helios_SignalSubTask(unit->hu_ARResponseCtx.arc_Context.ctx_SubTask, unit->hu_ARResponseCtx.arc_Context.ctx_Signal);
-    }
 
-    /* Handle Isochronous Receive events */
-    iso_events = ohci_RegRead(unit, OHCI1394_REG_ISO_RECV_INT_EVENT_CLEAR);
-    ohci_RegWrite(unit, OHCI1394_REG_ISO_RECV_INT_EVENT_CLEAR, iso_events);
-    if (0 != iso_events)
+    /* AT/AR and iso events are only recorded here, then handled by the unit IRQ task.
+     * Many interrupts raised before the task runs are so coalesced in one wake-up.
+     */
+    if (events & IRQ_DEFERRED_EVENTS)
     {
-        log_IrqIsoRecvEvents(iso_events);
+        /* The iso event registers are only read if a context has raised the summary bit */
+        if (events & OHCI1394_INTF_ISOCHRX)
+        {
+            iso_events = ohci_RegRead(unit, OHCI1394_REG_ISO_RECV_INT_EVENT_CLEAR);
+            ohci_RegWrite(unit, OHCI1394_REG_ISO_RECV_INT_EVENT_CLEAR, iso_events);
+            log_IrqIsoRecvEvents(iso_events);
+            ATOMIC_OR(&unit->hu_IRQPendingIR, iso_events);
+        }
 
-        /* Scan for which iso context has interrupted and raise corresponding iso receive handlers */
-        LOCK_REGION_SHARED(unit);
-        ohci_CheckAndScheduleIsoList(&unit->hu_IRCtxList, iso_events);
-        UNLOCK_REGION_SHARED(unit);
-    }
+        if (events & OHCI1394_INTF_ISOCHTX)
+        {
+            iso_events = ohci_RegRead(unit, OHCI1394_REG_ISO_XMIT_INT_EVENT_CLEAR);
+            ohci_RegWrite(unit, OHCI1394_REG_ISO_XMIT_INT_EVENT_CLEAR, iso_events);
+            log_IrqIsoXmitEvents(iso_events);
+            ATOMIC_OR(&unit->hu_IRQPendingIT, iso_events);
+        }
 
-    /* Handle Isochronous Transmit events */
-    iso_events = ohci_RegRead(unit, OHCI1394_REG_ISO_XMIT_INT_EVENT_CLEAR);
-    ohci_RegWrite(unit, OHCI1394_REG_ISO_XMIT_INT_EVENT_CLEAR, iso_events);
-    if (0 != iso_events)
-    {
-        log_IrqIsoXmitEvents(iso_events);
+        ATOMIC_OR(&unit->hu_IRQPending, events & IRQ_DEFERRED_EVENTS);
 
-        /* Scan for which iso context has interrupted and raise corresponding iso transmit handlers */
-        LOCK_REGION_SHARED(unit);
-        ohci_CheckAndScheduleIsoList(&unit->hu_ITCtxList, iso_events);
-        UNLOCK_REGION_SHARED(unit);
+        /* With a rate ceiling, these events stay masked until the IRQ task enables them again */
+        if (0 != unit->hu_IRQMaxRate)
+        {
+            ohci_RegWrite(unit, OHCI1394_REG_INT_MASK_CLEAR, IRQ_DEFERRED_EVENTS);
+        }
+
+        Helios_SignalSubTask(unit->hu_IRQTask, unit->hu_IRQSignal);
     }
 
+    TRACE(&unit->hu_Trace, HTP_IRQ_EVENTS, 0, events, iso_events);
+
     /* Log errors */
     if (0 != (events & OHCI1394_INTF_REGACCESSFAIL))
     {
@@ -885,6 +916,14 @@ static BOOL ohci_Context_Init(OHCI1394Unit *     unit,
     ctx->ctx_Unit = unit;
     ctx->ctx_RegOffset = reg_offset;
     ctx->ctx_Handler = handler;
+
+    /* No task name: the handler is called by the unit IRQ task */
+    if (NULL == task_name)
+    {
+        ctx->ctx_SubTask = NULL;
+        return TRUE;
+    }
+
     ctx->ctx_SubTask = Helios_CreateSubTask(task_name,
                                             ohci_Context_SubTask,
                                             HA_Pool, (ULONG)unit->hu_MemPool,
@@ -901,7 +940,10 @@ static BOOL ohci_Context_Init(OHCI1394Unit *     unit,
 
 static void ohci_Context_Term(OHCI1394Context *ctx)
 {
-    Helios_KillSubTask(ctx->ctx_SubTask);
+    if (NULL != ctx->ctx_SubTask)
+    {
+        Helios_KillSubTask(ctx->ctx_SubTask);
+    }
 }
 
 static BOOL ohci_Context_IsDead(OHCI1394Context *ctx)
@@ -954,14 +996,80 @@ static void ohci_ATContext_InitDMABuffers(OHCI1394ATCtx *ctx)
     }
 }
 
+static HeliosHWCtxStats *ohci_ATContext_Stats(OHCI1394ATCtx *ctx)
+{
+    OHCI1394Unit *unit = ctx->atc_Context.ctx_Unit;
+
+    return ctx == &unit->hu_ATRequestCtx ? &unit->hu_Stats.hs_ATRequest : &unit->hu_Stats.hs_ATResponse;
+}
+
+/* Capture a filled AT buffer, header taken from its immediate data.
+ * The OHCI AT format is turned into the wire one, as received by the AR contexts.
+ */
+static void ohci_ATContext_Capture(OHCI1394Unit *unit, OHCI1394ATBuffer *buf, UBYTE type,
+                                   UBYTE event, UWORD timestamp, const QUADLET *payload)
+{
+    OHCI1394Descriptor *d = buf->atb_Descriptors;
+    QUADLET header[4];
+    ULONG i, hl, length=0;
+    UBYTE speed = 0;
+
+    hl = MIN(BE_SWAPWORD(d[0].d_ReqCount), sizeof(header));
+    for (i=0; i < hl / sizeof(QUADLET); i++)
+    {
+        header[i] = BE_SWAPLONG(((QUADLET *)&d[1])[i]);
+    }
+
+    if (hl >= 8)
+    {
+        speed = AT_GET_HEADER_SPEED(header[0]);
+
+        switch (AT_GET_HEADER_TCODE(header[0]))
+        {
+            case TCODE_WRITE_PHY:
+                /* Kept as the AR context gives it, without the speed */
+                header[0] &= 0xffff;
+                break;
+
+            case TCODE_WRITE_STREAM:
+                /* data_length replaces the speed, one quadlet */
+                header[0] = (header[1] & 0xffff0000) | (header[0] & 0xffff);
+                hl = 4;
+                break;
+
+            default:
+                /* destination_ID replaces the speed, source_ID takes its place */
+                header[0] = (header[1] & 0xffff0000) | (header[0] & 0xffff);
+                header[1] = ((QUADLET)unit->hu_LocalNodeId << 16) | (header[1] & 0xffff);
+                break;
+        }
+    }
+
+    if (buf->atb_LastDescriptor != d)
+    {
+        length = BE_SWAPWORD(buf->atb_LastDescriptor->d_ReqCount);
+    }
+
+    capture_Packet(&unit->hu_Capture, type, event, timestamp, speed, header, hl, payload, length);
+}
+
 static OHCI1394ATBuffer *ohci_ATContext_GetBuffer(OHCI1394ATCtx *ctx)
 {
+    HeliosHWCtxStats *stats = ohci_ATContext_Stats(ctx);
     OHCI1394ATBuffer *buf;
+    ULONG used;
 
     buf = (OHCI1394ATBuffer *)REMHEAD((struct List *)&ctx->atc_BufferList);
     ADDTAIL((struct List *)&ctx->atc_UsedBufferList, (struct Node *)buf);
     ctx->atc_BufferUsage--;
 
+    /* Context is locked, the high-water mark needs no atomic update */
+    used = AT_DMA_BUFFER_SIZE / sizeof(OHCI1394ATBuffer) - ctx->atc_BufferUsage;
+    if (used > stats->cs_HighWater)
+    {
+        stats->cs_HighWater = used;
+    }
+
     _INFO_CTX(ctx, "DMA usage: %lu\n", ctx->atc_BufferUsage);
 
     return buf;
@@ -1028,21 +1136,28 @@ static void ohci_ATContext_AppendBuffer(OHCI1394ATCtx *    ctx,
                                         OHCI1394ATBuffer * buffer,
                                         ULONG              z)
 {
-    OHCI1394Unit *unit = ctx->atc_Context.ctx_Unit;
-    ULONG regoff = ctx->atc_Context.ctx_RegOffset;
+    HeliosHWCtxStats *stats = ohci_ATContext_Stats(ctx);
     OHCI1394Descriptor *d;
-    ULONG d_phy_addr;
+    ULONG d_phy_addr, bytes;
 
     d = &buffer->atb_Descriptors[0];
     d_phy_addr = ohci_ATContext_GetPhyAddress(ctx, d); /* normally aligned on 16-bytes */
 
-    _INFO_CTX(ctx, "CmdPtr=$%p, Reg=$%p\n", ctx->atc_CommandPtr,
-              ohci_RegRead(unit, CTX_CTRL_CMDPTR(regoff)));
+    /* Header, plus the payload if any */
+    bytes = BE_SWAPWORD(d->d_ReqCount);
+    if (buffer->atb_LastDescriptor != d)
+    {
+        bytes += BE_SWAPWORD(buffer->atb_LastDescriptor->d_ReqCount);
+    }
+    ATOMIC_ADD((LONG *)&stats->cs_Packets, 1);
+    ATOMIC_ADD((LONG *)&stats->cs_Bytes, bytes);
+
+    _INFO_CTX(ctx, "CmdPtr=$%p\n", ctx->atc_CommandPtr);
 
     /* DMA already programmed ? */
     if (NULL != ctx->atc_LastBuffer)
     {
-        _INFO_CTX(ctx, "Last buffer of ctx %p: %p\n", regoff, ctx->atc_LastBuffer);
+        _INFO_CTX(ctx, "Last buffer of ctx %p: %p\n", ctx->atc_Context.ctx_RegOffset, ctx->atc_LastBuffer);
 
         /* Attach this new buffer to an existant DMA program */
         ctx->atc_LastBuffer->atb_LastDescriptor->d_BranchAddress = BE_SWAPLONG( d_phy_addr | z);
@@ -1066,8 +1181,16 @@ static void ohci_ATContext_AppendBuffer(OHCI1394ATCtx *    ctx,
               d_phy_addr);
 
     log_DumpMem(d, sizeof(OHCI1394Descriptor)*z, TRUE, "Dumping context descriptors:\n");
+}
+
+/* Force a DMA wake-up, so the context fetches newly appended descriptors.
+ * Called once after one or more calls to ohci_ATContext_AppendBuffer().
+ */
+static void ohci_ATContext_Wake(OHCI1394ATCtx *ctx)
+{
+    OHCI1394Unit *unit = ctx->atc_Context.ctx_Unit;
+    ULONG regoff = ctx->atc_Context.ctx_RegOffset;
 
-    /* Force a DMA wake-up */
     _INFO_CTX(ctx, "wake-up ... (status = %08x)\n", ohci_RegRead(unit, CTX_CTRL_SET(regoff)));
     ohci_RegWrite(unit, CTX_CTRL_SET(regoff), CTX_WAKE);
 }
@@ -1075,8 +1198,7 @@ static void ohci_ATContext_AppendBuffer(OHCI1394ATCtx *    ctx,
 
 static BOOL ohci_ATContext_Init(OHCI1394Unit *        unit,
                                 OHCI1394ATCtx *       ctx,
-                                ULONG                 regoffset,
-                                STRPTR                task_name)
+                                ULONG                 regoffset)
 {
     static const ULONG cnt = AT_DMA_BUFFER_SIZE / sizeof(OHCI1394ATBuffer);
     static const ULONG size = cnt * sizeof(OHCI1394ATBuffer);
@@ -1100,8 +1222,7 @@ static BOOL ohci_ATContext_Init(OHCI1394Unit *        unit,
     ohci_ATContext_InitDMABuffers(ctx);
 
     if (!ohci_Context_Init(unit, &ctx->atc_Context, regoffset,
-                           task_name, ohci_ATContext_ATCompleteHandler,
-                           TASK_PRIO_ATCTX))
+                           NULL, ohci_ATContext_ATCompleteHandler, 0))
     {
         FreeVecDMA(ctx->atc_AllocDMABuffers);
         return FALSE;
@@ -1124,13 +1245,11 @@ static void ohci_ATContext_Term(OHCI1394ATCtx *ctx)
 static BOOL ohci_ATContexts_Init(OHCI1394Unit *unit)
 {
     if (ohci_ATContext_Init(unit, &unit->hu_ATRequestCtx,
-                            OHCI1394_REG_AREQT_CONTEXT_CONTROL,
-                            "["DEVNAME"] AT Requests Handler"))
+                            OHCI1394_REG_AREQT_CONTEXT_CONTROL))
     {
         _INFO_UNIT(unit, "AT request context @ %p\n", &unit->hu_ATRequestCtx);
         if (ohci_ATContext_Init(unit, &unit->hu_ATResponseCtx,
-                                OHCI1394_REG_AREST_CONTEXT_CONTROL,
-                                "["DEVNAME"] AT Responses Handler"))
+                                OHCI1394_REG_AREST_CONTEXT_CONTROL))
         {
             _INFO_UNIT(unit, "AT response context @ %p\n", &unit->hu_ATResponseCtx);
             return TRUE;
@@ -1217,6 +1336,8 @@ static void ohci_ARContext_Reset(OHCI1394ARCtx *ctx)
     ctx->arc_FirstBuffer = buf = ctx->arc_CpuDMABuffers;
     for (i=0; i < ARBUFFER_PAGE_COUNT; i++, buf++)
     {
+        buf->arb_Holds = 0;
+
         if (i < (ARBUFFER_PAGE_COUNT-1))
         {
             next = buf + 1;
@@ -1235,6 +1356,7 @@ static void ohci_ARContext_Reset(OHCI1394ARCtx *ctx)
 
     ctx->arc_LastBuffer = ctx->arc_RealLastBuffer;
     ctx->arc_FirstQuadlet = ctx->arc_Pages;
+    ctx->arc_Consumed = 0;
 }
 
 static void ohci_ARContext_Start(OHCI1394ARCtx *ctx)
@@ -1274,6 +1396,50 @@ static void ohci_ARContext_Wake(OHCI1394ARCtx *ctx)
     _INFO_ARDMA_CTX(ctx, "wake-up: Ctrl=%08x\n", ohci_RegRead(unit, CTX_CTRL_SET(ctx->arc_Context.ctx_RegOffset)));
 }
 
+/* Give back consumed pages to the DMA program, in ring order.
+ * Stops at the first page with borrowed zero-copy views: next pages
+ * may contain the end of a packet started on it.
+ */
+static void ohci_ARContext_Recycle(OHCI1394ARCtx *ctx)
+{
+    OHCI1394ARBuffer *buf;
+    BOOL wake = FALSE;
+
+    while (ctx->arc_Consumed > 0)
+    {
+        if (ctx->arc_LastBuffer == ctx->arc_RealLastBuffer)
+        {
+            buf = ctx->arc_CpuDMABuffers;
+        }
+        else
+        {
+            buf = ctx->arc_LastBuffer + 1;
+        }
+
+        if (buf->arb_Holds > 0)
+        {
+            _INFO_ARDMA_CTX(ctx, "buffer $%p held (%lu view(s))\n", buf, buf->arb_Holds);
+            break;
+        }
+
+        /* This full DMA block becomes the last DMA block in the program */
+        ctx->arc_LastBuffer->arb_Descriptor.d_BranchAddress |= BE_SWAPLONG_C(1); /* Z=1 */
+        _INFO_ARDMA_CTX(ctx, "old last buffer: $%p (z=%u)\n",
+                        ctx->arc_LastBuffer,
+                        BE_SWAPLONG(ctx->arc_LastBuffer->arb_Descriptor.d_BranchAddress) & 15);
+        buf->arb_Descriptor.d_BranchAddress &= BE_SWAPLONG_C(~15); /* Z=0 */
+        ctx->arc_LastBuffer = buf;
+        ctx->arc_Consumed--;
+        wake = TRUE;
+    }
+
+    /* Inform the DMA context of this change */
+    if (wake)
+    {
+        ohci_ARContext_Wake(ctx);
+    }
+}
+
 
 // Called in a task context, but keep it as fast possible
 static QUADLET *ohci_ARContext_ParsePacket(OHCI1394ARCtx *ctx,
@@ -1285,6 +1451,7 @@ static QUADLET *ohci_ARContext_ParsePacket(OHCI1394ARCtx *ctx,
 #endif
 
     HeliosAPacket p;
+    HeliosHWCtxStats *stats;
     ULONG len;
     QUADLET trailer;
     UBYTE event;
@@ -1370,6 +1537,17 @@ static QUADLET *ohci_ARContext_ParsePacket(OHCI1394ARCtx *ctx,
     p.Speed = (trailer >> 5) & 7;
     _INFO_ARDMA_CTX(ctx, "Event=$%02x (%s), TS=$%04x, Speed=%u, tcode=%u, payload=$%p (%lu byte(s))\n",
                     event, evt_strings[event], p.TimeStamp, p.Speed, p.TCode, p.Payload, p.PayloadLength);
+    TRACE(&unit->hu_Trace, HTP_AR_PACKET, event, p.Header[0], p.Header[1]);
+
+    stats = isrequest ? &unit->hu_Stats.hs_ARRequest : &unit->hu_Stats.hs_ARResponse;
+    ATOMIC_ADD((LONG *)&stats->cs_Packets, 1);
+    ATOMIC_ADD((LONG *)&stats->cs_Bytes, p.HeaderLength + p.PayloadLength);
+
+    if (CAPTURE_ENABLED(&unit->hu_Capture))
+    {
+        capture_Packet(&unit->hu_Capture, HCAPTURE_AR, event, p.TimeStamp, p.Speed,
+                       p.Header, p.HeaderLength, p.Payload, p.PayloadLength);
+    }
 
     /* handle event code first */
     if (OHCI1394_EVENT_BUS_RESET == event)
@@ -1414,6 +1592,8 @@ static QUADLET *ohci_ARContext_ParsePacket(OHCI1394ARCtx *ctx,
         /* drop outdated incomming packets */
         if (!gen_ok)
         {
+            TRACE(&unit->hu_Trace, HTP_AR_DROP, packet_gen, p.Header[0], p.Header[1]);
+            STAT_INC(unit, hs_ARGenerationDrops);
             goto bye;
         }
 
@@ -1472,8 +1652,8 @@ static void ohci_ARContext_PktHandler(OHCI1394Context *_ctx)
      * on the next buffer).
      * As all pages has been allocated as a contiguous buffer, so the split is trivial to handle
      * except when it occures between the last bytes and the first bytes of this big buffer.
-     * If the global pages buffer is large enough this not occures often and we could do some
-     * more cpu intensive stuffs in this case (like using the current full buffer to merge the packet).
+     * In this case the data of the first page are copied in the spare page following the ring,
+     * so packets already parsed in the last page, possibly borrowed, are never moved.
      */
     if (0 == resCount)
     {
@@ -1509,18 +1689,10 @@ static void ohci_ARContext_PktHandler(OHCI1394Context *_ctx)
             /* Packet split between the end of pages buffer and its start ? */
             if (at_end)
             {
-                /* We're going to reuse the current buffer to reassembling the packet */
+                /* Continue the ring in the spare page to reassemble the packet */
                 _INFO_ARDMA_CTX(ctx, "Split packet detected: len=%lu, rest=%lu\n", len, rest);
 
-                memmove(buf->arb_Page, start, len);
-                CopyMem(ctx->arc_FirstBuffer->arb_Page, (APTR)buf->arb_Page + len, rest);
-
-                /* Note: as page size is equals or bigger than the maximal packet size,
-                 * our reassembled buffer contains at least one packet and shall not contains
-                 * a split packet anymore.
-                 */
-
-                start = buf->arb_Page;
+                CopyMem(ctx->arc_FirstBuffer->arb_Page, (APTR)buf->arb_Page + ARBUFFER_PAGE_SIZE, rest);
             }
 
             len += rest;
@@ -1546,16 +1718,13 @@ static void ohci_ARContext_PktHandler(OHCI1394Context *_ctx)
 
         _INFO_ARDMA_CTX(ctx, "New FQ: $%p, new FB: $%p\n", ctx->arc_FirstQuadlet, ctx->arc_FirstBuffer);
 
-        /* This full DMA block becomes the last DMA block in the program */
-        ctx->arc_LastBuffer->arb_Descriptor.d_BranchAddress |= BE_SWAPLONG_C(1); /* Z=1 */
-        _INFO_ARDMA_CTX(ctx, "old last buffer: $%p (z=%u)\n",
-                        ctx->arc_LastBuffer,
-                        BE_SWAPLONG(ctx->arc_LastBuffer->arb_Descriptor.d_BranchAddress) & 15);
-        buf->arb_Descriptor.d_BranchAddress &= BE_SWAPLONG_C(~15); /* Z=0 */
-        ctx->arc_LastBuffer = buf;
-
-        /* Inform the DMA context of this change */
-        ohci_ARContext_Wake(ctx);
+        /* Full DMA block given back to the DMA program when not borrowed anymore */
+        LOCK_CTX(ctx);
+        {
+            ctx->arc_Consumed++;
+            ohci_ARContext_Recycle(ctx);
+        }
+        UNLOCK_CTX(ctx);
     }
     else
     {
@@ -1590,11 +1759,10 @@ static void ohci_ARContext_PktHandler(OHCI1394Context *_ctx)
 
 static BOOL ohci_ARContext_Init(OHCI1394Unit *        unit,
                                 OHCI1394ARCtx *       ctx,
-                                ULONG                 regoffset,
-                                STRPTR                task_name)
+                                ULONG                 regoffset)
 {
     static const ULONG blocksize = ARBUFFER_PAGE_COUNT * sizeof(OHCI1394ARBuffer);
-    static const ULONG pagessize = ARBUFFER_PAGE_COUNT * ARBUFFER_PAGE_SIZE;
+    static const ULONG pagessize = ARBUFFER_RING_SIZE + ARBUFFER_PAGE_SIZE; /* + spare page */
 
     /* Allocate DMA buffers space, 16-bytes aligned */
     ctx->arc_AllocDMABuffers = AllocVecDMA(blocksize + 15, MEMF_PUBLIC);
@@ -1623,8 +1791,7 @@ static BOOL ohci_ARContext_Init(OHCI1394Unit *        unit,
     _INFO_UNIT(unit, "AR-DMA[%X] pages: %p\n", regoffset, ctx->arc_Pages);
 
     if (!ohci_Context_Init(unit, &ctx->arc_Context, regoffset,
-                           task_name, ohci_ARContext_PktHandler,
-                           TASK_PRIO_ARCTX))
+                           NULL, ohci_ARContext_PktHandler, 0))
     {
         FreeVecDMA(ctx->arc_AllocDMABuffers);
         FreeVecDMA(ctx->arc_Pages);
@@ -1676,13 +1843,11 @@ static void ohci_ARContexts_Stop(OHCI1394Unit *unit)
 static BOOL ohci_ARContexts_Init(OHCI1394Unit *unit)
 {
     if (ohci_ARContext_Init(unit, &unit->hu_ARRequestCtx,
-                            OHCI1394_REG_AREQR_CONTEXT_CONTROL,
-                            "["DEVNAME"] AR Requests Handler"))
+                            OHCI1394_REG_AREQR_CONTEXT_CONTROL))
     {
         _INFO_UNIT(unit, "AR request context @ %p\n", &unit->hu_ARRequestCtx);
         if (ohci_ARContext_Init(unit, &unit->hu_ARResponseCtx,
-                                OHCI1394_REG_ARESR_CONTEXT_CONTROL,
-                                "["DEVNAME"] AR Responses Handler"))
+                                OHCI1394_REG_ARESR_CONTEXT_CONTROL))
         {
             _INFO_UNIT(unit, "AR response context @ %p\n", &unit->hu_ARResponseCtx);
             return TRUE;
@@ -1829,38 +1994,31 @@ static void ohci_ATContext_ATCompleteHandler(OHCI1394Context *_ctx)
         /* Transfer status decoding */
         event = BE_SWAPWORD(buf->atb_LastDescriptor->d_TransferStatus) & 0x1f;
 
-        /* transform DMA events into ack or response codes */
-        switch (event)
-        {
-            case OHCI1394_EVENT_MISSING_ACK: /* Packet transmitted -> BusReset before any ack */
-                status = HELIOS_RCODE_MISSING_ACK;
-                break;
-
-            case OHCI1394_EVENT_FLUSHED:     /* Packet not transmitted (but in DMA-FIFO) -> BusReset */
-                status = HELIOS_RCODE_GENERATION;
-                break;
-
-            case OHCI1394_EVENT_TIMEOUT:     /* Response timeout expired, Packet not transmitted */
-                status = HELIOS_RCODE_CANCELLED;
-                break;
-
-            case HELIOS_ACK_COMPLETE + 0x10:
-            case HELIOS_ACK_PENDING + 0x10:
-            case HELIOS_ACK_BUSY_X + 0x10:
-            case HELIOS_ACK_BUSY_A + 0x10:
-            case HELIOS_ACK_BUSY_B + 0x10:
-            case HELIOS_ACK_DATA_ERROR + 0x10:
-            case HELIOS_ACK_TYPE_ERROR + 0x10:
-                status = event - 0x10;
-                break;
-
-            default:
-                status = HELIOS_RCODE_SEND_ERROR;
-        }
+        status = ohci_ATEventStatus(event);
 
         _INFO_ATDMA_CTX(ctx, "Buffer $%p ack'ed: event=$%x (%s), XferStatus=$%08x, Status=%d\n",
                         buf, event, evt_strings[event],
                         buf->atb_LastDescriptor->d_TransferStatus, status);
+        TRACE(&unit->hu_Trace, HTP_AT_COMPLETE, (UBYTE)status,
+              BE_SWAPWORD(buf->atb_LastDescriptor->d_TimeStamp), buf->atb_PacketData);
+        if (CAPTURE_ENABLED(&unit->hu_Capture))
+        {
+            ohci_ATContext_Capture(unit, buf, HCAPTURE_AT_COMPLETE, event,
+                                   BE_SWAPWORD(buf->atb_LastDescriptor->d_TimeStamp), NULL);
+        }
+
+        if (status >= 0)
+        {
+            STAT_INC(unit, hs_Acks[status]);
+            if ((HELIOS_ACK_BUSY_X == status) || (HELIOS_ACK_BUSY_A == status) || (HELIOS_ACK_BUSY_B == status))
+            {
+                STAT_INC(unit, hs_BusyAcks);
+            }
+        }
+        else if (HELIOS_RCODE_GENERATION == status)
+        {
+            STAT_INC(unit, hs_ATGenerationDrops);
+        }
 
         /* Not cancelled ? */
         LOCK_REGION(unit);
@@ -1915,6 +2073,46 @@ static void ohci_IRContext_Wake(OHCI1394IRCtx *ctx)
                   CTX_WAKE);
 }
 
+/* Request the DMA stop, without waiting: called with the context locked */
+static void ohci_IRContext_RequestStop(OHCI1394IRCtx *ctx)
+{
+    OHCI1394Unit *unit = ctx->irc_Base.ic_Context.ctx_Unit;
+
+    /* Disable interruption line */
+    ohci_RegWrite(unit, OHCI1394_REG_ISO_RECV_INT_MASK_CLEAR, 1ul << ctx->irc_Base.ic_Index);
+
+    ohci_RegWrite(unit, OHCI1394_REG_IRECV_CONTEXT_CONTROL_CLEAR(ctx->irc_Base.ic_Index), CTX_RUN);
+}
+
+/* Wait about DMA safe state after a stop request.
+ * Sleeps: never called with the context locked.
+ */
+static BOOL ohci_IRContext_WaitStopped(OHCI1394IRCtx *ctx)
+{
+    OHCI1394Unit *unit = ctx->irc_Base.ic_Context.ctx_Unit;
+    ULONG loop = 20;
+
+    do
+    {
+        QUADLET reg;
+
+        reg = ohci_RegRead(unit, OHCI1394_REG_IRECV_CONTEXT_CONTROL(ctx->irc_Base.ic_Index));
+        if (0 == (reg & CTX_ACTIVE))
+        {
+            return TRUE;
+        }
+
+        _INFO_CTX(&ctx->irc_Base.ic_Context, "IR context %u still active\n", ctx->irc_Base.ic_Index);
+        Helios_DelayMS(25); // wait 25 ms
+    }
+    while (loop--);
+
+    _ERR_CTX(&ctx->irc_Base.ic_Context,
+             "TIMEOUT, IR context #%u still active 500ms after STOP request\n",
+             ctx->irc_Base.ic_Index);
+    return FALSE;
+}
+
 static ULONG ohci_IRContext_PacketPerBuffer_InitDMABuffers(OHCI1394IRCtx *ctx, ULONG buf_size)
 {
     OHCI1394Unit *unit = ctx->irc_Base.ic_Context.ctx_Unit;
@@ -1976,6 +2174,59 @@ static ULONG ohci_IRContext_PacketPerBuffer_InitDMABuffers(OHCI1394IRCtx *ctx, U
     return cmd_ptr;
 }
 
+static ULONG ohci_IRContext_BufferFill_InitDMABuffers(OHCI1394IRCtx *ctx, ULONG page_size)
+{
+    OHCI1394Unit *unit = ctx->irc_Base.ic_Context.ctx_Unit;
+    UWORD dma_page_size = BE_SWAPWORD(page_size);
+    ULONG i, cmd_ptr, dma_phy, page_phy;
+    APTR page = ctx->irc_AlignedPageBuffer;
+    OHCI1394IRBuffer *buf;
+
+    cmd_ptr = dma_phy = (ULONG)PCIXDMAGetPhysical(unit->hu_PCI_BoardObject, ctx->irc_AlignedDMABuffer);
+    page_phy =  (ULONG)PCIXDMAGetPhysical(unit->hu_PCI_BoardObject, page);
+
+    ctx->irc_FirstDMABuffer = buf = ctx->irc_AlignedDMABuffer;
+    ctx->irc_ReadOffset = 0;
+
+    _INFO_IRDMA_CTX(ctx, "BufAddr: DMA=%p, Pages=%p\n", ctx->irc_AlignedDMABuffer, page);
+    _INFO_IRDMA_CTX(ctx, "PhyAddr: DMA=%p, Pages=[%p, %p]\n", dma_phy, page_phy, page_phy+page_size*ctx->irc_DMABufferCount);
+
+    /* One INPUT_MORE descriptor per page (Z=1).
+     * The DMA writes packets (header, payload, trailer) one after the other,
+     * continuing on the next page when the current one is full.
+     * Interrupts are only requested on page completion.
+     */
+    for (i=0; i<ctx->irc_DMABufferCount; i++, page+=page_size, page_phy+=page_size, buf++)
+    {
+        OHCI1394Descriptor *d = buf->irb_Descriptors;
+        OHCI1394Descriptor *dn;
+        ULONG z = 1;
+
+        buf->irb_BufferData.Payload = page;
+
+        if (i < (ctx->irc_DMABufferCount-1))
+        {
+            buf->irb_Next = buf + 1;
+            dn = &buf[1].irb_Descriptors[0];
+        }
+        else
+        {
+            ctx->irc_LastDMABuffer = ctx->irc_RealLastDMABuffer = buf;
+            buf->irb_Next = ctx->irc_FirstDMABuffer;
+            dn = &ctx->irc_FirstDMABuffer->irb_Descriptors[0];
+            z = 0;
+        }
+
+        d[0].d_Control = BE_SWAPWORD_C(DESCRIPTOR_INPUT_MORE | DESCRIPTOR_STATUS | DESCRIPTOR_IRQ_ALWAYS | DESCRIPTOR_BRANCH_ALWAYS);
+        d[0].d_ReqCount = d[0].d_ResCount = dma_page_size;
+        d[0].d_DataAddress = BE_SWAPLONG(page_phy);
+        d[0].d_BranchAddress = BE_SWAPLONG(dma_phy + ((APTR) dn - (APTR) ctx->irc_AlignedDMABuffer) + z);
+        d[0].d_TransferStatus = 0;
+    }
+
+    return cmd_ptr;
+}
+
 static void ohci_IRContext_PacketPerBufferCallback(OHCI1394Context *_ctx)
 {
     OHCI1394IRCtx *ctx = (OHCI1394IRCtx *)_ctx;
@@ -2089,37 +2340,197 @@ static void ohci_IRContext_PacketPerBufferCallback(OHCI1394Context *_ctx)
     UNLOCK_CTX(ctx);
 }
 
-
-static void ohci_ITContext_Run(OHCI1394ITCtx *ctx)
+static void ohci_IRContext_BufferFillCallback(OHCI1394Context *_ctx)
 {
-    _INFO_ITDMA_CTX(ctx, "[%u]: run (CmdPtr=$%08x)\n", ctx->itc_Base.ic_Index,
-                    ohci_RegRead(ctx->itc_Base.ic_Context.ctx_Unit, OHCI1394_REG_IXMIT_COMMAND_PTR(ctx->itc_Base.ic_Index)));
-
-    ohci_RegWrite(ctx->itc_Base.ic_Context.ctx_Unit,
-                  OHCI1394_REG_IXMIT_CONTEXT_CONTROL_SET(ctx->itc_Base.ic_Index),
-                  CTX_RUN);
-}
+    OHCI1394IRCtx *ctx = (OHCI1394IRCtx *)_ctx;
+    OHCI1394IRBuffer *buf;
+    UBYTE *ring = ctx->irc_AlignedPageBuffer;
+    ULONG page_size = ctx->irc_PayloadLength;
+    ULONG ring_size = page_size * ctx->irc_DMABufferCount;
+    ULONG avail, first, count;
+    BOOL recycled = FALSE, stopped = FALSE;
+
+    /* Pages are used in ring by the DMA, from FirstDMABuffer to LastDMABuffer (Z=0).
+     * Each interrupt means at least one page is full.
+     *
+     * Packets are parsed from irc_ReadOffset up to the last byte written by the DMA,
+     * then given to the user callback by batch of OHCI1394_IR_BATCH_MAX.
+     * Fully parsed pages are given back at the end of the DMA program and the context is woken up.
+     */
 
-static void ohci_ITContext_Wake(OHCI1394ITCtx *ctx)
-{
-    ohci_RegWrite(ctx->itc_Base.ic_Context.ctx_Unit,
-                  OHCI1394_REG_IXMIT_CONTEXT_CONTROL_SET(ctx->itc_Base.ic_Index),
-                  CTX_WAKE);
-}
+    LOCK_CTX(ctx);
+    {
+        /* Count bytes written from the start of the first page */
+        avail = 0;
+        buf = ctx->irc_FirstDMABuffer;
+        do
+        {
+            OHCI1394Descriptor *d = &buf->irb_Descriptors[0];
+            UWORD status = BE_SWAPWORD(d->d_TransferStatus);
+            ULONG filled;
 
-static BOOL ohci_ITContext_Stop(OHCI1394ITCtx *ctx)
-{
-    OHCI1394Unit *unit = ctx->itc_Base.ic_Context.ctx_Unit;
-    ULONG loop = 20;
-    ULONG index_mask = 1ul << ctx->itc_Base.ic_Index;
+            if (0 == status)
+            {
+                break;
+            }
 
-    /* Disable interruption line */
-    ohci_RegWrite(unit, OHCI1394_REG_ISO_XMIT_INT_MASK_CLEAR, index_mask);
+            if ((status & CTX_DEAD) ||
+                (((status & 0x1f) != OHCI1394_EVENT_ACK_COMPLETE) && ((status & 0x1f) != OHCI1394_EVENT_LONG_PACKET)))
+            {
+                _ERR_IRDMA_CTX(ctx, "Event error in IR context %u (stopped): $%02x-'%s'",
+                               ctx->irc_Base.ic_Index, status & 0x1f, evt_strings[status & 0x1f]);
+
+                ctx->irc_BatchCallback(NULL, 0, status & 0x1f, ctx->irc_UserData);
+                ohci_IRContext_RequestStop(ctx);
+                stopped = TRUE;
+                goto out;
+            }
+
+            filled = page_size - BE_SWAPWORD(d->d_ResCount);
+            avail += filled;
+            if (filled < page_size)
+            {
+                break;
+            }
+
+            buf = buf->irb_Next;
+        }
+        while (buf != ctx->irc_FirstDMABuffer);
+
+        /* Parse complete packets: header quadlet, payload (quadlet padded), trailer quadlet */
+        first = (ctx->irc_FirstDMABuffer - ctx->irc_AlignedDMABuffer) * page_size;
+        count = 0;
+        while ((ctx->irc_ReadOffset + 8) <= avail)
+        {
+            HeliosIRPacket *pkt;
+            ULONG offset = (first + ctx->irc_ReadOffset) % ring_size;
+            UBYTE *data = ring + offset;
+            QUADLET header, trailer;
+            ULONG length, size;
+
+            header = BE_SWAPLONG(*(QUADLET *)data);
+            length = header >> 16;
+            size = 8 + ((length + 3) & ~3);
+
+            if ((ctx->irc_ReadOffset + size) > avail)
+            {
+                break;
+            }
+
+            ctx->irc_ReadOffset += size;
+
+            /* Packet split between the last and the first page */
+            if ((offset + size) > ring_size)
+            {
+                if (size > OHCI1394_IR_MAX_PACKET)
+                {
+                    ATOMIC_ADD((LONG *)&ctx->irc_Base.ic_Context.ctx_Unit->hu_IRDrops, 1);
+                    continue;
+                }
+
+                CopyMem(data, ctx->irc_Bounce, ring_size - offset);
+                CopyMem(ring, ctx->irc_Bounce + ring_size - offset, size - (ring_size - offset));
+                data = ctx->irc_Bounce;
+            }
+
+            if ((0 == length) && ctx->irc_Flags.DropEmpty)
+            {
+                continue;
+            }
+
+            trailer = BE_SWAPLONG(*(QUADLET *)(data + size - 4));
+
+            pkt = &ctx->irc_Batch[count++];
+            pkt->Header = header;
+            pkt->Status = trailer >> 16;
+            pkt->TimeStamp = trailer;
+            pkt->Payload = data + 4;
+            pkt->PayloadLength = length;
+
+            if (OHCI1394_IR_BATCH_MAX == count)
+            {
+                ctx->irc_BatchCallback(ctx->irc_Batch, count,
+                    OHCI1394_EVENT_ACK_COMPLETE, ctx->irc_UserData);
+                count = 0;
+            }
+        }
+
+        if (count > 0)
+        {
+            ctx->irc_BatchCallback(ctx->irc_Batch, count,
+                OHCI1394_EVENT_ACK_COMPLETE, ctx->irc_UserData);
+        }
+
+        /* DMA program update phase: move fully parsed pages at the end of the program */
+        while (ctx->irc_ReadOffset >= page_size)
+        {
+            OHCI1394Descriptor *d;
+
+            buf = ctx->irc_FirstDMABuffer;
+            d = &buf->irb_Descriptors[0];
+
+            d->d_ResCount = d->d_ReqCount;
+            d->d_TransferStatus = 0;
+            d->d_BranchAddress &= BE_SWAPLONG_C(~15); /* Z=0 */
+            ctx->irc_LastDMABuffer->irb_Descriptors[0].d_BranchAddress |= BE_SWAPLONG_C(1); /* Z=1 */
+            ctx->irc_LastDMABuffer = buf;
+
+            ctx->irc_FirstDMABuffer = buf->irb_Next;
+            ctx->irc_ReadOffset -= page_size;
+            recycled = TRUE;
+        }
+
+        if (recycled)
+        {
+            ohci_IRContext_Wake(ctx);
+        }
+    }
+out:
+    UNLOCK_CTX(ctx);
+
+    if (stopped)
+    {
+        ohci_IRContext_WaitStopped(ctx);
+    }
+}
+
+
+static void ohci_ITContext_Run(OHCI1394ITCtx *ctx)
+{
+    _INFO_ITDMA_CTX(ctx, "[%u]: run (CmdPtr=$%08x)\n", ctx->itc_Base.ic_Index,
+                    ohci_RegRead(ctx->itc_Base.ic_Context.ctx_Unit, OHCI1394_REG_IXMIT_COMMAND_PTR(ctx->itc_Base.ic_Index)));
+
+    ohci_RegWrite(ctx->itc_Base.ic_Context.ctx_Unit,
+                  OHCI1394_REG_IXMIT_CONTEXT_CONTROL_SET(ctx->itc_Base.ic_Index),
+                  CTX_RUN);
+}
+
+static void ohci_ITContext_Wake(OHCI1394ITCtx *ctx)
+{
+    ohci_RegWrite(ctx->itc_Base.ic_Context.ctx_Unit,
+                  OHCI1394_REG_IXMIT_CONTEXT_CONTROL_SET(ctx->itc_Base.ic_Index),
+                  CTX_WAKE);
+}
+
+/* Request the DMA stop, without waiting: called with the context locked */
+static void ohci_ITContext_RequestStop(OHCI1394ITCtx *ctx)
+{
+    OHCI1394Unit *unit = ctx->itc_Base.ic_Context.ctx_Unit;
+
+    /* Disable interruption line */
+    ohci_RegWrite(unit, OHCI1394_REG_ISO_XMIT_INT_MASK_CLEAR, 1ul << ctx->itc_Base.ic_Index);
 
-    /* Request the DMA stop of context */
     ohci_RegWrite(unit, OHCI1394_REG_IXMIT_CONTEXT_CONTROL_CLEAR(ctx->itc_Base.ic_Index), CTX_RUN);
+}
+
+/* Wait about DMA safe state after a stop request.
+ * Sleeps: never called with the context locked.
+ */
+static BOOL ohci_ITContext_WaitStopped(OHCI1394ITCtx *ctx)
+{
+    OHCI1394Unit *unit = ctx->itc_Base.ic_Context.ctx_Unit;
+    ULONG loop = 20;
 
-    /* Wait about DMA safe state */
     do
     {
         QUADLET reg;
@@ -2127,6 +2538,8 @@ static BOOL ohci_ITContext_Stop(OHCI1394ITCtx *ctx)
         reg = ohci_RegRead(unit, OHCI1394_REG_IXMIT_CONTEXT_CONTROL(ctx->itc_Base.ic_Index));
         if (0 == (reg & CTX_ACTIVE))
         {
+            _INFO_ITDMA_CTX(ctx, "[%u]: stopped, packets=%lu, skips=%lu, underruns=%lu\n",
+                            ctx->itc_Base.ic_Index, ctx->itc_Packets, ctx->itc_Skips, ctx->itc_Underruns);
             return TRUE;
         }
 
@@ -2135,33 +2548,236 @@ static BOOL ohci_ITContext_Stop(OHCI1394ITCtx *ctx)
     }
     while (loop--);
 
-    /* Timeout */
-    _INFO_CTX(&ctx->itc_Base.ic_Context,
-              "TIMEOUT, IR context #%u still active 500ms after STOP request\n",
-              ctx->itc_Base.ic_Index);
-
+    _ERR_CTX(&ctx->itc_Base.ic_Context,
+             "TIMEOUT, IT context #%u still active 500ms after STOP request\n",
+             ctx->itc_Base.ic_Index);
     return FALSE;
 }
 
-static void ohci_IRContext_Append(OHCI1394IRCtx *ctx, ULONG cmd_ptr)
+static inline ULONG ohci_ITContext_GetPhyAddress(OHCI1394ITCtx *ctx, APTR ptr)
+{
+    return ctx->itc_PhyDMABuffer + (ptr - (APTR)ctx->itc_AlignedDMABuffer);
+}
+
+/* Build the descriptor block of a buffer from its HeliosITBuffer data.
+ * The block is built as the end of the DMA program (Z=0).
+ *
+ * Z = 1: skipped cycle, only one OUTPUT_LAST descriptor without data.
+ * Z = 2: OUTPUT_LAST_IMMEDIATE, iso header only.
+ * Z = 3: OUTPUT_MORE_IMMEDIATE + OUTPUT_LAST (CIP header or payload).
+ * Z = 4: OUTPUT_MORE_IMMEDIATE + OUTPUT_MORE (CIP header) + OUTPUT_LAST (payload).
+ *
+ * The skipAddress of the immediate descriptor points on the block itself,
+ * so a packet not sent in time (late cycle start) is sent on the next cycle.
+ */
+static void ohci_ITContext_FillBuffer(OHCI1394ITCtx *ctx, OHCI1394ITBuffer *buf)
+{
+    HeliosITBuffer *data = &buf->itb_BufferData;
+    OHCI1394Descriptor *d = buf->itb_Descriptors;
+    OHCI1394Descriptor *last_d;
+    ULONG d_phy_addr, length, z;
+
+    memset(d, 0, sizeof(buf->itb_Descriptors));
+    d_phy_addr = ohci_ITContext_GetPhyAddress(ctx, d);
+
+    if (data->Flags & HELIOS_ITBF_SKIP)
+    {
+        ctx->itc_Skips++;
+        last_d = &d[0];
+        z = 1;
+    }
+    else
+    {
+        length = MIN(data->PayloadLength, ctx->itc_PayloadSize);
+        z = 2;
+
+        /* Isochronous packet header */
+        d[0].d_Control = BE_SWAPWORD_C(DESCRIPTOR_KEY_IMMEDIATE);
+        d[0].d_ReqCount = BE_SWAPWORD_C(8);
+        last_d = &d[0];
+
+        if (ctx->itc_Flags.CIP)
+        {
+            buf->itb_CIP[0] = LE_SWAPLONG(data->CIP[0]);
+            buf->itb_CIP[1] = LE_SWAPLONG(data->CIP[1]);
+
+            last_d = &d[z++];
+            last_d->d_ReqCount = BE_SWAPWORD_C(8);
+            last_d->d_DataAddress = BE_SWAPLONG(ohci_ITContext_GetPhyAddress(ctx, buf->itb_CIP));
+            length += 8;
+        }
+
+        if (data->PayloadLength > 0)
+        {
+            last_d = &d[z++];
+            last_d->d_ReqCount = BE_SWAPWORD(length - (ctx->itc_Flags.CIP ? 8 : 0));
+            last_d->d_DataAddress = BE_SWAPLONG((ULONG)PCIXDMAGetPhysical(ctx->itc_Base.ic_Context.ctx_Unit->hu_PCI_BoardObject,
+                                                                          data->Payload));
+        }
+
+        ((QUADLET *)&d[1])[0] = BE_SWAPLONG(ctx->itc_IsoHeader | (data->Sy & 0xf));
+        ((QUADLET *)&d[1])[1] = BE_SWAPLONG(length << 16);
+
+        /* skipAddress */
+        d[0].d_BranchAddress = BE_SWAPLONG(d_phy_addr | z);
+    }
+
+    last_d->d_Control |= BE_SWAPWORD_C(DESCRIPTOR_OUTPUT_LAST |
+                                       DESCRIPTOR_STATUS |
+                                       DESCRIPTOR_IRQ_ALWAYS |
+                                       DESCRIPTOR_BRANCH_ALWAYS);
+    buf->itb_LastDescriptor = last_d;
+    buf->itb_Z = z;
+}
+
+/* Ask the user for the next packet of this buffer, then put it at the end of the DMA program */
+static void ohci_ITContext_Refill(OHCI1394ITCtx *ctx, OHCI1394ITBuffer *buf, ULONG status)
+{
+    HeliosITBuffer *data = &buf->itb_BufferData;
+    OHCI1394ITBuffer *prev = ctx->itc_LastDMABuffer;
+
+    data->PayloadLength = 0;
+    data->Flags = 0;
+    data->Underruns = ctx->itc_Underruns;
+
+    ctx->itc_Callback(data, status, ctx->itc_UserData);
+    ohci_ITContext_FillBuffer(ctx, buf);
+
+    /* Link the previous end of program to this one */
+    if (NULL != prev)
+    {
+        prev->itb_LastDescriptor->d_BranchAddress = BE_SWAPLONG(ohci_ITContext_GetPhyAddress(ctx, buf) | buf->itb_Z);
+    }
+
+    ctx->itc_LastDMABuffer = buf;
+}
+
+static void ohci_ITContext_Handler(OHCI1394Context *_ctx)
+{
+    OHCI1394ITCtx *ctx = (OHCI1394ITCtx *)_ctx;
+    OHCI1394Unit *unit = _ctx->ctx_Unit;
+    OHCI1394ITBuffer *buf, *last;
+    QUADLET ctrl;
+    ULONG count = 0;
+    BOOL stopped = FALSE;
+
+    /* Scan descriptor blocks from the oldest one given to the DMA.
+     *
+     * Each sent packet is refilled by the user callback and appended at the end
+     * of the DMA program, so the callback runs ahead of the DMA by the number
+     * of buffers of the context.
+     *
+     * The end of the program is never refilled: if the DMA has reached it,
+     * it's waiting on its branch address, set when the next block is appended.
+     * This case is an underrun: the DMA has sent all packets before the refill.
+     * As each refill moves itc_LastDMABuffer, the scan stops on the end
+     * of the program as it was before the scan.
+     */
+
+    LOCK_CTX(ctx);
+    {
+        ctrl = ohci_RegRead(unit, OHCI1394_REG_IXMIT_CONTEXT_CONTROL(ctx->itc_Base.ic_Index));
+        if (0 == (ctrl & CTX_RUN))
+        {
+            goto out;
+        }
+
+        last = ctx->itc_LastDMABuffer;
+        for (buf = ctx->itc_FirstDMABuffer;
+             (buf != last) && (0 != buf->itb_LastDescriptor->d_TransferStatus);
+             buf = buf->itb_Next)
+        {
+            ULONG status = BE_SWAPWORD(buf->itb_LastDescriptor->d_TransferStatus);
+            ULONG event = status & 0x1f;
+
+            if ((0 != (ctrl & CTX_DEAD)) ||
+                (OHCI1394_EVENT_DESCRIPTOR_READ == event) ||
+                (OHCI1394_EVENT_DATA_READ == event) ||
+                (OHCI1394_EVENT_TIMEOUT == event) ||
+                (OHCI1394_EVENT_TCODE_ERR == event) ||
+                (OHCI1394_EVENT_UNKNOWN == event))
+            {
+                _ERR_ITDMA_CTX(ctx, "Event error in IT context %u (stopped): $%02x-'%s'",
+                               ctx->itc_Base.ic_Index, event, evt_strings[event]);
+
+                buf->itb_BufferData.PayloadLength = 0;
+                ctx->itc_Callback(&buf->itb_BufferData, event, ctx->itc_UserData);
+
+                ohci_ITContext_RequestStop(ctx);
+                stopped = TRUE;
+                goto out;
+            }
+
+            buf->itb_BufferData.TimeStamp = BE_SWAPWORD(buf->itb_LastDescriptor->d_TimeStamp);
+            ctx->itc_Packets++;
+            count++;
+
+            ohci_ITContext_Refill(ctx, buf, event);
+        }
+
+        ctx->itc_FirstDMABuffer = buf;
+
+        if (count > 0)
+        {
+            /* The DMA stops on the end of the program only if it has been reached */
+            if (0 == (ctrl & CTX_ACTIVE))
+            {
+                ctx->itc_Underruns++;
+                _ERR_ITDMA_CTX(ctx, "IT #%u underrun (%lu)\n", ctx->itc_Base.ic_Index, ctx->itc_Underruns);
+            }
+
+            ohci_ITContext_Wake(ctx);
+        }
+    }
+out:
+    UNLOCK_CTX(ctx);
+
+    if (stopped)
+    {
+        ohci_ITContext_WaitStopped(ctx);
+    }
+}
+
+/* FALSE if the context is multichannel and another one already is */
+static BOOL ohci_IRContext_Append(OHCI1394IRCtx *ctx, ULONG cmd_ptr, ULONG z)
 {
     OHCI1394Unit *unit = ctx->irc_Base.ic_Context.ctx_Unit;
+    OHCI1394IRCtx *ir_ctx;
+    BOOL added = TRUE;
 
     LOCK_REGION(unit);
     {
-        /* Clear the iso context config */
-        _INFO_IRDMA_CTX(ctx, "[%u]: Clearing context %p CTRL\n", ctx->irc_Base.ic_Index);
-        ohci_RegWrite(unit, OHCI1394_REG_IRECV_CONTEXT_CONTROL_CLEAR(ctx->irc_Base.ic_Index), ~0);
+        /* Only one IR context can use the multichannel mask */
+        if (ctx->irc_Flags.MultiChannel)
+        {
+            ForeachNode(&unit->hu_IRCtxList, ir_ctx)
+            {
+                if (ir_ctx->irc_Flags.MultiChannel)
+                {
+                    added = FALSE;
+                    break;
+                }
+            }
+        }
 
-        /* Setup the Iso CommandPtr register on the first descriptor */
-        _INFO_IRDMA_CTX(ctx, "[%u]: Setting CommandPtr of context %p with value $%08x\n",
-                        ctx->irc_Base.ic_Index, cmd_ptr | 2);
-        ohci_RegWrite(unit, OHCI1394_REG_IRECV_COMMAND_PTR(ctx->irc_Base.ic_Index), cmd_ptr | 2);
+        if (added)
+        {
+            /* Clear the iso context config */
+            _INFO_IRDMA_CTX(ctx, "[%u]: Clearing context %p CTRL\n", ctx->irc_Base.ic_Index);
+            ohci_RegWrite(unit, OHCI1394_REG_IRECV_CONTEXT_CONTROL_CLEAR(ctx->irc_Base.ic_Index), ~0);
 
-        /* Register to unit */
-        ADDHEAD(&unit->hu_IRCtxList, ctx);
+            /* Setup the Iso CommandPtr register on the first descriptor */
+            _INFO_IRDMA_CTX(ctx, "[%u]: Setting CommandPtr of context %p with value $%08x\n",
+                            ctx->irc_Base.ic_Index, cmd_ptr | z);
+            ohci_RegWrite(unit, OHCI1394_REG_IRECV_COMMAND_PTR(ctx->irc_Base.ic_Index), cmd_ptr | z);
+
+            /* Register to unit */
+            ADDHEAD(&unit->hu_IRCtxList, ctx);
+        }
     }
     UNLOCK_REGION(unit);
+
+    return added;
 }
 
 
@@ -2422,6 +3038,7 @@ static void ohci_HandleSelfIDComplete(OHCI1394Unit *unit)
 
         Helios_ReportMsg(HRMB_INFO, "OHCI", "<Bus-Reset> [Unit#%u], gen=%lu, local ID=%lu",
                          unit->hu_UnitNo, gen, nodeid);
+        TRACE(&unit->hu_Trace, HTP_BUSRESET_SELFID, gen, nodeid, packets_nbr);
 
         /* Stop AT contexts (see OHCI 1.1  7.2.3.2) before clearing the BusReset signal */
         ohci_ATContexts_Stop(unit);
@@ -2574,6 +3191,276 @@ out:
     FreeSignal(signal);
 }
 
+/* Handle all AT/AR and iso events recorded by the IRQ handler.
+ * Returns FALSE if events remain after IRQ_BUDGET rounds.
+ */
+static BOOL ohci_IRQ_HandlePending(OHCI1394Unit *unit)
+{
+    ULONG round;
+
+    for (round=0; round < IRQ_BUDGET; round++)
+    {
+        ULONG events, ir_events, it_events;
+
+        events = ATOMIC_FETCH(&unit->hu_IRQPending);
+        ir_events = ATOMIC_FETCH(&unit->hu_IRQPendingIR);
+        it_events = ATOMIC_FETCH(&unit->hu_IRQPendingIT);
+        if (0 == (events | ir_events | it_events))
+        {
+            return TRUE;
+        }
+
+        ATOMIC_AND(&unit->hu_IRQPending, ~events);
+        ATOMIC_AND(&unit->hu_IRQPendingIR, ~ir_events);
+        ATOMIC_AND(&unit->hu_IRQPendingIT, ~it_events);
+
+        TRACE(&unit->hu_Trace, HTP_IRQ_HANDLER, 0, events, 0);
+
+        if (events & OHCI1394_INTF_REQTXCOMPLETE)
+        {
+            unit->hu_IRQStats.is_ATRequest++;
+            unit->hu_ATRequestCtx.atc_Context.ctx_Handler(&unit->hu_ATRequestCtx.atc_Context);
+        }
+        if (events & OHCI1394_INTF_RESPTXCOMPLETE)
+        {
+            unit->hu_IRQStats.is_ATResponse++;
+            unit->hu_ATResponseCtx.atc_Context.ctx_Handler(&unit->hu_ATResponseCtx.atc_Context);
+        }
+        if (events & OHCI1394_INTF_RQPKT)
+        {
+            unit->hu_IRQStats.is_ARRequest++;
+            unit->hu_ARRequestCtx.arc_Context.ctx_Handler(&unit->hu_ARRequestCtx.arc_Context);
+        }
+        if (events & OHCI1394_INTF_RSPKT)
+        {
+            unit->hu_IRQStats.is_ARResponse++;
+            unit->hu_ARResponseCtx.arc_Context.ctx_Handler(&unit->hu_ARResponseCtx.arc_Context);
+        }
+
+        /* Iso contexts run user callbacks at their own priority: just wake them */
+        if (0 != (ir_events | it_events))
+        {
+            LOCK_REGION_SHARED(unit);
+            {
+                if (0 != ir_events)
+                {
+                    unit->hu_IRQStats.is_IsoRecv += utils_CountBits32(ir_events, 1);
+                    ohci_CheckAndScheduleIsoList(&unit->hu_IRCtxList, ir_events);
+                }
+                if (0 != it_events)
+                {
+                    unit->hu_IRQStats.is_IsoXmit += utils_CountBits32(it_events, 1);
+                    ohci_CheckAndScheduleIsoList(&unit->hu_ITCtxList, it_events);
+                }
+            }
+            UNLOCK_REGION_SHARED(unit);
+        }
+
+        unit->hu_IRQStats.is_Events += utils_CountBits32(events & ~(OHCI1394_INTF_ISOCHRX | OHCI1394_INTF_ISOCHTX), 1)
+            + utils_CountBits32(ir_events, 1) + utils_CountBits32(it_events, 1);
+    }
+
+    unit->hu_IRQStats.is_BudgetExhausted++;
+    return FALSE;
+}
+
+static void ohci_IRQ_Unmask(OHCI1394Unit *unit, struct timerequest *tr, struct timeval *last)
+{
+    struct Library *TimerBase = (struct Library *)tr->tr_node.io_Device;
+
+    GetSysTime(last);
+
+    if (unit->hu_Flags.Enabled)
+    {
+        ohci_RegWrite(unit, OHCI1394_REG_INT_MASK_SET, IRQ_DEFERRED_EVENTS);
+    }
+}
+
+/* Interrupts ceiling: the IRQ handler has masked deferred events, they are
+ * unmasked one interrupt period after the previous unmask. Before, the timer
+ * is armed for the remaining time and the task keeps waiting its signals.
+ * Events raised meanwhile are pending in the controller and raise an IRQ once unmasked.
+ * Returns TRUE if the unmask is delayed to the timer reply.
+ */
+static BOOL ohci_IRQ_Throttle(OHCI1394Unit *unit, struct timerequest *tr, struct timeval *last)
+{
+    struct Library *TimerBase = (struct Library *)tr->tr_node.io_Device;
+    struct timeval now;
+    ULONG rate, period, elapsed;
+
+    rate = unit->hu_IRQMaxRate;
+    if (0 != rate)
+    {
+        period = 1000000 / rate;
+
+        GetSysTime(&now);
+        if ((now.tv_secs - last->tv_secs) > 1)
+        {
+            elapsed = period;
+        }
+        else
+        {
+            elapsed = (now.tv_secs - last->tv_secs) * 1000000 + now.tv_micro - last->tv_micro;
+        }
+
+        if (elapsed < period)
+        {
+            unit->hu_IRQStats.is_Throttled++;
+
+            tr->tr_node.io_Command = TR_ADDREQUEST;
+            tr->tr_time.tv_secs = 0;
+            tr->tr_time.tv_micro = period - elapsed;
+            SendIO(&tr->tr_node);
+
+            return TRUE;
+        }
+    }
+
+    ohci_IRQ_Unmask(unit, tr, last);
+    return FALSE;
+}
+
+static void ohci_IRQTask(HeliosSubTask *self, struct TagItem *tags)
+{
+    OHCI1394Unit *unit;
+    struct MsgPort *taskport, *timerport;
+    struct timerequest *tr;
+    struct timeval last = {0, 0};
+    ULONG signal, sigset;
+    BOOL delayed = FALSE;
+
+    taskport = (APTR) GetTagData(HA_MsgPort, 0, tags);
+    unit = (APTR) GetTagData(HA_UserData, 0, tags);
+
+    if ((NULL == taskport) || (NULL == unit))
+    {
+        _ERR("Invalid parameters (msgport=%p, unit=%p)\n", taskport, unit);
+        return;
+    }
+
+    _INFO_UNIT(unit, "MsgPort @ %p\n", taskport);
+
+    timerport = CreateMsgPort();
+    if (NULL == timerport)
+    {
+        _ERR_UNIT(unit, "failed to create the IRQ TimerPort\n");
+        return;
+    }
+
+    tr = Helios_OpenTimer(timerport, UNIT_MICROHZ);
+    if (NULL == tr)
+    {
+        _ERR_UNIT(unit, "Failed to open IRQ timer ioreq\n");
+        DeleteMsgPort(timerport);
+        return;
+    }
+
+    signal = AllocSignal(-1);
+    if (~0U == signal)
+    {
+        _ERR("AllocSignal(-1) failed\n");
+        Helios_CloseTimer(tr);
+        DeleteMsgPort(timerport);
+        return;
+    }
+
+    unit->hu_IRQSignal = 1 << signal;
+    Helios_TaskReady(self, TRUE);
+
+    sigset = unit->hu_IRQSignal | (1ul << timerport->mp_SigBit) | (1 << taskport->mp_SigBit);
+    for (;;)
+    {
+        HeliosMsg *msg;
+        ULONG sigs;
+
+        sigs = Wait(sigset);
+
+        if (sigs & (1 << taskport->mp_SigBit))
+        {
+            while (NULL != (msg = (APTR) GetMsg(taskport)))
+            {
+                switch (msg->hm_Type)
+                {
+                    case HELIOS_MSGTYPE_TASKKILL:
+                        ReplyMsg((struct Message *) msg);
+                        goto out;
+                }
+
+                ReplyMsg((struct Message *) msg);
+            }
+        }
+
+        /* Interrupt period elapsed */
+        if ((sigs & (1ul << timerport->mp_SigBit)) && (NULL != GetMsg(timerport)))
+        {
+            delayed = FALSE;
+            ohci_IRQ_Unmask(unit, tr, &last);
+        }
+
+        if (sigs & unit->hu_IRQSignal)
+        {
+            unit->hu_IRQStats.is_HandlerRuns++;
+
+            /* Budget exhausted: let other tasks run, then continue */
+            if (!ohci_IRQ_HandlePending(unit))
+            {
+                Signal(FindTask(NULL), unit->hu_IRQSignal);
+            }
+
+            /* A delayed unmask is done by the timer reply */
+            if (!delayed)
+            {
+                delayed = ohci_IRQ_Throttle(unit, tr, &last);
+            }
+        }
+    }
+
+out:
+    if (delayed)
+    {
+        AbortIO(&tr->tr_node);
+        WaitIO(&tr->tr_node);
+    }
+
+    Helios_CloseTimer(tr);
+    DeleteMsgPort(timerport);
+    FreeSignal(signal);
+}
+
+static BOOL ohci_IRQTask_Init(OHCI1394Unit *unit)
+{
+    unit->hu_IRQTask = Helios_CreateSubTask("["DEVNAME"] IRQ handler",
+                                            ohci_IRQTask,
+                                            HA_Pool, (ULONG)unit->hu_MemPool,
+                                            TASKTAG_PRI, TASK_PRIO_IRQ,
+                                            HA_UserData, (ULONG)unit,
+                                            TAG_DONE);
+    if (NULL == unit->hu_IRQTask)
+    {
+        _ERR_UNIT(unit, "IRQ task creation failed\n");
+        return FALSE;
+    }
+
+    if (0 != Helios_WaitTaskReady(unit->hu_IRQTask, SIGBREAKF_CTRL_E))
+    {
+        _ERR_UNIT(unit, "TaskReady not received from IRQ task\n");
+        Helios_KillSubTask(unit->hu_IRQTask);
+        unit->hu_IRQTask = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void ohci_IRQTask_Term(OHCI1394Unit *unit)
+{
+    if (NULL != unit->hu_IRQTask)
+    {
+        Helios_KillSubTask(unit->hu_IRQTask);
+        unit->hu_IRQTask = NULL;
+    }
+}
+
 static BOOL ohci_SoftReset(OHCI1394Unit *unit)
 {
     ULONG loop = MAXLOOP;
@@ -2627,11 +3514,15 @@ static void ohci_EnableInterrupts(OHCI1394Unit *unit)
                   | OHCI1394_INTF_ISOCHRX);
 }
 
+/* Turn the SPLIT-TIMEOUT wheel: one timer request per tick,
+ * started by hu_SplitTimeoutSignal and stopped when the wheel is empty.
+ */
 static void ohci_SplitTimeoutTask(HeliosSubTask *self, struct TagItem *tags)
 {
     OHCI1394Unit *unit;
     struct MsgPort *taskport;
-    ULONG sigset;
+    ULONG signal, sigset;
+    BOOL ticking = FALSE;
 
     taskport = (APTR) GetTagData(HA_MsgPort, 0, tags);
     unit = (APTR) GetTagData(HA_UserData, 0, tags);
@@ -2644,10 +3535,18 @@ static void ohci_SplitTimeoutTask(HeliosSubTask *self, struct TagItem *tags)
 
     _INFO_UNIT(unit, "MsgPort @ %p\n", taskport);
 
+    signal = AllocSignal(-1);
+    if (~0U == signal)
+    {
+        _ERR("AllocSignal(-1) failed\n");
+        return;
+    }
+
     unit->hu_TimerPort = CreateMsgPort();
     if (NULL == unit->hu_TimerPort)
     {
         _ERR_UNIT(unit, "failed to create the unit SPLIT-TIMEOUT TimerPort\n");
+        FreeSignal(signal);
         return;
     }
 
@@ -2656,12 +3555,14 @@ static void ohci_SplitTimeoutTask(HeliosSubTask *self, struct TagItem *tags)
     {
         _ERR_UNIT(unit, "Failed to open SPLIT-TIMEOUT ioreq\n");
         DeleteMsgPort(unit->hu_TimerPort);
+        FreeSignal(signal);
         return;
     }
 
+    unit->hu_SplitTimeoutSignal = 1ul << signal;
     Helios_TaskReady(self, TRUE);
 
-    sigset = (1ul << unit->hu_TimerPort->mp_SigBit) | (1 << taskport->mp_SigBit);
+    sigset = unit->hu_SplitTimeoutSignal | (1ul << unit->hu_TimerPort->mp_SigBit) | (1 << taskport->mp_SigBit);
     for (;;)
     {
         HeliosMsg *msg;
@@ -2684,28 +3585,36 @@ static void ohci_SplitTimeoutTask(HeliosSubTask *self, struct TagItem *tags)
             }
         }
 
-        if (sigs & (1ul << unit->hu_TimerPort->mp_SigBit))
+        if ((sigs & (1ul << unit->hu_TimerPort->mp_SigBit)) && (NULL != GetMsg(unit->hu_TimerPort)))
         {
-            OHCI1394SplitTimeReq *req;
-
-            LOCK_REGION(unit);
+            ticking = ohci_TL_SplitTimeoutTick(unit);
+            if (ticking)
             {
-                while (NULL != (req = (OHCI1394SplitTimeReq *) GetMsg(unit->hu_TimerPort)))
-                {
-                    if (NULL != req->transaction)
-                    {
-                        ohci_TL_Finish(unit, req->transaction, HELIOS_RCODE_TIMEOUT);
-                    }
-                    FreePooled(unit->hu_MemPool, req, sizeof(OHCI1394SplitTimeReq));
-                }
+                SendIO(&unit->hu_SplitTimeoutIOReq->tr_node);
             }
-            UNLOCK_REGION(unit);
+        }
+
+        /* First timer armed in an empty wheel */
+        if ((sigs & unit->hu_SplitTimeoutSignal) && !ticking)
+        {
+            unit->hu_SplitTimeoutIOReq->tr_node.io_Command = TR_ADDREQUEST;
+            unit->hu_SplitTimeoutIOReq->tr_time.tv_secs = 0;
+            unit->hu_SplitTimeoutIOReq->tr_time.tv_micro = SPLIT_WHEEL_TICK_US;
+            SendIO(&unit->hu_SplitTimeoutIOReq->tr_node);
+            ticking = TRUE;
         }
     }
 
 out:
+    if (ticking)
+    {
+        AbortIO(&unit->hu_SplitTimeoutIOReq->tr_node);
+        WaitIO(&unit->hu_SplitTimeoutIOReq->tr_node);
+    }
+
     Helios_CloseTimer(unit->hu_SplitTimeoutIOReq);
     DeleteMsgPort(unit->hu_TimerPort);
+    FreeSignal(signal);
 }
 
 static void ohci_remove_devices(OHCI1394Unit *unit)
@@ -2728,6 +3637,12 @@ UWORD ohci_GetTimeStamp(OHCI1394Unit *unit)
     return ohci_RegRead(unit, OHCI1394_REG_ISOCHRONOUS_CYCLE_TIMER) >> 12;
 }
 
+/* Raw cycle timer (seconds:7, cycles:13, offset:12) */
+ULONG ohci_CycleTimer(OHCI1394Unit *unit)
+{
+    return ohci_RegRead(unit, OHCI1394_REG_ISOCHRONOUS_CYCLE_TIMER);
+}
+
 /* atomic (only if the task is not delayed more than 1 seconds per register read) */
 UQUAD ohci_UpTime(OHCI1394Unit *unit)
 {
@@ -2784,39 +3699,21 @@ UWORD ohci_ComputeResponseTimeStamp(UWORD req_timestamp, UWORD offset)
     return timestamp;
 }
 
-/* Put an ohci raw packet on the given AT ctx.
- * optional parameters:
- * timestamp: (resp. packet only) indicate the packet timeout.
- * tlabel: (req. packet only) overwrite the tlabel data into the packet.
+/* Fill descriptors of the given AT buffer with an ohci raw packet.
+ * Returns the number of used descriptors (Z value), or 0 if the packet
+ * can't be sent by an AT context.
  */
-LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
-                         QUADLET *payload, OHCI1394ATPacketData *pdata,
-                         UBYTE tlabel, UWORD timestamp)
+static UBYTE ohci_ATContext_FillBuffer(OHCI1394Unit *unit, OHCI1394ATBuffer *buffer,
+                                       QUADLET *p, QUADLET *payload,
+                                       OHCI1394ATPacketData *pdata,
+                                       UBYTE tlabel, UWORD timestamp)
 {
-    OHCI1394Unit *unit = ctx->atc_Context.ctx_Unit;
-    OHCI1394ATBuffer *buffer;
     OHCI1394Descriptor *d, *last_d;
     QUADLET p0;
     UBYTE z, hl, tcode;
     ULONG length;
-    LONG err;
     BOOL request;
 
-    _INFO_CTX(ctx, "gen=%u, p=$%p, tl=$%x, ts=$%x, pdata=%p\n",
-              generation, p, tlabel, timestamp, pdata);
-
-    tcode = AT_GET_HEADER_TCODE(p[0]);
-
-    /* outdated packet ? */
-    if ((tcode != TCODE_WRITE_PHY) &&
-        ((generation != unit->hu_OHCI_LastGeneration) ||
-         (OHCI1394_INTF_BUSRESET & ohci_RegRead(unit, OHCI1394_REG_INT_EVENT_CLEAR))))
-    {
-        /* Simulate a flush after busreset */
-        pdata->pd_AckCallback(unit, HELIOS_RCODE_GENERATION, 0, pdata);
-        return HHIOERR_NO_ERROR;
-    }
-
     /* To build the DMA descriptor block we'll arrange
      * a couple of DMA descriptors like this:
      * Our transaction layer built packets with an header of 3, 4 or
@@ -2840,19 +3737,7 @@ LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
      * That's the reason of all BE_SWAPxxx macros.
      */
 
-    LOCK_CTX(ctx);
-    {
-        buffer = ohci_ATContext_GetBuffer(ctx);
-        _INFO_CTX(ctx, "buffer: $%p %p-%p\n", buffer);
-    }
-    UNLOCK_CTX(ctx);
-
-    if (NULL == buffer)
-    {
-        _ERR_CTX(ctx, "no free buffers\n");
-        return IOERR_UNITBUSY;
-    }
-
+    tcode = AT_GET_HEADER_TCODE(p[0]);
     length = 0;
     switch (tcode)
     {
@@ -2932,12 +3817,7 @@ LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
             break;
 
         default: /* not the responsability of this function */
-            LOCK_CTX(ctx);
-            ohci_ATContext_ReleaseBuffer(ctx, buffer);
-            UNLOCK_CTX(ctx);
-
-            pdata->pd_AckCallback(unit, HELIOS_ACK_TYPE_ERROR, 0, pdata);
-            return HHIOERR_NO_ERROR;
+            return 0;
     }
 
     /* z = number of needed descriptors
@@ -3018,9 +3898,69 @@ LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
                                        DESCRIPTOR_BRANCH_ALWAYS);
     buffer->atb_LastDescriptor = last_d;
 
-    /* buffer / pdata dual link */
-    pdata->pd_Buffer = buffer;
-    buffer->atb_PacketData = pdata;
+    /* buffer / pdata dual link */
+    pdata->pd_Buffer = buffer;
+    buffer->atb_PacketData = pdata;
+
+    return z;
+}
+
+/* Put an ohci raw packet on the given AT ctx.
+ * optional parameters:
+ * timestamp: (resp. packet only) indicate the packet timeout.
+ * tlabel: (req. packet only) overwrite the tlabel data into the packet.
+ */
+LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
+                         QUADLET *payload, OHCI1394ATPacketData *pdata,
+                         UBYTE tlabel, UWORD timestamp)
+{
+    OHCI1394Unit *unit = ctx->atc_Context.ctx_Unit;
+    OHCI1394ATBuffer *buffer;
+    UBYTE z, tcode;
+    LONG err;
+
+    _INFO_CTX(ctx, "gen=%u, p=$%p, tl=$%x, ts=$%x, pdata=%p\n",
+              generation, p, tlabel, timestamp, pdata);
+
+    tcode = AT_GET_HEADER_TCODE(p[0]);
+
+    /* outdated packet ? */
+    if ((tcode != TCODE_WRITE_PHY) &&
+        ((generation != unit->hu_OHCI_LastGeneration) ||
+         (OHCI1394_INTF_BUSRESET & ohci_RegRead(unit, OHCI1394_REG_INT_EVENT_CLEAR))))
+    {
+        TRACE(&unit->hu_Trace, HTP_AT_DROP, HELIOS_RCODE_GENERATION, p[0], pdata);
+        STAT_INC(unit, hs_ATGenerationDrops);
+
+        /* Simulate a flush after busreset */
+        pdata->pd_AckCallback(unit, HELIOS_RCODE_GENERATION, 0, pdata);
+        return HHIOERR_NO_ERROR;
+    }
+
+    LOCK_CTX(ctx);
+    {
+        buffer = ohci_ATContext_GetBuffer(ctx);
+        _INFO_CTX(ctx, "buffer: $%p %p-%p\n", buffer);
+    }
+    UNLOCK_CTX(ctx);
+
+    if (NULL == buffer)
+    {
+        _ERR_CTX(ctx, "no free buffers\n");
+        TRACE(&unit->hu_Trace, HTP_AT_DROP, HELIOS_RCODE_BUSY, p[0], pdata);
+        return IOERR_UNITBUSY;
+    }
+
+    z = ohci_ATContext_FillBuffer(unit, buffer, p, payload, pdata, tlabel, timestamp);
+    if (0 == z)
+    {
+        LOCK_CTX(ctx);
+        ohci_ATContext_ReleaseBuffer(ctx, buffer);
+        UNLOCK_CTX(ctx);
+
+        pdata->pd_AckCallback(unit, HELIOS_ACK_TYPE_ERROR, 0, pdata);
+        return HHIOERR_NO_ERROR;
+    }
 
     /* Lock the unit to be sure to not send during a bus-reset */
     LOCK_REGION_SHARED(unit);
@@ -3042,6 +3982,8 @@ LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
                  * (the transaction can't be cancelled here as the application doesn't
                  * know that it's sent or not).
                  */
+                TRACE(&unit->hu_Trace, HTP_AT_DROP, HELIOS_RCODE_GENERATION, p[0], pdata);
+                STAT_INC(unit, hs_ATGenerationDrops);
                 pdata->pd_AckCallback(unit, HELIOS_RCODE_GENERATION, 0, pdata);
 
                 return HHIOERR_NO_ERROR;
@@ -3052,6 +3994,12 @@ LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
                 {
                     /* Append the descriptor block at the end of the current context program */
                     ohci_ATContext_AppendBuffer(ctx, buffer, z);
+                    TRACE(&unit->hu_Trace, HTP_AT_SEND, tlabel, p[0], pdata);
+                    if (CAPTURE_ENABLED(&unit->hu_Capture))
+                    {
+                        ohci_ATContext_Capture(unit, buffer, HCAPTURE_AT_SEND, 0, 0, payload);
+                    }
+                    ohci_ATContext_Wake(ctx);
 
                     /* And finish by running the context if not done yet */
                     ohci_ATContext_Run(ctx);
@@ -3075,6 +4023,139 @@ LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
     return err;
 }
 
+/* Vectored version of ohci_ATContext_Send().
+ * Packets are chained into the AT program under one context lock
+ * and the DMA is woken up once per batch of OHCI1394_AT_BATCH_MAX packets.
+ * Each packet is consumed: linked into the DMA program, or completed
+ * through its ack callback (generation, no free DMA buffer, unit disabled
+ * or tcode not supported).
+ * Returns the number of packets linked into the DMA program.
+ */
+ULONG ohci_ATContext_SendV(OHCI1394ATCtx *ctx, UBYTE generation,
+                           OHCI1394ATSendVec *vec, ULONG count)
+{
+    OHCI1394Unit *unit = ctx->atc_Context.ctx_Unit;
+    OHCI1394ATBuffer *buffers[OHCI1394_AT_BATCH_MAX];
+    UBYTE z[OHCI1394_AT_BATCH_MAX];
+    BYTE status[OHCI1394_AT_BATCH_MAX];
+    ULONG i, n, avail, linked, sent = 0;
+
+    _INFO_CTX(ctx, "gen=%u, vec=$%p, count=%lu\n", generation, vec, count);
+
+    for (; count > 0; vec += n, count -= n)
+    {
+        BOOL outdated;
+
+        n = MIN(count, OHCI1394_AT_BATCH_MAX);
+
+        /* Reserve DMA buffers of the whole batch */
+        LOCK_CTX(ctx);
+        {
+            avail = MIN(n, ctx->atc_BufferUsage);
+            for (i=0; i < avail; i++)
+            {
+                buffers[i] = ohci_ATContext_GetBuffer(ctx);
+            }
+        }
+        UNLOCK_CTX(ctx);
+
+        if (avail < n)
+        {
+            _ERR_CTX(ctx, "only %lu free buffers for %lu packets\n", avail, n);
+        }
+
+        /* Build descriptors outside locks */
+        for (i=0; i < n; i++)
+        {
+            status[i] = HELIOS_ACK_NOTSET;
+
+            if (i >= avail)
+            {
+                buffers[i] = NULL;
+                status[i] = HELIOS_RCODE_BUSY;
+                continue;
+            }
+
+            z[i] = ohci_ATContext_FillBuffer(unit, buffers[i], vec[i].sv_Header, vec[i].sv_Payload,
+                                             vec[i].sv_PacketData, vec[i].sv_TLabel, vec[i].sv_TimeStamp);
+            if (0 == z[i])
+            {
+                status[i] = HELIOS_ACK_TYPE_ERROR;
+            }
+        }
+
+        /* Lock the unit to be sure to not send during a bus-reset */
+        linked = 0;
+        LOCK_REGION_SHARED(unit);
+        {
+            outdated = (generation != unit->hu_OHCI_LastGeneration)
+                || (OHCI1394_INTF_BUSRESET & ohci_RegRead(unit, OHCI1394_REG_INT_EVENT_CLEAR));
+
+            LOCK_CTX(ctx);
+            {
+                for (i=0; i < avail; i++)
+                {
+                    if (HELIOS_ACK_NOTSET == status[i])
+                    {
+                        if (!unit->hu_Flags.Enabled)
+                        {
+                            status[i] = HELIOS_RCODE_SEND_ERROR;
+                        }
+                        else if (outdated && (TCODE_WRITE_PHY != AT_GET_HEADER_TCODE(vec[i].sv_Header[0])))
+                        {
+                            status[i] = HELIOS_RCODE_GENERATION;
+                        }
+                        else
+                        {
+                            /* Append the descriptor block at the end of the current context program */
+                            ohci_ATContext_AppendBuffer(ctx, buffers[i], z[i]);
+                            TRACE(&unit->hu_Trace, HTP_AT_SEND, vec[i].sv_TLabel,
+                                  vec[i].sv_Header[0], vec[i].sv_PacketData);
+                            if (CAPTURE_ENABLED(&unit->hu_Capture))
+                            {
+                                ohci_ATContext_Capture(unit, buffers[i], HCAPTURE_AT_SEND, 0, 0,
+                                                       vec[i].sv_Payload);
+                            }
+                            linked++;
+                            continue;
+                        }
+                    }
+
+                    ohci_ATContext_ReleaseBuffer(ctx, buffers[i]);
+                }
+
+                /* One wake-up for the whole batch, then run the context if not done yet */
+                if (linked > 0)
+                {
+                    ohci_ATContext_Wake(ctx);
+                    ohci_ATContext_Run(ctx);
+                }
+            }
+            UNLOCK_CTX(ctx);
+        }
+        UNLOCK_REGION_SHARED(unit);
+
+        sent += linked;
+
+        /* calling the ack callback max use an exclusive lock on unit */
+        for (i=0; i < n; i++)
+        {
+            if (HELIOS_ACK_NOTSET != status[i])
+            {
+                TRACE(&unit->hu_Trace, HTP_AT_DROP, (UBYTE)status[i],
+                      vec[i].sv_Header[0], vec[i].sv_PacketData);
+                if (HELIOS_RCODE_GENERATION == status[i])
+                {
+                    STAT_INC(unit, hs_ATGenerationDrops);
+                }
+                vec[i].sv_PacketData->pd_AckCallback(unit, status[i], 0, vec[i].sv_PacketData);
+            }
+        }
+    }
+
+    return sent;
+}
+
 LONG ohci_SendPHYPacket(OHCI1394Unit *unit, HeliosSpeed speed, QUADLET phy_data,
                         OHCI1394ATPacketData *pdata)
 {
@@ -3179,6 +4260,34 @@ void ohci_HandleLocalRequest(OHCI1394Unit *unit,
     }
 }
 
+/* Transform an AT DMA event into an ack or a response code */
+BYTE ohci_ATEventStatus(UBYTE event)
+{
+    switch (event)
+    {
+        case OHCI1394_EVENT_MISSING_ACK: /* Packet transmitted -> BusReset before any ack */
+            return HELIOS_RCODE_MISSING_ACK;
+
+        case OHCI1394_EVENT_FLUSHED:     /* Packet not transmitted (but in DMA-FIFO) -> BusReset */
+            return HELIOS_RCODE_GENERATION;
+
+        case OHCI1394_EVENT_TIMEOUT:     /* Response timeout expired, Packet not transmitted */
+            return HELIOS_RCODE_CANCELLED;
+
+        case HELIOS_ACK_COMPLETE + 0x10:
+        case HELIOS_ACK_PENDING + 0x10:
+        case HELIOS_ACK_BUSY_X + 0x10:
+        case HELIOS_ACK_BUSY_A + 0x10:
+        case HELIOS_ACK_BUSY_B + 0x10:
+        case HELIOS_ACK_DATA_ERROR + 0x10:
+        case HELIOS_ACK_TYPE_ERROR + 0x10:
+            return event - 0x10;
+
+        default:
+            return HELIOS_RCODE_SEND_ERROR;
+    }
+}
+
 void ohci_CancelATPacket(OHCI1394Unit *unit, OHCI1394ATPacketData *pdata)
 {
     LOCK_REGION(unit);
@@ -3193,6 +4302,66 @@ void ohci_CancelATPacket(OHCI1394Unit *unit, OHCI1394ATPacketData *pdata)
     UNLOCK_REGION(unit);
 }
 
+/* Borrow the AR request page containing the given payload, until released by
+ * ohci_ARContext_ReleasePayload(). Returns the payload address to give.
+ * Only the first page is held: pages are recycled in order, so the next one
+ * (or the spare page after a ring split) stays valid as long as this one.
+ * An empty payload, or one not in the AR request pages, is given unchanged
+ * and not held.
+ */
+QUADLET *ohci_ARContext_HoldPayload(OHCI1394Unit *unit, QUADLET *payload, ULONG length)
+{
+    OHCI1394ARCtx *ctx = &unit->hu_ARRequestCtx;
+    ULONG offset = (APTR)payload - (APTR)ctx->arc_Pages;
+
+    if ((0 == length) || (offset >= (ARBUFFER_RING_SIZE + ARBUFFER_PAGE_SIZE)))
+    {
+        return payload;
+    }
+
+    /* Packet parsed from the spare page: the same data are at the ring start */
+    if (offset >= ARBUFFER_RING_SIZE)
+    {
+        offset -= ARBUFFER_RING_SIZE;
+        payload = (APTR)ctx->arc_Pages + offset;
+    }
+
+    LOCK_CTX(ctx);
+    ctx->arc_CpuDMABuffers[offset / ARBUFFER_PAGE_SIZE].arb_Holds++;
+    UNLOCK_CTX(ctx);
+
+    return payload;
+}
+
+void ohci_ARContext_ReleasePayload(HeliosHWReqHandler *reqh, QUADLET *payload)
+{
+    OHCI1394Unit *unit = reqh->rh_ReleaseData;
+    OHCI1394ARCtx *ctx = &unit->hu_ARRequestCtx;
+    OHCI1394ARBuffer *buf;
+    ULONG offset = (APTR)payload - (APTR)ctx->arc_Pages;
+
+    /* Not held by ohci_ARContext_HoldPayload() */
+    if (offset >= ARBUFFER_RING_SIZE)
+    {
+        return;
+    }
+
+    buf = &ctx->arc_CpuDMABuffers[offset / ARBUFFER_PAGE_SIZE];
+
+    LOCK_CTX(ctx);
+    {
+        if (0 == buf->arb_Holds)
+        {
+            _ERR_UNIT(unit, "payload %p released twice\n", payload);
+        }
+        else if (0 == --buf->arb_Holds)
+        {
+            ohci_ARContext_Recycle(ctx);
+        }
+    }
+    UNLOCK_CTX(ctx);
+}
+
 LONG ohci_GenerationOK(OHCI1394Unit *unit, UBYTE generation)
 {
     return (generation == unit->hu_OHCI_LastGeneration) &&
@@ -3256,6 +4425,11 @@ void ohci_IRContext_Destroy(OHCI1394IRCtx *ctx)
     ohci_IsoCtx_Remove(&ctx->irc_Base.ic_Context);
     ohci_FreeIsoCtx(unit, HELIOS_ISO_RX_CTX, ctx->irc_Base.ic_Index);
 
+    if (NULL != ctx->irc_Batch)
+    {
+        FreePooled(unit->hu_MemPool, ctx->irc_Batch,
+                   sizeof(HeliosIRPacket) * OHCI1394_IR_BATCH_MAX + OHCI1394_IR_MAX_PACKET);
+    }
     FreeVecDMA(ctx->irc_PageBuffer);
     FreeVecDMA(ctx->irc_DMABuffer);
     FreePooled(unit->hu_MemPool, ctx, sizeof(*ctx));
@@ -3272,7 +4446,17 @@ OHCI1394IRCtx *ohci_IRContext_Create(OHCI1394Unit *     unit,
                                      OHCI1394IRCtxFlags flags)
 {
     OHCI1394IRCtx *ctx = NULL;
-    ULONG buf_size = ibuf_size + payload_align - 1;
+    ULONG buf_size;
+
+    if (flags.BufferFill)
+    {
+        /* Pages of whole quadlets, the packet header is not split from the payload */
+        ibuf_size &= ~3;
+        hlen = 0;
+        payload_align = 4;
+    }
+
+    buf_size = ibuf_size + payload_align - 1;
 
     index = ohci_AllocIsoCtx(unit, HELIOS_ISO_RX_CTX, index);
     if (index >= 0)
@@ -3283,7 +4467,14 @@ OHCI1394IRCtx *ohci_IRContext_Create(OHCI1394Unit *     unit,
             ctx->irc_Base.ic_Index = index;
             ctx->irc_HeaderLength = hlen;
             ctx->irc_PayloadLength = ibuf_size - hlen;
-            ctx->irc_Callback = callback;
+            if (flags.BufferFill)
+            {
+                ctx->irc_BatchCallback = callback;
+            }
+            else
+            {
+                ctx->irc_Callback = callback;
+            }
             ctx->irc_UserData = udata;
             ctx->irc_Flags = flags;
 
@@ -3297,12 +4488,26 @@ OHCI1394IRCtx *ohci_IRContext_Create(OHCI1394Unit *     unit,
                 /* Compute the header padding from requested payload alignement and the allocated data buffer address */
                 ctx->irc_HeaderPadding = (payload_align - ((((ULONG) ctx->irc_AlignedPageBuffer) + hlen) % payload_align)) % payload_align;
 
+                /* Packet views given to the user callback in buffer-fill mode */
+                if (flags.BufferFill)
+                {
+                    ctx->irc_Batch = AllocPooled(unit->hu_MemPool,
+                                                 sizeof(HeliosIRPacket) * OHCI1394_IR_BATCH_MAX + OHCI1394_IR_MAX_PACKET);
+                    if (NULL == ctx->irc_Batch)
+                    {
+                        _ERR_UNIT(unit, "IR #%u: batch alloc failed\n", index);
+                        goto free_pages;
+                    }
+
+                    ctx->irc_Bounce = (UBYTE *)&ctx->irc_Batch[OHCI1394_IR_BATCH_MAX];
+                }
+
                 /* DMA programs allocation */
                 ctx->irc_DMABufferCount = ibuf_count;
                 ctx->irc_DMABuffer = AllocVecDMA(sizeof(OHCI1394IRBuffer)*ibuf_count+15, MEMF_PUBLIC | MEMF_CLEAR);
                 if (NULL != ctx->irc_DMABuffer)
                 {
-                    ULONG cmd_ptr;
+                    ULONG cmd_ptr, z;
                     char buf[64];
 
                     /* Align on 16-bytes DMA buffers */
@@ -3314,16 +4519,32 @@ OHCI1394IRCtx *ohci_IRContext_Create(OHCI1394Unit *     unit,
                     _INFO_IRDMA_CTX(ctx, "DMA@%p, Pages@%p, DMA buf size=%lu\n",
                                     ctx->irc_AlignedDMABuffer, ctx->irc_AlignedPageBuffer, buf_size);
 
-                    cmd_ptr = ohci_IRContext_PacketPerBuffer_InitDMABuffers(ctx, buf_size);
+                    if (flags.BufferFill)
+                    {
+                        cmd_ptr = ohci_IRContext_BufferFill_InitDMABuffers(ctx, buf_size);
+                        z = 1;
+                    }
+                    else
+                    {
+                        cmd_ptr = ohci_IRContext_PacketPerBuffer_InitDMABuffers(ctx, buf_size);
+                        z = 2;
+                    }
 
                     utils_SPrintF(buf, "["DEVNAME"] IR Handler #%u", index);
                     if (ohci_Context_Init(unit, &ctx->irc_Base.ic_Context,
                                           OHCI1394_REG_IRECV_CONTEXT_CONTROL(index),
-                                          buf, ohci_IRContext_PacketPerBufferCallback,
+                                          buf, flags.BufferFill ?
+                                          ohci_IRContext_BufferFillCallback :
+                                          ohci_IRContext_PacketPerBufferCallback,
                                           TASK_PRIO_IRCTX))
                     {
-                        ohci_IRContext_Append(ctx, cmd_ptr);
-                        return ctx;
+                        if (ohci_IRContext_Append(ctx, cmd_ptr, z))
+                        {
+                            return ctx;
+                        }
+
+                        _ERR_UNIT(unit, "IR: a multichannel context already exists\n");
+                        Helios_KillSubTask(ctx->irc_Base.ic_Context.ctx_SubTask);
                     }
 
                     FreeVecDMA(ctx->irc_DMABuffer);
@@ -3333,6 +4554,13 @@ OHCI1394IRCtx *ohci_IRContext_Create(OHCI1394Unit *     unit,
                     _ERR_UNIT(unit, "IR #%u: DMABuffer alloc failed\n", index);
                 }
 
+                if (NULL != ctx->irc_Batch)
+                {
+                    FreePooled(unit->hu_MemPool, ctx->irc_Batch,
+                               sizeof(HeliosIRPacket) * OHCI1394_IR_BATCH_MAX + OHCI1394_IR_MAX_PACKET);
+                }
+
+free_pages:
                 FreeVecDMA(ctx->irc_PageBuffer);
             }
             else
@@ -3353,7 +4581,7 @@ OHCI1394IRCtx *ohci_IRContext_Create(OHCI1394Unit *     unit,
     return NULL;
 }
 
-void ohci_IRContext_Start(OHCI1394IRCtx *ctx, ULONG channel, ULONG tags)
+void ohci_IRContext_Start(OHCI1394IRCtx *ctx, ULONG channel, ULONG tags, UQUAD channels)
 {
     LOCK_CTX(ctx);
     {
@@ -3373,6 +4601,23 @@ void ohci_IRContext_Start(OHCI1394IRCtx *ctx, ULONG channel, ULONG tags)
             reg = (tags << 28) | channel;
             ohci_RegWrite(unit, OHCI1394_REG_IRECV_COMMAND_MATCH(ctx->irc_Base.ic_Index), reg);
 
+            /* Buffer-fill mode keeps packet headers and trailers in the pages */
+            if (ctx->irc_Flags.BufferFill)
+            {
+                reg = CTX_BUFFER_FILL | CTX_ISOCH_HEADER;
+
+                if (ctx->irc_Flags.MultiChannel)
+                {
+                    ohci_RegWrite(unit, OHCI1394_REG_IR_MULTICHAN_MASK_HI_CLEAR, ~0);
+                    ohci_RegWrite(unit, OHCI1394_REG_IR_MULTICHAN_MASK_LO_CLEAR, ~0);
+                    ohci_RegWrite(unit, OHCI1394_REG_IR_MULTICHAN_MASK_HI_SET, channels >> 32);
+                    ohci_RegWrite(unit, OHCI1394_REG_IR_MULTICHAN_MASK_LO_SET, channels);
+                    reg |= CTX_MULTI_CHAN_MODE;
+                }
+
+                ohci_RegWrite(unit, OHCI1394_REG_IRECV_CONTEXT_CONTROL_SET(ctx->irc_Base.ic_Index), reg);
+            }
+
             /* Run context */
             ohci_IRContext_Run(ctx);
 
@@ -3385,47 +4630,204 @@ void ohci_IRContext_Start(OHCI1394IRCtx *ctx, ULONG channel, ULONG tags)
 
 BOOL ohci_IRContext_Stop(OHCI1394IRCtx *ctx)
 {
-    OHCI1394Unit *unit = ctx->irc_Base.ic_Context.ctx_Unit;
-    ULONG loop = 20;
-    ULONG index_mask = 1ul << ctx->irc_Base.ic_Index;
+    LOCK_CTX(ctx);
+    {
+        ohci_IRContext_RequestStop(ctx);
+    }
+    UNLOCK_CTX(ctx);
+
+    return ohci_IRContext_WaitStopped(ctx);
+}
+
+
+void ohci_ITContext_Destroy(OHCI1394ITCtx *ctx)
+{
+    OHCI1394Unit *unit = ctx->itc_Base.ic_Context.ctx_Unit;
+
+    ohci_ITContext_Stop(ctx);
+    Helios_KillSubTask(ctx->itc_Base.ic_Context.ctx_SubTask);
+    ohci_IsoCtx_Remove(&ctx->itc_Base.ic_Context);
+    ohci_FreeIsoCtx(unit, HELIOS_ISO_TX_CTX, ctx->itc_Base.ic_Index);
+
+    FreeVecDMA(ctx->itc_PageBuffer);
+    FreeVecDMA(ctx->itc_DMABuffer);
+    FreePooled(unit->hu_MemPool, ctx, sizeof(*ctx));
+}
+
+OHCI1394ITCtx *ohci_ITContext_Create(OHCI1394Unit *     unit,
+                                     LONG               index,
+                                     UWORD              ibuf_size,
+                                     UWORD              ibuf_count,
+                                     APTR               callback,
+                                     APTR               udata,
+                                     OHCI1394ITCtxFlags flags)
+{
+    OHCI1394ITCtx *ctx = NULL;
+    ULONG buf_size = (ibuf_size + 3) & ~3;
+
+    index = ohci_AllocIsoCtx(unit, HELIOS_ISO_TX_CTX, index);
+    if (index >= 0)
+    {
+        ctx = AllocPooled(unit->hu_MemPool, sizeof(*ctx));
+        if (NULL != ctx)
+        {
+            memset(ctx, 0, sizeof(*ctx));
+            ctx->itc_Base.ic_Index = index;
+            ctx->itc_PayloadSize = ibuf_size;
+            ctx->itc_Callback = callback;
+            ctx->itc_UserData = udata;
+            ctx->itc_Flags = flags;
+
+            /* Data buffer allocation */
+            ctx->itc_PageBuffer = AllocVecDMA(buf_size * ibuf_count + 3, MEMF_PUBLIC | MEMF_CLEAR);
+            if (NULL != ctx->itc_PageBuffer)
+            {
+                ctx->itc_AlignedPageBuffer = (APTR) (((ULONG) ctx->itc_PageBuffer + 3) & ~3);
+
+                /* DMA programs allocation */
+                ctx->itc_DMABufferCount = ibuf_count;
+                ctx->itc_DMABuffer = AllocVecDMA(sizeof(OHCI1394ITBuffer)*ibuf_count+15, MEMF_PUBLIC | MEMF_CLEAR);
+                if (NULL != ctx->itc_DMABuffer)
+                {
+                    OHCI1394ITBuffer *buf;
+                    APTR page = ctx->itc_AlignedPageBuffer;
+                    char name[64];
+                    ULONG i;
+
+                    /* Align on 16-bytes DMA buffers */
+                    ctx->itc_AlignedDMABuffer = (APTR) (16 + (((ULONG) ctx->itc_DMABuffer - 1) & ~15));
+                    ctx->itc_PhyDMABuffer = (ULONG)PCIXDMAGetPhysical(unit->hu_PCI_BoardObject, ctx->itc_AlignedDMABuffer);
+
+                    _INFO_ITDMA_CTX(ctx, "DMA@%p, Pages@%p, buf size=%lu\n",
+                                    ctx->itc_AlignedDMABuffer, ctx->itc_AlignedPageBuffer, buf_size);
+
+                    /* Ring of buffers, descriptors are built at start */
+                    for (i=0, buf=ctx->itc_AlignedDMABuffer; i<ibuf_count; i++, buf++, page+=buf_size)
+                    {
+                        buf->itb_Next = ((i+1) < ibuf_count) ? buf + 1 : ctx->itc_AlignedDMABuffer;
+                        buf->itb_LastDescriptor = &buf->itb_Descriptors[0];
+                        buf->itb_BufferData.Payload = page;
+                        buf->itb_BufferData.PayloadSize = ibuf_size;
+                    }
+
+                    utils_SPrintF(name, "["DEVNAME"] IT Handler #%u", index);
+                    if (ohci_Context_Init(unit, &ctx->itc_Base.ic_Context,
+                                          OHCI1394_REG_IXMIT_CONTEXT_CONTROL(index),
+                                          name, ohci_ITContext_Handler,
+                                          TASK_PRIO_ITCTX))
+                    {
+                        LOCK_REGION(unit);
+                        {
+                            /* Clear the iso context config */
+                            ohci_RegWrite(unit, OHCI1394_REG_IXMIT_CONTEXT_CONTROL_CLEAR(index), ~0);
+
+                            /* Register to unit */
+                            ADDHEAD(&unit->hu_ITCtxList, ctx);
+                        }
+                        UNLOCK_REGION(unit);
+
+                        return ctx;
+                    }
+
+                    FreeVecDMA(ctx->itc_DMABuffer);
+                }
+                else
+                {
+                    _ERR_UNIT(unit, "IT #%u: DMABuffer alloc failed\n", index);
+                }
+
+                FreeVecDMA(ctx->itc_PageBuffer);
+            }
+            else
+            {
+                _ERR_UNIT(unit, "IT #%u: PageBuffer alloc failed\n", index);
+            }
+
+            FreePooled(unit->hu_MemPool, ctx, sizeof(*ctx));
+        }
+        else
+        {
+            _ERR_UNIT(unit, "IT #%u: ctx alloc failed\n", index);
+        }
+
+        ohci_FreeIsoCtx(unit, HELIOS_ISO_TX_CTX, index);
+    }
+
+    return NULL;
+}
+
+/* Fill all buffers through the user callback, then run the context.
+ * If cycle_match >= 0, the first packet is sent at this cycle
+ * (bits 14-13: seconds modulo 4, bits 12-0: cycle count).
+ */
+BOOL ohci_ITContext_Start(OHCI1394ITCtx *ctx, ULONG channel, ULONG tag,
+                          HeliosSpeed speed, LONG cycle_match)
+{
     BOOL res = FALSE;
 
     LOCK_CTX(ctx);
     {
-        /* Disable interruption line */
-        ohci_RegWrite(unit, OHCI1394_REG_ISO_RECV_INT_MASK_CLEAR, index_mask);
+        OHCI1394Unit *unit = ctx->itc_Base.ic_Context.ctx_Unit;
+        ULONG index = ctx->itc_Base.ic_Index;
+        QUADLET reg = ohci_RegRead(unit, OHCI1394_REG_IXMIT_CONTEXT_CONTROL(index));
 
-        /* Request the DMA stop of context */
-        ohci_RegWrite(unit, OHCI1394_REG_IRECV_CONTEXT_CONTROL_CLEAR(ctx->irc_Base.ic_Index), CTX_RUN);
+        _INFO_ITDMA_CTX(ctx, "[%u]: CTRL=$%08x\n", index, reg);
 
-        /* Wait about DMA safe state */
-        do
+        /* Also refused while a stop request is still in progress */
+        if (0 == (reg & (CTX_RUN | CTX_ACTIVE)))
         {
-            QUADLET reg;
+            OHCI1394ITBuffer *buf;
+            ULONG i, index_mask = 1ul << index;
+
+            ctx->itc_IsoHeader = ((speed & 7) << 16) | ((tag & 3) << 14) | ((channel & 0x3f) << 8) | (TCODE_WRITE_STREAM << 4);
 
-            reg = ohci_RegRead(unit, OHCI1394_REG_IRECV_CONTEXT_CONTROL(ctx->irc_Base.ic_Index));
-            if (0 == (reg & CTX_ACTIVE))
+            /* Prefill the DMA program */
+            ctx->itc_LastDMABuffer = NULL;
+            buf = ctx->itc_FirstDMABuffer = ctx->itc_AlignedDMABuffer;
+            for (i=0; i<ctx->itc_DMABufferCount; i++, buf++)
             {
-                res = TRUE;
-                goto out;
+                buf->itb_BufferData.TimeStamp = 0;
+                ohci_ITContext_Refill(ctx, buf, OHCI1394_EVENT_NO_STATUS);
             }
 
-            _INFO_CTX(&ctx->irc_Base.ic_Context, "IR context %u still active\n", ctx->irc_Base.ic_Index);
-            Helios_DelayMS(25); // wait 25 ms
-        }
-        while (loop--);
+            ohci_RegWrite(unit, OHCI1394_REG_IXMIT_CONTEXT_CONTROL_CLEAR(index), ~0);
+            ohci_RegWrite(unit, OHCI1394_REG_IXMIT_COMMAND_PTR(index),
+                          ctx->itc_PhyDMABuffer | ctx->itc_FirstDMABuffer->itb_Z);
+
+            /* Clearing and enable interruption line */
+            ohci_RegWrite(unit, OHCI1394_REG_ISO_XMIT_INT_EVENT_CLEAR, index_mask);
+            ohci_RegWrite(unit, OHCI1394_REG_ISO_XMIT_INT_MASK_SET, index_mask);
+
+            if (cycle_match >= 0)
+            {
+                ohci_RegWrite(unit, OHCI1394_REG_IXMIT_CONTEXT_CONTROL_SET(index),
+                              IT_CTX_CYCLE_MATCH_ENABLE | ((cycle_match & 0x7fff) << 16));
+            }
+
+            /* Run context */
+            ohci_ITContext_Run(ctx);
+            res = TRUE;
 
-        /* Timeout */
-        _ERR_CTX(&ctx->irc_Base.ic_Context,
-                 "TIMEOUT, IR context #%u still active 500ms after STOP request\n",
-                 ctx->irc_Base.ic_Index);
+            _INFO_ITDMA_CTX(ctx, "[%u]: CTRL=$%08x\n", index,
+                            ohci_RegRead(unit, OHCI1394_REG_IXMIT_CONTEXT_CONTROL(index)));
+        }
     }
     UNLOCK_CTX(ctx);
 
-out:
     return res;
 }
 
+BOOL ohci_ITContext_Stop(OHCI1394ITCtx *ctx)
+{
+    LOCK_CTX(ctx);
+    {
+        ohci_ITContext_RequestStop(ctx);
+    }
+    UNLOCK_CTX(ctx);
+
+    return ohci_ITContext_WaitStopped(ctx);
+}
+
 
 /* link layer */
 LONG ohci_ScanPCI(OHCI1394Device *base)
@@ -3558,6 +4960,10 @@ LONG ohci_Init(OHCI1394Unit *unit)
     NEWLIST(&unit->hu_Listeners);
     LOCK_INIT(&unit->hu_Listeners);
 
+    trace_Init(&unit->hu_Trace, unit->hu_TraceEvents, OHCI1394_TRACE_EVENTS, ohci_TraceClock, unit);
+    memset(&unit->hu_Stats, 0, sizeof(unit->hu_Stats));
+    capture_Init(&unit->hu_Capture, unit->hu_CapturePackets, OHCI1394_CAPTURE_PACKETS, ohci_TraceClock, unit);
+
     if (ohci_PCI_OpenUnit(unit))
     {
         unit->hu_MemPool = CreatePool(MEMF_PUBLIC|MEMF_CLEAR|MEMF_SEM_PROTECTED, 16384, 4096);
@@ -3573,7 +4979,17 @@ LONG ohci_Init(OHCI1394Unit *unit)
             {
                 if (0 == Helios_WaitTaskReady(unit->hu_SplitTimeoutTask, SIGBREAKF_CTRL_E))
                 {
-                    NEWLIST(&unit->hu_ReqHandlerData.rhd_List);
+                    ULONG i;
+
+                    for (i=0; i < SPLIT_WHEEL_SLOTS; i++)
+                    {
+                        NEWLIST((struct List *)&unit->hu_SplitWheel.sw_Slots[i]);
+                    }
+                    NEWLIST((struct List *)&unit->hu_SplitWheel.sw_Expired);
+
+                    unit->hu_ReqHandlerData.rhd_Index = NULL;
+                    unit->hu_ReqHandlerData.rhd_Count = 0;
+                    unit->hu_ReqHandlerData.rhd_Size = 0;
                     LOCK_INIT(&unit->hu_ReqHandlerData);
 
                     _INFO_UNIT(unit, "Reset HW registers...\n");
@@ -3615,7 +5031,7 @@ LONG ohci_Init(OHCI1394Unit *unit)
                             ohci_RegWrite(unit, OHCI1394_REG_ISO_XMIT_INT_MASK_SET, ~0);
                             unit->hu_ITCtxMask = ohci_RegRead(unit, OHCI1394_REG_ISO_XMIT_INT_MASK_SET);
                             ohci_RegWrite(unit, OHCI1394_REG_ISO_XMIT_INT_MASK_CLEAR, ~0);
-                            unit->hu_MaxIsoTransmitCtx = utils_CountBits32(unit->hu_IRCtxMask, 1);
+                            unit->hu_MaxIsoTransmitCtx = utils_CountBits32(unit->hu_ITCtxMask, 1);
 
                             _INFO_UNIT(unit, "Available ISO Contexts: Rx=%u, Tx=%u\n",
                                        unit->hu_MaxIsoReceiveCtx, unit->hu_MaxIsoTransmitCtx);
@@ -3658,7 +5074,7 @@ LONG ohci_Init(OHCI1394Unit *unit)
                                         /* Asynchronous handlers creation */
                                         if (ohci_ATContexts_Init(unit))
                                         {
-                                            if (ohci_ARContexts_Init(unit))
+                                            if (ohci_ARContexts_Init(unit) && ohci_IRQTask_Init(unit))
                                             {
                                                 ULONG lps, i;
 
@@ -3774,6 +5190,7 @@ LONG ohci_Init(OHCI1394Unit *unit)
                                                 }
                                             }
 
+                                            ohci_IRQTask_Term(unit);
                                             ohci_ARContexts_Term(unit);
                                         }
                                     }
@@ -3847,11 +5264,12 @@ void ohci_Term(OHCI1394Unit *unit)
 
     ForeachNodeSafe(&unit->hu_ITCtxList, iso_ctx, next)
     {
-        ; //iso_ITContext_Destroy(iso_ctx);
+        ohci_ITContext_Destroy(iso_ctx);
     }
 
     ohci_SoftReset(unit);
 
+    ohci_IRQTask_Term(unit);
     ohci_ATContexts_Term(unit);
     ohci_ARContexts_Term(unit);
 
@@ -409,6 +409,7 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define AT_HEADER_EXTCODE(x) (((QUADLET)(x) & AT_HEADER_EXTCODE_MSK) << AT_HEADER_EXTCODE_SHIFT)
 
 #define TLABEL_MAX 64 /* TLabel is on 6bits */
+#define TLABEL_POOLS 64 /* One tlabel pool per destination PHY ID, 0x3f included */
 #define MAX_NODES 63 /* Max nodes per bus, NodeID=0x3f is reserved as broadcast id */
 
 #define OHCI1394_PKTF_REQUEST (1<<0)
@@ -418,6 +419,8 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define UNLOCK_CTX(c) UNLOCK_REGION((OHCI1394Context *)(c))
 
 #include "debug.h"
+#include "trace.h"
+#include "capture.h"
 
 #define _INFO_UNIT(unit, fmt, args...) _INFO("[unit %lu] " fmt, (unit)->hu_UnitNo ,##args)
 #define _ERR_UNIT(unit, fmt, args...)  _ERR("[unit %lu] " fmt, (unit)->hu_UnitNo ,##args)
@@ -428,11 +431,31 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 
 struct OHCI1394Unit;
 
-typedef struct OHCI1394SplitTimeReq
+/* SPLIT-TIMEOUT of pending transactions, one per tlabel.
+ * Linked in the slot (st_Expire % SPLIT_WHEEL_SLOTS) of the unit timing wheel
+ * from the ACK_PENDING up to the response, the cancellation or the expiration.
+ */
+typedef struct OHCI1394SplitTimer
 {
-    struct timerequest req;
-    HeliosTransaction *transaction;
-} OHCI1394SplitTimeReq;
+    struct MinNode      st_Node;
+    ULONG               st_Expire;      /* Wheel tick of expiration */
+    HeliosTransaction * st_Transaction; /* NULL if not in the wheel */
+} OHCI1394SplitTimer;
+
+#define SPLIT_WHEEL_TICK_US 10000   /* Wheel period, timeouts are rounded up to it */
+#define SPLIT_WHEEL_SLOTS   64      /* Power of 2, timeouts over 640ms stay more turns */
+
+/* Hashed timing wheel: arming and disarming are O(1), a tick only visits one slot.
+ * Turned by the SplitTimeout task, only while timers are pending.
+ * Protected by the unit lock.
+ */
+typedef struct OHCI1394SplitWheel
+{
+    struct MinList      sw_Slots[SPLIT_WHEEL_SLOTS];
+    ULONG               sw_Tick;        /* Current tick */
+    ULONG               sw_Pending;     /* Timers in the wheel */
+    struct MinList      sw_Expired;     /* Timers expired, callbacks not called yet */
+} OHCI1394SplitWheel;
 
 typedef struct OHCI1394Descriptor
 {
@@ -452,6 +475,7 @@ typedef union
 
     struct
     {
+#if BYTE_ORDER == BIG_ENDIAN
         /* bits from 31 to 0 */
         QUADLET BIBimageValid   : 1;
         QUADLET NoByteSwapData  : 1;
@@ -465,6 +489,21 @@ typedef union
         QUADLET LinkEnable      : 1;
         QUADLET SoftReset       : 1;
         QUADLET Reserved2       : 16;
+#else
+        /* bits from 0 to 31 */
+        QUADLET Reserved2       : 16;
+        QUADLET SoftReset       : 1;
+        QUADLET LinkEnable      : 1;
+        QUADLET PWriteEnable    : 1;
+        QUADLET LinkPowerStatus : 1;
+        QUADLET Reserved1       : 2;
+        QUADLET APhyEhcEnable   : 1;
+        QUADLET PrgPhyEnable    : 1;
+        QUADLET Reserved0       : 5;
+        QUADLET AckTardyEnable  : 1;
+        QUADLET NoByteSwapData  : 1;
+        QUADLET BIBimageValid   : 1;
+#endif
     } r;
 } HCC;
 
@@ -482,8 +521,22 @@ typedef struct OHCI1394ATPacketData
     OHCI1394ATCompleteCallback pd_AckCallback;
     APTR                       pd_UData;
     struct OHCI1394ATBuffer *  pd_Buffer;
+    ULONG                      pd_SendTime;     /* Cycle timer at registration, for latency stats */
 } OHCI1394ATPacketData;
 
+/* Transaction labels only need to be unique per destination node:
+ * each one has its own 64 tlabels, allocated without lock
+ * by atomic updates of tp_Map.
+ */
+typedef struct OHCI1394TLabelPool
+{
+    ULONG                      tp_Map[2];       /* Used tlabels: bit n%32 of word n/32 */
+    ULONG                      tp_Hint;         /* Next tlabel to try first, not locked */
+    HeliosTransaction *        tp_Transactions[TLABEL_MAX];
+    OHCI1394ATPacketData       tp_PacketData[TLABEL_MAX];
+    OHCI1394SplitTimer         tp_SplitTimers[TLABEL_MAX];
+} OHCI1394TLabelPool;
+
 typedef struct OHCI1394ATBuffer
 {
     struct MinNode             atb_Node;
@@ -492,12 +545,34 @@ typedef struct OHCI1394ATBuffer
     OHCI1394Descriptor *       atb_LastDescriptor;
 } OHCI1394ATBuffer __attribute__((aligned(16)));
 
+/* Tracepoint events kept per unit (power of 2) */
+#define OHCI1394_TRACE_EVENTS 1024
+
+/* Captured packets kept per unit (power of 2) */
+#define OHCI1394_CAPTURE_PACKETS 1024
+
+/* Lock-free update of a HeliosHWStatistics counter */
+#define STAT_ADD(unit, field, n) ATOMIC_ADD((LONG *)&(unit)->hu_Stats.field, (n))
+#define STAT_INC(unit, field)    STAT_ADD(unit, field, 1)
+
+/* Packets given to ohci_ATContext_SendV() are woken by batch of this size */
+#define OHCI1394_AT_BATCH_MAX 64
+
+typedef struct OHCI1394ATSendVec
+{
+    QUADLET *                  sv_Header;
+    QUADLET *                  sv_Payload;
+    OHCI1394ATPacketData *     sv_PacketData;
+    UBYTE                      sv_TLabel;
+    UWORD                      sv_TimeStamp;
+} OHCI1394ATSendVec;
+
 /* The real size of this buffer is known only after the OHCI init */
 typedef struct OHCI1394ARBuffer
 {
     struct MinNode          arb_Node;
     QUADLET *               arb_Page;
-    ULONG                   arb_Pad0;
+    ULONG                   arb_Holds;      /* Zero-copy payload views not released yet on this page */
     OHCI1394Descriptor      arb_Descriptor; /* DMA INPUT_MORE descriptor */
 } OHCI1394ARBuffer __attribute__((aligned(16)));
 
@@ -509,6 +584,24 @@ typedef struct OHCI1394IRBuffer
     HeliosIRBuffer            irb_BufferData;
 } OHCI1394IRBuffer __attribute__((aligned(16)));
 
+/* Buffer-fill IR contexts give packets to the client by batch of this size */
+#define OHCI1394_IR_BATCH_MAX 64
+
+/* Largest packet (header + payload + trailer) that can be split at the end of a buffer-fill ring */
+#define OHCI1394_IR_MAX_PACKET (4 + 4096 + 4)
+
+/* IT descriptor block: OUTPUT_MORE_IMMEDIATE (2 descriptors), CIP header, payload */
+struct OHCI1394ITBuffer;
+typedef struct OHCI1394ITBuffer
+{
+    OHCI1394Descriptor        itb_Descriptors[4];
+    QUADLET                   itb_CIP[2];         /* CIP header in bus order, read by the DMA */
+    struct OHCI1394ITBuffer * itb_Next;
+    OHCI1394Descriptor *      itb_LastDescriptor;
+    ULONG                     itb_Z;
+    HeliosITBuffer            itb_BufferData;
+} OHCI1394ITBuffer __attribute__((aligned(16)));
+
 /* Common Context structure */
 struct OHCI1394Context;
 typedef void (*OHCI1394CtxHandler) (struct OHCI1394Context *ctx);
@@ -554,6 +647,7 @@ typedef struct OHCI1394ARCtx
 
     QUADLET *           arc_Pages;
     QUADLET *           arc_FirstQuadlet;   // first quadlet to read inside the first page of the current DMA block
+    ULONG               arc_Consumed;       // Fully read pages not given back yet to the DMA program (held views)
 } OHCI1394ARCtx;
 
 typedef struct OHCI1394IsoCtxBase
@@ -565,6 +659,8 @@ typedef struct OHCI1394IsoCtxBase
 typedef struct
 {
     ULONG DropEmpty:1;
+    ULONG BufferFill:1;     /* One INPUT_MORE descriptor per page, packets stored contiguously */
+    ULONG MultiChannel:1;   /* BufferFill context receiving the IR multichannel mask channels */
 } OHCI1394IRCtxFlags;
 
 typedef struct OHCI1394IRCtx
@@ -576,6 +672,7 @@ typedef struct OHCI1394IRCtx
 
     OHCI1394IRCtxFlags  irc_Flags;
     HeliosIRCallback    irc_Callback;
+    HeliosIRBatchCallback irc_BatchCallback; // BufferFill contexts
     APTR                irc_UserData;
     ULONG               irc_HeaderLength;
     ULONG               irc_PayloadLength;
@@ -589,11 +686,41 @@ typedef struct OHCI1394IRCtx
 
     APTR                irc_PageBuffer;
     APTR                irc_AlignedPageBuffer;
+
+    /* Buffer-fill mode only */
+    ULONG               irc_ReadOffset;     // next packet to parse, from the start of the first page
+    HeliosIRPacket *    irc_Batch;
+    UBYTE *             irc_Bounce;         // packets wrapping the end of the page ring are copied here
 } OHCI1394IRCtx;
 
+typedef struct
+{
+    ULONG CIP:1;
+} OHCI1394ITCtxFlags;
+
 typedef struct OHCI1394ITCtx
 {
     OHCI1394IsoCtxBase  itc_Base;
+    QUADLET             itc_IsoHeader;      /* speed, tag, channel and tcode of sent packets */
+
+    OHCI1394ITCtxFlags  itc_Flags;
+    HeliosITCallback    itc_Callback;
+    APTR                itc_UserData;
+    ULONG               itc_PayloadSize;
+
+    ULONG               itc_DMABufferCount;
+    APTR                itc_DMABuffer;
+    OHCI1394ITBuffer *  itc_AlignedDMABuffer;
+    ULONG               itc_PhyDMABuffer;
+    OHCI1394ITBuffer *  itc_FirstDMABuffer; // oldest buffer given to the DMA
+    OHCI1394ITBuffer *  itc_LastDMABuffer;  // end of the DMA program (Z=0)
+
+    APTR                itc_PageBuffer;
+    APTR                itc_AlignedPageBuffer;
+
+    ULONG               itc_Packets;
+    ULONG               itc_Skips;
+    ULONG               itc_Underruns;
 } OHCI1394ITCtx;
 
 typedef struct
@@ -630,19 +757,21 @@ typedef struct OHCI1394Unit
 
 
     /* Transactions handling */
-    HeliosTransaction *   hu_Transactions[TLABEL_MAX];
-    OHCI1394ATPacketData  hu_PacketData[TLABEL_MAX];
-    UQUAD                 hu_TLabelMap;
-    UBYTE                 hu_LastTLabel;
-    UBYTE                 hu_Reserved0[3];
+    OHCI1394TLabelPool    hu_TLabelPools[TLABEL_POOLS]; /* Indexed by destination PHY ID */
     ULONG                 hu_SplitTimeout;            /* SPLIT-TIMEOUT CSR register value */
     HeliosSubTask *       hu_SplitTimeoutTask;
+    ULONG                 hu_SplitTimeoutSignal;      /* Starts the wheel ticks */
     struct MsgPort *      hu_TimerPort;
-    struct timerequest *  hu_SplitTimeoutIOReq;
+    struct timerequest *  hu_SplitTimeoutIOReq;       /* Wheel tick */
+    OHCI1394SplitWheel    hu_SplitWheel;
+    OHCI1394SplitStats    hu_SplitStats;
+    ULONG                 hu_TLAllocs;                /* Pool allocations of the transaction layer */
     struct
     {
         LOCK_VARIABLE;
-        struct MinList    rhd_List;
+        HeliosHWReqHandler ** rhd_Index;  /* Sorted by rh_Start, regions never overlap */
+        ULONG                 rhd_Count;
+        ULONG                 rhd_Size;
     }                     hu_ReqHandlerData;
 
     /* OHCI static stuff (never change) */
@@ -675,6 +804,27 @@ typedef struct OHCI1394Unit
     UBYTE                 hu_MaxIsoReceiveCtx;
     UBYTE                 hu_MaxIsoTransmitCtx;
     UWORD                 hu_Reserved2;
+    ULONG                 hu_IRDrops;                 /* Buffer-fill packets dropped by all IR contexts */
+
+    /* Interrupt coalescing */
+    HeliosSubTask *       hu_IRQTask;                 /* Deferred handler of AT/AR and iso events */
+    ULONG                 hu_IRQSignal;
+    ULONG                 hu_IRQPending;              /* INT_EVENT bits not yet handled by hu_IRQTask */
+    ULONG                 hu_IRQPendingIR;            /* Same for ISO_RECV_INT_EVENT */
+    ULONG                 hu_IRQPendingIT;            /* Same for ISO_XMIT_INT_EVENT */
+    ULONG                 hu_IRQMaxRate;              /* Interrupts per second ceiling, 0 = no limit */
+    OHCI1394IrqStats      hu_IRQStats;
+
+    /* Tracepoints (HHA_TraceMask) */
+    HeliosTraceRing       hu_Trace;
+    HeliosTraceEvent      hu_TraceEvents[OHCI1394_TRACE_EVENTS];
+
+    /* Statistics (HHA_Statistics) */
+    HeliosHWStatistics    hu_Stats;
+
+    /* Bus capture (HHA_Capture) */
+    HeliosCaptureRing     hu_Capture;
+    HeliosCapturePacket   hu_CapturePackets[OHCI1394_CAPTURE_PACKETS];
 
     /* Asynchronous stuffs */
     OHCI1394ATCtx         hu_ATRequestCtx;
@@ -694,6 +844,7 @@ extern LONG ohci_Enable(OHCI1394Unit *unit);
 extern void ohci_Disable(OHCI1394Unit *unit);
 extern UWORD ohci_GetTimeStamp(OHCI1394Unit *unit);
 extern UQUAD ohci_UpTime(OHCI1394Unit *unit);
+extern ULONG ohci_CycleTimer(OHCI1394Unit *unit);
 extern LONG ohci_Init(OHCI1394Unit *unit);
 extern void ohci_Term(OHCI1394Unit *unit);
 extern BOOL ohci_RaiseBusReset(OHCI1394Unit *unit, BOOL shortreset);
@@ -702,10 +853,15 @@ extern LONG ohci_SendPHYPacket(OHCI1394Unit *unit, HeliosSpeed speed, QUADLET ph
 extern LONG ohci_ATContext_Send(OHCI1394ATCtx *ctx, UBYTE generation, QUADLET *p,
                                 QUADLET *payload, OHCI1394ATPacketData *pdata,
                                 UBYTE tlabel, UWORD timestamp);
+extern ULONG ohci_ATContext_SendV(OHCI1394ATCtx *ctx, UBYTE generation,
+                                  OHCI1394ATSendVec *vec, ULONG count);
 extern void ohci_HandleLocalRequest(OHCI1394Unit *unit,
                                     HeliosAPacket *req,
                                     HeliosAPacket *resp);
+extern BYTE ohci_ATEventStatus(UBYTE event);
 extern void ohci_CancelATPacket(OHCI1394Unit *unit, OHCI1394ATPacketData *pdata);
+extern QUADLET *ohci_ARContext_HoldPayload(OHCI1394Unit *unit, QUADLET *payload, ULONG length);
+extern void ohci_ARContext_ReleasePayload(HeliosHWReqHandler *reqh, QUADLET *payload);
 extern LONG ohci_GenerationOK(OHCI1394Unit *unit, UBYTE generation);
 extern LONG ohci_SetROM(OHCI1394Unit *unit, QUADLET *data);
 extern void ohci_IRContext_Destroy(OHCI1394IRCtx *ctx);
@@ -718,7 +874,18 @@ extern OHCI1394IRCtx *ohci_IRContext_Create(OHCI1394Unit *      unit,
                                             APTR                callback,
                                             APTR                udata,
                                             OHCI1394IRCtxFlags  flags);
-extern void ohci_IRContext_Start(OHCI1394IRCtx *ctx, ULONG channel, ULONG tags);
+extern void ohci_IRContext_Start(OHCI1394IRCtx *ctx, ULONG channel, ULONG tags, UQUAD channels);
 extern BOOL ohci_IRContext_Stop(OHCI1394IRCtx *ctx);
+extern void ohci_ITContext_Destroy(OHCI1394ITCtx *ctx);
+extern OHCI1394ITCtx *ohci_ITContext_Create(OHCI1394Unit *      unit,
+                                            LONG                index,
+                                            UWORD               ibuf_size,
+                                            UWORD               ibuf_count,
+                                            APTR                callback,
+                                            APTR                udata,
+                                            OHCI1394ITCtxFlags  flags);
+extern BOOL ohci_ITContext_Start(OHCI1394ITCtx *ctx, ULONG channel, ULONG tag,
+                                 HeliosSpeed speed, LONG cycle_match);
+extern BOOL ohci_ITContext_Stop(OHCI1394ITCtx *ctx);
 
 #endif /* OHCI1394_CORE_H */
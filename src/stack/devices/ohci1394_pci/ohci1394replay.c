@@ -0,0 +1,511 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Replay of a bus capture (HHIOCMD_READCAPTURE records) on the software
+** controller model, for transaction layer regression benchmarks.
+**
+** Records are fed in order to the transaction layer, as the DMA handlers do:
+**  - a sent request is registered again (new tlabel, not transmitted),
+**  - its AT completion gives the recorded ack to the transaction callback,
+**  - a received response is given to ohci_TL_HandleResponse() with the tlabel
+**    of the replayed request,
+**  - a bus reset flushes the pending transactions,
+**  - a received request is injected in the model by its source peer, so it
+**    goes through the AR DMA path and the request handlers of the device.
+** Sent responses are skipped: the request handlers send them again.
+**
+** With rp_Speed set, records are given at the times of the capture (divided
+** by rp_Speed), else back-to-back. Only the captured prefix of a payload is
+** known, the rest is given as zeros.
+**
+*/
+
+#define NDEBUG
+
+#include "ohci1394sim.h"
+#include "ohci1394trans.h"
+
+#include "proto/helios.h"
+
+#include <clib/macros.h>
+
+#include <proto/exec.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+
+#include <string.h>
+#include <stddef.h>
+
+#define REPLAY_PAYLOAD_MAX      4096    /* S800 max payload */
+#define REPLAY_INJECT_RETRIES   10      /* 1ms waits on a full AR request queue */
+#define REPLAY_DRAIN_MS         20      /* Let the device handle the last injected requests */
+
+#define REPLAY_KEY(nodeid, tlabel) ((((nodeid) & 0x3f) << 6) | ((tlabel) & 0x3f))
+
+typedef struct ReplayData ReplayData;
+
+typedef struct ReplayTrans
+{
+    HeliosTransaction rt_Trans;
+    ReplayData *      rt_Replay;
+    ULONG             rt_Start;     /* Host time of the registration, in us */
+    ULONG             rt_Latency;
+    BYTE              rt_TLabel;    /* Given by the replay */
+    BOOL              rt_Leftover;  /* Cancelled at the end of the replay */
+    volatile BOOL     rt_Done;      /* Callback called */
+} ReplayTrans;
+
+struct ReplayData
+{
+    OHCI1394Unit *       rd_Unit;
+    OHCI1394Replay *     rd_Replay;
+    struct Library *     rd_TimerBase;
+    ReplayTrans *        rd_Trans;      /* One per replayed request */
+    ULONG                rd_TransCount;
+    ReplayTrans *        rd_Live[64*64];  /* Captured destination and tlabel to replayed request */
+    QUADLET              rd_Payload[REPLAY_PAYLOAD_MAX/sizeof(QUADLET)];
+};
+
+/*----------------------------------------------------------------------------*/
+/*--- LOCAL CODE SECTION -----------------------------------------------------*/
+
+static ULONG replay_Now(ReplayData *rd)
+{
+    struct Library *TimerBase = rd->rd_TimerBase;
+    struct timeval tv;
+
+    GetSysTime(&tv);
+    return tv.tv_secs * 1000000 + tv.tv_micro;
+}
+
+/* Called by the transaction layer, maybe from the SPLIT-TIMEOUT task */
+static void replay_TransCb(HeliosTransaction *t, BYTE status, QUADLET *payload, ULONG length)
+{
+    ReplayTrans *rt = t->htr_UserData;
+
+    rt->rt_Latency = replay_Now(rt->rt_Replay) - rt->rt_Start;
+    MEMORY_BARRIER();
+    rt->rt_Done = TRUE;
+}
+
+static BOOL replay_IsRequest(UBYTE tcode)
+{
+    switch (tcode)
+    {
+        case TCODE_WRITE_QUADLET_REQUEST:
+        case TCODE_WRITE_BLOCK_REQUEST:
+        case TCODE_READ_QUADLET_REQUEST:
+        case TCODE_READ_BLOCK_REQUEST:
+        case TCODE_LOCK_REQUEST:
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Copy the captured payload prefix, zeros after. Returns the payload length to give. */
+static ULONG replay_Payload(ReplayData *rd, HeliosCapturePacket *cp, ULONG length)
+{
+    length = MIN(length, REPLAY_PAYLOAD_MAX);
+    memset(rd->rd_Payload, 0, length);
+    CopyMem(cp->cp_Payload, rd->rd_Payload, MIN(length, cp->cp_CapLength));
+
+    return length;
+}
+
+/* Sent request: register a transaction for it */
+static void replay_SendRequest(ReplayData *rd, HeliosCapturePacket *cp)
+{
+    ReplayTrans *rt = &rd->rd_Trans[rd->rd_TransCount];
+    QUADLET *h = cp->cp_Header;
+    UBYTE tcode = AT_GET_HEADER_TCODE(h[0]);
+    UWORD destid = AT_GET_HEADER_DEST_ID(h[0]);
+    ULONG length = 0;
+
+    if ((TCODE_READ_BLOCK_REQUEST == tcode) || (TCODE_WRITE_BLOCK_REQUEST == tcode) || (TCODE_LOCK_REQUEST == tcode))
+    {
+        length = replay_Payload(rd, cp, AT_GET_HEADER_LEN(h[3]));
+    }
+
+    rt->rt_Replay = rd;
+    rt->rt_Trans.htr_Callback = replay_TransCb;
+    rt->rt_Trans.htr_UserData = rt;
+    rt->rt_Trans.htr_Packet.TLabel = -1;
+    rt->rt_Start = replay_Now(rd);
+
+    if (ohci_TL_PrepareRequest(rd->rd_Unit, &rt->rt_Trans, destid, cp->cp_Speed, tcode,
+                               AT_GET_HEADER_EXTCODE(h[3]), ((HeliosOffset)(h[1] & 0xffff) << 32) | h[2],
+                               TCODE_WRITE_QUADLET_REQUEST == tcode ? &h[3] : rd->rd_Payload, length))
+    {
+        rd->rd_Replay->rp_Errors++;
+        return;
+    }
+
+    rt->rt_TLabel = rt->rt_Trans.htr_Packet.TLabel;
+    rd->rd_Live[REPLAY_KEY(destid, AT_GET_HEADER_TLABEL(h[0]))] = rt;
+    rd->rd_TransCount++;
+    rd->rd_Replay->rp_Transactions++;
+}
+
+/* AT completion of a sent request: give the recorded ack as the AT handler does */
+static void replay_ATComplete(ReplayData *rd, HeliosCapturePacket *cp)
+{
+    OHCI1394Unit *unit = rd->rd_Unit;
+    QUADLET *h = cp->cp_Header;
+    ReplayTrans *rt = rd->rd_Live[REPLAY_KEY(AT_GET_HEADER_DEST_ID(h[0]), AT_GET_HEADER_TLABEL(h[0]))];
+    BYTE status = ohci_ATEventStatus(cp->cp_Event);
+
+    if (NULL == rt)
+    {
+        rd->rd_Replay->rp_Unmatched++;
+        return;
+    }
+
+    LOCK_REGION(unit);
+    {
+        OHCI1394ATPacketData *pdata = rt->rt_Trans.htr_Private;
+
+        /* NULL if already responded */
+        if (NULL != pdata)
+        {
+            pdata->pd_AckCallback(unit, status, cp->cp_TimeStamp, pdata);
+        }
+    }
+    UNLOCK_REGION(unit);
+}
+
+/* Received response: give it with the tlabel of the replayed request */
+static void replay_Response(ReplayData *rd, HeliosCapturePacket *cp)
+{
+    QUADLET *h = cp->cp_Header;
+    UWORD srcid = AT_GET_HEADER_SOURCE_ID(h[1]);
+    ReplayTrans *rt = rd->rd_Live[REPLAY_KEY(srcid, AT_GET_HEADER_TLABEL(h[0]))];
+    HeliosAPacket p;
+
+    if ((NULL == rt) || rt->rt_Done)
+    {
+        rd->rd_Replay->rp_Unmatched++;
+        return;
+    }
+
+    memset(&p, 0, sizeof(p));
+    CopyMem(h, p.Header, cp->cp_HeaderLength);
+    p.Header[0] = (h[0] & ~AT_HEADER_TLABEL(AT_HEADER_TLABEL_MSK)) | AT_HEADER_TLABEL(rt->rt_TLabel);
+    p.HeaderLength = cp->cp_HeaderLength;
+    p.TCode = AT_GET_HEADER_TCODE(h[0]);
+    p.TLabel = rt->rt_TLabel;
+    p.DestID = AT_GET_HEADER_DEST_ID(h[0]);
+    p.SourceID = srcid;
+    p.RCode = AT_GET_HEADER_RCODE(h[1]);
+    p.Ack = cp->cp_Event - 16;
+    p.TimeStamp = cp->cp_TimeStamp;
+
+    switch (p.TCode)
+    {
+        case TCODE_READ_QUADLET_RESPONSE:
+            p.QuadletData = h[3];
+            break;
+
+        case TCODE_READ_BLOCK_RESPONSE:
+        case TCODE_LOCK_RESPONSE:
+            p.PayloadLength = replay_Payload(rd, cp, AT_GET_HEADER_LEN(h[3]));
+            p.Payload = rd->rd_Payload;
+            break;
+    }
+
+    ohci_TL_HandleResponse(rd->rd_Unit, &p);
+}
+
+/* Received request: sent to the device by its source peer in the model */
+static void replay_Request(ReplayData *rd, HeliosCapturePacket *cp)
+{
+    QUADLET *h = cp->cp_Header;
+    HeliosAPacket p;
+    ULONG i;
+
+    memset(&p, 0, sizeof(p));
+    p.TCode = AT_GET_HEADER_TCODE(h[0]);
+    p.TLabel = AT_GET_HEADER_TLABEL(h[0]);
+    p.Offset = ((HeliosOffset)(h[1] & 0xffff) << 32) | h[2];
+    p.QuadletData = h[3];
+
+    if ((TCODE_READ_BLOCK_REQUEST == p.TCode) || (TCODE_WRITE_BLOCK_REQUEST == p.TCode) || (TCODE_LOCK_REQUEST == p.TCode))
+    {
+        p.ExtTCode = AT_GET_HEADER_EXTCODE(h[3]);
+        p.PayloadLength = replay_Payload(rd, cp, AT_GET_HEADER_LEN(h[3]));
+        p.Payload = rd->rd_Payload;
+    }
+
+    for (i=0; !ohcisim_InjectRequest(rd->rd_Unit->hu_PCI_BoardObject, AT_GET_HEADER_SOURCE_ID(h[1]) & 0x3f, &p); i++)
+    {
+        if (REPLAY_INJECT_RETRIES == i)
+        {
+            rd->rd_Replay->rp_Errors++;
+            return;
+        }
+
+        /* AR request queue full */
+        Helios_DelayMS(1);
+    }
+
+    rd->rd_Replay->rp_Requests++;
+}
+
+/* Cancel the replayed requests only, the unit may have other users */
+static void replay_BusReset(ReplayData *rd)
+{
+    ULONG i;
+
+    for (i=0; i < rd->rd_TransCount; i++)
+    {
+        if (!rd->rd_Trans[i].rt_Done)
+        {
+            ohci_TL_Cancel(rd->rd_Unit, &rd->rd_Trans[i].rt_Trans);
+        }
+    }
+
+    memset(rd->rd_Live, 0, sizeof(rd->rd_Live));
+    rd->rd_Replay->rp_BusResets++;
+}
+
+static void replay_Packet(ReplayData *rd, HeliosCapturePacket *cp)
+{
+    UBYTE tcode = AT_GET_HEADER_TCODE(cp->cp_Header[0]);
+
+    switch (cp->cp_Type)
+    {
+        case HCAPTURE_AT_SEND:
+            if (replay_IsRequest(tcode))
+            {
+                replay_SendRequest(rd, cp);
+            }
+            break;
+
+        case HCAPTURE_AT_COMPLETE:
+            if (replay_IsRequest(tcode))
+            {
+                replay_ATComplete(rd, cp);
+            }
+            break;
+
+        case HCAPTURE_AR:
+            if (OHCI1394_EVENT_BUS_RESET == cp->cp_Event)
+            {
+                replay_BusReset(rd);
+            }
+            else if (TCODE_WRITE_PHY == tcode)
+            {
+                break;
+            }
+            else if (replay_IsRequest(tcode))
+            {
+                replay_Request(rd, cp);
+            }
+            else
+            {
+                replay_Response(rd, cp);
+            }
+            break;
+    }
+}
+
+/* Wait up to the host time of a record */
+static void replay_Wait(ReplayData *rd, struct timerequest *tr, ULONG start, UQUAD ticks)
+{
+    ULONG due = start + (ticks / 24 - ticks / 1024) / rd->rd_Replay->rp_Speed;
+    LONG wait = due - replay_Now(rd);
+
+    if (wait > 0)
+    {
+        tr->tr_node.io_Command = TR_ADDREQUEST;
+        tr->tr_time.tv_secs = wait / 1000000;
+        tr->tr_time.tv_micro = wait % 1000000;
+        DoIO((struct IORequest *)tr);
+    }
+}
+
+static void replay_Sort(ULONG *array, ULONG count)
+{
+    ULONG gap, i, j;
+
+    for (gap=count/2; gap > 0; gap /= 2)
+    {
+        for (i=gap; i < count; i++)
+        {
+            ULONG value = array[i];
+
+            for (j=i; (j >= gap) && (array[j-gap] > value); j -= gap)
+            {
+                array[j] = array[j-gap];
+            }
+            array[j] = value;
+        }
+    }
+}
+
+/* Cancel the requests left pending, wait all callbacks and compute latencies */
+static void replay_Finish(ReplayData *rd, ULONG *latencies)
+{
+    OHCI1394Replay *replay = rd->rd_Replay;
+    ULONG i, count=0;
+
+    for (i=0; i < rd->rd_TransCount; i++)
+    {
+        ReplayTrans *rt = &rd->rd_Trans[i];
+
+        if (!rt->rt_Done)
+        {
+            rt->rt_Leftover = TRUE;
+            ohci_TL_Cancel(rd->rd_Unit, &rt->rt_Trans);
+            replay->rp_Unmatched++;
+        }
+    }
+
+    /* A SPLIT-TIMEOUT callback may be late */
+    for (i=0; i < rd->rd_TransCount; i++)
+    {
+        while (!rd->rd_Trans[i].rt_Done)
+        {
+            Helios_DelayMS(1);
+        }
+
+        if (!rd->rd_Trans[i].rt_Leftover)
+        {
+            latencies[count++] = rd->rd_Trans[i].rt_Latency;
+        }
+    }
+
+    replay->rp_Completed = count;
+    if (count > 0)
+    {
+        replay_Sort(latencies, count);
+        replay->rp_Latency[0] = latencies[(count - 1) * 50 / 100];
+        replay->rp_Latency[1] = latencies[(count - 1) * 90 / 100];
+        replay->rp_Latency[2] = latencies[(count - 1) * 99 / 100];
+        replay->rp_Latency[3] = latencies[count - 1];
+    }
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*--- PUBLIC CODE SECTION ----------------------------------------------------*/
+
+/* Called in the task of the HHIOCMD_SETATTRIBUTES caller */
+LONG ohcisim_Replay(OHCI1394Unit *unit, OHCI1394Replay *replay)
+{
+    OHCI1394SimStats stats[2];
+    struct MsgPort *port;
+    struct timerequest *tr;
+    ReplayData *rd;
+    ULONG *latencies;
+    ULONG i, start, allocs, last_ticks=0;
+    UQUAD ticks=0;
+    LONG err = HHIOERR_NOMEM;
+
+    _INFO_UNIT(unit, "Replay of %lu record(s), speed %lu\n", replay->rp_Count, replay->rp_Speed);
+
+    memset(&replay->rp_Transactions, 0,
+           sizeof(*replay) - offsetof(OHCI1394Replay, rp_Transactions));
+
+    rd = AllocVec(sizeof(*rd), MEMF_PUBLIC | MEMF_CLEAR);
+    latencies = AllocVec(replay->rp_Count * sizeof(ULONG) + 1, MEMF_PUBLIC);
+    port = CreateMsgPort();
+    tr = NULL != port ? Helios_OpenTimer(port, UNIT_MICROHZ) : NULL;
+    if ((NULL == rd) || (NULL == latencies) || (NULL == tr))
+    {
+        _ERR_UNIT(unit, "Replay setup failed\n");
+        goto out;
+    }
+
+    rd->rd_Trans = AllocVec(replay->rp_Count * sizeof(ReplayTrans) + 1, MEMF_PUBLIC | MEMF_CLEAR);
+    if (NULL == rd->rd_Trans)
+    {
+        _ERR_UNIT(unit, "AllocVec() failed\n");
+        goto out;
+    }
+
+    rd->rd_Unit = unit;
+    rd->rd_Replay = replay;
+    rd->rd_TimerBase = (struct Library *)tr->tr_node.io_Device;
+
+    ohcisim_GetStats(unit->hu_PCI_BoardObject, &stats[0]);
+    allocs = ATOMIC_FETCH((LONG *)&unit->hu_TLAllocs);
+    start = replay_Now(rd);
+
+    for (i=0; i < replay->rp_Count; i++)
+    {
+        HeliosCapturePacket *cp = &replay->rp_Packets[i];
+        ULONG t = HELIOS_CYCLE_TICKS(cp->cp_Time);
+
+        /* The cycle timer wraps every 128s, consecutive records are closer */
+        if (i > 0)
+        {
+            ticks += (t - last_ticks + HELIOS_CYCLE_WRAP) % HELIOS_CYCLE_WRAP;
+        }
+        last_ticks = t;
+
+        if (replay->rp_Speed > 0)
+        {
+            replay_Wait(rd, tr, start, ticks);
+        }
+
+        replay_Packet(rd, cp);
+    }
+
+    replay->rp_ElapsedUS = replay_Now(rd) - start;
+
+    Helios_DelayMS(REPLAY_DRAIN_MS);
+    replay_Finish(rd, latencies);
+
+    ohcisim_GetStats(unit->hu_PCI_BoardObject, &stats[1]);
+    replay->rp_TLAllocs = ATOMIC_FETCH((LONG *)&unit->hu_TLAllocs) - allocs;
+    replay->rp_ModelAllocs = stats[1].ss_Allocs - stats[0].ss_Allocs;
+
+    _INFO_UNIT(unit, "Replay done: %lu request(s), %lu completed, %lu unmatched, %lu error(s)\n",
+               replay->rp_Transactions, replay->rp_Completed, replay->rp_Unmatched, replay->rp_Errors);
+    err = HHIOERR_NO_ERROR;
+
+out:
+    if (NULL != rd)
+    {
+        if (NULL != rd->rd_Trans)
+        {
+            FreeVec(rd->rd_Trans);
+        }
+        FreeVec(rd);
+    }
+    if (NULL != latencies)
+    {
+        FreeVec(latencies);
+    }
+    if (NULL != tr)
+    {
+        Helios_CloseTimer(tr);
+    }
+    if (NULL != port)
+    {
+        DeleteMsgPort(port);
+    }
+
+    return err;
+}
+
+/* EOF */
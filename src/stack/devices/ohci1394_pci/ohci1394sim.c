@@ -0,0 +1,3005 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Software model of an OHCI 1394 controller, used in place of a real PCI
+** board when the device is built with OHCI1394_SIMULATOR.
+**
+** Follow the "1394 Open Host Controller Interface Specifications",
+** Release 1.1, Junary 6, 2000.
+**
+** The model implements what the driver uses:
+**  - the register file with set/clear pairs, PHY and CSR lock accesses,
+**  - AT contexts (immediate header + payload descriptors),
+**  - AR contexts in buffer-fill mode, with packets split across buffers,
+**  - IR contexts in packet-per-buffer and buffer-fill (multichannel) modes,
+**  - IT contexts with cycle match and skipped cycles,
+**  - bus reset: bus reset packet, self-ID buffer and generation count,
+**  - cycle timer and interrupt events (one IRQ handler call per step).
+**
+** The bus is a daisy chain of simulated peers (phy 0..n-1), the local node
+** being the root (phy n). Peers answer through a handler, the default one
+** provides a RAM window at offset 0, a minimal configuration ROM and
+** a write block generator to load the AR request context (OHCISIM_PEER_GENERATOR).
+**
+** Time is driven by ohcisim_Step(): a ticker subtask, running while the IRQ
+** is installed, advances the bus clock in real time and processes DMA programs
+** as soon as the driver runs or wakes a context. Benchmarks can disable the
+** real time clock (ohcisim_SetAutoStep) and step the model themselves.
+**
+*/
+
+//#define DEBUG_SIM
+
+#include "ohci1394sim.h"
+
+#include "proto/helios.h"
+
+#include <exec/errors.h>
+#include <hardware/byteswap.h>
+#include <clib/macros.h>
+
+#include <proto/exec.h>
+#include <proto/utility.h>
+
+#include <string.h>
+
+#ifdef DEBUG_SIM
+#define _INFO_SIM(s, fmt, args...) _INFO("[sim %lu] " fmt, (s)->ohs_Index ,##args)
+#else
+#define _INFO_SIM(s, fmt, args...)
+#endif
+#define _ERR_SIM(s, fmt, args...) _ERR("[sim %lu] " fmt, (s)->ohs_Index ,##args)
+
+#define SIM_CYCLES_PER_SECOND   8000
+#define SIM_CYCLE_US            125
+#define SIM_TASK_PRIO           22
+
+#define SIM_CTX_AT_REQ          0
+#define SIM_CTX_AT_RESP         1
+#define SIM_CTX_AR_REQ          2
+#define SIM_CTX_AR_RESP         3
+#define SIM_CTX_IT(n)           (4 + (n))
+#define SIM_CTX_IR(n)           (4 + OHCISIM_ISO_CTX_COUNT + (n))
+#define SIM_CTX_COUNT           (4 + 2 * OHCISIM_ISO_CTX_COUNT)
+
+#define SIM_CTX_TYPE_AT         0
+#define SIM_CTX_TYPE_AR         1
+#define SIM_CTX_TYPE_IT         2
+#define SIM_CTX_TYPE_IR         3
+
+#define SIM_ISO_CTX_MASK        ((1ul << OHCISIM_ISO_CTX_COUNT) - 1)
+#define SIM_IT_CYCLE_MATCH      (1ul << 31)
+#define SIM_IR_BUFFER_FILL      (1ul << 31)
+#define SIM_IR_ISOCH_HEADER     (1ul << 30)
+#define SIM_IR_MULTI_CHAN       (1ul << 28)
+#define SIM_IR_CTRL_BITS        (0xf8000000)
+#define SIM_IT_CTRL_BITS        (0xffff0000)
+
+#define SIM_ACK_EVENT(ack)      (0x10 + (ack))
+#define SIM_XFERSTATUS(ev)      (CTX_RUN | CTX_ACTIVE | (S400 << 5) | (ev))
+#define SIM_DESCRIPTOR(ptr)     ((OHCI1394Descriptor *)((ptr) & ~15))
+#define SIM_DESC_KEY(ctrl)      (((ctrl) >> 8) & 7)
+#define SIM_LOCAL_BUS           (0x3ff)
+
+#define REG(s, off)             ((s)->ohs_Regs[(off) / 4])
+
+/* Max size of a packet moved by the model (header + payload + trailer) */
+#define SIM_PACKET_MAX          (16 + 4096 + 4)
+
+#define PHY_REG_COUNT           16
+#define CSR_REG_COUNT           4
+
+#define SIM_ROM_QUADLETS        32
+
+/* SBP-2 disk target */
+#define SIM_SBP2_MGT_AGENT      (CSR_BASE_LO + 0x10000)
+#define SIM_SBP2_CMD_AGENT      (CSR_BASE_LO + 0x20000)
+#define SIM_SBP2_BLOCK_SIZE     512
+#define SIM_SBP2_AGENT_RESET    0
+#define SIM_SBP2_AGENT_ACTIVE   1
+#define SIM_SBP2_AGENT_SUSPENDED 2
+#define SIM_SBP2_NULL_ORB       0x80000000  /* next_ORB high quadlet */
+#define SIM_SBP2_ORB_READ       (1ul << 11)
+#define SIM_SBP2_ORB_PAGETABLE  (1ul << 3)
+#define SIM_CSR_BUSY_TIMEOUT    (CSR_BASE_LO + 0x210)
+
+/* DMA addresses are CPU addresses */
+#define SIM_HOST_PTR(addr)      ((APTR)(ULONG)(addr))
+
+
+/*----------------------------------------------------------------------------*/
+/*--- STRUCTURES SECTION -----------------------------------------------------*/
+
+typedef struct SimPacket
+{
+    struct MinNode      sp_Node;
+    ULONG               sp_AllocSize;
+    UQUAD               sp_DueCycle;    /* Not delivered before this bus cycle */
+    UBYTE               sp_Channel;     /* Iso packets only */
+    UBYTE               sp_Tag;
+    UBYTE               sp_Sy;
+    UBYTE               sp_Reserved;
+    ULONG               sp_Length;      /* Bytes in sp_Data */
+    QUADLET             sp_Data[0];     /* AR: packet as written in DMA buffers, IR: payload */
+} SimPacket;
+
+typedef struct SimContext
+{
+    UBYTE                   sc_Type;
+    UBYTE                   sc_Index;
+    UWORD                   sc_Reserved;
+    QUADLET                 sc_Control;
+    QUADLET                 sc_CommandPtr;
+    QUADLET                 sc_Match;       /* IR ContextMatch register */
+    OHCI1394Descriptor *    sc_Last;        /* Descriptor with a Z=0 branch where the context is stalled */
+} SimContext;
+
+typedef struct SimPeer
+{
+    OHCI1394SimPeerHandler  sp_Handler;
+    APTR                    sp_UData;
+    UBYTE *                 sp_Memory;      /* Default handler RAM, bus byte order */
+    QUADLET                 sp_Rom[SIM_ROM_QUADLETS]; /* Default handler config ROM, bus byte order */
+
+    /* Write block generator (OHCISIM_PEER_GENERATOR) */
+    ULONG                   sp_GenCount;    /* Requests still to send */
+    ULONG                   sp_GenLength;
+    HeliosOffset            sp_GenOffset;
+    UBYTE                   sp_GenTLabel;
+
+    /* SBP-2 disk target (OHCISIM_SBP2_TARGET) */
+    UBYTE *                 sp_Disk;
+    HeliosOffset            sp_StatusFIFO;
+    QUADLET                 sp_BusyTimeout;
+    ULONG                   sp_MgtORB;      /* Management ORB to execute, host address */
+    ULONG                   sp_AgentState;
+    ULONG                   sp_ORB;         /* Command ORB to execute, host address */
+    ULONG                   sp_LastORB;     /* Last executed ORB, its next_ORB is read again on doorbell */
+    UQUAD                   sp_ORBDue;      /* Cycle where the sp_ORB command completes, 0 if not started */
+    UQUAD                   sp_AgentFree;   /* Cycle where the previous command completed */
+    ULONG                   sp_HeadLBA;     /* Block following the last READ/WRITE */
+    ULONG                   sp_StatusLength; /* Bytes of sp_Status waiting a free AR slot */
+    QUADLET                 sp_Status[8];   /* Status block, bus byte order */
+} SimPeer;
+
+struct OHCI1394Sim
+{
+    LOCK_VARIABLE;
+
+    ULONG                   ohs_Index;
+    APTR                    ohs_Pool;
+
+    /* PCI board */
+    BOOL                    ohs_Attempted;
+    STRPTR                  ohs_Owner;
+    UWORD                   ohs_PCICommand;
+    UWORD                   ohs_PCIPower;
+    APTR                    ohs_RegsAlloc;
+    QUADLET *               ohs_Regs;       /* Register file, aligned on its size */
+
+    /* Interrupt */
+    struct
+    {
+        LOCK_VARIABLE;
+    }                       ohs_IrqLock;
+    ULONG                   (*ohs_IrqHandler)(APTR);
+    APTR                    ohs_IrqData;
+    HeliosSubTask *         ohs_Ticker;
+    ULONG                   ohs_TickerSignal;
+    BOOL                    ohs_AutoStep;
+
+    /* Link and PHY */
+    QUADLET                 ohs_CSRReadData;
+    QUADLET                 ohs_CSR[CSR_REG_COUNT];
+    UBYTE                   ohs_PhyRegs[PHY_REG_COUNT];
+    UBYTE                   ohs_Generation;
+    BOOL                    ohs_BusResetPending;
+    UQUAD                   ohs_Cycles;
+
+    /* DMA */
+    SimContext              ohs_Contexts[SIM_CTX_COUNT];
+    struct MinList          ohs_ARQueue[2];
+    ULONG                   ohs_ARQueueLength[2];
+    struct MinList          ohs_IsoQueue;
+    UBYTE                   ohs_TxBuffer[SIM_PACKET_MAX];
+    UBYTE                   ohs_RxBuffer[SIM_PACKET_MAX];
+
+    /* Bus */
+    ULONG                   ohs_PeerCount;  /* Applied at next bus reset */
+    ULONG                   ohs_NodeCount;  /* Peers on the bus since the last bus reset */
+    ULONG                   ohs_ResponseDelay;
+    SimPeer                 ohs_Peers[OHCISIM_MAX_PEERS];
+    OHCI1394SimIsoSink      ohs_IsoSink;
+    APTR                    ohs_IsoSinkData;
+
+    OHCI1394SimStats        ohs_Stats;
+};
+
+static struct
+{
+    struct Library          sb_Library;
+    ULONG                   sb_OpenCnt;
+    ULONG                   sb_BoardCount;
+    OHCI1394Sim *           sb_Boards[OHCISIM_MAX_BOARDS];
+} sim_Bus;
+
+
+/*----------------------------------------------------------------------------*/
+/*--- PRIVATE CODE SECTION ---------------------------------------------------*/
+
+static BOOL sim_IsBoard(APTR board)
+{
+    ULONG i;
+
+    for (i=0; i < sim_Bus.sb_BoardCount; i++)
+    {
+        if (sim_Bus.sb_Boards[i] == board)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static QUADLET sim_CycleTimer(OHCI1394Sim *sim)
+{
+    ULONG seconds = (sim->ohs_Cycles / SIM_CYCLES_PER_SECOND) & 0x7f;
+    ULONG cycles = sim->ohs_Cycles % SIM_CYCLES_PER_SECOND;
+
+    return (seconds << 25) | (cycles << 12);
+}
+
+static UWORD sim_TimeStamp(OHCI1394Sim *sim)
+{
+    return sim_CycleTimer(sim) >> 12;
+}
+
+static UWORD sim_LocalNodeID(OHCI1394Sim *sim)
+{
+    return REG(sim, OHCI1394_REG_NODE_ID) & 0xffff;
+}
+
+static SimPacket *sim_AllocPacket(OHCI1394Sim *sim, ULONG length)
+{
+    ULONG size = sizeof(SimPacket) + ((length + 3) & ~3);
+    SimPacket *pkt;
+
+    pkt = AllocPooled(sim->ohs_Pool, size);
+    if (NULL != pkt)
+    {
+        sim->ohs_Stats.ss_Allocs++;
+        pkt->sp_AllocSize = size;
+        pkt->sp_DueCycle = sim->ohs_Cycles;
+        pkt->sp_Length = length;
+    }
+    else
+    {
+        _ERR_SIM(sim, "AllocPooled() failed\n");
+    }
+
+    return pkt;
+}
+
+static void sim_FreePacket(OHCI1394Sim *sim, SimPacket *pkt)
+{
+    FreePooled(sim->ohs_Pool, pkt, pkt->sp_AllocSize);
+}
+
+static void sim_FlushQueue(OHCI1394Sim *sim, struct MinList *list)
+{
+    SimPacket *pkt, *next;
+
+    ForeachNodeSafe(list, pkt, next)
+    {
+        REMOVE(pkt);
+        sim_FreePacket(sim, pkt);
+    }
+}
+
+
+/*--- Generic context API ---*/
+static void sim_ContextLoad(SimContext *ctx, QUADLET cmdptr)
+{
+    if (0 != (cmdptr & 15))
+    {
+        ctx->sc_CommandPtr = cmdptr;
+        ctx->sc_Control |= CTX_ACTIVE;
+        ctx->sc_Last = NULL;
+    }
+    else
+    {
+        ctx->sc_Control &= ~CTX_ACTIVE;
+    }
+}
+
+/* Follow the branch of the last descriptor of the current block.
+ * Z=0 stalls the context until the next wake. */
+static BOOL sim_ContextBranch(SimContext *ctx, OHCI1394Descriptor *d)
+{
+    QUADLET branch = BE_SWAPLONG(d->d_BranchAddress);
+
+    if (0 != (branch & 15))
+    {
+        sim_ContextLoad(ctx, branch);
+        return TRUE;
+    }
+
+    ctx->sc_Control &= ~CTX_ACTIVE;
+    ctx->sc_Last = d;
+
+    return FALSE;
+}
+
+static BOOL sim_ContextReady(SimContext *ctx)
+{
+    if ((0 == (ctx->sc_Control & CTX_RUN)) || (0 != (ctx->sc_Control & CTX_DEAD)))
+    {
+        return FALSE;
+    }
+
+    /* A wake re-reads the branch of a stalled context */
+    if (ctx->sc_Control & CTX_WAKE)
+    {
+        ctx->sc_Control &= ~CTX_WAKE;
+        if ((0 == (ctx->sc_Control & CTX_ACTIVE)) && (NULL != ctx->sc_Last))
+        {
+            sim_ContextBranch(ctx, ctx->sc_Last);
+        }
+    }
+
+    return 0 != (ctx->sc_Control & CTX_ACTIVE);
+}
+
+static void sim_ContextDead(OHCI1394Sim *sim, SimContext *ctx, UBYTE event)
+{
+    _ERR_SIM(sim, "context type %u #%u dead, event $%02x, CmdPtr=$%08x\n",
+             ctx->sc_Type, ctx->sc_Index, event, ctx->sc_CommandPtr);
+
+    ctx->sc_Control = (ctx->sc_Control & ~(CTX_ACTIVE | 0x1f)) | CTX_DEAD | event;
+    REG(sim, OHCI1394_REG_INT_EVENT) |= OHCI1394_INTF_UNRECOVERABLEERROR;
+    sim->ohs_Stats.ss_DeadContexts++;
+}
+
+static void sim_ContextControl(OHCI1394Sim *sim, SimContext *ctx, QUADLET set, QUADLET clear)
+{
+    QUADLET old = ctx->sc_Control;
+    QUADLET writable = CTX_RUN | CTX_WAKE;
+
+    if (SIM_CTX_TYPE_IR == ctx->sc_Type)
+    {
+        writable |= SIM_IR_CTRL_BITS;
+    }
+    else if (SIM_CTX_TYPE_IT == ctx->sc_Type)
+    {
+        writable |= SIM_IT_CTRL_BITS;
+    }
+
+    ctx->sc_Control = (old | (set & writable)) & ~(clear & writable);
+
+    if ((old & CTX_RUN) && !(ctx->sc_Control & CTX_RUN))
+    {
+        /* The model never holds a descriptor between two steps: stop is immediate */
+        ctx->sc_Control &= ~(CTX_ACTIVE | CTX_DEAD | CTX_WAKE);
+        ctx->sc_Last = NULL;
+    }
+    else if (!(old & CTX_RUN) && (ctx->sc_Control & CTX_RUN))
+    {
+        ctx->sc_Control &= ~CTX_WAKE;
+        sim_ContextLoad(ctx, ctx->sc_CommandPtr);
+    }
+}
+
+static SimContext *sim_GetContext(OHCI1394Sim *sim, LONG offset, ULONG *reg)
+{
+    ULONG n;
+
+    if ((offset >= OHCI1394_REG_AREQT_CONTEXT_CONTROL) && (offset < OHCI1394_REG_IXMIT_CONTEXT_CONTROL(0)))
+    {
+        *reg = offset & 0x1f;
+        return &sim->ohs_Contexts[(offset - OHCI1394_REG_AREQT_CONTEXT_CONTROL) / 32];
+    }
+
+    if ((offset >= OHCI1394_REG_IXMIT_CONTEXT_CONTROL(0))
+        && (offset < OHCI1394_REG_IXMIT_CONTEXT_CONTROL(OHCISIM_ISO_CTX_COUNT)))
+    {
+        n = (offset - OHCI1394_REG_IXMIT_CONTEXT_CONTROL(0)) / 16;
+        *reg = offset & 0xf;
+        return &sim->ohs_Contexts[SIM_CTX_IT(n)];
+    }
+
+    if ((offset >= OHCI1394_REG_IRECV_CONTEXT_CONTROL(0))
+        && (offset < OHCI1394_REG_IRECV_CONTEXT_CONTROL(OHCISIM_ISO_CTX_COUNT)))
+    {
+        n = (offset - OHCI1394_REG_IRECV_CONTEXT_CONTROL(0)) / 32;
+        *reg = offset & 0x1f;
+        return &sim->ohs_Contexts[SIM_CTX_IR(n)];
+    }
+
+    return NULL;
+}
+
+
+/*--- Bus management ---*/
+static void sim_SignalTicker(OHCI1394Sim *sim)
+{
+    if (NULL != sim->ohs_Ticker)
+    {
+        Helios_SignalSubTask(sim->ohs_Ticker, sim->ohs_TickerSignal);
+    }
+}
+
+static QUADLET sim_SelfIDPacket(OHCI1394Sim *sim, ULONG phy, ULONG root)
+{
+    QUADLET q;
+    ULONG p0, p1, link, contender;
+
+    /* Daisy chain: phy n-1 is the child on port 0, phy n+1 the parent on port 1 */
+    if (phy == root)
+    {
+        link = (sim->ohs_PhyRegs[4] & PHYF_LINK_ACTIVE) ? 1 : 0;
+        contender = (sim->ohs_PhyRegs[4] & PHYF_CONTENDER) ? 1 : 0;
+        p0 = (phy > 0) ? 3 : 1;
+        p1 = 1;
+    }
+    else
+    {
+        link = 1;
+        contender = 0;
+        p0 = (phy > 0) ? 3 : 2;
+        p1 = (phy > 0) ? 2 : 1;
+    }
+
+    q  = (2ul << 30) | (phy << 24) | (link << 22);
+    q |= (sim->ohs_PhyRegs[1] & 0x3f) << 16;
+    q |= S400 << 14;
+    q |= contender << 11;
+    q |= (p0 << 6) | (p1 << 4) | (1 << 2);
+    q |= (phy == root) ? 2 : 0; /* initiated reset */
+
+    return q;
+}
+
+static void sim_DoBusReset(OHCI1394Sim *sim)
+{
+    QUADLET *selfid = (QUADLET *)REG(sim, OHCI1394_REG_SELFID_BUFFER);
+    QUADLET node_id;
+    ULONG i, local;
+
+    sim->ohs_BusResetPending = FALSE;
+    sim->ohs_Generation++;
+    sim->ohs_Stats.ss_BusResets++;
+
+    /* Peers forget pending transactions */
+    sim->ohs_ARQueueLength[1] = 0;
+    sim_FlushQueue(sim, &sim->ohs_ARQueue[1]);
+    for (i=0; i < OHCISIM_MAX_PEERS; i++)
+    {
+        sim->ohs_Peers[i].sp_GenCount = 0;
+    }
+
+    sim->ohs_NodeCount = sim->ohs_PeerCount;
+    local = sim->ohs_NodeCount;
+
+    sim->ohs_PhyRegs[0] = (local << 2) | 0x02; /* PhyID, R=1 */
+
+    node_id = REG(sim, OHCI1394_REG_NODE_ID) & OHCI1394_NODEID_BUSNUMBER_MASK;
+    node_id |= OHCI1394_NODEIDF_IDVALID | OHCI1394_NODEIDF_ROOT | local;
+    REG(sim, OHCI1394_REG_NODE_ID) = node_id;
+
+    _INFO_SIM(sim, "bus reset: gen=%u, %lu node(s), local=$%04x\n",
+              sim->ohs_Generation, local + 1, node_id & 0xffff);
+
+    REG(sim, OHCI1394_REG_INT_EVENT) |= OHCI1394_INTF_BUSRESET;
+
+    if (0 == (REG(sim, OHCI1394_REG_HC_CONTROL) & OHCI1394_HCCF_LINKENABLE))
+    {
+        return;
+    }
+
+    /* Bus reset packet, in order with the received requests */
+    if (sim->ohs_Contexts[SIM_CTX_AR_REQ].sc_Control & CTX_RUN)
+    {
+        SimPacket *pkt = sim_AllocPacket(sim, 16);
+
+        if (NULL != pkt)
+        {
+            pkt->sp_Data[0] = BE_SWAPLONG(TCODE_WRITE_PHY << 4);
+            pkt->sp_Data[1] = 0;
+            pkt->sp_Data[2] = BE_SWAPLONG(sim->ohs_Generation << 16);
+            pkt->sp_Data[3] = BE_SWAPLONG((SIM_XFERSTATUS(OHCI1394_EVENT_BUS_RESET) << 16) | sim_TimeStamp(sim));
+
+            ADDTAIL(&sim->ohs_ARQueue[0], pkt);
+            sim->ohs_ARQueueLength[0]++;
+        }
+    }
+
+    if ((REG(sim, OHCI1394_REG_LINK_CONTROL) & OHCI1394_LCF_RCVSELFID) && (NULL != selfid))
+    {
+        selfid[0] = BE_SWAPLONG((sim->ohs_Generation << 16) | sim_TimeStamp(sim));
+        for (i=0; i <= local; i++)
+        {
+            QUADLET q = sim_SelfIDPacket(sim, i, local);
+
+            selfid[1 + 2*i] = BE_SWAPLONG(q);
+            selfid[2 + 2*i] = BE_SWAPLONG(~q);
+        }
+
+        REG(sim, OHCI1394_REG_SELFID_COUNT) = (sim->ohs_Generation << OHCI1394_SELFIDCOUNTB_SELFIDGENERATION)
+            | ((1 + 2 * (local + 1)) << OHCI1394_SELFIDCOUNTB_SELFIDSIZE);
+
+        REG(sim, OHCI1394_REG_INT_EVENT) |= OHCI1394_INTF_SELFIDCOMPLETE | OHCI1394_INTF_SELFIDCOMPLETE2;
+    }
+}
+
+static void sim_PhyWrite(OHCI1394Sim *sim, ULONG addr, UBYTE data)
+{
+    _INFO_SIM(sim, "PHY[%lu] <- $%02x\n", addr, data);
+
+    switch (addr)
+    {
+        case 0: /* read-only */
+            return;
+
+        case 1:
+            if (data & PHYF_BUS_RESET)
+            {
+                sim->ohs_BusResetPending = TRUE;
+                data &= ~PHYF_BUS_RESET;
+            }
+            break;
+
+        case 5:
+            if (data & PHYF_SHORT_BUS_RESET)
+            {
+                sim->ohs_BusResetPending = TRUE;
+                data &= ~PHYF_SHORT_BUS_RESET;
+            }
+            break;
+    }
+
+    sim->ohs_PhyRegs[addr] = data;
+}
+
+static void sim_PhyPacket(OHCI1394Sim *sim, QUADLET q)
+{
+    /* PHY configuration packet with T bit: new gap count for all nodes */
+    if ((0 == (q >> 30)) && (q & (1 << 22)))
+    {
+        sim->ohs_PhyRegs[1] = (sim->ohs_PhyRegs[1] & ~0x3f) | ((q >> 16) & 0x3f);
+    }
+}
+
+static void sim_SoftReset(OHCI1394Sim *sim)
+{
+    ULONG i;
+
+    _INFO_SIM(sim, "soft reset\n");
+
+    for (i=0; i < SIM_CTX_COUNT; i++)
+    {
+        SimContext *ctx = &sim->ohs_Contexts[i];
+
+        ctx->sc_Control = 0;
+        ctx->sc_Last = NULL;
+    }
+
+    for (i=0; i < 2; i++)
+    {
+        sim_FlushQueue(sim, &sim->ohs_ARQueue[i]);
+        sim->ohs_ARQueueLength[i] = 0;
+    }
+    sim_FlushQueue(sim, &sim->ohs_IsoQueue);
+
+    REG(sim, OHCI1394_REG_HC_CONTROL) &= OHCI1394_HCCF_LPS;
+    REG(sim, OHCI1394_REG_LINK_CONTROL) = 0;
+    REG(sim, OHCI1394_REG_INT_EVENT) = 0;
+    REG(sim, OHCI1394_REG_INT_MASK) = 0;
+    REG(sim, OHCI1394_REG_ISO_XMIT_INT_EVENT) = 0;
+    REG(sim, OHCI1394_REG_ISO_XMIT_INT_MASK) = 0;
+    REG(sim, OHCI1394_REG_ISO_RECV_INT_EVENT) = 0;
+    REG(sim, OHCI1394_REG_ISO_RECV_INT_MASK) = 0;
+    REG(sim, OHCI1394_REG_ASYNCH_REQ_FILTER_HI) = 0;
+    REG(sim, OHCI1394_REG_ASYNCH_REQ_FILTER_LO) = 0;
+    REG(sim, OHCI1394_REG_PHYREQ_REQ_FILTER_HI) = 0;
+    REG(sim, OHCI1394_REG_PHYREQ_REQ_FILTER_LO) = 0;
+    REG(sim, OHCI1394_REG_NODE_ID) = OHCI1394_NODEID_BUSNUMBER_MASK | 0x3f;
+    REG(sim, OHCI1394_REG_SELFID_COUNT) = 0;
+    REG(sim, OHCI1394_REG_PHY_CONTROL) = 0;
+    REG(sim, OHCI1394_REG_CSR_CONTROL) = OHCI1394_CSRCTRLF_DONE;
+
+    sim->ohs_CSR[0] = 0x3f;         /* BUS_MANAGER_ID */
+    sim->ohs_CSR[1] = 4915;         /* BANDWIDTH_AVAILABLE */
+    sim->ohs_CSR[2] = ~0;           /* CHANNELS_AVAILABLE_HI */
+    sim->ohs_CSR[3] = ~0;           /* CHANNELS_AVAILABLE_LO */
+    sim->ohs_BusResetPending = FALSE;
+}
+
+static void sim_CompareSwap(OHCI1394Sim *sim, QUADLET control)
+{
+    ULONG sel = control & 3;
+    QUADLET old = sim->ohs_CSR[sel];
+
+    if (old == REG(sim, OHCI1394_REG_CSR_COMPARE_DATA))
+    {
+        sim->ohs_CSR[sel] = REG(sim, OHCI1394_REG_CSR_WRITE_DATA);
+    }
+
+    sim->ohs_CSRReadData = old;
+    REG(sim, OHCI1394_REG_CSR_CONTROL) = OHCI1394_CSRCTRLF_DONE | sel;
+}
+
+static BOOL sim_IrqPending(OHCI1394Sim *sim)
+{
+    QUADLET mask = REG(sim, OHCI1394_REG_INT_MASK);
+    QUADLET events = REG(sim, OHCI1394_REG_INT_EVENT);
+
+    if (REG(sim, OHCI1394_REG_ISO_XMIT_INT_EVENT) & REG(sim, OHCI1394_REG_ISO_XMIT_INT_MASK))
+    {
+        events |= OHCI1394_INTF_ISOCHTX;
+    }
+    if (REG(sim, OHCI1394_REG_ISO_RECV_INT_EVENT) & REG(sim, OHCI1394_REG_ISO_RECV_INT_MASK))
+    {
+        events |= OHCI1394_INTF_ISOCHRX;
+    }
+
+    return (mask & OHCI1394_INTF_MASTERINTENABLE) && (events & mask & ~OHCI1394_INTF_MASTERINTENABLE);
+}
+
+
+/*--- Asynchronous packets ---*/
+
+/* Build the HeliosAPacket view of a packet sent by the driver */
+static void sim_DecodeATPacket(OHCI1394Sim *sim, QUADLET *header, ULONG hlen,
+                               UBYTE *payload, ULONG plen, HeliosAPacket *p)
+{
+    memset(p, 0, sizeof(*p));
+
+    CopyMem(header, p->Header, sizeof(p->Header));
+    p->HeaderLength = hlen;
+    p->TCode = AT_GET_HEADER_TCODE(header[0]);
+    p->TLabel = AT_GET_HEADER_TLABEL(header[0]);
+    p->Retry = AT_GET_HEADER_RT(header[0]);
+    p->Speed = AT_GET_HEADER_SPEED(header[0]);
+    p->DestID = AT_GET_HEADER_DEST_ID(header[1]);
+    p->SourceID = sim_LocalNodeID(sim);
+    p->Offset = ((HeliosOffset)(header[1] & 0xffff) << 32) | header[2];
+    p->RCode = AT_GET_HEADER_RCODE(header[1]);
+    p->TimeStamp = sim_TimeStamp(sim);
+
+    switch (p->TCode)
+    {
+        case TCODE_WRITE_QUADLET_REQUEST:
+        case TCODE_READ_QUADLET_RESPONSE:
+            p->QuadletData = header[3];
+            p->Payload = &p->QuadletData;
+            p->PayloadLength = sizeof(QUADLET);
+            break;
+
+        case TCODE_READ_BLOCK_REQUEST:
+        case TCODE_WRITE_BLOCK_REQUEST:
+        case TCODE_LOCK_REQUEST:
+        case TCODE_READ_BLOCK_RESPONSE:
+        case TCODE_LOCK_RESPONSE:
+            p->PayloadLength = AT_GET_HEADER_LEN(header[3]);
+            p->ExtTCode = AT_GET_HEADER_EXTCODE(header[3]);
+            p->Payload = plen ? (QUADLET *)payload : NULL;
+            break;
+    }
+}
+
+/* Build an AR packet image: header as LE quadlets (quadlet data untouched),
+ * payload as bus bytes, and the trailer. */
+static SimPacket *sim_BuildARPacket(OHCI1394Sim *sim, QUADLET *header, ULONG hlen,
+                                    const UBYTE *payload, ULONG plen, UBYTE ack)
+{
+    UBYTE tcode = AT_GET_HEADER_TCODE(header[0]);
+    ULONG len = ((hlen + plen + 3) & ~3) + 4;
+    SimPacket *pkt;
+    ULONG i;
+
+    if (len > SIM_PACKET_MAX)
+    {
+        _ERR_SIM(sim, "packet too large (%lu bytes)\n", len);
+        return NULL;
+    }
+
+    pkt = sim_AllocPacket(sim, len);
+    if (NULL == pkt)
+    {
+        return NULL;
+    }
+
+    for (i=0; i < hlen/4; i++)
+    {
+        pkt->sp_Data[i] = BE_SWAPLONG(header[i]);
+    }
+
+    if ((TCODE_WRITE_QUADLET_REQUEST == tcode) || (TCODE_READ_QUADLET_RESPONSE == tcode))
+    {
+        pkt->sp_Data[3] = header[3];
+    }
+
+    if (plen > 0)
+    {
+        pkt->sp_Data[(len / 4) - 2] = 0; /* padding */
+        CopyMem((APTR)payload, &pkt->sp_Data[hlen/4], plen);
+    }
+
+    pkt->sp_Data[(len / 4) - 1] = BE_SWAPLONG((SIM_XFERSTATUS(SIM_ACK_EVENT(ack)) << 16) | sim_TimeStamp(sim));
+
+    return pkt;
+}
+
+static BOOL sim_QueueARPacket(OHCI1394Sim *sim, ULONG queue, SimPacket *pkt)
+{
+    if (sim->ohs_ARQueueLength[queue] >= OHCISIM_AR_QUEUE_MAX)
+    {
+        sim->ohs_Stats.ss_ARDrops[queue]++;
+        sim_FreePacket(sim, pkt);
+        return FALSE;
+    }
+
+    ADDTAIL(&sim->ohs_ARQueue[queue], pkt);
+    sim->ohs_ARQueueLength[queue]++;
+
+    return TRUE;
+}
+
+/* Queue a request sent by a peer to the local node (model locked) */
+static BOOL sim_InjectRequest(OHCI1394Sim *sim, UBYTE phy_id, HeliosAPacket *req)
+{
+    QUADLET header[4];
+    ULONG hlen = 16, plen = 0;
+    QUADLET filter;
+    SimPacket *pkt;
+
+    if (phy_id >= sim->ohs_NodeCount)
+    {
+        return FALSE;
+    }
+
+    /* Asynchronous request filters */
+    if (phy_id < 32)
+    {
+        filter = REG(sim, OHCI1394_REG_ASYNCH_REQ_FILTER_LO) & (1ul << phy_id);
+    }
+    else
+    {
+        filter = REG(sim, OHCI1394_REG_ASYNCH_REQ_FILTER_HI) & (1ul << (phy_id - 32));
+    }
+
+    if ((0 == filter) && (0 == (REG(sim, OHCI1394_REG_ASYNCH_REQ_FILTER_HI) & 0x80000000)))
+    {
+        return FALSE;
+    }
+
+    header[0] = AT_HEADER_DEST_ID(sim_LocalNodeID(sim)) | AT_HEADER_TLABEL(req->TLabel)
+        | AT_HEADER_RT(1 /* retry_X */) | AT_HEADER_TCODE(req->TCode);
+    header[1] = ((QUADLET)(0xffc0 | phy_id) << 16) | ((req->Offset >> 32) & 0xffff);
+    header[2] = req->Offset & 0xffffffff;
+    header[3] = 0;
+
+    switch (req->TCode)
+    {
+        case TCODE_READ_QUADLET_REQUEST:
+            hlen = 12;
+            break;
+
+        case TCODE_WRITE_QUADLET_REQUEST:
+            header[3] = req->QuadletData;
+            break;
+
+        case TCODE_READ_BLOCK_REQUEST:
+            header[3] = AT_HEADER_LEN(req->PayloadLength) | AT_HEADER_EXTCODE(req->ExtTCode);
+            break;
+
+        case TCODE_WRITE_BLOCK_REQUEST:
+        case TCODE_LOCK_REQUEST:
+            plen = req->PayloadLength;
+            header[3] = AT_HEADER_LEN(plen) | AT_HEADER_EXTCODE(req->ExtTCode);
+            break;
+
+        default:
+            return FALSE;
+    }
+
+    pkt = sim_BuildARPacket(sim, header, hlen, (UBYTE *)req->Payload, plen, HELIOS_ACK_PENDING);
+    if (NULL == pkt)
+    {
+        return FALSE;
+    }
+
+    return sim_QueueARPacket(sim, 0, pkt);
+}
+
+static void sim_QueueResponse(OHCI1394Sim *sim, UBYTE phy_id, HeliosAPacket *req, HeliosAPacket *resp)
+{
+    QUADLET header[4];
+    ULONG hlen = 16, plen = 0;
+    UBYTE tcode;
+    SimPacket *pkt;
+
+    switch (req->TCode)
+    {
+        case TCODE_WRITE_QUADLET_REQUEST:
+        case TCODE_WRITE_BLOCK_REQUEST:
+            tcode = TCODE_WRITE_RESPONSE;
+            hlen = 12;
+            break;
+
+        case TCODE_READ_QUADLET_REQUEST:
+            tcode = TCODE_READ_QUADLET_RESPONSE;
+            break;
+
+        case TCODE_READ_BLOCK_REQUEST:
+            tcode = TCODE_READ_BLOCK_RESPONSE;
+            plen = resp->PayloadLength;
+            break;
+
+        case TCODE_LOCK_REQUEST:
+            tcode = TCODE_LOCK_RESPONSE;
+            plen = resp->PayloadLength;
+            break;
+
+        default:
+            return;
+    }
+
+    if (HELIOS_RCODE_COMPLETE != resp->RCode)
+    {
+        plen = 0;
+    }
+
+    header[0] = AT_HEADER_DEST_ID(req->SourceID) | AT_HEADER_TLABEL(req->TLabel)
+        | AT_HEADER_RT(1 /* retry_X */) | AT_HEADER_TCODE(tcode);
+    header[1] = ((QUADLET)(0xffc0 | phy_id) << 16) | ((resp->RCode & 0xf) << AT_HEADER_RCODE_SHIFT);
+    header[2] = 0;
+
+    if (TCODE_READ_QUADLET_RESPONSE == tcode)
+    {
+        header[3] = resp->QuadletData;
+    }
+    else
+    {
+        header[3] = AT_HEADER_LEN(plen) | AT_HEADER_EXTCODE(req->ExtTCode);
+    }
+
+    pkt = sim_BuildARPacket(sim, header, hlen, (UBYTE *)resp->Payload, plen, HELIOS_ACK_COMPLETE);
+    if (NULL != pkt)
+    {
+        pkt->sp_DueCycle = sim->ohs_Cycles + sim->ohs_ResponseDelay;
+        sim_QueueARPacket(sim, 1, pkt);
+    }
+}
+
+/* Deliver a packet sent by an AT context, returns the AT event code */
+static UBYTE sim_Transmit(OHCI1394Sim *sim, QUADLET *header, ULONG hlen, UBYTE *payload, ULONG plen, BOOL response)
+{
+    HeliosAPacket req, resp;
+    SimPeer *peer;
+    UBYTE tcode = AT_GET_HEADER_TCODE(header[0]);
+    UWORD dest;
+    BYTE ack;
+
+    if (TCODE_WRITE_PHY == tcode)
+    {
+        sim_PhyPacket(sim, header[1]);
+        return SIM_ACK_EVENT(HELIOS_ACK_COMPLETE);
+    }
+
+    /* AT contexts don't transmit until the BusReset event is cleared */
+    if (REG(sim, OHCI1394_REG_INT_EVENT) & OHCI1394_INTF_BUSRESET)
+    {
+        return OHCI1394_EVENT_FLUSHED;
+    }
+
+    if (TCODE_WRITE_STREAM == tcode)
+    {
+        return SIM_ACK_EVENT(HELIOS_ACK_COMPLETE);
+    }
+
+    sim_DecodeATPacket(sim, header, hlen, payload, plen, &req);
+    dest = req.DestID;
+
+    if (((dest >> 6) != SIM_LOCAL_BUS)
+        && ((dest >> 6) != OHCI1394_NODEID_BUSNUMBER(REG(sim, OHCI1394_REG_NODE_ID))))
+    {
+        sim->ohs_Stats.ss_MissingAcks++;
+        return OHCI1394_EVENT_MISSING_ACK;
+    }
+
+    /* Broadcast: all peers see it, nobody acks */
+    if (0x3f == (dest & 0x3f))
+    {
+        ULONG i;
+
+        for (i=0; i < sim->ohs_NodeCount; i++)
+        {
+            peer = &sim->ohs_Peers[i];
+            memset(&resp, 0, sizeof(resp));
+            peer->sp_Handler(sim, i, &req, &resp, peer->sp_UData);
+        }
+
+        return SIM_ACK_EVENT(HELIOS_ACK_COMPLETE);
+    }
+
+    if ((dest & 0x3f) >= sim->ohs_NodeCount)
+    {
+        sim->ohs_Stats.ss_MissingAcks++;
+        return OHCI1394_EVENT_MISSING_ACK;
+    }
+
+    peer = &sim->ohs_Peers[dest & 0x3f];
+
+    if (response)
+    {
+        sim->ohs_Stats.ss_PeerResponses++;
+        ack = peer->sp_Handler(sim, dest & 0x3f, &req, NULL, peer->sp_UData);
+    }
+    else
+    {
+        memset(&resp, 0, sizeof(resp));
+        resp.RCode = HELIOS_RCODE_COMPLETE;
+
+        ack = peer->sp_Handler(sim, dest & 0x3f, &req, &resp, peer->sp_UData);
+        if (HELIOS_ACK_PENDING == ack)
+        {
+            sim_QueueResponse(sim, dest & 0x3f, &req, &resp);
+        }
+    }
+
+    return SIM_ACK_EVENT(ack & 0xf);
+}
+
+static ULONG sim_ATRun(OHCI1394Sim *sim, SimContext *ctx)
+{
+    BOOL response = SIM_CTX_AT_RESP == ctx->sc_Index;
+    ULONG count = 0;
+
+    while (sim_ContextReady(ctx))
+    {
+        OHCI1394Descriptor *d = SIM_DESCRIPTOR(ctx->sc_CommandPtr);
+        OHCI1394Descriptor *last = NULL;
+        ULONG z = ctx->sc_CommandPtr & 15;
+        QUADLET header[4] = {0, 0, 0, 0};
+        ULONG i, j, hlen = 0, plen = 0;
+        UWORD ctrl = 0;
+        UBYTE event;
+
+        for (i=0; i < z; i++)
+        {
+            ULONG reqcount = BE_SWAPWORD(d[i].d_ReqCount);
+
+            ctrl = BE_SWAPWORD(d[i].d_Control);
+            if (2 == SIM_DESC_KEY(ctrl))
+            {
+                /* Immediate data are stored in the next 16 bytes */
+                QUADLET *q = (QUADLET *)&d[i+1];
+
+                hlen = MIN(reqcount, sizeof(header));
+                for (j=0; j < hlen/4; j++)
+                {
+                    header[j] = BE_SWAPLONG(q[j]);
+                }
+            }
+            else if (plen + reqcount <= sizeof(sim->ohs_TxBuffer))
+            {
+                CopyMem((APTR)BE_SWAPLONG(d[i].d_DataAddress), sim->ohs_TxBuffer + plen, reqcount);
+                plen += reqcount;
+            }
+            else
+            {
+                break;
+            }
+
+            if (DESCRIPTOR_OUTPUT_LAST == (ctrl & 0xf000))
+            {
+                last = &d[i];
+                break;
+            }
+
+            if (2 == SIM_DESC_KEY(ctrl))
+            {
+                i++;
+            }
+        }
+
+        if ((NULL == last) || (0 == hlen))
+        {
+            sim_ContextDead(sim, ctx, OHCI1394_EVENT_DESCRIPTOR_READ);
+            break;
+        }
+
+        event = sim_Transmit(sim, header, hlen, sim->ohs_TxBuffer, plen, response);
+        count++;
+
+        sim->ohs_Stats.ss_ATPackets[response]++;
+        sim->ohs_Stats.ss_ATBytes[response] += hlen + plen;
+
+        last->d_TimeStamp = BE_SWAPWORD(sim_TimeStamp(sim));
+        last->d_TransferStatus = BE_SWAPWORD(SIM_XFERSTATUS(event));
+        ctx->sc_Control = (ctx->sc_Control & ~0x1f) | event;
+
+        if ((DESCRIPTOR_IRQ_ALWAYS == (ctrl & DESCRIPTOR_IRQ_ALWAYS))
+            || ((ctrl & DESCRIPTOR_IRQ_ERROR) && (SIM_ACK_EVENT(HELIOS_ACK_COMPLETE) != event)
+                && (SIM_ACK_EVENT(HELIOS_ACK_PENDING) != event)))
+        {
+            REG(sim, OHCI1394_REG_INT_EVENT) |= response ? OHCI1394_INTF_RESPTXCOMPLETE : OHCI1394_INTF_REQTXCOMPLETE;
+        }
+
+        sim_ContextBranch(ctx, last);
+    }
+
+    return count;
+}
+
+/* Write one packet in the AR buffer-fill program, FALSE if no space yet */
+static BOOL sim_ARWrite(OHCI1394Sim *sim, SimContext *ctx, SimPacket *pkt)
+{
+    OHCI1394Descriptor *d;
+    ULONG len = pkt->sp_Length, done = 0;
+    ULONG avail;
+
+    if (!sim_ContextReady(ctx))
+    {
+        return FALSE;
+    }
+
+    d = SIM_DESCRIPTOR(ctx->sc_CommandPtr);
+    avail = BE_SWAPWORD(d->d_ResCount);
+
+    /* The packet may be split with the next buffer, if already given to the DMA */
+    if (avail < len)
+    {
+        QUADLET branch = BE_SWAPLONG(d->d_BranchAddress);
+
+        if ((0 == (branch & 15))
+            || ((avail + BE_SWAPWORD(SIM_DESCRIPTOR(branch)->d_ResCount)) < len))
+        {
+            return FALSE;
+        }
+    }
+
+    while (done < len)
+    {
+        ULONG reqcount = BE_SWAPWORD(d->d_ReqCount);
+        ULONG rescount = BE_SWAPWORD(d->d_ResCount);
+        ULONG n = MIN(rescount, len - done);
+
+        CopyMem((UBYTE *)pkt->sp_Data + done,
+                (UBYTE *)BE_SWAPLONG(d->d_DataAddress) + (reqcount - rescount), n);
+        done += n;
+        rescount -= n;
+
+        d->d_ResCount = BE_SWAPWORD(rescount);
+        d->d_TransferStatus = BE_SWAPWORD(SIM_XFERSTATUS(OHCI1394_EVENT_ACK_COMPLETE));
+
+        if (0 == rescount)
+        {
+            sim_ContextBranch(ctx, d);
+            if (done < len)
+            {
+                d = SIM_DESCRIPTOR(ctx->sc_CommandPtr);
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+static ULONG sim_ARRun(OHCI1394Sim *sim, SimContext *ctx)
+{
+    ULONG queue = ctx->sc_Index - SIM_CTX_AR_REQ;
+    SimPacket *pkt;
+    ULONG count = 0;
+
+    while (NULL != (pkt = (SimPacket *)GetHead(&sim->ohs_ARQueue[queue])))
+    {
+        if ((pkt->sp_DueCycle > sim->ohs_Cycles) || !sim_ARWrite(sim, ctx, pkt))
+        {
+            break;
+        }
+
+        REMOVE(pkt);
+        sim->ohs_ARQueueLength[queue]--;
+        sim->ohs_Stats.ss_ARPackets[queue]++;
+        sim->ohs_Stats.ss_ARBytes[queue] += pkt->sp_Length;
+        sim_FreePacket(sim, pkt);
+        count++;
+
+        REG(sim, OHCI1394_REG_INT_EVENT) |= queue ? OHCI1394_INTF_RSPKT : OHCI1394_INTF_RQPKT;
+    }
+
+    return count;
+}
+
+
+/*--- Isochronous packets ---*/
+static BOOL sim_IRMatch(OHCI1394Sim *sim, SimContext *ctx, SimPacket *pkt)
+{
+    if (ctx->sc_Control & SIM_IR_MULTI_CHAN)
+    {
+        if (pkt->sp_Channel < 32)
+        {
+            return 0 != (REG(sim, OHCI1394_REG_IR_MULTICHAN_MASK_LO) & (1ul << pkt->sp_Channel));
+        }
+
+        return 0 != (REG(sim, OHCI1394_REG_IR_MULTICHAN_MASK_HI) & (1ul << (pkt->sp_Channel - 32)));
+    }
+
+    return ((ctx->sc_Match & 0x3f) == pkt->sp_Channel)
+        && (0 != (ctx->sc_Match & (1ul << (28 + pkt->sp_Tag))));
+}
+
+/* Packet-per-buffer: one packet per descriptor block, the status is written
+ * in the descriptor where the packet ends. */
+static void sim_IRWrite(OHCI1394Sim *sim, SimContext *ctx, SimPacket *pkt)
+{
+    OHCI1394Descriptor *d = SIM_DESCRIPTOR(ctx->sc_CommandPtr);
+    OHCI1394Descriptor *status_d = NULL;
+    ULONG z = ctx->sc_CommandPtr & 15;
+    UBYTE *stream = sim->ohs_RxBuffer;
+    ULONG i, len = 0, done = 0;
+    UBYTE event = OHCI1394_EVENT_ACK_COMPLETE;
+
+    if (ctx->sc_Control & SIM_IR_ISOCH_HEADER)
+    {
+        QUADLET q = (pkt->sp_Length << 16) | (pkt->sp_Tag << 14) | (pkt->sp_Channel << 8)
+            | (TCODE_WRITE_STREAM << 4) | pkt->sp_Sy;
+
+        *(QUADLET *)stream = BE_SWAPLONG(q);
+        len = 4;
+    }
+
+    CopyMem(pkt->sp_Data, stream + len, pkt->sp_Length);
+    len += (pkt->sp_Length + 3) & ~3;
+
+    if (ctx->sc_Control & SIM_IR_ISOCH_HEADER)
+    {
+        *(QUADLET *)(stream + len) = BE_SWAPLONG((SIM_XFERSTATUS(event) << 16) | sim_TimeStamp(sim));
+        len += 4;
+    }
+
+    for (i=0; (i < z) && (done < len); i++)
+    {
+        ULONG reqcount = BE_SWAPWORD(d[i].d_ReqCount);
+        ULONG n = MIN(reqcount, len - done);
+
+        CopyMem(stream + done, (APTR)BE_SWAPLONG(d[i].d_DataAddress), n);
+        d[i].d_ResCount = BE_SWAPWORD(reqcount - n);
+        done += n;
+        status_d = &d[i];
+    }
+
+    if (done < len)
+    {
+        event = OHCI1394_EVENT_LONG_PACKET;
+    }
+
+    if (NULL != status_d)
+    {
+        status_d->d_TransferStatus = BE_SWAPWORD(SIM_XFERSTATUS(event));
+    }
+
+    if (DESCRIPTOR_IRQ_ALWAYS == (BE_SWAPWORD(d[z-1].d_Control) & DESCRIPTOR_IRQ_ALWAYS))
+    {
+        REG(sim, OHCI1394_REG_ISO_RECV_INT_EVENT) |= 1ul << (ctx->sc_Index - SIM_CTX_IR(0));
+    }
+
+    sim->ohs_Stats.ss_IRPackets++;
+    sim_ContextBranch(ctx, &d[z-1]);
+}
+
+/* Buffer-fill: packets are written one after the other in the pages,
+ * continuing on the next descriptor when the current one is full.
+ * The packet is dropped if the program has not enough space left. */
+static BOOL sim_IRFill(OHCI1394Sim *sim, SimContext *ctx, SimPacket *pkt)
+{
+    OHCI1394Descriptor *d = SIM_DESCRIPTOR(ctx->sc_CommandPtr);
+    UBYTE *stream = sim->ohs_RxBuffer;
+    ULONG len = 0, done = 0, avail;
+    QUADLET branch;
+
+    if (ctx->sc_Control & SIM_IR_ISOCH_HEADER)
+    {
+        QUADLET q = (pkt->sp_Length << 16) | (pkt->sp_Tag << 14) | (pkt->sp_Channel << 8)
+            | (TCODE_WRITE_STREAM << 4) | pkt->sp_Sy;
+
+        *(QUADLET *)stream = BE_SWAPLONG(q);
+        len = 4;
+    }
+
+    CopyMem(pkt->sp_Data, stream + len, pkt->sp_Length);
+    len += (pkt->sp_Length + 3) & ~3;
+
+    if (ctx->sc_Control & SIM_IR_ISOCH_HEADER)
+    {
+        *(QUADLET *)(stream + len) = BE_SWAPLONG((SIM_XFERSTATUS(OHCI1394_EVENT_ACK_COMPLETE) << 16)
+                                                 | sim_TimeStamp(sim));
+        len += 4;
+    }
+
+    /* Space left in the descriptors given to the DMA */
+    avail = BE_SWAPWORD(d->d_ResCount);
+    branch = BE_SWAPLONG(d->d_BranchAddress);
+    while ((avail < len) && (0 != (branch & 15)))
+    {
+        OHCI1394Descriptor *dn = SIM_DESCRIPTOR(branch);
+
+        if (dn == d)
+        {
+            break;
+        }
+
+        avail += BE_SWAPWORD(dn->d_ResCount);
+        branch = BE_SWAPLONG(dn->d_BranchAddress);
+    }
+
+    if (avail < len)
+    {
+        return FALSE;
+    }
+
+    while (done < len)
+    {
+        ULONG reqcount = BE_SWAPWORD(d->d_ReqCount);
+        ULONG rescount = BE_SWAPWORD(d->d_ResCount);
+        ULONG n = MIN(rescount, len - done);
+
+        CopyMem(stream + done, (UBYTE *)BE_SWAPLONG(d->d_DataAddress) + (reqcount - rescount), n);
+        done += n;
+        rescount -= n;
+
+        d->d_ResCount = BE_SWAPWORD(rescount);
+        d->d_TransferStatus = BE_SWAPWORD(SIM_XFERSTATUS(OHCI1394_EVENT_ACK_COMPLETE));
+
+        if (0 == rescount)
+        {
+            if (DESCRIPTOR_IRQ_ALWAYS == (BE_SWAPWORD(d->d_Control) & DESCRIPTOR_IRQ_ALWAYS))
+            {
+                REG(sim, OHCI1394_REG_ISO_RECV_INT_EVENT) |= 1ul << (ctx->sc_Index - SIM_CTX_IR(0));
+            }
+
+            sim_ContextBranch(ctx, d);
+            if (done < len)
+            {
+                d = SIM_DESCRIPTOR(ctx->sc_CommandPtr);
+            }
+        }
+    }
+
+    sim->ohs_Stats.ss_IRPackets++;
+    return TRUE;
+}
+
+static void sim_IRDeliver(OHCI1394Sim *sim, SimPacket *pkt)
+{
+    ULONG i;
+
+    for (i=0; i < OHCISIM_ISO_CTX_COUNT; i++)
+    {
+        SimContext *ctx = &sim->ohs_Contexts[SIM_CTX_IR(i)];
+
+        if ((0 == (ctx->sc_Control & CTX_RUN)) || !sim_IRMatch(sim, ctx, pkt))
+        {
+            continue;
+        }
+
+        if (ctx->sc_Control & SIM_IR_BUFFER_FILL)
+        {
+            if (!sim_ContextReady(ctx) || !sim_IRFill(sim, ctx, pkt))
+            {
+                sim->ohs_Stats.ss_IRDrops++;
+            }
+        }
+        else if (sim_ContextReady(ctx) && (0 != (ctx->sc_CommandPtr & 15)))
+        {
+            sim_IRWrite(sim, ctx, pkt);
+        }
+        else
+        {
+            sim->ohs_Stats.ss_IRDrops++;
+        }
+    }
+}
+
+static void sim_ITCycle(OHCI1394Sim *sim, SimContext *ctx)
+{
+    OHCI1394Descriptor *d, *last = NULL;
+    QUADLET header[2] = {0, 0};
+    ULONG i, z, plen = 0;
+    UWORD ctrl = 0;
+    BOOL skip = TRUE;
+
+    if (!sim_ContextReady(ctx))
+    {
+        return;
+    }
+
+    if (ctx->sc_Control & SIM_IT_CYCLE_MATCH)
+    {
+        ULONG now = (sim_CycleTimer(sim) >> 12) & 0x7fff;
+
+        if (now != ((ctx->sc_Control >> 16) & 0x7fff))
+        {
+            return;
+        }
+
+        ctx->sc_Control &= ~SIM_IT_CYCLE_MATCH;
+    }
+
+    d = SIM_DESCRIPTOR(ctx->sc_CommandPtr);
+    z = ctx->sc_CommandPtr & 15;
+
+    for (i=0; i < z; i++)
+    {
+        ULONG reqcount = BE_SWAPWORD(d[i].d_ReqCount);
+
+        ctrl = BE_SWAPWORD(d[i].d_Control);
+        if (2 == SIM_DESC_KEY(ctrl))
+        {
+            QUADLET *q = (QUADLET *)&d[i+1];
+
+            header[0] = BE_SWAPLONG(q[0]);
+            header[1] = BE_SWAPLONG(q[1]);
+            skip = FALSE;
+        }
+        else if (plen + reqcount <= sizeof(sim->ohs_TxBuffer))
+        {
+            CopyMem((APTR)BE_SWAPLONG(d[i].d_DataAddress), sim->ohs_TxBuffer + plen, reqcount);
+            plen += reqcount;
+        }
+        else
+        {
+            break;
+        }
+
+        if (DESCRIPTOR_OUTPUT_LAST == (ctrl & 0xf000))
+        {
+            last = &d[i];
+            break;
+        }
+
+        if (2 == SIM_DESC_KEY(ctrl))
+        {
+            i++;
+        }
+    }
+
+    if (NULL == last)
+    {
+        sim_ContextDead(sim, ctx, OHCI1394_EVENT_DESCRIPTOR_READ);
+        return;
+    }
+
+    /* A block without iso header skips the cycle */
+    if (skip)
+    {
+        sim->ohs_Stats.ss_ITSkips++;
+    }
+    else
+    {
+        if (NULL != sim->ohs_IsoSink)
+        {
+            sim->ohs_IsoSink(sim,
+                             (header[0] >> 8) & 0x3f,   /* channel */
+                             (header[0] >> 14) & 3,     /* tag */
+                             header[0] & 0xf,           /* sy */
+                             sim->ohs_TxBuffer,
+                             MIN(plen, header[1] >> 16),
+                             sim->ohs_IsoSinkData);
+        }
+
+        sim->ohs_Stats.ss_ITPackets++;
+    }
+
+    last->d_TimeStamp = BE_SWAPWORD(sim_TimeStamp(sim));
+    last->d_TransferStatus = BE_SWAPWORD(SIM_XFERSTATUS(OHCI1394_EVENT_ACK_COMPLETE));
+
+    if (DESCRIPTOR_IRQ_ALWAYS == (ctrl & DESCRIPTOR_IRQ_ALWAYS))
+    {
+        REG(sim, OHCI1394_REG_ISO_XMIT_INT_EVENT) |= 1ul << (ctx->sc_Index - SIM_CTX_IT(0));
+    }
+
+    if (!sim_ContextBranch(ctx, last))
+    {
+        sim->ohs_Stats.ss_ITUnderruns++;
+    }
+}
+
+static void sim_Cycle(OHCI1394Sim *sim)
+{
+    ULONG seconds = sim_CycleTimer(sim) >> 25;
+    UQUAD used = 0;
+    SimPacket *pkt, *next;
+    ULONG i;
+
+    sim->ohs_Cycles++;
+    sim->ohs_Stats.ss_Cycles++;
+
+    if ((seconds ^ (sim_CycleTimer(sim) >> 25)) & 0x40)
+    {
+        REG(sim, OHCI1394_REG_INT_EVENT) |= OHCI1394_INTF_CYCLE64SECONDS;
+    }
+
+    if (0 == (REG(sim, OHCI1394_REG_HC_CONTROL) & OHCI1394_HCCF_LINKENABLE))
+    {
+        return;
+    }
+
+    /* One packet per channel and per cycle */
+    ForeachNodeSafe(&sim->ohs_IsoQueue, pkt, next)
+    {
+        if (used & (1ull << pkt->sp_Channel))
+        {
+            continue;
+        }
+
+        used |= 1ull << pkt->sp_Channel;
+        REMOVE(pkt);
+        sim_IRDeliver(sim, pkt);
+        sim_FreePacket(sim, pkt);
+    }
+
+    for (i=0; i < OHCISIM_ISO_CTX_COUNT; i++)
+    {
+        sim_ITCycle(sim, &sim->ohs_Contexts[SIM_CTX_IT(i)]);
+    }
+}
+
+
+/*--- Default peer ---*/
+static UBYTE sim_PeerLock(QUADLET *mem, HeliosAPacket *req, HeliosAPacket *resp)
+{
+    QUADLET old, arg, data;
+
+    if (8 != req->PayloadLength)
+    {
+        return HELIOS_RCODE_DATA_ERROR;
+    }
+
+    old = LE_SWAPLONG(*mem);
+    arg = LE_SWAPLONG(req->Payload[0]);
+    data = LE_SWAPLONG(req->Payload[1]);
+
+    switch (req->ExtTCode)
+    {
+        case EXTCODE_COMPARE_SWAP:
+            if (old == arg)
+            {
+                *mem = LE_SWAPLONG(data);
+            }
+            break;
+
+        case EXTCODE_MASK_SWAP:
+            *mem = LE_SWAPLONG((data & arg) | (old & ~arg));
+            break;
+
+        default:
+            return HELIOS_RCODE_TYPE_ERROR;
+    }
+
+    resp->QuadletData = LE_SWAPLONG(old);
+    resp->Payload = &resp->QuadletData;
+    resp->PayloadLength = sizeof(QUADLET);
+
+    return HELIOS_RCODE_COMPLETE;
+}
+
+static void sim_InitPeerRom(OHCI1394Sim *sim, UBYTE phy_id)
+{
+    QUADLET rom[8];
+    ULONG i;
+
+    rom[1] = 0x31333934; /* "1394" */
+    rom[2] = 0x20ff8002; /* isc, max_rec=512, S400 */
+    rom[3] = OHCISIM_GUID_HI;
+    rom[4] = OHCISIM_GUID_LO + ((sim->ohs_Index + 1) << 8) + phy_id;
+    rom[0] = (4 << 24) | (4 << 16) | utils_GetBlockCRC16(&rom[1], 4);
+    rom[6] = 0x03000000 | (OHCISIM_GUID_HI >> 8);  /* Module_Vendor_ID */
+    rom[7] = 0x17000001;                           /* Model_ID */
+    rom[5] = (2 << 16) | utils_GetBlockCRC16(&rom[6], 2);
+
+    for (i=0; i < ARRAY_SIZE(rom); i++)
+    {
+        sim->ohs_Peers[phy_id].sp_Rom[i] = LE_SWAPLONG(rom[i]);
+    }
+}
+
+/* Send the write block requests armed through OHCISIM_PEER_GENERATOR,
+ * as fast as the AR request queue accepts them. */
+static void sim_PeerGenerate(OHCI1394Sim *sim)
+{
+    HeliosAPacket req;
+    ULONG i;
+
+    for (i=0; i < sim->ohs_NodeCount; i++)
+    {
+        SimPeer *peer = &sim->ohs_Peers[i];
+
+        while ((peer->sp_GenCount > 0) && (sim->ohs_ARQueueLength[0] < OHCISIM_AR_QUEUE_MAX))
+        {
+            bzero(&req, sizeof(req));
+            req.TCode = TCODE_WRITE_BLOCK_REQUEST;
+            req.TLabel = peer->sp_GenTLabel++ & 0x3f;
+            req.Offset = peer->sp_GenOffset;
+            req.Payload = (QUADLET *)sim->ohs_TxBuffer;
+            req.PayloadLength = peer->sp_GenLength;
+
+            if (!sim_InjectRequest(sim, i, &req))
+            {
+                peer->sp_GenCount = 0;
+                break;
+            }
+
+            peer->sp_GenCount--;
+        }
+    }
+}
+
+
+/*--- SBP-2 disk target ---*/
+
+static BYTE sim_SBP2PeerHandler(OHCI1394Sim *   sim,
+                                UBYTE           phy_id,
+                                HeliosAPacket * req,
+                                HeliosAPacket * resp,
+                                APTR            udata);
+
+#ifdef OHCISIM_SBP2_TARGET
+/* Add a SBP-2 unit directory to the default ROM */
+static void sim_InitSBP2Rom(OHCI1394Sim *sim, UBYTE phy_id)
+{
+    QUADLET rom[18];
+    ULONG i;
+
+    for (i=0; i < 8; i++)
+    {
+        rom[i] = LE_SWAPLONG(sim->ohs_Peers[phy_id].sp_Rom[i]);
+    }
+
+    rom[8] = 0x0c0083c0;                            /* Node_Capabilities */
+    rom[9] = 0xd1000001;                            /* Unit_Directory */
+    rom[5] = (4 << 16) | utils_GetBlockCRC16(&rom[6], 4);
+    rom[11] = 0x1200609e;                           /* Unit_Spec_ID */
+    rom[12] = 0x13010483;                           /* Unit_SW_Version */
+    rom[13] = 0x3800609e;                           /* Command_Set_Spec_ID */
+    rom[14] = 0x390104d8;                           /* Command_Set */
+    rom[15] = 0x54000000 | ((SIM_SBP2_MGT_AGENT - CSR_BASE_LO) / 4); /* Management_Agent */
+    rom[16] = 0x3a000a08;                           /* Unit_Characteristics: 5s, 8 quadlets ORBs */
+    rom[17] = 0x14000000;                           /* Logical_Unit_Number: LUN 0, direct access */
+    rom[10] = (7 << 16) | utils_GetBlockCRC16(&rom[11], 7);
+
+    for (i=0; i < ARRAY_SIZE(rom); i++)
+    {
+        sim->ohs_Peers[phy_id].sp_Rom[i] = LE_SWAPLONG(rom[i]);
+    }
+}
+#endif
+
+static void sim_SBP2ResetAgent(SimPeer *peer)
+{
+    peer->sp_AgentState = SIM_SBP2_AGENT_RESET;
+    peer->sp_ORB = 0;
+    peer->sp_LastORB = 0;
+    peer->sp_ORBDue = 0;
+}
+
+static void sim_SBP2Status(SimPeer *peer, ULONG src, ULONG sbp_status, ULONG orb, const UBYTE *sense)
+{
+    ULONG len = (NULL != sense) ? 3 : 1;
+
+    /* src, resp = REQUEST COMPLETE, d = 0, len, sbp_status, orb_offset_hi = 0 */
+    peer->sp_Status[0] = LE_SWAPLONG((src << 30) | (len << 24) | (sbp_status << 16));
+    peer->sp_Status[1] = LE_SWAPLONG(orb);
+    if (NULL != sense)
+    {
+        CopyMem((APTR)sense, &peer->sp_Status[2], 8);
+    }
+
+    peer->sp_StatusLength = (len + 1) * sizeof(QUADLET);
+}
+
+/* Write the pending status block into the status FIFO of the initiator */
+static BOOL sim_SBP2FlushStatus(OHCI1394Sim *sim, UBYTE phy_id)
+{
+    SimPeer *peer = &sim->ohs_Peers[phy_id];
+    HeliosAPacket req;
+
+    if (0 == peer->sp_StatusLength)
+    {
+        return TRUE;
+    }
+
+    if (sim->ohs_ARQueueLength[0] >= OHCISIM_AR_QUEUE_MAX)
+    {
+        return FALSE;
+    }
+
+    bzero(&req, sizeof(req));
+    req.TCode = TCODE_WRITE_BLOCK_REQUEST;
+    req.TLabel = peer->sp_GenTLabel++ & 0x3f;
+    req.Offset = peer->sp_StatusFIFO;
+    req.Payload = peer->sp_Status;
+    req.PayloadLength = peer->sp_StatusLength;
+
+    /* Lost if the node is filtered, as on a real bus */
+    sim_InjectRequest(sim, phy_id, &req);
+    peer->sp_StatusLength = 0;
+
+    return TRUE;
+}
+
+/* Bytes moved by a command ORB */
+static ULONG sim_SBP2Length(const QUADLET *orb)
+{
+    const UBYTE *cdb = (const UBYTE *)&orb[5];
+
+    if ((0x28 == cdb[0]) || (0x2a == cdb[0]))
+    {
+        return ((cdb[7] << 8) | cdb[8]) * SIM_SBP2_BLOCK_SIZE;
+    }
+
+    return 0;
+}
+
+/* Seek cycles of a command ORB, moves the disk head after its blocks */
+static ULONG sim_SBP2Seek(SimPeer *peer, const QUADLET *orb)
+{
+    const UBYTE *cdb = (const UBYTE *)&orb[5];
+    ULONG lba, dist;
+
+    if ((0x28 != cdb[0]) && (0x2a != cdb[0]))
+    {
+        return 0;
+    }
+
+    lba = (cdb[2] << 24) | (cdb[3] << 16) | (cdb[4] << 8) | cdb[5];
+    dist = (lba > peer->sp_HeadLBA) ? (lba - peer->sp_HeadLBA) : (peer->sp_HeadLBA - lba);
+    peer->sp_HeadLBA = lba + ((cdb[7] << 8) | cdb[8]);
+
+    if (0 == dist)
+    {
+        return 0;
+    }
+
+    return OHCISIM_SBP2_SEEK_CYCLES
+        + (ULONG)(((UQUAD)MIN(dist, OHCISIM_SBP2_BLOCKS) * OHCISIM_SBP2_STROKE_CYCLES) / OHCISIM_SBP2_BLOCKS);
+}
+
+/* Move up to length bytes between data and the ORB data buffer, direct or page table */
+static void sim_SBP2Transfer(const QUADLET *orb, UBYTE *data, ULONG length, BOOL to_host)
+{
+    ULONG ctrl = LE_SWAPLONG(orb[4]);
+    ULONG count = ctrl & 0xffff;
+    const QUADLET *pt;
+    ULONG i;
+
+    if (0 == (ctrl & (SIM_SBP2_ORB_PAGETABLE << 16)))
+    {
+        pt = NULL;
+        count = MIN(count, length);
+    }
+    else
+    {
+        pt = SIM_HOST_PTR(LE_SWAPLONG(orb[3]));
+    }
+
+    for (i=0; (i < (pt ? count : 1)) && (length > 0); i++)
+    {
+        UBYTE *buf;
+        ULONG seglen;
+
+        if (NULL != pt)
+        {
+            seglen = MIN(LE_SWAPLONG(pt[2*i]) >> 16, length);
+            buf = SIM_HOST_PTR(LE_SWAPLONG(pt[2*i+1]));
+        }
+        else
+        {
+            seglen = count;
+            buf = SIM_HOST_PTR(LE_SWAPLONG(orb[3]));
+        }
+
+        if (to_host)
+        {
+            CopyMem(data, buf, seglen);
+        }
+        else
+        {
+            CopyMem(buf, data, seglen);
+        }
+
+        data += seglen;
+        length -= seglen;
+    }
+}
+
+static void sim_SBP2Command(SimPeer *peer, const QUADLET *orb, ULONG orbaddr, ULONG src)
+{
+    const UBYTE *cdb = (const UBYTE *)&orb[5];
+    UBYTE data[36], sense[8];
+    ULONG lba, blocks;
+
+    bzero(sense, sizeof(sense));
+
+    switch (cdb[0])
+    {
+        case 0x00: /* TEST UNIT READY */
+        case 0x1b: /* START STOP UNIT */
+        case 0x1e: /* PREVENT ALLOW MEDIUM REMOVAL */
+        case 0x35: /* SYNCHRONIZE CACHE */
+            break;
+
+        case 0x12: /* INQUIRY */
+            bzero(data, sizeof(data));
+            data[2] = 4;                /* SPC-2 */
+            data[3] = 2;                /* Response data format */
+            data[4] = sizeof(data) - 5;
+            CopyMem("HELIOS  SIM SBP2 DISK   0001", &data[8], 28);
+            sim_SBP2Transfer(orb, data, MIN(sizeof(data), cdb[4]), TRUE);
+            break;
+
+        case 0x25: /* READ CAPACITY */
+            lba = OHCISIM_SBP2_BLOCKS - 1;
+            data[0] = lba >> 24;
+            data[1] = lba >> 16;
+            data[2] = lba >> 8;
+            data[3] = lba;
+            data[4] = 0;
+            data[5] = 0;
+            data[6] = SIM_SBP2_BLOCK_SIZE >> 8;
+            data[7] = SIM_SBP2_BLOCK_SIZE & 0xff;
+            sim_SBP2Transfer(orb, data, 8, TRUE);
+            break;
+
+        case 0x28: /* READ(10) */
+        case 0x2a: /* WRITE(10) */
+            lba = (cdb[2] << 24) | (cdb[3] << 16) | (cdb[4] << 8) | cdb[5];
+            blocks = (cdb[7] << 8) | cdb[8];
+            if ((lba >= OHCISIM_SBP2_BLOCKS) || (blocks > (OHCISIM_SBP2_BLOCKS - lba)))
+            {
+                sense[1] = 0x05;        /* ILLEGAL REQUEST */
+                sense[2] = 0x21;        /* LOGICAL BLOCK ADDRESS OUT OF RANGE */
+                break;
+            }
+
+            sim_SBP2Transfer(orb, peer->sp_Disk + lba * SIM_SBP2_BLOCK_SIZE,
+                             blocks * SIM_SBP2_BLOCK_SIZE, 0x28 == cdb[0]);
+            break;
+
+        default:
+            sense[1] = 0x05;            /* ILLEGAL REQUEST */
+            sense[2] = 0x20;            /* INVALID COMMAND OPERATION CODE */
+            break;
+    }
+
+    if (0 != sense[1])
+    {
+        sense[0] = 0x02;                /* CHECK CONDITION */
+        sim_SBP2Status(peer, src, 0, orbaddr, sense);
+    }
+    else
+    {
+        sim_SBP2Status(peer, src, 0, orbaddr, NULL);
+    }
+}
+
+static void sim_SBP2Management(SimPeer *peer, const QUADLET *orb, ULONG orbaddr)
+{
+    QUADLET response[4];
+    ULONG sbp_status = 0;
+
+    peer->sp_StatusFIFO = ((HeliosOffset)(LE_SWAPLONG(orb[6]) & 0xffff) << 32) | LE_SWAPLONG(orb[7]);
+
+    switch ((LE_SWAPLONG(orb[4]) >> 16) & 0xf)
+    {
+        case 0: /* LOGIN */
+            if (NULL == peer->sp_Disk)
+            {
+                peer->sp_Disk = AllocVec(OHCISIM_SBP2_BLOCKS * SIM_SBP2_BLOCK_SIZE, MEMF_PUBLIC | MEMF_CLEAR);
+                if (NULL == peer->sp_Disk)
+                {
+                    sbp_status = 8;     /* Resources unavailable */
+                    break;
+                }
+            }
+
+            /* length, login_ID, command_block_agent, reconnect_hold */
+            response[0] = LE_SWAPLONG(sizeof(response) << 16);
+            response[1] = LE_SWAPLONG((ULONG)(SIM_SBP2_CMD_AGENT >> 32));
+            response[2] = LE_SWAPLONG((ULONG)(SIM_SBP2_CMD_AGENT & 0xffffffff));
+            response[3] = 0;
+            CopyMem(response, SIM_HOST_PTR(LE_SWAPLONG(orb[3])),
+                    MIN(LE_SWAPLONG(orb[5]) & 0xffff, sizeof(response)));
+            sim_SBP2ResetAgent(peer);
+            break;
+
+        case 3: /* RECONNECT */
+        case 7: /* LOGOUT */
+            sim_SBP2ResetAgent(peer);
+            break;
+
+        default:
+            sbp_status = 1;             /* Request type not supported */
+            break;
+    }
+
+    sim_SBP2Status(peer, 1, sbp_status, orbaddr, NULL);
+}
+
+/* Execute the management ORB and the due command ORBs of SBP-2 targets */
+static void sim_SBP2Run(OHCI1394Sim *sim)
+{
+    ULONG i;
+
+    for (i=0; i < sim->ohs_NodeCount; i++)
+    {
+        SimPeer *peer = &sim->ohs_Peers[i];
+
+        if ((sim_SBP2PeerHandler != peer->sp_Handler) || !sim_SBP2FlushStatus(sim, i))
+        {
+            continue;
+        }
+
+        if (0 != peer->sp_MgtORB)
+        {
+            sim_SBP2Management(peer, SIM_HOST_PTR(peer->sp_MgtORB), peer->sp_MgtORB);
+            peer->sp_MgtORB = 0;
+
+            if (!sim_SBP2FlushStatus(sim, i))
+            {
+                continue;
+            }
+        }
+
+        /* Linked ORBs are executed back-to-back */
+        while ((SIM_SBP2_AGENT_ACTIVE == peer->sp_AgentState) && (0 != peer->sp_ORB))
+        {
+            const QUADLET *orb = SIM_HOST_PTR(peer->sp_ORB);
+            ULONG next_hi;
+
+            if (0 == peer->sp_ORBDue)
+            {
+                peer->sp_ORBDue = MAX(sim->ohs_Cycles, peer->sp_AgentFree) + OHCISIM_SBP2_CMD_CYCLES
+                    + sim_SBP2Seek(peer, orb) + sim_SBP2Length(orb) / OHCISIM_SBP2_BYTES_PER_CYCLE;
+            }
+
+            if (peer->sp_ORBDue > sim->ohs_Cycles)
+            {
+                break;
+            }
+
+            next_hi = LE_SWAPLONG(orb[0]);
+            sim_SBP2Command(peer, orb, peer->sp_ORB, (next_hi & SIM_SBP2_NULL_ORB) ? 1 : 0);
+
+            peer->sp_AgentFree = peer->sp_ORBDue;
+            peer->sp_ORBDue = 0;
+            peer->sp_LastORB = peer->sp_ORB;
+
+            /* A null next_ORB suspends the agent until the next doorbell */
+            if (next_hi & SIM_SBP2_NULL_ORB)
+            {
+                peer->sp_ORB = 0;
+                peer->sp_AgentState = SIM_SBP2_AGENT_SUSPENDED;
+            }
+            else
+            {
+                peer->sp_ORB = LE_SWAPLONG(orb[1]);
+            }
+
+            if (!sim_SBP2FlushStatus(sim, i))
+            {
+                break;
+            }
+        }
+    }
+}
+
+/* Management and command block agents, other offsets go to the default handler */
+static BYTE sim_SBP2PeerHandler(OHCI1394Sim *   sim,
+                                UBYTE           phy_id,
+                                HeliosAPacket * req,
+                                HeliosAPacket * resp,
+                                APTR            udata)
+{
+    SimPeer *peer = &sim->ohs_Peers[phy_id];
+    HeliosOffset offset = req->Offset;
+
+    if (NULL == resp)
+    {
+        return HELIOS_ACK_COMPLETE;
+    }
+
+    if (SIM_SBP2_MGT_AGENT == offset)
+    {
+        if ((TCODE_WRITE_BLOCK_REQUEST != req->TCode) || (8 != req->PayloadLength))
+        {
+            resp->RCode = HELIOS_RCODE_TYPE_ERROR;
+            return HELIOS_ACK_PENDING;
+        }
+
+        peer->sp_MgtORB = LE_SWAPLONG(req->Payload[1]);
+        return HELIOS_ACK_COMPLETE;
+    }
+
+    if (SIM_CSR_BUSY_TIMEOUT == offset)
+    {
+        switch (req->TCode)
+        {
+            case TCODE_WRITE_QUADLET_REQUEST:
+                peer->sp_BusyTimeout = req->QuadletData;
+                return HELIOS_ACK_COMPLETE;
+
+            case TCODE_READ_QUADLET_REQUEST:
+                resp->QuadletData = peer->sp_BusyTimeout;
+                return HELIOS_ACK_PENDING;
+        }
+
+        resp->RCode = HELIOS_RCODE_TYPE_ERROR;
+        return HELIOS_ACK_PENDING;
+    }
+
+    if ((offset < SIM_SBP2_CMD_AGENT) || (offset >= (SIM_SBP2_CMD_AGENT + 0x20)))
+    {
+        return ohcisim_DefaultPeerHandler(sim, phy_id, req, resp, udata);
+    }
+
+    switch (offset - SIM_SBP2_CMD_AGENT)
+    {
+        case 0x00: /* AGENT_STATE */
+            if (TCODE_READ_QUADLET_REQUEST == req->TCode)
+            {
+                resp->QuadletData = peer->sp_AgentState;
+                return HELIOS_ACK_PENDING;
+            }
+            break;
+
+        case 0x04: /* AGENT_RESET */
+            if (TCODE_WRITE_QUADLET_REQUEST == req->TCode)
+            {
+                sim_SBP2ResetAgent(peer);
+                return HELIOS_ACK_COMPLETE;
+            }
+            break;
+
+        case 0x08: /* ORB_POINTER */
+            if ((TCODE_WRITE_BLOCK_REQUEST == req->TCode) && (8 == req->PayloadLength))
+            {
+                peer->sp_ORB = LE_SWAPLONG(req->Payload[1]);
+                peer->sp_ORBDue = 0;
+                peer->sp_AgentState = SIM_SBP2_AGENT_ACTIVE;
+                return HELIOS_ACK_COMPLETE;
+            }
+            break;
+
+        case 0x10: /* DOORBELL */
+            if (TCODE_WRITE_QUADLET_REQUEST == req->TCode)
+            {
+                /* An active agent reads the next_ORB field after the current ORB */
+                if ((SIM_SBP2_AGENT_SUSPENDED == peer->sp_AgentState) && (0 != peer->sp_LastORB))
+                {
+                    const QUADLET *orb = SIM_HOST_PTR(peer->sp_LastORB);
+
+                    if (0 == (LE_SWAPLONG(orb[0]) & SIM_SBP2_NULL_ORB))
+                    {
+                        peer->sp_ORB = LE_SWAPLONG(orb[1]);
+                        peer->sp_AgentState = SIM_SBP2_AGENT_ACTIVE;
+                    }
+                }
+                return HELIOS_ACK_COMPLETE;
+            }
+            break;
+
+        case 0x14: /* UNSOLICITED_STATUS_ENABLE */
+            if (TCODE_WRITE_QUADLET_REQUEST == req->TCode)
+            {
+                return HELIOS_ACK_COMPLETE;
+            }
+            break;
+
+        default:
+            resp->RCode = HELIOS_RCODE_ADDRESS_ERROR;
+            return HELIOS_ACK_PENDING;
+    }
+
+    resp->RCode = HELIOS_RCODE_TYPE_ERROR;
+    return HELIOS_ACK_PENDING;
+}
+
+
+/*--- Ticker ---*/
+static void sim_TickerTask(HeliosSubTask *self, struct TagItem *tags)
+{
+    OHCI1394Sim *sim;
+    struct MsgPort *taskport, *timerport;
+    struct timerequest *tr;
+    ULONG signal, sigset;
+
+    taskport = (APTR) GetTagData(HA_MsgPort, 0, tags);
+    sim = (APTR) GetTagData(HA_UserData, 0, tags);
+
+    if ((NULL == taskport) || (NULL == sim))
+    {
+        _ERR("Invalid parameters (msgport=%p, sim=%p)\n", taskport, sim);
+        return;
+    }
+
+    timerport = CreateMsgPort();
+    if (NULL == timerport)
+    {
+        _ERR_SIM(sim, "CreateMsgPort() failed\n");
+        return;
+    }
+
+    tr = Helios_OpenTimer(timerport, UNIT_MICROHZ);
+    if (NULL == tr)
+    {
+        _ERR_SIM(sim, "Failed to open timer ioreq\n");
+        DeleteMsgPort(timerport);
+        return;
+    }
+
+    signal = AllocSignal(-1);
+    if (~0U == signal)
+    {
+        _ERR_SIM(sim, "AllocSignal(-1) failed\n");
+        Helios_CloseTimer(tr);
+        DeleteMsgPort(timerport);
+        return;
+    }
+
+    sim->ohs_TickerSignal = 1 << signal;
+    Helios_TaskReady(self, TRUE);
+
+    tr->tr_node.io_Command = TR_ADDREQUEST;
+    tr->tr_time.tv_secs = 0;
+    tr->tr_time.tv_micro = OHCISIM_TICK_US;
+    SendIO((struct IORequest *)tr);
+
+    sigset = sim->ohs_TickerSignal | (1ul << timerport->mp_SigBit) | (1ul << taskport->mp_SigBit);
+    for (;;)
+    {
+        HeliosMsg *msg;
+        ULONG sigs;
+
+        sigs = Wait(sigset);
+
+        if (sigs & (1ul << taskport->mp_SigBit))
+        {
+            while (NULL != (msg = (APTR) GetMsg(taskport)))
+            {
+                switch (msg->hm_Type)
+                {
+                    case HELIOS_MSGTYPE_TASKKILL:
+                        ReplyMsg((struct Message *) msg);
+                        goto out;
+                }
+
+                ReplyMsg((struct Message *) msg);
+            }
+        }
+
+        if (sigs & (1ul << timerport->mp_SigBit))
+        {
+            if (NULL != GetMsg(timerport))
+            {
+                ohcisim_Step(sim, sim->ohs_AutoStep ? (OHCISIM_TICK_US / SIM_CYCLE_US) : 0);
+
+                tr->tr_node.io_Command = TR_ADDREQUEST;
+                tr->tr_time.tv_secs = 0;
+                tr->tr_time.tv_micro = OHCISIM_TICK_US;
+                SendIO((struct IORequest *)tr);
+            }
+        }
+        else if (sigs & sim->ohs_TickerSignal)
+        {
+            ohcisim_Step(sim, 0);
+        }
+    }
+
+out:
+    if (!CheckIO((struct IORequest *)tr))
+    {
+        AbortIO((struct IORequest *)tr);
+    }
+    WaitIO((struct IORequest *)tr);
+
+    FreeSignal(signal);
+    Helios_CloseTimer(tr);
+    DeleteMsgPort(timerport);
+}
+
+static OHCI1394Sim *sim_Create(ULONG index)
+{
+    OHCI1394Sim *sim;
+    ULONG i;
+
+    sim = AllocVec(sizeof(*sim), MEMF_PUBLIC | MEMF_CLEAR);
+    if (NULL == sim)
+    {
+        return NULL;
+    }
+
+    LOCK_INIT(sim);
+    LOCK_INIT(&sim->ohs_IrqLock);
+    sim->ohs_Index = index;
+    sim->ohs_AutoStep = TRUE;
+    sim->ohs_PeerCount = OHCISIM_DEFAULT_PEERS;
+    sim->ohs_ResponseDelay = OHCISIM_RESPONSE_DELAY;
+
+    NEWLIST(&sim->ohs_ARQueue[0]);
+    NEWLIST(&sim->ohs_ARQueue[1]);
+    NEWLIST(&sim->ohs_IsoQueue);
+
+    for (i=0; i < SIM_CTX_COUNT; i++)
+    {
+        SimContext *ctx = &sim->ohs_Contexts[i];
+
+        if (i < SIM_CTX_AR_REQ)
+        {
+            ctx->sc_Type = SIM_CTX_TYPE_AT;
+        }
+        else if (i < SIM_CTX_IT(0))
+        {
+            ctx->sc_Type = SIM_CTX_TYPE_AR;
+        }
+        else if (i < SIM_CTX_IR(0))
+        {
+            ctx->sc_Type = SIM_CTX_TYPE_IT;
+        }
+        else
+        {
+            ctx->sc_Type = SIM_CTX_TYPE_IR;
+        }
+
+        ctx->sc_Index = i;
+    }
+
+    sim->ohs_Pool = CreatePool(MEMF_PUBLIC | MEMF_CLEAR, 16384, 4096);
+    if (NULL != sim->ohs_Pool)
+    {
+        sim->ohs_RegsAlloc = AllocVec(2 * OHCI1394_REGISTERS_SPACE_SIZE, MEMF_PUBLIC | MEMF_CLEAR);
+        if (NULL != sim->ohs_RegsAlloc)
+        {
+            sim->ohs_Regs = (APTR) GET_ALIGNED2(sim->ohs_RegsAlloc, OHCI1394_REGISTERS_SPACE_SIZE);
+
+            REG(sim, OHCI1394_REG_VERSION) = OHCISIM_VERSION;
+            REG(sim, OHCI1394_REG_VENDOR_ID) = OHCISIM_VENDOR_ID;
+            REG(sim, OHCI1394_REG_GUID_HI) = OHCISIM_GUID_HI;
+            REG(sim, OHCI1394_REG_GUID_LO) = OHCISIM_GUID_LO + index;
+            REG(sim, OHCI1394_REG_BUS_ID) = 0x31333934;
+            REG(sim, OHCI1394_REG_BUS_OPTIONS) = 0xf800a002;
+            REG(sim, OHCI1394_REG_HC_CONTROL) = 0;
+
+            sim->ohs_PhyRegs[1] = 0x3f;             /* gap count */
+            sim->ohs_PhyRegs[2] = (7 << 5) | 3;     /* extended registers, 3 ports */
+            sim->ohs_PhyRegs[3] = S400 << 6;
+
+            sim_SoftReset(sim);
+
+            for (i=0; i < OHCISIM_MAX_PEERS; i++)
+            {
+                sim->ohs_Peers[i].sp_Handler = ohcisim_DefaultPeerHandler;
+                sim_InitPeerRom(sim, i);
+            }
+
+#ifdef OHCISIM_SBP2_TARGET
+            sim->ohs_Peers[0].sp_Handler = sim_SBP2PeerHandler;
+            sim_InitSBP2Rom(sim, 0);
+#endif
+
+            return sim;
+        }
+
+        DeletePool(sim->ohs_Pool);
+    }
+
+    FreeVec(sim);
+    return NULL;
+}
+
+static void sim_Delete(OHCI1394Sim *sim)
+{
+    ULONG i;
+
+    for (i=0; i < OHCISIM_MAX_PEERS; i++)
+    {
+        if (NULL != sim->ohs_Peers[i].sp_Memory)
+        {
+            FreeVec(sim->ohs_Peers[i].sp_Memory);
+        }
+        if (NULL != sim->ohs_Peers[i].sp_Disk)
+        {
+            FreeVec(sim->ohs_Peers[i].sp_Disk);
+        }
+    }
+
+    /* Packets are pool allocated */
+    DeletePool(sim->ohs_Pool);
+    FreeVec(sim->ohs_RegsAlloc);
+    FreeVec(sim);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*--- PUBLIC CODE SECTION ----------------------------------------------------*/
+
+/*--- Bus level ---*/
+struct Library *ohcisim_OpenBus(void)
+{
+    if (0 == sim_Bus.sb_OpenCnt)
+    {
+        ULONG i;
+
+        sim_Bus.sb_BoardCount = 0;
+        for (i=0; i < MIN(OHCISIM_BOARDS, OHCISIM_MAX_BOARDS); i++)
+        {
+            OHCI1394Sim *sim = sim_Create(i);
+
+            if (NULL == sim)
+            {
+                _ERR("Failed to create simulated board #%lu\n", i);
+                break;
+            }
+
+            sim_Bus.sb_Boards[sim_Bus.sb_BoardCount++] = sim;
+        }
+    }
+
+    sim_Bus.sb_OpenCnt++;
+    return &sim_Bus.sb_Library;
+}
+
+void ohcisim_CloseBus(struct Library *bus)
+{
+    if ((NULL != bus) && (0 == --sim_Bus.sb_OpenCnt))
+    {
+        while (sim_Bus.sb_BoardCount > 0)
+        {
+            sim_Delete(sim_Bus.sb_Boards[--sim_Bus.sb_BoardCount]);
+        }
+    }
+}
+
+/*--- PCI board emulation ---*/
+APTR ohcisim_FindBoard(APTR prev)
+{
+    ULONG i = 0;
+
+    if (NULL != prev)
+    {
+        i = ((OHCI1394Sim *)prev)->ohs_Index + 1;
+    }
+
+    return (i < sim_Bus.sb_BoardCount) ? sim_Bus.sb_Boards[i] : NULL;
+}
+
+UWORD ohcisim_ReadConfig(APTR board, ULONG offset)
+{
+    OHCI1394Sim *sim = board;
+
+    switch (offset)
+    {
+        case PCIXCONFIG_VENDOR: return OHCISIM_PCI_VID;
+        case PCIXCONFIG_DEVICE: return OHCISIM_PCI_DID;
+        case PCIXCONFIG_COMMAND: return sim->ohs_PCICommand;
+        case PCIXCONFIG_PROGINTERFACE: return 0x10; /* OHCI */
+        case 0x54: return sim->ohs_PCIPower;
+    }
+
+    return 0;
+}
+
+void ohcisim_WriteConfig(APTR board, ULONG offset, UWORD value)
+{
+    OHCI1394Sim *sim = board;
+
+    switch (offset)
+    {
+        case PCIXCONFIG_COMMAND: sim->ohs_PCICommand = value; break;
+        case 0x54: sim->ohs_PCIPower = value; break;
+    }
+}
+
+BOOL ohcisim_AttemptBoard(APTR board)
+{
+    OHCI1394Sim *sim = board;
+    BOOL res = FALSE;
+
+    LOCK_REGION(sim);
+    if (!sim->ohs_Attempted)
+    {
+        sim->ohs_Attempted = TRUE;
+        res = TRUE;
+    }
+    UNLOCK_REGION(sim);
+
+    return res;
+}
+
+void ohcisim_ReleaseBoard(APTR board)
+{
+    OHCI1394Sim *sim = board;
+
+    LOCK_REGION(sim);
+    sim->ohs_Attempted = FALSE;
+    UNLOCK_REGION(sim);
+}
+
+ULONG ohcisim_GetBoardAttr(APTR board, ULONG attr)
+{
+    OHCI1394Sim *sim = board;
+
+    switch (attr)
+    {
+        case PCIXTAG_OWNER: return (ULONG)(sim->ohs_Owner ? sim->ohs_Owner : (STRPTR)"");
+        case PCIXTAG_BASEADDRESS0: return (ULONG)sim->ohs_Regs;
+        case PCIXTAG_BASESIZE0: return OHCI1394_REGISTERS_SPACE_SIZE;
+    }
+
+    return 0;
+}
+
+BOOL ohcisim_SetBoardAttr(APTR board, ULONG attr, ULONG value)
+{
+    OHCI1394Sim *sim = board;
+
+    if (PCIXTAG_OWNER == attr)
+    {
+        if ((0 == value) || (NULL == sim->ohs_Owner))
+        {
+            sim->ohs_Owner = (STRPTR)value;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+APTR ohcisim_CreateIntObject(APTR board, ULONG (*handler)(APTR), APTR data)
+{
+    OHCI1394Sim *sim = board;
+    HeliosSubTask *ticker;
+    char name[32];
+
+    if (!sim_IsBoard(board) || (NULL != sim->ohs_IrqHandler))
+    {
+        return NULL;
+    }
+
+    LOCK_REGION(&sim->ohs_IrqLock);
+    sim->ohs_IrqData = data;
+    sim->ohs_IrqHandler = handler;
+    UNLOCK_REGION(&sim->ohs_IrqLock);
+
+    utils_SPrintF(name, "[OHCISIM] Ticker #%lu", sim->ohs_Index);
+    ticker = Helios_CreateSubTask(name, sim_TickerTask,
+                                  HA_Pool, (ULONG)sim->ohs_Pool,
+                                  TASKTAG_PRI, SIM_TASK_PRIO,
+                                  HA_UserData, (ULONG)sim,
+                                  TAG_DONE);
+    if ((NULL != ticker) && (0 == Helios_WaitTaskReady(ticker, SIGBREAKF_CTRL_E)))
+    {
+        sim->ohs_Ticker = ticker;
+        return sim;
+    }
+
+    _ERR_SIM(sim, "Failed to create the ticker task\n");
+    if (NULL != ticker)
+    {
+        Helios_KillSubTask(ticker);
+    }
+
+    LOCK_REGION(&sim->ohs_IrqLock);
+    sim->ohs_IrqHandler = NULL;
+    UNLOCK_REGION(&sim->ohs_IrqLock);
+
+    return NULL;
+}
+
+void ohcisim_DeleteIntObject(APTR intobj)
+{
+    OHCI1394Sim *sim = intobj;
+
+    if (NULL != sim->ohs_Ticker)
+    {
+        Helios_KillSubTask(sim->ohs_Ticker);
+        sim->ohs_Ticker = NULL;
+    }
+
+    LOCK_REGION(&sim->ohs_IrqLock);
+    sim->ohs_IrqHandler = NULL;
+    sim->ohs_IrqData = NULL;
+    UNLOCK_REGION(&sim->ohs_IrqLock);
+}
+
+/*--- Register file ---*/
+QUADLET ohcisim_RegRead(APTR board, LONG offset)
+{
+    OHCI1394Sim *sim = board;
+    SimContext *ctx;
+    QUADLET value;
+    ULONG reg;
+
+    LOCK_REGION(sim);
+    sim->ohs_Stats.ss_RegReads++;
+
+    ctx = sim_GetContext(sim, offset, &reg);
+    if (NULL != ctx)
+    {
+        switch (reg)
+        {
+            case 0x0: /* ContextControlSet */
+            case 0x4: /* ContextControlClear */
+                value = ctx->sc_Control;
+                break;
+
+            case 0xc:
+                value = ctx->sc_CommandPtr;
+                break;
+
+            case 0x10:
+                value = ctx->sc_Match;
+                break;
+
+            default:
+                value = 0;
+        }
+
+        UNLOCK_REGION(sim);
+        return value;
+    }
+
+    switch (offset)
+    {
+        case OHCI1394_REG_CSR_READ_DATA:
+            value = sim->ohs_CSRReadData;
+            break;
+
+        case OHCI1394_REG_INT_EVENT_SET:
+        case OHCI1394_REG_INT_EVENT_CLEAR:
+            value = REG(sim, OHCI1394_REG_INT_EVENT);
+            if (REG(sim, OHCI1394_REG_ISO_XMIT_INT_EVENT) & REG(sim, OHCI1394_REG_ISO_XMIT_INT_MASK))
+            {
+                value |= OHCI1394_INTF_ISOCHTX;
+            }
+            if (REG(sim, OHCI1394_REG_ISO_RECV_INT_EVENT) & REG(sim, OHCI1394_REG_ISO_RECV_INT_MASK))
+            {
+                value |= OHCI1394_INTF_ISOCHRX;
+            }
+
+            /* The clear register returns the masked events */
+            if (OHCI1394_REG_INT_EVENT_CLEAR == offset)
+            {
+                value &= REG(sim, OHCI1394_REG_INT_MASK);
+            }
+            break;
+
+        case OHCI1394_REG_ISO_XMIT_INT_EVENT_CLEAR:
+            value = REG(sim, OHCI1394_REG_ISO_XMIT_INT_EVENT) & REG(sim, OHCI1394_REG_ISO_XMIT_INT_MASK);
+            break;
+
+        case OHCI1394_REG_ISO_RECV_INT_EVENT_CLEAR:
+            value = REG(sim, OHCI1394_REG_ISO_RECV_INT_EVENT) & REG(sim, OHCI1394_REG_ISO_RECV_INT_MASK);
+            break;
+
+        case OHCI1394_REG_HC_CONTROL_CLEAR:
+        case OHCI1394_REG_IR_MULTICHAN_MASK_HI_CLEAR:
+        case OHCI1394_REG_IR_MULTICHAN_MASK_LO_CLEAR:
+        case OHCI1394_REG_INT_MASK_CLEAR:
+        case OHCI1394_REG_ISO_XMIT_INT_MASK_CLEAR:
+        case OHCI1394_REG_ISO_RECV_INT_MASK_CLEAR:
+        case OHCI1394_REG_LINK_CONTROL_CLEAR:
+        case OHCI1394_REG_ASYNCH_REQ_FILTER_HI_CLEAR:
+        case OHCI1394_REG_ASYNCH_REQ_FILTER_LO_CLEAR:
+        case OHCI1394_REG_PHYREQ_REQ_FILTER_HI_CLEAR:
+        case OHCI1394_REG_PHYREQ_REQ_FILTER_LO_CLEAR:
+            value = REG(sim, offset - 4);
+            break;
+
+        case OHCI1394_REG_ISOCHRONOUS_CYCLE_TIMER:
+            value = sim_CycleTimer(sim);
+            break;
+
+        default:
+            if ((offset >= 0) && (offset < OHCI1394_REGISTERS_SPACE_SIZE))
+            {
+                value = REG(sim, offset & ~3);
+            }
+            else
+            {
+                value = ~0;
+            }
+    }
+
+    UNLOCK_REGION(sim);
+
+    return value;
+}
+
+void ohcisim_RegWrite(APTR board, LONG offset, QUADLET value)
+{
+    OHCI1394Sim *sim = board;
+    SimContext *ctx;
+    BOOL wake = FALSE;
+    ULONG reg;
+
+    LOCK_REGION(sim);
+    sim->ohs_Stats.ss_RegWrites++;
+
+    ctx = sim_GetContext(sim, offset, &reg);
+    if (NULL != ctx)
+    {
+        switch (reg)
+        {
+            case 0x0: /* ContextControlSet */
+                sim_ContextControl(sim, ctx, value, 0);
+                wake = 0 != (value & (CTX_RUN | CTX_WAKE));
+                break;
+
+            case 0x4: /* ContextControlClear */
+                sim_ContextControl(sim, ctx, 0, value);
+                break;
+
+            case 0xc: /* CommandPtr, only when the context is stopped and idle */
+                if (0 == (ctx->sc_Control & (CTX_RUN | CTX_ACTIVE)))
+                {
+                    ctx->sc_CommandPtr = value;
+                }
+                break;
+
+            case 0x10:
+                if (SIM_CTX_TYPE_IR == ctx->sc_Type)
+                {
+                    ctx->sc_Match = value;
+                }
+                break;
+        }
+
+        UNLOCK_REGION(sim);
+
+        if (wake)
+        {
+            sim_SignalTicker(sim);
+        }
+
+        return;
+    }
+
+    switch (offset)
+    {
+        /* Read-only registers */
+        case OHCI1394_REG_VERSION:
+        case OHCI1394_REG_GUID_ROM:
+        case OHCI1394_REG_GUID_HI:
+        case OHCI1394_REG_GUID_LO:
+        case OHCI1394_REG_VENDOR_ID:
+        case OHCI1394_REG_SELFID_COUNT:
+        case OHCI1394_REG_ISOCHRONOUS_CYCLE_TIMER:
+            break;
+
+        case OHCI1394_REG_CSR_CONTROL:
+            sim_CompareSwap(sim, value);
+            break;
+
+        case OHCI1394_REG_HC_CONTROL_SET:
+            if (value & OHCI1394_HCCF_SOFTRESET)
+            {
+                sim_SoftReset(sim);
+            }
+            REG(sim, offset) |= value & ~OHCI1394_HCCF_SOFTRESET;
+            break;
+
+        case OHCI1394_REG_ISO_XMIT_INT_MASK_SET:
+        case OHCI1394_REG_ISO_RECV_INT_MASK_SET:
+            REG(sim, offset) |= value & SIM_ISO_CTX_MASK;
+            break;
+
+        case OHCI1394_REG_IR_MULTICHAN_MASK_HI_SET:
+        case OHCI1394_REG_IR_MULTICHAN_MASK_LO_SET:
+        case OHCI1394_REG_INT_EVENT_SET:
+        case OHCI1394_REG_INT_MASK_SET:
+        case OHCI1394_REG_ISO_XMIT_INT_EVENT_SET:
+        case OHCI1394_REG_ISO_RECV_INT_EVENT_SET:
+        case OHCI1394_REG_LINK_CONTROL_SET:
+        case OHCI1394_REG_ASYNCH_REQ_FILTER_HI_SET:
+        case OHCI1394_REG_ASYNCH_REQ_FILTER_LO_SET:
+        case OHCI1394_REG_PHYREQ_REQ_FILTER_HI_SET:
+        case OHCI1394_REG_PHYREQ_REQ_FILTER_LO_SET:
+            REG(sim, offset) |= value;
+            break;
+
+        case OHCI1394_REG_HC_CONTROL_CLEAR:
+        case OHCI1394_REG_IR_MULTICHAN_MASK_HI_CLEAR:
+        case OHCI1394_REG_IR_MULTICHAN_MASK_LO_CLEAR:
+        case OHCI1394_REG_INT_EVENT_CLEAR:
+        case OHCI1394_REG_INT_MASK_CLEAR:
+        case OHCI1394_REG_ISO_XMIT_INT_EVENT_CLEAR:
+        case OHCI1394_REG_ISO_XMIT_INT_MASK_CLEAR:
+        case OHCI1394_REG_ISO_RECV_INT_EVENT_CLEAR:
+        case OHCI1394_REG_ISO_RECV_INT_MASK_CLEAR:
+        case OHCI1394_REG_LINK_CONTROL_CLEAR:
+        case OHCI1394_REG_ASYNCH_REQ_FILTER_HI_CLEAR:
+        case OHCI1394_REG_ASYNCH_REQ_FILTER_LO_CLEAR:
+        case OHCI1394_REG_PHYREQ_REQ_FILTER_HI_CLEAR:
+        case OHCI1394_REG_PHYREQ_REQ_FILTER_LO_CLEAR:
+            REG(sim, offset - 4) &= ~value;
+            /* Clearing BusReset lets AT contexts transmit again */
+            wake = (OHCI1394_REG_INT_EVENT_CLEAR == offset) && (value & OHCI1394_INTF_BUSRESET);
+            break;
+
+        case OHCI1394_REG_NODE_ID:
+            REG(sim, offset) = (REG(sim, offset) & ~OHCI1394_NODEID_BUSNUMBER_MASK)
+                | (value & OHCI1394_NODEID_BUSNUMBER_MASK);
+            break;
+
+        case OHCI1394_REG_PHY_CONTROL:
+            {
+                ULONG addr = (value >> OHCI1394_PCB_REG_ADDR) & 0x0f;
+
+                if (value & OHCI1394_PCF_RD_REG)
+                {
+                    REG(sim, offset) = OHCI1394_PCF_RD_DONE | (addr << OHCI1394_PCB_RD_ADDR)
+                        | (sim->ohs_PhyRegs[addr] << OHCI1394_PCB_RD_DATA);
+                    REG(sim, OHCI1394_REG_INT_EVENT) |= OHCI1394_INTF_PHYREGRCVD;
+                }
+                else if (value & OHCI1394_PCF_WR_REG)
+                {
+                    sim_PhyWrite(sim, addr, value & 0xff);
+                    REG(sim, offset) &= ~(OHCI1394_PCF_RD_REG | OHCI1394_PCF_WR_REG);
+                    wake = sim->ohs_BusResetPending;
+                }
+            }
+            break;
+
+        default:
+            if ((offset >= 0) && (offset < OHCI1394_REGISTERS_SPACE_SIZE))
+            {
+                REG(sim, offset & ~3) = value;
+            }
+    }
+
+    UNLOCK_REGION(sim);
+
+    if (wake)
+    {
+        sim_SignalTicker(sim);
+    }
+}
+
+/*--- Harness API ---*/
+OHCI1394Sim *ohcisim_GetBoard(ULONG index)
+{
+    return (index < sim_Bus.sb_BoardCount) ? sim_Bus.sb_Boards[index] : NULL;
+}
+
+/* Advance the bus clock of the given cycles count, then run DMA programs
+ * and raise the IRQ if needed. Returns the number of processed async packets. */
+ULONG ohcisim_Step(OHCI1394Sim *sim, ULONG cycles)
+{
+    ULONG count = 0;
+    BOOL irq;
+
+    LOCK_REGION(sim);
+    {
+        if (sim->ohs_BusResetPending)
+        {
+            sim_DoBusReset(sim);
+        }
+
+        while (cycles--)
+        {
+            sim_Cycle(sim);
+        }
+
+        count += sim_ATRun(sim, &sim->ohs_Contexts[SIM_CTX_AT_REQ]);
+        count += sim_ATRun(sim, &sim->ohs_Contexts[SIM_CTX_AT_RESP]);
+        sim_PeerGenerate(sim);
+        sim_SBP2Run(sim);
+        count += sim_ARRun(sim, &sim->ohs_Contexts[SIM_CTX_AR_REQ]);
+        count += sim_ARRun(sim, &sim->ohs_Contexts[SIM_CTX_AR_RESP]);
+
+        /* Stalled IR/IT contexts are only resumed by a wake */
+        irq = sim_IrqPending(sim);
+    }
+    UNLOCK_REGION(sim);
+
+    if (irq)
+    {
+        LOCK_REGION(&sim->ohs_IrqLock);
+        if (NULL != sim->ohs_IrqHandler)
+        {
+            sim->ohs_Stats.ss_Interrupts++;
+            sim->ohs_IrqHandler(sim->ohs_IrqData);
+        }
+        UNLOCK_REGION(&sim->ohs_IrqLock);
+    }
+
+    return count;
+}
+
+void ohcisim_SetAutoStep(OHCI1394Sim *sim, BOOL enable)
+{
+    LOCK_REGION(sim);
+    sim->ohs_AutoStep = enable;
+    UNLOCK_REGION(sim);
+}
+
+void ohcisim_SetPeerCount(OHCI1394Sim *sim, ULONG count)
+{
+    LOCK_REGION(sim);
+    sim->ohs_PeerCount = MIN(count, OHCISIM_MAX_PEERS);
+    UNLOCK_REGION(sim);
+}
+
+void ohcisim_SetPeerHandler(OHCI1394Sim *sim, UBYTE phy_id,
+                            OHCI1394SimPeerHandler handler, APTR udata)
+{
+    if (phy_id >= OHCISIM_MAX_PEERS)
+    {
+        return;
+    }
+
+    LOCK_REGION(sim);
+    sim->ohs_Peers[phy_id].sp_Handler = handler ? handler : ohcisim_DefaultPeerHandler;
+    sim->ohs_Peers[phy_id].sp_UData = udata;
+    UNLOCK_REGION(sim);
+}
+
+void ohcisim_SetResponseDelay(OHCI1394Sim *sim, ULONG cycles)
+{
+    LOCK_REGION(sim);
+    sim->ohs_ResponseDelay = cycles;
+    UNLOCK_REGION(sim);
+}
+
+void ohcisim_SetIsoSink(OHCI1394Sim *sim, OHCI1394SimIsoSink sink, APTR udata)
+{
+    LOCK_REGION(sim);
+    sim->ohs_IsoSink = sink;
+    sim->ohs_IsoSinkData = udata;
+    UNLOCK_REGION(sim);
+}
+
+/* Plug/unplug simulation: the bus reset happens at the next step */
+void ohcisim_BusReset(OHCI1394Sim *sim)
+{
+    LOCK_REGION(sim);
+    sim->ohs_BusResetPending = TRUE;
+    UNLOCK_REGION(sim);
+
+    sim_SignalTicker(sim);
+}
+
+/* Send a request from a peer to the local node (AR request context) */
+BOOL ohcisim_InjectRequest(OHCI1394Sim *sim, UBYTE phy_id, HeliosAPacket *req)
+{
+    BOOL res;
+
+    LOCK_REGION(sim);
+    res = sim_InjectRequest(sim, phy_id, req);
+    UNLOCK_REGION(sim);
+
+    if (res)
+    {
+        sim_SignalTicker(sim);
+    }
+
+    return res;
+}
+
+/* Queue an isochronous packet, delivered to the matching IR contexts at the next cycle */
+BOOL ohcisim_InjectIsoPacket(OHCI1394Sim *sim, UBYTE channel, UBYTE tag, UBYTE sy,
+                             const UBYTE *payload, ULONG length)
+{
+    SimPacket *pkt;
+
+    if ((channel > 63) || (length > (SIM_PACKET_MAX - 8)))
+    {
+        return FALSE;
+    }
+
+    LOCK_REGION(sim);
+    pkt = sim_AllocPacket(sim, length);
+    if (NULL != pkt)
+    {
+        pkt->sp_Channel = channel;
+        pkt->sp_Tag = tag & 3;
+        pkt->sp_Sy = sy & 0xf;
+        CopyMem((APTR)payload, pkt->sp_Data, length);
+        ADDTAIL(&sim->ohs_IsoQueue, pkt);
+    }
+    UNLOCK_REGION(sim);
+
+    return NULL != pkt;
+}
+
+UBYTE *ohcisim_GetPeerMemory(OHCI1394Sim *sim, UBYTE phy_id)
+{
+    SimPeer *peer;
+
+    if (phy_id >= OHCISIM_MAX_PEERS)
+    {
+        return NULL;
+    }
+
+    peer = &sim->ohs_Peers[phy_id];
+
+    LOCK_REGION(sim);
+    if (NULL == peer->sp_Memory)
+    {
+        peer->sp_Memory = AllocVec(OHCISIM_PEER_MEMSIZE, MEMF_PUBLIC | MEMF_CLEAR);
+    }
+    UNLOCK_REGION(sim);
+
+    return peer->sp_Memory;
+}
+
+void ohcisim_GetStats(OHCI1394Sim *sim, OHCI1394SimStats *stats)
+{
+    LOCK_REGION(sim);
+    CopyMem(&sim->ohs_Stats, stats, sizeof(*stats));
+    UNLOCK_REGION(sim);
+}
+
+void ohcisim_ResetStats(OHCI1394Sim *sim)
+{
+    LOCK_REGION(sim);
+    memset(&sim->ohs_Stats, 0, sizeof(sim->ohs_Stats));
+    UNLOCK_REGION(sim);
+}
+
+/* RAM at offsets [0, OHCISIM_PEER_MEMSIZE[ and a config ROM in the CSR space */
+BYTE ohcisim_DefaultPeerHandler(OHCI1394Sim *   sim,
+                                UBYTE           phy_id,
+                                HeliosAPacket * req,
+                                HeliosAPacket * resp,
+                                APTR            udata)
+{
+    SimPeer *peer = &sim->ohs_Peers[phy_id];
+    HeliosOffset offset = req->Offset;
+    UBYTE *mem;
+    ULONG size;
+
+    /* Nothing to do with responses */
+    if (NULL == resp)
+    {
+        return HELIOS_ACK_COMPLETE;
+    }
+
+    if ((offset >= (CSR_BASE_LO + CSR_CONFIG_ROM_OFFSET))
+        && (offset <= (CSR_BASE_LO + CSR_CONFIG_ROM_END)))
+    {
+        static UBYTE zero_rom[CSR_CONFIG_ROM_SIZE];
+        ULONG i = offset - (CSR_BASE_LO + CSR_CONFIG_ROM_OFFSET);
+
+        if ((TCODE_READ_QUADLET_REQUEST != req->TCode) && (TCODE_READ_BLOCK_REQUEST != req->TCode))
+        {
+            resp->RCode = HELIOS_RCODE_TYPE_ERROR;
+            return HELIOS_ACK_PENDING;
+        }
+
+        /* Quadlets after the ROM content are zeros */
+        if (i < sizeof(peer->sp_Rom))
+        {
+            mem = (UBYTE *)peer->sp_Rom + i;
+            size = sizeof(peer->sp_Rom) - i;
+        }
+        else
+        {
+            mem = zero_rom;
+            size = CSR_CONFIG_ROM_END + 1 - CSR_CONFIG_ROM_OFFSET - i;
+        }
+    }
+    else if (offset == OHCISIM_PEER_GENERATOR)
+    {
+        /* count, length, offset hi, offset lo */
+        if ((TCODE_WRITE_BLOCK_REQUEST != req->TCode) || (16 != req->PayloadLength))
+        {
+            resp->RCode = HELIOS_RCODE_TYPE_ERROR;
+            return HELIOS_ACK_PENDING;
+        }
+
+        peer->sp_GenCount = LE_SWAPLONG(req->Payload[0]);
+        peer->sp_GenLength = MIN(LE_SWAPLONG(req->Payload[1]), OHCISIM_PEER_GEN_MAX) & ~3;
+        peer->sp_GenOffset = ((HeliosOffset)(LE_SWAPLONG(req->Payload[2]) & 0xffff) << 32)
+            | LE_SWAPLONG(req->Payload[3]);
+        return HELIOS_ACK_COMPLETE;
+    }
+    else if (offset < OHCISIM_PEER_MEMSIZE)
+    {
+        if (NULL == peer->sp_Memory)
+        {
+            peer->sp_Memory = AllocVec(OHCISIM_PEER_MEMSIZE, MEMF_PUBLIC | MEMF_CLEAR);
+            if (NULL == peer->sp_Memory)
+            {
+                return HELIOS_ACK_BUSY_X;
+            }
+        }
+
+        mem = peer->sp_Memory + offset;
+        size = OHCISIM_PEER_MEMSIZE - offset;
+    }
+    else
+    {
+        resp->RCode = HELIOS_RCODE_ADDRESS_ERROR;
+        return HELIOS_ACK_PENDING;
+    }
+
+    switch (req->TCode)
+    {
+        case TCODE_WRITE_QUADLET_REQUEST:
+            if ((offset & 3) || (size < 4))
+            {
+                resp->RCode = HELIOS_RCODE_ADDRESS_ERROR;
+                return HELIOS_ACK_PENDING;
+            }
+            *(QUADLET *)mem = LE_SWAPLONG(req->QuadletData);
+            return HELIOS_ACK_COMPLETE;
+
+        case TCODE_WRITE_BLOCK_REQUEST:
+            if (req->PayloadLength > size)
+            {
+                resp->RCode = HELIOS_RCODE_ADDRESS_ERROR;
+                return HELIOS_ACK_PENDING;
+            }
+            CopyMem(req->Payload, mem, req->PayloadLength);
+            return HELIOS_ACK_COMPLETE;
+
+        case TCODE_READ_QUADLET_REQUEST:
+            if ((offset & 3) || (size < 4))
+            {
+                resp->RCode = HELIOS_RCODE_ADDRESS_ERROR;
+            }
+            else
+            {
+                resp->QuadletData = LE_SWAPLONG(*(QUADLET *)mem);
+            }
+            return HELIOS_ACK_PENDING;
+
+        case TCODE_READ_BLOCK_REQUEST:
+            if (req->PayloadLength > size)
+            {
+                resp->RCode = HELIOS_RCODE_ADDRESS_ERROR;
+            }
+            else
+            {
+                resp->Payload = (QUADLET *)mem;
+                resp->PayloadLength = req->PayloadLength;
+            }
+            return HELIOS_ACK_PENDING;
+
+        case TCODE_LOCK_REQUEST:
+            if ((offset & 3) || (size < 4))
+            {
+                resp->RCode = HELIOS_RCODE_ADDRESS_ERROR;
+            }
+            else
+            {
+                resp->RCode = sim_PeerLock((QUADLET *)mem, req, resp);
+            }
+            return HELIOS_ACK_PENDING;
+    }
+
+    return HELIOS_ACK_TYPE_ERROR;
+}
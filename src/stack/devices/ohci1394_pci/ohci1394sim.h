@@ -0,0 +1,230 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Header file for the software OHCI 1394 controller model.
+**
+** When the device is built with OHCI1394_SIMULATOR defined (make SIMULATOR=1),
+** the PCI bus and the OHCI chipset are replaced by this model: register file,
+** AT/AR/IR/IT DMA engines, self-ID buffer, cycle timer and interrupt events.
+** The driver code runs on it unmodified, using the same descriptors and
+** the same byte-order conventions than on real silicon.
+**
+** As the driver, the model assumes a 32-bit host where DMA addresses are
+** CPU addresses (PCIXDMAGetPhysical() is the identity). The host build
+** (src/host) keeps all exec allocations below 4GB for that.
+**
+*/
+
+#ifndef OHCI1394_SIM_H
+#define OHCI1394_SIM_H
+
+#include "ohci1394core.h"
+
+#ifndef OHCISIM_BOARDS
+#define OHCISIM_BOARDS              1       /* Number of simulated PCI boards */
+#endif
+
+#define OHCISIM_MAX_BOARDS          4
+#define OHCISIM_MAX_PEERS           (MAX_NODES-1)
+#ifndef OHCISIM_DEFAULT_PEERS
+#define OHCISIM_DEFAULT_PEERS       1       /* Number of simulated nodes per bus */
+#endif
+#define OHCISIM_ISO_CTX_COUNT       4       /* IR and IT contexts implemented */
+#define OHCISIM_PEER_MEMSIZE        (64*1024)
+#define OHCISIM_PEER_GENERATOR      OHCISIM_PEER_MEMSIZE /* See below */
+#define OHCISIM_PEER_GEN_MAX        2048    /* Max payload of generated requests (S400) */
+#define OHCISIM_AR_QUEUE_MAX        256     /* Pending packets per AR context */
+#define OHCISIM_RESPONSE_DELAY      2       /* Default split delay of peer responses, in cycles */
+#define OHCISIM_TICK_US             1000    /* Ticker period */
+#ifndef OHCISIM_SBP2_BLOCKS
+#define OHCISIM_SBP2_BLOCKS         32768   /* 512 bytes blocks of the simulated SBP-2 disk */
+#endif
+#define OHCISIM_SBP2_CMD_CYCLES     1       /* Command overhead of the SBP-2 disk */
+#define OHCISIM_SBP2_BYTES_PER_CYCLE 4096   /* Data rate of the SBP-2 disk (~32MB/s) */
+#define OHCISIM_SBP2_SEEK_CYCLES    2       /* Settle time of a non sequential SBP-2 access */
+#define OHCISIM_SBP2_STROKE_CYCLES  64      /* Seek time over the whole SBP-2 disk (8ms) */
+
+#define OHCISIM_VERSION             0x00010010
+#define OHCISIM_VENDOR_ID           0x00000000
+#define OHCISIM_PCI_VID             0x104c
+#define OHCISIM_PCI_DID             0x8023
+#define OHCISIM_GUID_HI             0x00c0ffee
+#define OHCISIM_GUID_LO             0x10000000 /* + board index */
+
+
+/*----------------------------------------------------------------------------*/
+/*--- STRUCTURES SECTION -----------------------------------------------------*/
+
+typedef struct OHCI1394Sim OHCI1394Sim;
+
+/* A 16 bytes write block at OHCISIM_PEER_GENERATOR on a peer using the default
+ * handler makes it send write block requests to the local node:
+ * quadlets are the requests count, the payload length and the 48-bit destination
+ * offset (high, low). Requests are sent as fast as the AR request context
+ * accepts them, until the count or the next bus reset.
+ */
+
+/* With OHCISIM_SBP2_TARGET defined (make SIMULATOR=1 SIMULATOR_SBP2=1),
+ * the node 0 is also a SBP-2 disk of OHCISIM_SBP2_BLOCKS blocks in RAM:
+ * its config ROM has a SBP-2 unit directory, the management agent accepts
+ * login, reconnect and logout ORBs, and the command agent fetches linked
+ * ORBs (ORB_POINTER, DOORBELL, AGENT_RESET) and executes the SCSI commands
+ * needed by the sbp2 class (TEST UNIT READY, INQUIRY, READ CAPACITY,
+ * READ(10), WRITE(10), START STOP UNIT). Commands take OHCISIM_SBP2_CMD_CYCLES
+ * plus one cycle per OHCISIM_SBP2_BYTES_PER_CYCLE bytes, back-to-back when
+ * ORBs are linked. A READ or WRITE not starting where the previous one ended
+ * also pays a seek: OHCISIM_SBP2_SEEK_CYCLES plus OHCISIM_SBP2_STROKE_CYCLES
+ * scaled by the distance over the disk size.
+ * Other offsets are handled by the default handler.
+ */
+
+/* Called for each asynchronous packet sent by the driver to a simulated peer.
+ * For requests, the peer fills resp and returns an IEEE1394 ack code.
+ * If HELIOS_ACK_PENDING is returned, resp is sent back after the split delay.
+ * For responses sent to the peer, resp is NULL and the return value is the ack.
+ * Called with the model locked: the handler shall not access the model registers.
+ */
+typedef BYTE (*OHCI1394SimPeerHandler)(OHCI1394Sim *   sim,
+                                       UBYTE           phy_id,
+                                       HeliosAPacket * req,
+                                       HeliosAPacket * resp,
+                                       APTR            udata);
+
+/* Called for each isochronous packet sent by an IT context (model locked) */
+typedef void (*OHCI1394SimIsoSink)(OHCI1394Sim *   sim,
+                                   UBYTE           channel,
+                                   UBYTE           tag,
+                                   UBYTE           sy,
+                                   const UBYTE *   payload,
+                                   ULONG           length,
+                                   APTR            udata);
+
+typedef struct OHCI1394SimStats
+{
+    UQUAD   ss_Cycles;
+    ULONG   ss_RegReads;
+    ULONG   ss_RegWrites;
+    ULONG   ss_Interrupts;
+    ULONG   ss_BusResets;
+    ULONG   ss_ATPackets[2];        /* request, response */
+    ULONG   ss_ATBytes[2];
+    ULONG   ss_ARPackets[2];        /* request, response */
+    ULONG   ss_ARBytes[2];
+    ULONG   ss_ARDrops[2];
+    ULONG   ss_MissingAcks;
+    ULONG   ss_PeerResponses;       /* responses sent by the driver to peers */
+    ULONG   ss_IRPackets;
+    ULONG   ss_IRDrops;
+    ULONG   ss_ITPackets;
+    ULONG   ss_ITSkips;
+    ULONG   ss_ITUnderruns;
+    ULONG   ss_DeadContexts;
+    ULONG   ss_Allocs;              /* Packet allocations */
+} OHCI1394SimStats;
+
+
+/*----------------------------------------------------------------------------*/
+/*--- PCIX REPLACEMENT -------------------------------------------------------*/
+
+#ifdef OHCI1394_SIMULATOR
+
+#define PCI_CLASS_SERIAL_FIREWIRE   0x0c00
+
+#define PCIXCONFIG_VENDOR           0x00
+#define PCIXCONFIG_DEVICE           0x02
+#define PCIXCONFIG_COMMAND          0x04
+#define PCIXCONFIG_PROGINTERFACE    0x09
+
+#define PCIXFINDTAG_FULLCLASS       (TAG_USER+0x100)
+#define PCIXINTTAG_MACHINE          (TAG_USER+0x200)
+#define PCIXINTTAG_PRI              (TAG_USER+0x201)
+#define PCIXTAG_OWNER               (TAG_USER+0x300)
+#define PCIXTAG_BASEADDRESS0        (TAG_USER+0x301)
+#define PCIXTAG_BASESIZE0           (TAG_USER+0x302)
+
+#ifndef CODETYPE_PPC
+#define CODETYPE_PPC 2
+#endif
+
+#define PCIXFindBoardTags(b, tags...)               ohcisim_FindBoard(b)
+#define PCIXReadConfigByte(b, o)                    ohcisim_ReadConfig(b, o)
+#define PCIXReadConfigWord(b, o)                    ohcisim_ReadConfig(b, o)
+#define PCIXWriteConfigWord(b, o, v)                ohcisim_WriteConfig(b, o, v)
+#define PCIXAttemptBoard(b)                         ohcisim_AttemptBoard(b)
+#define PCIXObtainBoard(b)                          ohcisim_AttemptBoard(b)
+#define PCIXReleaseBoard(b)                         ohcisim_ReleaseBoard(b)
+#define PCIXGetBoardAttr(b, a)                      ohcisim_GetBoardAttr(b, a)
+#define PCIXSetBoardAttr(b, a, v)                   ohcisim_SetBoardAttr(b, a, v)
+#define PCIXCreateIntObjectTags(b, f, d, tags...)   ohcisim_CreateIntObject(b, (ULONG (*)(APTR))(APTR)(f), d)
+#define PCIXDeleteIntObject(o)                      ohcisim_DeleteIntObject(o)
+#define PCIXDMAGetPhysical(b, p)                    ((void)(b), (APTR)(p))
+
+#endif /* OHCI1394_SIMULATOR */
+
+
+/*----------------------------------------------------------------------------*/
+/*--- EXPORTED API -----------------------------------------------------------*/
+
+/* Bus level (replaces pcix.library open/close) */
+extern struct Library *ohcisim_OpenBus(void);
+extern void ohcisim_CloseBus(struct Library *bus);
+
+/* PCI board emulation */
+extern APTR ohcisim_FindBoard(APTR prev);
+extern UWORD ohcisim_ReadConfig(APTR board, ULONG offset);
+extern void ohcisim_WriteConfig(APTR board, ULONG offset, UWORD value);
+extern BOOL ohcisim_AttemptBoard(APTR board);
+extern void ohcisim_ReleaseBoard(APTR board);
+extern ULONG ohcisim_GetBoardAttr(APTR board, ULONG attr);
+extern BOOL ohcisim_SetBoardAttr(APTR board, ULONG attr, ULONG value);
+extern APTR ohcisim_CreateIntObject(APTR board, ULONG (*handler)(APTR), APTR data);
+extern void ohcisim_DeleteIntObject(APTR intobj);
+
+/* Register file */
+extern QUADLET ohcisim_RegRead(APTR board, LONG offset);
+extern void ohcisim_RegWrite(APTR board, LONG offset, QUADLET value);
+
+/* Harness API */
+extern OHCI1394Sim *ohcisim_GetBoard(ULONG index);
+extern ULONG ohcisim_Step(OHCI1394Sim *sim, ULONG cycles);
+extern void ohcisim_SetAutoStep(OHCI1394Sim *sim, BOOL enable);
+extern void ohcisim_SetPeerCount(OHCI1394Sim *sim, ULONG count);
+extern void ohcisim_SetPeerHandler(OHCI1394Sim *sim, UBYTE phy_id,
+                                   OHCI1394SimPeerHandler handler, APTR udata);
+extern void ohcisim_SetResponseDelay(OHCI1394Sim *sim, ULONG cycles);
+extern void ohcisim_SetIsoSink(OHCI1394Sim *sim, OHCI1394SimIsoSink sink, APTR udata);
+extern void ohcisim_BusReset(OHCI1394Sim *sim);
+extern BOOL ohcisim_InjectRequest(OHCI1394Sim *sim, UBYTE phy_id, HeliosAPacket *req);
+extern BOOL ohcisim_InjectIsoPacket(OHCI1394Sim *sim, UBYTE channel, UBYTE tag, UBYTE sy,
+                                    const UBYTE *payload, ULONG length);
+extern UBYTE *ohcisim_GetPeerMemory(OHCI1394Sim *sim, UBYTE phy_id);
+extern void ohcisim_GetStats(OHCI1394Sim *sim, OHCI1394SimStats *stats);
+extern void ohcisim_ResetStats(OHCI1394Sim *sim);
+extern BYTE ohcisim_DefaultPeerHandler(OHCI1394Sim *   sim,
+                                       UBYTE           phy_id,
+                                       HeliosAPacket * req,
+                                       HeliosAPacket * resp,
+                                       APTR            udata);
+
+/* Capture replay (ohci1394replay.c) */
+extern LONG ohcisim_Replay(OHCI1394Unit *unit, OHCI1394Replay *replay);
+
+#endif /* OHCI1394_SIM_H */
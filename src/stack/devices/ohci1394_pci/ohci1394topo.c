@@ -50,6 +50,7 @@ typedef union SelfIDPkt
 
     struct
     {
+#if BYTE_ORDER == BIG_ENDIAN
         QUADLET PckID:2;        // should be 2
         QUADLET PhyID:6;        // Physical ID
         QUADLET Type:1;         // Packet type: 0 for packets #0, 1 for extended packets (#2, #3, #4)
@@ -65,10 +66,27 @@ typedef union SelfIDPkt
         QUADLET P2:2;           //     ''     , port  2
         QUADLET InitReset:1;    // This port has initiated the bus reset
         QUADLET More:1;         // Nex packet should be a extended packet for this node
+#else
+        QUADLET More:1;
+        QUADLET InitReset:1;
+        QUADLET P2:2;
+        QUADLET P1:2;
+        QUADLET P0:2;
+        QUADLET PowerClass:3;
+        QUADLET Contender:1;
+        QUADLET PhyDelay:2;
+        QUADLET PhySpeed:2;
+        QUADLET GapCount:6;
+        QUADLET ActiveLink:1;
+        QUADLET Type:1;
+        QUADLET PhyID:6;
+        QUADLET PckID:2;
+#endif
     } Packet0;
 
     struct
     {
+#if BYTE_ORDER == BIG_ENDIAN
         QUADLET PckID:2;        // should be 2
         QUADLET PhyID:6;        // Physical ID
         QUADLET Type:1;         // Packet type: 0 for packets #0, 1 for extended packets (#2, #3, #4)
@@ -85,6 +103,23 @@ typedef union SelfIDPkt
         QUADLET InitReset:1;    // This port has initiated the bus reset
         QUADLET Reserved:1;     // A reserved bit (should be 0)
         QUADLET More:1;         // Next packet should be a extended packet for this node
+#else
+        QUADLET More:1;
+        QUADLET Reserved:1;
+        QUADLET InitReset:1;
+        QUADLET Ph:2;
+        QUADLET Pg:2;
+        QUADLET Pf:2;
+        QUADLET Pe:2;
+        QUADLET Pd:2;
+        QUADLET Pc:2;
+        QUADLET Pb:2;
+        QUADLET Pa:2;
+        QUADLET N:3;
+        QUADLET Type:1;
+        QUADLET PhyID:6;
+        QUADLET PckID:2;
+#endif
     } PacketN;
 } SelfIDPkt;
 
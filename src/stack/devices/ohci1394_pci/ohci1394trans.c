@@ -31,6 +31,8 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "ohci1394trans.h"
 
+#include "proto/helios.h"
+
 #include <clib/macros.h>
 
 #include <proto/exec.h>
@@ -61,31 +63,121 @@ static HeliosResponse bad_address_response =
 /*----------------------------------------------------------------------------*/
 /*--- LOCAL CODE SECTION -----------------------------------------------------*/
 
-LONG tl_SearchNextTLabel(OHCI1394Unit *unit)
+#define TLABEL_POOL(unit, nodeid) (&(unit)->hu_TLabelPools[(nodeid) & 0x3f])
+
+/* Lock-free allocation of a tlabel in the pool of a destination node.
+ * Search starts at the tlabel following the last given one, so a tlabel
+ * is not reused just after its release. Returns -1 if all are in use.
+ */
+static LONG tl_AllocTLabel(OHCI1394TLabelPool *pool)
 {
-    LONG tlabel;
+    ULONG hint = pool->tp_Hint & (TLABEL_MAX-1);
+    ULONG i;
 
-    /* fully busy ? */
-    if (~0U == unit->hu_TLabelMap)
+    /* Hint word from the hint bit, the other word, then the hint word again */
+    for (i=0; i < 3; i++)
     {
-        return -1;
+        ULONG w = ((hint / 32) + i) & 1;
+        ULONG skip = (0 == i) ? ((1ul << (hint % 32)) - 1) : 0;
+        ULONG old = ATOMIC_FETCH(&pool->tp_Map[w]);
+
+        while ((ULONG)~0 != (old | skip))
+        {
+            ULONG bit = __builtin_ctz(~(old | skip));
+            ULONG prev = ATOMIC_CMPXCHG(&pool->tp_Map[w], old, old | (1ul << bit));
+
+            if (prev == old)
+            {
+                LONG tlabel = w * 32 + bit;
+
+                pool->tp_Hint = tlabel + 1;
+                return tlabel;
+            }
+
+            old = prev;
+        }
     }
 
-    /* Starting from the last given TLabel, search a non-used one.
-     * I don't check for a full scanning as I've already checked if
-     * one free tlabel exist at least.
-     */
-    tlabel = unit->hu_LastTLabel;
-    do
+    return -1;
+}
+
+static void tl_FreeTLabel(OHCI1394TLabelPool *pool, UBYTE tlabel)
+{
+    ATOMIC_AND(&pool->tp_Map[tlabel / 32], ~(1ul << (tlabel % 32)));
+}
+
+/* Transaction done: count its rcode and its latency since ohci_TL_Register() */
+static void tl_Account(OHCI1394Unit *unit, BYTE rcode, ULONG sent)
+{
+    ULONG now = HELIOS_CYCLE_TICKS(ohci_CycleTimer(unit));
+    ULONG ticks, us, bin;
+
+    sent = HELIOS_CYCLE_TICKS(sent);
+    ticks = now >= sent ? now - sent : now + (HELIOS_CYCLE_WRAP - sent);
+
+    /* us = ticks * 1000 / 24576, without overflow */
+    us = ticks / 24 - ticks / 1024;
+    bin = us ? MIN(32 - __builtin_clz(us), HSTAT_LATENCY_BINS - 1) : 0;
+
+    STAT_INC(unit, hs_RCodes[HSTAT_RCODE_INDEX(rcode) & 31]);
+    STAT_INC(unit, hs_Latency[bin]);
+
+    /* Racy max, an update may be lost against a concurrent one */
+    if (us > unit->hu_Stats.hs_LatencyMax)
+    {
+        unit->hu_Stats.hs_LatencyMax = us;
+    }
+}
+
+/* Put the SPLIT-TIMEOUT timer of a transaction acked pending in the wheel */
+static void tl_ArmSplitTimer(OHCI1394Unit *unit, HeliosTransaction *t)
+{
+    OHCI1394SplitWheel *wheel = &unit->hu_SplitWheel;
+    BOOL start = FALSE;
+
+    LOCK_REGION(unit);
+    {
+        OHCI1394SplitTimer *timer = t->htr_SplitTimerReq;
+
+        /* NULL if already responded or cancelled */
+        if ((NULL != timer) && (NULL == timer->st_Transaction))
+        {
+            ULONG us = (unit->hu_SplitTimeout >> 15) * 1000000 + (unit->hu_SplitTimeout & 0x7fff) * 125;
+
+            /* Rounded up, plus one as the current tick is already started */
+            timer->st_Expire = wheel->sw_Tick + (us + SPLIT_WHEEL_TICK_US - 1) / SPLIT_WHEEL_TICK_US + 1;
+            timer->st_Transaction = t;
+            ADDTAIL((struct List *)&wheel->sw_Slots[timer->st_Expire % SPLIT_WHEEL_SLOTS], (struct Node *)timer);
+
+            unit->hu_SplitStats.ss_Armed++;
+            start = 1 == ++wheel->sw_Pending;
+        }
+    }
+    UNLOCK_REGION(unit);
+
+    /* The wheel doesn't turn when empty */
+    if (start)
     {
-        tlabel = (tlabel >= 63) ? 0 : tlabel + 1;
+        Helios_SignalSubTask(unit->hu_SplitTimeoutTask, unit->hu_SplitTimeoutSignal);
     }
-    while (unit->hu_TLabelMap & (1ull << tlabel));
+}
 
-    unit->hu_LastTLabel = tlabel;
-    unit->hu_TLabelMap |= 1ull << tlabel;
+/* Remove the SPLIT-TIMEOUT timer of a finished transaction from the wheel.
+ * Called with the unit lock.
+ */
+static void tl_DisarmSplitTimer(OHCI1394Unit *unit, HeliosTransaction *t)
+{
+    OHCI1394SplitTimer *timer = t->htr_SplitTimerReq;
+
+    if ((NULL != timer) && (NULL != timer->st_Transaction))
+    {
+        REMOVE((struct Node *)timer);
+        timer->st_Transaction = NULL;
+        unit->hu_SplitWheel.sw_Pending--;
+        unit->hu_SplitStats.ss_Cancelled++;
+    }
 
-    return tlabel;
+    t->htr_SplitTimerReq = NULL;
 }
 
 /* This callback shall implement the TR_DATA.confirmation service */
@@ -107,10 +199,7 @@ static void tl_ATCompleteCb(OHCI1394Unit *unit,
 
         case HELIOS_ACK_PENDING:
             t->htr_Packet.TimeStamp = timestamp;
-
-            /* Split-Timeout timer */
-            ((OHCI1394SplitTimeReq *)t->htr_SplitTimerReq)->req.tr_node.io_Command = TR_ADDREQUEST;
-            SendIO((struct IORequest *)t->htr_SplitTimerReq);
+            tl_ArmSplitTimer(unit, t);
             break;
 
         case HELIOS_ACK_BUSY_X:
@@ -213,6 +302,7 @@ void tl_send_response(OHCI1394Unit *unit,
         _ERR_UNIT(unit, "AllocPooled() failed\n");
         return;
     }
+    ATOMIC_ADD((LONG *)&unit->hu_TLAllocs, 1);
 
     /* Fill the response header data */
     resp->hr_Packet.Header[1] = (req->SourceID << 16) | (resp->hr_Packet.RCode << 12);
@@ -266,6 +356,58 @@ void tl_send_response(OHCI1394Unit *unit,
 }
 
 
+/* Build the request header and register the transaction.
+ * do not use it if tcode one of :
+ * TCODE_WRITE_PHY, TCODE_WRITE_STREAM
+ */
+static LONG tl_PrepareRequest(OHCI1394Unit *unit,
+                              HeliosTransaction *t,
+                              UWORD destid,
+                              HeliosSpeed speed,
+                              UBYTE tcode,
+                              UWORD extcode,
+                              HeliosOffset offset,
+                              QUADLET *payload,
+                              ULONG length)
+{
+    t->htr_Packet.DestID = destid;
+    t->htr_Packet.TimeStamp = 0;
+
+    /* Prepare the packet */
+    t->htr_Packet.Header[0] = AT_HEADER_SPEED(speed) |
+                              AT_HEADER_TLABEL(t->htr_Packet.TLabel) |
+                              AT_HEADER_RT(RETRY_X) |
+                              AT_HEADER_TCODE(tcode);
+    t->htr_Packet.Header[1] = AT_HEADER_DEST_ID(destid) | (UWORD)(offset >> 32);
+    t->htr_Packet.Header[2] = offset;
+
+    switch (tcode)
+    {
+        case TCODE_READ_BLOCK_REQUEST:
+        case TCODE_WRITE_BLOCK_REQUEST:
+            t->htr_Packet.Header[3] = AT_HEADER_LEN(length);
+            break;
+
+        case TCODE_WRITE_QUADLET_REQUEST:
+            t->htr_Packet.Header[3] = payload[0];
+            break;
+
+        case TCODE_LOCK_REQUEST:
+            t->htr_Packet.Header[3] = AT_HEADER_LEN(length) | AT_HEADER_EXTCODE(extcode);
+            break;
+    }
+
+    if (-1 == ohci_TL_Register(unit, t, tl_ATCompleteCb, t))
+    {
+        return IOERR_UNITBUSY;
+    }
+
+    TRACE(&unit->hu_Trace, HTP_TL_SEND, (UBYTE)t->htr_Packet.TLabel, ((ULONG)destid << 16) | tcode, t);
+
+    return HHIOERR_NO_ERROR;
+}
+
+
 /*----------------------------------------------------------------------------*/
 /*--- PUBLIC CODE SECTION ----------------------------------------------------*/
 
@@ -274,21 +416,23 @@ LONG ohci_TL_Register(OHCI1394Unit *unit,
                       OHCI1394ATCompleteCallback cb,
                       APTR cb_udata)
 {
-    /* Find next available tlabel */
-    LOCK_REGION(unit);
-    t->htr_Packet.TLabel = tl_SearchNextTLabel(unit);
-    UNLOCK_REGION(unit);
+    OHCI1394TLabelPool *pool = TLABEL_POOL(unit, t->htr_Packet.DestID);
+
+    /* Find next available tlabel for this destination */
+    t->htr_Packet.TLabel = tl_AllocTLabel(pool);
 
     if (-1 != t->htr_Packet.TLabel)
     {
-        OHCI1394ATPacketData *pdata = &unit->hu_PacketData[t->htr_Packet.TLabel];
+        OHCI1394ATPacketData *pdata = &pool->tp_PacketData[t->htr_Packet.TLabel];
 
-        _INFO_UNIT(unit, "t=%p, TL=%d\n", t, (ULONG)t->htr_Packet.TLabel);
+        _INFO_UNIT(unit, "t=%p, DestID=$%04x, TL=%d\n", t, t->htr_Packet.DestID, (ULONG)t->htr_Packet.TLabel);
 
-        unit->hu_Transactions[t->htr_Packet.TLabel] = t;
+        pool->tp_Transactions[t->htr_Packet.TLabel] = t;
+        t->htr_SplitTimerReq = &pool->tp_SplitTimers[t->htr_Packet.TLabel];
         pdata->pd_AckCallback = cb;
         pdata->pd_UData = cb_udata;
         pdata->pd_Buffer = NULL;
+        pdata->pd_SendTime = ohci_CycleTimer(unit);
         t->htr_Private = pdata;
     }
     else
@@ -299,28 +443,71 @@ LONG ohci_TL_Register(OHCI1394Unit *unit,
     return t->htr_Packet.TLabel;
 }
 
+/* Build and register a request as ohci_TL_SendRequest() does, without sending it.
+ * The AT completion is given by the caller to the packet data in t->htr_Private
+ * (capture replay).
+ */
+LONG ohci_TL_PrepareRequest(OHCI1394Unit *unit,
+                            HeliosTransaction *t,
+                            UWORD destid,
+                            HeliosSpeed speed,
+                            UBYTE tcode,
+                            UWORD extcode,
+                            HeliosOffset offset,
+                            QUADLET *payload,
+                            ULONG length)
+{
+    return tl_PrepareRequest(unit, t, destid, speed, tcode, extcode, offset, payload, length);
+}
+
+/* Finish a transaction taken from the expired list of the SPLIT-TIMEOUT wheel */
+static void tl_FinishExpired(OHCI1394Unit *unit, OHCI1394SplitTimer *timer, BYTE status)
+{
+    HeliosTransaction *t = timer->st_Transaction;
+    UBYTE tlabel = t->htr_Packet.TLabel;
+
+    tl_Account(unit, status, TLABEL_POOL(unit, t->htr_Packet.DestID)->tp_PacketData[tlabel].pd_SendTime);
+
+    timer->st_Transaction = NULL;
+    t->htr_Packet.TLabel = -1;
+    tl_FreeTLabel(TLABEL_POOL(unit, t->htr_Packet.DestID), tlabel);
+
+    t->htr_Callback(t, status, NULL, 0);
+}
+
 void ohci_TL_FlushAll(OHCI1394Unit *unit)
 {
     LOCK_REGION(unit);
     {
-        ULONG i;
+        OHCI1394SplitTimer *timer;
+        ULONG i, j;
+
+        /* Expired but not finished yet by the SplitTimeout task */
+        while (NULL != (timer = (OHCI1394SplitTimer *)REMHEAD((struct List *)&unit->hu_SplitWheel.sw_Expired)))
+        {
+            tl_FinishExpired(unit, timer, HELIOS_RCODE_CANCELLED);
+        }
 
-        for (i=0; i<TLABEL_MAX; i++)
+        for (i=0; i<TLABEL_POOLS; i++)
         {
-            HeliosTransaction *t = unit->hu_Transactions[i];
+            OHCI1394TLabelPool *pool = &unit->hu_TLabelPools[i];
 
-            if (NULL != t)
+            for (j=0; j<TLABEL_MAX; j++)
             {
-                if (NULL != t->htr_Private)
+                HeliosTransaction *t = pool->tp_Transactions[j];
+
+                if (NULL != t)
                 {
-                    ohci_CancelATPacket(unit, t->htr_Private);
+                    if (NULL != t->htr_Private)
+                    {
+                        ohci_CancelATPacket(unit, t->htr_Private);
+                    }
+                    ohci_TL_Finish(unit, t, HELIOS_RCODE_CANCELLED);
                 }
-                ohci_TL_Finish(unit, t, HELIOS_RCODE_CANCELLED);
             }
-        }
 
-        unit->hu_LastTLabel = -1;
-        unit->hu_TLabelMap = 0;
+            pool->tp_Hint = 0;
+        }
     }
     UNLOCK_REGION(unit);
 }
@@ -328,7 +515,9 @@ void ohci_TL_FlushAll(OHCI1394Unit *unit)
 /* The transaction shall be cancelled at AT-layer before calling this function */
 void ohci_TL_Finish(OHCI1394Unit *unit, HeliosTransaction *t, BYTE status)
 {
+    OHCI1394TLabelPool *pool = TLABEL_POOL(unit, t->htr_Packet.DestID);
     BOOL cb_not_called = FALSE;
+    ULONG sent = 0;
 
     /* Free the tlabel */
     LOCK_REGION(unit);
@@ -336,26 +525,15 @@ void ohci_TL_Finish(OHCI1394Unit *unit, HeliosTransaction *t, BYTE status)
         _INFO_UNIT(unit, "t=%p, TL=$%X\n", t, t->htr_Packet.TLabel);
 
         /* Pending ? */
-        if ((((UBYTE)t->htr_Packet.TLabel) < 64) && (NULL != unit->hu_Transactions[t->htr_Packet.TLabel]))
+        if ((((UBYTE)t->htr_Packet.TLabel) < TLABEL_MAX) && (t == pool->tp_Transactions[t->htr_Packet.TLabel]))
         {
             cb_not_called = TRUE;
-            unit->hu_Transactions[t->htr_Packet.TLabel] = NULL;
-            unit->hu_TLabelMap &= ~(1ull << t->htr_Packet.TLabel);
+            sent = pool->tp_PacketData[t->htr_Packet.TLabel].pd_SendTime;
+            pool->tp_Transactions[t->htr_Packet.TLabel] = NULL;
+            tl_FreeTLabel(pool, t->htr_Packet.TLabel);
             t->htr_Private = NULL;
             t->htr_Packet.TLabel = -1;
-
-            /* Abort SPLIT-TIMER request */
-            if (HELIOS_ACK_PENDING == t->htr_Packet.Ack)
-            {
-                OHCI1394SplitTimeReq *req = t->htr_SplitTimerReq;
-
-                req->transaction = NULL;
-                if (!CheckIO(&req->req.tr_node))
-                {
-                    AbortIO(&req->req.tr_node);
-                }
-                t->htr_SplitTimerReq = NULL;
-            }
+            tl_DisarmSplitTimer(unit, t);
         }
     }
     UNLOCK_REGION(unit);
@@ -363,6 +541,8 @@ void ohci_TL_Finish(OHCI1394Unit *unit, HeliosTransaction *t, BYTE status)
     /* Let application play with data (TR_DATA.confirmation service) */
     if (cb_not_called)
     {
+        TRACE(&unit->hu_Trace, HTP_TL_FINISH, (UBYTE)status, t->htr_Packet.DestID, t);
+        tl_Account(unit, status, sent);
         _INFO_UNIT(unit, "trans %p, calling cb %p, status=%d\n", t, t->htr_Callback, (WORD)status);
         t->htr_Callback(t, status, NULL, 0);
     }
@@ -387,12 +567,79 @@ void ohci_TL_Cancel(OHCI1394Unit *unit, HeliosTransaction *t)
     }
 }
 
+/* Turn the SPLIT-TIMEOUT wheel by one tick and finish expired transactions.
+ * Returns FALSE if the wheel is empty (no more tick needed).
+ */
+BOOL ohci_TL_SplitTimeoutTick(OHCI1394Unit *unit)
+{
+    OHCI1394SplitWheel *wheel = &unit->hu_SplitWheel;
+    OHCI1394SplitTimer *timer, *next;
+    BOOL pending;
+
+    LOCK_REGION(unit);
+    {
+        struct MinList *slot = &wheel->sw_Slots[++wheel->sw_Tick % SPLIT_WHEEL_SLOTS];
+
+        ForeachNodeSafe(slot, timer, next)
+        {
+            HeliosTransaction *t = timer->st_Transaction;
+
+            /* Expires on a next turn? */
+            if ((LONG)(timer->st_Expire - wheel->sw_Tick) > 0)
+            {
+                continue;
+            }
+
+            /* Not pending anymore, but the tlabel (and so this timer) is kept
+             * up to the callback call.
+             */
+            TLABEL_POOL(unit, t->htr_Packet.DestID)->tp_Transactions[t->htr_Packet.TLabel] = NULL;
+            t->htr_Private = NULL;
+            t->htr_SplitTimerReq = NULL;
+
+            REMOVE((struct Node *)timer);
+            ADDTAIL((struct List *)&wheel->sw_Expired, (struct Node *)timer);
+            wheel->sw_Pending--;
+            unit->hu_SplitStats.ss_Expired++;
+        }
+
+        pending = wheel->sw_Pending > 0;
+    }
+    UNLOCK_REGION(unit);
+
+    /* Taken one by one: a flush may cancel the remaining ones meanwhile */
+    for (;;)
+    {
+        HeliosTransaction *t;
+
+        LOCK_REGION(unit);
+        timer = (OHCI1394SplitTimer *)REMHEAD((struct List *)&wheel->sw_Expired);
+        UNLOCK_REGION(unit);
+
+        if (NULL == timer)
+        {
+            break;
+        }
+
+        t = timer->st_Transaction;
+        _INFO_UNIT(unit, "SPLIT-TIMEOUT: t=%p, DestID=$%04x, TL=%u\n", t, t->htr_Packet.DestID, t->htr_Packet.TLabel);
+        TRACE(&unit->hu_Trace, HTP_TL_TIMEOUT, t->htr_Packet.TLabel, t->htr_Packet.DestID, t);
+        STAT_INC(unit, hs_SplitTimeouts);
+
+        tl_FinishExpired(unit, timer, HELIOS_RCODE_TIMEOUT);
+    }
+
+    return pending;
+}
+
 
 void ohci_TL_HandleResponse(OHCI1394Unit *unit, HeliosAPacket *resp)
 {
     HeliosTransaction *t;
     UBYTE tlabel = resp->TLabel;
+    OHCI1394TLabelPool *pool = TLABEL_POOL(unit, resp->SourceID);
     OHCI1394ATPacketData *pdata;
+    ULONG sent = 0;
 
     _INFO_UNIT(unit, "$%04x -> $%04x: TC=$%x, TL=$%x, Ack=%u, RCode=%u\n",
                resp->SourceID, resp->DestID, resp->TCode, resp->TLabel, resp->Ack, resp->RCode);
@@ -400,34 +647,22 @@ void ohci_TL_HandleResponse(OHCI1394Unit *unit, HeliosAPacket *resp)
     LOCK_REGION(unit);
     {
         _INFO_UNIT(unit, "TL=$%x Payload=%p, %lu byte(s)\n", resp->TLabel, resp->Payload, resp->PayloadLength);
-        t = unit->hu_Transactions[tlabel];
+        t = pool->tp_Transactions[tlabel];
 
         /* for response incoming packet we're going to check if it expected or not,
          * that could speed-up bit the process if the packet wasn't expected.
          */
         if ((NULL != t) && (resp->SourceID == t->htr_Packet.DestID))
         {
-            OHCI1394SplitTimeReq *req;
-
             /* remove transaction from the pending list */
-            unit->hu_Transactions[tlabel] = NULL;
-            unit->hu_TLabelMap &= ~(1ull << tlabel);
+            sent = pool->tp_PacketData[tlabel].pd_SendTime;
+            pool->tp_Transactions[tlabel] = NULL;
+            tl_FreeTLabel(pool, tlabel);
             t->htr_Packet.TLabel = -1;
 
             pdata = t->htr_Private;
             t->htr_Private = NULL;
-
-            /* Abort SPLIT-TIMER request */
-            req = t->htr_SplitTimerReq;
-            if (0 != req->req.tr_node.io_Command)
-            {
-                req->transaction = NULL;
-                if (!CheckIO(&req->req.tr_node))
-                {
-                    AbortIO(&req->req.tr_node);
-                }
-                t->htr_SplitTimerReq = NULL;
-            }
+            tl_DisarmSplitTimer(unit, t);
 
             /* Cancel ATComplete handler */
             if (NULL != pdata)
@@ -445,11 +680,15 @@ void ohci_TL_HandleResponse(OHCI1394Unit *unit, HeliosAPacket *resp)
     }
     UNLOCK_REGION(unit);
 
+    TRACE(&unit->hu_Trace, HTP_TL_RESPONSE, resp->RCode, ((ULONG)resp->SourceID << 16) | tlabel, t);
+
     if (NULL == t)
     {
         return;
     }
 
+    tl_Account(unit, resp->RCode, sent);
+
     if (TCODE_READ_QUADLET_RESPONSE == resp->TCode)
     {
         resp->Payload = &resp->QuadletData;
@@ -460,6 +699,90 @@ void ohci_TL_HandleResponse(OHCI1394Unit *unit, HeliosAPacket *resp)
     t->htr_Callback(t, resp->RCode, resp->Payload, resp->PayloadLength);
 }
 
+/* Request handlers are indexed by a sorted array of their regions.
+ * Regions never overlap, so a binary search on the start offset
+ * gives the handler of an incoming request.
+ * WARNING: call these functions with hu_ReqHandlerData locked.
+ */
+
+/* Returns the position of the first handler starting above offset */
+static ULONG tl_ReqHandler_Search(OHCI1394Unit *unit, HeliosOffset offset)
+{
+    HeliosHWReqHandler **index = unit->hu_ReqHandlerData.rhd_Index;
+    ULONG lo = 0, hi = unit->hu_ReqHandlerData.rhd_Count;
+
+    while (lo < hi)
+    {
+        ULONG mid = (lo + hi) / 2;
+
+        if (index[mid]->rh_Start <= offset)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static HeliosHWReqHandler *tl_ReqHandler_Find(OHCI1394Unit *unit, HeliosOffset offset)
+{
+    HeliosHWReqHandler *node;
+    ULONG pos;
+
+    pos = tl_ReqHandler_Search(unit, offset);
+    if (0 == pos)
+    {
+        return NULL;
+    }
+
+    node = unit->hu_ReqHandlerData.rhd_Index[pos-1];
+    if (offset < (node->rh_Start + node->rh_Length))
+    {
+        return node;
+    }
+
+    return NULL;
+}
+
+static LONG tl_ReqHandler_Insert(OHCI1394Unit *unit, HeliosHWReqHandler *reqh, ULONG pos)
+{
+    HeliosHWReqHandler **index = unit->hu_ReqHandlerData.rhd_Index;
+    ULONG count = unit->hu_ReqHandlerData.rhd_Count;
+
+    if (count == unit->hu_ReqHandlerData.rhd_Size)
+    {
+        ULONG size = count ? count * 2 : 16;
+
+        index = AllocPooled(unit->hu_MemPool, size * sizeof(*index));
+        if (NULL == index)
+        {
+            _ERR_UNIT(unit, "AllocPooled() failed\n");
+            return HHIOERR_NOMEM;
+        }
+        ATOMIC_ADD((LONG *)&unit->hu_TLAllocs, 1);
+
+        if (count > 0)
+        {
+            CopyMem(unit->hu_ReqHandlerData.rhd_Index, index, count * sizeof(*index));
+            FreePooled(unit->hu_MemPool, unit->hu_ReqHandlerData.rhd_Index,
+                       unit->hu_ReqHandlerData.rhd_Size * sizeof(*index));
+        }
+
+        unit->hu_ReqHandlerData.rhd_Index = index;
+        unit->hu_ReqHandlerData.rhd_Size = size;
+    }
+
+    memmove(&index[pos+1], &index[pos], (count - pos) * sizeof(*index));
+    index[pos] = reqh;
+    unit->hu_ReqHandlerData.rhd_Count++;
+
+    return HHIOERR_NO_ERROR;
+}
+
 void ohci_TL_HandleRequest(OHCI1394Unit *unit, HeliosAPacket *req, UBYTE generation)
 {
     HeliosResponse *response = NULL;
@@ -476,20 +799,21 @@ void ohci_TL_HandleRequest(OHCI1394Unit *unit, HeliosAPacket *req, UBYTE generat
     LOCK_REGION_SHARED(&unit->hu_ReqHandlerData);
     {
         HeliosHWReqHandler *node;
-        BOOL found = FALSE;
 
-        ForeachNode(&unit->hu_ReqHandlerData.rhd_List, node)
+        node = tl_ReqHandler_Find(unit, req->Offset);
+        if (NULL != node)
         {
-            if ((req->Offset >= node->rh_Start) && (req->Offset < (node->rh_Start+node->rh_Length)))
+            _INFO_UNIT(unit, "handler=%p, callback=%p\n", node, node->rh_ReqCallback);
+
+            /* Payload lent to the handler until it calls rh_Release() */
+            if ((node->rh_Flags & HHF_REQH_ZEROCOPY) && (NULL != req->Payload))
             {
-                _INFO_UNIT(unit, "handler=%p, callback=%p\n", node, node->rh_ReqCallback);
-                response = node->rh_ReqCallback(req, node->rh_UserData);
-                found = TRUE;
-                break; /* handlers not overlap */
+                req->Payload = ohci_ARContext_HoldPayload(unit, req->Payload, req->PayloadLength);
             }
-        }
 
-        if (!found)
+            response = node->rh_ReqCallback(req, node->rh_UserData);
+        }
+        else
         {
             response = &bad_address_response;
             _ERR_UNIT(unit, "no handler found\n");
@@ -521,65 +845,22 @@ LONG ohci_TL_SendRequest(OHCI1394Unit *unit,
     OHCI1394ATPacketData *pdata;
     HeliosAPacket resp;
     UWORD nodeid;
-    ULONG split_timeout;
-    OHCI1394SplitTimeReq *req;
-
-    t->htr_Packet.DestID = destid;
-    t->htr_Packet.TimeStamp = 0;
-
-    /* Prepare the packet */
-    t->htr_Packet.Header[0] = AT_HEADER_SPEED(speed) |
-                              AT_HEADER_TLABEL(t->htr_Packet.TLabel) |
-                              AT_HEADER_RT(RETRY_X) |
-                              AT_HEADER_TCODE(tcode);
-    t->htr_Packet.Header[1] = AT_HEADER_DEST_ID(destid) | (UWORD)(offset >> 32);
-    t->htr_Packet.Header[2] = offset;
-
-    switch (tcode)
-    {
-        case TCODE_READ_BLOCK_REQUEST:
-        case TCODE_WRITE_BLOCK_REQUEST:
-            t->htr_Packet.Header[3] = AT_HEADER_LEN(length);
-            break;
-
-        case TCODE_WRITE_QUADLET_REQUEST:
-            t->htr_Packet.Header[3] = payload[0];
-            break;
-
-        case TCODE_LOCK_REQUEST:
-            t->htr_Packet.Header[3] = AT_HEADER_LEN(length) | AT_HEADER_EXTCODE(extcode);
-            break;
-    }
+    LONG err;
 
-    if (-1 == ohci_TL_Register(unit, t, tl_ATCompleteCb, t))
+    err = tl_PrepareRequest(unit, t, destid, speed, tcode, extcode, offset, payload, length);
+    if (HHIOERR_NO_ERROR != err)
     {
-        return IOERR_UNITBUSY;
+        return err;
     }
 
     pdata = t->htr_Private;
 
     LOCK_REGION_SHARED(unit);
     {
-        split_timeout = unit->hu_SplitTimeout;
         nodeid = unit->hu_LocalNodeId;
     }
     UNLOCK_REGION_SHARED(unit);
 
-    /* setup the SPLIT-TIMEOUT timer request */
-    t->htr_SplitTimerReq = req = AllocPooled(unit->hu_MemPool, sizeof(OHCI1394SplitTimeReq));
-    if (NULL == req)
-    {
-        _ERR("SplitTime request alloc failed\n");
-        return IOERR_NOMEMORY;
-    }
-
-    CopyMem(unit->hu_SplitTimeoutIOReq, req, sizeof(OHCI1394SplitTimeReq));
-    req->transaction = t;
-    req->req.tr_node.io_Message.mn_Length = sizeof(OHCI1394SplitTimeReq);
-    req->req.tr_node.io_Command = 0;
-    req->req.tr_time.tv_secs = split_timeout >> 15;
-    req->req.tr_time.tv_micro = (split_timeout & 0x7fff) * 125;
-
     /* Remote node ? */
     if (destid != nodeid)
         return ohci_ATContext_Send(&unit->hu_ATRequestCtx, generation, &t->htr_Packet.Header[0],
@@ -651,6 +932,90 @@ LONG ohci_TL_SendRequest(OHCI1394Unit *unit,
     return HHIOERR_NO_ERROR;
 }
 
+/* Send a set of requests prepared by the caller in the transaction packets
+ * (DestID, Speed, TCode, ExtTCode, Offset, Payload and PayloadLength fields).
+ * Remote requests are given to the AT request context by batch,
+ * so the DMA is woken-up once per batch and not once per request.
+ * Each transaction is finished through its callback in any cases.
+ * Returns the number of requests put on the bus or handled locally.
+ */
+ULONG ohci_TL_SendRequests(OHCI1394Unit *unit,
+                           UBYTE generation,
+                           HeliosTransaction **ts,
+                           ULONG count)
+{
+    OHCI1394ATSendVec vec[OHCI1394_AT_BATCH_MAX];
+    HeliosTransaction *t;
+    HeliosAPacket *p;
+    ULONG i, n = 0, sent = 0;
+    UWORD nodeid;
+    LONG err;
+
+    LOCK_REGION_SHARED(unit);
+    {
+        nodeid = unit->hu_LocalNodeId;
+    }
+    UNLOCK_REGION_SHARED(unit);
+
+    for (i=0; i < count; i++)
+    {
+        t = ts[i];
+        p = &t->htr_Packet;
+
+        /* Local requests follow the non-batched path */
+        if (p->DestID == nodeid)
+        {
+            err = ohci_TL_SendRequest(unit, t, p->DestID, p->Speed, generation, p->TCode,
+                                      p->ExtTCode, p->Offset, p->Payload, p->PayloadLength);
+        }
+        else
+        {
+            err = tl_PrepareRequest(unit, t, p->DestID, p->Speed, p->TCode,
+                                    p->ExtTCode, p->Offset, p->Payload, p->PayloadLength);
+            if (HHIOERR_NO_ERROR == err)
+            {
+                vec[n].sv_Header = &p->Header[0];
+                vec[n].sv_Payload = p->Payload;
+                vec[n].sv_PacketData = t->htr_Private;
+                vec[n].sv_TLabel = p->TLabel;
+                vec[n].sv_TimeStamp = 0;
+
+                if (++n == OHCI1394_AT_BATCH_MAX)
+                {
+                    sent += ohci_ATContext_SendV(&unit->hu_ATRequestCtx, generation, vec, n);
+                    n = 0;
+                }
+                continue;
+            }
+        }
+
+        if (HHIOERR_NO_ERROR == err)
+        {
+            sent++;
+        }
+        else
+        {
+            _ERR_UNIT(unit, "request #%lu failed, err=%ld\n", i, err);
+            if (-1 == p->TLabel)
+            {
+                /* No tlabel: not registered, ohci_TL_Finish() can't be used */
+                t->htr_Callback(t, HELIOS_RCODE_BUSY, NULL, 0);
+            }
+            else
+            {
+                ohci_TL_Finish(unit, t, HELIOS_RCODE_BUSY);
+            }
+        }
+    }
+
+    if (n > 0)
+    {
+        sent += ohci_ATContext_SendV(&unit->hu_ATRequestCtx, generation, vec, n);
+    }
+
+    return sent;
+}
+
 /* TCODE_WRITE_STREAM not supported */
 LONG ohci_TL_DoRequest(OHCI1394Unit *unit,
                        UBYTE sigbit,
@@ -744,64 +1109,116 @@ LONG ohci_TL_DoPHYPacket(OHCI1394Unit *unit,
 LONG ohci_TL_AddReqHandler(OHCI1394Unit *unit, HeliosHWReqHandler *reqh)
 {
     LONG err = HHIOERR_FAILED;
-    HeliosHWReqHandler *node;
+    HeliosHWReqHandler **index;
     HeliosOffset start;
+    ULONG pos;
 
     /* Sanity checks:
-     *  - Region is 4-bytes aligned and limited to 48bits.
+     *  - Region (or the fixed start address) is 4-bytes aligned and limited to 48bits.
      *  - Length shall be 4-bytes aligned and not zero.
      * TODO: check against the physicalUpperBound value.
      */
-    if ((reqh->rh_RegionStart & 0xFFFF000000000003ULL) ||
-        (reqh->rh_RegionStop & 0xFFFF000000000003ULL) ||
-        (reqh->rh_RegionStart >= reqh->rh_RegionStop) ||
-        (reqh->rh_Length & 3) ||
-        (0 == reqh->rh_Length))
+    if ((reqh->rh_Length & 3) || (0 == reqh->rh_Length))
     {
         return IOERR_BADADDRESS;
     }
 
-    /* TODO: I support only HHF_REQH_ALLOCLEN allocation type */
-    if (reqh->rh_Flags != HHF_REQH_ALLOCLEN)
+    if (reqh->rh_Flags & HHF_REQH_ALLOCLEN)
     {
-        return HHIOERR_FAILED;
+        if ((reqh->rh_RegionStart & 0xFFFF000000000003ULL) ||
+            (reqh->rh_RegionStop & 0xFFFF000000000003ULL) ||
+            (reqh->rh_RegionStart >= reqh->rh_RegionStop))
+        {
+            return IOERR_BADADDRESS;
+        }
+    }
+    else if ((reqh->rh_Start & 0xFFFF000000000003ULL) ||
+             ((reqh->rh_Start + reqh->rh_Length) > 0x1000000000000ULL))
+    {
+        return IOERR_BADADDRESS;
     }
 
-    start = reqh->rh_RegionStart;
-    node = (APTR)GetHead(&unit->hu_ReqHandlerData.rhd_List);
+    if (reqh->rh_Flags & ~(HHF_REQH_ALLOCLEN | HHF_REQH_ZEROCOPY))
+    {
+        return HHIOERR_FAILED;
+    }
 
-    _INFO_UNIT(unit, "start=$%llx, node=%p\n", start, node);
+    if (reqh->rh_Flags & HHF_REQH_ZEROCOPY)
+    {
+        reqh->rh_Release = ohci_ARContext_ReleasePayload;
+        reqh->rh_ReleaseData = unit;
+    }
 
     LOCK_REGION(&unit->hu_ReqHandlerData);
     {
-        while ((start + reqh->rh_Length) < reqh->rh_RegionStop)
+        index = unit->hu_ReqHandlerData.rhd_Index;
+
+        if (reqh->rh_Flags & HHF_REQH_ALLOCLEN)
         {
-            /* no more registred handlers or requested is below */
-            if ((NULL == node) || ((start + reqh->rh_Length) <= node->rh_Start))
+            /* First gap large enough in the region */
+            start = reqh->rh_RegionStart;
+            pos = tl_ReqHandler_Search(unit, start);
+            if ((pos > 0) && ((index[pos-1]->rh_Start + index[pos-1]->rh_Length) > start))
             {
-                reqh->rh_Start = start;
-                ADDTAIL(&unit->hu_ReqHandlerData.rhd_List, reqh);
-                err = HHIOERR_NO_ERROR;
-                break;
+                start = index[pos-1]->rh_Start + index[pos-1]->rh_Length;
             }
 
-            start = node->rh_Start + node->rh_Length;
-            node = (APTR)GetSucc(node);
+            _INFO_UNIT(unit, "start=$%llx, pos=%lu\n", start, pos);
+
+            while ((start + reqh->rh_Length) <= reqh->rh_RegionStop)
+            {
+                /* no more registred handlers or requested is below */
+                if ((pos == unit->hu_ReqHandlerData.rhd_Count) ||
+                    ((start + reqh->rh_Length) <= index[pos]->rh_Start))
+                {
+                    reqh->rh_Start = start;
+                    err = tl_ReqHandler_Insert(unit, reqh, pos);
+                    break;
+                }
+
+                start = index[pos]->rh_Start + index[pos]->rh_Length;
+                pos++;
+            }
+        }
+        else
+        {
+            /* Fixed address: fails if overlapping one of its neighbours */
+            start = reqh->rh_Start;
+            pos = tl_ReqHandler_Search(unit, start);
+            if (((0 == pos) || ((index[pos-1]->rh_Start + index[pos-1]->rh_Length) <= start)) &&
+                ((pos == unit->hu_ReqHandlerData.rhd_Count) ||
+                 ((start + reqh->rh_Length) <= index[pos]->rh_Start)))
+            {
+                err = tl_ReqHandler_Insert(unit, reqh, pos);
+            }
         }
     }
     UNLOCK_REGION(&unit->hu_ReqHandlerData);
 
-    _INFO_UNIT(unit, "err=%ld\n", err);
+    _INFO_UNIT(unit, "start=$%llx, err=%ld\n", reqh->rh_Start, err);
 
     return err;
 }
 
 LONG ohci_TL_RemReqHandler(OHCI1394Unit *unit, HeliosHWReqHandler *reqh)
 {
+    HeliosHWReqHandler **index;
+    LONG err = HHIOERR_FAILED;
+    ULONG pos;
+
     LOCK_REGION(&unit->hu_ReqHandlerData);
-    REMOVE(reqh);
+    {
+        index = unit->hu_ReqHandlerData.rhd_Index;
+        pos = tl_ReqHandler_Search(unit, reqh->rh_Start);
+        if ((pos > 0) && (index[pos-1] == reqh))
+        {
+            unit->hu_ReqHandlerData.rhd_Count--;
+            memmove(&index[pos-1], &index[pos], (unit->hu_ReqHandlerData.rhd_Count - pos + 1) * sizeof(*index));
+            err = HHIOERR_NO_ERROR;
+        }
+    }
     UNLOCK_REGION(&unit->hu_ReqHandlerData);
 
-    return HHIOERR_NO_ERROR;
+    return err;
 }
 
@@ -35,9 +35,19 @@ extern LONG ohci_TL_Register(OHCI1394Unit *unit,
                              HeliosTransaction *t,
                              OHCI1394ATCompleteCallback cb,
                              APTR cb_udata);
+extern LONG ohci_TL_PrepareRequest(OHCI1394Unit *unit,
+                                   HeliosTransaction *t,
+                                   UWORD destid,
+                                   HeliosSpeed speed,
+                                   UBYTE tcode,
+                                   UWORD extcode,
+                                   HeliosOffset offset,
+                                   QUADLET *payload,
+                                   ULONG length);
 extern void ohci_TL_FlushAll(OHCI1394Unit *unit);
 extern void ohci_TL_Finish(OHCI1394Unit *unit, HeliosTransaction *t, BYTE rcode);
 extern void ohci_TL_Cancel(OHCI1394Unit *unit, HeliosTransaction *t);
+extern BOOL ohci_TL_SplitTimeoutTick(OHCI1394Unit *unit);
 
 extern void ohci_TL_HandleResponse(OHCI1394Unit *unit, HeliosAPacket *resp);
 extern void ohci_TL_HandleRequest(OHCI1394Unit *unit,
@@ -54,6 +64,10 @@ extern LONG ohci_TL_SendRequest(OHCI1394Unit *unit,
                                 HeliosOffset offset,
                                 QUADLET *payload,
                                 ULONG length);
+extern ULONG ohci_TL_SendRequests(OHCI1394Unit *unit,
+                                  UBYTE generation,
+                                  HeliosTransaction **ts,
+                                  ULONG count);
 extern LONG ohci_TL_DoRequest(OHCI1394Unit *unit,
                               UBYTE sigbit,
                               UWORD destid,
@@ -114,7 +114,10 @@ struct Library* LIB_Init(struct HeliosBase * base,
                 NEWLIST(&base->hb_Listeners.ell_SysList);
                 NEWLIST(&base->hb_Hardwares);
                 NEWLIST(&base->hb_Classes);
-                NEWLIST(&base->hb_ReportList);
+                romcache_Init();
+                romquirk_Init();
+                event_InitPool();
+                report_InitRing();
 
                 return &base->hb_Lib;
 
@@ -237,15 +240,6 @@ ULONG LIB_Close(void)
     }
     else
     {
-        HeliosReportMsg *msg;
-        APTR *next;
-
-        _INFO("Remove report msg...\n");
-        ForeachNodeSafe(&base->hb_ReportList, msg, next)
-        {
-            Helios_FreeReportMsg(msg);
-        }
-
         _INFO("Closing timer device...\n");
         CloseDevice((struct IORequest *) &base->hb_TimeReq);
 
@@ -46,6 +46,74 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "helios_internals.h"
 
+/* Configuration ROMs by GUID, most recently used first */
+struct HeliosROMCache
+{
+    LOCK_VARIABLE;
+    struct MinList          rc_Entries;
+    ULONG                   rc_Count;
+};
+
+/* Max ROM block read sizes by vendor/model */
+struct HeliosROMQuirks
+{
+    LOCK_VARIABLE;
+    struct MinList          rq_Entries;
+    ULONG                   rq_Count;
+};
+
+#define HELIOS_EVENTPOOL_SIZE 64
+
+typedef struct HeliosPooledEvent
+{
+    HeliosEventMsg          pe_Msg;
+    HeliosEventMsg *        pe_Listener;
+} HeliosPooledEvent;
+
+/* Preallocated messages for HELIOS_MSGTYPE_POOLED_EVENT listeners */
+struct HeliosEventPool
+{
+    LOCK_VARIABLE;
+    struct MinList          ep_Free;
+    ULONG                   ep_Sent;
+    ULONG                   ep_Coalesced;   /* Merged in a still queued message */
+    ULONG                   ep_Overflows;   /* Allocated as the pool was empty */
+    ULONG                   ep_Dropped;     /* Not sent, no memory */
+    HeliosPooledEvent       ep_Events[HELIOS_EVENTPOOL_SIZE];
+};
+
+#define HELIOS_REPORT_RING_SIZE 128     /* Power of 2 */
+#define HELIOS_REPORT_MAX_ARGS  8       /* ULONG slots, a %ll arg takes 2 */
+#define HELIOS_REPORT_DATA_SIZE 160     /* Label + string args + format */
+#define HELIOS_REPORT_FORMATTED 0xffff  /* rr_Format value of a message formatted by the writer */
+
+/* Helios_ReportMsg() call, formatted by the reader.
+ * The format is copied in rr_Data: the caller's string may be gone when read.
+ * If rr_Format is HELIOS_REPORT_FORMATTED the message was formatted by
+ * the writer and follows the label in rr_Data.
+ */
+typedef struct HeliosReportRecord
+{
+    volatile ULONG          rr_Seq;         /* Ticket + 1 once written */
+    ULONG                   rr_TypeBit;
+    struct timeval          rr_Time;
+    UWORD                   rr_Format;      /* Format offset in rr_Data */
+    ULONG                   rr_StrArgs;     /* Bit n set: rr_Args[n] is an offset in rr_Data */
+    ULONG                   rr_Args[HELIOS_REPORT_MAX_ARGS];
+    UBYTE                   rr_Data[HELIOS_REPORT_DATA_SIZE];
+} HeliosReportRecord;
+
+/* Lock free for writers, readers are serialized by the lock */
+struct HeliosReportRing
+{
+    LOCK_VARIABLE;
+    volatile ULONG          rr_Head;        /* Next ticket to write */
+    volatile ULONG          rr_Tail;        /* Next ticket to read */
+    ULONG                   rr_Dropped;     /* Ring full or reader out of memory */
+    ULONG                   rr_Truncated;   /* Label or string args cut */
+    HeliosReportRecord      rr_Records[HELIOS_REPORT_RING_SIZE];
+};
+
 struct HeliosBase
 {
     struct Library          hb_Lib;
@@ -57,7 +125,10 @@ struct HeliosBase
     HeliosEventListenerList hb_Listeners;
     struct MinList          hb_Hardwares;
     struct MinList          hb_Classes;
-    struct MinList          hb_ReportList;
+    struct HeliosROMCache   hb_ROMCache;
+    struct HeliosROMQuirks  hb_ROMQuirks;
+    struct HeliosEventPool  hb_EventPool;
+    struct HeliosReportRing hb_ReportRing;
 };
 
 extern struct HeliosBase *HeliosBase;
@@ -103,6 +103,11 @@ ULONG LibFuncTable[]=
     (ULONG) &Helios_DoIO,
     (ULONG) &Helios_ComputeCRC16,
     (ULONG) &Helios_ReadTextualDescriptor,
+    (ULONG) &Helios_LoadROMCache,
+    (ULONG) &Helios_SaveROMCache,
+    (ULONG) &Helios_LoadROMQuirks,
+    (ULONG) &Helios_SaveROMQuirks,
+    (ULONG) &Helios_FreeEvent,
     -1,
 
     FUNCARRAY_END
@@ -37,6 +37,8 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #include <proto/alib.h>
 #include <proto/timer.h>
 
+#include <clib/macros.h>
+
 #include <string.h>
 #include <stdarg.h>
 
@@ -101,6 +103,265 @@ static void helios_SubTaskEntry(HeliosSubTask *ctx)
     _INFO("- SubTask %p-'%s' says bye\n", task, task->tc_Node.ln_Name);
 }
 
+/* Events where only the last result matters when coalesced */
+#define EVENT_COALESCE_LAST (HEVTF_HARDWARE_BUSRESET|HEVTF_HARDWARE_TOPOLOGY|HEVTF_NEW_REPORTMSG)
+
+static BOOL event_IsPooled(HeliosEventMsg *msg)
+{
+    struct HeliosEventPool *pool = &HeliosBase->hb_EventPool;
+
+    return ((APTR)msg >= (APTR)&pool->ep_Events[0]) &&
+        ((APTR)msg < (APTR)&pool->ep_Events[HELIOS_EVENTPOOL_SIZE]);
+}
+
+/* NULL if the pool is empty */
+static HeliosPooledEvent *event_Get(void)
+{
+    struct HeliosEventPool *pool = &HeliosBase->hb_EventPool;
+    HeliosPooledEvent *pe;
+
+    LOCK_REGION(pool);
+    pe = (APTR)REMHEAD(&pool->ep_Free);
+    UNLOCK_REGION(pool);
+
+    return pe;
+}
+
+static void event_Put(HeliosPooledEvent *pe)
+{
+    struct HeliosEventPool *pool = &HeliosBase->hb_EventPool;
+
+    LOCK_REGION(pool);
+    ADDHEAD(&pool->ep_Free, pe);
+    UNLOCK_REGION(pool);
+}
+
+/* Merge the event in a message for the listener still queued on its port.
+ * Call in Forbid(), so the listener task can't get the message meanwhile.
+ */
+static BOOL event_Coalesce(HeliosEventMsg *node, ULONG event, ULONG result, const struct timeval *tv)
+{
+    struct Node *ln;
+
+    ForeachNode(&node->hm_Msg.mn_ReplyPort->mp_MsgList, ln)
+    {
+        HeliosPooledEvent *pe = (APTR)ln;
+
+        if (event_IsPooled(&pe->pe_Msg) &&
+            (pe->pe_Listener == node) &&
+            (pe->pe_Msg.hm_EventMask == event) &&
+            ((pe->pe_Msg.hm_Result == result) || (event & EVENT_COALESCE_LAST)))
+        {
+            pe->pe_Msg.hm_Result = result;
+            pe->pe_Msg.hm_Time = *tv;
+            pe->pe_Msg.hm_Count++;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void event_InitPool(void)
+{
+    struct HeliosEventPool *pool = &HeliosBase->hb_EventPool;
+    ULONG i;
+
+    LOCK_INIT(pool);
+    NEWLIST(&pool->ep_Free);
+
+    for (i=0; i < HELIOS_EVENTPOOL_SIZE; i++)
+    {
+        ADDTAIL(&pool->ep_Free, &pool->ep_Events[i]);
+    }
+}
+
+/* p is on a '%'. Returns the conversion end, type is its char (0 if bad),
+ * longs the count of 'l' flags.
+ */
+static CONST_STRPTR report_ParseSpec(CONST_STRPTR p, UBYTE *type, ULONG *longs)
+{
+    p++;
+    while (('-' == *p) || ('.' == *p) || (('0' <= *p) && ('9' >= *p)))
+    {
+        p++;
+    }
+
+    for (*longs=0; 'l' == *p; p++)
+    {
+        (*longs)++;
+    }
+
+    *type = *p;
+    if ('\0' != *p)
+    {
+        p++;
+    }
+
+    return p;
+}
+
+/* Copy s at rr_Data[offset], returns the next offset */
+static ULONG report_CopyStr(HeliosReportRecord *rec, ULONG offset, CONST_STRPTR s)
+{
+    ULONG len = strlen(s);
+
+    offset = MIN(offset, HELIOS_REPORT_DATA_SIZE - 1);
+    if (len >= (HELIOS_REPORT_DATA_SIZE - offset))
+    {
+        len = HELIOS_REPORT_DATA_SIZE - offset - 1;
+        ATOMIC_ADD((LONG *)&HeliosBase->hb_ReportRing.rr_Truncated, 1);
+    }
+
+    CopyMem((APTR)s, &rec->rr_Data[offset], len);
+    rec->rr_Data[offset + len] = '\0';
+
+    return offset + len + 1;
+}
+
+/* Store fmt and its arguments in rec from rr_Data[offset],
+ * FALSE if not possible (unsupported, too many or no room left).
+ */
+static BOOL report_Encode(HeliosReportRecord *rec, ULONG offset, CONST_STRPTR fmt, va_list args)
+{
+    CONST_STRPTR p = fmt;
+    ULONG n=0, longs, len;
+    UBYTE type;
+
+    rec->rr_StrArgs = 0;
+
+    while ('\0' != *p)
+    {
+        if ('%' != *p)
+        {
+            p++;
+            continue;
+        }
+
+        p = report_ParseSpec(p, &type, &longs);
+        switch (type)
+        {
+            case '%':
+                break;
+
+            case 's':
+                if (n >= HELIOS_REPORT_MAX_ARGS)
+                {
+                    return FALSE;
+                }
+                else
+                {
+                    CONST_STRPTR s = va_arg(args, CONST_STRPTR);
+
+                    rec->rr_StrArgs |= 1ul << n;
+                    rec->rr_Args[n++] = MIN(offset, HELIOS_REPORT_DATA_SIZE - 1);
+                    offset = report_CopyStr(rec, offset, (NULL != s) ? s : (CONST_STRPTR)"(null)");
+                }
+                break;
+
+            case 'c': case 'd': case 'i': case 'u':
+            case 'x': case 'X': case 'p':
+                if (longs > 1)
+                {
+                    UQUAD q = va_arg(args, UQUAD);
+
+                    if ((n + 2) > HELIOS_REPORT_MAX_ARGS)
+                    {
+                        return FALSE;
+                    }
+
+                    rec->rr_Args[n++] = q >> 32;
+                    rec->rr_Args[n++] = q;
+                }
+                else
+                {
+                    if (n >= HELIOS_REPORT_MAX_ARGS)
+                    {
+                        return FALSE;
+                    }
+
+                    rec->rr_Args[n++] = va_arg(args, ULONG);
+                }
+                break;
+
+            default:
+                return FALSE;
+        }
+    }
+
+    /* A cut format would not match the arguments */
+    len = strlen(fmt);
+    if ((offset + len) >= HELIOS_REPORT_DATA_SIZE)
+    {
+        return FALSE;
+    }
+
+    CopyMem((APTR)fmt, &rec->rr_Data[offset], len + 1);
+    rec->rr_Format = offset;
+
+    return TRUE;
+}
+
+/* Format a record message in buf */
+static void report_Format(const HeliosReportRecord *rec, ULONG label_len, STRPTR buf, ULONG size)
+{
+    CONST_STRPTR p;
+    ULONG len=0, n=0, longs;
+    UBYTE spec[16], type;
+
+    if (HELIOS_REPORT_FORMATTED == rec->rr_Format)
+    {
+        utils_SafeSPrintF(buf, size, "%s", &rec->rr_Data[label_len + 1]);
+        buf[size - 1] = '\0';
+        return;
+    }
+
+    p = (CONST_STRPTR)&rec->rr_Data[rec->rr_Format];
+    while (('\0' != *p) && (len < (size - 1)))
+    {
+        CONST_STRPTR start = p;
+
+        if ('%' != *p)
+        {
+            buf[len++] = *p++;
+            continue;
+        }
+
+        p = report_ParseSpec(p, &type, &longs);
+        CopyMem((APTR)start, spec, MIN((ULONG)(p - start), sizeof(spec) - 1));
+        spec[MIN((ULONG)(p - start), sizeof(spec) - 1)] = '\0';
+
+        if ('%' == type)
+        {
+            buf[len++] = '%';
+        }
+        else if (rec->rr_StrArgs & (1ul << n))
+        {
+            utils_SafeSPrintF(&buf[len], size - len, spec, &rec->rr_Data[rec->rr_Args[n++]]);
+        }
+        else if (longs > 1)
+        {
+            utils_SafeSPrintF(&buf[len], size - len, spec,
+                              ((UQUAD)rec->rr_Args[n] << 32) + rec->rr_Args[n + 1]);
+            n += 2;
+        }
+        else
+        {
+            utils_SafeSPrintF(&buf[len], size - len, spec, rec->rr_Args[n++]);
+        }
+
+        buf[size - 1] = '\0';
+        len += strlen(&buf[len]);
+    }
+
+    buf[len] = '\0';
+}
+
+void report_InitRing(void)
+{
+    LOCK_INIT(&HeliosBase->hb_ReportRing);
+}
+
 
 /*----------------------------------------------------------------------------*/
 /*--- LIBRARY CODE SECTION ---------------------------------------------------*/
@@ -526,7 +787,10 @@ void Helios_RemoveEventListener(HeliosEventListenerList *list, HeliosEventMsg *n
 /* WARNING: this function assumes that the list is protected against modifications */
 void Helios_SendEvent(HeliosEventListenerList *list, ULONG event, ULONG result)
 {
+    struct HeliosEventPool *pool = &HeliosBase->hb_EventPool;
     HeliosEventMsg *msg, *node, *next;
+    HeliosPooledEvent *pe;
+    ULONG sent=0, coalesced=0, overflows=0, dropped=0;
     struct timeval tv;
     struct Library *TimerBase;
 
@@ -548,6 +812,21 @@ void Helios_SendEvent(HeliosEventListenerList *list, ULONG event, ULONG result)
                 node->hm_Time = tv;
                 node->hm_Result = result;
                 ReplyMsg(&node->hm_Msg);
+                sent++;
+                continue;
+            }
+
+            /* Pooled listeners don't allocate, except on empty pool */
+            pe = NULL;
+            if (HELIOS_MSGTYPE_POOLED_EVENT == node->hm_Type)
+            {
+                pe = event_Get();
+            }
+
+            if (NULL != pe)
+            {
+                pe->pe_Listener = node;
+                msg = &pe->pe_Msg;
             }
             else
             {
@@ -555,69 +834,146 @@ void Helios_SendEvent(HeliosEventListenerList *list, ULONG event, ULONG result)
                 if (NULL == msg)
                 {
                     _ERR("Msg alloc failed\n");
+                    dropped++;
                     continue;
                 }
 
-                msg->hm_Msg.mn_ReplyPort = NULL;
-                msg->hm_Msg.mn_Length = sizeof(*msg);
-                msg->hm_Msg.mn_Node.ln_Type = NT_FREEMSG;
-                msg->hm_Type = HELIOS_MSGTYPE_EVENT;
-                msg->hm_Time = tv;
-                msg->hm_EventMask = event;
-                msg->hm_Result = result;
-                msg->hm_UserData = node->hm_UserData;
+                if (HELIOS_MSGTYPE_POOLED_EVENT == node->hm_Type)
+                {
+                    overflows++;
+                }
+            }
+
+            msg->hm_Msg.mn_ReplyPort = NULL;
+            msg->hm_Msg.mn_Length = sizeof(*msg);
+            msg->hm_Msg.mn_Node.ln_Type = NT_FREEMSG;
+            msg->hm_Type = HELIOS_MSGTYPE_EVENT;
+            msg->hm_Time = tv;
+            msg->hm_EventMask = event;
+            msg->hm_Result = result;
+            msg->hm_UserData = node->hm_UserData;
+            msg->hm_Count = 1;
+
+            if (HELIOS_MSGTYPE_POOLED_EVENT == node->hm_Type)
+            {
+                Forbid();
+                if (event_Coalesce(node, event, result, &tv))
+                {
+                    Permit();
+
+                    if (NULL != pe)
+                    {
+                        event_Put(pe);
+                    }
+                    else
+                    {
+                        FreeMem(msg, sizeof(*msg));
+                    }
+
+                    coalesced++;
+                    continue;
+                }
 
                 PutMsg(node->hm_Msg.mn_ReplyPort, &msg->hm_Msg);
+                Permit();
             }
+            else
+            {
+                PutMsg(node->hm_Msg.mn_ReplyPort, &msg->hm_Msg);
+            }
+
+            sent++;
         }
     }
     UNLOCK_REGION(list);
+
+    LOCK_REGION(pool);
+    {
+        pool->ep_Sent += sent;
+        pool->ep_Coalesced += coalesced;
+        pool->ep_Overflows += overflows;
+        pool->ep_Dropped += dropped;
+    }
+    UNLOCK_REGION(pool);
 }
 
+/* Free an event message received by a listener of type
+ * HELIOS_MSGTYPE_EVENT or HELIOS_MSGTYPE_POOLED_EVENT.
+ */
+void Helios_FreeEvent(HeliosEventMsg *msg)
+{
+    if (event_IsPooled(msg))
+    {
+        event_Put((APTR)msg);
+    }
+    else
+    {
+        FreeMem(msg, msg->hm_Msg.mn_Length);
+    }
+}
+
+/* Lock and allocation free: the call is stored in a ring record, formatted
+ * when read by Helios_GetNextReportMsg(). fmt and %s args are copied.
+ * HEVTF_NEW_REPORTMSG is sent when the ring becomes non-empty: listeners
+ * shall read it until empty after registering.
+ * Returns -1 if the ring is full.
+ */
 LONG Helios_VReportMsg(ULONG type, CONST_STRPTR label, CONST_STRPTR fmt, va_list args)
 {
-    ULONG len=0, label_len, msg_size;
-    HeliosReportMsg *msg;
+    struct HeliosReportRing *ring = &HeliosBase->hb_ReportRing;
+    HeliosReportRecord *rec;
+    ULONG ticket, offset;
+    struct Library *TimerBase;
     struct safe_buf sb;
     va_list args_dup;
 
-    va_copy(args_dup, args);
+    /* Reserve a record */
+    do
+    {
+        ticket = ring->rr_Head;
+        if ((ticket - ring->rr_Tail) >= HELIOS_REPORT_RING_SIZE)
+        {
+            ATOMIC_ADD((LONG *)&ring->rr_Dropped, 1);
+            return -1;
+        }
+    }
+    while (ATOMIC_CMPXCHG((ULONG *)&ring->rr_Head, ticket, ticket + 1) != ticket);
 
-    /* len = label + formated fmt string */
-    VNewRawDoFmt(fmt, (APTR)RAWFMTFUNC_COUNT, (APTR)&len, args);
-    label_len = strlen(label);
+    rec = &ring->rr_Records[ticket % HELIOS_REPORT_RING_SIZE];
 
-    /* +2 for strings walls */
-    msg_size = sizeof(HeliosReportMsg)+label_len+1+len+1;
-    msg = AllocVecPooled(HeliosBase->hb_MemPool, msg_size);
-    if (NULL != msg)
-    {
-        msg->hrm_SysMsg.mn_Length = msg_size;
-        msg->hrm_TypeBit = type;
-        msg->hrm_Label = (APTR)msg + sizeof(HeliosReportMsg);
-        msg->hrm_Msg = (APTR)msg->hrm_Label + label_len + 1;
+    TimerBase = (struct Library *)HeliosBase->hb_TimeReq.tr_node.io_Device;
+    GetSysTime(&rec->rr_Time);
+    rec->rr_TypeBit = type;
 
-        CopyMem((STRPTR)label, (STRPTR)msg->hrm_Label, label_len);
-        ((STRPTR)msg->hrm_Label)[label_len] = '\0';
+    offset = report_CopyStr(rec, 0, label);
 
-        sb.buf = (STRPTR)msg->hrm_Msg;
-        sb.size = len;
+    va_copy(args_dup, args);
+    if (!report_Encode(rec, offset, fmt, args))
+    {
+        /* Formatted now */
+        offset = MIN(offset, HELIOS_REPORT_DATA_SIZE - 1);
+        sb.buf = (STRPTR)&rec->rr_Data[offset];
+        sb.size = HELIOS_REPORT_DATA_SIZE - offset;
         VNewRawDoFmt(fmt, utils_SafePutChProc, (STRPTR)&sb, args_dup);
-        len -= sb.size;
-        ((STRPTR)msg->hrm_Msg)[len] = '\0';
+        rec->rr_Data[HELIOS_REPORT_DATA_SIZE - 1] = '\0';
+        rec->rr_Format = HELIOS_REPORT_FORMATTED;
+    }
+    va_end(args_dup);
 
-        LOCK_REGION(HeliosBase);
-        {
-            //kprintf("RptMsg: [%s] %s\n", msg->hrm_Label, msg->hrm_Msg);
-            ADDHEAD(&HeliosBase->hb_ReportList, msg);
-        }
-        UNLOCK_REGION(HeliosBase);
+    /* Publish */
+    MEMORY_BARRIER();
+    rec->rr_Seq = ticket + 1;
 
+    /* The reader stops on an unpublished record: the writer of the oldest
+     * one notifies, whatever the publication order.
+     */
+    MEMORY_BARRIER();
+    if (ring->rr_Tail == ticket)
+    {
         Helios_SendEvent(&HeliosBase->hb_Listeners, HEVTF_NEW_REPORTMSG, 0);
-        return len;
     }
 
-    return -1;
+    return 0;
 }
 
 LONG Helios_ReportMsg(ULONG type, CONST_STRPTR label, CONST_STRPTR fmt, ...)
@@ -632,13 +988,60 @@ LONG Helios_ReportMsg(ULONG type, CONST_STRPTR label, CONST_STRPTR fmt, ...)
     return res;
 }
 
+/* Oldest ring record formatted as a message, to free by Helios_FreeReportMsg() */
 HeliosReportMsg *Helios_GetNextReportMsg(void)
 {
+    struct HeliosReportRing *ring = &HeliosBase->hb_ReportRing;
+    HeliosReportRecord *slot, rec;
     HeliosReportMsg *msg;
+    ULONG tail, label_len, len, msg_size;
+    BOOL found=FALSE;
+    UBYTE buf[256];
+
+    LOCK_REGION(ring);
+    {
+        tail = ring->rr_Tail;
+        slot = &ring->rr_Records[tail % HELIOS_REPORT_RING_SIZE];
+
+        /* Not written yet if the writer is still on it */
+        if (slot->rr_Seq == (tail + 1))
+        {
+            /* No record read before its sequence */
+            MEMORY_BARRIER();
+            CopyMemQuick(slot, &rec, sizeof(rec));
+            MEMORY_BARRIER();
+            ring->rr_Tail = tail + 1;
+            found = TRUE;
+        }
+    }
+    UNLOCK_REGION(ring);
+
+    if (!found)
+    {
+        return NULL;
+    }
+
+    label_len = strlen((STRPTR)rec.rr_Data);
+    report_Format(&rec, label_len, (STRPTR)buf, sizeof(buf));
+    len = strlen((STRPTR)buf);
+
+    /* +2 for strings walls */
+    msg_size = sizeof(HeliosReportMsg)+label_len+1+len+1;
+    msg = AllocVecPooled(HeliosBase->hb_MemPool, msg_size);
+    if (NULL == msg)
+    {
+        ATOMIC_ADD((LONG *)&ring->rr_Dropped, 1);
+        return NULL;
+    }
+
+    msg->hrm_SysMsg.mn_Length = msg_size;
+    msg->hrm_TypeBit = rec.rr_TypeBit;
+    msg->hrm_Time = rec.rr_Time;
+    msg->hrm_Label = (APTR)msg + sizeof(HeliosReportMsg);
+    msg->hrm_Msg = (APTR)msg->hrm_Label + label_len + 1;
 
-    Helios_WriteLockBase();
-    msg = (HeliosReportMsg *)REMTAIL(&HeliosBase->hb_ReportList);
-    Helios_UnlockBase();
+    CopyMem(rec.rr_Data, (STRPTR)msg->hrm_Label, label_len + 1);
+    CopyMem(buf, (STRPTR)msg->hrm_Msg, len + 1);
 
     return msg;
 }
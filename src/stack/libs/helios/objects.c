@@ -58,13 +58,61 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 #define PHY_CONFIG_ROOT_ID(node_id) ((((node_id) & 0x3f) << 24) | (1 << 23))
 #define PHY_IDENTIFIER(id) ((id) << 30)
 
+#define SCAN_DELAY          1000    /* ms before a ROM scan, from the IEEE1394 norm */
+#define SCAN_CACHED_DELAY   100     /* ms before trying the ROM cache */
+#define SCAN_WORKERS        4       /* Max concurrent ROM scans per hardware */
+#define SCAN_SBP2_SPEC_ID   0x00609e
+
+/* ROM scan priorities, highest first */
+#define SCAN_PRI_NEW        0       /* Device never scanned */
+#define SCAN_PRI_KNOWN      1       /* ROM known from a previous generation */
+#define SCAN_PRI_BOUND      2       /* A unit is bound to a class */
+#define SCAN_PRI_STORAGE    3       /* A SBP2 unit is bound (disks before cameras) */
+
+#define SCAN_PHASE_CACHE    0       /* Check the ROM cache */
+#define SCAN_PHASE_READ     1       /* Read the full ROM */
+
 #define PHY_PACKET_CONFIG   0x0
 #define PHY_PACKET_LINK_ON  0x1
 #define PHY_PACKET_SELF_ID  0x2
 
+/* A pending ROM scan, owns a device reference */
+typedef struct HeliosScanRequest
+{
+    struct MinNode sr_Node;
+    HeliosDevice * sr_Device;
+    ULONG          sr_Generation;
+    ULONG          sr_Start;        /* Request time in ms */
+    ULONG          sr_Due;          /* Not processed before this time in ms */
+    ULONG          sr_Requests;     /* Bus requests done */
+    UBYTE          sr_Priority;
+    UBYTE          sr_Phase;
+} HeliosScanRequest;
+
+/* Per hardware ROM scan scheduler.
+ * Queued requests are processed by at most SCAN_WORKERS tasks,
+ * the highest priority due request first.
+ * Workers only do bus requests: waiting for the norm delay is done in
+ * the queue, so ROM reads of several devices are in flight together.
+ */
+typedef struct HeliosScanner
+{
+    LOCK_VARIABLE;
+    struct MinList hs_Queue;
+    ULONG          hs_Workers;
+    struct Task *  hs_Closer;      /* Set when the hardware is going away */
+    ULONG          hs_CloseSignal; /* Sent to hs_Closer by the last worker */
+} HeliosScanner;
+
 static const ULONG gHeliosPTBase[] =
 {
     PACK_STARTTABLE(HA_Dummy),
+    PACK_ENTRY(HA_Dummy, HA_EventsSent, struct HeliosBase, hb_EventPool.ep_Sent, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
+    PACK_ENTRY(HA_Dummy, HA_EventsCoalesced, struct HeliosBase, hb_EventPool.ep_Coalesced, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
+    PACK_ENTRY(HA_Dummy, HA_EventsOverflows, struct HeliosBase, hb_EventPool.ep_Overflows, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
+    PACK_ENTRY(HA_Dummy, HA_EventsDropped, struct HeliosBase, hb_EventPool.ep_Dropped, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
+    PACK_ENTRY(HA_Dummy, HA_ReportsDropped, struct HeliosBase, hb_ReportRing.rr_Dropped, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
+    PACK_ENTRY(HA_Dummy, HA_ReportsTruncated, struct HeliosBase, hb_ReportRing.rr_Truncated, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
     PACK_ENDTABLE
 };
 
@@ -83,6 +131,8 @@ static const ULONG gHeliosPTDevice[] =
     PACK_ENTRY(HA_Dummy, HA_GUID_Hi, HeliosDevice, hd_GUID.w.hi, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
     PACK_ENTRY(HA_Dummy, HA_GUID_Lo, HeliosDevice, hd_GUID.w.lo, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
     PACK_ENTRY(HA_Dummy, HA_Generation, HeliosDevice, hd_Generation, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
+    PACK_ENTRY(HA_Dummy, HA_RomScanTime, HeliosDevice, hd_RomScanTime, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
+    PACK_ENTRY(HA_Dummy, HA_RomScanRequests, HeliosDevice, hd_RomScanRequests, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
     //PACK_ENTRY(HA_Dummy, HA_Hardware, HeliosDevice, hd_Hardware, PKCTRL_ULONG|PKCTRL_UNPACKONLY),
     PACK_ENDTABLE
 };
@@ -429,6 +479,71 @@ set_config:
     }
 }
 
+/* Stop the scanner before freeing it.
+ * Pending requests are dropped with their device reference, then running
+ * workers are waited: they end on the empty queue, requeues being refused.
+ */
+static void helios_scan_stop(HeliosScanner *scanner)
+{
+    struct MinList drop;
+    HeliosScanRequest *req, *next;
+    BYTE sigbit;
+    ULONG workers;
+
+    NEWLIST(&drop);
+
+    sigbit = AllocSignal(-1);
+    if (-1 == sigbit)
+    {
+        /* Fallback to polling */
+        _ERR("No signal to wait scan workers, polling\n");
+    }
+
+    LOCK_REGION(scanner);
+    {
+        scanner->hs_Closer = FindTask(NULL);
+        scanner->hs_CloseSignal = (-1 != sigbit) ? (1ul << sigbit) : 0;
+
+        ForeachNodeSafe(&scanner->hs_Queue, req, next)
+        {
+            REMOVE(req);
+            ADDTAIL(&drop, req);
+        }
+
+        workers = scanner->hs_Workers;
+    }
+    UNLOCK_REGION(scanner);
+
+    ForeachNodeSafe(&drop, req, next)
+    {
+        Helios_ReleaseDevice(req->sr_Device);
+        FreePooled(HeliosBase->hb_MemPool, req, sizeof(*req));
+    }
+
+    while (workers > 0)
+    {
+        _INFO("Waiting %lu scan worker(s)\n", workers);
+
+        if (-1 != sigbit)
+        {
+            Wait(1ul << sigbit);
+        }
+        else
+        {
+            Helios_DelayMS(SCAN_CACHED_DELAY);
+        }
+
+        LOCK_REGION(scanner);
+        workers = scanner->hs_Workers;
+        UNLOCK_REGION(scanner);
+    }
+
+    if (-1 != sigbit)
+    {
+        FreeSignal(sigbit);
+    }
+}
+
 static void helios_hardware_task(HeliosSubTask *self, struct TagItem *tags)
 {
     struct MsgPort *taskport, *hwport, *evtport;
@@ -475,6 +590,20 @@ static void helios_hardware_task(HeliosSubTask *self, struct TagItem *tags)
     }
 
     hw = (APTR)iobase->iohh_Req.io_Unit;
+
+    hw->hu_Scanner = AllocPooled(HeliosBase->hb_MemPool, sizeof(HeliosScanner));
+    if (NULL == hw->hu_Scanner)
+    {
+        _ERR("<%s,%ld>: scanner alloc failed\n", name, unit);
+        CloseDevice((struct IORequest *)iobase);
+        goto error;
+    }
+
+    LOCK_INIT(hw->hu_Scanner);
+    NEWLIST(&hw->hu_Scanner->hs_Queue);
+    hw->hu_Scanner->hs_Workers = 0;
+    hw->hu_Scanner->hs_Closer = NULL;
+
     hw->hu_HWTask = self;
     HW_INCREF(hw);
 
@@ -490,7 +619,7 @@ static void helios_hardware_task(HeliosSubTask *self, struct TagItem *tags)
     bzero(&myListener, sizeof(myListener));
     myListener.hm_Msg.mn_ReplyPort = evtport;
     myListener.hm_Msg.mn_Length = sizeof(myListener);
-    myListener.hm_Type = HELIOS_MSGTYPE_EVENT;
+    myListener.hm_Type = HELIOS_MSGTYPE_POOLED_EVENT;
     myListener.hm_EventMask = HEVTF_HARDWARE_TOPOLOGY;
     Helios_AddEventListener(&hw->hu_Listeners, &myListener);
 
@@ -540,7 +669,7 @@ static void helios_hardware_task(HeliosSubTask *self, struct TagItem *tags)
                 {
                     if (NULL != evt)
                     {
-                        FreeMem(evt, evt->hm_Msg.mn_Length);
+                        Helios_FreeEvent(evt);
                     }
 
                     evt = next;
@@ -557,7 +686,7 @@ static void helios_hardware_task(HeliosSubTask *self, struct TagItem *tags)
 
                 helios_process_bm(hw, &evt->hm_Time, evt->hm_Result, is_bm, bm_gen, &bm_retry);
 
-                FreeMem(evt, evt->hm_Msg.mn_Length);
+                Helios_FreeEvent(evt);
             }
         }
     }
@@ -569,7 +698,7 @@ static void helios_hardware_task(HeliosSubTask *self, struct TagItem *tags)
 
         while (NULL != (msg = GetMsg(evtport)))
         {
-            FreeMem(msg, msg->mn_Length);
+            Helios_FreeEvent((HeliosEventMsg *)msg);
         }
     }
 
@@ -579,7 +708,9 @@ static void helios_hardware_task(HeliosSubTask *self, struct TagItem *tags)
 
     HW_DECREF(hw);
 
-    /* TODO: RefCnt protection here */
+    helios_scan_stop(hw->hu_Scanner);
+    FreePooled(HeliosBase->hb_MemPool, hw->hu_Scanner, sizeof(HeliosScanner));
+    hw->hu_Scanner = NULL;
 
     CloseDevice((struct IORequest *)iobase);
 
@@ -618,40 +749,101 @@ static void helios_read_dev_name(HeliosDevice *dev, const QUADLET *dir)
     }
 }
 
-static void helios_scanner_task(HeliosDevice *dev, STRPTR task_name, ULONG topogen)
+static BOOL helios_scan_valid(HeliosDevice *dev, ULONG topogen)
 {
-    QUADLET *rom;
-    UQUAD guid=0;
-    ULONG len=CSR_CONFIG_ROM_SIZE;
-    static const STRPTR default_task_name = "<helios rom scan (killed)>";
+    BOOL valid;
 
-    rom = AllocPooled(HeliosBase->hb_MemPool, CSR_CONFIG_ROM_SIZE);
-    if (NULL == rom)
+    LOCK_REGION_SHARED(dev);
+    valid = (dev->hd_Generation == topogen);
+    UNLOCK_REGION_SHARED(dev);
+
+    return valid;
+}
+
+static ULONG helios_scan_clock(void)
+{
+    struct Library *TimerBase;
+    struct timeval now;
+
+    TimerBase = (struct Library *)HeliosBase->hb_TimeReq.tr_node.io_Device;
+    GetSysTime(&now);
+
+    return now.tv_secs * 1000 + now.tv_micro / 1000;
+}
+
+/* HeliosBase and dev must be r-locked */
+static UBYTE helios_scan_priority(HeliosDevice *dev)
+{
+    HeliosUnit *unit;
+    UBYTE pri;
+
+    pri = (NULL != dev->hd_Rom) ? SCAN_PRI_KNOWN : SCAN_PRI_NEW;
+
+    /* Units kept from the previous generation tell what is waiting for this device */
+    ForeachNode(&dev->hd_Units, unit)
     {
-        _ERR("Rom alloc failed\n");
-        goto bye;
+        if (NULL != unit->hu_BindClass)
+        {
+            if (SCAN_SBP2_SPEC_ID == unit->hu_Ids.fields.UnitSpecID)
+            {
+                pri = SCAN_PRI_STORAGE;
+            }
+            else
+            {
+                pri = MAX(pri, SCAN_PRI_BOUND);
+            }
+        }
     }
 
-    /* IEEE1394 norm indicates a delay of 1s before scanning device's ROM */
-    Helios_DelayMS(1000);
+    return pri;
+}
 
-    LOCK_REGION_SHARED(dev);
+/* Scanner must be w-locked.
+ * Returns the highest priority due request, removed from the queue.
+ * If none, wait is set to the delay in ms to the next due one (0 if empty queue).
+ */
+static HeliosScanRequest *helios_scan_next(HeliosScanner *scanner, ULONG now, ULONG *wait)
+{
+    HeliosScanRequest *req, *best=NULL;
+
+    *wait = 0;
+
+    ForeachNode(&scanner->hs_Queue, req)
     {
-        if (dev->hd_Generation != topogen)
+        LONG delta = (LONG)(req->sr_Due - now);
+
+        if (delta > 0)
         {
-            topogen = 0;
+            if ((0 == *wait) || ((ULONG)delta < *wait))
+            {
+                *wait = delta;
+            }
+        }
+        else if ((NULL == best) ||
+                 (req->sr_Priority > best->sr_Priority) ||
+                 ((req->sr_Priority == best->sr_Priority) && ((LONG)(req->sr_Due - best->sr_Due) < 0)))
+        {
+            best = req;
         }
     }
-    UNLOCK_REGION_SHARED(dev);
 
-    if (!topogen)
+    if (NULL != best)
     {
-        goto bye;
+        REMOVE(best);
     }
 
-    _INFO("Scanning dev %p @ gen #%lu\n", dev, topogen);
+    return best;
+}
 
-    if (!Helios_ReadROM(dev, rom, &len) && (len >= 5))
+/* Set the scanned ROM to the device, if still at the topogen generation.
+ * rom is a CSR_CONFIG_ROM_SIZE bytes buffer, freed here.
+ */
+static void helios_scan_apply(HeliosDevice *dev, ULONG topogen, QUADLET *rom, ULONG len,
+                              BOOL read, BOOL cached, ULONG scan_time, ULONG requests)
+{
+    UQUAD guid=0;
+
+    if (read && (len >= 5))
     {
         QUADLET *tmp;
 
@@ -661,6 +853,7 @@ static void helios_scanner_task(HeliosDevice *dev, STRPTR task_name, ULONG topog
         if (NULL != tmp)
         {
             CopyMem(rom, tmp, len);
+            FreePooled(HeliosBase->hb_MemPool, rom, CSR_CONFIG_ROM_SIZE);
             rom = tmp;
         }
         else
@@ -677,6 +870,8 @@ static void helios_scanner_task(HeliosDevice *dev, STRPTR task_name, ULONG topog
     {
         LOCK_REGION(dev);
         {
+            dev->hd_RomScanner = NULL;
+
             /* Not changed of topology generation (or removed) ? */
             if (dev->hd_Generation == topogen)
             {
@@ -684,6 +879,13 @@ static void helios_scanner_task(HeliosDevice *dev, STRPTR task_name, ULONG topog
                                  dev->hd_NodeID, dev, dev->hd_Generation, guid);
 
                 dev->hd_GUID.q = guid;
+                dev->hd_RomScanTime = scan_time;
+                dev->hd_RomScanRequests = requests;
+
+                Helios_ReportMsg(HRMB_INFO, "Device", "Node #%u: ROM %s in %lu ms, %lu request(s)",
+                                 dev->hd_NodeID & 0x3f, cached ? "from cache" : "read",
+                                 scan_time, requests);
+
                 if (0 != guid)
                 {
                     ULONG i;
@@ -739,7 +941,6 @@ static void helios_scanner_task(HeliosDevice *dev, STRPTR task_name, ULONG topog
                         rom = NULL;
 
                         dev->hd_RomLength = len;
-                        dev->hd_RomScanner = NULL;
 
                         helios_get_ids((APTR)dev->hd_Rom + ROM_ROOT_DIRECTORY, dev->hd_Ids.array);
 
@@ -781,16 +982,162 @@ static void helios_scanner_task(HeliosDevice *dev, STRPTR task_name, ULONG topog
     }
     UNLOCK_REGION(HeliosBase);
 
-bye:
     if (NULL != rom)
     {
         FreePooled(HeliosBase->hb_MemPool, rom, len);
     }
+}
 
-    NewSetTaskAttrsA(NULL, (APTR)&default_task_name, sizeof(STRPTR), TASKINFOTYPE_NAME, NULL);
-    FreePooled(HeliosBase->hb_MemPool, task_name, 64);
+/* Queue again a request, FALSE if a newer one exists for the device
+ * or if the scanner is stopping.
+ */
+static BOOL helios_scan_requeue(HeliosScanner *scanner, HeliosScanRequest *req)
+{
+    HeliosScanRequest *node;
+    BOOL queued=TRUE;
 
-    Helios_ReleaseDevice(dev);
+    LOCK_REGION(scanner);
+    {
+        queued = (NULL == scanner->hs_Closer);
+
+        ForeachNode(&scanner->hs_Queue, node)
+        {
+            if (node->sr_Device == req->sr_Device)
+            {
+                queued = FALSE;
+                break;
+            }
+        }
+
+        if (queued)
+        {
+            ADDTAIL(&scanner->hs_Queue, req);
+        }
+    }
+    UNLOCK_REGION(scanner);
+
+    return queued;
+}
+
+/* Process one phase of a request, TRUE if the request is queued again */
+static BOOL helios_scan_run(HeliosScanner *scanner, HeliosScanRequest *req)
+{
+    HeliosDevice *dev = req->sr_Device;
+    QUADLET *rom;
+    ULONG len=CSR_CONFIG_ROM_SIZE, rom_requests=0;
+    BOOL read, cached=FALSE;
+
+    rom = AllocPooled(HeliosBase->hb_MemPool, CSR_CONFIG_ROM_SIZE);
+    if (NULL == rom)
+    {
+        _ERR("Rom alloc failed\n");
+        return FALSE;
+    }
+
+    LOCK_REGION(dev);
+    dev->hd_RomScanner = FindTask(NULL);
+    UNLOCK_REGION(dev);
+
+    if (SCAN_PHASE_CACHE == req->sr_Phase)
+    {
+        /* A known ROM is checked by a few quadlet reads before the norm delay,
+         * a device not ready yet just fails the check.
+         */
+        read = cached = romcache_Validate(dev, rom, &len, &req->sr_Requests);
+        if (!read)
+        {
+            FreePooled(HeliosBase->hb_MemPool, rom, CSR_CONFIG_ROM_SIZE);
+
+            /* IEEE1394 norm indicates a delay of 1s before scanning device's ROM.
+             * The worker is free for other devices meanwhile.
+             */
+            req->sr_Phase = SCAN_PHASE_READ;
+            req->sr_Due = req->sr_Start + SCAN_DELAY;
+
+            return helios_scan_requeue(scanner, req);
+        }
+    }
+    else
+    {
+        _INFO("Scanning dev %p @ gen #%lu\n", dev, req->sr_Generation);
+
+        read = !rom_ReadROM(dev, rom, &len, &rom_requests);
+        req->sr_Requests += rom_requests;
+        if (read)
+        {
+            romcache_Store(rom, len);
+        }
+    }
+
+    /* Bus reset to ROM ready, delays included */
+    helios_scan_apply(dev, req->sr_Generation, rom, len, read, cached,
+                      helios_scan_clock() - req->sr_Start, req->sr_Requests);
+
+    return FALSE;
+}
+
+/* Scan worker task: processes due requests until the queue is empty.
+ * The task owns a hw reference.
+ */
+static void helios_scan_worker(HeliosHardware *hw)
+{
+    HeliosScanner *scanner = hw->hu_Scanner;
+    HeliosScanRequest *req;
+    struct Task *closer;
+    ULONG wait, sig=0;
+
+    for (;;)
+    {
+        closer = NULL;
+
+        LOCK_REGION(scanner);
+        {
+            req = helios_scan_next(scanner, helios_scan_clock(), &wait);
+            if ((NULL == req) && (0 == wait))
+            {
+                /* The scanner may be freed as soon as the last worker is out,
+                 * so the closer is signaled after the unlock, with local copies.
+                 */
+                if ((0 == --scanner->hs_Workers) && (NULL != scanner->hs_Closer))
+                {
+                    closer = scanner->hs_Closer;
+                    sig = scanner->hs_CloseSignal;
+                }
+            }
+        }
+        UNLOCK_REGION(scanner);
+
+        if (NULL == req)
+        {
+            if (0 == wait)
+            {
+                if (NULL != closer)
+                {
+                    Signal(closer, sig);
+                }
+                break;
+            }
+
+            /* A new request may be due before */
+            Helios_DelayMS(MIN(wait, (ULONG)SCAN_CACHED_DELAY));
+            continue;
+        }
+
+        /* Generation changed or device removed since queued? */
+        if (!helios_scan_valid(req->sr_Device, req->sr_Generation))
+        {
+            _WARN("Abording ROM scan dev %p (topogen mismatch: %u)\n", req->sr_Device, req->sr_Generation);
+        }
+        else if (helios_scan_run(scanner, req))
+        {
+            continue;
+        }
+
+        Helios_ReleaseDevice(req->sr_Device);
+        FreePooled(HeliosBase->hb_MemPool, req, sizeof(*req));
+    }
+
+    Helios_ReleaseHardware(hw);
 }
 
 /* HeliosBase must be r-locked */
@@ -910,7 +1257,7 @@ LONG Helios_GetAttrsA(ULONG type, APTR obj, struct TagItem *tags)
                     *(HeliosEventListenerList **)ti->ti_Data = &base->hb_Listeners;
                     count++;
                 }
-                count += (LONG) UnpackStructureTags(obj, packtab, tags);
+                count += (LONG) UnpackStructureTags(base, packtab, tags);
             }
             UNLOCK_REGION_SHARED(base);
         }
@@ -938,10 +1285,12 @@ LONG Helios_GetAttrsA(ULONG type, APTR obj, struct TagItem *tags)
                             break;
 
                         case HHA_Topology:
+                        case HHA_TraceRing:
+                        case HHA_Statistics:
                         {
                             struct TagItem tags[] =
                             {
-                                {HHA_Topology, (ULONG)ti->ti_Data},
+                                {ti->ti_Tag, (ULONG)ti->ti_Data},
                                 {TAG_DONE, 0}
                             };
                             IOHeliosHWReq ioreq;
@@ -1430,61 +1779,146 @@ void Helios_UpdateDevice(HeliosDevice *dev, HeliosNode *node, ULONG topogen)
 /* WARNING: dev shall be incref'ed before calling */
 void Helios_ScanDevice(HeliosDevice *dev)
 {
-    ULONG gen;
+    HeliosHardware *hw = dev->hd_Hardware;
+    HeliosScanner *scanner = hw->hu_Scanner;
+    HeliosScanRequest *req, *node, *drop=NULL;
+    ULONG gen, now, count=0;
     UWORD nid;
+    UBYTE pri;
+    BOOL queued=FALSE, closing;
 
-    LOCK_REGION_SHARED(dev);
+    LOCK_REGION_SHARED(HeliosBase);
     {
-        gen = dev->hd_Generation;
-        nid = dev->hd_NodeID;
+        LOCK_REGION_SHARED(dev);
+        {
+            gen = dev->hd_Generation;
+            nid = dev->hd_NodeID;
+            pri = helios_scan_priority(dev);
+        }
+        UNLOCK_REGION_SHARED(dev);
     }
-    UNLOCK_REGION_SHARED(dev);
+    UNLOCK_REGION_SHARED(HeliosBase);
 
-    if (gen > 0)
+    if (0 == gen)
     {
-        STRPTR name = AllocPooled(HeliosBase->hb_MemPool, 64);
+        _WARN("already dead device, not scanned\n");
+        return;
+    }
+
+    req = (NULL != scanner) ? AllocPooled(HeliosBase->hb_MemPool, sizeof(*req)) : NULL;
+    if (NULL == req)
+    {
+        _ERR("Scan request failed for dev $%x-%p\n", nid, dev);
+        goto dead;
+    }
+
+    now = helios_scan_clock();
 
-        if (NULL != name)
+    LOCK_REGION(scanner);
+    {
+        /* No more requests once the hardware is going away */
+        closing = (NULL != scanner->hs_Closer);
+        if (!closing)
         {
-            utils_SafeSPrintF(name, 64, "heliosdevice-scanner <%u,$%x>", gen, nid);
+            /* A pending scan of the device restarts at the new generation */
+            ForeachNode(&scanner->hs_Queue, node)
+            {
+                if (node->sr_Device == dev)
+                {
+                    node->sr_Generation = gen;
+                    node->sr_Start = now;
+                    node->sr_Due = now + SCAN_CACHED_DELAY;
+                    node->sr_Requests = 0;
+                    node->sr_Priority = pri;
+                    node->sr_Phase = SCAN_PHASE_CACHE;
+                    queued = TRUE;
+                }
+                count++;
+            }
 
-            DEV_INCREF(dev);
-            dev->hd_RomScanner = NewCreateTask(TASKTAG_CODETYPE,    CODETYPE_PPC,
-                                               TASKTAG_NAME,        (ULONG)name,
-                                               TASKTAG_PRI,         0,
-                                               TASKTAG_STACKSIZE,   32768,
-                                               TASKTAG_PC,          (ULONG)helios_scanner_task,
-                                               TASKTAG_PPC_ARG1,    (ULONG)dev,
-                                               TASKTAG_PPC_ARG2,    (ULONG)name,
-                                               TASKTAG_PPC_ARG3,    gen,
-                                               TAG_DONE);
-            if (NULL == dev->hd_RomScanner)
+            if (!queued)
             {
-                _ERR("Scanner creation failed for dev $%x-%p\n", nid, dev);
+                DEV_INCREF(dev);
+                req->sr_Device = dev;
+                req->sr_Generation = gen;
+                req->sr_Start = now;
+                req->sr_Due = now + SCAN_CACHED_DELAY;
+                req->sr_Requests = 0;
+                req->sr_Priority = pri;
+                req->sr_Phase = SCAN_PHASE_CACHE;
+                ADDTAIL(&scanner->hs_Queue, req);
+                req = NULL;
+                count++;
+                queued = TRUE;
+            }
 
-                /* Not possible to obtain ROM, mark it as dead */
-                LOCK_REGION(HeliosBase);
+            /* One more worker if all are busy */
+            if ((scanner->hs_Workers < SCAN_WORKERS) && (scanner->hs_Workers < count))
+            {
+                HW_INCREF(hw);
+                if (NULL != NewCreateTask(TASKTAG_CODETYPE,    CODETYPE_PPC,
+                                          TASKTAG_NAME,        (ULONG)"heliosdevice-scanner",
+                                          TASKTAG_PRI,         0,
+                                          TASKTAG_STACKSIZE,   32768,
+                                          TASKTAG_PC,          (ULONG)helios_scan_worker,
+                                          TASKTAG_PPC_ARG1,    (ULONG)hw,
+                                          TAG_DONE))
                 {
-                    LOCK_REGION(dev);
-                    helios_dev_set_dead(dev);
-                    UNLOCK_REGION(dev);
+                    scanner->hs_Workers++;
                 }
-                UNLOCK_REGION(HeliosBase);
-
+                else
+                {
+                    _ERR("Scanner creation failed for dev $%x-%p\n", nid, dev);
+                    HW_DECREF(hw);
 
-                Helios_ReleaseDevice(dev);
-                FreePooled(HeliosBase->hb_MemPool, name, 64);
+                    /* Nobody to process the queue? */
+                    if (0 == scanner->hs_Workers)
+                    {
+                        ForeachNode(&scanner->hs_Queue, node)
+                        {
+                            if (node->sr_Device == dev)
+                            {
+                                REMOVE(node);
+                                drop = node;
+                                break;
+                            }
+                        }
+                        queued = FALSE;
+                    }
+                }
             }
         }
-        else
-        {
-            _ERR("Scanner name alloc failed\n");
-        }
     }
-    else
+    UNLOCK_REGION(scanner);
+
+    /* Not queued (pending request updated) */
+    if (NULL != req)
     {
-        _WARN("already dead device, not scanned\n");
+        FreePooled(HeliosBase->hb_MemPool, req, sizeof(*req));
+    }
+
+    if (closing)
+    {
+        goto dead;
     }
+
+    if (queued)
+    {
+        return;
+    }
+
+    FreePooled(HeliosBase->hb_MemPool, drop, sizeof(*drop));
+    Helios_ReleaseDevice(dev);
+
+dead:
+    /* Not possible to obtain ROM, mark it as dead */
+    LOCK_REGION(HeliosBase);
+    {
+        LOCK_REGION(dev);
+        helios_dev_set_dead(dev);
+        UNLOCK_REGION(dev);
+    }
+    UNLOCK_REGION(HeliosBase);
 }
 
 void Helios_ReadLockDevice(HeliosDevice *dev)
@@ -1776,6 +2210,7 @@ void Helios_DBG_DumpDevices(HeliosHardware *hw)
                 kprintf("\t\tRomScanner: $%p\n", (ULONG)dev->hd_RomScanner);
                 kprintf("\t\tRom:        $%p\n", (ULONG)dev->hd_Rom);
                 kprintf("\t\tRomLength:  %lu\n", dev->hd_RomLength);
+                kprintf("\t\tRomScan:    %lu ms, %lu request(s)\n", dev->hd_RomScanTime, dev->hd_RomScanRequests);
                 kprintf("\t\tGUID:       $%016llx\n", dev->hd_GUID.q);
                 kprintf("\t\tUnits:      $%p -> $%p\n", (ULONG)GetHead(&dev->hd_Units), (ULONG)GetTail(&dev->hd_Units));
                 ListLength(&dev->hd_Units, count);
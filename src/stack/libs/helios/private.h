@@ -74,4 +74,18 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 extern void _Helios_FreeDevice(HeliosDevice *dev);
 extern void _Helios_FreeUnit(HeliosUnit *unit);
 
+extern LONG rom_ReadQuadlets(HeliosDevice *dev, ULONG index, QUADLET *storage, ULONG count);
+extern LONG rom_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length, ULONG *requests);
+
+extern void romcache_Init(void);
+extern BOOL romcache_Validate(HeliosDevice *dev, QUADLET *rom, ULONG *length, ULONG *requests);
+extern void romcache_Store(const QUADLET *rom, ULONG length);
+
+extern void romquirk_Init(void);
+extern ULONG romquirk_MaxBlock(ULONG vendor, ULONG model, ULONG def);
+extern void romquirk_Learn(ULONG vendor, ULONG model, ULONG block);
+
+extern void event_InitPool(void);
+extern void report_InitRing(void);
+
 #endif /* HELIOS_PRIVATE_H */
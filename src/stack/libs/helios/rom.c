@@ -180,6 +180,162 @@ void rom_SetDefault(QUADLET *rom, UQUAD guid, QUADLET opts, QUADLET vendor_comp_
 }
 
 
+/* Read count quadlets from ROM[index], at S100.
+ * No wait for a ROM not ready: a zero ROM[0] gives HERR_TIMEOUT.
+ */
+LONG rom_ReadQuadlets(HeliosDevice *dev, ULONG index, QUADLET *storage, ULONG count)
+{
+    IOHeliosHWSendRequest ioreq;
+    struct MsgPort port;
+    HeliosAPacket *p;
+    ULONG i, loop, tgen;
+    LONG err;
+
+    LOCK_REGION_SHARED(dev);
+    tgen = dev->hd_Generation;
+    UNLOCK_REGION_SHARED(dev);
+
+    port.mp_Flags   = PA_SIGNAL;
+    port.mp_SigBit  = SIGB_SINGLE;
+    port.mp_SigTask = FindTask(NULL);
+    NEWLIST(&port.mp_MsgList);
+
+    ioreq.iohhe_Req.iohh_Req.io_Device = dev->hd_Hardware->hu_Device;
+    ioreq.iohhe_Req.iohh_Req.io_Unit = &dev->hd_Hardware->hu_Unit;
+    ioreq.iohhe_Req.iohh_Req.io_Message.mn_ReplyPort = &port;
+    ioreq.iohhe_Req.iohh_Req.io_Message.mn_Length = sizeof(IOHeliosHWSendRequest);
+    ioreq.iohhe_Req.iohh_Req.io_Command = HHIOCMD_SENDREQUEST;
+    ioreq.iohhe_Req.iohh_Data = NULL;
+    ioreq.iohhe_Req.iohh_Length = 0;
+    ioreq.iohhe_Device = dev;
+
+    p = &ioreq.iohhe_Transaction.htr_Packet;
+
+    for (i=0; i < count; i++)
+    {
+        Helios_FillReadQuadletPacket(p, S100, CSR_BASE_LO + CSR_CONFIG_ROM_OFFSET + (index + i) * sizeof(QUADLET));
+
+        loop = 10;
+        for (;;)
+        {
+            ioreq.iohhe_Req.iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
+            err = DoIO(&ioreq.iohhe_Req.iohh_Req);
+
+            if ((HHIOERR_NO_ERROR == err) && (HELIOS_RCODE_COMPLETE == p->RCode))
+            {
+                break;
+            }
+
+            if (HELIOS_RCODE_GENERATION == p->RCode)
+            {
+                return HERR_BUSRESET;
+            }
+
+            if ((HELIOS_RCODE_BUSY != p->RCode) || (0 == --loop))
+            {
+                _INFO_1394("$%04x: ROM[%u] read failed (IOErr=%ld, RCode=%ld)\n",
+                           dev->hd_NodeID, index + i, err, p->RCode);
+                return HERR_IO;
+            }
+
+            Helios_DelayMS(125);
+        }
+
+        if ((0 == (index + i)) && (0 == p->QuadletData))
+        {
+            return HERR_TIMEOUT;
+        }
+
+        storage[i] = p->QuadletData;
+    }
+
+    LOCK_REGION_SHARED(dev);
+    err = (tgen == dev->hd_Generation) ? HERR_NOERR : HERR_BUSRESET;
+    UNLOCK_REGION_SHARED(dev);
+
+    return err;
+}
+
+/* Read size bytes at offset with one block read.
+ * Returns HERR_BADCALL on address error (may be the ROM end), HERR_IO if the
+ * device fails the block read.
+ */
+static LONG rom_ReadBlock(IOHeliosHWSendRequest *ioreq,
+                          HeliosDevice *dev,
+                          HeliosOffset offset,
+                          QUADLET *storage,
+                          ULONG size,
+                          ULONG *requests)
+{
+    HeliosAPacket *p = &ioreq->iohhe_Transaction.htr_Packet;
+    ULONG loop = 10;
+    LONG err;
+
+    ioreq->iohhe_Req.iohh_Data = storage;
+    ioreq->iohhe_Req.iohh_Length = size;
+
+    for (;;)
+    {
+        Helios_FillReadBlockPacket(p, dev->hd_NodeInfo.n_MaxSpeed, offset, size);
+
+        _INFO_1394("$%04x: ReadB@$%llX, %lu bytes, S%u\n", dev->hd_NodeID, p->Offset, size, (1<<p->Speed)*100);
+        ioreq->iohhe_Req.iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
+        err = DoIO(&ioreq->iohhe_Req.iohh_Req);
+        (*requests)++;
+
+        if ((HHIOERR_NO_ERROR == err) && (HELIOS_RCODE_COMPLETE == p->RCode))
+        {
+            err = (ioreq->iohhe_Req.iohh_Actual == (LONG)size) ? HERR_NOERR : HERR_IO;
+            break;
+        }
+
+        if (HELIOS_RCODE_GENERATION == p->RCode)
+        {
+            err = HERR_BUSRESET;
+            break;
+        }
+
+        if (HELIOS_RCODE_ADDRESS_ERROR == p->RCode)
+        {
+            err = HERR_BADCALL;
+            break;
+        }
+
+        if ((HELIOS_RCODE_BUSY != p->RCode) || (0 == --loop))
+        {
+            _INFO_1394("$%04x: ReadB@$%llX failed (IOErr=%ld, RCode=%ld)\n", dev->hd_NodeID, p->Offset, err, p->RCode);
+            err = HERR_IO;
+            break;
+        }
+
+        Helios_DelayMS(125);
+    }
+
+    /* Quadlet reads have no payload buffer */
+    ioreq->iohhe_Req.iohh_Data = NULL;
+    ioreq->iohhe_Req.iohh_Length = 0;
+
+    return err;
+}
+
+/* Vendor/model immediates of a root directory, unchanged if missing */
+static void rom_RootIds(const QUADLET *dir, ULONG *vendor, ULONG *model)
+{
+    HeliosRomIterator ri;
+    QUADLET key, value;
+
+    Helios_InitRomIterator(&ri, dir);
+    while (Helios_RomIterate(&ri, &key, &value))
+    {
+        switch (key)
+        {
+            case CSR_KEY_MODULE_VENDOR_ID: *vendor = value; break;
+            case CSR_KEY_MODEL_ID:         *model = value; break;
+        }
+    }
+}
+
+
 /*============================================================================*/
 /*--- LIBRARY CODE SECTION ---------------------------------------------------*/
 
@@ -232,16 +388,21 @@ void Helios_FreeROM(APTR pool, QUADLET *rom)
     }
 }
 
-LONG Helios_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length)
+/* Helios_ReadROM() giving the count of read requests sent */
+LONG rom_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length, ULONG *requests)
 {
     IOHeliosHWSendRequest ioreq;
     struct MsgPort port;
     HeliosAPacket *p;
     ULONG remains, loop, info_len, crc_len, tgen, tgen2;
+    ULONG root_end, block, first_block=0, vendor, model;
+    BOOL block_failed=FALSE;
     UWORD crc, rom_crc_value;
     LONG err, i;
     HeliosOffset offset;
 
+    *requests = 0;
+
     if (*length < CSR_CONFIG_ROM_SIZE)
     {
         _ERR("Destination buffer length too small\n");
@@ -289,6 +450,7 @@ LONG Helios_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length)
         {
             ioreq.iohhe_Req.iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
             err = DoIO(&ioreq.iohhe_Req.iohh_Req);
+            (*requests)++;
 
             if ((HHIOERR_NO_ERROR != err) || (HELIOS_RCODE_COMPLETE != p->RCode))
             {
@@ -363,17 +525,73 @@ LONG Helios_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length)
     rom_crc_value = storage[0] & 0xffff;
     _INFO_1394("$%04x: CRC len=%u, CRC value=%04x\n", dev->hd_NodeID, crc_len, rom_crc_value);
 
-    //ULONG max_payload = 1ul << (dev->hd_NodeInfo.n_MaxSpeed+9);
-
     /* My first implementation used 2 passes, one using a block read
      * then many quadlet reads if the first pass failed.
      * But it seems that some devices don't like this and stop to work
      * when block read is done.
-     * So now I use always quadlet reads only.
+     * So the root directory is read by quadlets, then its vendor/model give
+     * the block size from the quirk table (the max payload of n_MaxSpeed if
+     * unknown). A failed block read is done again with a half size, down to
+     * quadlet reads, and this size is learned for the vendor/model.
      */
+    root_end = ~0; /* Index after the root directory, known with ROM[5] */
+    block = 0;     /* Quadlet reads until the root directory end */
+    vendor = storage[3] >> 8;
+    model = 0;
 
     while (remains > 0)
     {
+        if ((0 == block) && (i >= (LONG)root_end))
+        {
+            rom_RootIds(&storage[5], &vendor, &model);
+            block = romquirk_MaxBlock(vendor, model, 1ul << (dev->hd_NodeInfo.n_MaxSpeed + 9));
+            first_block = block;
+
+            _INFO_1394("$%04x: vendor=$%06lx, model=$%06lx, block=%lu\n", dev->hd_NodeID, vendor, model, block);
+        }
+
+        if (block > sizeof(QUADLET))
+        {
+            ULONG size = MIN(block, remains);
+
+            err = rom_ReadBlock(&ioreq, dev, offset, &storage[i], size, requests);
+            if (HERR_BUSRESET == err)
+            {
+                _WARN("$%04x: ReadB@$%llx failed, BusReset occured!\n", dev->hd_NodeID, offset);
+                return HERR_BUSRESET;
+            }
+
+            if (HERR_NOERR != err)
+            {
+                /* An address error may come from the ROM end inside the block */
+                block = MAX(size / 2, sizeof(QUADLET));
+                if (HERR_BADCALL != err)
+                {
+                    _WARN("$%04x: ReadB@$%llx of %lu bytes failed, use %lu bytes now\n",
+                          dev->hd_NodeID, offset, size, block);
+                    romquirk_Learn(vendor, model, block);
+                    block_failed = TRUE;
+                }
+                continue;
+            }
+
+            LOCK_REGION_SHARED(dev);
+            tgen2 = dev->hd_Generation;
+            UNLOCK_REGION_SHARED(dev);
+
+            if (tgen != tgen2)
+            {
+                _WARN("$%04x: ReadB@$%llx failed, BusReset occured!\n", dev->hd_NodeID, offset);
+                return HERR_BUSRESET;
+            }
+
+            i += size / sizeof(QUADLET);
+            *length += size;
+            remains -= size;
+            offset += size;
+            continue;
+        }
+
         Helios_FillReadQuadletPacket(p, dev->hd_NodeInfo.n_MaxSpeed, offset);
 
         loop = 10;
@@ -382,6 +600,7 @@ LONG Helios_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length)
             _INFO_1394("$%04x: ReadQ@$%llX, S%u\n", dev->hd_NodeID, p->Offset, (1<<p->Speed)*100);
             ioreq.iohhe_Req.iohh_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
             err = DoIO(&ioreq.iohhe_Req.iohh_Req);
+            (*requests)++;
             if ((HHIOERR_FAILED == err) || (HELIOS_RCODE_COMPLETE != p->RCode))
             {
                 switch (p->RCode)
@@ -442,6 +661,17 @@ LONG Helios_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length)
         *length += sizeof(QUADLET);
         remains -= sizeof(QUADLET);
         offset += sizeof(QUADLET);
+
+        if (6 == i)
+        {
+            root_end = 6 + (storage[5] >> 16);
+        }
+    }
+
+    /* Block reads work for this vendor/model */
+    if ((first_block > sizeof(QUADLET)) && !block_failed)
+    {
+        romquirk_Learn(vendor, model, first_block);
     }
 
 check_crc:
@@ -459,6 +689,13 @@ check_crc:
     return HERR_NOERR;
 }
 
+LONG Helios_ReadROM(HeliosDevice *dev, QUADLET *storage, ULONG *length)
+{
+    ULONG requests;
+
+    return rom_ReadROM(dev, storage, length, &requests);
+}
+
 void Helios_InitRomIterator(HeliosRomIterator *ri, const QUADLET *rom)
 {
     ri->actual = rom + 1;
@@ -0,0 +1,326 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Configuration ROM cache.
+**
+** Each ROM read by a device scan is kept by GUID. The next scan of the same
+** GUID only reads the bus info block and the root directory header: if they
+** equal the cached ones (same ROM CRC, same 1394a generation field, same
+** root directory CRC) the cached ROM is used, else the full ROM is read.
+** A ROM using the minimal format or a non standard bus info block is never
+** cached.
+**
+** The cache lives in the library base, it may be saved to a file and loaded
+** back (Helios_SaveROMCache/Helios_LoadROMCache) so a cold boot can also
+** use it: helios_rom_start and helios_remove use the file given by the env
+** var helios_romcache.
+**
+*/
+
+#include "private.h"
+
+#include <clib/macros.h>
+#include <string.h>
+
+#ifndef MAKE_ID
+#define MAKE_ID(a,b,c,d) ((ULONG) (a)<<24 | (ULONG) (b)<<16 | (ULONG) (c)<<8 | (ULONG) (d))
+#endif
+
+#define ROMCACHE_MAX            64      /* Entries, the least recently used is dropped */
+#define ROMCACHE_CHECK          6       /* Bus info block + root directory header */
+#define ROMCACHE_FILE_ID        MAKE_ID('H','R','C','1')
+
+#define ROM_GUID(rom) (((UQUAD)(rom)[3] << 32) + (rom)[4])
+
+typedef struct HeliosROMCacheEntry
+{
+    struct MinNode rce_Node;
+    UQUAD          rce_GUID;
+    ULONG          rce_Length;  /* ROM length in bytes */
+    QUADLET        rce_Rom[0];
+} HeliosROMCacheEntry;
+
+/*----------------------------------------------------------------------------*/
+/*--- LOCAL CODE SECTION -----------------------------------------------------*/
+
+/* TRUE if rom can be validated by ROMCACHE_CHECK quadlets */
+static BOOL romcache_Cacheable(const QUADLET *rom, ULONG length)
+{
+    ULONG crc_len;
+
+    if ((length < (ROMCACHE_CHECK * sizeof(QUADLET))) ||
+        (length > CSR_CONFIG_ROM_SIZE) ||
+        (length & (sizeof(QUADLET)-1)) ||
+        ((rom[0] >> 24) != 4) ||
+        (0 == ROM_GUID(rom)))
+    {
+        return FALSE;
+    }
+
+    crc_len = (rom[0] >> 16) & 0xff;
+    return ((crc_len + 1) * sizeof(QUADLET) <= length) &&
+        (utils_GetBlockCRC16((QUADLET *)&rom[1], crc_len) == (rom[0] & 0xffff));
+}
+
+/* Cache must be locked */
+static HeliosROMCacheEntry *romcache_Find(UQUAD guid)
+{
+    HeliosROMCacheEntry *entry;
+
+    ForeachNode(&HeliosBase->hb_ROMCache.rc_Entries, entry)
+    {
+        if (entry->rce_GUID == guid)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/* Cache must be w-locked */
+static void romcache_Remove(HeliosROMCacheEntry *entry)
+{
+    REMOVE(entry);
+    HeliosBase->hb_ROMCache.rc_Count--;
+    FreePooled(HeliosBase->hb_MemPool, entry, sizeof(*entry) + entry->rce_Length);
+}
+
+/* Replace the GUID entry, as the most recently used one if head */
+static void romcache_Add(const QUADLET *rom, ULONG length, BOOL head)
+{
+    struct HeliosROMCache *cache = &HeliosBase->hb_ROMCache;
+    HeliosROMCacheEntry *entry;
+
+    LOCK_REGION(cache);
+    {
+        entry = romcache_Find(ROM_GUID(rom));
+        if (NULL != entry)
+        {
+            romcache_Remove(entry);
+        }
+
+        entry = AllocPooled(HeliosBase->hb_MemPool, sizeof(*entry) + length);
+        if (NULL != entry)
+        {
+            entry->rce_GUID = ROM_GUID(rom);
+            entry->rce_Length = length;
+            CopyMem((APTR)rom, entry->rce_Rom, length);
+
+            if (head)
+            {
+                ADDHEAD(&cache->rc_Entries, entry);
+            }
+            else
+            {
+                ADDTAIL(&cache->rc_Entries, entry);
+            }
+            cache->rc_Count++;
+
+            if (cache->rc_Count > ROMCACHE_MAX)
+            {
+                romcache_Remove((APTR)cache->rc_Entries.mlh_TailPred);
+            }
+        }
+    }
+    UNLOCK_REGION(cache);
+}
+
+void romcache_Init(void)
+{
+    LOCK_INIT(&HeliosBase->hb_ROMCache);
+    NEWLIST(&HeliosBase->hb_ROMCache.rc_Entries);
+    HeliosBase->hb_ROMCache.rc_Count = 0;
+}
+
+/* Fast path of a device scan.
+ * Returns TRUE if the device ROM is the cached one, copied in rom.
+ * rom has CSR_CONFIG_ROM_SIZE bytes. The quadlet reads are added to requests.
+ */
+BOOL romcache_Validate(HeliosDevice *dev, QUADLET *rom, ULONG *length, ULONG *requests)
+{
+    struct HeliosROMCache *cache = &HeliosBase->hb_ROMCache;
+    HeliosROMCacheEntry *entry;
+    QUADLET check[ROMCACHE_CHECK];
+    BOOL hit=FALSE;
+
+    *requests += ROMCACHE_CHECK;
+    if (rom_ReadQuadlets(dev, 0, check, ROMCACHE_CHECK - 1) ||
+        ((check[0] >> 24) != 4) ||
+        rom_ReadQuadlets(dev, ROMCACHE_CHECK - 1, &check[ROMCACHE_CHECK - 1], 1))
+    {
+        return FALSE;
+    }
+
+    LOCK_REGION(cache);
+    {
+        entry = romcache_Find(ROM_GUID(check));
+        if ((NULL != entry) && !memcmp(check, entry->rce_Rom, sizeof(check)))
+        {
+            CopyMemQuick(entry->rce_Rom, rom, entry->rce_Length);
+            *length = entry->rce_Length;
+
+            REMOVE(entry);
+            ADDHEAD(&cache->rc_Entries, entry);
+            hit = TRUE;
+        }
+    }
+    UNLOCK_REGION(cache);
+
+    if (hit)
+    {
+        _INFO("$%04x: ROM cache hit, GUID=$%llX\n", dev->hd_NodeID, ROM_GUID(check));
+    }
+
+    return hit;
+}
+
+/* Keep a ROM read by a device scan */
+void romcache_Store(const QUADLET *rom, ULONG length)
+{
+    if (romcache_Cacheable(rom, length))
+    {
+        romcache_Add(rom, length, TRUE);
+    }
+}
+
+
+/*============================================================================*/
+/*--- LIBRARY CODE SECTION ---------------------------------------------------*/
+
+/* Returns the count of loaded ROMs, or a negative HERR error */
+LONG Helios_LoadROMCache(CONST_STRPTR filename)
+{
+    QUADLET *rom;
+    ULONG header[2], i;
+    LONG count=0;
+    BPTR fh;
+
+    rom = AllocPooled(HeliosBase->hb_MemPool, CSR_CONFIG_ROM_SIZE);
+    if (NULL == rom)
+    {
+        return HERR_NOMEM;
+    }
+
+    fh = Open(filename, MODE_OLDFILE);
+    if (0 == fh)
+    {
+        FreePooled(HeliosBase->hb_MemPool, rom, CSR_CONFIG_ROM_SIZE);
+        return HERR_SYSTEM;
+    }
+
+    if ((sizeof(header) != Read(fh, header, sizeof(header))) ||
+        (ROMCACHE_FILE_ID != header[0]))
+    {
+        _ERR("%s: not a ROM cache file\n", filename);
+        count = HERR_IO;
+        goto out;
+    }
+
+    for (i=0; i < MIN(header[1], (ULONG)ROMCACHE_MAX); i++)
+    {
+        ULONG length;
+
+        if ((sizeof(length) != Read(fh, &length, sizeof(length))) ||
+            (length > CSR_CONFIG_ROM_SIZE) ||
+            ((LONG)length != Read(fh, rom, length)))
+        {
+            _ERR("%s: truncated at entry #%lu\n", filename, i);
+            break;
+        }
+
+        /* Never override a ROM read since the boot */
+        if (romcache_Cacheable(rom, length))
+        {
+            BOOL known;
+
+            LOCK_REGION_SHARED(&HeliosBase->hb_ROMCache);
+            known = NULL != romcache_Find(ROM_GUID(rom));
+            UNLOCK_REGION_SHARED(&HeliosBase->hb_ROMCache);
+
+            if (!known)
+            {
+                romcache_Add(rom, length, FALSE);
+                count++;
+            }
+        }
+        else
+        {
+            _WARN("%s: entry #%lu dropped (bad ROM)\n", filename, i);
+        }
+    }
+
+    _INFO("%s: %ld ROM(s) loaded\n", filename, count);
+
+out:
+    Close(fh);
+    FreePooled(HeliosBase->hb_MemPool, rom, CSR_CONFIG_ROM_SIZE);
+
+    return count;
+}
+
+/* Returns the count of saved ROMs, or a negative HERR error */
+LONG Helios_SaveROMCache(CONST_STRPTR filename)
+{
+    struct HeliosROMCache *cache = &HeliosBase->hb_ROMCache;
+    HeliosROMCacheEntry *entry;
+    ULONG header[2];
+    LONG count=0;
+    BPTR fh;
+
+    fh = Open(filename, MODE_NEWFILE);
+    if (0 == fh)
+    {
+        return HERR_SYSTEM;
+    }
+
+    LOCK_REGION_SHARED(cache);
+    {
+        header[0] = ROMCACHE_FILE_ID;
+        header[1] = cache->rc_Count;
+
+        if (sizeof(header) == Write(fh, header, sizeof(header)))
+        {
+            ForeachNode(&cache->rc_Entries, entry)
+            {
+                if ((sizeof(entry->rce_Length) != Write(fh, &entry->rce_Length, sizeof(entry->rce_Length))) ||
+                    ((LONG)entry->rce_Length != Write(fh, entry->rce_Rom, entry->rce_Length)))
+                {
+                    break;
+                }
+                count++;
+            }
+        }
+
+        if (count != (LONG)cache->rc_Count)
+        {
+            _ERR("%s: write failed\n", filename);
+            count = HERR_IO;
+        }
+    }
+    UNLOCK_REGION_SHARED(cache);
+
+    Close(fh);
+
+    return count;
+}
+
+/* EOF */
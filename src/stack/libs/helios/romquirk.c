@@ -0,0 +1,306 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Configuration ROM read quirks.
+**
+** Max block read size used by Helios_ReadROM() per vendor/model, 4 meaning
+** quadlet reads only. Entries are learned from block read failures and
+** successes, or loaded from a text file (Helios_LoadROMQuirks), one entry
+** per line:
+**
+**     # vendor  model     max block bytes
+**     0x00d04b  0x000001  4
+**     0x0001f2  *         512
+**
+** helios_rom_start loads and helios_remove saves the file named by the env
+** var helios_romquirks.
+**
+*/
+
+#include "private.h"
+
+#include <clib/macros.h>
+#include <ctype.h>
+
+#define ROMQUIRK_ANY_MODEL      (~0ul)
+#define ROMQUIRK_MAX            128
+#define ROMQUIRK_MAX_BLOCK      2048    /* S400 max payload */
+
+typedef struct HeliosROMQuirk
+{
+    struct MinNode rqk_Node;
+    ULONG          rqk_VendorID;
+    ULONG          rqk_ModelID;     /* ROMQUIRK_ANY_MODEL for all models */
+    ULONG          rqk_MaxBlock;    /* Bytes */
+} HeliosROMQuirk;
+
+/*----------------------------------------------------------------------------*/
+/*--- LOCAL CODE SECTION -----------------------------------------------------*/
+
+/* Quirks must be locked */
+static HeliosROMQuirk *romquirk_Find(ULONG vendor, ULONG model)
+{
+    HeliosROMQuirk *quirk;
+
+    ForeachNode(&HeliosBase->hb_ROMQuirks.rq_Entries, quirk)
+    {
+        if ((quirk->rqk_VendorID == vendor) && (quirk->rqk_ModelID == model))
+        {
+            return quirk;
+        }
+    }
+
+    return NULL;
+}
+
+/* Power of 2 in [4, ROMQUIRK_MAX_BLOCK] */
+static ULONG romquirk_BlockSize(ULONG size)
+{
+    ULONG block = sizeof(QUADLET);
+
+    while (((block * 2) <= size) && ((block * 2) <= ROMQUIRK_MAX_BLOCK))
+    {
+        block *= 2;
+    }
+
+    return block;
+}
+
+/* Set the vendor/model entry, lower only if keep_lower */
+static void romquirk_Set(ULONG vendor, ULONG model, ULONG block, BOOL keep_lower)
+{
+    struct HeliosROMQuirks *quirks = &HeliosBase->hb_ROMQuirks;
+    HeliosROMQuirk *quirk;
+
+    block = romquirk_BlockSize(block);
+
+    LOCK_REGION(quirks);
+    {
+        quirk = romquirk_Find(vendor, model);
+        if (NULL != quirk)
+        {
+            quirk->rqk_MaxBlock = keep_lower ? MIN(quirk->rqk_MaxBlock, block) : block;
+        }
+        else if (quirks->rq_Count < ROMQUIRK_MAX)
+        {
+            quirk = AllocPooled(HeliosBase->hb_MemPool, sizeof(*quirk));
+            if (NULL != quirk)
+            {
+                quirk->rqk_VendorID = vendor;
+                quirk->rqk_ModelID = model;
+                quirk->rqk_MaxBlock = block;
+                ADDTAIL(&quirks->rq_Entries, quirk);
+                quirks->rq_Count++;
+            }
+        }
+    }
+    UNLOCK_REGION(quirks);
+}
+
+/* Hexa ($, 0x) or decimal number, '*' gives ROMQUIRK_ANY_MODEL */
+static BOOL romquirk_ParseNumber(STRPTR *line, ULONG *value)
+{
+    STRPTR s = *line;
+    ULONG base = 10, digit;
+    BOOL found = FALSE;
+
+    while (isspace(*s))
+    {
+        s++;
+    }
+
+    if ('*' == *s)
+    {
+        *value = ROMQUIRK_ANY_MODEL;
+        *line = s + 1;
+        return TRUE;
+    }
+
+    if ('$' == *s)
+    {
+        base = 16;
+        s++;
+    }
+    else if (('0' == s[0]) && ('x' == tolower(s[1])))
+    {
+        base = 16;
+        s += 2;
+    }
+
+    *value = 0;
+    for (;; s++)
+    {
+        if (isdigit(*s))
+        {
+            digit = *s - '0';
+        }
+        else if ((16 == base) && isxdigit(*s))
+        {
+            digit = tolower(*s) - 'a' + 10;
+        }
+        else
+        {
+            break;
+        }
+
+        *value = *value * base + digit;
+        found = TRUE;
+    }
+
+    *line = s;
+    return found;
+}
+
+void romquirk_Init(void)
+{
+    LOCK_INIT(&HeliosBase->hb_ROMQuirks);
+    NEWLIST(&HeliosBase->hb_ROMQuirks.rq_Entries);
+    HeliosBase->hb_ROMQuirks.rq_Count = 0;
+}
+
+/* Max block read size for the vendor/model, def if unknown */
+ULONG romquirk_MaxBlock(ULONG vendor, ULONG model, ULONG def)
+{
+    struct HeliosROMQuirks *quirks = &HeliosBase->hb_ROMQuirks;
+    HeliosROMQuirk *quirk;
+    ULONG block;
+
+    LOCK_REGION_SHARED(quirks);
+    {
+        quirk = romquirk_Find(vendor, model);
+        if (NULL == quirk)
+        {
+            quirk = romquirk_Find(vendor, ROMQUIRK_ANY_MODEL);
+        }
+
+        block = (NULL != quirk) ? quirk->rqk_MaxBlock : romquirk_BlockSize(def);
+    }
+    UNLOCK_REGION_SHARED(quirks);
+
+    return block;
+}
+
+/* Keep the block size that worked (or the half of the one that failed) */
+void romquirk_Learn(ULONG vendor, ULONG model, ULONG block)
+{
+    _INFO("ROM quirk: vendor=$%06lx, model=$%06lx, max block=%lu\n", vendor, model, block);
+    romquirk_Set(vendor, model, block, TRUE);
+}
+
+
+/*============================================================================*/
+/*--- LIBRARY CODE SECTION ---------------------------------------------------*/
+
+/* Returns the count of loaded entries, or a negative HERR error */
+LONG Helios_LoadROMQuirks(CONST_STRPTR filename)
+{
+    UBYTE line[128];
+    ULONG lineno=0;
+    LONG count=0;
+    BPTR fh;
+
+    fh = Open(filename, MODE_OLDFILE);
+    if (0 == fh)
+    {
+        return HERR_SYSTEM;
+    }
+
+    while (NULL != FGets(fh, line, sizeof(line)))
+    {
+        STRPTR s = line;
+        ULONG vendor, model, block;
+
+        lineno++;
+
+        while (isspace(*s))
+        {
+            s++;
+        }
+
+        if (('\0' == *s) || ('#' == *s) || (';' == *s))
+        {
+            continue;
+        }
+
+        if (!romquirk_ParseNumber(&s, &vendor) ||
+            !romquirk_ParseNumber(&s, &model) ||
+            !romquirk_ParseNumber(&s, &block) ||
+            (ROMQUIRK_ANY_MODEL == vendor))
+        {
+            _WARN("%s:%lu: syntax error\n", filename, lineno);
+            continue;
+        }
+
+        /* The file overrides learned entries */
+        romquirk_Set(vendor, model, block, FALSE);
+        count++;
+    }
+
+    Close(fh);
+
+    _INFO("%s: %ld ROM quirk(s) loaded\n", filename, count);
+
+    return count;
+}
+
+/* Returns the count of saved entries, or a negative HERR error */
+LONG Helios_SaveROMQuirks(CONST_STRPTR filename)
+{
+    struct HeliosROMQuirks *quirks = &HeliosBase->hb_ROMQuirks;
+    HeliosROMQuirk *quirk;
+    LONG count=0;
+    BPTR fh;
+
+    fh = Open(filename, MODE_NEWFILE);
+    if (0 == fh)
+    {
+        return HERR_SYSTEM;
+    }
+
+    FPuts(fh, "# Helios ROM read quirks\n# vendor  model     max block bytes\n");
+
+    LOCK_REGION_SHARED(quirks);
+    {
+        ForeachNode(&quirks->rq_Entries, quirk)
+        {
+            if (ROMQUIRK_ANY_MODEL == quirk->rqk_ModelID)
+            {
+                FPrintf(fh, "0x%06lx  *         %lu\n", quirk->rqk_VendorID, quirk->rqk_MaxBlock);
+            }
+            else
+            {
+                FPrintf(fh, "0x%06lx  0x%06lx  %lu\n",
+                        quirk->rqk_VendorID, quirk->rqk_ModelID, quirk->rqk_MaxBlock);
+            }
+            count++;
+        }
+    }
+    UNLOCK_REGION_SHARED(quirks);
+
+    if (!Close(fh))
+    {
+        count = HERR_IO;
+    }
+
+    return count;
+}
+
+/* EOF */
@@ -0,0 +1,293 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Capture the asynchronous traffic of a hardware into a pcap file,
+** up to a CTRL-C. The link type is described in devices/helios.h.
+**
+**     helios_capture TO=RAM:bus.pcap              headers only
+**     helios_capture TO=RAM:bus.pcap PAYLOAD      with payload prefixes
+**
+*/
+
+#include "proto/helios.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <string.h>
+
+#define HELIOS_LIBNAME "helios.library"
+#define MAX_PACKETS 256
+
+/* DateStamp epoch (1978-01-01) in Unix time */
+#define AMIGA_EPOCH    252460800ul
+
+static const UBYTE template[] = "HW_ID/N,TO/A,PAYLOAD/S";
+
+static struct
+{
+    LONG *hwno;
+    STRPTR to;
+    LONG payload;
+} args;
+
+struct pcap_file_header
+{
+    ULONG magic;
+    UWORD version_major;
+    UWORD version_minor;
+    LONG  thiszone;
+    ULONG sigfigs;
+    ULONG snaplen;
+    ULONG linktype;
+};
+
+struct pcap_packet_header
+{
+    ULONG ts_sec;
+    ULONG ts_usec;
+    ULONG incl_len;
+    ULONG orig_len;
+};
+
+static HeliosCapturePacket packets[MAX_PACKETS];
+
+static LONG set_capture(HeliosHardware *hw, IOHeliosHWReq *ioreq, ULONG flags)
+{
+    struct TagItem tags[] =
+    {
+        {HHA_Capture, flags},
+        {TAG_DONE, 0}
+    };
+
+    ioreq->iohh_Req.io_Command = HHIOCMD_SETATTRIBUTES;
+    ioreq->iohh_Data = tags;
+    return Helios_DoIO(HGA_HARDWARE, hw, ioreq) || (1 != ioreq->iohh_Actual);
+}
+
+/* Returns the number of packets read after the one of seq after, or -1 */
+static LONG read_capture(HeliosHardware *hw, IOHeliosHWReq *ioreq, ULONG after)
+{
+    ioreq->iohh_Req.io_Command = HHIOCMD_READCAPTURE;
+    ioreq->iohh_Data = packets;
+    ioreq->iohh_Length = sizeof(packets);
+    ioreq->iohh_Actual = after;
+    if (Helios_DoIO(HGA_HARDWARE, hw, ioreq))
+    {
+        Printf("HHIOCMD_READCAPTURE failed, io err=%ld\n", (LONG)ioreq->iohh_Req.io_Error);
+        return -1;
+    }
+
+    return ioreq->iohh_Actual;
+}
+
+static BOOL write_packet(BPTR fh, HeliosCapturePacket *cp, UQUAD us)
+{
+    struct pcap_packet_header ph;
+    HeliosCapturePcapHeader cph;
+
+    cph.cph_Version = HCAPTURE_PCAP_VERSION;
+    cph.cph_Type = cp->cp_Type;
+    cph.cph_Event = cp->cp_Event;
+    cph.cph_HeaderLength = cp->cp_HeaderLength;
+    cph.cph_TimeStamp = cp->cp_TimeStamp;
+    cph.cph_PayloadLength = cp->cp_PayloadLength;
+    cph.cph_CycleTimer = cp->cp_Time;
+    cph.cph_Speed = cp->cp_Speed;
+    cph.cph_Reserved[0] = cph.cph_Reserved[1] = cph.cph_Reserved[2] = 0;
+
+    ph.ts_sec = us / 1000000;
+    ph.ts_usec = us % 1000000;
+    ph.incl_len = sizeof(cph) + cp->cp_HeaderLength + cp->cp_CapLength;
+    ph.orig_len = sizeof(cph) + cp->cp_HeaderLength + cp->cp_PayloadLength;
+
+    return (1 == FWrite(fh, &ph, sizeof(ph), 1)) &&
+        (1 == FWrite(fh, &cph, sizeof(cph), 1)) &&
+        (!cp->cp_HeaderLength || (1 == FWrite(fh, cp->cp_Header, cp->cp_HeaderLength, 1))) &&
+        (!cp->cp_CapLength || (1 == FWrite(fh, cp->cp_Payload, cp->cp_CapLength, 1)));
+}
+
+static LONG capture(HeliosHardware *hw, IOHeliosHWReq *ioreq, BPTR fh)
+{
+    struct pcap_file_header fhdr;
+    struct DateStamp ds;
+    ULONG last_seq=0, last_ticks=0, count=0, lost=0;
+    UQUAD start_us, ticks=0;
+    LONG n, res=RETURN_OK;
+    BOOL first=TRUE;
+
+    fhdr.magic = 0xa1b2c3d4; /* big-endian file on MorphOS */
+    fhdr.version_major = 2;
+    fhdr.version_minor = 4;
+    fhdr.thiszone = 0;
+    fhdr.sigfigs = 0;
+    fhdr.snaplen = sizeof(HeliosCapturePcapHeader) + sizeof(packets[0].cp_Header) + HCAPTURE_PAYLOAD;
+    fhdr.linktype = HCAPTURE_LINKTYPE;
+    if (1 != FWrite(fh, &fhdr, sizeof(fhdr), 1))
+    {
+        return RETURN_ERROR;
+    }
+
+    /* Skip packets kept from a previous capture */
+    while ((n = read_capture(hw, ioreq, last_seq)) > 0)
+    {
+        last_seq = packets[n-1].cp_Seq;
+    }
+    if (n < 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    if (set_capture(hw, ioreq, HCAPF_HEADERS | (args.payload ? HCAPF_PAYLOAD : 0)))
+    {
+        Printf("Capture not supported by this hardware\n");
+        return RETURN_ERROR;
+    }
+
+    DateStamp(&ds);
+    start_us = ((UQUAD)AMIGA_EPOCH + ds.ds_Days * 86400ul + ds.ds_Minute * 60ul) * 1000000
+        + ds.ds_Tick * (1000000 / TICKS_PER_SECOND);
+
+    Printf("Capturing, CTRL-C to stop...\n");
+
+    while (!(SetSignal(0, 0) & SIGBREAKF_CTRL_C))
+    {
+        LONG i;
+
+        n = read_capture(hw, ioreq, last_seq);
+        if (n < 0)
+        {
+            res = RETURN_ERROR;
+            break;
+        }
+
+        for (i=0; i < n; i++)
+        {
+            HeliosCapturePacket *cp = &packets[i];
+            ULONG t = HELIOS_CYCLE_TICKS(cp->cp_Time);
+
+            /* The cycle timer wraps every 128s, consecutive packets are closer */
+            if (!first)
+            {
+                ticks += (t - last_ticks + HELIOS_CYCLE_WRAP) % HELIOS_CYCLE_WRAP;
+            }
+            first = FALSE;
+            last_ticks = t;
+
+            lost += cp->cp_Seq - last_seq - 1;
+            last_seq = cp->cp_Seq;
+
+            if (!write_packet(fh, cp, start_us + (ticks * 1000) / 24576))
+            {
+                PrintFault(IoErr(), args.to);
+                res = RETURN_ERROR;
+                break;
+            }
+            count++;
+        }
+
+        if (RETURN_OK != res)
+        {
+            break;
+        }
+
+        /* Wait for more when the ring is drained */
+        if (n < MAX_PACKETS)
+        {
+            Delay(1);
+        }
+    }
+
+    set_capture(hw, ioreq, 0);
+
+    Printf("%lu packet(s) captured, %lu lost\n", count, lost);
+
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    struct Library *HeliosBase;
+    APTR rdargs;
+    LONG res=RETURN_FAIL, hwno=0;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL == rdargs)
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    if (NULL != args.hwno)
+    {
+        hwno = *args.hwno;
+    }
+
+    HeliosBase = OpenLibrary(HELIOS_LIBNAME, 52);
+    if (NULL != HeliosBase)
+    {
+        HeliosHardware *hw = NULL;
+        LONG cnt=0;
+
+        Helios_ReadLockBase();
+        {
+            while (NULL != (hw = Helios_GetNextHardware(hw)))
+            {
+                if (hwno == cnt++)
+                {
+                    break;
+                }
+                Helios_ReleaseHardware(hw);
+            }
+        }
+        Helios_UnlockBase();
+
+        if (NULL != hw)
+        {
+            BPTR fh;
+
+            fh = Open(args.to, MODE_NEWFILE);
+            if (0 != fh)
+            {
+                IOHeliosHWReq ioreq;
+
+                bzero(&ioreq, sizeof(ioreq));
+                ioreq.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+
+                res = capture(hw, &ioreq, fh);
+                Close(fh);
+            }
+            else
+            {
+                PrintFault(IoErr(), args.to);
+            }
+
+            Helios_ReleaseHardware(hw);
+        }
+        else
+        {
+            Printf("No hardware #%ld\n", hwno);
+        }
+
+        CloseLibrary(HeliosBase);
+    }
+
+    FreeArgs(rdargs);
+    return res;
+}
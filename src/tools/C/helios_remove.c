@@ -37,6 +37,17 @@ int main(int argc, char **argv)
         HeliosClass *hc;
         HeliosHardware *hw;
         APTR next;
+        UBYTE path[256];
+
+        /* Keep known ROMs for the next helios_rom_start */
+        if (GetVar("helios_romcache", path, sizeof(path), 0) > 0)
+        {
+            Helios_SaveROMCache(path);
+        }
+        if (GetVar("helios_romquirks", path, sizeof(path), 0) > 0)
+        {
+            Helios_SaveROMQuirks(path);
+        }
 
         hc = Helios_GetNextClass(NULL);
         while (NULL != hc)
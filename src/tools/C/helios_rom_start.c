@@ -25,6 +25,7 @@ along with Helios.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <exec/execbase.h>
 #include <proto/exec.h>
+#include <proto/dos.h>
 
 #include <string.h>
 
@@ -44,6 +45,17 @@ int main(int argc, char **argv)
     if (NULL != HeliosBase)
     {
         ULONG cnt;
+        UBYTE path[256];
+
+        /* ROMs known by the previous session, before any scan */
+        if (GetVar("helios_romcache", path, sizeof(path), 0) > 0)
+        {
+            Helios_LoadROMCache(path);
+        }
+        if (GetVar("helios_romquirks", path, sizeof(path), 0) > 0)
+        {
+            Helios_LoadROMQuirks(path);
+        }
 
         Helios_AddClass("Helios/sbp2.class", 50);
 
@@ -0,0 +1,268 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Print the statistics of a hardware over an interval.
+**
+**     helios_stats INTERVAL=5         counters difference over 5 seconds
+**     helios_stats RESET              zero the counters first
+**
+*/
+
+#include "proto/helios.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <string.h>
+
+#define HELIOS_LIBNAME "helios.library"
+
+static const UBYTE template[] = "HW_ID/N,INTERVAL/N,RESET/S";
+
+static struct
+{
+    LONG *hwno;
+    LONG *interval;
+    LONG reset;
+} args;
+
+static const CONST_STRPTR ack_names[16] =
+{
+    [HELIOS_ACK_COMPLETE]   = "complete",
+    [HELIOS_ACK_PENDING]    = "pending",
+    [HELIOS_ACK_BUSY_X]     = "busy_x",
+    [HELIOS_ACK_BUSY_A]     = "busy_a",
+    [HELIOS_ACK_BUSY_B]     = "busy_b",
+    [HELIOS_ACK_TARDY]      = "tardy",
+    [HELIOS_ACK_DATA_ERROR] = "data_error",
+    [HELIOS_ACK_TYPE_ERROR] = "type_error",
+};
+
+static const CONST_STRPTR rcode_names[32] =
+{
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_COMPLETE)]       = "complete",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_CONFLICT_ERROR)] = "conflict_error",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_DATA_ERROR)]     = "data_error",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_TYPE_ERROR)]     = "type_error",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_ADDRESS_ERROR)]  = "address_error",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_CANCELLED)]      = "cancelled",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_GENERATION)]     = "generation",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_MISSING_ACK)]    = "missing_ack",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_SEND_ERROR)]     = "send_error",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_BUSY)]           = "busy",
+    [HSTAT_RCODE_INDEX(HELIOS_RCODE_TIMEOUT)]        = "timeout",
+};
+
+static HeliosHWStatistics stats[2];
+
+static LONG snapshot(HeliosHardware *hw, IOHeliosHWReq *ioreq, HeliosHWStatistics *s)
+{
+    struct TagItem tags[] =
+    {
+        {HHA_Statistics, (ULONG)s},
+        {TAG_DONE, 0}
+    };
+
+    ioreq->iohh_Req.io_Command = HHIOCMD_QUERYDEVICE;
+    ioreq->iohh_Data = tags;
+    return Helios_DoIO(HGA_HARDWARE, hw, ioreq) || (1 != ioreq->iohh_Actual);
+}
+
+/* Counters only wrap, unsigned difference is right modulo 2^32 */
+#define DIFF(field) (stats[1].field - stats[0].field)
+
+static void print_ctx(CONST_STRPTR name, HeliosHWCtxStats *c0, HeliosHWCtxStats *c1, ULONG secs, BOOL at)
+{
+    ULONG packets = c1->cs_Packets - c0->cs_Packets;
+    ULONG bytes = c1->cs_Bytes - c0->cs_Bytes;
+
+    Printf("%-12s %10lu %12lu %10lu %10lu", (ULONG)name, packets, bytes, packets / secs, bytes / secs / 1024);
+    if (at)
+    {
+        Printf(" %10lu", c1->cs_HighWater);
+    }
+    Printf("\n");
+}
+
+static void print_stats(ULONG secs)
+{
+    ULONG i, total=0, max=0;
+
+    Printf("%-12s %10s %12s %10s %10s %10s\n",
+           (ULONG)"context", (ULONG)"packets", (ULONG)"bytes", (ULONG)"packets/s",
+           (ULONG)"KB/s", (ULONG)"high-water");
+    print_ctx("AT request", &stats[0].hs_ATRequest, &stats[1].hs_ATRequest, secs, TRUE);
+    print_ctx("AT response", &stats[0].hs_ATResponse, &stats[1].hs_ATResponse, secs, TRUE);
+    print_ctx("AR request", &stats[0].hs_ARRequest, &stats[1].hs_ARRequest, secs, FALSE);
+    print_ctx("AR response", &stats[0].hs_ARResponse, &stats[1].hs_ARResponse, secs, FALSE);
+
+    Printf("\nAcks:\n");
+    for (i=0; i < 16; i++)
+    {
+        if (DIFF(hs_Acks[i]))
+        {
+            Printf("  %-16s %10lu\n", (ULONG)(ack_names[i] ? ack_names[i] : (CONST_STRPTR)"?"), DIFF(hs_Acks[i]));
+        }
+    }
+
+    Printf("\nTransactions:\n");
+    for (i=0; i < 32; i++)
+    {
+        if (DIFF(hs_RCodes[i]))
+        {
+            Printf("  %-16s %10lu\n", (ULONG)(rcode_names[i] ? rcode_names[i] : (CONST_STRPTR)"?"), DIFF(hs_RCodes[i]));
+        }
+    }
+
+    Printf("\nBusy acks: %lu, split timeouts: %lu, generation drops: AT %lu, AR %lu\n",
+           DIFF(hs_BusyAcks), DIFF(hs_SplitTimeouts),
+           DIFF(hs_ATGenerationDrops), DIFF(hs_ARGenerationDrops));
+
+    for (i=0; i < HSTAT_LATENCY_BINS; i++)
+    {
+        total += DIFF(hs_Latency[i]);
+        if (DIFF(hs_Latency[i]) > max)
+        {
+            max = DIFF(hs_Latency[i]);
+        }
+    }
+
+    Printf("\nLatency (%lu transactions, max %lu us since reset):\n", total, stats[1].hs_LatencyMax);
+    for (i=0; (i < HSTAT_LATENCY_BINS) && max; i++)
+    {
+        ULONG n = DIFF(hs_Latency[i]);
+        ULONG j, bar = (n * 40 + max - 1) / max;
+
+        if (0 == i)
+        {
+            Printf("  %10s", (ULONG)"< 1 us");
+        }
+        else if (HSTAT_LATENCY_BINS - 1 == i)
+        {
+            Printf("  >= %7lu", 1ul << (i - 1));
+        }
+        else
+        {
+            Printf("  < %8lu", 1ul << i);
+        }
+
+        Printf(" %10lu ", n);
+        for (j=0; j < bar; j++)
+        {
+            Printf("#");
+        }
+        Printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct Library *HeliosBase;
+    APTR rdargs;
+    LONG res=RETURN_FAIL, hwno=0, interval=1;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL == rdargs)
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    if (NULL != args.hwno)
+    {
+        hwno = *args.hwno;
+    }
+
+    if ((NULL != args.interval) && (*args.interval > 0))
+    {
+        interval = *args.interval;
+    }
+
+    HeliosBase = OpenLibrary(HELIOS_LIBNAME, 52);
+    if (NULL != HeliosBase)
+    {
+        HeliosHardware *hw = NULL;
+        LONG cnt=0;
+
+        Helios_ReadLockBase();
+        {
+            while (NULL != (hw = Helios_GetNextHardware(hw)))
+            {
+                if (hwno == cnt++)
+                {
+                    break;
+                }
+                Helios_ReleaseHardware(hw);
+            }
+        }
+        Helios_UnlockBase();
+
+        if (NULL != hw)
+        {
+            IOHeliosHWReq ioreq;
+
+            res = RETURN_OK;
+            bzero(&ioreq, sizeof(ioreq));
+            ioreq.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+
+            if (args.reset)
+            {
+                ioreq.iohh_Req.io_Command = HHIOCMD_RESETSTATISTICS;
+                if (Helios_DoIO(HGA_HARDWARE, hw, &ioreq))
+                {
+                    Printf("HHIOCMD_RESETSTATISTICS failed, io err=%ld\n", (LONG)ioreq.iohh_Req.io_Error);
+                    res = RETURN_ERROR;
+                }
+            }
+
+            if (RETURN_OK == res)
+            {
+                if (snapshot(hw, &ioreq, &stats[0]))
+                {
+                    Printf("Statistics not supported by this hardware\n");
+                    res = RETURN_ERROR;
+                }
+                else
+                {
+                    Delay(interval * TICKS_PER_SECOND);
+
+                    if (snapshot(hw, &ioreq, &stats[1]))
+                    {
+                        res = RETURN_ERROR;
+                    }
+                    else
+                    {
+                        print_stats(interval);
+                    }
+                }
+            }
+
+            Helios_ReleaseHardware(hw);
+        }
+        else
+        {
+            Printf("No hardware #%ld\n", hwno);
+        }
+
+        CloseLibrary(HeliosBase);
+    }
+
+    FreeArgs(rdargs);
+    return res;
+}
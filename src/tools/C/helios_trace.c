@@ -0,0 +1,275 @@
+/* Copyright 2008-2013,2019 Guillaume Roguez
+
+This file is part of Helios.
+
+Helios is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Helios is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Helios.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+**
+** Set the tracepoints mask of a hardware and dump its recorded events.
+**
+**     helios_trace MASK=AT,AR,TL      enable these subsystems
+**     helios_trace MASK=NONE          disable all tracepoints
+**     helios_trace DUMP               print events, oldest first
+**
+*/
+
+#include "proto/helios.h"
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <proto/utility.h>
+#include <string.h>
+
+#define HELIOS_LIBNAME "helios.library"
+#define MAX_EVENTS 1024
+
+static const UBYTE template[] = "HW_ID/N,MASK/K,DUMP/S";
+
+static struct
+{
+    LONG *hwno;
+    STRPTR mask;
+    LONG dump;
+} args;
+
+static const struct
+{
+    CONST_STRPTR name;
+    ULONG        flag;
+} subsystems[] =
+{
+    {"AT",       HTRACEF_AT},
+    {"AR",       HTRACEF_AR},
+    {"IRQ",      HTRACEF_IRQ},
+    {"TL",       HTRACEF_TL},
+    {"BUSRESET", HTRACEF_BUSRESET},
+    {"SBP2",     HTRACEF_SBP2},
+    {"ALL",      HTRACEF_ALL},
+    {"NONE",     0},
+};
+
+static const struct
+{
+    UWORD        id;
+    CONST_STRPTR name;
+} tracepoints[] =
+{
+    {HTP_AT_SEND,         "at-send"},
+    {HTP_AT_COMPLETE,     "at-complete"},
+    {HTP_AT_DROP,         "at-drop"},
+    {HTP_AR_PACKET,       "ar-packet"},
+    {HTP_AR_DROP,         "ar-drop"},
+    {HTP_IRQ_EVENTS,      "irq"},
+    {HTP_IRQ_HANDLER,     "irq-handler"},
+    {HTP_TL_SEND,         "tl-send"},
+    {HTP_TL_RESPONSE,     "tl-response"},
+    {HTP_TL_FINISH,       "tl-finish"},
+    {HTP_TL_TIMEOUT,      "tl-timeout"},
+    {HTP_BUSRESET_SELFID, "busreset"},
+    {HTP_SBP2_QUEUE,      "sbp2-queue"},
+    {HTP_SBP2_DOORBELL,   "sbp2-doorbell"},
+    {HTP_SBP2_STATUS,     "sbp2-status"},
+    {HTP_SBP2_DONE,       "sbp2-done"},
+};
+
+static HeliosTraceEvent events[MAX_EVENTS];
+
+/* Comma separated subsystem names, returns FALSE on an unknown name */
+static BOOL parse_mask(STRPTR s, ULONG *mask)
+{
+    *mask = 0;
+
+    while ('\0' != *s)
+    {
+        ULONG i, len = strcspn(s, ",");
+
+        for (i=0; i < sizeof(subsystems)/sizeof(*subsystems); i++)
+        {
+            if ((strlen(subsystems[i].name) == len) && !Strnicmp(s, subsystems[i].name, len))
+            {
+                *mask |= subsystems[i].flag;
+                break;
+            }
+        }
+
+        if (i == sizeof(subsystems)/sizeof(*subsystems))
+        {
+            Printf("Unknown subsystem in '%s'\n", (ULONG)s);
+            return FALSE;
+        }
+
+        s += len;
+        if (',' == *s)
+        {
+            s++;
+        }
+    }
+
+    return TRUE;
+}
+
+static CONST_STRPTR tracepoint_name(UWORD id)
+{
+    ULONG i;
+
+    for (i=0; i < sizeof(tracepoints)/sizeof(*tracepoints); i++)
+    {
+        if (tracepoints[i].id == id)
+        {
+            return tracepoints[i].name;
+        }
+    }
+
+    return "?";
+}
+
+static void dump(ULONG count)
+{
+    ULONG i, prev=0;
+
+    Printf("%10s %16s %10s %-14s %6s %10s %10s\n",
+           (ULONG)"seq", (ULONG)"sec:cycle:off", (ULONG)"delta(us)", (ULONG)"tracepoint",
+           (ULONG)"arg16", (ULONG)"arg1", (ULONG)"arg2");
+
+    for (i=0; i < count; i++)
+    {
+        HeliosTraceEvent *ev = &events[i];
+        ULONG ticks = HELIOS_CYCLE_TICKS(ev->te_Time);
+        ULONG delta = i ? (ticks - prev + HELIOS_CYCLE_WRAP) % HELIOS_CYCLE_WRAP : 0;
+
+        Printf("%10lu %3lu:%04lu:%04lu %10lu %-14s %6lx %10lx %10lx\n",
+               ev->te_Seq, ev->te_Time >> 25, (ev->te_Time >> 12) & 0x1fff, ev->te_Time & 0xfff,
+               (ULONG)(((UQUAD)delta * 1000) / 24576), (ULONG)tracepoint_name(ev->te_Id),
+               ev->te_Arg16, ev->te_Args[0], ev->te_Args[1]);
+        prev = ticks;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct Library *HeliosBase;
+    APTR rdargs;
+    LONG res=RETURN_FAIL, hwno=0;
+
+    rdargs = ReadArgs(template, (APTR) &args, NULL);
+    if (NULL == rdargs)
+    {
+        PrintFault(IoErr(), NULL);
+        return RETURN_ERROR;
+    }
+
+    if (NULL != args.hwno)
+    {
+        hwno = *args.hwno;
+    }
+
+    HeliosBase = OpenLibrary(HELIOS_LIBNAME, 52);
+    if (NULL != HeliosBase)
+    {
+        HeliosHardware *hw = NULL;
+        LONG cnt=0;
+
+        Helios_ReadLockBase();
+        {
+            while (NULL != (hw = Helios_GetNextHardware(hw)))
+            {
+                if (hwno == cnt++)
+                {
+                    break;
+                }
+                Helios_ReleaseHardware(hw);
+            }
+        }
+        Helios_UnlockBase();
+
+        if (NULL != hw)
+        {
+            IOHeliosHWReq ioreq;
+            ULONG mask;
+
+            res = RETURN_OK;
+            bzero(&ioreq, sizeof(ioreq));
+            ioreq.iohh_Req.io_Message.mn_Length = sizeof(ioreq);
+
+            if (NULL != args.mask)
+            {
+                if (parse_mask(args.mask, &mask))
+                {
+                    struct TagItem tags[] =
+                    {
+                        {HHA_TraceMask, mask},
+                        {TAG_DONE, 0}
+                    };
+
+                    ioreq.iohh_Req.io_Command = HHIOCMD_SETATTRIBUTES;
+                    ioreq.iohh_Data = tags;
+                    if (Helios_DoIO(HGA_HARDWARE, hw, &ioreq) || (1 != ioreq.iohh_Actual))
+                    {
+                        Printf("Tracepoints not supported by this hardware\n");
+                        res = RETURN_ERROR;
+                    }
+                }
+                else
+                {
+                    res = RETURN_ERROR;
+                }
+            }
+
+            if ((RETURN_OK == res) && args.dump)
+            {
+                ioreq.iohh_Req.io_Command = HHIOCMD_DUMPTRACE;
+                ioreq.iohh_Data = events;
+                ioreq.iohh_Length = sizeof(events);
+                if (Helios_DoIO(HGA_HARDWARE, hw, &ioreq))
+                {
+                    Printf("HHIOCMD_DUMPTRACE failed, io err=%ld\n", (LONG)ioreq.iohh_Req.io_Error);
+                    res = RETURN_ERROR;
+                }
+                else
+                {
+                    dump(ioreq.iohh_Actual);
+                }
+            }
+
+            if (RETURN_OK == res)
+            {
+                struct TagItem tags[] =
+                {
+                    {HHA_TraceMask, (ULONG)&mask},
+                    {TAG_DONE, 0}
+                };
+
+                ioreq.iohh_Req.io_Command = HHIOCMD_QUERYDEVICE;
+                ioreq.iohh_Data = tags;
+                if (!Helios_DoIO(HGA_HARDWARE, hw, &ioreq) && (1 == ioreq.iohh_Actual))
+                {
+                    Printf("Trace mask: $%08lx\n", mask);
+                }
+            }
+
+            Helios_ReleaseHardware(hw);
+        }
+        else
+        {
+            Printf("No hardware #%ld\n", hwno);
+        }
+
+        CloseLibrary(HeliosBase);
+    }
+
+    FreeArgs(rdargs);
+    return res;
+}
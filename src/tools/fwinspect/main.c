@@ -504,7 +504,7 @@ static APTR DeviceListConstruct(struct Hook *hook, APTR pool, HeliosDevice *dev)
             data->DevEvtMsg.hm_Msg.mn_Node.ln_Type = NT_MESSAGE;
             data->DevEvtMsg.hm_Msg.mn_ReplyPort = event_port;
             data->DevEvtMsg.hm_Msg.mn_Length = sizeof(data->DevEvtMsg);
-            data->DevEvtMsg.hm_Type = HELIOS_MSGTYPE_EVENT;
+            data->DevEvtMsg.hm_Type = HELIOS_MSGTYPE_POOLED_EVENT;
             data->DevEvtMsg.hm_EventMask = HEVTF_DEVICE_ALL;
             data->DevEvtMsg.hm_UserData = data;
             Helios_AddEventListener(data->DevEvtList, &data->DevEvtMsg);
@@ -847,7 +847,7 @@ BOOL HandleHeliosEvents(void)
                 }
 
                 /* these messages must be free by user */
-                FreeMem(msg, msg->hm_Msg.mn_Length);
+                Helios_FreeEvent(msg);
             }
             break;
         }